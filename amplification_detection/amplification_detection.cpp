@@ -54,6 +54,7 @@
 #include <sstream>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <csignal>
 #include <list>
 #include <map>
@@ -61,6 +62,7 @@
 #include <algorithm>
 #include <getopt.h>
 #include <unistd.h>
+#include <arpa/inet.h>
 #include <vector>
 
 #ifdef __cplusplus
@@ -71,8 +73,10 @@ extern "C" {
 #ifdef __cplusplus
 }
 #endif
+#include "async_log.h"
 #include <unirec/unirec.h>
 #include "amplification_detection.h"
+#include "history_table.h"
 
 /**
  * Use this macro to count curently saved bytes/packets/flow only - if there are
@@ -101,7 +105,8 @@ UR_FIELDS(
    uint32 RSP_FLOWS,    //Number of flows in an interval (responses)
    uint32 RSP_PACKETS,  //Number of packets in a flow or in an interval (responses)
    uint64 RSP_BYTES,    //Number of bytes in a flow or in an interval (responses)
-   uint32 EVENT_ID      //Identification number of reported event
+   uint32 EVENT_ID,     //Identification number of reported event
+   uint32 ADDR_CNT      //Number of distinct reflectors (aggregation mode)
 )
 
 trap_module_info_t *module_info = NULL;
@@ -111,7 +116,7 @@ trap_module_info_t *module_info = NULL;
 
 #define MODULE_PARAMS(PARAM) \
    PARAM('d', "log_dir", "path to log files - it has to end with slash ('/'). If the parameter is omitted, no logs are stored.", required_argument, "string") \
-   PARAM('p', "port", "port used for detection (53)", required_argument, "int32") \
+   PARAM('p', "port", "comma separated list of ports used for detection (53), thresholds of a port can be set by :<param>=<value> for params n,t,q,a,i,y,l,m (e.g. 53,123:a=20:l=400)", required_argument, "string") \
    PARAM('n', "top", "number of top N values chosen (10)", required_argument, "int32") \
    PARAM('q', "step", "step of histogram (10)", required_argument, "uint32") \
    PARAM('a', "min_ampf", "minimal amplification effect considered an attack (5)", required_argument, "int32") \
@@ -121,202 +126,262 @@ trap_module_info_t *module_info = NULL;
    PARAM('l', "min_resp_byte", "minimal threshold for average size of responses in bytes in TOP-N (1000)", required_argument, "uint32") \
    PARAM('m', "max_query", "maximal threshold for average size of queries in bytes in TOP-N (300)", required_argument, "uint32") \
    PARAM('w', "timeout", "time window of detection / timeout of inactive flow (3600)", required_argument, "int32") \
-   PARAM('s', "period", "time window of deletion / period of inactive flows checking(300)", required_argument, "int32") \
-   PARAM('S', "record_count", "count of records to store for query / response direction (max size of vector).", required_argument, "uint32")
+   PARAM('s', "period", "time window of deletion (300)", required_argument, "int32") \
+   PARAM('S', "record_count", "count of records to store for query / response direction (max size of vector).", required_argument, "uint32") \
+   PARAM('H', "streaming", "keep incremental histograms in time slices instead of flow records, logs contain slice summaries only", no_argument, "none") \
+   PARAM('v', "victim_prefix", "aggregate all reflectors of victim prefix <ipv4_len>[,<ipv6_len>] into one record (e.g. 24,64), IPv6 prefix is 64 if omitted", required_argument, "string")
 
 static int stop = 0;
 
+/**
+ * Protocol (port) used for detection, with its own thresholds and history model
+ */
+struct protocol_t {
+
+   config_t config;     // configuration with thresholds of protocol
+   HistoryTable model;  // created history model of flows
+};
+
 /* configuration structure */
 static config_t config;
-/* created history model of flows */
-static history_t model;
+/* protocols used for detection */
+static vector<protocol_t *> protocols;
+/* index of protocol + 1 for each port, 0 if port is not used for detection */
+static uint8_t port_table[65536];
 /* current flow timestamp (seconds) */
 static unsigned long actual_timestamp;
 
-bool delete_inactive_flag = false;
-
 static char time_buff[25];
 
 TRAP_DEFAULT_SIGNAL_HANDLER(stop = 1)
 
 /**
- * Deletes inactive flows stored in history. Triggered by alarm.
+ * Masks address of victim to its prefix (aggregation mode)
  *
- * @param signum received signal
+ * @param ip address of victim
  */
-void mark_deletion(int signum) {
-   delete_inactive_flag = true;
-   // set next alarm
-   alarm(config.del_time);
-}
-
-void delete_inactive() {
-   delete_inactive_flag = false;
+void mask_victim(ip_addr_t &ip) {
 
-   // iterators
-   history_iter iter = model.begin();
-   history_iter iterEnd = model.end();
-
-   // loop of erasing
-   for ( ; iter != iterEnd; ) {
-      if ((actual_timestamp - ur_time_get_sec(iter->second.last_t)) > config.det_window) {
-         model.erase(iter++);
-      } else {
-         ++iter;
+   if (ip_is4(&ip)) {
+      if (config.victim_prefix4 < 32) {
+         ip.ui32[2] &= htonl(config.victim_prefix4 == 0 ? 0 : (uint32_t) 0xffffffff << (32 - config.victim_prefix4));
+      }
+   } else {
+      for (int i = 0; i < 16; i++) {
+         int bits = config.victim_prefix6 - 8 * i;
+         if (bits <= 0) {
+            ip.ui8[i] = 0;
+         } else if (bits < 8) {
+            ip.ui8[i] &= (uint8_t) (0xff << (8 - bits));
+         }
       }
    }
 }
 
 /**
- * Creates histogram from vector of flows
+ * Calculates index of histogram bucket for value
  *
- * @param flows flow data
- * @param type type of histogram (bytes/packets)
- * @param direction direction of histogram (query/response)
- * @return histogram
+ * @param value value
+ * @param q width of bucket
+ * @return index of bucket
  */
-histogram_t createHistogram(flow_data_t &flows, int type, int direction) {
+inline uint32_t histogramBucket(uint64_t value, uint32_t q) {
 
-   histogram_t histogram;
-   histogram_t histogram_q;
+   uint64_t bucket = value / q;
+   uint32_t buckets = (BYTES_MAX + q - 1) / q;
 
-   // choose the direction
-   if (direction == QUERY) {
-
-      // Create the histogram
-      for (vector<flow_item_t>::iterator i = flows.q.begin(); i != flows.q.end(); ++i) {
-         // choose base data of histogram
-         if (type == PACKETS) {
-            ++histogram[i->packets];
-         } else if (type == BYTES) {
-            ++histogram[i->bytes];
-         }
-      }
+   return (bucket < buckets) ? bucket : buckets - 1;
+}
 
-   } else if (direction == RESPONSE) {
+/**
+ * Prepares empty histogram with buckets of width q
+ *
+ * @param h histogram
+ * @param q width of bucket
+ */
+void initHistogram(histogram_t &h, uint32_t q) {
 
-   // Create the histogram
-      for (vector<flow_item_t>::iterator i = flows.r.begin(); i != flows.r.end(); ++i) {
-         if (type == PACKETS) {
-            ++histogram[i->packets];
-         } else if (type == BYTES) {
-            histogram[i->bytes] = histogram[i->bytes]+1;
-         }
-      }
-   }
+   h.q = q;
+   h.total = 0;
+   h.counts.assign((BYTES_MAX + q - 1) / q, 0);
+}
 
-   // divide by Q according to histogram step
-   uint32_t max = config.q;
+/**
+ * Adds value to histogram
+ *
+ * @param h histogram
+ * @param value added value
+ */
+inline void addToHistogram(histogram_t &h, uint64_t value) {
 
-   for (uint32_t i = 0; i < BYTES_MAX; i+=config.q) {
-      for (histogram_iter it = histogram.begin(); it != histogram.end(); ++it) {
-         if ((it->first >= i) && (it->first < max)) {
-            histogram_q[max] = it->second;
-         }
-      }
-      max += config.q;
-   }
+   ++h.counts[histogramBucket(value, h.q)];
+   ++h.total;
+}
+
+/**
+ * Adds value to sparse histogram of time slice
+ *
+ * @param h histogram
+ * @param value added value
+ * @param q width of bucket
+ */
+void addToSliceHistogram(slice_histogram_t &h, uint64_t value, uint32_t q) {
 
-   // DEBUG PRINT
-   //for (histogram_iter i = histogram_q.begin(); i != histogram_q.end(); ++i) {
-   //    printf("!!q! %d : %d \n", i->first, i->second);
-   //}
+   pair<uint16_t, uint32_t> item(histogramBucket(value, q), 0);
 
-   return histogram_q;
+   // buckets are unique, so the first pair not less than (bucket, 0) is the bucket itself or its successor
+   slice_histogram_t::iterator it = lower_bound(h.begin(), h.end(), item);
+   if (it == h.end() || it->first != item.first) {
+      it = h.insert(it, item);
+   }
+   ++it->second;
 }
 
 /**
- * Creates normalized histogram from histogram
+ * Adds flow to the time slice of flow data it belongs to (streaming mode)
  *
- * @param h input histogram
- * @return normalized histogram
+ * @param d flow data
+ * @param direction direction of flow (query/response)
+ * @param i flow item
+ * @param q width of histogram bucket
  */
-histogram_norm_t normalizeHistogram(histogram_t h) {
+void streamAddFlow(flow_data_t &d, int direction, const flow_item_t &i, uint32_t q) {
 
-   // sum for dividing
-   float sum = 0;
+   uint64_t id = ur_time_get_sec(i.t) / config.slice_len;
 
-   for (histogram_iter it = h.begin(); it != h.end(); it++) {
-      sum += it->second;
+   // flows come almost ordered, look for the slice from the newest one
+   vector<flow_slice_t>::iterator s = d.slices.end();
+   while (s != d.slices.begin() && (s - 1)->id > id) {
+      --s;
    }
 
-   histogram_norm_t histogram;
-
-   // create normalized histogram
-   for (histogram_iter it = h.begin(); it != h.end(); ++it) {
-      histogram[it->first] = it->second / sum;
+   if (s == d.slices.begin() || (s - 1)->id != id) {
+      flow_slice_t slice;
+      slice.id = id;
+      slice.first_t = i.t;
+      for (int dir = QUERY; dir <= RESPONSE; dir++) {
+         slice.bytes[dir] = 0;
+         slice.packets[dir] = 0;
+         slice.flows[dir] = 0;
+         slice.max_bytes[dir] = 0;
+         slice.max_packets[dir] = 0;
+      }
+      s = d.slices.insert(s, slice);
+   } else {
+      --s;
    }
 
-   // DEBUG PRINT
-   //for (histogram_norm_iter i = histogram.begin(); i != histogram.end(); ++i) {
-   //    printf(".. %d : %f \n", i->first, i->second);
-   //}
+   s->bytes[direction] += i.bytes;
+   s->packets[direction] += i.packets;
+   s->flows[direction] += 1;
+   if (i.bytes > s->max_bytes[direction]) {
+      s->max_bytes[direction] = i.bytes;
+   }
+   if (i.packets > s->max_packets[direction]) {
+      s->max_packets[direction] = i.packets;
+   }
+   if (i.t < s->first_t) {
+      s->first_t = i.t;
+   }
 
-   return histogram;
+   addToSliceHistogram(s->hist[direction][PACKETS], i.packets, q);
+   addToSliceHistogram(s->hist[direction][BYTES], i.bytes, q);
 }
 
-
 /**
- * Takes topN items from histogram
+ * Deletes time slices with flows older than kept part of the window (streaming mode).
+ * Slice is deleted only when all its flows are old.
  *
- * @param h input histogram
- * @return topN items as histogram
+ * @param d flow data
+ * @param now actual time in seconds
  */
-histogram_t topnHistogram(histogram_t h) {
+void streamDeleteWindow(flow_data_t &d, uint64_t now) {
 
-   histogram_t topn;
+   vector<flow_slice_t>::iterator s = d.slices.begin();
 
-   // create vector of pairs from histogram
-   vector<pair<unsigned int, unsigned int> > values;
-
-   // fill vector with swapped histogram pairs
-   for (histogram_iter it = h.begin(); it != h.end(); ++it) {
-      values.push_back(make_pair(it->second, it->first));
+   for ( ; s != d.slices.end(); ++s) {
+      // last second which belongs to the slice
+      uint64_t slice_end = (s->id + 1) * config.slice_len - 1;
+      if (now <= slice_end || (now - slice_end) <= (config.det_window - config.del_time)) {
+         break;
+      }
    }
 
-   // sort histogram pairs - reversed
-   sort(values.rbegin(), values.rend());
+   d.slices.erase(d.slices.begin(), s);
+}
 
-   // take only first n items in correct order now
-   uint32_t i = 0;
-   for (int j = 0; j < config.n; j++) {
-      if (i < values.size()) {
-         topn[values[i].second] = values[i].first;
-         i++;
+/**
+ * Creates histogram from vector of flows
+ *
+ * @param flows flow data
+ * @param type type of histogram (bytes/packets)
+ * @param direction direction of histogram (query/response)
+ * @param histogram created histogram (its buffer is reused)
+ * @param q width of bucket
+ */
+void createHistogram(flow_data_t &flows, int type, int direction, histogram_t &histogram, uint32_t q) {
+
+   initHistogram(histogram, q);
+
+   // merge histograms of time slices
+   if (config.streaming) {
+      for (vector<flow_slice_t>::iterator s = flows.slices.begin(); s != flows.slices.end(); ++s) {
+         slice_histogram_t &h = s->hist[direction][type];
+         for (slice_histogram_t::iterator b = h.begin(); b != h.end(); ++b) {
+            histogram.counts[b->first] += b->second;
+            histogram.total += b->second;
+         }
       }
+      return;
    }
 
-   return topn;
-}
+   // choose the direction
+   vector<flow_item_t> &items = (direction == QUERY) ? flows.q : flows.r;
 
+   // choose base data of histogram
+   if (type == PACKETS) {
+      for (vector<flow_item_t>::iterator i = items.begin(); i != items.end(); ++i) {
+         addToHistogram(histogram, i->packets);
+      }
+   } else if (type == BYTES) {
+      for (vector<flow_item_t>::iterator i = items.begin(); i != items.end(); ++i) {
+         addToHistogram(histogram, i->bytes);
+      }
+   }
+}
 
 /**
- * Takes topN items from normalized histogram
+ * Takes topN buckets from histogram (buckets with the same count ordered by key, the highest first)
  *
  * @param h input histogram
- * @return topN items as normalized histogram
+ * @param n_top number of buckets chosen
+ * @return topN buckets, the most frequent first
  */
-histogram_norm_t topnNormHistogram(histogram_norm_t h) {
+topn_t topnHistogram(const histogram_t &h, int n_top) {
 
-   histogram_norm_t topn;
+   topn_t topn;
+   size_t n = n_top > 0 ? n_top : 0;
 
-   // create vector of pairs from histogram
-   vector<pair<float, unsigned int> > values;
-
-   // fill vector with swapped histogram pairs
-   for (histogram_norm_iter it = h.begin(); it != h.end(); ++it) {
-      values.push_back(make_pair(it->second, it->first));
+   if (n == 0) {
+      return topn;
    }
+   topn.reserve(n + 1);
 
-   // sort histogram pairs - reversed
-   sort(values.rbegin(), values.rend());
+   // insertion into short sorted array, n is small
+   for (size_t i = 0; i < h.counts.size(); ++i) {
+      unsigned int count = h.counts[i];
+      if (count == 0 || (topn.size() == n && count < topn.back().second)) {
+         continue;
+      }
 
-   // take first n pairs in correct order
-   uint32_t i = 0;
-   for (int j = 0; j < config.n; j++) {
-      if (i < values.size()) {
-         topn[values[i].second] = values[i].first;
-         i++;
+      pair<unsigned int, unsigned int> item((i + 1) * h.q, count);
+      topn_t::iterator pos = topn.begin();
+      while (pos != topn.end() && (pos->second > count || (pos->second == count && pos->first > item.first))) {
+         ++pos;
+      }
+      topn.insert(pos, item);
+      if (topn.size() > n) {
+         topn.pop_back();
       }
    }
 
@@ -325,18 +390,18 @@ histogram_norm_t topnNormHistogram(histogram_norm_t h) {
 
 
 /**
- * Calculates sum of value occurence
+ * Calculates sum of keys or values of topN buckets
  *
- * @param h input histogram
+ * @param h topN buckets
  * @param type type of sum - keys or values
  * @return sum
  */
-unsigned int sum (histogram_t h, int type) {
+unsigned int sum (const topn_t &h, int type) {
 
    // sum
    unsigned int s = 0;
 
-   for (histogram_iter it = h.begin(); it != h.end(); it++) {
+   for (topn_iter it = h.begin(); it != h.end(); it++) {
 
       // choose first or second value of map
       if (type == KEY) {
@@ -350,21 +415,21 @@ unsigned int sum (histogram_t h, int type) {
 }
 
 
-
-
 /**
- * Calculates sum of value normalized occurence. For sum of KEYs use sum() with correct parameter.
+ * Calculates sum of normalized occurence of topN buckets (share of values in topN buckets)
  *
- * @param h input histogram
+ * @param h histogram
+ * @param topn topN buckets of the histogram
  * @return sum normalized
  */
-float sumN (histogram_norm_t h) {
+float sumN (const histogram_t &h, const topn_t &topn) {
 
    // float sum
    float s = 0.0;
+   float total = h.total;
 
-   for (histogram_norm_iter it = h.begin(); it != h.end(); ++it) {
-      s += it->second;
+   for (topn_iter it = topn.begin(); it != topn.end(); ++it) {
+      s += it->second / total;
    }
 
    return s;
@@ -374,16 +439,16 @@ float sumN (histogram_norm_t h) {
 /**
  * Calculates average key value
  *
- * @param h input histogram
+ * @param h topN buckets
  * @return average
  */
-float sum_average (histogram_t h) {
+float sum_average (const topn_t &h) {
 
    // sum and number of items
    unsigned long s = 0;
    unsigned long n = 0;
 
-   for (histogram_iter it = h.begin(); it != h.end(); ++it) {
+   for (topn_iter it = h.begin(); it != h.end(); ++it) {
       s += (it->first * it->second);
       n += it->second;
    }
@@ -396,15 +461,26 @@ float sum_average (histogram_t h) {
 }
 
 /**
- * Calculates maximum packet count in vecotr of given direction
+ * Calculates maximum packet count in flows of given direction
  *
- * @param vec input vector
+ * @param d flow data
+ * @param direction direction of flows (query/response)
  * @return maximum packet count
  */
-uint32_t max_packets (vector<flow_item_t> &vec) {
+uint32_t max_packets (flow_data_t &d, int direction) {
 
    uint32_t max = 0;
 
+   if (config.streaming) {
+      for (vector<flow_slice_t>::iterator it = d.slices.begin(); it != d.slices.end(); ++it) {
+         if (it->max_packets[direction] > max){
+            max = it->max_packets[direction];
+         }
+      }
+      return (max);
+   }
+
+   vector<flow_item_t> &vec = (direction == QUERY) ? d.q : d.r;
    for (vector<flow_item_t>::iterator it = vec.begin(); it != vec.end(); ++it) {
       if (it->packets > max){
          max = it->packets;
@@ -415,15 +491,26 @@ uint32_t max_packets (vector<flow_item_t> &vec) {
 }
 
 /**
- * Calculates maximum byte count in vecotr of given direction
+ * Calculates maximum byte count in flows of given direction
  *
- * @param vec input vector
+ * @param d flow data
+ * @param direction direction of flows (query/response)
  * @return maximum byte count
  */
-uint64_t max_bytes (vector<flow_item_t> &vec) {
+uint64_t max_bytes (flow_data_t &d, int direction) {
 
    uint64_t max = 0;
 
+   if (config.streaming) {
+      for (vector<flow_slice_t>::iterator it = d.slices.begin(); it != d.slices.end(); ++it) {
+         if (it->max_bytes[direction] > max){
+            max = it->max_bytes[direction];
+         }
+      }
+      return (max);
+   }
+
+   vector<flow_item_t> &vec = (direction == QUERY) ? d.q : d.r;
    for (vector<flow_item_t>::iterator it = vec.begin(); it != vec.end(); ++it) {
       if (it->bytes > max){
          max = it->bytes;
@@ -433,6 +520,27 @@ uint64_t max_bytes (vector<flow_item_t> &vec) {
    return (max);
 }
 
+/**
+ * Checks if flows of given direction are stored
+ *
+ * @param d flow data
+ * @param direction direction of flows (query/response)
+ * @return true if there is at least one flow
+ */
+bool has_flows (flow_data_t &d, int direction) {
+
+   if (config.streaming) {
+      for (vector<flow_slice_t>::iterator it = d.slices.begin(); it != d.slices.end(); ++it) {
+         if (it->flows[direction] > 0){
+            return true;
+         }
+      }
+      return false;
+   }
+
+   return (direction == QUERY) ? !d.q.empty() : !d.r.empty();
+}
+
 void time2str(ur_time_t t)
 {
    time_t sec = ur_time_get_sec(t);
@@ -442,6 +550,270 @@ void time2str(ur_time_t t)
    sprintf(time_buff + 19, ".%03i", msec);
 }
 
+/**
+ * Writes summary of time slices to log (streaming mode), one line per slice and direction
+ * with first timestamp, packets, bytes and number of flows
+ *
+ * @param log log of the event
+ * @param slices slices of the log record
+ * @param count number of slices
+ */
+void log_slices(ostream &log, const log_slice_t *slices, uint32_t count)
+{
+   for (uint32_t i = 0; i < count; i++) {
+      time2str(slices[i].first_t);
+      log << time_buff << ((slices[i].dir == QUERY) ? "\tQ\t" : "\tR\t") << slices[i].packets << "\t" << slices[i].bytes << "\t" << slices[i].flows << endl;
+   }
+}
+
+/**
+ * Writes flow item to log
+ */
+static void log_flow_item(ostream &log, const flow_item_t &item, int dir)
+{
+   time2str(item.t);
+   log << time_buff << ((dir == QUERY) ? "\tQ\t" : "\tR\t") << item.packets << "\t" << item.bytes << endl;
+}
+
+// log files opened by the log writer thread
+static map<string, FILE *> log_files;
+
+/**
+ * Returns log file of given name opened for appending, at most LOG_OPEN_FILES files are kept opened.
+ */
+static FILE *get_log_file(const string &name)
+{
+   map<string, FILE *>::iterator f = log_files.find(name);
+   if (f != log_files.end()) {
+      return f->second;
+   }
+   if (log_files.size() >= LOG_OPEN_FILES) {
+      close_log_files();
+   }
+   FILE *log = fopen(name.c_str(), "a");
+   if (log == NULL) {
+      cerr << "Error: Cannot open log file [" << name << "]." << endl;
+      return NULL;
+   }
+   log_files[name] = log;
+   return log;
+}
+
+void close_log_files()
+{
+   for (map<string, FILE *>::iterator f = log_files.begin(); f != log_files.end(); ++f) {
+      fclose(f->second);
+   }
+   log_files.clear();
+}
+
+/**
+ * Formats log of an event and appends it to its file, called by the log writer thread.
+ * Record contains log_record_t followed by top reflectors, time slices, query and response flows,
+ * argument is the path to log files.
+ */
+void write_log_record(FILE *, uint16_t type, const void *data, uint32_t size, void *arg)
+{
+   const string &log_path = *(const string *) arg;
+   const char *pos = (const char *) data;
+   char addr_buff[INET6_ADDRSTRLEN];
+   log_record_t header;
+   ostringstream filename;
+   ostringstream log;
+
+   if (type != LOG_RECORD || size < sizeof(header)) {
+      return;
+   }
+   memcpy(&header, pos, sizeof(header));
+   if (size != sizeof(header) + header.top * sizeof(reflector_t) + header.slices * sizeof(log_slice_t) +
+               ((size_t) header.q + header.r) * sizeof(flow_item_t)) {
+      return;
+   }
+   pos += sizeof(header);
+   vector<reflector_t> top(header.top);
+   vector<log_slice_t> slices(header.slices);
+   vector<flow_item_t> q(header.q), r(header.r);
+   if (header.top != 0) {
+      memcpy(&top[0], pos, header.top * sizeof(reflector_t));
+      pos += header.top * sizeof(reflector_t);
+   }
+   if (header.slices != 0) {
+      memcpy(&slices[0], pos, header.slices * sizeof(log_slice_t));
+      pos += header.slices * sizeof(log_slice_t);
+   }
+   if (header.q != 0) {
+      memcpy(&q[0], pos, header.q * sizeof(flow_item_t));
+      pos += header.q * sizeof(flow_item_t);
+   }
+   if (header.r != 0) {
+      memcpy(&r[0], pos, header.r * sizeof(flow_item_t));
+   }
+
+   filename << log_path;
+   if (header.big){
+      filename << "BIG/";
+   }
+   if (header.aggregate){
+      filename << LOG_FILE_PREFIX << "victim";
+   } else {
+      ip_to_str(&header.key.src, addr_buff);
+      filename << LOG_FILE_PREFIX << addr_buff;
+   }
+   ip_to_str(&header.key.dst, addr_buff);
+   filename << "-" << addr_buff;
+   if (header.port != 0){
+      filename << "-" << header.port;
+   }
+   filename << LOG_FILE_SUFFIX;
+
+   if (header.aggregate){
+      ip_to_str(&header.key.dst, addr_buff);
+      log << "Target prefix: " << addr_buff << "/" << (int) header.prefix;
+      log << "   Reflectors: " << header.reflectors << "\n";
+      for (vector<reflector_t>::iterator it = top.begin(); it != top.end(); ++it) {
+         ip_to_str(&it->ip, addr_buff);
+         log << "Abused server IP: " << addr_buff << "\t" << it->bytes << "\n";
+      }
+   } else {
+      ip_to_str(&header.key.src, addr_buff);
+      log << "Abused server IP: " << addr_buff;
+      ip_to_str(&header.key.dst, addr_buff);
+      log << "   Target IP: " << addr_buff << "\n";
+   }
+   log_slices(log, slices.empty() ? NULL : &slices[0], header.slices);
+
+   // flows are merged by time until the direction with sooner last flow ends
+   size_t pos_dir[2] = {0,0};
+   ur_time_t tmp_t_q = 0;
+   ur_time_t tmp_t_r = 0;
+   for (vector<flow_item_t>::iterator it = q.begin(); it != q.end(); ++it) {
+      if (it->t > tmp_t_q) {
+         tmp_t_q = it->t;
+      }
+   }
+   for (vector<flow_item_t>::iterator it = r.begin(); it != r.end(); ++it) {
+      if (it->t > tmp_t_r) {
+         tmp_t_r = it->t;
+      }
+   }
+   int shorter = (tmp_t_r < tmp_t_q) ? RESPONSE : QUERY;
+   int longer = (shorter == QUERY) ? RESPONSE : QUERY;
+   size_t sooner_end = (shorter == QUERY) ? q.size() : r.size();
+   size_t later_end = (shorter == QUERY) ? r.size() : q.size();
+
+   while (pos_dir[shorter] < sooner_end){
+      if (q[pos_dir[QUERY]].t <= r[pos_dir[RESPONSE]].t) {
+         log_flow_item(log, q[pos_dir[QUERY]], QUERY);
+         ++pos_dir[QUERY];
+      } else {
+         log_flow_item(log, r[pos_dir[RESPONSE]], RESPONSE);
+         ++pos_dir[RESPONSE];
+      }
+   }
+   for (pos_dir[longer] = pos_dir[shorter]; pos_dir[longer] < later_end; ++pos_dir[longer]) {
+      log_flow_item(log, (longer == QUERY) ? q[pos_dir[QUERY]] : r[pos_dir[RESPONSE]], longer);
+   }
+
+   FILE *file = get_log_file(filename.str());
+   if (file == NULL) {
+      return;
+   }
+   string text = log.str();
+   fwrite(text.data(), 1, text.size(), file);
+   fflush(file);
+}
+
+
+/**
+ * Parses list of ports used for detection with their thresholds, e.g. "53,123:a=20:l=400".
+ * Thresholds which are not set for a port are taken from the global configuration.
+ *
+ * @param list list of ports
+ * @return true if the list is valid
+ */
+bool parse_protocols(const string &list)
+{
+   istringstream items(list);
+   string item;
+
+   while (getline(items, item, ',')) {
+      istringstream fields(item);
+      string field;
+      char *end;
+
+      getline(fields, field, ':');
+      unsigned long port = strtoul(field.c_str(), &end, 10);
+      if (field.empty() || *end != '\0' || port > 65535) {
+         cerr << "Error: Invalid port [" << field << "]." << endl;
+         return false;
+      }
+      if (port_table[port] != 0) {
+         cerr << "Error: Port " << port << " is set more than once." << endl;
+         return false;
+      }
+      if (protocols.size() >= 255) {
+         cerr << "Error: Too many ports." << endl;
+         return false;
+      }
+
+      protocol_t *proto = new protocol_t();
+      proto->config = config;
+      proto->config.port = port;
+      protocols.push_back(proto);
+      port_table[port] = protocols.size();
+
+      // thresholds of port
+      while (getline(fields, field, ':')) {
+         if (field.size() < 3 || field[1] != '=') {
+            cerr << "Error: Invalid threshold [" << field << "] of port " << port << "." << endl;
+            return false;
+         }
+         const char *value = field.c_str() + 2;
+         switch (field[0]) {
+            case 'n':
+               proto->config.n = atoi(value);
+               break;
+            case 't':
+               proto->config.min_flows = atoi(value);
+               break;
+            case 'q':
+               proto->config.q = atoi(value);
+               break;
+            case 'a':
+               proto->config.min_a = atoi(value);
+               break;
+            case 'i':
+            case 'I':
+               proto->config.min_flows_norm = atof(value);
+               break;
+            case 'y':
+               proto->config.min_resp_packets = atoi(value);
+               break;
+            case 'l':
+               proto->config.min_resp_bytes = atoi(value);
+               break;
+            case 'm':
+               proto->config.max_quer_bytes = atoi(value);
+               break;
+            default:
+               cerr << "Error: Unknown threshold [" << field << "] of port " << port << "." << endl;
+               return false;
+         }
+      }
+
+      if (proto->config.q == 0) {
+         cerr << "Error: Histogram step of port " << port << " must be positive." << endl;
+         return false;
+      }
+   }
+
+   if (protocols.empty()) {
+      cerr << "Error: No port used for detection." << endl;
+      return false;
+   }
+
+   return true;
+}
 
 /**
  * Main function.
@@ -456,9 +828,9 @@ int main (int argc, char** argv)
    int ret;       // return value
 
    uint32_t unique_id = 0;
-   ofstream log;
-   ostringstream filename;
+   async_log_t *event_log = NULL;
    string log_path = "";
+   string port_list = "";
 
    uint16_t src_port;      // actual source port
    uint16_t dst_port;      // actual destination flows
@@ -477,7 +849,7 @@ int main (int argc, char** argv)
             log_path = optarg;
             break;
          case 'p':
-            config.port = atoi(optarg);
+            port_list = optarg;
             break;
          case 'n':
             config.n = atoi(optarg);
@@ -524,6 +896,23 @@ int main (int argc, char** argv)
          case 'S':
             config.max_flow_items = atoi (optarg);
             break;
+         case 'H':
+            config.streaming = true;
+            break;
+         case 'v': {
+            unsigned int prefix4 = 0, prefix6 = 64;
+            int items = sscanf(optarg, "%u,%u", &prefix4, &prefix6);
+            if (items < 1 || prefix4 > 32 || prefix6 > 128) {
+               cerr << "Error: Invalid victim prefix [" << optarg << "]." << endl;
+               trap_finalize();
+               FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS)
+               return ERROR;
+            }
+            config.aggregate = true;
+            config.victim_prefix4 = prefix4;
+            config.victim_prefix6 = prefix6;
+            break;
+         }
          default:
             cerr <<  "Error: Invalid arguments." << endl;
             trap_finalize();
@@ -532,6 +921,22 @@ int main (int argc, char** argv)
       }
    }
 
+   if (port_list.empty()){
+      ostringstream default_port;
+      default_port << config.port;
+      port_list = default_port.str();
+   }
+
+   // global thresholds are set, create protocols with their own thresholds
+   if (!parse_protocols(port_list)){
+      for (size_t p = 0; p < protocols.size(); p++) {
+         delete protocols[p];
+      }
+      trap_finalize();
+      FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS)
+      return ERROR;
+   }
+
    if (config.max_flow_items < MINIMAL_RECORD_VECTOR_SIZE){
       cerr << "Error: Wrong record vector(s) settings." << endl;
       trap_finalize();
@@ -539,6 +944,9 @@ int main (int argc, char** argv)
       return ERROR;
    }
 
+   // slices are deleted as a whole, so they have to be shorter than the deletion window
+   config.slice_len = (config.del_time >= STREAM_SLICES) ? config.del_time / STREAM_SLICES : 1;
+
    if (trap_ifcctl(TRAPIFC_INPUT, 0, TRAPCTL_SETTIMEOUT, TRAP_WAIT) != TRAP_E_OK){
       cerr << "Error: Unable to set up intput timeout." << endl;
       trap_finalize();
@@ -567,7 +975,9 @@ int main (int argc, char** argv)
       FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS)
       return ERROR;
    }
-   ur_template_t* unirec_out = ur_create_output_template(0, "SRC_IP,DST_IP,SRC_PORT,REQ_FLOWS,REQ_PACKETS,REQ_BYTES,RSP_FLOWS,RSP_PACKETS,RSP_BYTES,TIME_FIRST,TIME_LAST,EVENT_ID", &errstr);
+   ur_template_t* unirec_out = ur_create_output_template(0, config.aggregate ?
+         "SRC_IP,DST_IP,SRC_PORT,REQ_FLOWS,REQ_PACKETS,REQ_BYTES,RSP_FLOWS,RSP_PACKETS,RSP_BYTES,TIME_FIRST,TIME_LAST,EVENT_ID,ADDR_CNT" :
+         "SRC_IP,DST_IP,SRC_PORT,REQ_FLOWS,REQ_PACKETS,REQ_BYTES,RSP_FLOWS,RSP_PACKETS,RSP_BYTES,TIME_FIRST,TIME_LAST,EVENT_ID", &errstr);
    // check created templates
    if (unirec_out == NULL) {
       cerr << "Error: Invalid UniRec specifier." << endl;
@@ -593,15 +1003,32 @@ int main (int argc, char** argv)
       return ERROR;
    }
 
+   // logs of events are written by a separate thread, so that detection does not wait for the disk
+   if (log_path.compare("") != 0) {
+      event_log = async_log_open(NULL, LOG_CAPACITY, ASYNC_LOG_SYNC_NEVER, write_log_record, &log_path);
+      if (event_log == NULL) {
+         ur_free_template(unirec_in);
+         ur_free_template(unirec_out);
+         ur_free_record(detection);
+         trap_finalize();
+         FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS)
+         return ERROR;
+      }
+   }
 
-   // set signal for inactive flow deletion
-   signal(SIGALRM, mark_deletion);
-   alarm(config.del_time);
+
+   // inactive pairs are deleted after detection window
+   for (size_t p = 0; p < protocols.size(); p++) {
+      protocols[p]->model.init(config.det_window);
+   }
 
    // data buffer
    const void *data;
    uint16_t data_size;
 
+   // histograms of detection, buffers are reused
+   histogram_t hvqb, hvqp, hvrb, hvrp;
+
    // ***** Main processing loop *****
    while (!stop) {
       // retrieve data from server
@@ -627,11 +1054,12 @@ int main (int argc, char** argv)
       flow_key_t actual_key;
 
       // check if src or dst port is expected, otherwise next flow
-      if (dst_port == config.port) {
+      uint8_t proto_index;
+      if ((proto_index = port_table[dst_port]) != 0) {
          qr = BOOL_QUERY;
          actual_key.dst = ur_get(unirec_in, data, F_SRC_IP);
          actual_key.src = ur_get(unirec_in, data, F_DST_IP);
-      } else if (src_port == config.port) {
+      } else if ((proto_index = port_table[src_port]) != 0) {
          qr = BOOL_RESPONSE;
          actual_key.src = ur_get(unirec_in, data, F_SRC_IP);
          actual_key.dst = ur_get(unirec_in, data, F_DST_IP);
@@ -639,17 +1067,32 @@ int main (int argc, char** argv)
          continue;
       }
 
+      // all reflectors of victim prefix share one record
+      ip_addr_t reflector = actual_key.src;
+      if (config.aggregate) {
+         memset(&actual_key.src, 0, sizeof(ip_addr_t));
+         mask_victim(actual_key.dst);
+      }
+
+      // history model and thresholds of the protocol
+      HistoryTable &model = protocols[proto_index - 1]->model;
+      const config_t &proto_config = protocols[proto_index - 1]->config;
+
       if (actual_timestamp < ur_time_get_sec(ur_get(unirec_in, data, F_TIME_LAST))){ // since timestamps are not always ordered
          actual_timestamp = ur_time_get_sec(ur_get(unirec_in, data, F_TIME_LAST));
       }
 
       // iterator through history model
-      history_iter it;
+      history_entry_t *it;
 
-      if ((it = model.find(actual_key)) != model.end()) {
+      if ((it = model.find(actual_key)) != NULL) {
          // record exists - update information and add flow
-         if (it->second.last_t < ur_get(unirec_in, data, F_TIME_LAST)){
-            it->second.last_t = ur_get(unirec_in, data, F_TIME_LAST);
+         if (it->data.last_t < ur_get(unirec_in, data, F_TIME_LAST)){
+            it->data.last_t = ur_get(unirec_in, data, F_TIME_LAST);
+            model.touch(it);
+         }
+         if (config.aggregate){
+            it->data.reflectors.insert(reflector, (qr == BOOL_RESPONSE) ? ur_get(unirec_in, data, F_BYTES) : 0);
          }
 
          // create new flow information structure
@@ -660,254 +1103,259 @@ int main (int argc, char** argv)
 
          // add new flow
          if (qr == BOOL_QUERY){
-            it->second.total_bytes[QUERY] += ur_get(unirec_in, data, F_BYTES);
-            it->second.total_packets[QUERY] += ur_get(unirec_in, data, F_PACKETS);
-            it->second.total_flows[QUERY] += 1;
-
-            if (it->second.q.size() < config.max_flow_items){
-               it->second.q.push_back(i);
+            it->data.total_bytes[QUERY] += ur_get(unirec_in, data, F_BYTES);
+            it->data.total_packets[QUERY] += ur_get(unirec_in, data, F_PACKETS);
+            it->data.total_flows[QUERY] += 1;
+
+            if (config.streaming){
+               streamAddFlow(it->data, QUERY, i, proto_config.q);
+            } else if (it->data.q.size() < config.max_flow_items){
+               it->data.q.push_back(i);
             } else {
-               if (it->second.q_rem_pos == 0){
-                  it->second.q.reserve(config.max_flow_items);
+               if (it->data.q_rem_pos == 0){
+                  it->data.q.reserve(config.max_flow_items);
                }
                #ifdef COUNTS_WORKING
-               it->second.total_bytes[QUERY] -=  it->second.q[it->second.q_rem_pos].bytes;
-               it->second.total_packets[QUERY] -=  it->second.q[it->second.q_rem_pos].packets;
-               it->second.total_flows[QUERY] -= 1;
+               it->data.total_bytes[QUERY] -=  it->data.q[it->data.q_rem_pos].bytes;
+               it->data.total_packets[QUERY] -=  it->data.q[it->data.q_rem_pos].packets;
+               it->data.total_flows[QUERY] -= 1;
                #endif
 
-               it->second.q[it->second.q_rem_pos] = i;
-               it->second.q_rem_pos = (it->second.q_rem_pos + 1) % config.max_flow_items;
+               it->data.q[it->data.q_rem_pos] = i;
+               it->data.q_rem_pos = (it->data.q_rem_pos + 1) % config.max_flow_items;
             }
          } else {
-            it->second.total_bytes[RESPONSE] += ur_get(unirec_in, data, F_BYTES);
-            it->second.total_packets[RESPONSE] += ur_get(unirec_in, data, F_PACKETS);
-            it->second.total_flows[RESPONSE] += 1;
-
-            if (it->second.r.size() < config.max_flow_items){
-               it->second.r.push_back(i);
+            it->data.total_bytes[RESPONSE] += ur_get(unirec_in, data, F_BYTES);
+            it->data.total_packets[RESPONSE] += ur_get(unirec_in, data, F_PACKETS);
+            it->data.total_flows[RESPONSE] += 1;
+
+            if (config.streaming){
+               streamAddFlow(it->data, RESPONSE, i, proto_config.q);
+            } else if (it->data.r.size() < config.max_flow_items){
+               it->data.r.push_back(i);
             } else {
-               if (it->second.r_rem_pos == 0){
-                  it->second.r.reserve(config.max_flow_items);
+               if (it->data.r_rem_pos == 0){
+                  it->data.r.reserve(config.max_flow_items);
                }
                #ifdef COUNTS_WORKING
-               it->second.total_bytes[RESPONSE] -= it->second.r[it->second.r_rem_pos].bytes;
-               it->second.total_packets[RESPONSE] -= it->second.r[it->second.r_rem_pos].packets;
-               it->second.total_flows[RESPONSE] -= 1;
+               it->data.total_bytes[RESPONSE] -= it->data.r[it->data.r_rem_pos].bytes;
+               it->data.total_packets[RESPONSE] -= it->data.r[it->data.r_rem_pos].packets;
+               it->data.total_flows[RESPONSE] -= 1;
                #endif
 
-               it->second.r[it->second.r_rem_pos] = i;
-               it->second.r_rem_pos = (it->second.r_rem_pos + 1) % config.max_flow_items;
+               it->data.r[it->data.r_rem_pos] = i;
+               it->data.r_rem_pos = (it->data.r_rem_pos + 1) % config.max_flow_items;
             }
          }
 
          long t1 = ur_time_get_sec(ur_get(unirec_in, data, F_TIME_LAST));
-         long t2 = ur_time_get_sec(it->second.first_t);
+         long t2 = ur_time_get_sec(it->data.first_t);
          long t = t1 - t2;
          /// -------------------------------------------------------------------
          /// ---- Detection ---- >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
          // check if detection window for the key is met
          if (t > config.det_window) {
             // create histograms
-            histogram_t hvqb, hvqp, hvrb, hvrp;
-            histogram_norm_t hvrb_n;
-            hvqb = createHistogram(it->second, BYTES, QUERY);
-            hvqp = createHistogram(it->second, PACKETS, QUERY);
-            hvrb = createHistogram(it->second, BYTES, RESPONSE);
-            hvrp = createHistogram(it->second, PACKETS, RESPONSE);
+            createHistogram(it->data, BYTES, QUERY, hvqb, proto_config.q);
+            createHistogram(it->data, PACKETS, QUERY, hvqp, proto_config.q);
+            createHistogram(it->data, BYTES, RESPONSE, hvrb, proto_config.q);
+            createHistogram(it->data, PACKETS, RESPONSE, hvrp, proto_config.q);
 
             int report_this = DO_NOT_REPORT;
             //int report_this = NO;
 
-            if (it->second.total_flows[QUERY] && it->second.total_flows[RESPONSE]){
-               if (it->second.total_packets[QUERY] >= 30 && (it->second.total_packets[RESPONSE] / it->second.total_packets[QUERY]) >= 5){
-                  if (max_packets(it->second.q) > config.max_quer_flow_packets || max_bytes(it->second.r) > config.max_resp_flow_bytes) {
+            if (it->data.total_flows[QUERY] && it->data.total_flows[RESPONSE]){
+               if (it->data.total_packets[QUERY] >= 30 && (it->data.total_packets[RESPONSE] / it->data.total_packets[QUERY]) >= 5){
+                  if (max_packets(it->data, QUERY) > proto_config.max_quer_flow_packets || max_bytes(it->data, RESPONSE) > proto_config.max_resp_flow_bytes) {
                      //if ( (sum(topnHistogram(hvrb), KEY) / sum(topnHistogram(hvqb), KEY)) > config.min_a ) {
-                     if (it->second.r.size() > 0 && it->second.q.size() > 0)
-                     if ((max_bytes(it->second.r) / max_bytes(it->second.q)) > config.min_a) {
+                     if (has_flows(it->data, RESPONSE) && has_flows(it->data, QUERY))
+                     if ((max_bytes(it->data, RESPONSE) / max_bytes(it->data, QUERY)) > proto_config.min_a) {
                         report_this = REPORT_BIG;
                         //report_this = COND1;
                      }
                   }
-               } else if ( (sumN(topnNormHistogram(normalizeHistogram(hvrb))) > config.min_flows_norm) && (sum(topnHistogram(hvrb), VALUE) > config.min_flows) ) {
-                  if ( (sum_average(topnHistogram(hvrp)) > config.min_resp_packets) && (sum_average(topnHistogram(hvrb)) > config.min_resp_bytes) && (sum_average(topnHistogram(hvqb)) < config.max_quer_bytes) ) {
-                     if (sum(topnHistogram(hvqb), BYTES) > 0) {
-                        if ( ((sum(topnHistogram(hvrb), KEY) / topnHistogram(hvrb).size()) / (sum(topnHistogram(hvqb), KEY) / topnHistogram(hvqb).size())) > config.min_a ) {
-                           report_this = REPORT_COMPLEX;
-                           //report_this = COND2;
-                        } //if (det. - cond4)
-                     } //if (det. - cond3)
-                  } //if (det. - cond2)
+               } else {
+                  topn_t topn_rb = topnHistogram(hvrb, proto_config.n);
+                  if ( (sumN(hvrb, topn_rb) > proto_config.min_flows_norm) && (sum(topn_rb, VALUE) > proto_config.min_flows) ) {
+                     topn_t topn_rp = topnHistogram(hvrp, proto_config.n);
+                     topn_t topn_qb = topnHistogram(hvqb, proto_config.n);
+                     if ( (sum_average(topn_rp) > proto_config.min_resp_packets) && (sum_average(topn_rb) > proto_config.min_resp_bytes) && (sum_average(topn_qb) < proto_config.max_quer_bytes) ) {
+                        if (sum(topn_qb, BYTES) > 0) {
+                           if ( ((sum(topn_rb, KEY) / topn_rb.size()) / (sum(topn_qb, KEY) / topn_qb.size())) > proto_config.min_a ) {
+                              report_this = REPORT_COMPLEX;
+                              //report_this = COND2;
+                           } //if (det. - cond4)
+                        } //if (det. - cond3)
+                     } //if (det. - cond2)
+                  }
                } //if (det. - cond1)
             }
             /// Report event >>>
             if (report_this){
 
-               if (it->second.identifier == 0){
-                  it->second.identifier = ++unique_id;
+               if (it->data.identifier == 0){
+                  it->data.identifier = ++unique_id;
                }
 
                if (report_this == REPORT_COMPLEX){
-                  ur_set(unirec_out, detection, F_SRC_IP, it->first.src);
-                  ur_set(unirec_out, detection, F_DST_IP, it->first.dst);
-                  ur_set(unirec_out, detection, F_SRC_PORT, config.port);
-                  ur_set(unirec_out, detection, F_RSP_FLOWS, it->second.total_flows[RESPONSE] - it->second.total_flows[R_REPORTED]);
-                  ur_set(unirec_out, detection, F_RSP_PACKETS, it->second.total_packets[RESPONSE] - it->second.total_packets[R_REPORTED]);
-                  ur_set(unirec_out, detection, F_RSP_BYTES, it->second.total_bytes[RESPONSE] - it->second.total_bytes[R_REPORTED]);
-                  ur_set(unirec_out, detection, F_REQ_FLOWS, it->second.total_flows[QUERY] - it->second.total_flows[Q_REPORTED]);
-                  ur_set(unirec_out, detection, F_REQ_PACKETS, it->second.total_packets[QUERY] - it->second.total_packets[Q_REPORTED]);
-                  ur_set(unirec_out, detection, F_REQ_BYTES, it->second.total_bytes[QUERY] - it->second.total_bytes[Q_REPORTED]);
-                  ur_set(unirec_out, detection, F_TIME_FIRST, it->second.first_t);
+                  if (config.aggregate){
+                     // the heaviest reflector represents the attack
+                     vector<reflector_t> top = it->data.reflectors.top();
+                     ur_set(unirec_out, detection, F_SRC_IP, top.empty() ? reflector : top[0].ip);
+                     ur_set(unirec_out, detection, F_ADDR_CNT, it->data.reflectors.count());
+                  } else {
+                     ur_set(unirec_out, detection, F_SRC_IP, it->key.src);
+                  }
+                  ur_set(unirec_out, detection, F_DST_IP, it->key.dst);
+                  ur_set(unirec_out, detection, F_SRC_PORT, proto_config.port);
+                  ur_set(unirec_out, detection, F_RSP_FLOWS, it->data.total_flows[RESPONSE] - it->data.total_flows[R_REPORTED]);
+                  ur_set(unirec_out, detection, F_RSP_PACKETS, it->data.total_packets[RESPONSE] - it->data.total_packets[R_REPORTED]);
+                  ur_set(unirec_out, detection, F_RSP_BYTES, it->data.total_bytes[RESPONSE] - it->data.total_bytes[R_REPORTED]);
+                  ur_set(unirec_out, detection, F_REQ_FLOWS, it->data.total_flows[QUERY] - it->data.total_flows[Q_REPORTED]);
+                  ur_set(unirec_out, detection, F_REQ_PACKETS, it->data.total_packets[QUERY] - it->data.total_packets[Q_REPORTED]);
+                  ur_set(unirec_out, detection, F_REQ_BYTES, it->data.total_bytes[QUERY] - it->data.total_bytes[Q_REPORTED]);
+                  ur_set(unirec_out, detection, F_TIME_FIRST, it->data.first_t);
                   ur_set(unirec_out, detection, F_TIME_LAST, ur_get(unirec_in, data, F_TIME_LAST));
-                  ur_set(unirec_out, detection, F_EVENT_ID, it->second.identifier);
+                  ur_set(unirec_out, detection, F_EVENT_ID, it->data.identifier);
 
                   // send alert
                   ret = trap_send(0, detection, ur_rec_size(unirec_out, detection));
                   TRAP_DEFAULT_SEND_ERROR_HANDLING(ret, ;, break); // continue normally on timeout
                }
 
-               // LOG QUERY/RESPONSE VECTORS
-               size_t pos[2] = {0,0};
-               int shorter;
-               int longer;
-               ur_time_t tmp_t_r = 0;
-               ur_time_t tmp_t_q = 0;
-               ur_time_t sooner_end;
-               ur_time_t later_end;
-               for (vector<flow_item_t>::iterator it_end = it->second.q.begin(); it_end != it->second.q.end(); ++it_end) {
-                  if (it_end->t > tmp_t_q) {
-                     tmp_t_q = it_end->t;
+               // LOG QUERY/RESPONSE VECTORS, the text is formatted by the log writer thread
+               if (event_log != NULL){
+                  vector<reflector_t> top;
+                  log_record_t header;
+                  memset(&header, 0, sizeof(header));
+                  header.key = actual_key;
+                  header.port = (protocols.size() > 1) ? proto_config.port : 0;
+                  header.big = (report_this == REPORT_BIG);
+                  header.aggregate = config.aggregate;
+                  if (config.aggregate){
+                     header.prefix = ip_is4(&actual_key.dst) ? config.victim_prefix4 : config.victim_prefix6;
+                     header.reflectors = it->data.reflectors.count();
+                     top = it->data.reflectors.top();
                   }
-               }
-               for (vector<flow_item_t>::iterator it_end  = it->second.r.begin(); it_end  != it->second.r.end(); ++it_end ) {
-                  if (it_end ->t > tmp_t_r) {
-                     tmp_t_r = it_end ->t;
-                  }
-               }
-
-               if (tmp_t_r < tmp_t_q){
-                  shorter = RESPONSE;
-                  longer = QUERY;
-                  sooner_end = it->second.r.size();
-                  later_end = it->second.q.size();
-               } else {
-                  shorter = QUERY;
-                  longer = RESPONSE;
-                  sooner_end = it->second.q.size();
-                  later_end = it->second.r.size();
-               }
-
-               char addr_buff[INET6_ADDRSTRLEN];
-               if (log_path.compare("") != 0) {
-                  filename.str("");
-                  filename.clear();
-                  filename << log_path;
-                  if (report_this == REPORT_BIG){
-                     filename << "BIG/";
+                  header.top = top.size();
+                  for (vector<flow_slice_t>::iterator sl = it->data.slices.begin(); sl != it->data.slices.end(); ++sl) {
+                     header.slices += (sl->flows[QUERY] != 0) + (sl->flows[RESPONSE] != 0);
                   }
-                  ip_to_str(&actual_key.src, addr_buff);
-                  filename << LOG_FILE_PREFIX << addr_buff;
-                  ip_to_str(&actual_key.dst, addr_buff);
-                  filename << "-" << addr_buff << LOG_FILE_SUFFIX;
-
-                  log.open(filename.str().c_str(), ofstream::app);
-
-                  if (log.is_open()){
-                     ip_to_str(&actual_key.src, addr_buff);
-                     log << "Abused server IP: " << addr_buff;
-                     ip_to_str(&actual_key.dst, addr_buff);
-                     log << "   Target IP: " << addr_buff << "\n";
-                     while (pos[shorter] < sooner_end){
-                        if (it->second.q[pos[QUERY]].t <= it->second.r[pos[RESPONSE]].t) {
-                           time2str(it->second.q[pos[QUERY]].t);
-                           log << time_buff << "\tQ\t" << it->second.q[pos[QUERY]].packets << "\t" << it->second.q[pos[QUERY]].bytes << endl;
-                           ++pos[QUERY];
-                        } else {
-                           time2str(it->second.r[pos[RESPONSE]].t);
-                           log << time_buff << "\tR\t" << it->second.r[pos[RESPONSE]].packets << "\t" << it->second.r[pos[RESPONSE]].bytes << endl;
-                           ++pos[RESPONSE];
-                        }
+                  header.q = it->data.q.size();
+                  header.r = it->data.r.size();
+
+                  size_t size = sizeof(header) + header.top * sizeof(reflector_t) + header.slices * sizeof(log_slice_t) +
+                                (header.q + header.r) * sizeof(flow_item_t);
+                  char *record = (char *) async_log_reserve(event_log, LOG_RECORD, size);
+                  if (record != NULL){
+                     char *pos = record;
+                     memcpy(pos, &header, sizeof(header));
+                     pos += sizeof(header);
+                     if (!top.empty()){
+                        memcpy(pos, &top[0], top.size() * sizeof(reflector_t));
+                        pos += top.size() * sizeof(reflector_t);
                      }
-                     for (pos[longer] = pos[shorter]; pos[longer] < later_end; ++pos[longer]) {
-                        if (longer == QUERY){
-                           time2str(it->second.q[pos[QUERY]].t);
-                           log << time_buff << "\tQ\t" << it->second.q[pos[QUERY]].packets << "\t" << it->second.q[pos[QUERY]].bytes << endl;
-                        } else {
-                           time2str(it->second.r[pos[RESPONSE]].t);
-                           log << time_buff << "\tR\t" << it->second.r[pos[RESPONSE]].packets << "\t" << it->second.r[pos[RESPONSE]].bytes << endl;
+                     for (vector<flow_slice_t>::iterator sl = it->data.slices.begin(); sl != it->data.slices.end(); ++sl) {
+                        for (int dir = QUERY; dir <= RESPONSE; dir++) {
+                           if (sl->flows[dir] == 0) {
+                              continue;
+                           }
+                           log_slice_t slice = {sl->first_t, sl->bytes[dir], sl->packets[dir], sl->flows[dir], (uint8_t) dir};
+                           memcpy(pos, &slice, sizeof(slice));
+                           pos += sizeof(slice);
                         }
                      }
-                     log.close();
-                  } else {
-                     cerr << "Error: Cannot open log file [" << filename.str() << "]." << endl;
+                     if (!it->data.q.empty()){
+                        memcpy(pos, &it->data.q[0], header.q * sizeof(flow_item_t));
+                        pos += header.q * sizeof(flow_item_t);
+                     }
+                     if (!it->data.r.empty()){
+                        memcpy(pos, &it->data.r[0], header.r * sizeof(flow_item_t));
+                     }
+                     async_log_commit(event_log, record);
                   }
                }
             }
             /// Report event <<<
             /// DELETION OF WINDOW
+            if (config.streaming){
+               streamDeleteWindow(it->data, ur_time_get_sec(ur_get(unirec_in, data, F_TIME_LAST)));
+            }
+
             // delete flows from queries
-            for (vector<flow_item_t>::iterator del = it->second.q.begin(); del != it->second.q.end(); ) {
+            for (vector<flow_item_t>::iterator del = it->data.q.begin(); del != it->data.q.end(); ) {
                //F_TIME_LAST is used since F_TIME_FIRST could be occasionally more in past
                if ((ur_time_get_sec(ur_get(unirec_in, data, F_TIME_LAST)) - ur_time_get_sec(del->t)) > (config.det_window - config.del_time)) {
-                  del = it->second.q.erase(del);
-                  it->second.q_rem_pos = 0;
+                  del = it->data.q.erase(del);
+                  it->data.q_rem_pos = 0;
                } else {
                   ++del;
                }
             }
 
             // delete flows from responses
-            for (vector<flow_item_t>::iterator del = it->second.r.begin(); del != it->second.r.end(); ) {
+            for (vector<flow_item_t>::iterator del = it->data.r.begin(); del != it->data.r.end(); ) {
                //F_TIME_LAST is used since F_TIME_FIRST could be occasionally more in past
                if ((ur_time_get_sec(ur_get(unirec_in, data, F_TIME_LAST)) - ur_time_get_sec(del->t)) > (config.det_window - config.del_time)) {
-                  del = it->second.r.erase(del);
-                  it->second.r_rem_pos = 0;
+                  del = it->data.r.erase(del);
+                  it->data.r_rem_pos = 0;
                } else {
                   ++del;
                }
             }
 
-            if (it->second.r.empty() && it->second.q.empty()){
+            if (it->data.r.empty() && it->data.q.empty() && it->data.slices.empty()){
                model.erase(it);
             } else {
                // determine new first time of key was spotted
                ur_time_t min_time = ur_get(unirec_in, data, F_TIME_FIRST);
 
-               it->second.total_bytes[QUERY] = 0;
-               it->second.total_packets[QUERY] = 0;
-               it->second.total_flows[QUERY] = 0;
-               for (vector<flow_item_t>::iterator it_min = it->second.q.begin(); it_min != it->second.q.end(); it_min++) {
-                  it->second.total_bytes[QUERY] += it_min->bytes;
-                  it->second.total_packets[QUERY] += it_min->packets;
-                  it->second.total_flows[QUERY] += 1;
+               it->data.total_bytes[QUERY] = 0;
+               it->data.total_packets[QUERY] = 0;
+               it->data.total_flows[QUERY] = 0;
+               for (vector<flow_item_t>::iterator it_min = it->data.q.begin(); it_min != it->data.q.end(); it_min++) {
+                  it->data.total_bytes[QUERY] += it_min->bytes;
+                  it->data.total_packets[QUERY] += it_min->packets;
+                  it->data.total_flows[QUERY] += 1;
                   if (it_min->t < min_time) {
                      min_time = it_min->t;
                   }
                }
 
-               it->second.total_bytes[RESPONSE] = 0;
-               it->second.total_packets[RESPONSE] = 0;
-               it->second.total_flows[RESPONSE] = 0;
-               for (vector<flow_item_t>::iterator it_min = it->second.r.begin(); it_min != it->second.r.end(); it_min++) {
-                  it->second.total_bytes[RESPONSE] += it_min->bytes;
-                  it->second.total_packets[RESPONSE] += it_min->packets;
-                  it->second.total_flows[RESPONSE] += 1;
+               it->data.total_bytes[RESPONSE] = 0;
+               it->data.total_packets[RESPONSE] = 0;
+               it->data.total_flows[RESPONSE] = 0;
+               for (vector<flow_item_t>::iterator it_min = it->data.r.begin(); it_min != it->data.r.end(); it_min++) {
+                  it->data.total_bytes[RESPONSE] += it_min->bytes;
+                  it->data.total_packets[RESPONSE] += it_min->packets;
+                  it->data.total_flows[RESPONSE] += 1;
                   if (it_min->t < min_time) {
                      min_time = it_min->t;
                   }
                }
 
-               it->second.first_t = min_time;
+               for (vector<flow_slice_t>::iterator s = it->data.slices.begin(); s != it->data.slices.end(); s++) {
+                  for (int dir = QUERY; dir <= RESPONSE; dir++) {
+                     it->data.total_bytes[dir] += s->bytes[dir];
+                     it->data.total_packets[dir] += s->packets[dir];
+                     it->data.total_flows[dir] += s->flows[dir];
+                  }
+                  if (s->first_t < min_time) {
+                     min_time = s->first_t;
+                  }
+               }
+
+               it->data.first_t = min_time;
 
                // store counters for data, which was reported and which is still in history
-               it->second.total_bytes[Q_REPORTED] = it->second.total_bytes[QUERY];
-               it->second.total_packets[Q_REPORTED] = it->second.total_packets[QUERY];
-               it->second.total_flows[Q_REPORTED] = it->second.total_flows[QUERY];
+               it->data.total_bytes[Q_REPORTED] = it->data.total_bytes[QUERY];
+               it->data.total_packets[Q_REPORTED] = it->data.total_packets[QUERY];
+               it->data.total_flows[Q_REPORTED] = it->data.total_flows[QUERY];
 
                // store counters for data, which was reported and which is still in history
-               it->second.total_bytes[R_REPORTED] = it->second.total_bytes[RESPONSE];
-               it->second.total_packets[R_REPORTED] = it->second.total_packets[RESPONSE];
-               it->second.total_flows[R_REPORTED] = it->second.total_flows[RESPONSE];
+               it->data.total_bytes[R_REPORTED] = it->data.total_bytes[RESPONSE];
+               it->data.total_packets[R_REPORTED] = it->data.total_packets[RESPONSE];
+               it->data.total_flows[R_REPORTED] = it->data.total_flows[RESPONSE];
             }
          } //if (time > detection_window)
          /// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<---- Detection ----
@@ -938,7 +1386,11 @@ int main (int argc, char** argv)
             d.total_packets[QUERY] = 0;
             d.total_flows[QUERY] = 0;
 
-            d.r.push_back(i);
+            if (config.streaming){
+               streamAddFlow(d, RESPONSE, i, proto_config.q);
+            } else {
+               d.r.push_back(i);
+            }
          } else {
             d.total_bytes[QUERY] = ur_get(unirec_in, data, F_BYTES);
             d.total_packets[QUERY] = ur_get(unirec_in, data, F_PACKETS);
@@ -947,7 +1399,11 @@ int main (int argc, char** argv)
             d.total_packets[RESPONSE] = 0;
             d.total_flows[RESPONSE] = 0;
 
-            d.q.push_back(i);
+            if (config.streaming){
+               streamAddFlow(d, QUERY, i, proto_config.q);
+            } else {
+               d.q.push_back(i);
+            }
          }
          d.total_bytes[Q_REPORTED] = 0;
          d.total_packets[Q_REPORTED] = 0;
@@ -958,11 +1414,17 @@ int main (int argc, char** argv)
 
 
          // assign key to history model
-         model[actual_key] = d;
+         it = model.insert(actual_key);
+         it->data = d;
+         model.touch(it);
+         if (config.aggregate){
+            it->data.reflectors.insert(reflector, (qr == BOOL_RESPONSE) ? ur_get(unirec_in, data, F_BYTES) : 0);
+         }
       }
 
-      if (delete_inactive_flag){
-         delete_inactive();
+      // delete pairs inactive for detection window
+      for (size_t p = 0; p < protocols.size(); p++) {
+         protocols[p]->model.expire(actual_timestamp);
       }
    }
 
@@ -971,11 +1433,16 @@ int main (int argc, char** argv)
    TRAP_DEFAULT_SEND_ERROR_HANDLING(ret, ;, ;);
 
    // clean up before termination
+   async_log_close(event_log);
+   close_log_files();
    ur_free_template(unirec_in);
    ur_free_template(unirec_out);
    ur_free_record(detection);
+   for (size_t p = 0; p < protocols.size(); p++) {
+      delete protocols[p];
+   }
 
    trap_finalize();
    FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS)
-   return OK;
+   return 0;
 }
@@ -46,7 +46,7 @@
 
 #include <unirec/unirec.h>
 #include <vector>
-#include <map>
+#include "reflector_sketch.h"
 
 #ifndef SIMPLE_AMPLIF_DETECTOR_H
 #define SIMPLE_AMPLIF_DETECTOR_H
@@ -57,6 +57,7 @@ extern "C" {
 
 #define BYTES_MAX    5000  // max bytes of flow checked in q dividing
 #define MINIMAL_RECORD_VECTOR_SIZE    10000
+#define STREAM_SLICES   5     // number of time slices in deletion window (streaming mode)
 
 #define PACKETS      0
 #define BYTES        1
@@ -67,6 +68,9 @@ extern "C" {
 
 #define LOG_FILE_PREFIX ""
 #define LOG_FILE_SUFFIX ".log"
+#define LOG_RECORD   1        // type of records of the log writer (log_record_t and its items)
+#define LOG_OPEN_FILES 64     // maximal number of log files kept opened by the log writer
+#define LOG_CAPACITY (8 << 20) // size of ring of the log writer, one record may take half of it
 
 #define BOOL_QUERY false
 #define BOOL_RESPONSE true
@@ -108,6 +112,11 @@ typedef struct config_s {
    uint32_t det_window;      /** length of detection window */
    int del_time;     /** length of delete window after detection */
    uint32_t max_flow_items;     /** maximal size of vector with query/response records */
+   bool streaming;      /** keep incremental histograms in time slices instead of flow records */
+   uint32_t slice_len;  /** length of time slice in streaming mode */
+   bool aggregate;      /** aggregate all reflectors of victim prefix into one model record */
+   uint8_t victim_prefix4;    /** length of IPv4 victim prefix in aggregation mode */
+   uint8_t victim_prefix6;    /** length of IPv6 victim prefix in aggregation mode */
 
    config_s() {
       port = 53;
@@ -126,6 +135,11 @@ typedef struct config_s {
       det_window = 900;
       del_time = 300;
       max_flow_items = 100000;
+      streaming = false;
+      slice_len = 60;
+      aggregate = false;
+      victim_prefix4 = 32;
+      victim_prefix6 = 128;
    }
 
 } config_t;
@@ -157,6 +171,25 @@ struct flow_item_t {
 };
 
 
+/** Sparse histogram of time slice, pairs of bucket index and count sorted by bucket */
+typedef vector<pair<uint16_t, uint32_t> > slice_histogram_t;
+
+/**
+ * Structure of flows received in one time slice, stored instead of flow items in streaming mode
+ */
+struct flow_slice_t {
+
+   uint64_t id;                  // index of time slice (seconds / slice length)
+   ur_time_t first_t;            // timestamp of first flow in slice
+   uint64_t bytes [2];           // bytes of flows in slice [QUERY/RESPONSE]
+   uint32_t packets [2];         // packets of flows in slice
+   uint32_t flows [2];           // number of flows in slice
+   uint64_t max_bytes [2];       // maximal bytes in one flow
+   uint32_t max_packets [2];     // maximal packets in one flow
+   slice_histogram_t hist [2][2];   // histograms [QUERY/RESPONSE][PACKETS/BYTES]
+};
+
+
 /**
  * Structure of stored flow data in history. For each flow key.
  */
@@ -173,22 +206,61 @@ struct flow_data_t {
    ur_time_t last_t;    // timestamp of last flow - for inactivity detection
    uint32_t identifier;    // unique identifier
    ur_time_t last_logged;     // timestamp of last logged flow
+   vector<flow_slice_t> slices;  // time slices of flows sorted by time (streaming mode)
+   ReflectorSketch reflectors;   // reflectors of victim prefix (aggregation mode)
 };
 
-/** Map storing history model of flows */
-typedef map <flow_key_t, flow_data_t> history_t;
-/** History model iterator */
-typedef history_t::iterator history_iter;
+/**
+ * Header of a log record of an event, it is followed by top reflectors (reflector_t),
+ * time slices (log_slice_t), query and response flows (flow_item_t).
+ * The log writer thread formats the record and appends it to the log file of the event.
+ */
+struct log_record_t {
+
+   flow_key_t key;         // key of the event
+   uint64_t reflectors;    // number of reflectors (aggregation mode)
+   uint32_t top;           // number of top reflectors
+   uint32_t slices;        // number of time slices
+   uint32_t q;             // number of query flows
+   uint32_t r;             // number of response flows
+   uint16_t port;          // port of the protocol in file name, 0 for one protocol
+   uint8_t prefix;         // length of victim prefix (aggregation mode)
+   uint8_t big;            // event is logged to BIG directory
+   uint8_t aggregate;      // key is victim prefix
+};
 
-/** Map storing histogram */
-typedef map<unsigned int, unsigned int> histogram_t;
-/** Histogram iterator */
-typedef histogram_t::iterator histogram_iter;
+/**
+ * Time slice of one direction in a log record (streaming mode)
+ */
+struct log_slice_t {
+
+   ur_time_t first_t;   // timestamp of first flow in slice
+   uint64_t bytes;      // bytes of flows in slice
+   uint32_t packets;    // packets of flows in slice
+   uint32_t flows;      // number of flows in slice
+   uint8_t dir;         // QUERY/RESPONSE
+};
+
+/**
+ * Closes log files opened by the log writer, called after the log is closed.
+ */
+void close_log_files();
+
+/**
+ * Histogram with fixed buckets of width q. Bucket i counts values in [i*q, (i+1)*q),
+ * its key is the upper bound (i+1)*q. Values over BYTES_MAX are counted in the last bucket.
+ */
+struct histogram_t {
+
+   vector<uint32_t> counts;   // count of values in buckets
+   uint32_t total;            // count of all values
+   uint32_t q;                // width of bucket
+};
 
-/** Map storing normalized histogram */
-typedef map<unsigned int, float> histogram_norm_t;
-/** Normalized histogram iterator */
-typedef histogram_norm_t::iterator histogram_norm_iter;
+/** TopN buckets of histogram, pairs of bucket key and count */
+typedef vector<pair<unsigned int, unsigned int> > topn_t;
+/** TopN iterator */
+typedef topn_t::const_iterator topn_iter;
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,111 @@
+/**
+ * \file histogram_bench.cpp
+ * \brief Micro-benchmark of createHistogram() of amplification_detection (make bench).
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+/*
+ * The histograms use the configuration of the module, so its translation
+ * unit is included with main() renamed.
+ */
+#define main amplification_detection_main
+#include "amplification_detection.cpp"
+#undef main
+
+#include "bench.h"
+
+#define FLOW_CNT 100000
+#define DETECTION_ROUNDS 64
+
+/**
+ * Flows of one key over the detection window, small queries and large
+ * responses as in an amplification attack
+ */
+static void fill_flows(flow_data_t &d)
+{
+   uint32_t seconds = config.det_window;
+
+   for (uint32_t i = 0; i < FLOW_CNT; i++) {
+      flow_item_t item;
+      int direction = (bench_rand() % 2) ? QUERY : RESPONSE;
+
+      item.t = ur_time_from_sec_msec(i / (FLOW_CNT / seconds + 1), 0);
+      item.packets = 1 + bench_rand() % 4;
+      item.bytes = item.packets * ((direction == QUERY) ? 60 + bench_rand() % 40 : 400 + bench_rand() % 1100);
+      if (config.streaming) {
+         streamAddFlow(d, direction, item, config.q);
+      } else if (direction == QUERY) {
+         d.q.push_back(item);
+      } else {
+         d.r.push_back(item);
+      }
+   }
+}
+
+static void bench_histogram(bool streaming)
+{
+   flow_data_t d;
+   histogram_t hvqb, hvqp, hvrb, hvrp;
+   volatile uint32_t sink = 0;
+
+   config.streaming = streaming;
+   config.slice_len = config.del_time / STREAM_SLICES;
+   fill_flows(d);
+
+   // Detection of the key creates four histograms, their buffers are reused
+   double start = bench_now_ns();
+   unsigned long start_allocations = bench_allocations();
+   for (int r = 0; r < DETECTION_ROUNDS; r++) {
+      createHistogram(d, BYTES, QUERY, hvqb, config.q);
+      createHistogram(d, PACKETS, QUERY, hvqp, config.q);
+      createHistogram(d, BYTES, RESPONSE, hvrb, config.q);
+      createHistogram(d, PACKETS, RESPONSE, hvrp, config.q);
+      sink += hvqb.total + hvrp.total;
+   }
+   bench_report(streaming ? "createHistogram (streaming)" : "createHistogram (vectors)",
+                DETECTION_ROUNDS * 4, start, start_allocations);
+   (void) sink;
+}
+
+int main()
+{
+   bench_histogram(false);
+   bench_histogram(true);
+   return 0;
+}
@@ -0,0 +1,261 @@
+/**
+ * \file history_table.cpp
+ * \brief Hash table of history model with expiry of inactive pairs
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cstring>
+#include "history_table.h"
+
+HistoryTable::HistoryTable() : count(0), mask(0), wheel_mask(0), timeout(0), swept(0) {
+
+   slots.assign(INITIAL_CAPACITY, NULL);
+   mask = INITIAL_CAPACITY - 1;
+   init(0);
+}
+
+HistoryTable::~HistoryTable() {
+
+   for (size_t i = 0; i < slots.size(); i++) {
+      delete slots[i];
+   }
+}
+
+/**
+ * Sets inactivity timeout, has to be called before any entry is inserted
+ *
+ * @param timeout entries with last_t older than timeout are expired
+ */
+void HistoryTable::init(uint32_t timeout) {
+
+   size_t size = 64;
+   while (size < (size_t) timeout + 2) {
+      size *= 2;
+   }
+
+   this->timeout = timeout;
+   wheel.assign(size, NULL);
+   wheel_mask = size - 1;
+}
+
+/**
+ * Hash of the key (both addresses)
+ */
+uint64_t HistoryTable::hash(const flow_key_t &key) {
+
+   uint64_t h = key.src.ui64[0] * 0x9E3779B97F4A7C15ULL ^ key.src.ui64[1];
+   h = (h ^ key.dst.ui64[0]) * 0xFF51AFD7ED558CCDULL ^ key.dst.ui64[1];
+   h ^= h >> 33;
+   h *= 0xC4CEB9FE1A85EC53ULL;
+   h ^= h >> 33;
+   return h;
+}
+
+/**
+ * Finds slot of the key or empty slot where the key belongs
+ */
+size_t HistoryTable::position(const flow_key_t &key) const {
+
+   size_t i = hash(key) & mask;
+   while (slots[i] != NULL && memcmp(&slots[i]->key, &key, sizeof(flow_key_t)) != 0) {
+      i = (i + 1) & mask;
+   }
+   return i;
+}
+
+void HistoryTable::resize(size_t capacity) {
+
+   vector<history_entry_t *> old;
+   old.swap(slots);
+   slots.assign(capacity, NULL);
+   mask = capacity - 1;
+
+   for (size_t i = 0; i < old.size(); i++) {
+      if (old[i] != NULL) {
+         slots[position(old[i]->key)] = old[i];
+      }
+   }
+}
+
+/**
+ * Finds entry of the key
+ *
+ * @param key key
+ * @return entry or NULL if the key is not in the table
+ */
+history_entry_t *HistoryTable::find(const flow_key_t &key) const {
+
+   return slots[position(key)];
+}
+
+/**
+ * Creates entry of the key with empty flow data, the key must not be in the table.
+ * The entry should be touched when its flow data is filled.
+ *
+ * @param key key
+ * @return new entry
+ */
+history_entry_t *HistoryTable::insert(const flow_key_t &key) {
+
+   if ((count + 1) * 4 > slots.size() * 3) {
+      resize(slots.size() * 2);
+   }
+
+   history_entry_t *entry = new history_entry_t();
+   entry->key = key;
+
+   slots[position(key)] = entry;
+   count++;
+
+   link(entry, swept + 1);
+   return entry;
+}
+
+void HistoryTable::link(history_entry_t *entry, uint64_t sec) {
+
+   if (sec <= swept) {
+      // second was already expired, check the entry with the next one
+      sec = swept + 1;
+   }
+
+   history_entry_t *&head = wheel[sec & wheel_mask];
+   entry->expire_sec = sec;
+   entry->expire_prev = NULL;
+   entry->expire_next = head;
+   if (head != NULL) {
+      head->expire_prev = entry;
+   }
+   head = entry;
+}
+
+void HistoryTable::unlink(history_entry_t *entry) {
+
+   if (entry->expire_prev != NULL) {
+      entry->expire_prev->expire_next = entry->expire_next;
+   } else {
+      wheel[entry->expire_sec & wheel_mask] = entry->expire_next;
+   }
+   if (entry->expire_next != NULL) {
+      entry->expire_next->expire_prev = entry->expire_prev;
+   }
+}
+
+/**
+ * Moves entry in expiry wheel according to its last_t, called when last_t changes
+ *
+ * @param entry entry
+ */
+void HistoryTable::touch(history_entry_t *entry) {
+
+   uint64_t sec = ur_time_get_sec(entry->data.last_t);
+   if (sec == entry->expire_sec || (sec <= swept && entry->expire_sec == swept + 1)) {
+      return;
+   }
+
+   unlink(entry);
+   link(entry, sec);
+}
+
+/**
+ * Removes entry from the hash table, following entries of the cluster are shifted back
+ */
+void HistoryTable::remove(history_entry_t *entry) {
+
+   size_t hole = position(entry->key);
+
+   for (size_t j = (hole + 1) & mask; slots[j] != NULL; j = (j + 1) & mask) {
+      size_t home = hash(slots[j]->key) & mask;
+      if (((j - home) & mask) >= ((j - hole) & mask)) {
+         slots[hole] = slots[j];
+         hole = j;
+      }
+   }
+   slots[hole] = NULL;
+   count--;
+}
+
+/**
+ * Deletes entry
+ *
+ * @param entry entry
+ */
+void HistoryTable::erase(history_entry_t *entry) {
+
+   unlink(entry);
+   remove(entry);
+   delete entry;
+}
+
+/**
+ * Deletes entries inactive for more than timeout, visits only slots of seconds
+ * passed since the last call
+ *
+ * @param now actual time in seconds
+ * @return number of deleted entries
+ */
+size_t HistoryTable::expire(uint64_t now) {
+
+   if (now <= (uint64_t) timeout + 1 || now - timeout - 1 <= swept) {
+      return 0;
+   }
+
+   // entries with last_t up to limit are inactive
+   uint64_t limit = now - timeout - 1;
+   uint64_t steps = limit - swept;
+   if (steps > wheel.size()) {
+      steps = wheel.size();
+   }
+
+   size_t deleted = 0;
+   for (uint64_t i = 1; i <= steps; i++) {
+      history_entry_t *entry = wheel[(swept + i) & wheel_mask];
+      while (entry != NULL) {
+         history_entry_t *next = entry->expire_next;
+         if (entry->expire_sec <= limit) {
+            erase(entry);
+            deleted++;
+         }
+         entry = next;
+      }
+   }
+
+   swept = limit;
+   return deleted;
+}
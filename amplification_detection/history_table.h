@@ -0,0 +1,108 @@
+/**
+ * \file history_table.h
+ * \brief Hash table of history model with expiry of inactive pairs
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef AMPLIFICATION_HISTORY_TABLE_H
+#define AMPLIFICATION_HISTORY_TABLE_H
+
+#include <vector>
+#include "amplification_detection.h"
+
+/**
+ * Record of history model - key, its flow data and position in expiry wheel
+ */
+struct history_entry_t {
+
+   flow_key_t key;      // key of flow data
+   flow_data_t data;    // flow data of key
+   uint64_t expire_sec;    // second the entry is scheduled to in expiry wheel
+   history_entry_t *expire_prev;    // previous entry in slot of expiry wheel
+   history_entry_t *expire_next;    // next entry in slot of expiry wheel
+};
+
+/**
+ * History model of flows - hash table with linear probing owning its entries.
+ *
+ * Entries are also kept in a wheel of one second slots by their last_t, so
+ * inactive entries are found without walking the whole table. The wheel
+ * is longer than the timeout, so each slot holds entries of one second only.
+ */
+class HistoryTable {
+
+public:
+   HistoryTable();
+   ~HistoryTable();
+
+   void init(uint32_t timeout);
+
+   history_entry_t *find(const flow_key_t &key) const;
+   history_entry_t *insert(const flow_key_t &key);
+   void erase(history_entry_t *entry);
+   void touch(history_entry_t *entry);
+   size_t expire(uint64_t now);
+
+   inline size_t size() const { return count; }
+
+private:
+   static const size_t INITIAL_CAPACITY = 1024;
+
+   vector<history_entry_t *> slots;      // hash table, NULL in empty slots
+   size_t count;        // number of entries
+   size_t mask;         // mask of hash table index
+
+   vector<history_entry_t *> wheel;      // expiry wheel, heads of slot lists
+   size_t wheel_mask;   // mask of wheel index
+   uint32_t timeout;    // inactivity timeout in seconds
+   uint64_t swept;      // all seconds up to this one were expired
+
+   static uint64_t hash(const flow_key_t &key);
+   size_t position(const flow_key_t &key) const;
+   void resize(size_t capacity);
+   void link(history_entry_t *entry, uint64_t sec);
+   void unlink(history_entry_t *entry);
+   void remove(history_entry_t *entry);
+
+   HistoryTable(const HistoryTable &);
+   HistoryTable &operator=(const HistoryTable &);
+};
+
+#endif
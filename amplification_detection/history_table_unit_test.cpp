@@ -0,0 +1,205 @@
+/**
+ * \file history_table_unit_test.cpp
+ * \brief Unit test of history table, expiry of pairs is compared with a brute-force map
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include "history_table.h"
+
+static int fail_counter = 0;
+
+#define CHECK(cond, msg) { if (!(cond)) { fprintf(stderr, "FAIL: %s\n", msg); fail_counter++; } }
+
+#define TIMEOUT 60
+#define KEYS 2000
+#define OPERATIONS 300000
+
+/**
+ * Brute-force model of expiry: every pair keeps the second it expires after,
+ * which is its last second, or the second after the last expired one if the
+ * pair was already out of the window
+ */
+struct model_t {
+
+   map<flow_key_t, uint64_t> pairs;
+   uint64_t swept;
+
+   model_t() : swept(0) {}
+
+   void touch(const flow_key_t &key, uint64_t sec) {
+      pairs[key] = (sec > swept) ? sec : swept + 1;
+   }
+
+   size_t expire(uint64_t now) {
+      if (now <= (uint64_t) TIMEOUT + 1 || now - TIMEOUT - 1 <= swept) {
+         return 0;
+      }
+      swept = now - TIMEOUT - 1;
+
+      size_t deleted = 0;
+      for (map<flow_key_t, uint64_t>::iterator it = pairs.begin(); it != pairs.end(); ) {
+         if (it->second <= swept) {
+            pairs.erase(it++);
+            deleted++;
+         } else {
+            ++it;
+         }
+      }
+      return deleted;
+   }
+};
+
+static flow_key_t make_key(uint32_t i) {
+
+   flow_key_t key;
+   memset(&key, 0, sizeof(key));
+   key.src = ip_from_int(0x0A000000 | (i % 97));
+   key.dst = ip_from_int(0xC0A80000 | i);
+   return key;
+}
+
+/** Random flows of the key pool, some of them already out of the window */
+static void test_against_model() {
+
+   HistoryTable table;
+   model_t model;
+   uint64_t now = 1455131180;
+   bool same = true, counts = true, keys = true;
+
+   table.init(TIMEOUT);
+   srand(1);
+
+   for (int op = 0; op < OPERATIONS; op++) {
+      flow_key_t key = make_key(rand() % KEYS);
+      uint64_t sec = now - rand() % (TIMEOUT + 20);
+      ur_time_t last_t = ur_time_from_sec_msec(sec, rand() % 1000);
+
+      if (rand() % 1000 == 0) {
+         now += rand() % (4 * TIMEOUT); // gap in traffic
+      } else if (rand() % 50 == 0) {
+         now++;
+      }
+
+      history_entry_t *it = table.find(key);
+      if ((it != NULL) != (model.pairs.count(key) != 0)) {
+         same = false;
+      }
+
+      if (it == NULL) {
+         it = table.insert(key);
+         it->data.last_t = last_t;
+         table.touch(it);
+         model.touch(key, sec);
+      } else if (rand() % 20 == 0) {
+         table.erase(it);
+         model.pairs.erase(key);
+      } else if (it->data.last_t < last_t) {
+         it->data.last_t = last_t;
+         table.touch(it);
+         model.touch(key, sec);
+      }
+
+      if (table.expire(now) != model.expire(now)) {
+         counts = false;
+      }
+      if (table.size() != model.pairs.size()) {
+         counts = false;
+      }
+   }
+
+   for (map<flow_key_t, uint64_t>::iterator m = model.pairs.begin(); m != model.pairs.end(); ++m) {
+      history_entry_t *it = table.find(m->first);
+      if (it == NULL || memcmp(&it->key, &m->first, sizeof(flow_key_t)) != 0) {
+         keys = false;
+      }
+   }
+
+   CHECK(same, "pairs in table are pairs of model");
+   CHECK(counts, "expired and kept pairs counted as in model");
+   CHECK(keys, "pairs of model found with their keys");
+}
+
+/** Pair idle for longer than timeout is expired, active one is kept */
+static void test_timeout() {
+
+   HistoryTable table;
+   uint64_t start = 1455131180;
+   flow_key_t idle = make_key(1), active = make_key(2);
+   bool kept = true;
+
+   table.init(TIMEOUT);
+   history_entry_t *it = table.insert(idle);
+   it->data.last_t = ur_time_from_sec_msec(start, 0);
+   table.touch(it);
+
+   for (uint64_t now = start; now <= start + TIMEOUT + 1; now++) {
+      it = table.find(active);
+      if (it == NULL) {
+         it = table.insert(active);
+      }
+      it->data.last_t = ur_time_from_sec_msec(now, 0);
+      table.touch(it);
+      table.expire(now);
+      if (now <= start + TIMEOUT && table.find(idle) == NULL) {
+         kept = false;
+      }
+   }
+
+   CHECK(kept, "pair kept within timeout");
+   CHECK(table.find(idle) == NULL, "idle pair expired");
+   CHECK(table.find(active) != NULL, "active pair kept");
+   CHECK(table.size() == 1, "size after expiry");
+}
+
+int main() {
+
+   test_timeout();
+   test_against_model();
+
+   if (fail_counter > 0) {
+      fprintf(stderr, "%d checks failed\n", fail_counter);
+      return 1;
+   }
+   return 0;
+}
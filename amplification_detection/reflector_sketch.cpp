@@ -0,0 +1,129 @@
+/**
+ * \file reflector_sketch.cpp
+ * \brief Compact sketch of reflectors used against one victim
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "reflector_sketch.h"
+
+/**
+ * Adds flow of reflector
+ *
+ * @param ip address of reflector
+ * @param bytes response bytes of flow, 0 only counts the reflector
+ */
+void ReflectorSketch::insert(const ip_addr_t &ip, uint64_t bytes) {
+
+   if (registers.empty()) {
+      registers.assign(1 << RS_HLL_BITS, 0);
+      heavy.reserve(RS_TOP);
+   }
+
+   hll_t hll = hll_view(registers.data(), RS_HLL_BITS, 8);
+   hll_add(&hll, hll_hash(&ip, sizeof(ip)), NULL);
+
+   if (bytes == 0) {
+      return;
+   }
+
+   size_t min = 0;
+   for (size_t i = 0; i < heavy.size(); i++) {
+      if (memcmp(&heavy[i].ip, &ip, sizeof(ip_addr_t)) == 0) {
+         heavy[i].bytes += bytes;
+         return;
+      }
+      if (heavy[i].bytes < heavy[min].bytes) {
+         min = i;
+      }
+   }
+
+   if (heavy.size() < RS_TOP) {
+      reflector_t r;
+      r.ip = ip;
+      r.bytes = bytes;
+      r.error = 0;
+      heavy.push_back(r);
+   } else {
+      // replace the smallest counter, new reflector inherits its count as error
+      heavy[min].ip = ip;
+      heavy[min].error = heavy[min].bytes;
+      heavy[min].bytes += bytes;
+   }
+}
+
+/**
+ * Estimates number of distinct reflectors
+ *
+ * @return number of reflectors
+ */
+uint32_t ReflectorSketch::count() const {
+
+   if (registers.empty()) {
+      return 0;
+   }
+
+   hll_t hll = hll_view(const_cast<uint8_t *>(registers.data()), RS_HLL_BITS, 8);
+   return hll_estimate(&hll);
+}
+
+static bool more_bytes(const reflector_t &a, const reflector_t &b) {
+
+   return a.bytes > b.bytes;
+}
+
+/**
+ * Returns reflectors with the most response bytes
+ *
+ * @return reflectors sorted by bytes, the heaviest first
+ */
+vector<reflector_t> ReflectorSketch::top() const {
+
+   vector<reflector_t> sorted(heavy);
+   sort(sorted.begin(), sorted.end(), more_bytes);
+   return sorted;
+}
+
+void ReflectorSketch::clear() {
+
+   vector<uint8_t>().swap(registers);
+   vector<reflector_t>().swap(heavy);
+}
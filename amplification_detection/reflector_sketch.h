@@ -0,0 +1,89 @@
+/**
+ * \file reflector_sketch.h
+ * \brief Compact sketch of reflectors used against one victim
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef AMPLIFICATION_REFLECTOR_SKETCH_H
+#define AMPLIFICATION_REFLECTOR_SKETCH_H
+
+#include <unirec/unirec.h>
+#include <vector>
+#include "hll.h"
+
+using namespace std;
+
+/**
+ * Reflector counted in the top list of sketch
+ */
+struct reflector_t {
+
+   ip_addr_t ip;     // address of reflector
+   uint64_t bytes;   // response bytes, overestimated by at most error
+   uint64_t error;   // maximal overestimation of bytes
+};
+
+/**
+ * Sketch of reflectors (abused servers) sending responses to one victim.
+ *
+ * Distinct reflectors are counted by HyperLogLog (common hll) with 2^RS_HLL_BITS registers
+ * (standard error about 6.5 %), reflectors with the most response bytes are kept
+ * by Space-Saving algorithm in RS_TOP counters. Memory is allocated with
+ * the first reflector, so unused sketch costs only its empty vectors.
+ */
+class ReflectorSketch {
+
+public:
+   void insert(const ip_addr_t &ip, uint64_t bytes);
+   uint32_t count() const;
+   vector<reflector_t> top() const;
+   void clear();
+
+   inline bool empty() const { return registers.empty(); }
+
+private:
+   static const int RS_HLL_BITS = 8;
+   static const size_t RS_TOP = 8;
+
+   vector<uint8_t> registers;       // HyperLogLog registers
+   vector<reflector_t> heavy;       // Space-Saving counters
+};
+
+#endif
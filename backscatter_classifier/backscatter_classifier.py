@@ -8,7 +8,14 @@ from socket import gethostbyaddr, herror
 from datetime import datetime, timezone, timedelta
 from ipaddress import IPv4Address, IPv4Network
 import os
+import time
 from contextlib import contextmanager
+from collections import OrderedDict
+from concurrent.futures import ThreadPoolExecutor, TimeoutError as FutureTimeout
+from functools import lru_cache
+from queue import Queue, Full
+from threading import Thread, Lock
+from types import SimpleNamespace
 
 from pymisp import ExpandedPyMISP, MISPEvent, MISPObject
 import pytrap
@@ -36,6 +43,8 @@ MISP_ANALYSIS_COMPLETE = 2
 MISP_THREAT = 2
 # MISP distribution community
 MISP_DIST = 1
+# Fields of the feature vector needed to create the event after classification
+EVENT_FIELDS = ("PROTOCOL", "SRC_PORT_1", "POSIX_START", "POSIX_END", "BYTES", "FLOW_COUNT", "PACKET_COUNT")
 # Derive local timezone
 LOCAL_TIMEZONE = datetime.now(timezone(timedelta(0))).astimezone().tzinfo
 
@@ -90,11 +99,23 @@ class DDoSClassifier:
             raise RuntimeError("Incorrect threshold value")
         self.threshold = threshold
 
+    def get_model(self, protocol):
+        """
+        :param protocol: Protocol of the feature vector
+        :return: Tuple of features, scaler and model for the protocol
+        """
+        if protocol == TCP:
+            return self.model.tcp_features, self.model.tcp_scaler, self.model.tcp_model
+        elif protocol == ICMP:
+            return self.model.icmp_features, self.model.icmp_scaler, self.model.icmp_model
+        else:
+            raise ProtocolNotSupported("Protocol with number {d} is not supported".format(d=protocol))
+
     def get_feature_vector(self, f_list, rec: pytrap.UnirecTemplate):
         """
         :param f_list: List of tuples (feature name, type of feature - primary/derived)
         :param rec: Basic feature vector
-        :return: Complete feature vector with derived features
+        :return: Complete feature vector with derived features (one row of the matrix of a batch)
         """
         feature_vector = []
         for f, t in f_list:
@@ -108,7 +129,18 @@ class DDoSClassifier:
             except AttributeError:
                 raise MissingFeatureAttribute("Feature {f} is not supported, incompatible models".format(f=f))
             feature_vector.append(feature)
-        return np.array([feature_vector])
+        return feature_vector
+
+    def predict_batch(self, protocol, feature_vectors):
+        """
+        Predict classes of feature vectors of one protocol by a single call of the model
+        :param protocol: Protocol of all feature vectors
+        :param feature_vectors: List of feature vectors from get_feature_vector
+        :return: Array of booleans, True if vector is predicted to come from DDoS attack (backscatter)
+        """
+        _, scaler, model = self.get_model(protocol)
+        matrix = scaler.transform(np.array(feature_vectors))
+        return model.predict_proba(matrix)[:, self.model.DDOS_CLASS] > self.threshold
 
     def predict(self, rec: pytrap.UnirecTemplate):
         """
@@ -116,17 +148,8 @@ class DDoSClassifier:
         :param rec: Basic feature vector derived from backscatter like flows
         :return: True if vector is predicted to come from DDoS attack (backscatter)
         """
-        # Choose right model and predict class of feature vector
-        if rec.PROTOCOL == TCP:
-            feature_vector = self.get_feature_vector(self.model.tcp_features, rec)
-            feature_vector = self.model.tcp_scaler.transform(feature_vector)
-            return self.model.tcp_model.predict_proba(feature_vector)[:, self.model.DDOS_CLASS][0] > self.threshold
-        elif rec.PROTOCOL == ICMP:
-            feature_vector = self.get_feature_vector(self.model.icmp_features, rec)
-            feature_vector = self.model.icmp_scaler.transform(feature_vector)
-            return self.model.icmp_model.predict_proba(feature_vector)[:, self.model.DDOS_CLASS][0] > self.threshold
-        else:
-            raise ProtocolNotSupported("Protocol with number {d} is not supported".format(d=rec.PROTOCOL))
+        features, _, _ = self.get_model(rec.PROTOCOL)
+        return self.predict_batch(rec.PROTOCOL, [self.get_feature_vector(features, rec)])[0]
 
     # DERIVED FEATURES
 
@@ -191,13 +214,18 @@ class Geoip2Wrapper:
     Wrapper for geoip city and ASN databases
     """
 
-    def __init__(self, asn_db_path, city_db_path):
+    def __init__(self, asn_db_path, city_db_path, cache_size=0):
         """
         :param asn_db_path: Local ASN database file
         :param city_db_path: Local city database file
+        :param cache_size: Number of IP addresses with cached results (0 disables caching)
         """
         self.asn_db = geoip2.database.Reader(asn_db_path)
         self.city_db = geoip2.database.Reader(city_db_path)
+        if cache_size > 0:
+            # Victims of a backscatter wave are reported repeatedly
+            self.get_asn = lru_cache(maxsize=cache_size)(self.get_asn)
+            self.get_city = lru_cache(maxsize=cache_size)(self.get_city)
 
     def get_asn(self, ip):
         """
@@ -222,6 +250,190 @@ class Geoip2Wrapper:
             return None
 
 
+class EventBatch:
+    """
+    Feature vectors waiting for classification, accumulated into one matrix per protocol
+    """
+
+    def __init__(self, classifier: DDoSClassifier, size):
+        """
+        :param classifier: Classifier of the batches
+        :param size: Number of feature vectors classified together
+        """
+        self.classifier = classifier
+        self.size = size
+        self.vectors = {TCP: [], ICMP: []}
+        self.events = {TCP: [], ICMP: []}
+        self.count = 0
+        self.first = None
+
+    def add(self, rec: pytrap.UnirecTemplate, victim_ip):
+        """
+        Add feature vector of the event
+        :param rec: Basic feature vector
+        :param victim_ip: Victim IP address
+        """
+        features, _, _ = self.classifier.get_model(rec.PROTOCOL)
+        vector = self.classifier.get_feature_vector(features, rec)
+        # The record is reused by the next received data, keep the fields of the event
+        event = SimpleNamespace(**{f: getattr(rec, f, None) for f in EVENT_FIELDS})
+        self.vectors[rec.PROTOCOL].append(vector)
+        self.events[rec.PROTOCOL].append((event, victim_ip))
+        if self.count == 0:
+            self.first = time.monotonic()
+        self.count += 1
+
+    def full(self):
+        return self.count >= self.size
+
+    def expired(self, timeout):
+        """
+        :param timeout: The longest time in seconds a feature vector waits for classification
+        :return: True if the oldest feature vector has waited for timeout
+        """
+        return self.count > 0 and time.monotonic() - self.first >= timeout
+
+    def classify(self, logger):
+        """
+        Classify all feature vectors and empty the batch
+        :param logger: Logger of the module
+        :return: List of tuples (event, victim IP) predicted to be DDoS attacks
+        """
+        ddos = []
+        for protocol in self.vectors:
+            vectors = self.vectors[protocol]
+            if not vectors:
+                continue
+            try:
+                predictions = self.classifier.predict_batch(protocol, vectors)
+                ddos.extend(event for event, prediction in zip(self.events[protocol], predictions) if prediction)
+            except Exception as e:
+                logger.error(e)
+            self.vectors[protocol] = []
+            self.events[protocol] = []
+        self.count = 0
+        self.first = None
+        return ddos
+
+
+class Reporter(Thread):
+    """
+    Reverse DNS lookups, creation of MISP events and their export out of the classification thread
+    """
+
+    def __init__(self, args, geoip_db, misp_instance, logger):
+        """
+        :param args: Arguments of the module
+        :param geoip_db: Geoip database wrapper
+        :param misp_instance: MISP instance (None if events are exported to C3ISP only)
+        :param logger: Logger of the module
+        """
+        Thread.__init__(self, name="reporter")
+        self.args = args
+        self.geoip_db = geoip_db
+        self.misp_instance = misp_instance
+        self.logger = logger
+        self.queue = Queue(maxsize=args.report_queue)
+        self.dns_pool = ThreadPoolExecutor(max_workers=args.dns_workers, thread_name_prefix="dns")
+        self.dns_cache = OrderedDict()
+        self.dns_lock = Lock()
+
+    def resolve(self, ip):
+        """
+        Reverse DNS lookup with LRU cache, run by the DNS pool
+        :param ip: IP address
+        :return: Domain or None if the address has none
+        """
+        with self.dns_lock:
+            if ip in self.dns_cache:
+                self.dns_cache.move_to_end(ip)
+                return self.dns_cache[ip]
+        try:
+            domain = gethostbyaddr(ip)[0]
+        except herror:
+            domain = None
+        with self.dns_lock:
+            self.dns_cache[ip] = domain
+            if len(self.dns_cache) > self.args.cache_size:
+                self.dns_cache.popitem(last=False)
+        return domain
+
+    def submit(self, rec, victim_ip):
+        """
+        Start reverse DNS lookup of the victim and queue the event for reporting
+        :param rec: Fields of the feature vector of the event
+        :param victim_ip: Victim IP address
+        """
+        domain = self.dns_pool.submit(self.resolve, str(victim_ip))
+        try:
+            self.queue.put_nowait((rec, victim_ip, domain, time.monotonic() + self.args.dns_timeout))
+        except Full:
+            self.logger.error("Queue of reported events is full, event for {ip} dropped".format(ip=victim_ip))
+
+    def stop(self):
+        """
+        Report all queued events and stop the thread
+        """
+        self.queue.put(None)
+        self.join()
+        self.dns_pool.shutdown()
+
+    def run(self):
+        while True:
+            item = self.queue.get()
+            if item is None:
+                break
+            rec, victim_ip, domain, deadline = item
+            try:
+                domain = domain.result(timeout=max(0, deadline - time.monotonic()))
+            except FutureTimeout:
+                self.logger.info("Reverse DNS lookup of {ip} timed out, skipping".format(ip=victim_ip))
+                continue
+            except Exception as e:
+                # e.g. socket.gaierror of the lookup, the thread must keep reporting the next events
+                self.logger.error("Reverse DNS lookup of {ip} failed: {err}".format(ip=victim_ip, err=e))
+                continue
+            if domain is None:
+                # Do not report for unknown domains
+                continue
+            try:
+                self.report(rec, victim_ip, domain)
+            except Exception as e:
+                self.logger.error(str(e))
+
+    def report(self, rec, victim_ip, domain):
+        """
+        Create MISP event and export it
+        :param rec: Fields of the feature vector of the event
+        :param victim_ip: Victim IP address
+        :param domain: Domain of the victim
+        """
+        args = self.args
+        logger = self.logger
+        event = create_ddos_event(rec, self.geoip_db, victim_ip, domain, args.misp_templates_dir)
+        if args.export_to == "misp":
+            try:
+                event_id = self.misp_instance.add_event(event)['Event']['id']
+                self.misp_instance.publish(event_id)
+            except Exception as e:
+                logger.error(e)
+        elif args.export_to in ("c3isp", "c3isp-misp"):
+            logger.debug(f"Uploading event to C3ISP platform.")
+            event_file_path = Path("misp_event_to_c3isp.json").absolute()
+            with temporary_open(event_file_path, 'w') as event_file:
+                json.dump(event.to_json(), event_file)
+                response = c3isp_upload.upload_to_c3isp(event_file_path)
+                logger.debug(f"Response: {response}")
+
+            if not response or ('status' in response and response['status'] == 'ERROR'):
+                logger.error("ERROR during upload!")
+                return
+            if args.export_to == "c3isp-misp":
+                dpo_id = response['content']['additionalProperties']['dposId']
+                logger.debug(f'Exporting DPO {dpo_id} to MISP.')
+                c3isp_upload.export_misp(dpo_id, logger)
+
+
 def create_ddos_event(rec: pytrap.UnirecTemplate, geoip_db, victim_ip, domain, misp_templates_dir):
     """
     Create MISP event describing attack
@@ -328,6 +540,17 @@ def process_arguments():
                                           "and 'c3isp-misp' to export to both C3ISP and MISP.",
                         default="misp", type=str, choices=["misp", "c3isp", "c3isp-misp"], required=True)
     parser.add_argument('--c3isp_config', help="Configuration file of C3ISP uploader.", default='servers.ini', type=str)
+    parser.add_argument('--batch_size', help="Number of feature vectors classified together.", default=256, type=int)
+    parser.add_argument('--batch_timeout', help="Maximum time in seconds a feature vector waits for classification.",
+                        default=1.0, type=float)
+    parser.add_argument('--dns_timeout', help="Timeout of reverse DNS lookup of a victim in seconds, events of "
+                                              "victims without domain in time are not reported.",
+                        default=5.0, type=float)
+    parser.add_argument('--dns_workers', help="Number of threads doing reverse DNS lookups.", default=8, type=int)
+    parser.add_argument('--cache_size', help="Number of IP addresses with cached GeoIP and reverse DNS results.",
+                        default=65536, type=int)
+    parser.add_argument('--report_queue', help="Maximum number of detected events waiting for reporting.",
+                        default=10000, type=int)
     return parser.parse_known_args()
 
 
@@ -358,7 +581,7 @@ def main():
 
     # ASN and city databases
     try:
-        geoip_db = Geoip2Wrapper(args.agp, args.cgp)
+        geoip_db = Geoip2Wrapper(args.agp, args.cgp, args.cache_size)
     except Exception as e:
         logger.error(e)
         logger.error("Error while create GeoIP2 wrapper")
@@ -368,6 +591,7 @@ def main():
     if args.export_to in ("c3isp", "c3isp-misp"):
         c3isp_upload.read_config(args.c3isp_config)
 
+    misp_instance = None
     if args.export_to == "misp":
         # MISP instance
         try:
@@ -381,6 +605,14 @@ def main():
     # DDoS model
     ddos_model = pickle.load(args.model)
     ddos_classifier = DDoSClassifier(ddos_model, args.min_threshold)
+    batch = EventBatch(ddos_classifier, args.batch_size)
+
+    # Events are reported by a separate thread
+    reporter = Reporter(args, geoip_db, misp_instance, logger)
+    reporter.start()
+
+    # Wake up regularly, so an incomplete batch does not wait for more data
+    trap.ifcctl(0, True, pytrap.CTL_TIMEOUT, int(args.batch_timeout * 1000000))
 
     # *** MAIN PROCESSING LOOP ***
     while True:
@@ -393,6 +625,11 @@ def main():
                 fmttype, fmtspec = trap.getDataFmt(0)
                 rec = pytrap.UnirecTemplate(fmtspec)
                 data = e.data
+            except pytrap.TimeoutError:
+                if batch.expired(args.batch_timeout):
+                    for event, victim_ip in batch.classify(logger):
+                        reporter.submit(event, victim_ip)
+                continue
             if len(data) <= 1:
                 # Terminating message
                 break
@@ -407,7 +644,7 @@ def main():
                 logger.info("Received IPv6 address, skipping")
                 continue
 
-            # Predict class of backscatter like traffic
+            # Add feature vector of backscatter like traffic to the batch
             try:
                 duration = DDoSClassifier.DURATION(rec)
                 if duration < args.min_duration:
@@ -422,49 +659,24 @@ def main():
                 for subnet in CESNET_NET:
                     if victim_ip in subnet:
                         continue
-                ddos = ddos_classifier.predict(rec)
+                batch.add(rec, victim_ip)
             except Exception as e:
                 logger.error(e)
                 continue
 
-            # Report attack using MISP
-            try:
-                if ddos:
-                    try:
-                        domain = gethostbyaddr(str(victim_ip))
-                    except herror as e:
-                        # Do not report for unknown domains
-                        continue
-                    event = create_ddos_event(rec, geoip_db, victim_ip, domain[0], args.misp_templates_dir)
-                    if args.export_to == "misp":
-                        try:
-                            event_id = misp_instance.add_event(event)['Event']['id']
-                            misp_instance.publish(event_id)
-                        except Exception as e:
-                            logger.error(e)
-                    elif args.export_to in ("c3isp", "c3isp-misp"):
-                        logger.debug(f"Uploading event to C3ISP platform.")
-                        event_file_path = Path("misp_event_to_c3isp.json").absolute()
-                        with temporary_open(event_file_path, 'w') as event_file:
-                            json.dump(event.to_json(), event_file)
-                            response = c3isp_upload.upload_to_c3isp(event_file_path)
-                            logger.debug(f"Response: {response}")
-
-                        if not response or ('status' in response and response['status'] == 'ERROR'):
-                            logger.error("ERROR during upload!")
-                            continue
-                        if args.export_to == "c3isp-misp":
-                            dpo_id = response['content']['additionalProperties']['dposId']
-                            logger.debug(f'Exporting DPO {dpo_id} to MISP.')
-                            c3isp_upload.export_misp(dpo_id, logger)
-            except Exception as e:
-                logger.error(str(e))
-                continue
+            # Predict class of the whole batch and report attacks using MISP
+            if batch.full() or batch.expired(args.batch_timeout):
+                for event, victim_ip in batch.classify(logger):
+                    reporter.submit(event, victim_ip)
         except Exception as e:
             # Log and re-raise exception
             logger.error(e)
+            reporter.stop()
             raise e
     # *** END OF MAIN PROCESSING LOOP ***
+    for event, victim_ip in batch.classify(logger):
+        reporter.submit(event, victim_ip)
+    reporter.stop()
     trap.finalize()
 
 
@@ -7,8 +7,10 @@
 
 from threading import Timer
 from threading import Thread
+from threading import Lock
 from datetime import datetime
 import queue
+import time
 import sys
 import os
 import signal
@@ -31,6 +33,9 @@ MAX_DST_IPS_PER_EVENT = 1000
 
 WWW_PREFIX = 'www.'
 
+# Number of buckets of the timer wheel per aggregation window (events are sent at most window/buckets late)
+WHEEL_BUCKETS_PER_WINDOW = 10
+
 stop = 0
 
 
@@ -44,56 +49,120 @@ def signal_h(signal, f):
     stop = 1
 
 
-# Global dicts of events
-ip_events = {}
-url_events = {}
+class EventStore:
+    """
+    Aggregated events with a timer wheel of their expiration. An event is sent when the aggregation
+    window since its first record elapses, the events are kept in buckets by the time of their expiration,
+    so sending visits only the buckets which are due instead of all events.
+    """
 
-template_out = "aggregated_blacklist"
+    def __init__(self, window):
+        self.granularity = window / WHEEL_BUCKETS_PER_WINDOW
+        self.window = window
+        # key -> event
+        self.events = {}
+        # bucket number -> keys of the events expiring in the bucket
+        self.buckets = {}
+        self.next_bucket = self._bucket(time.time())
+        # Held by the processor thread during lookup and update of an event and by the timer during expiration
+        self.lock = Lock()
 
+    def _bucket(self, ts):
+        return int(ts / self.granularity)
 
-# Send aggregated events by RepeatedTimer
-def send_events():
-    global ip_events
-    global url_events
-
-    # No need for locking, store reference global lists to local variables and point global lists to new, empty dicts.
-    # The processor threads then write into those new (empty) dicts
-    my_ip_events = ip_events
-    my_url_events = url_events
-    ip_events = {}
-    url_events = {}
-
-    for events in [my_ip_events, my_url_events]:
-        for event in events.values():
-            # Convert targets from IPAddr objects to str
-            event["targets"] = [str(target) for target in event["targets"]]
-            event["source_ports"] = list(event["source_ports"])
-
-            # Convert source/source_ip to str
-            try:
-                event["source"] = str(event["source"])
-            except KeyError:
-                event["source_ip"] = str(event["source_ip"])
+    def get(self, key):
+        return self.events.get(key)
 
-            try:
-                # To avoid too long messages, split the event if there are more 1000 IPs
-                if len(event["targets"]) > MAX_DST_IPS_PER_EVENT:
-                    targets = event["targets"]
-                    while targets:
-                        event_copy = event.copy()
-                        event_copy["targets"] = targets[:MAX_DST_IPS_PER_EVENT]
-                        targets = targets[MAX_DST_IPS_PER_EVENT:]
-                        trap.send(bytearray(json.dumps(event_copy), "utf-8"))
+    def insert(self, key, event):
+        self.events[key] = event
+        self.buckets.setdefault(self._bucket(time.time() + self.window), []).append(key)
 
-                else:
-                    # Send data to output interface
-                    trap.send(bytearray(json.dumps(event), "utf-8"))
-            except pytrap.Terminated:
-                print("Terminated TRAP.")
-                break
+    def expire(self, now):
+        """
+        Remove events of all buckets which ended before now
+        :return: List of the expired events
+        """
+        expired = []
+        with self.lock:
+            last = self._bucket(now)
+            for bucket in range(self.next_bucket, last):
+                for key in self.buckets.pop(bucket, ()):
+                    expired.append(self.events.pop(key))
+            self.next_bucket = max(self.next_bucket, last)
+        return expired
+
+    def pop_all(self):
+        """
+        Remove all events regardless of their expiration
+        :return: List of the events
+        """
+        with self.lock:
+            expired = list(self.events.values())
+            self.events = {}
+            self.buckets = {}
+        return expired
 
+
+# Global stores of events
+ip_store = None
+url_store = None
+
+template_out = "aggregated_blacklist"
+
+
+def event_messages(event):
+    """
+    Convert aggregated event to JSON messages of the output interface
+    """
+    # Convert targets from IPAddr objects to str
+    event["targets"] = [str(target) for target in event["targets"]]
+    event["source_ports"] = list(event["source_ports"])
+
+    # Convert source/source_ip to str
+    try:
+        event["source"] = str(event["source"])
+    except KeyError:
+        event["source_ip"] = str(event["source_ip"])
+
+    # To avoid too long messages, split the event if there are more 1000 IPs
+    if len(event["targets"]) > MAX_DST_IPS_PER_EVENT:
+        messages = []
+        targets = event["targets"]
+        while targets:
+            event_copy = event.copy()
+            event_copy["targets"] = targets[:MAX_DST_IPS_PER_EVENT]
+            targets = targets[MAX_DST_IPS_PER_EVENT:]
+            messages.append(bytearray(json.dumps(event_copy), "utf-8"))
+        return messages
+
+    return [bytearray(json.dumps(event), "utf-8")]
+
+
+def emit_events(events):
+    """
+    Send the batch of events to the output interface, the batch is flushed at once
+    """
+    if not events:
+        return
+
+    # Encode the whole batch first, so the interface is busy only while sending
+    messages = [message for event in events for message in event_messages(event)]
+
+    try:
+        for message in messages:
+            try:
+                trap.send(message)
             except pytrap.TimeoutError:
                 print("{}: Warning: dropped event because of TimeoutError".format(datetime.now().strftime("%F-%T")))
+        trap.sendFlush()
+    except pytrap.Terminated:
+        print("Terminated TRAP.")
+
+
+# Send expired events by RepeatedTimer
+def send_events():
+    now = time.time()
+    emit_events(ip_store.expire(now) + url_store.expire(now))
 
 
 class RepeatedTimer:
@@ -157,7 +226,7 @@ class IPProcessor:
         if self.ur_input.DST_BLACKLIST and self.ur_input.DST_PORT <= MINSRCPORT:
             event["source_ports"].add(self.ur_input.DST_PORT)
 
-        ip_events[key] = event
+        ip_store.insert(key, event)
 
     def _update_event(self, event):
         """
@@ -210,11 +279,12 @@ class IPProcessor:
                 self.ur_input.DST_BLACKLIST = blist
                 key = (self.ur_input.DST_IP, self.ur_input.PROTOCOL, blist)
 
-            event = ip_events.get(key)
-            if event is None:
-                self._insert_event(key)
-            else:
-                self._update_event(event)
+            with ip_store.lock:
+                event = ip_store.get(key)
+                if event is None:
+                    self._insert_event(key)
+                else:
+                    self._update_event(event)
 
 
 class URLProcessor:
@@ -256,7 +326,7 @@ class URLProcessor:
             "is_only_fqdn": only_fqdn
         }
 
-        url_events[key] = event
+        url_store.insert(key, event)
 
     def _update_event(self, event):
         """
@@ -299,11 +369,12 @@ class URLProcessor:
                    blist
                    )
 
-            event = url_events.get(key)
-            if event is None:
-                self._insert_event(key)
-            else:
-                self._update_event(event)
+            with url_store.lock:
+                event = url_store.get(key)
+                if event is None:
+                    self._insert_event(key)
+                else:
+                    self._update_event(event)
 
 
 class Aggregator:
@@ -401,14 +472,16 @@ if __name__ == '__main__':
     trap.init(sys.argv, 2, 1)
     trap.setDataFmt(0, pytrap.FMT_JSON, template_out)
 
-    rt = RepeatedTimer(float(options.time) * 60, send_events)
+    ip_store = EventStore(float(options.time) * 60)
+    url_store = EventStore(float(options.time) * 60)
+    rt = RepeatedTimer(ip_store.granularity, send_events)
 
     agg = Aggregator()
     agg.run()
     agg.join()
 
     rt.stop()
-    send_events()
+    emit_events(ip_store.pop_all() + url_store.pop_all())
 
     trap.sendFlush()
     trap.finalize()
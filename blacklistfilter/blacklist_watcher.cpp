@@ -47,7 +47,11 @@
    http://man7.org/linux/man-pages/man7/inotify.7.html */
 
 #include <sys/inotify.h>
+#include <sys/stat.h>
 #include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fstream>
 #include <errno.h>
 #include <unistd.h>
 #include <pthread.h>
@@ -59,6 +63,7 @@
 #include "ipblacklistfilter.h"
 #include "urlblacklistfilter.h"
 #include "dnsblacklistfilter.h"
+#include "unifiedblacklistfilter.h"
 
 #ifdef DEBUG
 #define DBG(x) fprintf x;
@@ -72,8 +77,11 @@ extern int BL_RELOAD_FLAG;
 /**
  * \brief Handles inotify events occuring on the filedescriptor.
  * \param fd File descriptor to watch for events
+ * \param wds Watch descriptors of the watched files
+ * \param nfiles Number of the watched files
+ * \return bit field with bit i set if the i-th watched file was rewritten
  */
-static void handle_events(int fd)
+static uint32_t handle_events(int fd, const int *wds, int nfiles)
 {
     /* Some systems cannot read integer variables if they are not
        properly aligned. On other systems, incorrect alignment may
@@ -85,13 +93,14 @@ static void handle_events(int fd)
     const struct inotify_event *event;
     ssize_t len;
     char *ptr;
+    uint32_t changed = 0;
 
     /* Loop while events can be read from inotify file descriptor. */
     while (1) {
         len = read(fd, buf, sizeof(buf));
         if (len == -1 && errno != EAGAIN) {
             perror("Error: Couldnt read from fd");
-            stop = 1; return;
+            stop = 1; return 0;
         }
 
         /* If the nonblocking read() found no events to read, then
@@ -106,13 +115,36 @@ static void handle_events(int fd)
             event = (const struct inotify_event *) ptr;
 
             if (event->mask & IN_CLOSE_WRITE) {
-                DBG((stderr, "Blacklist watcher setting a flag to reload blacklists\n"));
-                pthread_mutex_lock(&BLD_SYNC_MUTEX);
-                BL_RELOAD_FLAG = 1;
-                pthread_mutex_unlock(&BLD_SYNC_MUTEX);
+                for (int i = 0; i < nfiles; i++) {
+                    if (event->wd == wds[i]) {
+                        changed |= 1U << i;
+                    }
+                }
             }
         }
     }
+
+    return changed;
+}
+
+/**
+ * \brief Reloads the blacklists in the watcher thread if the detector supports it,
+ * otherwise sets a flag for the detector to reload them in its main loop.
+ * \param watcher_wrapper Data passed from the detector
+ */
+static void reload_blacklists(const watcher_wrapper_t *watcher_wrapper)
+{
+    if (watcher_wrapper->reload != nullptr) {
+        DBG((stderr, "Blacklist watcher reloading blacklists\n"));
+        // failure is reported by the callback, the detector keeps using the old blacklists
+        watcher_wrapper->reload(watcher_wrapper->data);
+        return;
+    }
+
+    DBG((stderr, "Blacklist watcher setting a flag to reload blacklists\n"));
+    pthread_mutex_lock(&BLD_SYNC_MUTEX);
+    BL_RELOAD_FLAG = 1;
+    pthread_mutex_unlock(&BLD_SYNC_MUTEX);
 }
 
 
@@ -123,26 +155,36 @@ static void handle_events(int fd)
  */
 void *watch_blacklist_files(void *arg)
 {
-    const char *detection_file = nullptr;
-    const char *detection_file2 = nullptr;
+    const char *files[WATCHER_MAX_FILES];
+    int nfiles = 0;
+    // only the unified filter may run without some of the files
+    bool required = true;
 
     watcher_wrapper_t *watcher_wrapper = (watcher_wrapper_t *) arg;
 
     switch (watcher_wrapper->detector_type) {
-        case 0:
-            detection_file =  ((ip_config_t *) watcher_wrapper->data) -> ipv4_blacklist_file;
-            detection_file2 = ((ip_config_t *) watcher_wrapper->data) -> ipv6_blacklist_file;
+        case IP_DETECT_ID:
+            files[nfiles++] = ((ip_config_t *) watcher_wrapper->data) -> ipv4_blacklist_file;
+            files[nfiles++] = ((ip_config_t *) watcher_wrapper->data) -> ipv6_blacklist_file;
+	    break;
+        case URL_DETECT_ID:
+            files[nfiles++] = ((url_config_t *) watcher_wrapper->data) -> blacklist_file;
 	    break;
-        case 1:
-            detection_file = ((url_config_t *) watcher_wrapper->data) -> blacklist_file;
+        case DNS_DETECT_ID:
+            files[nfiles++] = ((dns_config_t *) watcher_wrapper->data) -> blacklist_file;
 	    break;
-        case 2:
-            detection_file = ((dns_config_t *) watcher_wrapper->data) -> blacklist_file;
+        case UNIFIED_DETECT_ID:
+            files[nfiles++] = ((bl_config_t *) watcher_wrapper->data) -> ipv4_blacklist_file;
+            files[nfiles++] = ((bl_config_t *) watcher_wrapper->data) -> ipv6_blacklist_file;
+            files[nfiles++] = ((bl_config_t *) watcher_wrapper->data) -> url_blacklist_file;
+            files[nfiles++] = ((bl_config_t *) watcher_wrapper->data) -> dns_blacklist_file;
+            required = false;
 	    break;
     }
 
     int fd, poll_num;
-    int wd1, wd2;
+    int wds[WATCHER_MAX_FILES];
+    int watched = 0;
     nfds_t nfds;
     struct pollfd fds[1];
 
@@ -153,18 +195,26 @@ void *watch_blacklist_files(void *arg)
         stop = 1; return NULL;
     }
 
-    /* Watch the files for IN_CLOSE_WRITE event */
-    wd1 = inotify_add_watch(fd, detection_file, IN_CLOSE_WRITE);
+    /* Watch the files for IN_CLOSE_WRITE event, the first one is required (except for the unified filter) */
+    for (int i = 0; i < nfiles; i++) {
+        wds[i] = -1;
+        if (strcmp(files[i], BL_FILE_DISABLED) == 0) {
+            continue;
+        }
 
-    if (detection_file2 != nullptr) {
-        wd2 = inotify_add_watch(fd, detection_file2, IN_CLOSE_WRITE);
-        if (wd2 == -1) {
-            perror("Warning: inotify_add_watch failed for IPv6 file");
+        wds[i] = inotify_add_watch(fd, files[i], IN_CLOSE_WRITE);
+        if (wds[i] != -1) {
+            watched++;
+        } else if (i == 0 && required) {
+            perror("Error: Cannot watch the detector file, inotify_add_watch failed");
+            stop = 1; return NULL;
+        } else {
+            fprintf(stderr, "Warning: inotify_add_watch failed for %s: %s\n", files[i], strerror(errno));
         }
     }
 
-    if (wd1 == -1) {
-        perror("Error: Cannot watch the detector file, inotify_add_watch failed");
+    if (watched == 0) {
+        fprintf(stderr, "Error: Cannot watch any of the detector files\n");
         stop = 1; return NULL;
     }
 
@@ -174,7 +224,7 @@ void *watch_blacklist_files(void *arg)
     fds[0].fd = fd;
     fds[0].events = POLLIN;
 
-    DBG((stderr, "Blacklist watcher listening for changes in files %s, %s\n", detection_file, detection_file2));
+    DBG((stderr, "Blacklist watcher listening for changes in %d files\n", watched));
 
     while (1) {
         poll_num = poll(fds, nfds, -1);
@@ -190,8 +240,82 @@ void *watch_blacklist_files(void *arg)
         if (poll_num > 0) {
             if (fds[0].revents & POLLIN) {
                 /* Inotify events are available */
-                handle_events(fd);
+                uint32_t changed = handle_events(fd, wds, nfiles);
+                if (changed != 0) {
+                    watcher_wrapper->changed = changed;
+                    reload_blacklists(watcher_wrapper);
+                }
             }
         }
     }
 }
+
+
+/**
+ * \brief Gets version (size and modification time) of a blacklist file.
+ * \param file Path to the blacklist file
+ * \param version Filled version, size is -1 if the file cannot be accessed
+ * \return true if the file can be accessed
+ */
+bool get_blacklist_version(const std::string &file, blacklist_version_t &version)
+{
+    struct stat st;
+
+    if (stat(file.c_str(), &st) != 0) {
+        version.size = -1;
+        version.mtime_ns = 0;
+        return false;
+    }
+
+    version.size = st.st_size;
+    version.mtime_ns = (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+/**
+ * \brief Reads the changes of a blacklist file made since the given version.
+ * Delta file (file + BLACKLIST_DELTA_SUFFIX) starts with a line "#base <size> <mtime_ns>"
+ * identifying the version of the blacklist file it was computed against, followed by lines
+ * "+<line of the blacklist file>" for added or changed entries and "-<entity>" for removed ones.
+ * \param file Path to the blacklist file
+ * \param base Version of the blacklist file currently loaded by the detector
+ * \param added Filled with lines of added or changed entries
+ * \param removed Filled with removed entities
+ * \return true if the delta file exists, was computed against base and was read completely,
+ * otherwise the whole blacklist file has to be reloaded
+ */
+bool read_blacklist_delta(const std::string &file, const blacklist_version_t &base,
+                          std::vector<std::string> &added, std::vector<std::string> &removed)
+{
+    std::ifstream input((file + BLACKLIST_DELTA_SUFFIX).c_str(), std::ifstream::in);
+    std::string line;
+    int64_t size, mtime_ns;
+
+    added.clear();
+    removed.clear();
+
+    if (base.size < 0 || !input.is_open() || !getline(input, line)) {
+        return false;
+    }
+
+    if (sscanf(line.c_str(), "#base %" SCNd64 " %" SCNd64, &size, &mtime_ns) != 2 ||
+        size != base.size || mtime_ns != base.mtime_ns) {
+        DBG((stderr, "Delta file does not match the loaded blacklist file\n"));
+        return false;
+    }
+
+    while (getline(input, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        if (line[0] == '+') {
+            added.push_back(line.substr(1));
+        } else if (line[0] == '-') {
+            removed.push_back(line.substr(1));
+        } else {
+            return false;
+        }
+    }
+
+    return !input.bad();
+}
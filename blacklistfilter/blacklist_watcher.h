@@ -1,9 +1,20 @@
 #ifndef BLACKLISTFILTER_BLACKLIST_WATCHER_H
 #define BLACKLISTFILTER_BLACKLIST_WATCHER_H
 
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
 #define IP_DETECT_ID 0
 #define URL_DETECT_ID 1
 #define DNS_DETECT_ID 2
+#define UNIFIED_DETECT_ID 3
+
+/**
+* Maximum number of files watched by one watcher (IPv4, IPv6, URL and DNS file of the unified filter).
+*/
+#define WATCHER_MAX_FILES 4
 
 /**
 * Mutex for synchronization.
@@ -22,6 +33,38 @@ void *watch_blacklist_files(void *);
 typedef struct __attribute__ ((__packed__)) {
     uint8_t detector_type; /**< IP, URL od DNS detector ID */
     void *data;             /**< configuration of the detector to be passed to watcher_thread */
+    int (*reload)(void *);  /**< if set, called with data in the watcher thread to reload the blacklists,
+                                 otherwise BL_RELOAD_FLAG is set for the main loop */
+    uint32_t changed;       /**< bit i is set if the i-th watched file changed, filled before reload is called */
 } watcher_wrapper_t;
 
+/**
+* Value of a file in the configuration meaning that the file is not used.
+*/
+#define BL_FILE_DISABLED "-"
+
+/**
+* Suffix of the file with changes of a blacklist file, written by blacklist downloader.
+*/
+#define BLACKLIST_DELTA_SUFFIX ".delta"
+
+/**
+* Version of a loaded blacklist file.
+*/
+typedef struct {
+    int64_t size;     /**< Size of the file, -1 if unknown */
+    int64_t mtime_ns; /**< Modification time of the file in nanoseconds */
+} blacklist_version_t;
+
+/**
+* Function for getting version of a blacklist file.
+*/
+bool get_blacklist_version(const std::string &file, blacklist_version_t &version);
+
+/**
+* Function for reading the changes of a blacklist file made since the given version.
+*/
+bool read_blacklist_delta(const std::string &file, const blacklist_version_t &base,
+                          std::vector<std::string> &added, std::vector<std::string> &removed);
+
 #endif //BLACKLISTFILTER_BLACKLIST_WATCHER_H
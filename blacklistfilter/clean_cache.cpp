@@ -0,0 +1,82 @@
+/**
+ * \file clean_cache.cpp
+ * \brief Cache of recently checked clean domain names and URLs.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include "clean_cache.h"
+
+void clean_cache_init(clean_cache_t &cache, size_t size)
+{
+   size_t sets = 1;
+
+   while (sets * CLEAN_CACHE_WAYS < size) {
+      sets <<= 1;
+   }
+
+   std::vector<std::atomic<uint64_t> >(size > 0 ? sets * CLEAN_CACHE_WAYS : 0).swap(cache.tags);
+   for (size_t i = 0; i < cache.tags.size(); i++) {
+      cache.tags[i].store(0, std::memory_order_relaxed);
+   }
+   cache.set_mask = sets - 1;
+   // generation 0 is never used, so the zeroed tags do not match anything
+   cache.generation.store(1ULL << 1, std::memory_order_release);
+   cache.lookups = 0;
+   cache.hits = 0;
+}
+
+void clean_cache_invalidate(clean_cache_t &cache)
+{
+   uint64_t generation = (cache.generation.load(std::memory_order_relaxed) + (1ULL << 1)) & CLEAN_CACHE_GEN_MASK;
+
+   if (generation == 0) {
+      // generations wrapped around, tags from the previous round could match again
+      for (size_t i = 0; i < cache.tags.size(); i++) {
+         cache.tags[i].store(0, std::memory_order_relaxed);
+      }
+      generation = 1ULL << 1;
+   }
+   cache.generation.store(generation, std::memory_order_release);
+}
+
+double clean_cache_hit_rate(const clean_cache_t &cache)
+{
+   return cache.lookups > 0 ? (double) cache.hits / cache.lookups : 0.0;
+}
@@ -0,0 +1,195 @@
+/**
+ * \file clean_cache.h
+ * \brief Cache of recently checked clean domain names and URLs, header file.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef BLACKLISTFILTER_CLEAN_CACHE_H
+#define BLACKLISTFILTER_CLEAN_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+/*
+ * Most of the checked names are not blacklisted and a few thousand popular ones
+ * make up most of the traffic. The cache remembers 64-bit hashes of names which
+ * were found clean, so the blacklist is not searched for them again.
+ *
+ * The cache is a fixed-size table of sets of CLEAN_CACHE_WAYS tags. Every tag
+ * holds the upper 48 bits of the hash, the generation in which it was inserted
+ * and a reference bit. Replacement within a set follows the clock algorithm:
+ * a hit sets the reference bit, an insertion takes an empty or stale tag if
+ * there is one, otherwise the first unreferenced tag, clearing the reference
+ * bits of the tags it passes.
+ *
+ * Tags of older generations never match, so the cache is invalidated by
+ * incrementing the generation and a blacklist reload does not have to touch
+ * the table. Tags are single atomic words, readers therefore need no locking.
+ */
+
+/**
+ * Default number of cached names.
+ */
+#define CLEAN_CACHE_DEFAULT_SIZE 65536
+
+/**
+ * Number of tags in one set (one 32B piece of a cache line).
+ */
+#define CLEAN_CACHE_WAYS 4
+
+#define CLEAN_CACHE_REF_BIT 1ULL
+#define CLEAN_CACHE_GEN_BITS 15
+#define CLEAN_CACHE_GEN_MASK (((1ULL << CLEAN_CACHE_GEN_BITS) - 1) << 1)
+#define CLEAN_CACHE_KEY_MASK (~0ULL << (CLEAN_CACHE_GEN_BITS + 1))
+
+/**
+ * Cache of clean names.
+ */
+typedef struct {
+   std::vector<std::atomic<uint64_t> > tags; /**< Sets of tags, empty if the cache is disabled */
+   size_t set_mask;                          /**< Number of sets - 1 */
+   std::atomic<uint64_t> generation;         /**< Current generation, shifted to its position in tags */
+   uint64_t lookups;                         /**< Number of lookups */
+   uint64_t hits;                            /**< Number of lookups which found the name */
+} clean_cache_t;
+
+/**
+ * Function for allocating the cache for at least size names, size 0 disables the cache.
+ */
+void clean_cache_init(clean_cache_t &cache, size_t size);
+
+/**
+ * Function for invalidating all cached names (called after a blacklist reload).
+ */
+void clean_cache_invalidate(clean_cache_t &cache);
+
+/**
+ * Function returning ratio of lookups which hit the cache.
+ */
+double clean_cache_hit_rate(const clean_cache_t &cache);
+
+/**
+ * \brief Computes the hash identifying a name in the cache.
+ * \param str Name.
+ * \param len Length of the name.
+ * \return Hash of the name.
+ */
+static inline uint64_t clean_cache_hash(const char *str, size_t len)
+{
+   uint64_t hash = 0xcbf29ce484222325ULL;
+   for (size_t i = 0; i < len; i++) {
+      hash = (hash ^ (uint8_t) str[i]) * 0x100000001b3ULL;
+   }
+   // FNV-1a is weak in the upper bits, mix them before they are used as tag
+   hash ^= hash >> 33;
+   hash *= 0xff51afd7ed558ccdULL;
+   hash ^= hash >> 33;
+   return hash;
+}
+
+/**
+ * \brief Checks whether the name was recently found clean.
+ * \param cache Cache.
+ * \param hash Hash of the name (see clean_cache_hash()).
+ * \return True if the name is cached as clean.
+ */
+static inline bool clean_cache_lookup(clean_cache_t &cache, uint64_t hash)
+{
+   if (cache.tags.empty()) {
+      return false;
+   }
+
+   const uint64_t tag = (hash & CLEAN_CACHE_KEY_MASK) | cache.generation.load(std::memory_order_acquire);
+   std::atomic<uint64_t> *set = &cache.tags[(hash & cache.set_mask) * CLEAN_CACHE_WAYS];
+
+   cache.lookups++;
+   for (int i = 0; i < CLEAN_CACHE_WAYS; i++) {
+      uint64_t t = set[i].load(std::memory_order_relaxed);
+      if ((t & ~CLEAN_CACHE_REF_BIT) == tag) {
+         if (!(t & CLEAN_CACHE_REF_BIT)) {
+            set[i].store(t | CLEAN_CACHE_REF_BIT, std::memory_order_relaxed);
+         }
+         cache.hits++;
+         return true;
+      }
+   }
+   return false;
+}
+
+/**
+ * \brief Remembers the name as clean.
+ * \param cache Cache.
+ * \param hash Hash of the name (see clean_cache_hash()).
+ */
+static inline void clean_cache_insert(clean_cache_t &cache, uint64_t hash)
+{
+   if (cache.tags.empty()) {
+      return;
+   }
+
+   const uint64_t generation = cache.generation.load(std::memory_order_acquire);
+   const uint64_t tag = (hash & CLEAN_CACHE_KEY_MASK) | generation;
+   std::atomic<uint64_t> *set = &cache.tags[(hash & cache.set_mask) * CLEAN_CACHE_WAYS];
+
+   // empty and stale tags are reused first
+   for (unsigned i = 0; i < CLEAN_CACHE_WAYS; i++) {
+      if ((set[i].load(std::memory_order_relaxed) & CLEAN_CACHE_GEN_MASK) != generation) {
+         set[i].store(tag, std::memory_order_relaxed);
+         return;
+      }
+   }
+
+   // start at a different tag every time, the hash bits above the set index are random
+   const unsigned hand = (unsigned) ((hash >> 20) % CLEAN_CACHE_WAYS);
+
+   for (unsigned n = 0; n < 2 * CLEAN_CACHE_WAYS; n++) {
+      std::atomic<uint64_t> &slot = set[(hand + n) % CLEAN_CACHE_WAYS];
+      uint64_t t = slot.load(std::memory_order_relaxed);
+      if (!(t & CLEAN_CACHE_REF_BIT)) {
+         slot.store(tag, std::memory_order_relaxed);
+         return;
+      }
+      slot.store(t & ~CLEAN_CACHE_REF_BIT, std::memory_order_relaxed);
+   }
+}
+
+#endif /* BLACKLISTFILTER_CLEAN_CACHE_H */
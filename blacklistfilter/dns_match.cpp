@@ -0,0 +1,306 @@
+/**
+ * \file dns_match.cpp
+ * \brief Matching of DNS names (FQDNs) against the DNS blacklist.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "fields.h"
+#include "blacklist_watcher.h"
+#include "dnsblacklistfilter.h"
+
+#ifdef DEBUG
+#define DBG(x) fprintf x;
+#else
+#define DBG(x)
+#endif
+
+using namespace std;
+
+/**
+ * Function for parsing one line of the blacklist file ("entity\\bl_id").
+ * @param line Line of the blacklist file.
+ * @param fqdn Parsed FQDN.
+ * @param bl_index Parsed blacklist bitfield.
+ * @return false if the line is not in the expected format.
+ */
+static bool parse_blacklist_line(const string &line, string &fqdn, uint64_t &bl_index)
+{
+    // find DNS-blacklist separator
+    size_t sep = line.find_first_of('\\');
+
+    if (sep == string::npos) {
+        return false;
+    }
+
+    // Parse blacklist ID
+    bl_index = strtoull((line.substr(sep + 1, string::npos)).c_str(), NULL, 10);
+
+    // Parse FQDN
+    fqdn = line.substr(0, sep);
+    return true;
+}
+
+/**
+ * Function for inserting (or updating) the FQDN in the blacklist.
+ */
+static void insert_fqdn(dns_blacklist_t &blacklist, const string &fqdn, uint64_t bl_index)
+{
+    if (blacklist.use_hash) {
+        domain_index_insert(blacklist.index, fqdn.c_str(), fqdn.length(), bl_index);
+        return;
+    }
+
+    prefix_tree_domain_t *elem = prefix_tree_insert(blacklist.tree, fqdn.c_str(), strlen(fqdn.c_str()));
+
+    if (elem != NULL) {
+        dns_info_t *info = (dns_info_t *) elem->value;
+        info->bl_id = bl_index;
+    } else {
+        cerr << "WARNING: Can't insert element \'" << fqdn.c_str() << "\' to the prefix tree" << endl;
+    }
+}
+
+/**
+ * Function for removing the FQDN from the blacklist.
+ * Prefix tree keeps the node, it is just not blacklisted anymore (bl_id 0) until the next full reload.
+ */
+static void remove_fqdn(dns_blacklist_t &blacklist, const string &fqdn)
+{
+    if (blacklist.use_hash) {
+        domain_index_remove(blacklist.index, fqdn.c_str(), fqdn.length());
+        return;
+    }
+
+    prefix_tree_domain_t *elem = prefix_tree_insert(blacklist.tree, fqdn.c_str(), strlen(fqdn.c_str()));
+
+    if (elem != NULL) {
+        ((dns_info_t *) elem->value)->bl_id = 0;
+    }
+}
+
+/**
+ * Function for applying the delta file written by blacklist downloader to the loaded blacklist.
+ * @param blacklist Loaded blacklist.
+ * @param file Path to the blacklist file.
+ * @return false if there is no delta matching the loaded version, the file must be reloaded completely then.
+ */
+static bool apply_blacklist_delta(dns_blacklist_t &blacklist, string &file)
+{
+    vector<string> added, removed;
+    blacklist_version_t version;
+    string fqdn;
+    uint64_t bl_index;
+
+    // version is taken before reading the delta, a delta written meanwhile will not match it
+    get_blacklist_version(file, version);
+    if (!read_blacklist_delta(file, blacklist.version, added, removed)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < removed.size(); i++) {
+        remove_fqdn(blacklist, removed[i]);
+    }
+
+    for (size_t i = 0; i < added.size(); i++) {
+        if (parse_blacklist_line(added[i], fqdn, bl_index)) {
+            insert_fqdn(blacklist, fqdn, bl_index);
+        } else {
+            cerr << "WARNING: Delta of file '" << file << "' has bad formatted line '" << added[i] << "'" << endl;
+        }
+    }
+
+    DBG((stderr, "FQDN Blacklists updated: %zu added, %zu removed.\n", added.size(), removed.size()));
+
+    blacklist.version = version;
+    return true;
+}
+
+/**
+ * Function for loading blacklist file.
+ * Function gets path to the file and loads the blacklisted DNS/FQDN entities
+ * The FQDNs are stored in a prefix tree or in a hash index, depending on the selected backend
+ * If the downloader wrote a delta against the loaded version of the file, only the delta is applied.
+ * @param blacklist Blacklist to be filled.
+ * @param file Path to the file with sources.
+ * @return BLIST_LOAD_ERROR if directory cannot be accessed, ALL_OK otherwise.
+ */
+int reload_blacklists(dns_blacklist_t &blacklist, string &file)
+{
+    // names cached as clean may be blacklisted now
+    clean_cache_invalidate(blacklist.cache);
+
+    if (apply_blacklist_delta(blacklist, file)) {
+        return ALL_OK;
+    }
+
+    // recreate the tree/index with entities
+    if (blacklist.use_hash) {
+        domain_index_init(blacklist.index, DOMAIN_INDEX_SUFFIX);
+    } else {
+        prefix_tree_destroy(blacklist.tree);
+        blacklist.tree = prefix_tree_initialize(SUFFIX, sizeof(dns_info_t), '.', DOMAIN_EXTENSION_NO, RELAXATION_AFTER_DELETE_YES);
+    }
+
+    ifstream input;
+    string line, fqdn;
+    uint64_t bl_index;
+    int line_num = 0;
+
+    // version is taken before reading, a delta against a newer file will not match it
+    get_blacklist_version(file, blacklist.version);
+
+    input.open(file.c_str(), ifstream::in);
+    if (!input.is_open()) {
+        std::cerr << "ERROR: Cannot open file with updates. Is the downloader running?" << std::endl;
+        blacklist.version.size = -1;
+        return BLIST_LOAD_ERROR;
+    }
+
+    // load file line by line
+    while (!input.eof()) {
+        getline(input, line);
+        line_num++;
+
+        if (input.bad()) {
+            cerr << "ERROR: Failed reading blacklist file (getline badbit)" << endl;
+            input.close();
+            blacklist.version.size = -1;
+            return BLIST_LOAD_ERROR;
+        }
+
+        if (!parse_blacklist_line(line, fqdn, bl_index)) {
+            if (line.empty()) {
+                // probably just newline at the end of file
+                continue;
+            }
+            // Blacklist index delimeter not found (bad format?), skip it
+            cerr << "WARNING: File '" << file << "' has bad formatted line number '" << line_num << "'" << endl;
+            continue;
+        }
+
+        insert_fqdn(blacklist, fqdn, bl_index);
+    }
+
+    DBG((stderr, "DNS Blacklists Reloaded.\n"))
+
+    input.close();
+
+    return ALL_OK;
+}
+
+/**
+ * Function for checking the DNS/FQDN.
+ * Function gets the UniRec record with DNS/FQDN to check and tries to find it
+ * in the given blacklist. If the function succeeds then the appropriate
+ * field in detection record is filled with the number of blacklist asociated
+ * with the DNS/FQDN. If the DNS/FQDN is clean nothing is done.
+ *
+ * @param blacklist Blacklisted elements.
+ * @param in Template of input UniRec (record).
+ * @param out Template of output UniRec (detect).
+ * @param record Record with DNS/FQDN for checking.
+ * @param detect Record for reporting detection of blacklisted DNS/FQDN.
+ * @return BLACKLISTED if the address is found in table, FQDN_CLEAR otherwise.
+ */
+int check_blacklist(dns_blacklist_t &blacklist, ur_template_t *in, ur_template_t *out, const void *record, void *detect)
+{
+    // normalized copy of the name, kept on stack to avoid allocation per record
+    char fqdn[FQDN_MAX_LEN + 1];
+    const char *name = ur_get_ptr(in, record, F_DNS_NAME);
+    size_t len = ur_get_var_len(in, record, F_DNS_NAME);
+
+    // valid names are never longer than FQDN_MAX_LEN, such records cannot be blacklisted
+    if (len == 0 || len > FQDN_MAX_LEN) {
+        return DNS_CLEAR;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        char c = name[i];
+        fqdn[i] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+    fqdn[len] = '\0';
+
+    // skip WWW prefix
+    const char *start = fqdn;
+    if (len > WWW_PREFIX_LEN && memcmp(fqdn, WWW_PREFIX, WWW_PREFIX_LEN) == 0) {
+        start += WWW_PREFIX_LEN;
+        len -= WWW_PREFIX_LEN;
+    }
+
+    const uint64_t hash = clean_cache_hash(start, len);
+    if (clean_cache_lookup(blacklist.cache, hash)) {
+        return DNS_CLEAR;
+    }
+
+    if (blacklist.use_hash) {
+        // longest blacklisted label suffix, 0 if there is none
+        uint64_t bl_id = domain_index_search(blacklist.index, start, len);
+        if (bl_id > 0) {
+            DBG((stderr, "Detected blacklisted FQDN: '%s'\n", start));
+            ur_set(out, detect, F_BLACKLIST, bl_id);
+            return BLACKLISTED;
+        }
+        clean_cache_insert(blacklist.cache, hash);
+        return DNS_CLEAR;
+    }
+
+    prefix_tree_domain_t *domain = prefix_tree_search(blacklist.tree, start, len);
+
+    if (domain != NULL) {
+        dns_info_t *info = (dns_info_t *) domain->value;
+        // if blacklist index is 0, it is just a prefix/suffix match (not exact match)
+        if (info->bl_id > 0) {
+            DBG((stderr, "Detected blacklisted FQDN: '%s'\n", start));
+            ur_set(out, detect, F_BLACKLIST, info->bl_id);
+            return BLACKLISTED;
+        }
+    }
+
+    // FQDN was not found
+    clean_cache_insert(blacklist.cache, hash);
+    return DNS_CLEAR;
+}
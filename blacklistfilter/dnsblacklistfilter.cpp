@@ -43,8 +43,7 @@
  *
  */
 
-#include <algorithm>
-#include <cctype>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <pthread.h>
@@ -107,7 +106,7 @@ UR_FIELDS(
 )
 
 trap_module_info_t *module_info = NULL;
-prefix_tree_t * tree;
+dns_blacklist_t blacklist;
 
 using namespace std;
 
@@ -124,6 +123,8 @@ using namespace std;
   PARAM('c', "", "Specify user configuration file for DNSBlacklistFilter. [Default: " SYSCONFDIR "/blacklistfilter/dnsdetect_config.xml]", required_argument, "string") \
   PARAM('b', "", "Specify DNS blacklist file (overrides config file). [Default: /tmp/blacklistfilter/dns.blist]", required_argument, "string") \
   PARAM('n', "", "Do not send terminating Unirec when exiting program.", no_argument, "none") \
+  PARAM('e', "", "Specify number of recently checked clean FQDNs remembered to skip the blacklist search, 0 disables the cache. [Default: 65536]", required_argument, "uint32") \
+  PARAM('t', "", "Specify blacklist backend, \"" DOMAIN_BACKEND_TREE "\" (prefix tree) or \"" DOMAIN_BACKEND_HASH "\" (hash of label suffixes) (overrides config file). [Default: " DOMAIN_BACKEND_TREE "]", required_argument, "string") \
 
 int stop = 0; // global variable for stopping the program
 int BL_RELOAD_FLAG = 0;
@@ -135,127 +136,6 @@ static bool WATCH_BLACKLISTS_FLAG;
 TRAP_DEFAULT_SIGNAL_HANDLER(stop = 1)
 
 
-/**
- * Function for loading blacklist file.
- * Function gets path to the file and loads the blacklisted DNS/FQDN entities
- * The FQDNs are stored in a prefix tree
- * @param tree Prefix tree to be filled.
- * @param file Path to the file with sources.
- * @return BLIST_LOAD_ERROR if directory cannot be accessed, ALL_OK otherwise.
- */
-int reload_blacklists(prefix_tree_t **tree, string &file)
-{
-    // recreate the tree with entities
-    prefix_tree_destroy(*tree);
-    *tree = prefix_tree_initialize(SUFFIX, sizeof(dns_info_t), '.', DOMAIN_EXTENSION_NO, RELAXATION_AFTER_DELETE_YES);
-
-    ifstream input;
-    string line, fqdn, bl_flag_str;
-    uint64_t bl_index;
-    int line_num = 0;
-    size_t sep;
-
-    input.open(file.c_str(), ifstream::in);
-    if (!input.is_open()) {
-        std::cerr << "ERROR: Cannot open file with updates. Is the downloader running?" << std::endl;
-        return BLIST_LOAD_ERROR;
-    }
-
-    // load file line by line
-    while (!input.eof()) {
-        getline(input, line);
-        line_num++;
-
-        if (input.bad()) {
-            cerr << "ERROR: Failed reading blacklist file (getline badbit)" << endl;
-            input.close();
-            return BLIST_LOAD_ERROR;
-        }
-
-        // find DNS-blacklist separator
-        sep = line.find_first_of('\\');
-
-        if (sep == string::npos) {
-            if (line.empty()) {
-                // probably just newline at the end of file
-                continue;
-            }
-            // Blacklist index delimeter not found (bad format?), skip it
-            cerr << "WARNING: File '" << file << "' has bad formatted line number '" << line_num << "'" << endl;
-            continue;
-        }
-
-        // Parse blacklist ID
-        bl_index = strtoull((line.substr(sep + 1, string::npos)).c_str(), NULL, 10);
-
-        // Parse DNS
-        fqdn = line.substr(0, sep);
-
-        prefix_tree_domain_t *elem = prefix_tree_insert(*tree, fqdn.c_str(), strlen(fqdn.c_str()));
-
-        if (elem != NULL) {
-            dns_info_t *info = (dns_info_t *) elem->value;
-            info->bl_id = bl_index;
-        } else {
-            cerr << "WARNING: Can't insert element \'" << fqdn.c_str() << "\' to the prefix tree" << endl;
-        }
-    }
-
-    DBG((stderr, "DNS Blacklists Reloaded.\n"))
-
-    input.close();
-
-    return ALL_OK;
-}
-
-/**
- * Function for checking the DNS/FQDN.
- * Function gets the UniRec record with DNS/FQDN to check and tries to find it
- * in the given blacklist. If the function succeeds then the appropriate
- * field in detection record is filled with the number of blacklist asociated
- * with the DNS/FQDN. If the DNS/FQDN is clean nothing is done.
- *
- * @param tree Prefix tree with blacklisted elements.
- * @param in Template of input UniRec (record).
- * @param out Template of output UniRec (detect).
- * @param record Record with DNS/FQDN for checking.
- * @param detect Record for reporting detection of blacklisted DNS/FQDN.
- * @return BLACKLISTED if the address is found in table, FQDN_CLEAR otherwise.
- */
-int check_blacklist(prefix_tree_t *tree, ur_template_t *in, ur_template_t *out, const void *record, void *detect)
-{
-    string fqdn;
-
-    if (ur_get_var_len(in, record, F_DNS_NAME) == 0) {
-        return DNS_CLEAR;
-    }
-
-    fqdn = string(ur_get_ptr(in, record, F_DNS_NAME), ur_get_var_len(in, record, F_DNS_NAME));
-
-    // erase WWW prefix
-    if (fqdn.find(WWW_PREFIX) == 0) {
-        fqdn.erase(0, strlen(WWW_PREFIX));
-    }
-
-    std::transform(fqdn.begin(), fqdn.end(), fqdn.begin(), ::tolower);
-
-    prefix_tree_domain_t *domain = prefix_tree_search(tree, fqdn.c_str(), fqdn.length());
-
-    if (domain != NULL) {
-        dns_info_t *info = (dns_info_t *) domain->value;
-        // if blacklist index is 0, it is just a prefix/suffix match (not exact match)
-        if (info->bl_id > 0) {
-            DBG((stderr, "Detected blacklisted FQDN: '%s'\n", fqdn.c_str()));
-            ur_set(out, detect, F_BLACKLIST, info->bl_id);
-            return BLACKLISTED;
-        }
-    }
-
-    // FQDN was not found
-    return DNS_CLEAR;
-}
-
-
 /*
  * MAIN FUNCTION
  */
@@ -268,6 +148,8 @@ int main (int argc, char** argv)
     // Set default files names
     char *userFile = (char *) SYSCONFDIR "/blacklistfilter/dnsdetect_config.xml";
     char *blacklist_file = nullptr;
+    char *backend = nullptr;
+    size_t cache_size = CLEAN_CACHE_DEFAULT_SIZE;
 
     // TRAP initialization
     INIT_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
@@ -304,7 +186,7 @@ int main (int argc, char** argv)
 
     // ********** Parse arguments **********
     int opt;
-    while ((opt = getopt(argc, argv, "nc:b:")) != -1) {
+    while ((opt = getopt(argc, argv, "nc:b:e:t:")) != -1) {
         switch (opt) {
             case 'c': // user configuration file for DNSBlacklistFilter
                 userFile = optarg;
@@ -315,6 +197,12 @@ int main (int argc, char** argv)
             case 'n': // Do not send terminating Unirec
                 send_terminating_unirec = 0;
                 break;
+            case 'e': // size of the clean cache
+                cache_size = strtoul(optarg, NULL, 10);
+                break;
+            case 't': // blacklist backend
+                backend = optarg;
+                break;
             case '?':
                 main_retval = 1; goto cleanup;
         }
@@ -332,15 +220,31 @@ int main (int argc, char** argv)
         strcpy(config.blacklist_file, blacklist_file);
     }
 
+    if (backend != nullptr) {
+        snprintf(config.backend, sizeof(config.backend), "%s", backend);
+    }
+
+    if (strcmp(config.backend, DOMAIN_BACKEND_HASH) == 0) {
+        blacklist.use_hash = true;
+    } else if (strcmp(config.backend, DOMAIN_BACKEND_TREE) == 0) {
+        blacklist.use_hash = false;
+    } else {
+        cerr << "Error: Unknown blacklist backend '" << config.backend << "'" << endl;
+        main_retval = 1; goto cleanup;
+    }
+
     if (strcmp(config.watch_blacklists, "true") == 0) {
         WATCH_BLACKLISTS_FLAG = true;
     } else {
         WATCH_BLACKLISTS_FLAG = false;
     }
 
+    clean_cache_init(blacklist.cache, cache_size);
+    blacklist.version.size = -1;
+
     // Load FQDNs from file
     bl_file = config.blacklist_file;
-    if (reload_blacklists(&tree, bl_file) == BLIST_LOAD_ERROR) {
+    if (reload_blacklists(blacklist, bl_file) == BLIST_LOAD_ERROR) {
         cerr << "Error: Unable to read bl_file " << bl_file.c_str() << endl;
         main_retval = 1; goto cleanup;
     }
@@ -349,6 +253,7 @@ int main (int argc, char** argv)
         watcher_wrapper_t watcher_wrapper;
         watcher_wrapper.detector_type = DNS_DETECT_ID;
         watcher_wrapper.data = (void *) &config;
+        watcher_wrapper.reload = nullptr;
 
         if (pthread_create(&watcher_thread, NULL, watch_blacklist_files, (void *) &watcher_wrapper) > 0) {
             cerr << "Error: Couldnt create watcher thread" << endl;
@@ -378,7 +283,7 @@ int main (int argc, char** argv)
         }
 
         // check for blacklist match
-        retval = check_blacklist(tree, ur_input, ur_output, data, detection);
+        retval = check_blacklist(blacklist, ur_input, ur_output, data, detection);
 
         // is blacklisted? send report
         if (retval == BLACKLISTED) {
@@ -389,7 +294,7 @@ int main (int argc, char** argv)
         if (BL_RELOAD_FLAG) {
             // Update blacklists
             DBG((stderr, "Reloading blacklists\n"));
-            if (reload_blacklists(&tree, bl_file) == BLIST_LOAD_ERROR) {
+            if (reload_blacklists(blacklist, bl_file) == BLIST_LOAD_ERROR) {
                 cerr << "ERROR: Unable to load update files. Will use the old tables instead." << endl;
             }
 
@@ -401,6 +306,11 @@ int main (int argc, char** argv)
         }
     }
 
+    if (!blacklist.cache.tags.empty()) {
+        cerr << "Clean cache: " << blacklist.cache.hits << " hits of " << blacklist.cache.lookups << " lookups ("
+             << 100.0 * clean_cache_hit_rate(blacklist.cache) << " %)" << endl;
+    }
+
     // send terminate message
     if (send_terminating_unirec) {
         trap_send(0, "TERMINATE", 1);
@@ -50,6 +50,9 @@
 #include <string>
 #include <vector>
 #include <stdint.h>
+#include "blacklist_watcher.h"
+#include "clean_cache.h"
+#include "domain_index.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -60,6 +63,10 @@ extern "C" {
 /* include from nemea-common */
 #include <prefix_tree.h>
 
+#ifdef __cplusplus
+}
+#endif
+
 /**
  * Constant returned if everything is ok.
  */
@@ -86,11 +93,18 @@ extern "C" {
 #define DETECTION_ALLOC_LEN 2048
 
 #define WWW_PREFIX "www."
+#define WWW_PREFIX_LEN (sizeof(WWW_PREFIX) - 1)
+
+/**
+ * Maximum length of a domain name in text form (RFC 1035)
+ */
+#define FQDN_MAX_LEN 255
 
 
 typedef struct __attribute__ ((__packed__)) {
     char blacklist_file[256];
     char watch_blacklists[8];
+    char backend[8];
 } dns_config_t;
 
 /**
@@ -107,18 +121,25 @@ typedef struct {
     uint64_t bl_id;
 } dns_info_t;
 
+/**
+ * Blacklisted FQDNs stored in the selected backend.
+ */
+typedef struct {
+    bool use_hash;           /**< Hash index is used instead of the prefix tree */
+    prefix_tree_t *tree;     /**< Prefix tree of FQDNs */
+    clean_cache_t cache;     /**< Recently checked clean FQDNs */
+    domain_index_t index;    /**< Hash index of FQDNs */
+    blacklist_version_t version; /**< Version of the loaded blacklist file */
+} dns_blacklist_t;
+
 /**
  * Function for loading update files.
  */
-int reload_blacklists(prefix_tree_t *tree, std::string &file);
+int reload_blacklists(dns_blacklist_t &blacklist, std::string &file);
 
 /**
  * Function for checking records.
  */
-int check_blacklist(prefix_tree_t *tree, ur_template_t *in, ur_template_t *out, const void *record, void *detect);
-
-#ifdef __cplusplus
-}
-#endif
+int check_blacklist(dns_blacklist_t &blacklist, ur_template_t *in, ur_template_t *out, const void *record, void *detect);
 
 #endif /* DNSBLACKLISTFILTER_H */
@@ -63,6 +63,11 @@ static char const *MODULE_CONFIG_PATTERN_STRING =
             "<type size=\"8\">string</type>"
             "<default-value>true</default-value>"
         "</element>"
+        "<element type=\"optional\">"
+            "<name>backend</name>"
+            "<type size=\"8\">string</type>"
+            "<default-value>tree</default-value>"
+        "</element>"
     "</struct>"
 "</configuration>";
 
@@ -0,0 +1,218 @@
+/**
+ * \file domain_index.cpp
+ * \brief Hash index of blacklisted domain suffixes and URL prefixes.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include "domain_index.h"
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+/**
+ * Initial log2 size of the table.
+ */
+#define DOMAIN_INDEX_MIN_BITS 10
+
+/**
+ * \brief Adds one character to the running FNV-1a hash.
+ */
+static inline uint64_t hash_step(uint64_t hash, char c)
+{
+   return (hash ^ (uint8_t) c) * FNV_PRIME;
+}
+
+/**
+ * \brief Turns the running hash into a key, 0 is reserved for empty slots.
+ */
+static inline uint64_t hash_key(uint64_t hash)
+{
+   return hash != 0 ? hash : 1;
+}
+
+/**
+ * \brief Computes key of a whole inserted string.
+ */
+static uint64_t string_key(const domain_index_t &index, const char *str, size_t len)
+{
+   uint64_t hash = FNV_OFFSET;
+
+   if (index.mode == DOMAIN_INDEX_SUFFIX) {
+      for (size_t i = len; i > 0; i--) {
+         hash = hash_step(hash, str[i - 1]);
+      }
+   } else {
+      for (size_t i = 0; i < len; i++) {
+         hash = hash_step(hash, str[i]);
+      }
+   }
+   return hash_key(hash);
+}
+
+/**
+ * \brief Returns the slot where probing for the key starts.
+ */
+static inline size_t home_slot(const domain_index_t &index, uint64_t key)
+{
+   return (size_t) ((key * 0x9e3779b97f4a7c15ULL) >> (64 - index.bits));
+}
+
+/**
+ * \brief Returns slot of the key or the empty slot where the key belongs.
+ */
+static inline size_t find_slot(const domain_index_t &index, uint64_t key)
+{
+   const size_t mask = index.slots.size() - 1;
+   size_t i = home_slot(index, key);
+
+   while (index.slots[i].key != 0 && index.slots[i].key != key) {
+      i = (i + 1) & mask;
+   }
+   return i;
+}
+
+static void resize(domain_index_t &index, unsigned bits)
+{
+   std::vector<domain_index_slot_t> old;
+   old.swap(index.slots);
+
+   index.bits = bits;
+   index.slots.assign((size_t) 1 << bits, domain_index_slot_t());
+
+   for (size_t i = 0; i < old.size(); i++) {
+      if (old[i].key != 0) {
+         index.slots[find_slot(index, old[i].key)] = old[i];
+      }
+   }
+}
+
+void domain_index_init(domain_index_t &index, domain_index_mode_t mode)
+{
+   index.mode = mode;
+   index.count = 0;
+   index.slots.clear();
+   resize(index, DOMAIN_INDEX_MIN_BITS);
+}
+
+void domain_index_insert(domain_index_t &index, const char *str, size_t len, uint64_t bl_id)
+{
+   // keep the load factor at most 1/2
+   if (2 * (index.count + 1) > index.slots.size()) {
+      resize(index, index.bits + 1);
+   }
+
+   const uint64_t key = string_key(index, str, len);
+   domain_index_slot_t &slot = index.slots[find_slot(index, key)];
+
+   if (slot.key == 0) {
+      slot.key = key;
+      index.count++;
+   }
+   slot.bl_id = bl_id;
+}
+
+void domain_index_remove(domain_index_t &index, const char *str, size_t len)
+{
+   const size_t mask = index.slots.size() - 1;
+   size_t i = find_slot(index, string_key(index, str, len));
+
+   if (index.slots[i].key == 0) {
+      return;
+   }
+
+   // backward shift deletion, move back the following keys which would not be found past the hole
+   for (size_t j = (i + 1) & mask; index.slots[j].key != 0; j = (j + 1) & mask) {
+      const size_t home = home_slot(index, index.slots[j].key);
+      if (((j - home) & mask) >= ((j - i) & mask)) {
+         index.slots[i] = index.slots[j];
+         i = j;
+      }
+   }
+
+   index.slots[i].key = 0;
+   index.slots[i].bl_id = 0;
+   index.count--;
+}
+
+uint64_t domain_index_search(const domain_index_t &index, const char *str, size_t len)
+{
+   uint64_t hash = FNV_OFFSET;
+   uint64_t bl_id = 0;
+
+   if (index.count == 0) {
+      return 0;
+   }
+
+   if (index.mode == DOMAIN_INDEX_SUFFIX) {
+      for (size_t i = len; i > 0; i--) {
+         hash = hash_step(hash, str[i - 1]);
+         if (i == 1 || str[i - 2] == '.') {
+            const domain_index_slot_t &slot = index.slots[find_slot(index, hash_key(hash))];
+            if (slot.key != 0 && slot.bl_id != 0) {
+               bl_id = slot.bl_id;
+            }
+         }
+      }
+   } else {
+      for (size_t i = 0; i < len; i++) {
+         hash = hash_step(hash, str[i]);
+         if (i + 1 == len || str[i + 1] == '/' || str[i + 1] == '?') {
+            const domain_index_slot_t &slot = index.slots[find_slot(index, hash_key(hash))];
+            if (slot.key != 0 && slot.bl_id != 0) {
+               bl_id = slot.bl_id;
+            }
+         }
+      }
+   }
+
+   return bl_id;
+}
+
+void domain_index_clear(domain_index_t &index)
+{
+   std::vector<domain_index_slot_t>().swap(index.slots);
+   index.bits = 0;
+   index.count = 0;
+}
+
+size_t domain_index_memory(const domain_index_t &index)
+{
+   return index.slots.capacity() * sizeof(domain_index_slot_t);
+}
@@ -0,0 +1,134 @@
+/**
+ * \file domain_index.h
+ * \brief Hash index of blacklisted domain suffixes and URL prefixes, header file.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef BLACKLISTFILTER_DOMAIN_INDEX_H
+#define BLACKLISTFILTER_DOMAIN_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/*
+ * The index is a flat open-addressing table of 64-bit hashes of the inserted
+ * strings, the strings themselves are not stored. A searched string is hashed
+ * once, character by character, and the table is probed only at the boundaries
+ * where an inserted string may end:
+ *
+ * - DOMAIN_INDEX_SUFFIX hashes from the last character and probes every label
+ *   suffix, i.e. "a.b.evil.com" tests "com", "evil.com", "b.evil.com" and
+ *   "a.b.evil.com".
+ * - DOMAIN_INDEX_PREFIX hashes from the first character and probes the prefixes
+ *   ending before each '/' or '?' and the whole string, i.e. "evil.com/a/b"
+ *   tests "evil.com", "evil.com/a" and "evil.com/a/b".
+ *
+ * The longest inserted string found wins. Two different strings with the same
+ * hash are indistinguishable, with 64-bit hashes this is negligible.
+ */
+
+/**
+ * Name of the prefix tree (nemea-common) backend.
+ */
+#define DOMAIN_BACKEND_TREE "tree"
+
+/**
+ * Name of the hash index backend.
+ */
+#define DOMAIN_BACKEND_HASH "hash"
+
+/**
+ * Direction in which the strings are matched.
+ */
+typedef enum {
+   DOMAIN_INDEX_SUFFIX, /**< Match label suffixes of domain names */
+   DOMAIN_INDEX_PREFIX  /**< Match path prefixes of URLs */
+} domain_index_mode_t;
+
+/**
+ * Slot of the table, key 0 marks an empty slot.
+ */
+typedef struct {
+   uint64_t key;   /**< Hash of the inserted string */
+   uint64_t bl_id; /**< Blacklist bitfield of the string */
+} domain_index_slot_t;
+
+/**
+ * Hash index of blacklisted strings.
+ */
+typedef struct {
+   domain_index_mode_t mode;                /**< Matching direction */
+   std::vector<domain_index_slot_t> slots;  /**< Table, size is a power of two */
+   unsigned bits;                           /**< Log2 of the table size */
+   size_t count;                            /**< Number of occupied slots */
+} domain_index_t;
+
+/**
+ * Function for (re)initializing an empty index.
+ */
+void domain_index_init(domain_index_t &index, domain_index_mode_t mode);
+
+/**
+ * Function for inserting a string, the bitfield of an already present string is replaced.
+ */
+void domain_index_insert(domain_index_t &index, const char *str, size_t len, uint64_t bl_id);
+
+/**
+ * Function for removing a string, nothing is done if the string is not present.
+ */
+void domain_index_remove(domain_index_t &index, const char *str, size_t len);
+
+/**
+ * Function for searching the longest inserted suffix/prefix of a string.
+ */
+uint64_t domain_index_search(const domain_index_t &index, const char *str, size_t len);
+
+/**
+ * Function for releasing memory of the index.
+ */
+void domain_index_clear(domain_index_t &index);
+
+/**
+ * Function returning memory footprint of the index in bytes.
+ */
+size_t domain_index_memory(const domain_index_t &index);
+
+#endif /* BLACKLISTFILTER_DOMAIN_INDEX_H */
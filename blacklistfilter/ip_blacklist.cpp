@@ -0,0 +1,358 @@
+/**
+ * \file ip_blacklist.cpp
+ * \brief Loading of IP blacklists for IPBlacklistFilter, either from the text files or from a snapshot.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <iostream>
+#include <fstream>
+#include <cerrno>
+#include <unirec/unirec.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef DEBUG
+#define DBG(x) fprintf x;
+#else
+#define DBG(x)
+#endif
+
+#include "ipblacklistfilter.h"
+#include "ip_snapshot.h"
+
+using namespace std;
+
+/**
+ * \brief Function for building longest-prefix-match index of the blacklist entries.
+ * \param index Index to be built.
+ * \param is_v6 Whether the entries are IPv6.
+ * \param list Entries to be indexed, the index returns positions in this list.
+ */
+static void build_index(ip_lpm_t &index, bool is_v6, const vector<ip_bl_entry_t> &list)
+{
+   std::vector<ip_lpm_prefix_t> prefixes;
+   prefixes.reserve(list.size());
+
+   for (size_t i = 0; i < list.size(); i++) {
+      ip_lpm_prefix_t prefix;
+      prefix.ip = list[i].ip;
+      prefix.prefix_len = list[i].prefix_len;
+      prefix.value = i;
+      prefixes.push_back(prefix);
+   }
+
+   ip_lpm_build(index, is_v6, prefixes);
+   DBG((stderr, "IPv%d index built: %lu nodes, %lu leaves\n", is_v6 ? 6 : 4, index.nodes.size(), index.leaves.size()));
+}
+
+/**
+ * \brief Function for loading blacklists from text files. It parses files with blacklisted IP
+ * addresses (IPv6 blacklist file is optional.). The file shall be preprocessed by blacklist downloader
+ * (no redundant whitespaces, forcing lowercase etc.)
+ * Function also checks validity of line on which the IP address was found. Invalid of bad formatted lines
+ * are ignored.
+ * The entries are indexed for longest-prefix matching, so the files do not have to be sorted
+ * and overlapping prefixes are resolved to the most specific one.
+ * \param blacklist Blacklist to be filled, it is left untouched on error.
+ * \param config Configuration with blacklist files.
+ * \return ALL_OK if everything goes well, BLIST_FILE_ERROR if file cannot be accessed.
+ */
+int load_blacklist_files(ip_blacklist_t &blacklist, const ip_config_t *config)
+{
+   ifstream input;
+   string line, ip, bl_index_str;
+   uint64_t bl_index;      // blacklist ID is a 64bit map
+   int line_num = 0;
+   ip_bl_entry_t bl_entry; // black list entry associated with ip address
+   std::map<int, std::set<int>> bl_ports; // ports for blacklists of the entry
+
+   ip_blacklist_t new_blacklist;
+   vector<ip_bl_entry_t> v4_list_new;
+   vector<ip_bl_entry_t> v6_list_new;
+
+   // Entries with the same ports or adaptive IDs share them
+   ip_port_table_builder_t ports_builder;
+   unordered_map<string, uint32_t> adaptive_ids_index;
+   vector<uint32_t> adaptive_id_offsets(1, 0);
+   vector<char> adaptive_id_chars(1, '\0');
+
+   std::vector<char *> blacklist_files;
+   blacklist_files.push_back(((ip_config_t *) config)->ipv4_blacklist_file);
+   blacklist_files.push_back(((ip_config_t *) config)->ipv6_blacklist_file);
+
+   // Read the blacklist files
+   for (auto &file: blacklist_files) {
+      line_num = 0;
+      input.open(file, ifstream::in);
+
+      if (!input.is_open()) {
+         if (file == ((ip_config_t *) config)->ipv6_blacklist_file) {
+            // Do not terminate the program when IPv6 blacklist not present
+            cerr << "Warning: Could not read IPv6 blacklist, not detecting IPv6" << endl;
+            continue;
+         }
+         cerr << "ERROR: Cannot open blacklist file: " << config->ipv4_blacklist_file << ". Is the downloader running?"
+              << endl;
+         return BLIST_FILE_ERROR;
+      }
+
+      while (!input.eof()) {
+         getline(input, line);
+         line_num++;
+
+         if (input.bad()) {
+            cerr << "ERROR: Failed reading blacklist file (getline badbit)" << endl;
+            input.close();
+            return BLIST_FILE_ERROR;
+         }
+
+         // Find IP-blacklist index separator
+         size_t comma_sep = line.find_first_of(',');
+
+         if (comma_sep == string::npos) {
+            if (line.empty()) {
+               // probably just newline at the end of file
+               continue;
+            }
+            // Blacklist index delimeter not found (bad format?), skip it
+            cerr << "WARNING: File '" << file << "' has bad formatted line number '" << line_num << "'" << endl;
+            continue;
+         }
+
+         bl_entry.adaptive_id = 0;
+         bl_entry.port_filter = NO_PORT_FILTER;
+
+         // Parse IP
+         ip = line.substr(0, comma_sep);
+
+         // Are we loading prefix?
+         size_t slash_sep = ip.find_first_of('/');
+
+         if (slash_sep == string::npos) {
+            // IP only
+            if (!ip_from_str(ip.c_str(), &bl_entry.ip)) {
+               cerr << "WARNING: Invalid IP address in file '" << file << "' on line '" << line_num << "'" << endl;
+               continue;
+            }
+            if (ip_is4(&bl_entry.ip)) {
+               bl_entry.prefix_len = PREFIX_V4_DEFAULT;
+            } else {
+               bl_entry.prefix_len = PREFIX_V6_DEFAULT;
+            }
+
+         } else {
+            // IP prefix
+            if (!ip_from_str((ip.substr(0, slash_sep)).c_str(), &bl_entry.ip)) {
+               cerr << "WARNING: Invalid IP address in file '" << file << "' on line '" << line_num << "'" << endl;
+               continue;
+            }
+
+            ip.erase(0, slash_sep + 1);
+            bl_entry.prefix_len = (uint8_t) strtol(ip.c_str(), nullptr, 0);
+         }
+
+         // Parse blacklist ID
+         bl_index = strtoull((line.substr(comma_sep + 1, string::npos)).c_str(), NULL, 10);
+
+         // Determine blacklist
+         bl_entry.in_blacklist = bl_index;
+
+         // If handling adaptive blacklist, load adaptive IDs in the entity
+         if (bl_index == ADAPTIVE_BLACKLIST_INDEX) {
+            string id_part = line.substr(comma_sep + 1, string::npos);
+            size_t comma_sep2 = id_part.find_first_of(',');
+            id_part = id_part.substr(comma_sep2 + 1, string::npos);
+
+            auto id = adaptive_ids_index.find(id_part);
+            if (id == adaptive_ids_index.end()) {
+               id = adaptive_ids_index.emplace(id_part, adaptive_id_offsets.size()).first;
+               adaptive_id_offsets.push_back(adaptive_id_chars.size());
+               adaptive_id_chars.insert(adaptive_id_chars.end(), id_part.c_str(), id_part.c_str() + id_part.size() + 1);
+            }
+            bl_entry.adaptive_id = id->second;
+         }
+
+         // blacklist:[ports] parsing
+         uint16_t bl_num;
+         uint16_t port;
+
+         size_t bl_semicolon_sep = line.find_first_of(';');
+
+         if (bl_semicolon_sep == string::npos) {
+            // Add entry to vector
+            if (ip_is4(&bl_entry.ip)) {
+               v4_list_new.push_back(bl_entry);
+            } else {
+               v6_list_new.push_back(bl_entry);
+            }
+            continue;
+         }
+
+         string str = line.substr(bl_semicolon_sep, string::npos);
+         char *index = const_cast<char *>(str.c_str());
+         char* end_ptr = nullptr;
+
+         bl_ports.clear();
+
+#define state_start 0
+#define state_blacklist_num 1
+#define state_ports 2
+#define state_invalid 3
+#define state_end 4
+
+         int state = state_start;
+         while (state != state_end) {
+            switch (state) {
+            case state_start:
+               if (*index == ';') {
+                  index++;
+                  state = state_blacklist_num;
+               } else if (*index == '\0') {
+                  state = state_end;
+               } else {
+                  state = state_invalid;
+               }
+               break;
+
+            case state_blacklist_num:
+               bl_num = strtoul(index, &end_ptr, 10);
+               if (end_ptr == index || errno != 0) {
+                  cerr << "Parsing blacklist number failed, errno:" << errno << endl;
+                  state = state_invalid;
+                  break;
+               }
+
+               index = end_ptr;
+               bl_ports[bl_num] = {};
+
+               if (*index == ':') {
+                  index++;
+                  state = state_ports;
+               } else {
+                  state = state_invalid;
+               }
+               break;
+
+            case state_ports:
+               port = strtoul(index, &end_ptr, 10);
+               if (end_ptr == index || errno != 0) {
+                  cerr << "Parsing port number failed, errno:" << errno << endl;
+                  state = state_invalid;
+                  break;
+               }
+               index = end_ptr;
+               bl_ports.at(bl_num).insert(port);
+
+               if (*index == ',') {
+                  index++;
+                  state = state_ports;
+               } else if (*index == ';') {
+                  index++;
+                  state = state_start;
+               } else {
+                  state = state_end;
+               }
+               break;
+            }
+
+            if (state == state_invalid) {
+               cerr << "Invalid blacklist:[ports] on line:" << str << endl;
+               break;
+            }
+         }
+
+         bl_entry.port_filter = ip_port_table_add(ports_builder, bl_ports);
+
+         // Add entry to vector
+         if (ip_is4(&bl_entry.ip)) {
+            v4_list_new.push_back(bl_entry);
+         } else {
+            v6_list_new.push_back(bl_entry);
+         }
+      }
+
+      input.close();
+   }
+
+   build_index(new_blacklist.v4_index, false, v4_list_new);
+   build_index(new_blacklist.v6_index, true, v6_list_new);
+
+   new_blacklist.v4_list.assign(move(v4_list_new));
+   new_blacklist.v6_list.assign(move(v6_list_new));
+   ip_port_table_finish(new_blacklist.ports, ports_builder);
+   new_blacklist.adaptive_id_offsets.assign(move(adaptive_id_offsets));
+   new_blacklist.adaptive_id_chars.assign(move(adaptive_id_chars));
+
+   blacklist = move(new_blacklist);
+
+   DBG((stderr, "Blacklists reloaded. Entries: IP4: %lu, IP6: %lu, index size: IP4: %lu B, IP6: %lu B, "
+        "port filters: %lu (%lu B), adaptive IDs: %lu\n",
+        blacklist.v4_list.size(), blacklist.v6_list.size(),
+        ip_lpm_memory(blacklist.v4_index), ip_lpm_memory(blacklist.v6_index),
+        blacklist.ports.filters.size(), ip_port_table_memory(blacklist.ports), blacklist.adaptive_id_offsets.size()));
+
+   return ALL_OK;
+}
+
+/**
+ * \brief Function for (re)loading blacklists. The snapshot is used if it is configured
+ * and it was compiled from the current blacklist files, otherwise the files are parsed.
+ * \param blacklist Blacklist to be filled, it is left untouched on error.
+ * \param config Configuration with blacklist files and snapshot.
+ * \return ALL_OK if everything goes well, BLIST_FILE_ERROR if file cannot be accessed.
+ */
+int reload_blacklists(ip_blacklist_t &blacklist, const ip_config_t *config)
+{
+   if (ip_snapshot_configured(config)) {
+      if (ip_snapshot_load(blacklist, config, config->snapshot_file) == ALL_OK) {
+         return ALL_OK;
+      }
+      cerr << "Warning: Snapshot '" << config->snapshot_file << "' not used, parsing blacklist files" << endl;
+   }
+
+   return load_blacklist_files(blacklist, config);
+}
@@ -0,0 +1,311 @@
+/**
+ * \file ip_lpm.cpp
+ * \brief Compressed longest-prefix-match index for IPv4/IPv6 blacklists.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+
+#include <algorithm>
+#include "ip_lpm.h"
+
+/**
+ * Number of slots of the direct table.
+ */
+#define LPM_DIRECT_SIZE (1U << LPM_DIRECT_BITS)
+
+/**
+ * Number of slots of a trie node.
+ */
+#define LPM_NODE_SIZE (1U << LPM_STRIDE)
+
+/**
+ * Uncompressed node used while building the index.
+ */
+typedef struct {
+   uint32_t leaf[LPM_NODE_SIZE];  /**< Leaf value + 1 of every slot */
+   uint32_t child[LPM_NODE_SIZE]; /**< Index + 1 of the child node of every slot, 0 if none */
+} lpm_build_node_t;
+
+/**
+ * \brief Returns the child of the slot, creating it if it does not exist yet.
+ * The new child inherits the leaf of the slot (leaf pushing).
+ * \param build Uncompressed nodes.
+ * \param child Child index of the slot.
+ * \param leaf Leaf of the slot.
+ * \return Index of the child node.
+ */
+static uint32_t lpm_get_child(std::vector<lpm_build_node_t> &build, uint32_t &child, uint32_t leaf)
+{
+   if (child == 0) {
+      lpm_build_node_t node;
+      std::fill(node.leaf, node.leaf + LPM_NODE_SIZE, leaf);
+      std::fill(node.child, node.child + LPM_NODE_SIZE, 0);
+      build.push_back(node);
+      child = build.size();
+   }
+   return child - 1;
+}
+
+/**
+ * \brief Compresses the uncompressed node and (recursively) all its children.
+ * \param nodes Compressed nodes to be filled.
+ * \param leaves Compressed leaves to be filled.
+ * \param build Uncompressed nodes.
+ * \param build_idx Index of the uncompressed node.
+ * \param out Index of the already allocated compressed node.
+ */
+static void lpm_compress_node(std::vector<ip_lpm_node_t> &nodes, std::vector<uint32_t> &leaves,
+                              const std::vector<lpm_build_node_t> &build, uint32_t build_idx, uint32_t out)
+{
+   const lpm_build_node_t &node = build[build_idx];
+   ip_lpm_node_t compressed = {0, 0, 0, 0};
+   uint32_t children = 0;
+   bool first = true;
+   uint32_t prev = LPM_NO_MATCH;
+
+   compressed.base0 = leaves.size();
+   for (unsigned i = 0; i < LPM_NODE_SIZE; i++) {
+      if (node.child[i] != 0) {
+         compressed.vector |= 1ULL << i;
+         children++;
+      } else if (first || node.leaf[i] != prev) {
+         compressed.leafvec |= 1ULL << i;
+         leaves.push_back(node.leaf[i]);
+         prev = node.leaf[i];
+         first = false;
+      }
+   }
+
+   // Children of a node must be stored next to each other
+   compressed.base1 = nodes.size();
+   nodes.resize(nodes.size() + children);
+   nodes[out] = compressed;
+
+   uint32_t k = 0;
+   for (unsigned i = 0; i < LPM_NODE_SIZE; i++) {
+      if (node.child[i] != 0) {
+         lpm_compress_node(nodes, leaves, build, node.child[i] - 1, compressed.base1 + k++);
+      }
+   }
+}
+
+/**
+ * \brief Function for building the index. Prefixes are inserted from the shortest
+ * to the longest, so every longer prefix overwrites the expanded slots of shorter
+ * prefixes that contain it. Previous content of the index is discarded.
+ * \param lpm Index to be built.
+ * \param is_v6 Whether the prefixes are IPv6.
+ * \param prefixes Prefixes to be inserted, values must be lower than LPM_NODE_FLAG - 1.
+ */
+void ip_lpm_build(ip_lpm_t &lpm, bool is_v6, const std::vector<ip_lpm_prefix_t> &prefixes)
+{
+   const unsigned max_len = is_v6 ? 128 : 32;
+   std::vector<uint32_t> direct_leaf(LPM_DIRECT_SIZE, LPM_NO_MATCH);
+   std::vector<uint32_t> direct_child(LPM_DIRECT_SIZE, 0);
+   std::vector<lpm_build_node_t> build;
+   std::vector<const ip_lpm_prefix_t *> sorted;
+
+   ip_lpm_clear(lpm);
+   lpm.is_v6 = is_v6;
+
+   sorted.reserve(prefixes.size());
+   for (const auto &prefix: prefixes) {
+      sorted.push_back(&prefix);
+   }
+   std::stable_sort(sorted.begin(), sorted.end(), [](const ip_lpm_prefix_t *a, const ip_lpm_prefix_t *b) {
+      return a->prefix_len < b->prefix_len;
+   });
+
+   for (const ip_lpm_prefix_t *prefix: sorted) {
+      const unsigned len = std::min<unsigned>(prefix->prefix_len, max_len);
+      const uint32_t leaf = prefix->value + 1;
+      const ip_lpm_key_t key = ip_lpm_key(&prefix->ip, is_v6);
+      uint32_t slot = ip_lpm_bits(key, 0, LPM_DIRECT_BITS);
+
+      if (len <= LPM_DIRECT_BITS) {
+         const uint32_t span = 1U << (LPM_DIRECT_BITS - len);
+         slot &= ~(span - 1);
+         std::fill(direct_leaf.begin() + slot, direct_leaf.begin() + slot + span, leaf);
+         continue;
+      }
+
+      uint32_t node = lpm_get_child(build, direct_child[slot], direct_leaf[slot]);
+      unsigned off = LPM_DIRECT_BITS;
+
+      while (len > off + LPM_STRIDE) {
+         slot = ip_lpm_bits(key, off, LPM_STRIDE);
+         // build may be reallocated by lpm_get_child, do not keep references into it
+         uint32_t child = build[node].child[slot];
+         uint32_t next = lpm_get_child(build, child, build[node].leaf[slot]);
+         build[node].child[slot] = child;
+         node = next;
+         off += LPM_STRIDE;
+      }
+
+      const uint32_t span = 1U << (off + LPM_STRIDE - len);
+      slot = ip_lpm_bits(key, off, LPM_STRIDE) & ~(span - 1);
+      std::fill(build[node].leaf + slot, build[node].leaf + slot + span, leaf);
+   }
+
+   std::vector<uint32_t> direct(LPM_DIRECT_SIZE);
+   std::vector<ip_lpm_node_t> nodes;
+   std::vector<uint32_t> leaves;
+
+   for (uint32_t i = 0; i < LPM_DIRECT_SIZE; i++) {
+      if (direct_child[i] == 0) {
+         direct[i] = direct_leaf[i];
+         continue;
+      }
+      const uint32_t out = nodes.size();
+      nodes.resize(out + 1);
+      lpm_compress_node(nodes, leaves, build, direct_child[i] - 1, out);
+      direct[i] = out | LPM_NODE_FLAG;
+   }
+
+   lpm.direct.assign(std::move(direct));
+   lpm.nodes.assign(std::move(nodes));
+   lpm.leaves.assign(std::move(leaves));
+}
+
+/**
+ * \brief Looks up at most LPM_BATCH_MAX addresses. All lookups advance by one trie level
+ * in every round and the memory needed by the next round is prefetched, so the cache
+ * misses of independent lookups overlap instead of being paid one after another.
+ * \param lpm Index.
+ * \param ips Searched addresses.
+ * \param results Values of the longest matching prefixes (-1 if not found).
+ * \param count Number of addresses.
+ */
+static void lpm_lookup_chunk(const ip_lpm_t &lpm, const ip_addr_t *const *ips, int *results, size_t count)
+{
+   ip_lpm_key_t keys[LPM_BATCH_MAX];
+   const uint32_t *slots[LPM_BATCH_MAX];
+   const ip_lpm_node_t *nodes[LPM_BATCH_MAX];
+   unsigned offs[LPM_BATCH_MAX];
+   uint8_t active[LPM_BATCH_MAX];
+   size_t active_cnt = 0;
+
+   for (size_t i = 0; i < count; i++) {
+      keys[i] = ip_lpm_key(ips[i], lpm.is_v6);
+      slots[i] = &lpm.direct[ip_lpm_bits(keys[i], 0, LPM_DIRECT_BITS)];
+      __builtin_prefetch(slots[i]);
+   }
+
+   for (size_t i = 0; i < count; i++) {
+      const uint32_t d = *slots[i];
+      if (!(d & LPM_NODE_FLAG)) {
+         results[i] = (int) d - 1;
+         continue;
+      }
+      nodes[i] = &lpm.nodes[d & ~LPM_NODE_FLAG];
+      offs[i] = LPM_DIRECT_BITS;
+      __builtin_prefetch(nodes[i]);
+      active[active_cnt++] = i;
+   }
+
+   // slots[] is reused for leaves which were prefetched in the previous round
+   while (active_cnt > 0) {
+      size_t next_cnt = 0;
+      for (size_t a = 0; a < active_cnt; a++) {
+         const size_t i = active[a];
+         if (nodes[i] == nullptr) {
+            results[i] = (int) *slots[i] - 1;
+            continue;
+         }
+
+         const ip_lpm_node_t *node = nodes[i];
+         const unsigned idx = ip_lpm_bits(keys[i], offs[i], LPM_STRIDE);
+         const uint64_t mask = (2ULL << idx) - 1;
+
+         if (node->vector & (1ULL << idx)) {
+            nodes[i] = &lpm.nodes[node->base1 + __builtin_popcountll(node->vector & mask) - 1];
+            offs[i] += LPM_STRIDE;
+            __builtin_prefetch(nodes[i]);
+         } else {
+            slots[i] = &lpm.leaves[node->base0 + __builtin_popcountll(node->leafvec & mask) - 1];
+            nodes[i] = nullptr;
+            __builtin_prefetch(slots[i]);
+         }
+         active[next_cnt++] = i;
+      }
+      active_cnt = next_cnt;
+   }
+}
+
+/**
+ * \brief Function for looking up many addresses at once. The result is the same
+ * as calling ip_lpm_lookup() for every address.
+ * \param lpm Index.
+ * \param ips Searched addresses (of the same family as the index).
+ * \param results Values of the longest matching prefixes (-1 if not found).
+ * \param count Number of addresses.
+ */
+void ip_lpm_lookup_batch(const ip_lpm_t &lpm, const ip_addr_t *const *ips, int *results, size_t count)
+{
+   if (lpm.direct.empty()) {
+      std::fill(results, results + count, -1);
+      return;
+   }
+
+   for (size_t done = 0; done < count; done += LPM_BATCH_MAX) {
+      lpm_lookup_chunk(lpm, ips + done, results + done, std::min<size_t>(LPM_BATCH_MAX, count - done));
+   }
+}
+
+/**
+ * \brief Function for releasing memory of the index.
+ * \param lpm Index to be cleared.
+ */
+void ip_lpm_clear(ip_lpm_t &lpm)
+{
+   lpm.direct.clear();
+   lpm.nodes.clear();
+   lpm.leaves.clear();
+}
+
+/**
+ * \brief Function returning approximate memory footprint of the index.
+ * \param lpm Index.
+ * \return Size of the index in bytes (not counting arrays of a mapped snapshot).
+ */
+size_t ip_lpm_memory(const ip_lpm_t &lpm)
+{
+   return lpm.direct.memory() + lpm.nodes.memory() + lpm.leaves.memory();
+}
@@ -0,0 +1,223 @@
+/**
+ * \file ip_lpm.h
+ * \brief Compressed longest-prefix-match index for IPv4/IPv6 blacklists, header file.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef BLACKLISTFILTER_IP_LPM_H
+#define BLACKLISTFILTER_IP_LPM_H
+
+#include <stdint.h>
+#include <endian.h>
+#include <vector>
+#include <unirec/unirec.h>
+#include "mapped_array.h"
+
+/*
+ * The index is a poptrie-like multibit trie. The first LPM_DIRECT_BITS of the
+ * address are resolved by a flat table, the rest in steps of LPM_STRIDE bits
+ * through compressed nodes. Every node stores two 64-bit bitmaps and two base
+ * offsets, children and leaves of a node are kept contiguous, so a child or
+ * a leaf is located with a single popcount. Prefixes are expanded (leaf pushed)
+ * at build time, overlapping prefixes are therefore resolved to the longest one.
+ *
+ * Lookup costs at most 1 + ceil((32 - 16) / 6) = 4 node reads for IPv4
+ * and 1 + ceil((128 - 16) / 6) = 20 node reads for IPv6, plus one leaf read.
+ */
+
+/**
+ * Number of leading address bits resolved by the direct table.
+ */
+#define LPM_DIRECT_BITS 16
+
+/**
+ * Number of address bits resolved by one trie node (64 slots).
+ */
+#define LPM_STRIDE 6
+
+/**
+ * Flag of a direct table entry pointing to a trie node (otherwise it is a leaf).
+ */
+#define LPM_NODE_FLAG 0x80000000U
+
+/**
+ * Leaf value of addresses which are not covered by any prefix.
+ */
+#define LPM_NO_MATCH 0
+
+/**
+ * Compressed trie node.
+ */
+typedef struct {
+   uint64_t vector;  /**< Bit i is set if the slot i points to a child node */
+   uint64_t leafvec; /**< Bit i is set if the leaf slot i starts a new run of equal leaves */
+   uint32_t base0;   /**< Index of the first leaf of the node */
+   uint32_t base1;   /**< Index of the first child of the node */
+} ip_lpm_node_t;
+
+/**
+ * Prefix inserted into the index.
+ */
+typedef struct {
+   ip_addr_t ip;       /**< Network address */
+   uint8_t prefix_len; /**< Length of the prefix */
+   uint32_t value;     /**< Value returned for addresses matching the prefix (index of the entry) */
+} ip_lpm_prefix_t;
+
+/**
+ * Longest-prefix-match index of either IPv4 or IPv6 prefixes.
+ */
+typedef struct {
+   bool is_v6;                        /**< Index holds IPv6 prefixes */
+   MappedArray<uint32_t> direct;      /**< Direct table, leaf value + 1 or node index | LPM_NODE_FLAG */
+   MappedArray<ip_lpm_node_t> nodes;  /**< Trie nodes */
+   MappedArray<uint32_t> leaves;      /**< Compressed leaves, value + 1 or LPM_NO_MATCH */
+} ip_lpm_t;
+
+/**
+ * Function for building the index from the list of prefixes.
+ */
+void ip_lpm_build(ip_lpm_t &lpm, bool is_v6, const std::vector<ip_lpm_prefix_t> &prefixes);
+
+/**
+ * Function for releasing memory of the index.
+ */
+void ip_lpm_clear(ip_lpm_t &lpm);
+
+/**
+ * Function returning approximate memory footprint of the index in bytes.
+ */
+size_t ip_lpm_memory(const ip_lpm_t &lpm);
+
+/**
+ * Maximum number of addresses resolved together by ip_lpm_lookup_batch(), larger batches are split.
+ */
+#define LPM_BATCH_MAX 64
+
+/**
+ * Function for looking up many addresses at once, memory accesses of the lookups are interleaved.
+ */
+void ip_lpm_lookup_batch(const ip_lpm_t &lpm, const ip_addr_t *const *ips, int *results, size_t count);
+
+/**
+ * Address converted to a 128-bit host order integer, IPv4 is stored in the top 32 bits.
+ */
+typedef struct {
+   uint64_t hi;
+   uint64_t lo;
+} ip_lpm_key_t;
+
+/**
+ * \brief Converts an address to the key used for indexing.
+ * \param ip Address.
+ * \param is_v6 Whether the address is IPv6.
+ * \return Key of the address.
+ */
+static inline ip_lpm_key_t ip_lpm_key(const ip_addr_t *ip, bool is_v6)
+{
+   ip_lpm_key_t key;
+   if (is_v6) {
+      key.hi = be64toh(ip->ui64[0]);
+      key.lo = be64toh(ip->ui64[1]);
+   } else {
+      key.hi = (uint64_t) be32toh(ip->ui32[2]) << 32;
+      key.lo = 0;
+   }
+   return key;
+}
+
+/**
+ * \brief Extracts len bits of the key starting at bit offset off (from MSB).
+ * \param key Key.
+ * \param off Offset of the first bit, bits past the end of the address are zero.
+ * \param len Number of bits (at most 32).
+ * \return Extracted bits.
+ */
+static inline uint32_t ip_lpm_bits(const ip_lpm_key_t &key, unsigned off, unsigned len)
+{
+   uint64_t v;
+   if (off == 0) {
+      v = key.hi;
+   } else if (off < 64) {
+      v = (key.hi << off) | (key.lo >> (64 - off));
+   } else if (off < 128) {
+      v = key.lo << (off - 64);
+   } else {
+      v = 0;
+   }
+   return (uint32_t) (v >> (64 - len));
+}
+
+/**
+ * \brief Finds the longest prefix matching the given address.
+ * \param lpm Index.
+ * \param ip Searched address (of the same family as the index).
+ * \return Value of the longest matching prefix or -1 if the address is not covered by any prefix.
+ */
+static inline int ip_lpm_lookup(const ip_lpm_t &lpm, const ip_addr_t *ip)
+{
+   if (lpm.direct.empty()) {
+      return -1;
+   }
+
+   const ip_lpm_key_t key = ip_lpm_key(ip, lpm.is_v6);
+   uint32_t d = lpm.direct[ip_lpm_bits(key, 0, LPM_DIRECT_BITS)];
+
+   if (!(d & LPM_NODE_FLAG)) {
+      return (int) d - 1;
+   }
+
+   const ip_lpm_node_t *node = &lpm.nodes[d & ~LPM_NODE_FLAG];
+   unsigned off = LPM_DIRECT_BITS;
+
+   while (1) {
+      const unsigned idx = ip_lpm_bits(key, off, LPM_STRIDE);
+      const uint64_t mask = (2ULL << idx) - 1;
+
+      if (node->vector & (1ULL << idx)) {
+         node = &lpm.nodes[node->base1 + __builtin_popcountll(node->vector & mask) - 1];
+         off += LPM_STRIDE;
+      } else {
+         return (int) lpm.leaves[node->base0 + __builtin_popcountll(node->leafvec & mask) - 1] - 1;
+      }
+   }
+}
+
+#endif /* BLACKLISTFILTER_IP_LPM_H */
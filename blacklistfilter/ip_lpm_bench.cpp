@@ -0,0 +1,135 @@
+/**
+ * \file ip_lpm_bench.cpp
+ * \brief Benchmark of the longest-prefix-match index on synthetic prefixes
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "ip_lpm.h"
+#include "bench.h"
+
+using namespace std;
+
+#define PREFIX_CNT 100000
+#define ADDR_CNT (1 << 20)
+#define LOOKUP_ROUNDS 8
+
+/**
+ * Random address, IPv4 addresses are stored the same way as by UniRec.
+ */
+static void random_address(ip_addr_t *ip, bool is_v6)
+{
+   ip->ui64[0] = bench_rand();
+   ip->ui64[1] = bench_rand();
+   if (!is_v6) {
+      ip->ui64[0] = 0;
+      ip->ui32[3] = 0xffffffff;
+   }
+}
+
+static void bench_lpm(bool is_v6)
+{
+   vector<ip_lpm_prefix_t> prefixes(PREFIX_CNT);
+   vector<ip_addr_t> addrs(ADDR_CNT);
+   vector<const ip_addr_t *> addr_ptrs(ADDR_CNT);
+   vector<int> results(LPM_BATCH_MAX);
+   ip_lpm_t lpm;
+   volatile int sink = 0;
+   double start;
+   unsigned long start_allocations;
+
+   for (uint32_t i = 0; i < PREFIX_CNT; i++) {
+      random_address(&prefixes[i].ip, is_v6);
+      // Lengths as in usual blacklists, mostly host addresses
+      prefixes[i].prefix_len = is_v6 ? 32 + bench_rand() % 97 : 8 + bench_rand() % 25;
+      if (bench_rand() % 2) {
+         prefixes[i].prefix_len = is_v6 ? 128 : 32;
+      }
+      prefixes[i].value = i;
+   }
+   for (uint32_t i = 0; i < ADDR_CNT; i++) {
+      // Half of the addresses hit a prefix
+      if (i % 2) {
+         addrs[i] = prefixes[bench_rand() % PREFIX_CNT].ip;
+      } else {
+         random_address(&addrs[i], is_v6);
+      }
+      addr_ptrs[i] = &addrs[i];
+   }
+
+   start = bench_now_ns();
+   start_allocations = bench_allocations();
+   ip_lpm_build(lpm, is_v6, prefixes);
+   bench_report(is_v6 ? "ip_lpm_build (IPv6, per prefix)" : "ip_lpm_build (IPv4, per prefix)",
+          PREFIX_CNT, start, start_allocations);
+
+   start = bench_now_ns();
+   start_allocations = bench_allocations();
+   for (int r = 0; r < LOOKUP_ROUNDS; r++) {
+      for (uint32_t i = 0; i < ADDR_CNT; i++) {
+         sink += ip_lpm_lookup(lpm, &addrs[i]);
+      }
+   }
+   bench_report(is_v6 ? "ip_lpm_lookup (IPv6)" : "ip_lpm_lookup (IPv4)",
+          (uint64_t) LOOKUP_ROUNDS * ADDR_CNT, start, start_allocations);
+
+   start = bench_now_ns();
+   start_allocations = bench_allocations();
+   for (int r = 0; r < LOOKUP_ROUNDS; r++) {
+      for (uint32_t i = 0; i < ADDR_CNT; i += LPM_BATCH_MAX) {
+         ip_lpm_lookup_batch(lpm, &addr_ptrs[i], results.data(), LPM_BATCH_MAX);
+         sink += results[0];
+      }
+   }
+   bench_report(is_v6 ? "ip_lpm_lookup_batch (IPv6)" : "ip_lpm_lookup_batch (IPv4)",
+          (uint64_t) LOOKUP_ROUNDS * ADDR_CNT, start, start_allocations);
+
+   printf("%-32s %10lu bytes\n", "index memory", (unsigned long) ip_lpm_memory(lpm));
+   ip_lpm_clear(lpm);
+   (void) sink;
+}
+
+int main()
+{
+   bench_lpm(false);
+   bench_lpm(true);
+   return 0;
+}
@@ -0,0 +1,193 @@
+/**
+ * \file ip_lpm_unit_test.cpp
+ * \brief Unit test for the longest-prefix-match index
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "ip_lpm.h"
+
+using namespace std;
+
+int failCounter = 0;
+
+#define CHECK(cond, msg) { if (!(cond)) { fprintf(stderr, "FAIL: %s\n", msg); failCounter++; } }
+
+static ip_lpm_prefix_t make_prefix(const char *ip, uint8_t len, uint32_t value)
+{
+   ip_lpm_prefix_t p;
+   memset(&p, 0, sizeof(p));
+   ip_from_str(ip, &p.ip);
+   p.prefix_len = len;
+   p.value = value;
+   return p;
+}
+
+static int lookup(const ip_lpm_t &lpm, const char *ip)
+{
+   ip_addr_t addr;
+   ip_from_str(ip, &addr);
+   return ip_lpm_lookup(lpm, &addr);
+}
+
+/**
+ * Reference implementation, linear scan for the longest matching prefix.
+ */
+static int linear_lookup(const vector<ip_lpm_prefix_t> &prefixes, const ip_addr_t *ip, bool is_v6)
+{
+   const ip_lpm_key_t k = ip_lpm_key(ip, is_v6);
+   int best = -1, best_len = -1;
+
+   for (const auto &p: prefixes) {
+      const ip_lpm_key_t pk = ip_lpm_key(&p.ip, is_v6);
+      const unsigned len = p.prefix_len;
+      const uint64_t mhi = len == 0 ? 0 : (len >= 64 ? ~0ULL : ~(~0ULL >> len));
+      const uint64_t mlo = len <= 64 ? 0 : (len >= 128 ? ~0ULL : ~(~0ULL >> (len - 64)));
+      if ((k.hi & mhi) == (pk.hi & mhi) && (k.lo & mlo) == (pk.lo & mlo) && (int) len >= best_len) {
+         best = p.value;
+         best_len = len;
+      }
+   }
+   return best;
+}
+
+static void random_test(bool is_v6)
+{
+   vector<ip_lpm_prefix_t> prefixes;
+   ip_lpm_t lpm;
+
+   for (uint32_t i = 0; i < 2000; i++) {
+      ip_lpm_prefix_t p;
+      memset(&p, 0, sizeof(p));
+      // keep the addresses close to each other to get many overlaps
+      for (int b = 0; b < 16; b++) {
+         p.ip.ui8[b] = (b < 2) ? (rand() % 4) : rand();
+      }
+      if (!is_v6) {
+         p.ip.ui64[0] = 0;
+         p.ip.ui32[3] = 0xffffffff;
+      }
+      p.prefix_len = rand() % (is_v6 ? 129 : 33);
+      p.value = i;
+      prefixes.push_back(p);
+   }
+
+   ip_lpm_build(lpm, is_v6, prefixes);
+
+   // batch lookup has to return the same results as single lookups
+   vector<ip_addr_t> batch(1000);
+   vector<const ip_addr_t *> batch_ptrs;
+   vector<int> batch_results(batch.size());
+   for (auto &q: batch) {
+      q = prefixes[rand() % prefixes.size()].ip;
+      q.ui8[is_v6 ? 15 : 11] ^= rand();
+      batch_ptrs.push_back(&q);
+   }
+   ip_lpm_lookup_batch(lpm, batch_ptrs.data(), batch_results.data(), batch.size());
+   for (size_t i = 0; i < batch.size(); i++) {
+      if (batch_results[i] != ip_lpm_lookup(lpm, &batch[i])) {
+         CHECK(false, "batch lookup");
+         break;
+      }
+   }
+
+   for (int i = 0; i < 100000; i++) {
+      ip_addr_t q = prefixes[rand() % prefixes.size()].ip;
+      // flip some low bits of a random prefix
+      const int byte = is_v6 ? rand() % 16 : 8 + rand() % 4;
+      q.ui8[byte] ^= rand();
+
+      const int expected = linear_lookup(prefixes, &q, is_v6);
+      const int found = ip_lpm_lookup(lpm, &q);
+      if (found != expected && (found < 0 || expected < 0 ||
+                                prefixes[found].prefix_len != prefixes[expected].prefix_len)) {
+         CHECK(false, is_v6 ? "random IPv6 lookup" : "random IPv4 lookup");
+         break;
+      }
+   }
+}
+
+int main()
+{
+   srand(0);
+
+   ip_lpm_t v4;
+   vector<ip_lpm_prefix_t> v4_prefixes;
+
+   CHECK(ip_lpm_lookup(v4, NULL) == -1, "empty index");
+
+   v4_prefixes.push_back(make_prefix("10.0.0.0", 8, 0));
+   v4_prefixes.push_back(make_prefix("10.1.2.3", 32, 1));
+   v4_prefixes.push_back(make_prefix("10.1.0.0", 16, 2));
+   v4_prefixes.push_back(make_prefix("192.168.1.128", 25, 3));
+   ip_lpm_build(v4, false, v4_prefixes);
+
+   CHECK(lookup(v4, "10.200.0.1") == 0, "IPv4 /8");
+   CHECK(lookup(v4, "10.1.2.3") == 1, "IPv4 /32 inside /16");
+   CHECK(lookup(v4, "10.1.2.4") == 2, "IPv4 /16 inside /8");
+   CHECK(lookup(v4, "192.168.1.200") == 3, "IPv4 /25");
+   CHECK(lookup(v4, "192.168.1.127") == -1, "IPv4 outside /25");
+   CHECK(lookup(v4, "11.0.0.0") == -1, "IPv4 clear");
+
+   ip_lpm_t v6;
+   vector<ip_lpm_prefix_t> v6_prefixes;
+
+   v6_prefixes.push_back(make_prefix("2001:db8::", 32, 0));
+   v6_prefixes.push_back(make_prefix("2001:db8:1::", 48, 1));
+   v6_prefixes.push_back(make_prefix("2001:db8:1::1", 128, 2));
+   ip_lpm_build(v6, true, v6_prefixes);
+
+   CHECK(lookup(v6, "2001:db8:ffff::1") == 0, "IPv6 /32");
+   CHECK(lookup(v6, "2001:db8:1::2") == 1, "IPv6 /48");
+   CHECK(lookup(v6, "2001:db8:1::1") == 2, "IPv6 /128");
+   CHECK(lookup(v6, "2001:db9::1") == -1, "IPv6 clear");
+
+   random_test(false);
+   random_test(true);
+
+   if (failCounter > 0) {
+      fprintf(stderr, "%d test(s) failed\n", failCounter);
+      return 1;
+   }
+   return 0;
+}
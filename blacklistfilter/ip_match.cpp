@@ -0,0 +1,217 @@
+/**
+ * \file ip_match.cpp
+ * \brief Matching of flow addresses against the IP blacklist.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdio.h>
+#include "fields.h"
+#include "ipblacklistfilter.h"
+
+#ifdef DEBUG
+#define DBG(x) fprintf x;
+#else
+#define DBG(x)
+#endif
+
+/**
+ * @brief fill bitfield with flags of ports where the port matching succeeded or where no port information are available
+ * 		  gets called for records that have been already matched based on SRC_IP/DST_IP
+ *
+ * @param ports port restrictions of the blacklist
+ * @param bl_entry blacklist entry
+ * @param port src/dst port of the matched record
+ *
+ * @return bitfield with only those flags filled where ports were matched or not available
+ */
+static inline uint64_t check_ports_get_bitfield(const ip_port_table_t &ports, const ip_bl_entry_t &bl_entry, uint16_t port)
+{
+   if (bl_entry.port_filter == NO_PORT_FILTER) {
+      // no port information => match everything
+      return bl_entry.in_blacklist;
+   }
+
+   return ip_port_table_unmatched(ports, bl_entry.port_filter, port) xor bl_entry.in_blacklist;
+}
+
+/**
+ * \brief Function for checking blacklisted IPv4/IPv6 addresses.
+ *
+ * Source and destination addresses of the record are already matched to either
+ * address or prefix (see process_batch()). If the match is positive the field in the detection
+ * record is filled with the respective blacklist(s) number.
+ * \param ur_in  Template of input UniRec record.
+ * \param ur_out Template of detection UniRec record.
+ * \param record Record being analyzed.
+ * \param detected Detection record used if any address matches the blacklist.
+ * \param blacklist Blacklist with port restrictions and adaptive IDs of the entries.
+ * \param bl List of blacklisted prefixes of the address family of the record.
+ * \param src_result Position of the longest prefix in bl matching the source address (or IP_NOT_FOUND).
+ * \param dst_result Position of the longest prefix in bl matching the destination address (or IP_NOT_FOUND).
+ * \return BLACKLISTED if match was found otherwise ADDR_CLEAR.
+ */
+int blacklist_check(ur_template_t *ur_in,
+                    ur_template_t *ur_out,
+                    const void *record,
+                    void *detected,
+                    const ip_blacklist_t &blacklist,
+                    const black_list_t &bl,
+                    int src_result,
+                    int dst_result)
+{
+   // index of the matched prefix
+   int search_result;
+
+   // port-matching
+   uint16_t port;
+   uint64_t matched_bitfield;
+
+   // Check source IP
+   if ((search_result = src_result) != IP_NOT_FOUND) {
+      if (bl[search_result].in_blacklist == ADAPTIVE_BLACKLIST_INDEX) {
+         // Adaptive IP filter mode
+         ur_set_string(ur_out, detected, F_ADAPTIVE_IDS, ip_blacklist_adaptive_ids(blacklist, bl[search_result]));
+      } else {
+         ur_set_string(ur_out, detected, F_ADAPTIVE_IDS, "");
+      }
+
+      port = ur_get(ur_in, record, F_SRC_PORT);  // source IP was matched
+
+      matched_bitfield = check_ports_get_bitfield(blacklist.ports, bl[search_result], port);
+
+      if (matched_bitfield != 0) {
+         ur_set(ur_out, detected, F_SRC_BLACKLIST, matched_bitfield);
+         return BLACKLISTED;
+      }
+
+      ur_set(ur_out, detected, F_DST_BLACKLIST, 0x0);
+
+      // Check destination IP
+   } else if ((search_result = dst_result) != IP_NOT_FOUND) {
+      if (bl[search_result].in_blacklist == ADAPTIVE_BLACKLIST_INDEX) {
+         ur_set_string(ur_out, detected, F_ADAPTIVE_IDS, ip_blacklist_adaptive_ids(blacklist, bl[search_result]));
+      } else {
+         ur_set_string(ur_out, detected, F_ADAPTIVE_IDS, "");
+      }
+
+      port = ur_get(ur_in, record, F_DST_PORT);  // dest IP was matched - mirrored
+
+      matched_bitfield = check_ports_get_bitfield(blacklist.ports, bl[search_result], port);
+
+      if (matched_bitfield != 0) {
+         ur_set(ur_out, detected, F_DST_BLACKLIST, matched_bitfield);
+         return BLACKLISTED;
+      }
+
+      ur_set(ur_out, detected, F_SRC_BLACKLIST, 0x0);
+
+   }
+
+   return ADDR_CLEAR;
+}
+
+/**
+ * \brief Function for processing a batch of received records.
+ *
+ * Addresses of all records are extracted first and looked up together, so that
+ * the memory accesses of independent lookups overlap. Then the records are checked
+ * and reported in the order they were received, as if they were processed one by one.
+ * \param ur_in  Template of input UniRec record.
+ * \param ur_out Template of detection UniRec record.
+ * \param detected Detection record used if any address matches the blacklist.
+ * \param batch Received records.
+ * \param blacklist Blacklisted prefixes to be compared with.
+ * \param output Detections to be sent.
+ */
+void process_batch(ur_template_t *ur_in,
+                   ur_template_t *ur_out,
+                   void *detected,
+                   ip_batch_t &batch,
+                   const ip_blacklist_t &blacklist,
+                   ip_output_t &output)
+{
+   const size_t count = batch.offsets.size();
+
+   batch.addrs[0].clear();
+   batch.addrs[1].clear();
+   batch.positions.resize(count);
+
+   // Extract addresses, both of them are looked up in the list of the source address family
+   for (size_t i = 0; i < count; i++) {
+      const void *record = &batch.data[batch.offsets[i]];
+      const int family = ip_is4(ur_get_ptr(ur_in, record, F_SRC_IP)) ? 0 : 1;
+
+      batch.positions[i] = batch.addrs[family].size();
+      batch.addrs[family].push_back(ur_get_ptr(ur_in, record, F_SRC_IP));
+      batch.addrs[family].push_back(ur_get_ptr(ur_in, record, F_DST_IP));
+   }
+
+   for (int family = 0; family < 2; family++) {
+      batch.results[family].resize(batch.addrs[family].size());
+      ip_lpm_lookup_batch(family == 0 ? blacklist.v4_index : blacklist.v6_index,
+                          batch.addrs[family].data(), batch.results[family].data(), batch.addrs[family].size());
+   }
+
+   // Report blacklisted records
+   for (size_t i = 0; i < count; i++) {
+      const void *record = &batch.data[batch.offsets[i]];
+      const int family = ip_is4(ur_get_ptr(ur_in, record, F_SRC_IP)) ? 0 : 1;
+      const int *results = &batch.results[family][batch.positions[i]];
+
+      if (blacklist_check(ur_in, ur_out, record, detected, blacklist, family == 0 ? blacklist.v4_list : blacklist.v6_list,
+                          results[0], results[1]) == BLACKLISTED) {
+         ur_copy_fields(ur_out, detected, ur_in, record);
+         const uint16_t size = ur_rec_size(ur_out, detected);
+         output.data.insert(output.data.end(), (const char *) detected, (const char *) detected + size);
+         output.sizes.push_back(size);
+         DBG((stderr, "IP detected on blacklist\n"))
+      }
+   }
+}
+
+/**
+ * \brief Function for checking if incoming flow has src/dst port 53.
+ */
+bool is_dns_traffic(ur_template_t *ur_in, const void *data)
+{
+   uint16_t src_port = ur_get(ur_in, data, F_SRC_PORT);
+   uint16_t dst_port = ur_get(ur_in, data, F_DST_PORT);
+   return (src_port == 53) || (dst_port == 53);
+}
@@ -0,0 +1,147 @@
+/**
+ * \file ip_port_table.cpp
+ * \brief Shared table of port restrictions of blacklist entries.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+
+#include "ip_port_table.h"
+
+/**
+ * \brief Stores a port list in the pool unless the same list is already there.
+ * \param builder Pool being filled.
+ * \param ports Sorted ports.
+ * \return Rule referring to the list (without the blacklist bit).
+ */
+static ip_port_rule_t store_list(ip_port_table_builder_t &builder, const std::vector<uint16_t> &ports)
+{
+   auto it = builder.lists.find(ports);
+   if (it != builder.lists.end()) {
+      return it->second;
+   }
+
+   ip_port_rule_t rule;
+   rule.bit = 0;
+   rule.count = ports.size();
+
+   if (rule.count > PORT_LIST_MAX) {
+      rule.offset = builder.bitmaps.size();
+      builder.bitmaps.resize(builder.bitmaps.size() + PORT_BITMAP_WORDS, 0);
+      for (const uint16_t port: ports) {
+         builder.bitmaps[rule.offset + (port >> 6)] |= 1ULL << (port & 63);
+      }
+   } else {
+      rule.offset = builder.values.size();
+      builder.values.insert(builder.values.end(), ports.begin(), ports.end());
+   }
+
+   builder.lists[ports] = rule;
+   return rule;
+}
+
+/**
+ * \brief Function for adding port restrictions of an entry to the pool.
+ * Blacklists are numbered from 1, numbers out of the 64-bit field are ignored.
+ * \param builder Pool being filled, shared by all entries of the blacklist.
+ * \param bl_ports Ports of the restricted blacklists of the entry.
+ * \return Index of the filter or NO_PORT_FILTER if the entry has no (valid) restriction.
+ */
+uint32_t ip_port_table_add(ip_port_table_builder_t &builder, const std::map<int, std::set<int>> &bl_ports)
+{
+   std::vector<ip_port_rule_t> rules;
+   std::vector<uint64_t> key;
+
+   for (const auto &blacklist: bl_ports) {
+      if (blacklist.first <= 0 || blacklist.first > 63) {
+         continue;
+      }
+
+      const std::vector<uint16_t> ports(blacklist.second.begin(), blacklist.second.end());
+      ip_port_rule_t rule = store_list(builder, ports);
+      rule.bit = 1ULL << (blacklist.first - 1);
+
+      rules.push_back(rule);
+      key.push_back(rule.bit);
+      key.push_back(((uint64_t) rule.offset << 32) | rule.count);
+   }
+
+   if (rules.empty()) {
+      return NO_PORT_FILTER;
+   }
+
+   auto it = builder.filter_ids.find(key);
+   if (it != builder.filter_ids.end()) {
+      return it->second;
+   }
+
+   ip_port_filter_t filter;
+   filter.first = builder.rules.size();
+   filter.count = rules.size();
+   builder.rules.insert(builder.rules.end(), rules.begin(), rules.end());
+   builder.filters.push_back(filter);
+
+   builder.filter_ids[key] = builder.filters.size() - 1;
+   return builder.filters.size() - 1;
+}
+
+/**
+ * \brief Function for moving the filled pool to the table, the builder is emptied.
+ * \param table Pool of port restrictions.
+ * \param builder Filled pool.
+ */
+void ip_port_table_finish(ip_port_table_t &table, ip_port_table_builder_t &builder)
+{
+   table.filters.assign(std::move(builder.filters));
+   table.rules.assign(std::move(builder.rules));
+   table.values.assign(std::move(builder.values));
+   table.bitmaps.assign(std::move(builder.bitmaps));
+   builder.lists.clear();
+   builder.filter_ids.clear();
+}
+
+/**
+ * \brief Function returning approximate memory footprint of the pool.
+ * \param table Pool of port restrictions.
+ * \return Size of the pool in bytes (not counting arrays of a mapped snapshot).
+ */
+size_t ip_port_table_memory(const ip_port_table_t &table)
+{
+   return table.filters.memory() + table.rules.memory() + table.values.memory() + table.bitmaps.memory();
+}
@@ -0,0 +1,175 @@
+/**
+ * \file ip_port_table.h
+ * \brief Shared table of port restrictions of blacklist entries, header file.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+
+#ifndef BLACKLISTFILTER_IP_PORT_TABLE_H
+#define BLACKLISTFILTER_IP_PORT_TABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <set>
+#include <vector>
+#include "mapped_array.h"
+
+/*
+ * Blacklist entries may restrict some of their blacklists to a list of ports.
+ * Entries without such a restriction store nothing, the others point to a filter,
+ * i.e. a run of rules, one per restricted blacklist. Every rule refers to a port
+ * list shared by all rules with the same ports. Short lists are kept sorted in
+ * a common pool, long ones are expanded to a bitmap of all 65536 ports.
+ * Identical filters are stored only once.
+ */
+
+/**
+ * Filter index of entries without port restrictions.
+ */
+#define NO_PORT_FILTER UINT32_MAX
+
+/**
+ * Port lists longer than this are stored as bitmaps.
+ */
+#define PORT_LIST_MAX 16
+
+/**
+ * Number of 64-bit words of a port bitmap.
+ */
+#define PORT_BITMAP_WORDS (65536 / 64)
+
+/**
+ * Restriction of one blacklist to a list of ports.
+ */
+typedef struct {
+   uint64_t bit;    /**< Bit of the restricted blacklist */
+   uint32_t offset; /**< Offset of the ports in values, or of the bitmap in bitmaps */
+   uint32_t count;  /**< Number of ports, they are stored in a bitmap if count > PORT_LIST_MAX */
+} ip_port_rule_t;
+
+/**
+ * Port restrictions of one blacklist entry.
+ */
+typedef struct {
+   uint32_t first; /**< Index of the first rule */
+   uint32_t count; /**< Number of rules */
+} ip_port_filter_t;
+
+/**
+ * Pool of port restrictions of all entries of a blacklist.
+ */
+typedef struct {
+   MappedArray<ip_port_filter_t> filters; /**< Filters referenced by the entries */
+   MappedArray<ip_port_rule_t> rules;     /**< Rules of the filters */
+   MappedArray<uint16_t> values;          /**< Sorted short port lists */
+   MappedArray<uint64_t> bitmaps;         /**< Long port lists, PORT_BITMAP_WORDS words each */
+} ip_port_table_t;
+
+/**
+ * Pool being filled, with lookup tables to share identical lists and filters.
+ */
+typedef struct {
+   std::vector<ip_port_filter_t> filters;                 /**< Filters referenced by the entries */
+   std::vector<ip_port_rule_t> rules;                     /**< Rules of the filters */
+   std::vector<uint16_t> values;                          /**< Sorted short port lists */
+   std::vector<uint64_t> bitmaps;                         /**< Long port lists, PORT_BITMAP_WORDS words each */
+   std::map<std::vector<uint16_t>, ip_port_rule_t> lists; /**< Stored port lists (bit is not used) */
+   std::map<std::vector<uint64_t>, uint32_t> filter_ids;  /**< Stored filters by their rules */
+} ip_port_table_builder_t;
+
+/**
+ * Function for adding port restrictions of an entry to the pool being filled.
+ */
+uint32_t ip_port_table_add(ip_port_table_builder_t &builder, const std::map<int, std::set<int>> &bl_ports);
+
+/**
+ * Function for moving the filled pool to the table.
+ */
+void ip_port_table_finish(ip_port_table_t &table, ip_port_table_builder_t &builder);
+
+/**
+ * Function returning approximate memory footprint of the pool in bytes.
+ */
+size_t ip_port_table_memory(const ip_port_table_t &table);
+
+/**
+ * \brief Checks whether the port is in the list of the rule.
+ * \param table Pool of port restrictions.
+ * \param rule Rule.
+ * \param port Port.
+ * \return True if the port is listed.
+ */
+static inline bool ip_port_rule_match(const ip_port_table_t &table, const ip_port_rule_t &rule, uint16_t port)
+{
+   if (rule.count > PORT_LIST_MAX) {
+      return (table.bitmaps[rule.offset + (port >> 6)] >> (port & 63)) & 1;
+   }
+
+   const uint16_t *values = &table.values[rule.offset];
+   for (uint32_t i = 0; i < rule.count && values[i] <= port; i++) {
+      if (values[i] == port) {
+         return true;
+      }
+   }
+   return false;
+}
+
+/**
+ * \brief Finds the restricted blacklists which do not list the port.
+ * \param table Pool of port restrictions.
+ * \param filter Filter of the entry (not NO_PORT_FILTER).
+ * \param port Port.
+ * \return Bit field of blacklists not matching the port.
+ */
+static inline uint64_t ip_port_table_unmatched(const ip_port_table_t &table, uint32_t filter, uint16_t port)
+{
+   const ip_port_filter_t &f = table.filters[filter];
+   uint64_t unmatched = 0;
+
+   for (uint32_t i = f.first; i < f.first + f.count; i++) {
+      if (!ip_port_rule_match(table, table.rules[i], port)) {
+         unmatched |= table.rules[i].bit;
+      }
+   }
+   return unmatched;
+}
+
+#endif /* BLACKLISTFILTER_IP_PORT_TABLE_H */
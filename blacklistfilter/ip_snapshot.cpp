@@ -0,0 +1,413 @@
+/**
+ * \file ip_snapshot.cpp
+ * \brief Binary snapshot of compiled IP blacklists.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "ip_snapshot.h"
+
+#ifdef DEBUG
+#define DBG(x) fprintf x;
+#else
+#define DBG(x)
+#endif
+
+using namespace std;
+
+/**
+ * Initial value of the hash (FNV-1a 64-bit offset basis).
+ */
+#define SNAPSHOT_HASH_INIT 0xcbf29ce484222325ULL
+
+/**
+ * Multiplier of the hash (FNV-1a 64-bit prime).
+ */
+#define SNAPSHOT_HASH_PRIME 0x100000001b3ULL
+
+/**
+ * Size of the buffer for hashing the blacklist files.
+ */
+#define SNAPSHOT_READ_BUFFER (1 << 20)
+
+/**
+ * \brief Continues FNV-1a hash of data, 8 bytes are hashed at once (the tail byte by byte).
+ * The result depends on how the data are split, callers have to split them the same way.
+ * \param hash Hash of the previous data.
+ * \param data Data.
+ * \param len Length of the data.
+ * \return Hash including the data.
+ */
+static uint64_t snapshot_hash(uint64_t hash, const char *data, size_t len)
+{
+   size_t i = 0;
+
+   for (; i + 8 <= len; i += 8) {
+      uint64_t word;
+      memcpy(&word, data + i, 8);
+      hash = (hash ^ word) * SNAPSHOT_HASH_PRIME;
+   }
+   for (; i < len; i++) {
+      hash = (hash ^ (uint8_t) data[i]) * SNAPSHOT_HASH_PRIME;
+   }
+   return hash;
+}
+
+/**
+ * \brief Computes size and hash of a blacklist file.
+ * \param file Name of the file.
+ * \param source Identification of the file, size is UINT64_MAX if the file cannot be read.
+ */
+static void snapshot_source(const char *file, ip_snapshot_source_t &source)
+{
+   source.size = UINT64_MAX;
+   source.hash = SNAPSHOT_HASH_INIT;
+
+   FILE *f = fopen(file, "rb");
+   if (f == nullptr) {
+      return;
+   }
+
+   vector<char> buffer(SNAPSHOT_READ_BUFFER);
+   uint64_t size = 0;
+   size_t len;
+
+   while ((len = fread(buffer.data(), 1, buffer.size(), f)) > 0) {
+      source.hash = snapshot_hash(source.hash, buffer.data(), len);
+      size += len;
+   }
+   if (!ferror(f)) {
+      source.size = size;
+   }
+   fclose(f);
+}
+
+/**
+ * \brief Appends an array as a new section of the snapshot.
+ * \param image Snapshot being written.
+ * \param id Section.
+ * \param array Array.
+ */
+template <typename T>
+static void snapshot_add_section(vector<char> &image, int id, const MappedArray<T> &array)
+{
+   image.resize((image.size() + IP_SNAPSHOT_ALIGN - 1) / IP_SNAPSHOT_ALIGN * IP_SNAPSHOT_ALIGN, 0);
+
+   ip_snapshot_section_t section;
+   section.offset = image.size();
+   section.count = array.size();
+   section.item_size = sizeof(T);
+   section.reserved = 0;
+   memcpy(&((ip_snapshot_header_t *) image.data())->sections[id], &section, sizeof(section));
+
+   image.insert(image.end(), (const char *) array.begin(), (const char *) array.end());
+}
+
+/**
+ * \brief Points an array to its section of the mapped snapshot.
+ * \param header Header of the snapshot, sections were checked to be within the file.
+ * \param id Section.
+ * \param array Array.
+ * \return False if the section does not hold items of the array.
+ */
+template <typename T>
+static bool snapshot_map_section(const ip_snapshot_header_t *header, int id, MappedArray<T> &array)
+{
+   const ip_snapshot_section_t &section = header->sections[id];
+
+   if (section.item_size != sizeof(T) || section.offset % IP_SNAPSHOT_ALIGN != 0) {
+      return false;
+   }
+   array.map((const T *) ((const char *) header + section.offset), section.count);
+   return true;
+}
+
+/**
+ * \brief Checks that all indexes in the index point within its arrays, so that lookups
+ * cannot read past them.
+ * \param lpm Index.
+ * \param entries Number of blacklist entries the leaves refer to.
+ * \return True if the index is consistent.
+ */
+static bool snapshot_check_index(const ip_lpm_t &lpm, size_t entries)
+{
+   if (lpm.direct.empty()) {
+      return lpm.nodes.empty() && lpm.leaves.empty();
+   }
+   if (lpm.direct.size() != (1U << LPM_DIRECT_BITS)) {
+      return false;
+   }
+
+   for (const uint32_t d: lpm.direct) {
+      if ((d & LPM_NODE_FLAG) ? (d & ~LPM_NODE_FLAG) >= lpm.nodes.size() : d > entries) {
+         return false;
+      }
+   }
+   for (size_t i = 0; i < lpm.nodes.size(); i++) {
+      const ip_lpm_node_t &node = lpm.nodes[i];
+      // children are stored after their parent, so the lookup cannot loop
+      if (node.vector != 0 && (node.base1 <= i ||
+                               node.base1 + __builtin_popcountll(node.vector) > lpm.nodes.size())) {
+         return false;
+      }
+      if (node.base0 + __builtin_popcountll(node.leafvec) > lpm.leaves.size()) {
+         return false;
+      }
+      // every leaf slot has to be preceded (or started) by a run of leaves
+      if (~node.vector != 0 && (node.leafvec == 0 || __builtin_ctzll(node.leafvec) > __builtin_ctzll(~node.vector))) {
+         return false;
+      }
+   }
+   for (const uint32_t leaf: lpm.leaves) {
+      if (leaf > entries) {
+         return false;
+      }
+   }
+   return true;
+}
+
+/**
+ * \brief Checks that entries refer to existing port filters and adaptive IDs
+ * and that the port filters refer to existing port lists.
+ * \param blacklist Mapped blacklist.
+ * \return True if the blacklist is consistent.
+ */
+static bool snapshot_check_entries(const ip_blacklist_t &blacklist)
+{
+   const ip_port_table_t &ports = blacklist.ports;
+
+   if (blacklist.adaptive_id_offsets.empty() || blacklist.adaptive_id_chars.empty() ||
+       blacklist.adaptive_id_chars[blacklist.adaptive_id_chars.size() - 1] != '\0') {
+      return false;
+   }
+   for (const uint32_t offset: blacklist.adaptive_id_offsets) {
+      if (offset >= blacklist.adaptive_id_chars.size()) {
+         return false;
+      }
+   }
+
+   for (const black_list_t *list: {&blacklist.v4_list, &blacklist.v6_list}) {
+      for (const ip_bl_entry_t &entry: *list) {
+         if (entry.adaptive_id >= blacklist.adaptive_id_offsets.size() ||
+             (entry.port_filter != NO_PORT_FILTER && entry.port_filter >= ports.filters.size())) {
+            return false;
+         }
+      }
+   }
+
+   for (const ip_port_filter_t &filter: ports.filters) {
+      if ((uint64_t) filter.first + filter.count > ports.rules.size()) {
+         return false;
+      }
+   }
+   for (const ip_port_rule_t &rule: ports.rules) {
+      if (rule.count > PORT_LIST_MAX ? (uint64_t) rule.offset + PORT_BITMAP_WORDS > ports.bitmaps.size()
+                                     : (uint64_t) rule.offset + rule.count > ports.values.size()) {
+         return false;
+      }
+   }
+   return true;
+}
+
+/**
+ * \brief Function checking whether the configuration specifies a snapshot.
+ * \param config Configuration.
+ * \return True if the snapshot file is set.
+ */
+bool ip_snapshot_configured(const ip_config_t *config)
+{
+   return config->snapshot_file[0] != '\0' && strcmp(config->snapshot_file, "-") != 0;
+}
+
+/**
+ * \brief Function for writing the snapshot. The snapshot is written to a temporary file
+ * and renamed, so filters which have the previous snapshot mapped are not affected.
+ * \param blacklist Blacklist loaded from the files of the configuration.
+ * \param config Configuration with the blacklist files.
+ * \param file Name of the snapshot.
+ * \return ALL_OK if everything goes well, BLIST_FILE_ERROR if the snapshot cannot be written.
+ */
+int ip_snapshot_write(const ip_blacklist_t &blacklist, const ip_config_t *config, const char *file)
+{
+   vector<char> image(sizeof(ip_snapshot_header_t), 0);
+   ip_snapshot_header_t header;
+
+   snapshot_add_section(image, SNAP_V4_LIST, blacklist.v4_list);
+   snapshot_add_section(image, SNAP_V6_LIST, blacklist.v6_list);
+   snapshot_add_section(image, SNAP_V4_DIRECT, blacklist.v4_index.direct);
+   snapshot_add_section(image, SNAP_V4_NODES, blacklist.v4_index.nodes);
+   snapshot_add_section(image, SNAP_V4_LEAVES, blacklist.v4_index.leaves);
+   snapshot_add_section(image, SNAP_V6_DIRECT, blacklist.v6_index.direct);
+   snapshot_add_section(image, SNAP_V6_NODES, blacklist.v6_index.nodes);
+   snapshot_add_section(image, SNAP_V6_LEAVES, blacklist.v6_index.leaves);
+   snapshot_add_section(image, SNAP_PORT_FILTERS, blacklist.ports.filters);
+   snapshot_add_section(image, SNAP_PORT_RULES, blacklist.ports.rules);
+   snapshot_add_section(image, SNAP_PORT_VALUES, blacklist.ports.values);
+   snapshot_add_section(image, SNAP_PORT_BITMAPS, blacklist.ports.bitmaps);
+   snapshot_add_section(image, SNAP_ADAPTIVE_OFFSETS, blacklist.adaptive_id_offsets);
+   snapshot_add_section(image, SNAP_ADAPTIVE_CHARS, blacklist.adaptive_id_chars);
+
+   memcpy(&header, image.data(), sizeof(header));
+   memcpy(header.magic, IP_SNAPSHOT_MAGIC, sizeof(header.magic));
+   header.version = IP_SNAPSHOT_VERSION;
+   header.byte_order = IP_SNAPSHOT_BYTE_ORDER;
+   header.size = image.size();
+   header.checksum = snapshot_hash(SNAPSHOT_HASH_INIT, image.data() + sizeof(header), image.size() - sizeof(header));
+   snapshot_source(config->ipv4_blacklist_file, header.sources[0]);
+   snapshot_source(config->ipv6_blacklist_file, header.sources[1]);
+   memcpy(image.data(), &header, sizeof(header));
+
+   const string tmp_file = string(file) + ".tmp";
+   FILE *f = fopen(tmp_file.c_str(), "wb");
+   if (f == nullptr) {
+      cerr << "ERROR: Cannot create snapshot file: " << tmp_file << endl;
+      return BLIST_FILE_ERROR;
+   }
+
+   const bool written = fwrite(image.data(), 1, image.size(), f) == image.size() && fflush(f) == 0 && fsync(fileno(f)) == 0;
+   if (fclose(f) != 0 || !written || rename(tmp_file.c_str(), file) != 0) {
+      cerr << "ERROR: Cannot write snapshot file: " << file << endl;
+      unlink(tmp_file.c_str());
+      return BLIST_FILE_ERROR;
+   }
+
+   DBG((stderr, "Snapshot written: %s, %lu B\n", file, image.size()));
+   return ALL_OK;
+}
+
+/**
+ * \brief Function for mapping the blacklists from the snapshot. The snapshot is verified
+ * and used only if it was compiled from the current content of the configured blacklist files.
+ * \param blacklist Blacklist to be filled, it is left untouched on error.
+ * \param config Configuration with the blacklist files.
+ * \param file Name of the snapshot.
+ * \return ALL_OK if everything goes well, BLIST_FILE_ERROR if the snapshot cannot be used.
+ */
+int ip_snapshot_load(ip_blacklist_t &blacklist, const ip_config_t *config, const char *file)
+{
+   ip_blacklist_t new_blacklist;
+   struct stat st;
+
+   int fd = open(file, O_RDONLY);
+   if (fd < 0) {
+      cerr << "Warning: Cannot open snapshot file: " << file << endl;
+      return BLIST_FILE_ERROR;
+   }
+   if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(ip_snapshot_header_t) ||
+       !new_blacklist.snapshot.map(fd, st.st_size)) {
+      cerr << "Warning: Cannot map snapshot file: " << file << endl;
+      close(fd);
+      return BLIST_FILE_ERROR;
+   }
+   // the mapping stays valid after the file is closed (or replaced by a new snapshot)
+   close(fd);
+
+   const char *data = new_blacklist.snapshot.data();
+   const size_t size = new_blacklist.snapshot.size();
+   const ip_snapshot_header_t *header = (const ip_snapshot_header_t *) data;
+
+   if (memcmp(header->magic, IP_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+       header->version != IP_SNAPSHOT_VERSION || header->byte_order != IP_SNAPSHOT_BYTE_ORDER) {
+      cerr << "Warning: Snapshot '" << file << "' has unsupported format or version" << endl;
+      return BLIST_FILE_ERROR;
+   }
+   if (header->size != size ||
+       header->checksum != snapshot_hash(SNAPSHOT_HASH_INIT, data + sizeof(*header), size - sizeof(*header))) {
+      cerr << "Warning: Snapshot '" << file << "' is truncated or corrupted" << endl;
+      return BLIST_FILE_ERROR;
+   }
+   for (int i = 0; i < IP_SNAPSHOT_SECTIONS; i++) {
+      const ip_snapshot_section_t &section = header->sections[i];
+      if (section.offset < sizeof(*header) || section.offset > size ||
+          section.item_size == 0 || section.count > (size - section.offset) / section.item_size) {
+         cerr << "Warning: Snapshot '" << file << "' has invalid section " << i << endl;
+         return BLIST_FILE_ERROR;
+      }
+   }
+
+   ip_snapshot_source_t sources[2];
+   snapshot_source(config->ipv4_blacklist_file, sources[0]);
+   snapshot_source(config->ipv6_blacklist_file, sources[1]);
+   for (int i = 0; i < 2; i++) {
+      if (sources[i].size != header->sources[i].size || sources[i].hash != header->sources[i].hash) {
+         cerr << "Warning: Snapshot '" << file << "' is older than the blacklist files" << endl;
+         return BLIST_FILE_ERROR;
+      }
+   }
+
+   new_blacklist.v4_index.is_v6 = false;
+   new_blacklist.v6_index.is_v6 = true;
+
+   if (!snapshot_map_section(header, SNAP_V4_LIST, new_blacklist.v4_list) ||
+       !snapshot_map_section(header, SNAP_V6_LIST, new_blacklist.v6_list) ||
+       !snapshot_map_section(header, SNAP_V4_DIRECT, new_blacklist.v4_index.direct) ||
+       !snapshot_map_section(header, SNAP_V4_NODES, new_blacklist.v4_index.nodes) ||
+       !snapshot_map_section(header, SNAP_V4_LEAVES, new_blacklist.v4_index.leaves) ||
+       !snapshot_map_section(header, SNAP_V6_DIRECT, new_blacklist.v6_index.direct) ||
+       !snapshot_map_section(header, SNAP_V6_NODES, new_blacklist.v6_index.nodes) ||
+       !snapshot_map_section(header, SNAP_V6_LEAVES, new_blacklist.v6_index.leaves) ||
+       !snapshot_map_section(header, SNAP_PORT_FILTERS, new_blacklist.ports.filters) ||
+       !snapshot_map_section(header, SNAP_PORT_RULES, new_blacklist.ports.rules) ||
+       !snapshot_map_section(header, SNAP_PORT_VALUES, new_blacklist.ports.values) ||
+       !snapshot_map_section(header, SNAP_PORT_BITMAPS, new_blacklist.ports.bitmaps) ||
+       !snapshot_map_section(header, SNAP_ADAPTIVE_OFFSETS, new_blacklist.adaptive_id_offsets) ||
+       !snapshot_map_section(header, SNAP_ADAPTIVE_CHARS, new_blacklist.adaptive_id_chars) ||
+       !snapshot_check_index(new_blacklist.v4_index, new_blacklist.v4_list.size()) ||
+       !snapshot_check_index(new_blacklist.v6_index, new_blacklist.v6_list.size()) ||
+       !snapshot_check_entries(new_blacklist)) {
+      cerr << "Warning: Snapshot '" << file << "' is not consistent" << endl;
+      return BLIST_FILE_ERROR;
+   }
+
+   blacklist = move(new_blacklist);
+
+   DBG((stderr, "Blacklists mapped from snapshot %s. Entries: IP4: %lu, IP6: %lu, size: %lu B\n",
+        file, blacklist.v4_list.size(), blacklist.v6_list.size(), blacklist.snapshot.size()));
+
+   return ALL_OK;
+}
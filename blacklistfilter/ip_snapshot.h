@@ -0,0 +1,152 @@
+/**
+ * \file ip_snapshot.h
+ * \brief Binary snapshot of compiled IP blacklists, header file.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+
+#ifndef BLACKLISTFILTER_IP_SNAPSHOT_H
+#define BLACKLISTFILTER_IP_SNAPSHOT_H
+
+#include <stdint.h>
+#include "ipblacklistfilter.h"
+
+/*
+ * The snapshot is an image of ip_blacklist_t compiled from the blacklist files
+ * (see ipblacklist_snapshot). All arrays are stored as they are in memory, so the
+ * filter maps the file read-only and points the arrays into the mapping instead of
+ * parsing the files and building the index. Instances of the filter mapping the same
+ * snapshot share its pages.
+ *
+ * The file starts with ip_snapshot_header_t and is followed by the sections, each
+ * aligned to IP_SNAPSHOT_ALIGN bytes. The header records the size and hash of the
+ * blacklist files the snapshot was compiled from, the snapshot is used only while
+ * they did not change. The format follows the in-memory layout of the host,
+ * IP_SNAPSHOT_VERSION has to be increased whenever one of the stored structures changes.
+ */
+
+/**
+ * Magic string at the beginning of the snapshot.
+ */
+#define IP_SNAPSHOT_MAGIC "NBLSNAP"
+
+/**
+ * Version of the snapshot format.
+ */
+#define IP_SNAPSHOT_VERSION 1
+
+/**
+ * Marker of the byte order of the host which wrote the snapshot.
+ */
+#define IP_SNAPSHOT_BYTE_ORDER 0x01020304U
+
+/**
+ * Alignment of the sections in the file.
+ */
+#define IP_SNAPSHOT_ALIGN 64
+
+/**
+ * Sections of the snapshot, one for every array of ip_blacklist_t.
+ */
+enum {
+   SNAP_V4_LIST,
+   SNAP_V6_LIST,
+   SNAP_V4_DIRECT,
+   SNAP_V4_NODES,
+   SNAP_V4_LEAVES,
+   SNAP_V6_DIRECT,
+   SNAP_V6_NODES,
+   SNAP_V6_LEAVES,
+   SNAP_PORT_FILTERS,
+   SNAP_PORT_RULES,
+   SNAP_PORT_VALUES,
+   SNAP_PORT_BITMAPS,
+   SNAP_ADAPTIVE_OFFSETS,
+   SNAP_ADAPTIVE_CHARS,
+   IP_SNAPSHOT_SECTIONS
+};
+
+/**
+ * Location of an array in the snapshot.
+ */
+typedef struct {
+   uint64_t offset;    /**< Offset of the first item from the beginning of the file */
+   uint64_t count;     /**< Number of items */
+   uint32_t item_size; /**< Size of an item */
+   uint32_t reserved;  /**< Zero */
+} ip_snapshot_section_t;
+
+/**
+ * Identification of a blacklist file the snapshot was compiled from.
+ */
+typedef struct {
+   uint64_t size; /**< Size of the file, UINT64_MAX if it did not exist */
+   uint64_t hash; /**< Hash of the content of the file */
+} ip_snapshot_source_t;
+
+/**
+ * Header of the snapshot.
+ */
+typedef struct {
+   char magic[8];                   /**< IP_SNAPSHOT_MAGIC */
+   uint32_t version;                /**< IP_SNAPSHOT_VERSION */
+   uint32_t byte_order;             /**< IP_SNAPSHOT_BYTE_ORDER */
+   uint64_t size;                   /**< Size of the whole file */
+   uint64_t checksum;               /**< Hash of everything after the header */
+   ip_snapshot_source_t sources[2]; /**< IPv4 and IPv6 blacklist files */
+   ip_snapshot_section_t sections[IP_SNAPSHOT_SECTIONS]; /**< Arrays */
+} ip_snapshot_header_t;
+
+/**
+ * Function checking whether the configuration specifies a snapshot.
+ */
+bool ip_snapshot_configured(const ip_config_t *config);
+
+/**
+ * Function for writing the snapshot of blacklists loaded from the configured files.
+ */
+int ip_snapshot_write(const ip_blacklist_t &blacklist, const ip_config_t *config, const char *file);
+
+/**
+ * Function for mapping the blacklists from the snapshot.
+ */
+int ip_snapshot_load(ip_blacklist_t &blacklist, const ip_config_t *config, const char *file);
+
+#endif /* BLACKLISTFILTER_IP_SNAPSHOT_H */
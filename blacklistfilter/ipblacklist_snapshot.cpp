@@ -0,0 +1,126 @@
+/**
+ * \file ipblacklist_snapshot.cpp
+ * \brief Tool compiling IP blacklist files into a snapshot for IPBlacklistFilter.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+
+#include <iostream>
+#include <cstring>
+#include <getopt.h>
+#include "ipblacklistfilter.h"
+#include "ip_snapshot.h"
+
+using namespace std;
+
+/**
+ * \brief Prints usage of the tool.
+ * \param name Name of the program.
+ */
+static void usage(const char *name)
+{
+   cerr << "Usage: " << name << " -4 <ipv4_blacklist_file> [-6 <ipv6_blacklist_file>] -o <snapshot_file>" << endl
+        << "Compiles blacklist files prepared by blacklist downloader into a snapshot, which" << endl
+        << "ipblacklistfilter maps directly instead of parsing the files." << endl;
+}
+
+/**
+ * \brief Copies a file name to the configuration.
+ * \param dst Item of the configuration.
+ * \param src File name.
+ * \return False if the name is too long.
+ */
+static bool set_file(char (&dst)[256], const char *src)
+{
+   if (strlen(src) >= sizeof(dst)) {
+      cerr << "Error: File name too long: " << src << endl;
+      return false;
+   }
+   strcpy(dst, src);
+   return true;
+}
+
+int main(int argc, char **argv)
+{
+   ip_config_t config;
+   ip_blacklist_t blacklist;
+   const char *snapshot_file = nullptr;
+   int opt;
+
+   memset(&config, 0, sizeof(config));
+
+   while ((opt = getopt(argc, argv, "4:6:o:h")) != -1) {
+      switch (opt) {
+      case '4':
+         if (!set_file(config.ipv4_blacklist_file, optarg)) {
+            return 1;
+         }
+         break;
+      case '6':
+         if (!set_file(config.ipv6_blacklist_file, optarg)) {
+            return 1;
+         }
+         break;
+      case 'o':
+         snapshot_file = optarg;
+         break;
+      default:
+         usage(argv[0]);
+         return opt == 'h' ? 0 : 1;
+      }
+   }
+
+   if (config.ipv4_blacklist_file[0] == '\0' || snapshot_file == nullptr) {
+      usage(argv[0]);
+      return 1;
+   }
+
+   if (load_blacklist_files(blacklist, &config) != ALL_OK) {
+      return 1;
+   }
+
+   if (ip_snapshot_write(blacklist, &config, snapshot_file) != ALL_OK) {
+      return 1;
+   }
+
+   cout << "Snapshot " << snapshot_file << " written, entries: IP4: " << blacklist.v4_list.size()
+        << ", IP6: " << blacklist.v6_list.size() << endl;
+   return 0;
+}
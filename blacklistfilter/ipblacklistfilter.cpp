@@ -46,6 +46,7 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <algorithm>
 #include <iostream>
 #include <fstream>
@@ -73,6 +74,10 @@
 #include "ipblacklistfilter.h"
 #include "fields.h"
 #include "blacklist_watcher.h"
+#include "rcu_pointer.h"
+#include "metrics.h"
+#include "overload.h"
+#include "affinity.h"
 
 UR_FIELDS(
 //BASIC_FLOW
@@ -107,13 +112,21 @@ trap_module_info_t *module_info = NULL;
     "This module uses configurator tool. To specify files with blacklists (prepared by blacklist downloader) " \
     "use XML configuration file for IPBlacklistFilter (ipdetect_config.xml). " \
     "To show, edit, add or remove public blacklist information, use XML configuration file for " \
-    "blacklist downloader (bl_downloader_config.xml).", 1, 1)
+    "blacklist downloader (bl_downloader_config.xml). " \
+    "The module accepts one or more input interfaces, records from all of them are checked " \
+    "by a pool of worker threads and reported to the output interface.", -1, 1)
 
 #define MODULE_PARAMS(PARAM) \
   PARAM('c', "", "Specify user configuration file for IPBlacklistFilter. [Default: " SYSCONFDIR "/blacklistfilter/ipdetect_config.xml]", required_argument, "string") \
   PARAM('4', "", "Specify IPv4 blacklist file (overrides config file). [Default: /tmp/blacklistfilter/ip4.blist]", required_argument, "string") \
   PARAM('6', "", "Specify IPv6 blacklist file (overrides config file). [Default: /tmp/blacklistfilter/ip6.blist]", required_argument, "string") \
-  PARAM('n', "", "Do not send terminating Unirec when exiting program.", no_argument, "none")
+  PARAM('s', "", "Specify snapshot compiled from the blacklist files by ipblacklist_snapshot (overrides config file).", required_argument, "string") \
+  PARAM('n', "", "Do not send terminating Unirec when exiting program.", no_argument, "none") \
+  PARAM('b', "", "Number of records looked up together, 1 disables batching. [Default: 32]", required_argument, "uint32") \
+  PARAM('w', "", "Number of worker threads, at least one per input interface is used. [Default: 1]", required_argument, "uint32") \
+  PARAM('L', "", "Load (0-1] of a worker above which only flows of host pairs sampled by hash are looked up. [Default: disabled]", required_argument, "float") \
+  PARAM('m', "", "UNIX socket serving runtime metrics in Prometheus text format.", required_argument, "string") \
+  PARAM('a', "", "List of CPUs the workers are pinned to in turns, e.g. 0-3. [Default: not pinned]", required_argument, "string")
 
 using namespace std;
 
@@ -126,6 +139,15 @@ int BL_RELOAD_FLAG = 0;
 // Blacklist watcher flag. If set, the inotify based thread for watching blacklists is created
 static bool WATCH_BLACKLISTS_FLAG;
 
+// Currently used blacklist, the watcher thread replaces it when the blacklist files change
+static RcuPointer<ip_blacklist_t> BLACKLIST;
+
+// Workers send the detections of a whole batch at once under this lock
+static pthread_mutex_t OUTPUT_LOCK = PTHREAD_MUTEX_INITIALIZER;
+
+// UniRec field definitions are global, templates are updated under this lock
+static pthread_mutex_t TEMPLATE_LOCK = PTHREAD_MUTEX_INITIALIZER;
+
 /**
  * Procedure for handling signals SIGTERM and SIGINT (Ctrl-C)
  */
@@ -133,466 +155,192 @@ TRAP_DEFAULT_SIGNAL_HANDLER(stop = 1
 )
 
 /**
- * Function for swapping bits in byte.
- * \param in Input byte.
- * \return Byte with reversed bits.
+ * \brief Function for reloading blacklists in the background (called by the watcher thread).
+ * A new generation of the blacklist is loaded and indexed while the main loop keeps
+ * using the current one. It is then published and the old generation is freed
+ * once the main loop stops using it.
+ * \param arg Configuration with blacklist files.
+ * \return ALL_OK if the new blacklist was published, BLIST_FILE_ERROR otherwise.
  */
-inline uint8_t bit_endian_swap(uint8_t in)
+static int reload_blacklists_background(void *arg)
 {
-   in = (in & 0xF0) >> 4 | (in & 0x0F) << 4;
-   in = (in & 0xCC) >> 2 | (in & 0x33) << 2;
-   in = (in & 0xAA) >> 1 | (in & 0x55) << 1;
-   return in;
-}
-
+   ip_blacklist_t *blacklist = new ip_blacklist_t;
 
-/**
- * \brief Function for creating masks for IPv4 addresses. It fills the given
- * array with every possible netmask for IPv4 address.
- * \param m Array to be filled.
- */
-void create_v4_mask_map(ipv4_mask_map_t &m)
-{
-   // Explicitly inserted or else it will be 0xFFFFFFFF
-   m[0] = 0x00000000;
+   if (reload_blacklists(*blacklist, (const ip_config_t *) arg) == BLIST_FILE_ERROR) {
+      cerr << "ERROR: Unable to load update blacklist. Will use the old one instead." << endl;
+      delete blacklist;
+      return BLIST_FILE_ERROR;
+   }
 
-   for (int i = 1; i <= 32; i++) {
-      m[i] = (0xFFFFFFFF >> (32 - i));
+   BLACKLIST.publish(blacklist, &stop);
+   DBG((stderr, "New blacklist generation published\n"));
 
-      // Swap bits in each byte for compatibility with ip_addr_t structure
-      m[i] = (bit_endian_swap((m[i] & 0x000000FF) >> 0) << 0) |
-             (bit_endian_swap((m[i] & 0x0000FF00) >> 8) << 8) |
-             (bit_endian_swap((m[i] & 0x00FF0000) >> 16) << 16) |
-             (bit_endian_swap((m[i] & 0xFF000000) >> 24) << 24);
-   }
+   return ALL_OK;
 }
 
 /**
- * \brief Function for creating masks for IPv6 addresses. It fills the given
- * array with every possible netmask for IPv6 address.
- * \param m Array to be filled.
+ * \brief Function for hashing the pair of hosts of a flow, both directions of the communication have the same hash.
  */
-void create_v6_mask_map(ipv6_mask_map_t &m)
+static inline uint64_t hosts_hash(ur_template_t *ur_in, const void *data)
 {
-   // Explicitly inserted or else it will be 0xFF in every byte
-   m[0][0] = m[0][1] = 0;
-
-   for (int i = 1; i <= 128; i++) {
-      if (i < 64) {
-         m[i][0] = 0xFFFFFFFFFFFFFFFF >> (64 - i);
-         m[i][1] = 0x0;
-      } else {
-         m[i][0] = 0xFFFFFFFFFFFFFFFF;
-         m[i][1] = 0xFFFFFFFFFFFFFFFF >> (64 - i);
-      }
-   }
+   const ip_addr_t src = ur_get(ur_in, data, F_SRC_IP);
+   const ip_addr_t dst = ur_get(ur_in, data, F_DST_IP);
+   return src.ui64[0] ^ src.ui64[1] ^ dst.ui64[0] ^ dst.ui64[1];
 }
 
 /**
- * \brief Function for loading blacklists. It parses files with blacklisted IP
- * addresses (IPv6 blacklist file is optional.). The file shall be preprocessed by blacklist downloader
- * (no redundant whitespaces, forcing lowercase etc.)
- * Function also checks validity of line on which the IP address was found. Invalid of bad formatted lines
- * are ignored.
- * \param v4_list IPv4 vector to be filled
- * \param v6_list IPv6 vector to be filled
- * \param config Configuration with blacklist files.
- * \return ALL_OK if everything goes well, BLIST_FILE_ERROR if file cannot be accessed.
+ * \brief Function for receiving a batch of records, timeout ends the batch early.
+ * Workers sharing the input interface receive from it in turns, the lock of the interface
+ * is held only while a record is received and copied to the batch of the worker, because
+ * data from TRAP are valid only until the next receive. The record is checked after the
+ * lock is released.
+ * \param worker Worker receiving the records.
  */
-int reload_blacklists(black_list_t &v4_list, black_list_t &v6_list, const ip_config_t *config)
+static void receive_batch(ip_worker_t *worker)
 {
-   ifstream input;
-   string line, ip, bl_index_str;
-   uint64_t bl_index;      // blacklist ID is a 64bit map
-   int line_num = 0;
-   ip_bl_entry_t bl_entry; // black list entry associated with ip address
-
-   black_list_t v4_list_new;
-   black_list_t v6_list_new;
-
-   std::vector<char *> blacklist_files;
-   blacklist_files.push_back(((ip_config_t *) config)->ipv4_blacklist_file);
-   blacklist_files.push_back(((ip_config_t *) config)->ipv6_blacklist_file);
-
-   // Read the blacklist files
-   for (auto &file: blacklist_files) {
-      line_num = 0;
-      input.open(file, ifstream::in);
-
-      if (!input.is_open()) {
-         if (file == ((ip_config_t *) config)->ipv6_blacklist_file) {
-            // Do not terminate the program when IPv6 blacklist not present
-            cerr << "Warning: Could not read IPv6 blacklist, not detecting IPv6" << endl;
-            continue;
-         }
-         cerr << "ERROR: Cannot open blacklist file: " << config->ipv4_blacklist_file << ". Is the downloader running?"
-              << endl;
-         return BLIST_FILE_ERROR;
-      }
+   ip_input_t *input = worker->input;
+   ip_batch_t &batch = worker->batch;
+   std::string format;
 
-      while (!input.eof()) {
-         getline(input, line);
-         line_num++;
+   batch.data.clear();
+   batch.offsets.clear();
 
-         if (input.bad()) {
-            cerr << "ERROR: Failed reading blacklist file (getline badbit)" << endl;
-            input.close();
-            return BLIST_FILE_ERROR;
-         }
-
-         // Find IP-blacklist index separator
-         size_t comma_sep = line.find_first_of(',');
-
-         if (comma_sep == string::npos) {
-            if (line.empty()) {
-               // probably just newline at the end of file
-               continue;
-            }
-            // Blacklist index delimeter not found (bad format?), skip it
-            cerr << "WARNING: File '" << file << "' has bad formatted line number '" << line_num << "'" << endl;
-            continue;
-         }
-
-         // Parse IP
-         ip = line.substr(0, comma_sep);
-
-         // Are we loading prefix?
-         size_t slash_sep = ip.find_first_of('/');
-
-         if (slash_sep == string::npos) {
-            // IP only
-            if (!ip_from_str(ip.c_str(), &bl_entry.ip)) {
-               cerr << "WARNING: Invalid IP address in file '" << file << "' on line '" << line_num << "'" << endl;
-               continue;
-            }
-            if (ip_is4(&bl_entry.ip)) {
-               bl_entry.prefix_len = PREFIX_V4_DEFAULT;
-            } else {
-               bl_entry.prefix_len = PREFIX_V6_DEFAULT;
-            }
-
-         } else {
-            // IP prefix
-            if (!ip_from_str((ip.substr(0, slash_sep)).c_str(), &bl_entry.ip)) {
-               cerr << "WARNING: Invalid IP address in file '" << file << "' on line '" << line_num << "'" << endl;
-               continue;
-            }
-
-            ip.erase(0, slash_sep + 1);
-            bl_entry.prefix_len = (uint8_t) strtol(ip.c_str(), nullptr, 0);
-         }
-
-         // Parse blacklist ID
-         bl_index = strtoull((line.substr(comma_sep + 1, string::npos)).c_str(), NULL, 10);
-
-         // Determine blacklist
-         bl_entry.in_blacklist = bl_index;
-
-         // If handling adaptive blacklist, load adaptive IDs in the entity
-         if (bl_index == ADAPTIVE_BLACKLIST_INDEX) {
-            string id_part = line.substr(comma_sep + 1, string::npos);
-            size_t comma_sep2 = id_part.find_first_of(',');
-            id_part = id_part.substr(comma_sep2 + 1, string::npos);
-            bl_entry.adaptive_ids = id_part;
+   while (batch.offsets.size() < worker->batch_size && !stop && !input->end_of_input) {
+      const void *data;
+      uint16_t data_size = 0;
+      size_t offset = batch.data.size();
+      uint64_t format_changes;
+
+      // libtrap allows a single receiver of an interface, so only the receive and copy are serialized
+      pthread_mutex_lock(&input->lock);
+
+      // Retrieve data from sender, a new data format is announced to all workers of the interface
+      int retval = trap_recv(worker->ifc, &data, &data_size);
+      if (retval == TRAP_E_FORMAT_CHANGED) {
+         const char *spec = NULL;
+         uint8_t data_fmt;
+         if (trap_get_data_fmt(TRAPIFC_INPUT, worker->ifc, &data_fmt, &spec) != TRAP_E_OK) {
+            pthread_mutex_unlock(&input->lock);
+            cerr << "Error: Data format of input interface " << worker->ifc << " was not loaded" << endl;
+            input->end_of_input = true;
+            break;
          }
+         input->format = spec;
+         input->format_changes++;
+         retval = TRAP_E_OK;
+      }
+      if (retval == TRAP_E_OK) {
+         batch.data.insert(batch.data.end(), (const char *) data, (const char *) data + data_size);
+      }
+      format_changes = input->format_changes;
+      if (worker->format_changes != format_changes) {
+         format = input->format;
+      }
 
-         // blacklist:[ports] parsing
-         uint16_t bl_num;
-         uint16_t port;
-
-         size_t bl_semicolon_sep = line.find_first_of(';');
+      pthread_mutex_unlock(&input->lock);
 
-         if (bl_semicolon_sep == string::npos) {
-            // Add entry to vector
-            if (ip_is4(&bl_entry.ip)) {
-               v4_list_new.push_back(bl_entry);
-            } else {
-               v6_list_new.push_back(bl_entry);
-            }
-            continue;
-         }
+      TRAP_DEFAULT_GET_DATA_ERROR_HANDLING(retval, break, input->end_of_input = true; break);
+      data = batch.data.data() + offset;
 
-         string str = line.substr(bl_semicolon_sep, string::npos);
-         char *index = const_cast<char *>(str.c_str());
-         char* end_ptr = nullptr;
-
-         bl_entry.bl_ports = {};
-
-#define state_start 0
-#define state_blacklist_num 1
-#define state_ports 2
-#define state_invalid 3
-#define state_end 4
-
-         int state = state_start;
-         while (state != state_end) {
-            switch (state) {
-            case state_start:
-               if (*index == ';') {
-                  index++;
-                  state = state_blacklist_num;
-               } else if (*index == '\0') {
-                  state = state_end;
-               } else {
-                  state = state_invalid;
-               }
-               break;
-
-            case state_blacklist_num:
-               bl_num = strtoul(index, &end_ptr, 10);
-               if (end_ptr == index || errno != 0) {
-                  cerr << "Parsing blacklist number failed, errno:" << errno << endl;
-                  state = state_invalid;
-                  break;
-               }
-
-               index = end_ptr;
-               bl_entry.bl_ports[bl_num] = {};
-
-               if (*index == ':') {
-                  index++;
-                  state = state_ports;
-               } else {
-                  state = state_invalid;
-               }
-               break;
-
-            case state_ports:
-               port = strtoul(index, &end_ptr, 10);
-               if (end_ptr == index || errno != 0) {
-                  cerr << "Parsing port number failed, errno:" << errno << endl;
-                  state = state_invalid;
-                  break;
-               }
-               index = end_ptr;
-               bl_entry.bl_ports.at(bl_num).insert(port);
-
-               if (*index == ',') {
-                  index++;
-                  state = state_ports;
-               } else if (*index == ';') {
-                  index++;
-                  state = state_start;
-               } else {
-                  state = state_end;
-               }
-               break;
-            }
+      if (worker->format_changes != format_changes) {
+         pthread_mutex_lock(&TEMPLATE_LOCK);
+         ur_template_t *tmplt = ur_define_fields_and_update_template(format.c_str(), worker->ur_input);
+         pthread_mutex_unlock(&TEMPLATE_LOCK);
 
-            if (state == state_invalid) {
-               cerr << "Invalid blacklist:[ports] on line:" << str << endl;
-               break;
-            }
+         if (tmplt == NULL) {
+            cerr << "Error: Template of input interface " << worker->ifc << " could not be updated" << endl;
+            input->end_of_input = true;
+            batch.data.resize(offset);
+            break;
          }
-
-         // Add entry to vector
-         if (ip_is4(&bl_entry.ip)) {
-            v4_list_new.push_back(bl_entry);
-         } else {
-            v6_list_new.push_back(bl_entry);
+         worker->ur_input = tmplt;
+         worker->format_changes = format_changes;
+
+         // Copied records of the previous input format cannot be interpreted with the new template
+         if (!batch.offsets.empty()) {
+            cerr << "Warning: Input format changed, dropping " << batch.offsets.size() << " buffered records" << endl;
+            batch.data.erase(batch.data.begin(), batch.data.begin() + offset);
+            batch.offsets.clear();
+            offset = 0;
+            data = batch.data.data();
          }
       }
 
-      input.close();
-   }
-
-   v4_list = move(v4_list_new);
-   v6_list = move(v6_list_new);
-
-   DBG((stderr, "Blacklists reloaded. Entries: IP4: %lu, IP6: %lu\n", v4_list.size(), v6_list.size()));
-
-   return ALL_OK;
-}
-
-/**
- * \brief Function for searching in blacklists. It uses binary search
- * algorithm to determine whether the given ip address fits any of the prefix/IP in the list.
- * \param searched IP address that we are checking.
- * \param v4mm Map of IPv4 masks.
- * \param v6mm Map of IPv6 masks.
- * \param black_list List of prefixes to be compared with. Either IPv4 or IPv6
- * \return IP_NOT_FOUND if the ip address doesn't fit any prefix. Index of the prefix otherwise.
- */
-int ip_binary_search(const ip_addr_t *searched,
-                     const ipv4_mask_map_t &v4mm,
-                     const ipv6_mask_map_t &v6mm,
-                     const black_list_t &black_list)
-{
-   int end, begin, mid;
-   int mask_result = 1;
-   ip_addr_t masked;
-
-   begin = 0;
-   end = black_list.size() - 1;
-
-   // Binary search
-   if (ip_is4(searched)) {
-      // Searching in IPv4 blacklist
-      // Mask the searched IP with the mask of the mid IP, if it matches the network IP -> found
-      while (begin <= end) {
-         mid = (begin + end) >> 1;
-         masked.ui32[2] = searched->ui32[2] & v4mm[black_list[mid].prefix_len];
-         mask_result = memcmp(&(black_list[mid].ip.ui32[2]), &(masked.ui32[2]), 4);
-
-         if (mask_result < 0) {
-            begin = mid + 1;
-         } else if (mask_result > 0) {
-            end = mid - 1;
-         } else {
-            break;
+      // Check the data size, the short record of end of data is not interpreted
+      if (data_size <= 1 || data_size != ur_rec_size(worker->ur_input, data)) {
+         if (data_size > 1) { // data corrupted
+            cerr << "ERROR: Corrupted data or wrong data template was specified. ";
+            cerr << "Size computed from record: " << ur_rec_size(worker->ur_input, data) << " ";
+            cerr << "Size returned from Trap: " << data_size << endl;
          }
+         // end of data
+         input->end_of_input = true;
+         batch.data.resize(offset);
+         break;
       }
-   } else {
-      // Searching in IPv6 blacklist
-      while (begin <= end) {
-         mid = (begin + end) >> 1;
-         if (black_list[mid].prefix_len <= 64) {
-            // If the prefix is <= 64, compare only the first 8 bytes, since the other 8 bytes of the network are zeroes
-            masked.ui64[0] = searched->ui64[0] & v6mm[black_list[mid].prefix_len][0];
-            mask_result = memcmp(&(black_list[mid].ip.ui64[0]), &(masked.ui64[0]), 8);
-         } else {
-            masked.ui64[0] = searched->ui64[0];
-            masked.ui64[1] = searched->ui64[1] & v6mm[black_list[mid].prefix_len][1];
-            mask_result = memcmp(&(black_list[mid].ip.ui8), &(masked.ui8), 16);
-         }
 
-         if (mask_result < 0) {
-            begin = mid + 1;
-         } else if (mask_result > 0) {
-            end = mid - 1;
-         } else {
-            break;
-         }
+      // Ignore DNS queries, in overload only flows of the sampled host pairs are looked up
+      if (is_dns_traffic(worker->ur_input, data) ||
+          !overload_keep(worker->overload, hosts_hash(worker->ur_input, data))) {
+         batch.data.resize(offset);
+         continue;
       }
-   }
 
-   if (mask_result == 0) {
-      // Address found, return blacklist index
-      return mid;
+      batch.offsets.push_back(offset);
    }
-
-   return IP_NOT_FOUND;
 }
 
 /**
- * @brief fill bitfield with flags of ports where the port matching succeeded or where no port information are available
- * 		  gets called for records that have been already matched based on SRC_IP/DST_IP
- *
- * @param bl_entry blacklist entry
- * @param port src/dst port of the matched record
- *
- * @return bitfield with only those flags filled where ports were matched or not available
+ * \brief Function for sending the detections of a batch to the output interface.
+ * \param output Detections, the buffer is emptied.
  */
-uint64_t check_ports_get_bitfield(const ip_bl_entry_t &bl_entry, uint16_t port)
+static void send_output(ip_output_t &output)
 {
-   uint64_t inverse_matched_bitfield = 0;
-
-   if (bl_entry.bl_ports.empty()) {
-      // no port information => match everything
-      return bl_entry.in_blacklist;
+   if (output.sizes.empty()) {
+      return;
    }
 
-   for (const auto &blacklist: bl_entry.bl_ports) {
-      if (blacklist.second.find(port) == blacklist.second.end()) {
-         const uint64_t one = 1;
-         const int key = blacklist.first;
-         const uint64_t set_bit = key > 0 && key <= 63 ? (one << (key - 1)) : 0;
-         inverse_matched_bitfield |= set_bit;
-      }
+   pthread_mutex_lock(&OUTPUT_LOCK);
+   size_t offset = 0;
+   for (const uint16_t size: output.sizes) {
+      trap_send(0, &output.data[offset], size);
+      offset += size;
    }
+   pthread_mutex_unlock(&OUTPUT_LOCK);
 
-   return inverse_matched_bitfield xor bl_entry.in_blacklist;
+   output.data.clear();
+   output.sizes.clear();
 }
 
 /**
- * \brief Function for checking blacklisted IPv4/IPv6 addresses.
- *
- * It extracts both source and
- * destination addresses from the UniRec record and tries to match them to either
- * address or prefix. If the match is positive the field in the detection record is filled
- * with the respective blacklist(s) number.
- * \param ur_in  Template of input UniRec record.
- * \param ur_out Template of detection UniRec record.
- * \param record Record being analyzed.
- * \param detected Detection record used if any address matches the blacklist.
- * \param v4mm Map of IPv4 masks.
- * \param v6mm Map of IPv6 masks.
- * \param v4blacklist List of IPv4 prefixes to be compared with.
- * \param v6blacklist List of IPv6 prefixes to be compared with.
- * \return BLACKLISTED if match was found otherwise ADDR_CLEAR.
+ * \brief Worker thread. All workers share the current blacklist (read-only),
+ * each of them stops referencing it before receiving the next batch.
+ * \param arg Worker.
+ * \return NULL.
  */
-int blacklist_check(ur_template_t *ur_in,
-                    ur_template_t *ur_out,
-                    const void *record,
-                    void *detected,
-                    const ipv4_mask_map_t &v4mm,
-                    const ipv6_mask_map_t &v6mm,
-                    const black_list_t &v4blacklist,
-                    const black_list_t &v6blacklist)
+static void *worker_thread(void *arg)
 {
-   // determine which blacklist (ipv4/ipv6) we are working with
-   const black_list_t &bl = ip_is4(&(ur_get(ur_in, record, F_SRC_IP))) ? v4blacklist : v6blacklist;
-
-   // index of the prefix the source ip fits in (return value of binary search)
-   int search_result;
-
-   // port-matching
-   uint16_t port;
-   uint64_t matched_bitfield;
-
-   // Check source IP
-   if ((search_result = ip_binary_search(ur_get_ptr(ur_in, record, F_SRC_IP), v4mm, v6mm, bl)) != IP_NOT_FOUND) {
-      if (bl[search_result].in_blacklist == ADAPTIVE_BLACKLIST_INDEX) {
-         // Adaptive IP filter mode
-         ur_set_string(ur_out, detected, F_ADAPTIVE_IDS, bl[search_result].adaptive_ids.c_str());
-      } else {
-         ur_set_string(ur_out, detected, F_ADAPTIVE_IDS, "");
-      }
-
-      port = ur_get(ur_in, record, F_SRC_PORT);  // source IP was matched
-
-      matched_bitfield = check_ports_get_bitfield(bl[search_result], port);
-
-      if (matched_bitfield != 0) {
-         ur_set(ur_out, detected, F_SRC_BLACKLIST, matched_bitfield);
-         return BLACKLISTED;
-      }
-
-      ur_set(ur_out, detected, F_DST_BLACKLIST, 0x0);
-
-      // Check destination IP
-   } else if ((search_result = ip_binary_search(ur_get_ptr(ur_in, record, F_DST_IP), v4mm, v6mm, bl)) != IP_NOT_FOUND) {
-      if (bl[search_result].in_blacklist == ADAPTIVE_BLACKLIST_INDEX) {
-         ur_set_string(ur_out, detected, F_ADAPTIVE_IDS, bl[search_result].adaptive_ids.c_str());
-      } else {
-         ur_set_string(ur_out, detected, F_ADAPTIVE_IDS, "");
-      }
+   ip_worker_t *worker = (ip_worker_t *) arg;
 
-      port = ur_get(ur_in, record, F_DST_PORT);  // dest IP was matched - mirrored
+   while (!stop && !worker->input->end_of_input) {
+      // No reference to the blacklist is held between batches
+      BLACKLIST.quiescent(worker->id);
 
-      matched_bitfield = check_ports_get_bitfield(bl[search_result], port);
+      receive_batch(worker);
 
-      if (matched_bitfield != 0) {
-         ur_set(ur_out, detected, F_DST_BLACKLIST, matched_bitfield);
-         return BLACKLISTED;
+      // Try to match the IP addresses to blacklist
+      if (!worker->batch.offsets.empty()) {
+         overload_begin(worker->overload);
+         process_batch(worker->ur_input, worker->ur_output, worker->detection, worker->batch, *BLACKLIST.get(),
+                       worker->output);
+         send_output(worker->output);
+         overload_end(worker->overload, worker->batch.offsets.size());
       }
-
-      ur_set(ur_out, detected, F_SRC_BLACKLIST, 0x0);
-
    }
 
-   return ADDR_CLEAR;
-}
-
-
-/**
- * \brief Function for checking if incoming flow has src/dst port 53.
- */
-bool is_dns_traffic(ur_template_t *ur_in, const void *data)
-{
-   uint16_t src_port = ur_get(ur_in, data, F_SRC_PORT);
-   uint16_t dst_port = ur_get(ur_in, data, F_DST_PORT);
-   return (src_port == 53) || (dst_port == 53);
+   // Do not let a reload in progress wait for this worker
+   BLACKLIST.offline(worker->id);
+   return NULL;
 }
 
 int main(int argc, char **argv)
@@ -606,52 +354,63 @@ int main(int argc, char **argv)
    "/blacklistfilter/ipdetect_config.xml";
    char *ipv4_file = nullptr;
    char *ipv6_file = nullptr;
-
-   // For use with prefixes
-   black_list_t v4_list;
-   black_list_t v6_list;
-
-   // Mask array for prefixes
-   ipv4_mask_map_t v4_masks;
-   ipv6_mask_map_t v6_masks;
-   create_v4_mask_map(v4_masks);
-   create_v6_mask_map(v6_masks);
-
-   // TRAP initialization
+   char *snapshot_file = nullptr;
+
+   // Records are received and looked up in batches by the workers
+   size_t batch_size = DEFAULT_BATCH_SIZE;
+   uint32_t worker_cnt = DEFAULT_WORKERS;
+   uint32_t input_cnt;
+   std::vector<ip_input_t> inputs; // not movable (atomic member), created with its final size
+   std::vector<ip_worker_t> workers;
+   std::vector<pthread_t> worker_threads;
+   std::vector<overload_t> overloads;
+   double overload_threshold = 0;
+   char *metrics_socket = nullptr;
+   char *cpu_affinity = nullptr;
+
+   // Blacklisted prefixes and their indexes (initial generation)
+   ip_blacklist_t *blacklist = nullptr;
+
+   // TRAP initialization, the number of input interfaces is given by the interface specifier
+   trap_ifc_spec_t ifc_spec;
    INIT_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
-   TRAP_DEFAULT_INITIALIZATION(argc, argv, *module_info);
+   retval = trap_parse_params(&argc, argv, &ifc_spec);
+   if (retval != TRAP_E_OK) {
+      if (retval == TRAP_E_HELP) { // "-h" was found
+         trap_print_help(module_info);
+         FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS)
+         return 0;
+      }
+      cerr << "ERROR in parsing of parameters for TRAP: " << trap_last_error_msg << endl;
+      FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS)
+      return 1;
+   }
+   if (strlen(ifc_spec.types) < 2) {
+      cerr << "Error: At least one input and one output interface have to be specified" << endl;
+      trap_free_ifc_spec(ifc_spec);
+      FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS)
+      return 1;
+   }
+   input_cnt = strlen(ifc_spec.types) - 1;
+   module_info->num_ifc_in = input_cnt;
+
+   retval = trap_init(module_info, ifc_spec);
+   trap_free_ifc_spec(ifc_spec);
+   if (retval != TRAP_E_OK) {
+      cerr << "ERROR in TRAP initialization: " << trap_last_error_msg << endl;
+      FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS)
+      return 1;
+   }
    TRAP_REGISTER_DEFAULT_SIGNAL_HANDLER();
 
-   void *detection = NULL;
    ur_template_t *ur_output = NULL;
-   ur_template_t *ur_input = NULL;
    pthread_t watcher_thread = 0;
-
-   // UniRec templates for recieving data and reporting blacklisted IPs
-   ur_input = ur_create_input_template(0, "SRC_IP,DST_IP,SRC_PORT,DST_PORT,PROTOCOL,PACKETS,BYTES,TIME_FIRST,TIME_LAST",
-                                       NULL);
-   ur_output = ur_create_output_template(0,
-                                         "SRC_IP,DST_IP,SRC_PORT,DST_PORT,PROTOCOL,PACKETS,BYTES,TIME_FIRST,TIME_LAST,"
-                                         "SRC_BLACKLIST,DST_BLACKLIST,ADAPTIVE_IDS", NULL);
-
-   if (ur_input == NULL || ur_output == NULL) {
-      cerr << "Error: Input or output template could not be created" << endl;
-      main_retval = 1;
-      goto cleanup;
-   }
-
-   // Create detection record, variable size is used for ADAPTIVE_ID
-   detection = ur_create_record(ur_output, IP_DETECTION_ALLOC_LEN);
-   if (detection == NULL) {
-      cerr << "Error: Memory allocation problem (output record)" << endl;
-      main_retval = 1;
-      goto cleanup;
-   }
+   watcher_wrapper_t watcher_wrapper;
 
    int opt;
 
    // ********** Parse arguments **********
-   while ((opt = getopt(argc, argv, "n4:6:c:")) != -1) {
+   while ((opt = getopt(argc, argv, "n4:6:s:c:b:w:L:m:a:")) != -1) {
       switch (opt) {
       case 'c': // user configuration file for IPBlacklistFilter
          userFile = optarg;
@@ -662,15 +421,110 @@ int main(int argc, char **argv)
       case '6':
          ipv6_file = optarg;
          break;
+      case 's':
+         snapshot_file = optarg;
+         break;
       case 'n': // Do not send terminating Unirec
          send_terminating_unirec = 0;
          break;
+      case 'b':
+         batch_size = strtoul(optarg, NULL, 10);
+         if (batch_size < 1 || batch_size > MAX_BATCH_SIZE) {
+            cerr << "Error: Batch size must be between 1 and " << MAX_BATCH_SIZE << endl;
+            main_retval = 1;
+            goto cleanup;
+         }
+         break;
+      case 'w':
+         worker_cnt = strtoul(optarg, NULL, 10);
+         if (worker_cnt < 1 || worker_cnt > MAX_WORKERS) {
+            cerr << "Error: Number of workers must be between 1 and " << MAX_WORKERS << endl;
+            main_retval = 1;
+            goto cleanup;
+         }
+         break;
+      case 'L': {
+         char *end;
+         overload_threshold = strtod(optarg, &end);
+         if (end == optarg || *end != '\0' || !(overload_threshold > 0 && overload_threshold <= 1)) {
+            cerr << "Error: Load threshold must be in (0, 1]" << endl;
+            main_retval = 1;
+            goto cleanup;
+         }
+         break;
+      }
+      case 'm':
+         metrics_socket = optarg;
+         break;
+      case 'a':
+         cpu_affinity = optarg;
+         break;
       case '?':
          main_retval = 1;
          goto cleanup;
       }
    }
 
+   // Every input interface needs a worker
+   if (worker_cnt < input_cnt) {
+      if (input_cnt > MAX_WORKERS) {
+         cerr << "Error: Too many input interfaces, at most " << MAX_WORKERS << " are supported" << endl;
+         main_retval = 1;
+         goto cleanup;
+      }
+      worker_cnt = input_cnt;
+   }
+
+   if (affinity_init(cpu_affinity) != 0) {
+      main_retval = 1;
+      goto cleanup;
+   }
+   // A single worker runs in the main thread, the blacklist and records it allocates are then local to its CPU
+   if (worker_cnt == 1) {
+      affinity_pin_self();
+   }
+
+   // UniRec template for reporting blacklisted IPs
+   ur_output = ur_create_output_template(0,
+                                         "SRC_IP,DST_IP,SRC_PORT,DST_PORT,PROTOCOL,PACKETS,BYTES,TIME_FIRST,TIME_LAST,"
+                                         "SRC_BLACKLIST,DST_BLACKLIST,ADAPTIVE_IDS", NULL);
+   if (ur_output == NULL) {
+      cerr << "Error: Output template could not be created" << endl;
+      main_retval = 1;
+      goto cleanup;
+   }
+
+   // Workers are assigned to the input interfaces in turns, each of them has its own templates and records
+   inputs = std::vector<ip_input_t>(input_cnt);
+   for (uint32_t i = 0; i < input_cnt; i++) {
+      pthread_mutex_init(&inputs[i].lock, NULL);
+      inputs[i].format_changes = 0;
+      inputs[i].end_of_input = false;
+   }
+   workers.resize(worker_cnt);
+   overloads.resize(worker_cnt);
+   for (uint32_t i = 0; i < worker_cnt; i++) {
+      ip_worker_t &worker = workers[i];
+      worker.id = i;
+      worker.overload = &overloads[i];
+      overload_init(worker.overload, "ipblacklistfilter", overload_threshold);
+      worker.ifc = i % input_cnt;
+      worker.input = &inputs[worker.ifc];
+      worker.format_changes = 0;
+      worker.ur_output = ur_output;
+      worker.batch_size = batch_size;
+      worker.ur_input = ur_create_input_template(worker.ifc, "SRC_IP,DST_IP,SRC_PORT,DST_PORT,PROTOCOL,PACKETS,BYTES,"
+                                                 "TIME_FIRST,TIME_LAST", NULL);
+      // Create detection record, variable size is used for ADAPTIVE_ID
+      worker.detection = ur_create_record(ur_output, IP_DETECTION_ALLOC_LEN);
+
+      if (worker.ur_input == NULL || worker.detection == NULL) {
+         cerr << "Error: Input template or detection record could not be created" << endl;
+         main_retval = 1;
+         goto cleanup;
+      }
+   }
+
    ip_config_t config;
 
    if (loadConfiguration((char *) MODULE_CONFIG_PATTERN_STRING, userFile, &config, CONF_PATTERN_STRING)) {
@@ -686,6 +540,9 @@ int main(int argc, char **argv)
    if (ipv6_file != nullptr) {
       strcpy(config.ipv6_blacklist_file, ipv6_file);
    }
+   if (snapshot_file != nullptr) {
+      strcpy(config.snapshot_file, snapshot_file);
+   }
 
    if (strcmp(config.watch_blacklists, "true") == 0) {
       WATCH_BLACKLISTS_FLAG = true;
@@ -694,19 +551,33 @@ int main(int argc, char **argv)
    }
 
    // Load ip addresses from sources
-   retval = reload_blacklists(v4_list, v6_list, &config);
+   blacklist = new ip_blacklist_t;
+   retval = reload_blacklists(*blacklist, &config);
 
    // If update from bl_file could not be processed, return error
    if (retval == BLIST_FILE_ERROR) {
       cerr << "Error: Unable to read blacklist files" << endl;
+      delete blacklist;
       main_retval = 1;
       goto cleanup;
    }
+   // All workers share one copy of the blacklist
+   BLACKLIST.set_readers(worker_cnt);
+   BLACKLIST.publish(blacklist);
+
+   if (metrics_socket != nullptr && metrics_server_start(metrics_socket) != 0) {
+      cerr << "Warning: Metrics could not be served on socket " << metrics_socket << endl;
+   }
+
+   // Receive with timeout, so that the workers regularly leave the blacklist and reload can finish
+   for (uint32_t i = 0; i < input_cnt; i++) {
+      trap_ifcctl(TRAPIFC_INPUT, i, TRAPCTL_SETTIMEOUT, RECV_TIMEOUT);
+   }
 
    if (WATCH_BLACKLISTS_FLAG) {
-      watcher_wrapper_t watcher_wrapper;
       watcher_wrapper.detector_type = IP_DETECT_ID;
       watcher_wrapper.data = (void *) &config;
+      watcher_wrapper.reload = reload_blacklists_background;
 
       if (pthread_create(&watcher_thread, NULL, watch_blacklist_files, (void *) &watcher_wrapper) > 0) {
          cerr << "Error: Couldnt create watcher thread" << endl;
@@ -715,67 +586,52 @@ int main(int argc, char **argv)
       }
    }
 
-   // ***** Main processing loop *****
-   while (!stop) {
-      const void *data;
-      uint16_t data_size;
-
-      // Retrieve data from sender
-      retval = TRAP_RECEIVE(0, data, data_size, ur_input);
-      TRAP_DEFAULT_GET_DATA_ERROR_HANDLING(retval,
-      continue, break);
-
-      // Check the data size
-      if (data_size != ur_rec_size(ur_input, data)) {
-         if (data_size <= 1) { // end of data
-            break;
-         } else { // data corrupted
-            cerr << "ERROR: Corrupted data or wrong data template was specified. ";
-            cerr << "Size computed from record: " << ur_rec_size(ur_input, data) << " ";
-            cerr << "Size returned from Trap: " << data_size << endl;
+   // ***** Main processing, a single worker runs in the main thread *****
+   if (worker_cnt == 1) {
+      worker_thread(&workers[0]);
+   } else {
+      worker_threads.resize(worker_cnt);
+      for (uint32_t i = 0; i < worker_cnt; i++) {
+         if (affinity_thread_create(&worker_threads[i], worker_thread, (void *) &workers[i]) != 0) {
+            cerr << "Error: Couldnt create worker thread" << endl;
+            // The started workers are stopped and joined below, unstarted ones must not block a reload
+            stop = 1;
+            main_retval = 1;
+            for (uint32_t j = i; j < worker_cnt; j++) {
+               BLACKLIST.offline(j);
+            }
+            worker_threads.resize(i);
             break;
          }
       }
-
-      // Ignore DNS queries
-      if (is_dns_traffic(ur_input, data)) {
-         continue;
-      }
-
-      // Try to match the IP addresses to blacklist
-      retval = blacklist_check(ur_input, ur_output, data, detection, v4_masks, v6_masks, v4_list, v6_list);
-
-      // If IP address was found on blacklist
-      if (retval == BLACKLISTED) {
-         ur_copy_fields(ur_output, detection, ur_input, data);
-         trap_send(0, detection, ur_rec_size(ur_output, detection));
-         DBG((stderr, "IP detected on blacklist\n"))
+      for (pthread_t &thread: worker_threads) {
+         pthread_join(thread, NULL);
       }
+   }
 
-      if (BL_RELOAD_FLAG) {
-         DBG((stderr, "Reloading blacklists\n"));
-         retval = reload_blacklists(v4_list, v6_list, &config);
-         if (retval == BLIST_FILE_ERROR) {
-            cerr << "ERROR: Unable to load update blacklist. Will use the old one instead." << endl;
-         }
-
-         // this lazy locking is fine, we don't need to reload the blacklists immediately
-         // and locking the mutex in every iteration is ineffective
-         pthread_mutex_lock(&BLD_SYNC_MUTEX);
-         BL_RELOAD_FLAG = 0;
-         pthread_mutex_unlock(&BLD_SYNC_MUTEX);
+   if (overload_threshold > 0) {
+      uint64_t shed = 0;
+      for (const overload_t &overload: overloads) {
+         shed += overload.shed;
       }
+      cerr << "Info: " << shed << " flows were shed in overload" << endl;
    }
 
    // If set, send terminating message to modules on output
-   if (send_terminating_unirec) {
+   if (send_terminating_unirec && main_retval == 0) {
       trap_send(0, "TERMINATE", 1);
    }
 
    cleanup:
    // Clean up before termination
-   ur_free_record(detection);
-   ur_free_template(ur_input);
+   metrics_server_stop();
+   for (ip_worker_t &worker: workers) {
+      ur_free_record(worker.detection);
+      ur_free_template(worker.ur_input);
+   }
+   for (ip_input_t &input: inputs) {
+      pthread_mutex_destroy(&input.lock);
+   }
    ur_free_template(ur_output);
    ur_finalize();
 
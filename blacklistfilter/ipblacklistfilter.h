@@ -47,11 +47,16 @@
 #ifndef BLACKLISTFILTER_H
 #define BLACKLISTFILTER_H
 
+#include <atomic>
 #include <map>
 #include <vector>
 #include <set>
 #include <string>
+#include <pthread.h>
 #include <unirec/unirec.h>
+#include "ip_lpm.h"
+#include "ip_port_table.h"
+#include "mapped_array.h"
 
 /**
  * Special value of a blacklist index indicating adaptive blacklist
@@ -80,7 +85,7 @@
 #define ALL_OK 0
 
 /**
- * Return value for binary search when the item is not found.
+ * Return value for blacklist lookup when the item is not found.
  */
 #define IP_NOT_FOUND -1
 
@@ -94,6 +99,32 @@
  */
 #define PREFIX_V6_DEFAULT 128
 
+/**
+ * Timeout of receiving a record (microseconds), it bounds how long
+ * a background reload waits for the main loop to release the old blacklist
+ */
+#define RECV_TIMEOUT 500000
+
+/**
+ * Default number of records received and looked up together
+ */
+#define DEFAULT_BATCH_SIZE 32
+
+/**
+ * Maximum number of records received and looked up together
+ */
+#define MAX_BATCH_SIZE 4096
+
+/**
+ * Default number of worker threads
+ */
+#define DEFAULT_WORKERS 1
+
+/**
+ * Maximum number of worker threads
+ */
+#define MAX_WORKERS 64
+
 /**
  * Allocation size for variable sized UniRec output template
  */
@@ -104,10 +135,10 @@
  */
 typedef struct {
     ip_addr_t ip; /**< Blacklisted IP or prefix */
-    uint8_t prefix_len; /**< Length of the prefix. (set to 32/128 if missing) */
     uint64_t in_blacklist; /**< Bit field of blacklists for the address. */
-    std::string adaptive_ids; /**< IDs for adaptive filter events */
-    std::map<int, std::set<int>> bl_ports; /**< Ports for blacklists (where known) */
+    uint32_t adaptive_id; /**< IDs for adaptive filter events, index to ip_blacklist_t::adaptive_ids */
+    uint32_t port_filter; /**< Ports for blacklists (where known), index to ip_port_table_t::filters or NO_PORT_FILTER */
+    uint8_t prefix_len; /**< Length of the prefix. (set to 32/128 if missing) */
 } ip_bl_entry_t;
 
 
@@ -118,24 +149,112 @@ typedef struct __attribute__ ((__packed__)) {
     char ipv4_blacklist_file[256];
     char ipv6_blacklist_file[256];
     char watch_blacklists[8];
+    char snapshot_file[256];
 } ip_config_t;
 
 /**
- * @typedef vector<ip_bl_entry_t> black_list_t;
- * Vector of blacklisted prefixes.
+ * @typedef MappedArray<ip_bl_entry_t> black_list_t;
+ * Array of blacklisted prefixes.
+ */
+typedef MappedArray<ip_bl_entry_t> black_list_t;
+
+/**
+ * Blacklisted prefixes together with their longest-prefix-match indexes.
+ */
+typedef struct {
+    black_list_t v4_list; /**< IPv4 entries */
+    black_list_t v6_list; /**< IPv6 entries */
+    ip_lpm_t v4_index;    /**< Index of IPv4 entries, values are positions in v4_list */
+    ip_lpm_t v6_index;    /**< Index of IPv6 entries, values are positions in v6_list */
+    ip_port_table_t ports; /**< Port restrictions of the entries of both lists */
+    MappedArray<uint32_t> adaptive_id_offsets; /**< Offsets of distinct IDs for adaptive filter events, the first one is empty */
+    MappedArray<char> adaptive_id_chars; /**< Zero terminated IDs for adaptive filter events */
+    MappedFile snapshot; /**< Mapped snapshot the arrays point to, if the blacklist was loaded from it */
+} ip_blacklist_t;
+
+/**
+ * \brief Returns IDs for adaptive filter events of an entry.
+ * \param blacklist Blacklist.
+ * \param entry Entry of the blacklist.
+ * \return Zero terminated IDs separated by comma.
  */
-typedef std::vector<ip_bl_entry_t> black_list_t;
+static inline const char *ip_blacklist_adaptive_ids(const ip_blacklist_t &blacklist, const ip_bl_entry_t &entry)
+{
+    return &blacklist.adaptive_id_chars[blacklist.adaptive_id_offsets[entry.adaptive_id]];
+}
 
 /**
- * @typedef uint32_t ipv4_mask_map_t[33];
- * Array of IPv4 netmasks.
+ * Function for loading blacklists from the text files.
  */
-typedef uint32_t ipv4_mask_map_t[33];
+int load_blacklist_files(ip_blacklist_t &blacklist, const ip_config_t *config);
 
 /**
- * @typedef uint64_t ipv6_mask_map_t[129][2];
- * Array of IPv6 netmasks.
+ * Function for loading blacklists from the snapshot or from the text files.
  */
-typedef uint64_t ipv6_mask_map_t[129][2];
+int reload_blacklists(ip_blacklist_t &blacklist, const ip_config_t *config);
+
+/**
+ * Records processed together by the main loop.
+ */
+typedef struct {
+    std::vector<char> data;                  /**< Copies of the records (TRAP data are valid only until next receive) */
+    std::vector<size_t> offsets;             /**< Offsets of the records in data */
+    std::vector<const ip_addr_t *> addrs[2]; /**< SRC and DST address of every record, IPv4 [0] and IPv6 [1] */
+    std::vector<int> results[2];             /**< Lookup results of addrs */
+    std::vector<size_t> positions;           /**< Position of the SRC address of every record in addrs of its family */
+} ip_batch_t;
+
+/**
+ * Detections of one batch waiting to be sent.
+ */
+typedef struct {
+    std::vector<char> data;      /**< Detection records */
+    std::vector<uint16_t> sizes; /**< Sizes of the records */
+} ip_output_t;
+
+/**
+ * Function for checking the addresses of a record already looked up in the blacklist.
+ */
+int blacklist_check(ur_template_t *ur_in, ur_template_t *ur_out, const void *record, void *detected,
+                    const ip_blacklist_t &blacklist, const black_list_t &bl, int src_result, int dst_result);
+
+/**
+ * Function for checking a batch of records, detections are appended to the output.
+ */
+void process_batch(ur_template_t *ur_in, ur_template_t *ur_out, void *detected, ip_batch_t &batch,
+                   const ip_blacklist_t &blacklist, ip_output_t &output);
+
+/**
+ * Function for checking if incoming flow has src/dst port 53.
+ */
+bool is_dns_traffic(ur_template_t *ur_in, const void *data);
+
+/**
+ * Input interface shared by the workers receiving from it.
+ */
+typedef struct {
+    pthread_mutex_t lock;       /**< Lock of receiving a record from the interface */
+    std::string format;         /**< Data format of the interface (valid if format_changes > 0) */
+    uint64_t format_changes;    /**< Number of data format changes of the interface */
+    std::atomic<bool> end_of_input; /**< End of data was received or the interface failed (read without the lock) */
+} ip_input_t;
+
+/**
+ * Worker thread, it receives batches from its input interface, looks them up
+ * in the shared blacklist and sends the detections.
+ */
+typedef struct {
+    uint32_t id;                /**< Number of the worker (RCU reader) */
+    uint32_t ifc;               /**< Index of the input interface */
+    ip_input_t *input;          /**< Input interface */
+    ur_template_t *ur_input;    /**< Private template of the input records */
+    uint64_t format_changes;    /**< Data format of the interface the template was updated to */
+    ur_template_t *ur_output;   /**< Template of the detection records (shared, read-only) */
+    void *detection;            /**< Detection record */
+    size_t batch_size;          /**< Maximum number of records in a batch */
+    ip_batch_t batch;           /**< Records of the current batch */
+    ip_output_t output;         /**< Detections of the current batch */
+    struct overload_s *overload; /**< Overload controller of the worker (overload.h) */
+} ip_worker_t;
 
 #endif /* BLACKLISTFILTER_H */
@@ -68,6 +68,11 @@ static char const *MODULE_CONFIG_PATTERN_STRING =
             "<type size=\"8\">string</type>"
             "<default-value>true</default-value>"
         "</element>"
+        "<element type=\"optional\">"
+            "<name>snapshot_file</name>"
+            "<type size=\"256\">string</type>"
+            "<default-value>-</default-value>"
+        "</element>"
     "</struct>"
 "</configuration>";
 
@@ -0,0 +1,236 @@
+/**
+ * \file mapped_array.h
+ * \brief Read-only arrays either owned or pointing into a mapped file.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+
+#ifndef BLACKLISTFILTER_MAPPED_ARRAY_H
+#define BLACKLISTFILTER_MAPPED_ARRAY_H
+
+#include <stddef.h>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+
+/**
+ * Immutable array used by the lookup structures. The items are either owned
+ * (moved in from a vector after the structure is built) or they point into
+ * a read-only file mapping (see MappedFile), which avoids building the structure
+ * at all and lets several processes share the pages.
+ */
+template <typename T>
+class MappedArray {
+public:
+   MappedArray() : items(nullptr), count(0)
+   {
+   }
+
+   MappedArray(MappedArray &&other) : items(nullptr), count(0)
+   {
+      *this = std::move(other);
+   }
+
+   MappedArray &operator=(MappedArray &&other)
+   {
+      // moving the vector keeps its buffer, so items stay valid
+      storage = std::move(other.storage);
+      items = other.items;
+      count = other.count;
+      other.items = nullptr;
+      other.count = 0;
+      return *this;
+   }
+
+   /**
+    * \brief Takes over the items of a vector.
+    * \param values Items.
+    */
+   void assign(std::vector<T> &&values)
+   {
+      storage = std::move(values);
+      storage.shrink_to_fit();
+      items = storage.data();
+      count = storage.size();
+   }
+
+   /**
+    * \brief Points the array to items owned by somebody else (mapped file).
+    * \param values Items, they have to outlive the array.
+    * \param n Number of items.
+    */
+   void map(const T *values, size_t n)
+   {
+      std::vector<T>().swap(storage);
+      items = values;
+      count = n;
+   }
+
+   /**
+    * \brief Releases the items.
+    */
+   void clear()
+   {
+      std::vector<T>().swap(storage);
+      items = nullptr;
+      count = 0;
+   }
+
+   const T &operator[](size_t i) const
+   {
+      return items[i];
+   }
+
+   const T *data() const
+   {
+      return items;
+   }
+
+   const T *begin() const
+   {
+      return items;
+   }
+
+   const T *end() const
+   {
+      return items + count;
+   }
+
+   size_t size() const
+   {
+      return count;
+   }
+
+   bool empty() const
+   {
+      return count == 0;
+   }
+
+   /**
+    * \brief Returns heap memory owned by the array, mapped items are not counted.
+    * \return Size in bytes.
+    */
+   size_t memory() const
+   {
+      return storage.capacity() * sizeof(T);
+   }
+
+private:
+   MappedArray(const MappedArray &);
+   MappedArray &operator=(const MappedArray &);
+
+   std::vector<T> storage; /**< Owned items */
+   const T *items;         /**< Items, owned or mapped */
+   size_t count;           /**< Number of items */
+};
+
+/**
+ * Read-only mapping of a whole file, unmapped when destroyed.
+ */
+class MappedFile {
+public:
+   MappedFile() : addr(nullptr), length(0)
+   {
+   }
+
+   MappedFile(MappedFile &&other) : addr(nullptr), length(0)
+   {
+      *this = std::move(other);
+   }
+
+   MappedFile &operator=(MappedFile &&other)
+   {
+      unmap();
+      std::swap(addr, other.addr);
+      std::swap(length, other.length);
+      return *this;
+   }
+
+   ~MappedFile()
+   {
+      unmap();
+   }
+
+   /**
+    * \brief Maps the file, a previous mapping is released.
+    * \param fd Descriptor of the file opened for reading.
+    * \param size Size of the file.
+    * \return True on success.
+    */
+   bool map(int fd, size_t size)
+   {
+      unmap();
+      void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+      if (p == MAP_FAILED) {
+         return false;
+      }
+      addr = p;
+      length = size;
+      return true;
+   }
+
+   void unmap()
+   {
+      if (addr != nullptr) {
+         munmap(addr, length);
+         addr = nullptr;
+         length = 0;
+      }
+   }
+
+   const char *data() const
+   {
+      return (const char *) addr;
+   }
+
+   size_t size() const
+   {
+      return length;
+   }
+
+private:
+   MappedFile(const MappedFile &);
+   MappedFile &operator=(const MappedFile &);
+
+   void *addr;    /**< Start of the mapping */
+   size_t length; /**< Length of the mapping */
+};
+
+#endif /* BLACKLISTFILTER_MAPPED_ARRAY_H */
@@ -0,0 +1,181 @@
+/**
+ * \file rcu_pointer.h
+ * \brief Pointer to a shared read-only object replaced without blocking the reader.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+
+#ifndef BLACKLISTFILTER_RCU_POINTER_H
+#define BLACKLISTFILTER_RCU_POINTER_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+
+/**
+ * Interval of polling the reader while waiting for a grace period (microseconds).
+ */
+#define RCU_POLL_INTERVAL 1000
+
+/**
+ * Special value of the reader epoch of a reader which stopped reading.
+ */
+#define RCU_READER_IDLE UINT64_MAX
+
+/**
+ * Maximum number of reader threads.
+ */
+#define RCU_MAX_READERS 64
+
+/**
+ * Pointer to an immutable object (generation) shared by reader threads and a writer.
+ *
+ * This is a minimal quiescent-state based RCU. Every reader calls quiescent() whenever it does
+ * not hold any reference to the object (e.g. before receiving a new record) and get() to obtain
+ * the current generation. The writer publishes a new generation with publish(), which waits
+ * until all readers pass a quiescent state and then deletes the previous generation.
+ * So readers never block and pay one atomic load and one store per quiescent state.
+ *
+ * Readers are numbered from 0 to set_readers() - 1 (a single reader 0 by default), each of them
+ * has to reach a quiescent state regularly (use receive timeout), otherwise publish() waits until it does.
+ */
+template <typename T>
+class RcuPointer {
+public:
+   RcuPointer() : current(nullptr), epoch(0), readers(1)
+   {
+      for (size_t i = 0; i < RCU_MAX_READERS; i++) {
+         reader_epochs[i].epoch.store(0);
+      }
+   }
+
+   ~RcuPointer()
+   {
+      delete current.load();
+   }
+
+   /**
+    * \brief Returns the current generation (reader side).
+    * \return Pointer valid until the next call of quiescent().
+    */
+   const T *get() const
+   {
+      return current.load(std::memory_order_acquire);
+   }
+
+   /**
+    * \brief Sets the number of readers, it has to be called before the readers start.
+    * \param count Number of readers (at most RCU_MAX_READERS).
+    */
+   void set_readers(size_t count)
+   {
+      readers = count;
+   }
+
+   /**
+    * \brief Announces that the reader holds no reference to any generation (reader side).
+    * \param reader Number of the reader.
+    */
+   void quiescent(size_t reader = 0)
+   {
+      reader_epochs[reader].epoch.store(epoch.load(std::memory_order_acquire), std::memory_order_release);
+   }
+
+   /**
+    * \brief Announces that the reader stopped reading for good (e.g. at exit),
+    * grace periods do not wait for it anymore.
+    * \param reader Number of the reader.
+    */
+   void offline(size_t reader = 0)
+   {
+      reader_epochs[reader].epoch.store(RCU_READER_IDLE, std::memory_order_release);
+   }
+
+   /**
+    * \brief Replaces the current generation and frees the previous one once the reader
+    * cannot hold it anymore (writer side, blocks until then).
+    * \param next New generation, ownership is taken over.
+    * \param stop Optional flag, the wait is abandoned (and the old generation leaked) if it is set.
+    */
+   void publish(T *next, const volatile int *stop = nullptr)
+   {
+      T *old = current.exchange(next, std::memory_order_acq_rel);
+      const uint64_t e = epoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+      if (old == nullptr) {
+         return;
+      }
+
+      // Wait for a grace period, every reader loaded the new pointer after passing epoch e
+      for (size_t i = 0; i < readers; i++) {
+         while (1) {
+            const uint64_t r = reader_epochs[i].epoch.load(std::memory_order_acquire);
+            if (r == RCU_READER_IDLE || r >= e) {
+               break;
+            }
+            if (stop != nullptr && *stop) {
+               return;
+            }
+            usleep(RCU_POLL_INTERVAL);
+         }
+      }
+
+      delete old;
+   }
+
+private:
+   RcuPointer(const RcuPointer &);
+   RcuPointer &operator=(const RcuPointer &);
+
+   /**
+    * Epoch of a reader, every reader has its own cache line.
+    */
+   struct alignas(64) reader_epoch_t {
+      std::atomic<uint64_t> epoch;      /**< Last epoch observed by the reader in a quiescent state */
+   };
+
+   std::atomic<T *> current;            /**< Current generation */
+   std::atomic<uint64_t> epoch;         /**< Number of published generations */
+   size_t readers;                      /**< Number of readers */
+   reader_epoch_t reader_epochs[RCU_MAX_READERS]; /**< Epochs of the readers */
+};
+
+#endif /* BLACKLISTFILTER_RCU_POINTER_H */
@@ -0,0 +1,472 @@
+/**
+ * \file unifiedblacklistfilter.cpp
+ * \brief Unified blacklist filter checking IP addresses, URLs and DNS names in one pass.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <atomic>
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <signal.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <unirec/unirec.h>
+#include <libtrap/trap.h>
+#include <unifieddetect/patternstrings.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef DEBUG
+#define DBG(x) fprintf x;
+#else
+#define DBG(x)
+#endif
+
+/* include from nemea-common */
+#include <nemea-common.h>
+#include "unifiedblacklistfilter.h"
+#include "fields.h"
+#include "blacklist_watcher.h"
+#include "rcu_pointer.h"
+
+UR_FIELDS(
+//BASIC_FLOW
+      ipaddr SRC_IP,      //Source address of a flow
+      ipaddr DST_IP,      //Destination address of a flow
+      uint16 SRC_PORT,    //Source transport-layer port
+      uint16 DST_PORT,    //Destination transport-layer port
+      uint8 PROTOCOL,     //L4 protocol (TCP, UDP, ICMP, etc.)
+      uint32 PACKETS,     //Number of packets in a flow or in an interval
+      uint64 BYTES,       //Number of bytes in a flow or in an interval
+      time TIME_FIRST,    //Timestamp of the first packet of a flow
+      time TIME_LAST,     //Timestamp of the last packet of a flow
+//HTTP
+      string HTTP_REQUEST_HOST,
+      string HTTP_REQUEST_URL,
+//DNS
+      string DNS_NAME,
+//Blacklist items
+      uint64 SRC_BLACKLIST,   //Bit field of blacklists IDs which contains the source address of the flow
+      uint64 DST_BLACKLIST,   //Bit field of blacklists IDs which contains the destination address of the flow
+      string ADAPTIVE_IDS,    // UUID4 of the scenario events, separated by comma, used when working with adaptive blacklist
+      uint64 BLACKLIST        //ID of blacklist which contains the URL or the domain name
+)
+
+trap_module_info_t *module_info = NULL;
+
+#define MODULE_BASIC_INFO(BASIC) \
+  BASIC("unifiedblacklistfilter", "Module receives the UniRec record and checks its addresses, URL (Host + Path) " \
+    "and domain name (FQDN) against the IP, URL and DNS blacklists in a single pass. " \
+    "It replaces ipblacklistfilter, urlblacklistfilter and dnsblacklistfilter running on the same flows. " \
+    "URL and DNS blacklists are checked only if the input records contain HTTP_REQUEST_HOST and HTTP_REQUEST_URL, " \
+    "resp. DNS_NAME fields. Detections are sent to three output interfaces: IP, URL and DNS. " \
+    "This module uses configurator tool. To specify files with blacklists (prepared by blacklist downloader) " \
+    "use XML configuration file for UnifiedBlacklistFilter (unifieddetect_config.xml).", 1, 3)
+
+#define MODULE_PARAMS(PARAM) \
+  PARAM('c', "", "Specify user configuration file for UnifiedBlacklistFilter. [Default: " SYSCONFDIR "/blacklistfilter/unifieddetect_config.xml]", required_argument, "string") \
+  PARAM('e', "", "Specify number of recently checked clean URLs and FQDNs remembered to skip the blacklist search, 0 disables the cache. [Default: 65536]", required_argument, "uint32") \
+  PARAM('n', "", "Do not send terminating Unirec when exiting program.", no_argument, "none")
+
+using namespace std;
+
+// Global variable for signaling the program to stop execution
+int stop = 0;
+
+// Used by the watcher only for detectors without reload callback
+int BL_RELOAD_FLAG = 0;
+
+// Blacklist watcher flag. If set, the inotify based thread for watching blacklists is created
+static bool WATCH_BLACKLISTS_FLAG;
+
+// IP blacklist, the watcher thread replaces it when the IP blacklist files change
+static RcuPointer<ip_blacklist_t> BLACKLIST;
+
+// Configuration of the IP blacklist (part of the module configuration)
+static ip_config_t IP_CONFIG;
+
+// URL and DNS files changed (BL_CHANGED_* bits), they are reloaded by the main loop
+static std::atomic<uint32_t> RELOAD_FILES(0);
+
+/**
+ * Procedure for handling signals SIGTERM and SIGINT (Ctrl-C)
+ */
+TRAP_DEFAULT_SIGNAL_HANDLER(stop = 1)
+
+/**
+ * \brief Function for reloading changed blacklists (called by the watcher thread).
+ * IP blacklist is loaded in the background and published (see ipblacklistfilter),
+ * reload of URL and DNS blacklists is left to the main loop, which updates them in place.
+ * \param arg Watcher data with the bit field of changed files.
+ * \return ALL_OK on success, BLIST_FILE_ERROR if the IP blacklist could not be loaded.
+ */
+static int reload_changed_blacklists(void *arg)
+{
+   const watcher_wrapper_t *watcher_wrapper = (const watcher_wrapper_t *) arg;
+   int retval = ALL_OK;
+
+   RELOAD_FILES.fetch_or(watcher_wrapper->changed & (BL_CHANGED_URL | BL_CHANGED_DNS));
+
+   // IPv6 file may be watched even if the IP detector is disabled
+   if ((watcher_wrapper->changed & (BL_CHANGED_IP4 | BL_CHANGED_IP6)) &&
+       strcmp(IP_CONFIG.ipv4_blacklist_file, BL_FILE_DISABLED) != 0) {
+      ip_blacklist_t *blacklist = new ip_blacklist_t;
+
+      if (reload_blacklists(*blacklist, &IP_CONFIG) == BLIST_FILE_ERROR) {
+         cerr << "ERROR: Unable to load update IP blacklist. Will use the old one instead." << endl;
+         delete blacklist;
+         retval = BLIST_FILE_ERROR;
+      } else {
+         BLACKLIST.publish(blacklist, &stop);
+         DBG((stderr, "New IP blacklist generation published\n"));
+      }
+   }
+
+   return retval;
+}
+
+/**
+ * \brief Function for checking the addresses of a record against the IP blacklist.
+ * \param ur_in Template of input UniRec record.
+ * \param ur_out Template of IP detection record.
+ * \param record Record being analyzed.
+ * \param detected IP detection record.
+ * \param blacklist IP blacklist.
+ * \return BLACKLISTED if any of the addresses is blacklisted, ADDR_CLEAR otherwise.
+ */
+static int check_ip_blacklist(ur_template_t *ur_in, ur_template_t *ur_out, const void *record, void *detected,
+                              const ip_blacklist_t &blacklist)
+{
+   const ip_addr_t *src = ur_get_ptr(ur_in, record, F_SRC_IP);
+   const ip_addr_t *dst = ur_get_ptr(ur_in, record, F_DST_IP);
+
+   // both addresses are looked up in the list of the source address family
+   if (ip_is4(src)) {
+      return blacklist_check(ur_in, ur_out, record, detected, blacklist, blacklist.v4_list,
+                             ip_lpm_lookup(blacklist.v4_index, src), ip_lpm_lookup(blacklist.v4_index, dst));
+   }
+   return blacklist_check(ur_in, ur_out, record, detected, blacklist, blacklist.v6_list,
+                          ip_lpm_lookup(blacklist.v6_index, src), ip_lpm_lookup(blacklist.v6_index, dst));
+}
+
+/**
+ * \brief Function for sending a detection record.
+ * \param ifc Output interface.
+ * \param ur_out Template of the detection record.
+ * \param detected Detection record.
+ * \param ur_in Template of input UniRec record.
+ * \param record Record the detection was found in.
+ */
+static void send_detection(uint32_t ifc, ur_template_t *ur_out, void *detected, ur_template_t *ur_in, const void *record)
+{
+   ur_copy_fields(ur_out, detected, ur_in, record);
+   trap_send(ifc, detected, ur_rec_size(ur_out, detected));
+}
+
+int main(int argc, char **argv)
+{
+   int main_retval = 0;
+   int retval = 0;
+   int send_terminating_unirec = 1;
+
+   // Set default files names
+   char *userFile = (char *) SYSCONFDIR "/blacklistfilter/unifieddetect_config.xml";
+   size_t cache_size = CLEAN_CACHE_DEFAULT_SIZE;
+
+   // Detectors are enabled by their blacklist files, URL and DNS ones also by the input format
+   bool ip_enabled, url_enabled, dns_enabled;
+   bool has_url = false, has_dns = false;
+   url_blacklist_t url_blacklist;
+   dns_blacklist_t dns_blacklist;
+   string url_file, dns_file;
+   ip_blacklist_t *blacklist = nullptr;
+
+   url_blacklist.tree = NULL;
+   dns_blacklist.tree = NULL;
+
+   // TRAP initialization
+   INIT_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+   TRAP_DEFAULT_INITIALIZATION(argc, argv, *module_info);
+   TRAP_REGISTER_DEFAULT_SIGNAL_HANDLER();
+
+   ur_template_t *ur_input = NULL;
+   ur_template_t *ur_output[3] = {NULL, NULL, NULL};
+   void *detection[3] = {NULL, NULL, NULL};
+   pthread_t watcher_thread = 0;
+   watcher_wrapper_t watcher_wrapper;
+   bl_config_t config;
+
+   int opt;
+
+   // ********** Parse arguments **********
+   while ((opt = getopt(argc, argv, "nc:e:")) != -1) {
+      switch (opt) {
+      case 'c': // user configuration file for UnifiedBlacklistFilter
+         userFile = optarg;
+         break;
+      case 'e': // size of the clean cache
+         cache_size = strtoul(optarg, NULL, 10);
+         break;
+      case 'n': // Do not send terminating Unirec
+         send_terminating_unirec = 0;
+         break;
+      case '?':
+         main_retval = 1;
+         goto cleanup;
+      }
+   }
+
+   // UniRec templates, the input template is extended to all fields of the input format when it is received
+   ur_input = ur_create_input_template(0, "SRC_IP,DST_IP,SRC_PORT,DST_PORT,PROTOCOL,PACKETS,BYTES,TIME_FIRST,TIME_LAST", NULL);
+   ur_output[BL_IFC_IP] = ur_create_output_template(BL_IFC_IP, "SRC_IP,DST_IP,SRC_PORT,DST_PORT,PROTOCOL,PACKETS,BYTES,"
+                                                    "TIME_FIRST,TIME_LAST,SRC_BLACKLIST,DST_BLACKLIST,ADAPTIVE_IDS", NULL);
+   ur_output[BL_IFC_URL] = ur_create_output_template(BL_IFC_URL, "SRC_IP,DST_IP,SRC_PORT,DST_PORT,PROTOCOL,PACKETS,BYTES,"
+                                                     "TIME_FIRST,TIME_LAST,HTTP_REQUEST_HOST,HTTP_REQUEST_URL,BLACKLIST", NULL);
+   ur_output[BL_IFC_DNS] = ur_create_output_template(BL_IFC_DNS, "SRC_IP,DST_IP,SRC_PORT,DST_PORT,PROTOCOL,PACKETS,BYTES,"
+                                                     "TIME_FIRST,TIME_LAST,DNS_NAME,BLACKLIST", NULL);
+   if (ur_input == NULL || ur_output[BL_IFC_IP] == NULL || ur_output[BL_IFC_URL] == NULL || ur_output[BL_IFC_DNS] == NULL) {
+      cerr << "Error: Input or output template could not be created" << endl;
+      main_retval = 1;
+      goto cleanup;
+   }
+
+   // Create detection records, variable size is used for ADAPTIVE_IDS, URLs and domain names
+   detection[BL_IFC_IP] = ur_create_record(ur_output[BL_IFC_IP], IP_DETECTION_ALLOC_LEN);
+   detection[BL_IFC_URL] = ur_create_record(ur_output[BL_IFC_URL], DETECTION_ALLOC_LEN);
+   detection[BL_IFC_DNS] = ur_create_record(ur_output[BL_IFC_DNS], DETECTION_ALLOC_LEN);
+   if (detection[BL_IFC_IP] == NULL || detection[BL_IFC_URL] == NULL || detection[BL_IFC_DNS] == NULL) {
+      cerr << "Error: Memory allocation problem (output record)" << endl;
+      main_retval = 1;
+      goto cleanup;
+   }
+
+   if (loadConfiguration((char *) MODULE_CONFIG_PATTERN_STRING, userFile, &config, CONF_PATTERN_STRING)) {
+      cerr << "Error: Could not parse XML configuration." << endl;
+      main_retval = 1;
+      goto cleanup;
+   }
+
+   WATCH_BLACKLISTS_FLAG = strcmp(config.watch_blacklists, "true") == 0;
+
+   ip_enabled = strcmp(config.ipv4_blacklist_file, BL_FILE_DISABLED) != 0;
+   url_enabled = strcmp(config.url_blacklist_file, BL_FILE_DISABLED) != 0;
+   dns_enabled = strcmp(config.dns_blacklist_file, BL_FILE_DISABLED) != 0;
+
+   if (!ip_enabled && !url_enabled && !dns_enabled) {
+      cerr << "Error: No blacklist file is configured" << endl;
+      main_retval = 1;
+      goto cleanup;
+   }
+
+   if (strcmp(config.backend, DOMAIN_BACKEND_HASH) == 0) {
+      url_blacklist.use_hash = dns_blacklist.use_hash = true;
+   } else if (strcmp(config.backend, DOMAIN_BACKEND_TREE) == 0) {
+      url_blacklist.use_hash = dns_blacklist.use_hash = false;
+   } else {
+      cerr << "Error: Unknown blacklist backend '" << config.backend << "'" << endl;
+      main_retval = 1;
+      goto cleanup;
+   }
+
+   // Load the blacklists of the enabled detectors
+   memcpy(IP_CONFIG.ipv4_blacklist_file, config.ipv4_blacklist_file, sizeof(IP_CONFIG.ipv4_blacklist_file));
+   memcpy(IP_CONFIG.ipv6_blacklist_file, config.ipv6_blacklist_file, sizeof(IP_CONFIG.ipv6_blacklist_file));
+   memcpy(IP_CONFIG.watch_blacklists, config.watch_blacklists, sizeof(IP_CONFIG.watch_blacklists));
+   memcpy(IP_CONFIG.snapshot_file, config.snapshot_file, sizeof(IP_CONFIG.snapshot_file));
+
+   if (ip_enabled) {
+      blacklist = new ip_blacklist_t;
+      if (reload_blacklists(*blacklist, &IP_CONFIG) == BLIST_FILE_ERROR) {
+         cerr << "Error: Unable to read IP blacklist files" << endl;
+         delete blacklist;
+         main_retval = 1;
+         goto cleanup;
+      }
+      BLACKLIST.publish(blacklist);
+   }
+
+   url_blacklist.version.size = -1;
+   dns_blacklist.version.size = -1;
+   clean_cache_init(url_blacklist.cache, cache_size);
+   clean_cache_init(dns_blacklist.cache, cache_size);
+
+   url_file = config.url_blacklist_file;
+   if (url_enabled && reload_blacklists(url_blacklist, url_file) == BLIST_LOAD_ERROR) {
+      cerr << "Error: Unable to read URL blacklist file " << url_file << endl;
+      main_retval = 1;
+      goto cleanup;
+   }
+
+   dns_file = config.dns_blacklist_file;
+   if (dns_enabled && reload_blacklists(dns_blacklist, dns_file) == BLIST_LOAD_ERROR) {
+      cerr << "Error: Unable to read DNS blacklist file " << dns_file << endl;
+      main_retval = 1;
+      goto cleanup;
+   }
+
+   // Receive with timeout, so that the main loop regularly leaves the IP blacklist and reload can finish
+   trap_ifcctl(TRAPIFC_INPUT, 0, TRAPCTL_SETTIMEOUT, RECV_TIMEOUT);
+
+   // A single watcher watches the files of all detectors
+   if (WATCH_BLACKLISTS_FLAG) {
+      watcher_wrapper.detector_type = UNIFIED_DETECT_ID;
+      watcher_wrapper.data = (void *) &config;
+      watcher_wrapper.reload = reload_changed_blacklists;
+      watcher_wrapper.changed = 0;
+
+      if (pthread_create(&watcher_thread, NULL, watch_blacklist_files, (void *) &watcher_wrapper) > 0) {
+         cerr << "Error: Couldnt create watcher thread" << endl;
+         main_retval = 1;
+         goto cleanup;
+      }
+   }
+
+   // ***** Main processing loop, every record passes all enabled detectors *****
+   while (!stop) {
+      const void *data;
+      uint16_t data_size;
+
+      // No reference to the IP blacklist is held between records
+      BLACKLIST.quiescent();
+
+      retval = trap_recv(0, &data, &data_size);
+      if (retval == TRAP_E_FORMAT_CHANGED) {
+         const char *spec = NULL;
+         uint8_t data_fmt;
+         if (trap_get_data_fmt(TRAPIFC_INPUT, 0, &data_fmt, &spec) != TRAP_E_OK) {
+            cerr << "Error: Data format was not loaded" << endl;
+            break;
+         }
+         ur_input = ur_define_fields_and_update_template(spec, ur_input);
+         if (ur_input == NULL) {
+            cerr << "Error: Template could not be updated" << endl;
+            break;
+         }
+         has_url = ur_is_present(ur_input, F_HTTP_REQUEST_HOST) && ur_is_present(ur_input, F_HTTP_REQUEST_URL);
+         has_dns = ur_is_present(ur_input, F_DNS_NAME);
+         retval = TRAP_E_OK;
+      }
+      TRAP_DEFAULT_GET_DATA_ERROR_HANDLING(retval, continue, break);
+
+      // Check the data size
+      if (data_size != ur_rec_size(ur_input, data)) {
+         if (data_size > 1) { // data corrupted
+            cerr << "ERROR: Corrupted data or wrong data template was specified. ";
+            cerr << "Size computed from record: " << ur_rec_size(ur_input, data) << " ";
+            cerr << "Size returned from Trap: " << data_size << endl;
+         }
+         // end of data
+         break;
+      }
+
+      // DNS traffic is not checked against the IP blacklist (same as ipblacklistfilter)
+      if (ip_enabled && !is_dns_traffic(ur_input, data) &&
+          check_ip_blacklist(ur_input, ur_output[BL_IFC_IP], data, detection[BL_IFC_IP], *BLACKLIST.get()) == BLACKLISTED) {
+         send_detection(BL_IFC_IP, ur_output[BL_IFC_IP], detection[BL_IFC_IP], ur_input, data);
+      }
+
+      if (url_enabled && has_url &&
+          check_blacklist(url_blacklist, ur_input, ur_output[BL_IFC_URL], data, detection[BL_IFC_URL]) == BLACKLISTED) {
+         send_detection(BL_IFC_URL, ur_output[BL_IFC_URL], detection[BL_IFC_URL], ur_input, data);
+      }
+
+      if (dns_enabled && has_dns &&
+          check_blacklist(dns_blacklist, ur_input, ur_output[BL_IFC_DNS], data, detection[BL_IFC_DNS]) == BLACKLISTED) {
+         send_detection(BL_IFC_DNS, ur_output[BL_IFC_DNS], detection[BL_IFC_DNS], ur_input, data);
+      }
+
+      // URL and DNS blacklists are used only by this thread, they are updated here
+      if (RELOAD_FILES.load(std::memory_order_relaxed) != 0) {
+         const uint32_t changed = RELOAD_FILES.exchange(0);
+         if (url_enabled && (changed & BL_CHANGED_URL) && reload_blacklists(url_blacklist, url_file) == BLIST_LOAD_ERROR) {
+            cerr << "ERROR: Unable to load URL blacklist update. Will use the old table instead." << endl;
+         }
+         if (dns_enabled && (changed & BL_CHANGED_DNS) && reload_blacklists(dns_blacklist, dns_file) == BLIST_LOAD_ERROR) {
+            cerr << "ERROR: Unable to load DNS blacklist update. Will use the old table instead." << endl;
+         }
+      }
+   }
+
+   // Do not let a reload in progress wait for the main loop
+   BLACKLIST.offline();
+
+   // If set, send terminating message to modules on output
+   if (send_terminating_unirec && main_retval == 0) {
+      for (uint32_t ifc = 0; ifc < 3; ifc++) {
+         trap_send(ifc, "TERMINATE", 1);
+      }
+   }
+
+   cleanup:
+   // Clean up before termination
+   for (int i = 0; i < 3; i++) {
+      ur_free_record(detection[i]);
+      ur_free_template(ur_output[i]);
+   }
+   ur_free_template(ur_input);
+   ur_finalize();
+
+   TRAP_DEFAULT_FINALIZATION();
+   FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS)
+
+   if (WATCH_BLACKLISTS_FLAG && watcher_thread != 0) {
+      // since watcher hangs on poll(), pthread_cancel is fine (poll is a cancelation point)
+      if (pthread_cancel(watcher_thread) == 0) {
+         pthread_join(watcher_thread, NULL);
+         DBG((stderr, "Watcher thread successfully canceled\n"));
+      } else {
+         cerr << "Warning: Failed to cancel watcher thread" << endl;
+      }
+   }
+
+   if (url_blacklist.tree != NULL) {
+      prefix_tree_destroy(url_blacklist.tree);
+   }
+   if (dns_blacklist.tree != NULL) {
+      prefix_tree_destroy(dns_blacklist.tree);
+   }
+
+   return main_retval;
+}
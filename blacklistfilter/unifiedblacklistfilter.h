@@ -0,0 +1,87 @@
+/**
+ * \file unifiedblacklistfilter.h
+ * \brief Unified blacklist filter checking IP addresses, URLs and DNS names in one pass, header file.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef UNIFIEDBLACKLISTFILTER_H
+#define UNIFIEDBLACKLISTFILTER_H
+
+#include "ipblacklistfilter.h"
+#include "urlblacklistfilter.h"
+#include "dnsblacklistfilter.h"
+
+/**
+ * Output interface of IP detections.
+ */
+#define BL_IFC_IP 0
+
+/**
+ * Output interface of URL detections.
+ */
+#define BL_IFC_URL 1
+
+/**
+ * Output interface of DNS detections.
+ */
+#define BL_IFC_DNS 2
+
+/**
+ * Bits of the watched files in watcher_wrapper_t::changed (in the order the watcher adds them).
+ */
+#define BL_CHANGED_IP4 0x1
+#define BL_CHANGED_IP6 0x2
+#define BL_CHANGED_URL 0x4
+#define BL_CHANGED_DNS 0x8
+
+/**
+ * Configuration structure.
+ */
+typedef struct __attribute__ ((__packed__)) {
+   char ipv4_blacklist_file[256];
+   char ipv6_blacklist_file[256];
+   char watch_blacklists[8];
+   char snapshot_file[256];
+   char url_blacklist_file[256];
+   char dns_blacklist_file[256];
+   char backend[8];
+} bl_config_t;
+
+#endif /* UNIFIEDBLACKLISTFILTER_H */
@@ -0,0 +1,307 @@
+/**
+ * \file url_match.cpp
+ * \brief Matching of URLs against the URL blacklist.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "fields.h"
+#include "blacklist_watcher.h"
+#include "urlblacklistfilter.h"
+
+#ifdef DEBUG
+#define DBG(x) fprintf x;
+#else
+#define DBG(x)
+#endif
+
+using namespace std;
+
+/**
+ * Function for parsing one line of the blacklist file ("entity\\bl_id").
+ * @param line Line of the blacklist file.
+ * @param url Parsed URL.
+ * @param bl_index Parsed blacklist bitfield.
+ * @return false if the line is not in the expected format.
+ */
+static bool parse_blacklist_line(const string &line, string &url, uint64_t &bl_index)
+{
+    // find URL-blacklist separator
+    size_t sep = line.find_first_of('\\');
+
+    if (sep == string::npos) {
+        return false;
+    }
+
+    // Parse blacklist ID
+    bl_index = strtoull((line.substr(sep + 1, string::npos)).c_str(), NULL, 10);
+
+    // Parse URL
+    url = line.substr(0, sep);
+    return true;
+}
+
+/**
+ * Function for inserting (or updating) the URL in the blacklist.
+ */
+static void insert_url(url_blacklist_t &blacklist, const string &url, uint64_t bl_index)
+{
+    if (blacklist.use_hash) {
+        domain_index_insert(blacklist.index, url.c_str(), url.length(), bl_index);
+        return;
+    }
+
+    prefix_tree_domain_t *elem = prefix_tree_insert(blacklist.tree, url.c_str(), strlen(url.c_str()));
+
+    if (elem != NULL) {
+        url_info_t *info = (url_info_t *) elem->value;
+        info->bl_id = bl_index;
+    } else {
+        cerr << "WARNING: Can't insert element \'" << url.c_str() << "\' to the prefix tree" << endl;
+    }
+}
+
+/**
+ * Function for removing the URL from the blacklist.
+ * Prefix tree keeps the node, it is just not blacklisted anymore (bl_id 0) until the next full reload.
+ */
+static void remove_url(url_blacklist_t &blacklist, const string &url)
+{
+    if (blacklist.use_hash) {
+        domain_index_remove(blacklist.index, url.c_str(), url.length());
+        return;
+    }
+
+    prefix_tree_domain_t *elem = prefix_tree_insert(blacklist.tree, url.c_str(), strlen(url.c_str()));
+
+    if (elem != NULL) {
+        ((url_info_t *) elem->value)->bl_id = 0;
+    }
+}
+
+/**
+ * Function for applying the delta file written by blacklist downloader to the loaded blacklist.
+ * @param blacklist Loaded blacklist.
+ * @param file Path to the blacklist file.
+ * @return false if there is no delta matching the loaded version, the file must be reloaded completely then.
+ */
+static bool apply_blacklist_delta(url_blacklist_t &blacklist, string &file)
+{
+    vector<string> added, removed;
+    blacklist_version_t version;
+    string url;
+    uint64_t bl_index;
+
+    // version is taken before reading the delta, a delta written meanwhile will not match it
+    get_blacklist_version(file, version);
+    if (!read_blacklist_delta(file, blacklist.version, added, removed)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < removed.size(); i++) {
+        remove_url(blacklist, removed[i]);
+    }
+
+    for (size_t i = 0; i < added.size(); i++) {
+        if (parse_blacklist_line(added[i], url, bl_index)) {
+            insert_url(blacklist, url, bl_index);
+        } else {
+            cerr << "WARNING: Delta of file '" << file << "' has bad formatted line '" << added[i] << "'" << endl;
+        }
+    }
+
+    DBG((stderr, "URL Blacklists updated: %zu added, %zu removed.\n", added.size(), removed.size()));
+
+    blacklist.version = version;
+    return true;
+}
+
+/**
+ * Function for loading blacklist file.
+ * Function gets path to the file and loads the blacklisted URL entities
+ * The URLs are stored in a prefix tree or in a hash index, depending on the selected backend
+ * If the downloader wrote a delta against the loaded version of the file, only the delta is applied.
+ * @param blacklist Blacklist to be filled.
+ * @param file blacklist file
+ * @return BLIST_LOAD_ERROR if directory cannot be accessed, ALL_OK otherwise.
+ */
+int reload_blacklists(url_blacklist_t &blacklist, string &file)
+{
+    // names cached as clean may be blacklisted now
+    clean_cache_invalidate(blacklist.cache);
+
+    if (apply_blacklist_delta(blacklist, file)) {
+        return ALL_OK;
+    }
+
+    // recreate the prefix tree/index with entities
+    if (blacklist.use_hash) {
+        domain_index_init(blacklist.index, DOMAIN_INDEX_PREFIX);
+    } else {
+        prefix_tree_destroy(blacklist.tree);
+        blacklist.tree = prefix_tree_initialize(PREFIX, sizeof(url_info_t), -1, DOMAIN_EXTENSION_NO, RELAXATION_AFTER_DELETE_YES);
+    }
+
+    ifstream input;
+    string line, url;
+    uint64_t bl_index;
+    int line_num = 0;
+
+    // version is taken before reading, a delta against a newer file will not match it
+    get_blacklist_version(file, blacklist.version);
+
+    input.open(file.c_str(), ifstream::in);
+    if (!input.is_open()) {
+        std::cerr << "ERROR: Cannot open file with updates. Is the downloader running?" << std::endl;
+        blacklist.version.size = -1;
+        return BLIST_LOAD_ERROR;
+    }
+
+    // load file line by line
+    while (!input.eof()) {
+        getline(input, line);
+        line_num++;
+
+        if (input.bad()) {
+            cerr << "ERROR: Failed reading blacklist file (getline badbit)" << endl;
+            input.close();
+            blacklist.version.size = -1;
+            return BLIST_LOAD_ERROR;
+        }
+
+        if (!parse_blacklist_line(line, url, bl_index)) {
+            if (line.empty()) {
+                // probably just newline at the end of file
+                continue;
+            }
+            // Blacklist index delimeter not found (bad format?), skip it
+            cerr << "WARNING: File '" << file << "' has bad formatted line number '" << line_num << "'" << endl;
+            continue;
+        }
+
+        insert_url(blacklist, url, bl_index);
+    }
+
+    DBG((stderr, "URL Blacklists Reloaded.\n"))
+
+    input.close();
+
+    return ALL_OK;
+}
+
+/**
+ * Function for checking the URL.
+ * Function gets the UniRec record with URL (Host+Path) to check and tries to find it
+ * in the given blacklist. If the function succeeds then the appropriate
+ * field in detection record is filled with the number of blacklist asociated
+ * with the URL. If the URL is clean nothing is done.
+ *
+ * @param blacklist Blacklisted elements.
+ * @param in Template of input UniRec (record).
+ * @param out Template of output UniRec (detect).
+ * @param record Record with URL for checking.
+ * @param detect Record for reporting detection of blacklisted URL.
+ * @return BLACKLISTED if the address is found in table, URL_CLEAR otherwise.
+ */
+int check_blacklist(url_blacklist_t &blacklist, ur_template_t *in, ur_template_t *out, const void *record, void *detect)
+{
+    string host, host_url;
+
+    if (ur_get_var_len(in, record, F_HTTP_REQUEST_HOST) == 0) {
+        return URL_CLEAR;
+    }
+
+    host = string(ur_get_ptr(in, record, F_HTTP_REQUEST_HOST), ur_get_var_len(in, record, F_HTTP_REQUEST_HOST));
+
+    // erase WWW prefix
+    if (host.find(WWW_PREFIX) == 0) {
+        host.erase(0, strlen(WWW_PREFIX));
+    }
+
+    host_url = host + string(ur_get_ptr(in, record, F_HTTP_REQUEST_URL), ur_get_var_len(in, record, F_HTTP_REQUEST_URL));
+
+    // Strip / (slash) from URL if it is last character
+    while (host_url[host_url.length() - 1] == '/') {
+        host_url.resize(host_url.length() - 1);
+    }
+
+    std::transform(host_url.begin(), host_url.end(), host_url.begin(), ::tolower);
+
+    const uint64_t hash = clean_cache_hash(host_url.c_str(), host_url.length());
+    if (clean_cache_lookup(blacklist.cache, hash)) {
+        return URL_CLEAR;
+    }
+
+    if (blacklist.use_hash) {
+        // longest blacklisted host/path prefix, 0 if there is none
+        uint64_t bl_id = domain_index_search(blacklist.index, host_url.c_str(), host_url.length());
+        if (bl_id > 0) {
+            DBG((stderr, "Detected blacklisted URL: '%s'\n", host_url.c_str()));
+            ur_set(out, detect, F_BLACKLIST, bl_id);
+            return BLACKLISTED;
+        }
+        clean_cache_insert(blacklist.cache, hash);
+        return URL_CLEAR;
+    }
+
+    prefix_tree_domain_t *domain = prefix_tree_search(blacklist.tree, host_url.c_str(), host_url.length());
+
+    if (domain != NULL) {
+        url_info_t *info = (url_info_t *) domain->value;
+        // blacklist index is 0 for URLs removed by a delta update
+        if (info->bl_id > 0) {
+            DBG((stderr, "Detected blacklisted URL: '%s'\n", host_url.c_str()));
+            ur_set(out, detect, F_BLACKLIST, info->bl_id);
+            return BLACKLISTED;
+        }
+    }
+
+    // URL was not found
+    clean_cache_insert(blacklist.cache, hash);
+    return URL_CLEAR;
+}
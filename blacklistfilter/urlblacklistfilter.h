@@ -50,6 +50,9 @@
 #include <string>
 #include <vector>
 #include <stdint.h>
+#include "blacklist_watcher.h"
+#include "clean_cache.h"
+#include "domain_index.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -59,6 +62,10 @@ extern "C" {
 /* include from nemea-common */
 #include <prefix_tree.h>
 
+#ifdef __cplusplus
+}
+#endif
+
 
 /**
  * Constant returned if everything is ok.
@@ -90,6 +97,7 @@ extern "C" {
 typedef struct __attribute__ ((__packed__)) {
     char blacklist_file[256];
     char watch_blacklists[8];
+    char backend[8];
 } url_config_t;
 
 /**
@@ -106,18 +114,25 @@ typedef struct {
     uint64_t bl_id;
 } url_info_t;
 
+/**
+ * Blacklisted URLs stored in the selected backend.
+ */
+typedef struct {
+    bool use_hash;           /**< Hash index is used instead of the prefix tree */
+    prefix_tree_t *tree;     /**< Prefix tree of URLs */
+    clean_cache_t cache;     /**< Recently checked clean URLs */
+    domain_index_t index;    /**< Hash index of URLs */
+    blacklist_version_t version; /**< Version of the loaded blacklist file */
+} url_blacklist_t;
+
 /**
  * Function for loading update files.
  */
-int reload_blacklists(prefix_tree_t *tree, std::string &file);
+int reload_blacklists(url_blacklist_t &blacklist, std::string &file);
 
 /**
  * Function for checking records.
  */
-int check_blacklist(prefix_tree_t *tree, ur_template_t *in, ur_template_t *out, const void *record, void *detect);
-
-#ifdef __cplusplus
-}
-#endif
+int check_blacklist(url_blacklist_t &blacklist, ur_template_t *in, ur_template_t *out, const void *record, void *detect);
 
 #endif /* URLBLACKLISTFILTER_H */
@@ -57,8 +57,13 @@
 
 #include <iostream>
 #include <string>
+#include <cstring>
 #include <map>
+#include <algorithm>
+#include <atomic>
 #include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "record.h"
 #include "config.h"
@@ -66,6 +71,11 @@
 #include "sender.h"
 #include "brute_force_detector.h"
 #include "whitelist.h"
+#include "detector.h"
+#include "worker.h"
+#include "prefilter.h"
+#include "checkpoint.h"
+#include "ur_fixed.h"
 #include <locale>
 #include <sys/time.h>
 #include <iomanip>
@@ -93,6 +103,41 @@ UR_FIELDS(
   uint8 TCP_FLAGS,    //TCP flags of a flow (logical OR over TCP flags field of all packets)
 )
 
+//record of the input template as UniRec lays it out, the fields are read
+//directly while the negotiated template matches (see ur_fixed.h)
+struct __attribute__ ((__packed__)) InputRecord {
+    ip_addr_t dstIp;
+    ip_addr_t srcIp;
+    uint64_t  bytes;
+    ur_time_t timeFirst;
+    ur_time_t timeLast;
+    uint32_t  packets;
+    uint16_t  dstPort;
+    uint16_t  srcPort;
+    uint8_t   protocol;
+    uint8_t   tcpFlags;
+};
+
+static const ur_fixed_field_t INPUT_RECORD_FIELDS[] = {
+    UR_FIXED_FIELD(InputRecord, dstIp, F_DST_IP),
+    UR_FIXED_FIELD(InputRecord, srcIp, F_SRC_IP),
+    UR_FIXED_FIELD(InputRecord, bytes, F_BYTES),
+    UR_FIXED_FIELD(InputRecord, timeFirst, F_TIME_FIRST),
+    UR_FIXED_FIELD(InputRecord, timeLast, F_TIME_LAST),
+    UR_FIXED_FIELD(InputRecord, packets, F_PACKETS),
+    UR_FIXED_FIELD(InputRecord, dstPort, F_DST_PORT),
+    UR_FIXED_FIELD(InputRecord, srcPort, F_SRC_PORT),
+    UR_FIXED_FIELD(InputRecord, protocol, F_PROTOCOL),
+    UR_FIXED_FIELD(InputRecord, tcpFlags, F_TCP_FLAGS),
+};
+
+static bool isInputRecord(const ur_template_t *tmplt)
+{
+    return ur_fixed_match(tmplt, INPUT_RECORD_FIELDS, UR_FIXED_FIELD_COUNT(INPUT_RECORD_FIELDS), sizeof(InputRecord));
+}
+
+#define GET_FIELD(fixed, member, tmplt, data, field_id) ur_fixed_get(fixed, InputRecord, member, tmplt, data, field_id)
+
 /* ************************************************************************* */
 // Struct with information about module
 trap_module_info_t *module_info = NULL;
@@ -107,11 +152,33 @@ TelnetServerProfileMap TELNETRecord::TSPMap;
     PARAM('R', "RDP", "Set detection mode to RDP.", no_argument, "none") \
     PARAM('T', "TELNET", "Set detection mode to TELNET.", no_argument, "none") \
     PARAM('c', "config", "Specify configuration file. Signal SIGUSR1 can be used for reload configuration file. (not required)", required_argument, "string") \
-    PARAM('w', "whitelist", "Specify whitelist file. Signal SIGUSR2 can be used for whitelist reload. (not required)", required_argument, "string") \
-    PARAM('W', "verbose", "Set whitelist parser to verbose mode.", no_argument, "none")
+    PARAM('w', "whitelist", "Specify whitelist file. Signal SIGUSR2 can be used for whitelist reload (the whitelist is loaded in the background). (not required)", required_argument, "string") \
+    PARAM('W', "verbose", "Set whitelist parser to verbose mode.", no_argument, "none") \
+    PARAM('n', "workers", "Number of detection threads, flows are distributed among them by the attacker IP (default 0, detection in the receiving thread).", required_argument, "uint32") \
+    PARAM('M', "metrics", "UNIX socket serving runtime metrics in Prometheus text format. (not required)", required_argument, "string") \
+    PARAM('k', "checkpoint", "File with the checkpoint of the hosts, it is loaded at startup and saved on exit. (not required)", required_argument, "string") \
+    PARAM('K', "checkpoint-interval", "Period of checkpoints in seconds of the flow time (default 0, checkpoint is saved only on exit).", required_argument, "uint32")
 
 static int stop = 0;
-Whitelist whitelist;
+
+// Receive timeout (us) when the detection runs in workers, their queued alerts are sent at least this often
+const static int WORKER_ALERT_TIMEOUT = 500000;
+
+// Set by SIGUSR1, the configuration is reloaded and published by configReloadThread
+static volatile sig_atomic_t configReloadRequested = 0;
+static bool configReloadStarted = false;
+static std::atomic<bool> configReloadRunning(false);
+static pthread_t configReloadThreadId;
+
+// Whitelist used by the detection, replaced by whitelistReloadThread
+static SharedWhitelist whitelist;
+static char *whitelistFilePath = NULL;
+
+// Set by SIGUSR2, the whitelist is built by whitelistReloadThread
+static volatile sig_atomic_t whitelistReloadRequested = 0;
+static bool whitelistReloadStarted = false;
+static std::atomic<bool> whitelistReloadRunning(false);
+static pthread_t whitelistReloadThreadId;
 
 void signalHandler(int signal)
 {
@@ -122,30 +189,147 @@ void signalHandler(int signal)
     }
     else if(signal == SIGUSR1)
     {
-        Config::getInstance().reloadConfig();
+        configReloadRequested = 1;
     }
     else if(signal == SIGUSR2)
     {
-        if(!whitelist.isLockedForConfigurationReload())
-            whitelist.reloadWhitelist();
-        else
-            alarm(1); //cannot reload now.. wait
+        whitelistReloadRequested = 1;
+    }
+}
+
+void *whitelistReloadThread(void *)
+{
+    Whitelist *newWhitelist = new Whitelist();
+
+    if(!newWhitelist->init(whitelistFilePath, false))
+    {
+        cerr << "Error Whitelist: Cannot open whitelist file!\n";
+        delete newWhitelist;
     }
-    else if(signal == SIGALRM)
+    else
+    {
+        whitelist.publish(newWhitelist);
+        cout << "Whitelist: Whitelist reloaded successfully.\n";
+    }
+
+    whitelistReloadRunning = false;
+    return NULL;
+}
+
+/**
+ * Start reload of the whitelist if requested, called by the main loop between flows.
+ */
+void updateWhitelist()
+{
+    if(whitelistReloadRequested && !whitelistReloadRunning)
     {
-        if(!whitelist.isLockedForConfigurationReload())
-            whitelist.reloadWhitelist();
+        whitelistReloadRequested = 0;
+
+        if(whitelistFilePath == NULL)
+            cerr << "Error Whitelist: Whitelist path is not set!\n";
         else
-            alarm(1); //wait another second
+        {
+            if(whitelistReloadStarted)
+                pthread_join(whitelistReloadThreadId, NULL);
+
+            whitelistReloadRunning = true;
+            whitelistReloadStarted = pthread_create(&whitelistReloadThreadId, NULL, whitelistReloadThread, NULL) == 0;
+            if(!whitelistReloadStarted)
+            {
+                cerr << "Error Whitelist: Cannot create reload thread!\n";
+                whitelistReloadRunning = false;
+            }
+        }
     }
 }
 
-bool checkForTimeout(ur_time_t oldTime, ur_time_t timer, ur_time_t actualTime)
+void *configReloadThread(void *)
 {
-    if(oldTime + timer <= actualTime)
-        return true;
-    else
-        return false;
+    //the threads take the new snapshot before their next flow
+    Config::getInstance().reloadConfig();
+
+    configReloadRunning = false;
+    return NULL;
+}
+
+/**
+ * Start reload of the configuration if requested, called by the main loop between flows.
+ */
+void updateConfig()
+{
+    if(configReloadRequested && !configReloadRunning)
+    {
+        configReloadRequested = 0;
+
+        if(configReloadStarted)
+            pthread_join(configReloadThreadId, NULL);
+
+        configReloadRunning = true;
+        configReloadStarted = pthread_create(&configReloadThreadId, NULL, configReloadThread, NULL) == 0;
+        if(!configReloadStarted)
+        {
+            cerr << "Error Config: Cannot create reload thread!\n";
+            configReloadRunning = false;
+        }
+    }
+}
+
+// Periodic checkpoint of the hosts, taken every checkpointInterval seconds of the flow time
+static uint32_t checkpointInterval = 0;
+static uint32_t nextCheckpoint = 0;
+static ur_time_t checkpointTime = 0;
+static bool checkpointPending = false;
+static vector<CheckpointBuffer> checkpointParts;
+static vector<bool> checkpointTaken;
+
+/**
+ * Take a periodic checkpoint, called by the main loop between flows. Hosts are serialized
+ * by the threads owning them and written by the checkpoint writer in the background.
+ */
+void updateCheckpoint(CheckpointWriter *writer, ur_time_t actualTime, Detector *detector, vector<Worker *> &workers)
+{
+    if(writer == NULL || checkpointInterval == 0)
+        return;
+
+    if(!checkpointPending)
+    {
+        uint32_t now = ur_time_get_sec(actualTime);
+        if(nextCheckpoint == 0)
+            nextCheckpoint = now + checkpointInterval;
+        if(now < nextCheckpoint || writer->isRunning())
+            return;
+
+        nextCheckpoint = now + checkpointInterval;
+        checkpointTime = actualTime;
+        if(detector != NULL)
+        {
+            checkpointParts.resize(1);
+            detector->saveCheckpoint(checkpointParts[0]);
+            writer->start(checkpointTime, checkpointParts);
+            return;
+        }
+
+        checkpointParts.resize(workers.size());
+        checkpointTaken.assign(workers.size(), false);
+        for(size_t i = 0; i < workers.size(); i++)
+            workers[i]->requestCheckpoint();
+        checkpointPending = true;
+        return;
+    }
+
+    //hosts of the workers are written when all of them are serialized
+    bool complete = true;
+    for(size_t i = 0; i < workers.size(); i++)
+    {
+        if(!checkpointTaken[i])
+            checkpointTaken[i] = workers[i]->takeCheckpoint(checkpointParts[i]);
+        complete = complete && checkpointTaken[i];
+    }
+    if(complete)
+    {
+        writer->start(checkpointTime, checkpointParts);
+        checkpointPending = false;
+    }
 }
 
 void printFlowPercent(uint64_t b, uint64_t p)
@@ -163,6 +347,18 @@ void printFlowPercent(uint64_t b, uint64_t p)
 
 }
 
+void printProtocolStats(const char *name, const ProtocolStats &stats, uint32_t hostMapSize)
+{
+    cout.imbue(std::locale(std::locale(), new thousandsSeparator));
+    cout << name << " Counter: " << stats.totalFlows << endl;
+    cout << name << " Incoming Counter: " << stats.totalIncomingFlows; printFlowPercent(stats.totalFlows, stats.totalIncomingFlows); cout << endl;
+    cout << name << " Outgoing Counter: " << stats.totalOutgoingFlows; printFlowPercent(stats.totalFlows, stats.totalOutgoingFlows); cout << endl;
+    cout << name << " Matched Counter: "  << stats.totalMatchedFlows; printFlowPercent(stats.totalFlows, stats.totalMatchedFlows); cout << endl;
+    cout << name << " Matched Incoming Counter: " << stats.totalMatchedIncomingFlows; printFlowPercent(stats.totalMatchedFlows, stats.totalMatchedIncomingFlows); printFlowPercent(stats.totalFlows, stats.totalMatchedIncomingFlows); cout << endl;
+    cout << name << " Matched Outgoing Counter: " << stats.totalMatchedOutgoingFlows; printFlowPercent(stats.totalMatchedFlows, stats.totalMatchedOutgoingFlows); printFlowPercent(stats.totalFlows, stats.totalMatchedOutgoingFlows); cout << endl;
+    cout << name << " host map size: " << hostMapSize << endl;
+}
+
 int main(int argc, char **argv)
 {
     // ***** TRAP initialization *****
@@ -183,28 +379,27 @@ int main(int argc, char **argv)
     sigaddset(&sigAction.sa_mask, SIGINT);
     sigaddset(&sigAction.sa_mask, SIGUSR1);
     sigaddset(&sigAction.sa_mask, SIGUSR2);
-    sigaddset(&sigAction.sa_mask, SIGALRM);
 
     //register signal handler
     sigaction (SIGTERM, &sigAction, NULL);
     sigaction (SIGINT , &sigAction, NULL);
     sigaction (SIGUSR1, &sigAction, NULL);
     sigaction (SIGUSR2, &sigAction, NULL);
-    sigaction (SIGALRM, &sigAction, NULL);
 #else
     signal(SIGTERM, signalHandler);
     signal(SIGINT,  signalHandler);
     signal(SIGUSR1, signalHandler);
     signal(SIGUSR2, signalHandler);
-    signal(SIGALRM, signalHandler);
 #endif
 
     // ***** Parsing non TRAP arguments *****
     signed char opt;
     char *configFilePath = NULL;
-    char *whitelistFilePath = NULL;
     bool whitelistParserVerbose = false;
-    bool RDP = false, SSH = false, TELNET = false;
+    bool enabled[PROTOCOL_COUNT] = {false};
+    unsigned workerCount = 0;
+    char *metricsSocketPath = NULL;
+    char *checkpointFilePath = NULL;
     while((opt = TRAP_GETOPT(argc, argv, module_getopt_string, long_options)) != -1)
     {
         switch (opt)
@@ -219,13 +414,25 @@ int main(int argc, char **argv)
             whitelistParserVerbose = true;
             break;
         case 'R':
-            RDP = true;
+            enabled[PROTOCOL_RDP] = true;
             break;
         case 'S':
-            SSH = true;
+            enabled[PROTOCOL_SSH] = true;
             break;
         case 'T':
-            TELNET = true;
+            enabled[PROTOCOL_TELNET] = true;
+            break;
+        case 'n':
+            workerCount = atoi(optarg);
+            break;
+        case 'M':
+            metricsSocketPath = optarg;
+            break;
+        case 'k':
+            checkpointFilePath = optarg;
+            break;
+        case 'K':
+            checkpointInterval = atoi(optarg);
             break;
         default:
             cerr << "Error: Invalid arguments.\n";
@@ -234,7 +441,7 @@ int main(int argc, char **argv)
         }
     }
 
-    if(!RDP && !SSH && !TELNET)
+    if(std::find(enabled, enabled + PROTOCOL_COUNT, true) == enabled + PROTOCOL_COUNT)
     {
         cerr << "Error: Detection mode is not set.\n";
         return 3;
@@ -252,17 +459,24 @@ int main(int argc, char **argv)
         }
     }
 
+    //settings of the receiving thread, the workers take their own
+    SettingsHandle settings;
+    settings.update();
+
 	// ***** Whitelist init *****
+    Whitelist *initialWhitelist = new Whitelist();
     if(whitelistFilePath != NULL)
     {
-        bool state = whitelist.init(whitelistFilePath, whitelistParserVerbose);
+        bool state = initialWhitelist->init(whitelistFilePath, whitelistParserVerbose);
         if (!state)
         {
             cerr << "Error: Cannot open whitelist file.\n";
+            delete initialWhitelist;
             FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS)
             return 5;
         }
     }
+    whitelist.publish(initialWhitelist);
 
     // ***** Create UniRec template for input *****
     std::string unirecSpecifier = "SRC_IP,DST_IP,SRC_PORT,DST_PORT,PROTOCOL,PACKETS,BYTES,TIME_FIRST,TIME_LAST,TCP_FLAGS";
@@ -294,44 +508,117 @@ int main(int argc, char **argv)
         return 4;
     }
 
+    // ***** Runtime metrics *****
+    metrics_counter_t *receivedFlows = metrics_counter("brute_force_received_flows_total", "Flows received from the input interface.");
+    metrics_counter_t *rejectedFlows = metrics_counter("brute_force_prefilter_rejected_flows_total", "Flows of other protocols and services.");
+    if(metricsSocketPath != NULL && metrics_server_start(metricsSocketPath) != 0)
+    {
+        cerr << "Error: Cannot serve metrics on socket \"" << metricsSocketPath << "\".\n";
+        delete sender;
+        ur_free_template(tmplt);
+        trap_finalize();
+        FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS)
+        return 5;
+    }
+
+    // ***** Detection threads *****
+    //detection runs in the receiving thread (workerCount 0) or in the workers
+    Detector *detector = NULL;
+    WhitelistHandle whitelistHandle(&whitelist);
+    vector<Worker *> workers;
+    vector<Detector *> detectors;
+
+    if(workerCount == 0)
+    {
+        detector = new Detector(enabled, sender);
+        detector->loadConfig(settings.get());
+        detectors.push_back(detector);
+    }
+    else
+    {
+        sender->enableQueue();
+        for(unsigned i = 0; i < workerCount; i++)
+        {
+            workers.push_back(new Worker(enabled, sender, &whitelist));
+            detectors.push_back(&workers.back()->getDetector());
+        }
+    }
+
+    // ***** Checkpoint *****
+    //hosts are loaded before the workers start, with the settings of this thread
+    CheckpointWriter *checkpointWriter = NULL;
+    ur_time_t lastFlowTime = 0;
+    if(checkpointFilePath != NULL)
+    {
+        if(!loadCheckpoint(checkpointFilePath, detectors))
+            cout << "Checkpoint: No checkpoint loaded from \"" << checkpointFilePath << "\".\n";
+        checkpointWriter = new CheckpointWriter(checkpointFilePath);
+    }
+
+    for(size_t i = 0; i < workers.size(); i++)
+    {
+        if(!workers[i]->start())
+        {
+            cerr << "Error: Cannot create detection thread.\n";
+            stop = 1;
+            break;
+        }
+    }
 
     // ***** Main processing loop *****
-    SSHHostMap    sshHostMap;
-    RDPHostMap    rdpHostMap;
-    TELNETHostMap telnetHostMap;
-
-    uint64_t SSHTotalFlows = 0;
-    uint64_t SSHTotalIncomingFlows = 0;
-    uint64_t SSHTotalOutgoingFlows = 0;
-    uint64_t SSHTotalMatchedFlows  = 0;
-    uint64_t SSHTotalMatchedIncomingFlows = 0;
-    uint64_t SSHTotalMatchedOutgoingFlows = 0;
-
-    uint64_t RDPTotalFlows = 0;
-    uint64_t RDPTotalIncomingFlows = 0;
-    uint64_t RDPTotalOutgoingFlows = 0;
-    uint64_t RDPTotalMatchedFlows  = 0;
-    uint64_t RDPTotalMatchedIncomingFlows = 0;
-    uint64_t RDPTotalMatchedOutgoingFlows = 0;
-
-    uint64_t TELNETTotalFlows = 0;
-    uint64_t TELNETTotalIncomingFlows = 0;
-    uint64_t TELNETTotalOutgoingFlows = 0;
-    uint64_t TELNETTotalMatchedFlows = 0;
-    uint64_t TELNETTotalMatchedIncomingFlows = 0;
-    uint64_t TELNETTotalMatchedOutgoingFlows = 0;
-
-    ur_time_t timeOfLastReportCheck = 0;
-    ur_time_t timeOfLastDeleteCheck = 0;
-    ur_time_t timerForReportCheck = Config::getInstance().getGlobalTimerForReportCheck();
-    ur_time_t timerForDeleteCheck = Config::getInstance().getGlobalTimerForDeleteCheck();
+    //ports of the enabled services, first filter of the flows
+    FlowPrefilter prefilter;
+    //protocol of the service listening on the port
+    static uint8_t portTable[65536];
+    memset(portTable, PROTOCOL_NONE, sizeof(portTable));
+    for(int i = 0; i < PROTOCOL_COUNT; i++)
+    {
+        if(enabled[i])
+        {
+            prefilter.addPort(PROTOCOLS[i].port);
+            portTable[PROTOCOLS[i].port] = i;
+        }
+    }
+
+    //records are read directly while the template matches the specifier
+    bool fixed = isInputRecord(tmplt);
+
+    //the receiving thread wakes up regularly to send alerts of the workers in quiet periods
+    if(!workers.empty())
+        trap_ifcctl(TRAPIFC_INPUT, 0, TRAPCTL_SETTIMEOUT, WORKER_ALERT_TIMEOUT);
 
     while(!stop)
     {
-        // Receive data from input interface (block until data are available)
+        //alerts queued by the workers (also by their report and delete checks) are sent before every receive
+        if(!workers.empty())
+        {
+            ret = sender->flushAlerts();
+            TRAP_DEFAULT_SEND_DATA_ERROR_HANDLING(ret, ret = TRAP_E_OK, break);
+        }
+
+        // Receive data from input interface (block until data are available, up to the timeout with workers)
         const void *data;
         uint16_t data_size;
-        ret = TRAP_RECEIVE(0, data, data_size, tmplt);
+        ret = trap_recv(0, &data, &data_size);
+        if(ret == TRAP_E_FORMAT_CHANGED)
+        {
+            //the record is already in the new format
+            const char *spec = NULL;
+            uint8_t dataFmt;
+            if(trap_get_data_fmt(TRAPIFC_INPUT, 0, &dataFmt, &spec) != TRAP_E_OK)
+            {
+                cerr << "Error: Data format was not loaded.\n";
+                break;
+            }
+            tmplt = ur_define_fields_and_update_template(spec, tmplt);
+            if(tmplt == NULL)
+            {
+                cerr << "Error: Template could not be edited.\n";
+                break;
+            }
+            fixed = isInputRecord(tmplt);
+            ret = TRAP_E_OK;
+        }
         TRAP_DEFAULT_RECV_ERROR_HANDLING(ret, continue, break);
 
         // Check size of received data
@@ -350,307 +637,127 @@ int main(int argc, char **argv)
             }
         }
 
-        //Skip non TCP flows
-        if(ur_get(tmplt, data, F_PROTOCOL) != TCP_PROTOCOL_NUM) //TCP flows only
-            continue;
-
-        uint16_t dstPort = ur_get(tmplt, data, F_DST_PORT);
-        uint16_t srcPort = ur_get(tmplt, data, F_SRC_PORT);
+        metrics_counter_inc(receivedFlows);
+        updateWhitelist();
+        updateConfig();
+        if(settings.update() && detector != NULL)
+            detector->loadConfig(settings.get());
 
-	    if(dstPort != TCP_SSH_PORT && dstPort != TCP_TELNET_PORT && dstPort != TCP_RDP_PORT
-	       && srcPort != TCP_SSH_PORT && srcPort != TCP_TELNET_PORT && srcPort != TCP_RDP_PORT)
-	        continue;
+        //Skip non TCP flows and flows of other services
+        uint16_t dstPort = GET_FIELD(fixed, dstPort, tmplt, data, F_DST_PORT);
+        uint16_t srcPort = GET_FIELD(fixed, srcPort, tmplt, data, F_SRC_PORT);
+        if(!prefilter.isCandidate(GET_FIELD(fixed, protocol, tmplt, data, F_PROTOCOL), srcPort, dstPort))
+        {
+            metrics_counter_inc(rejectedFlows);
+            continue;
+        }
 
-	    uint8_t direction;
-        if(dstPort == TCP_SSH_PORT || dstPort == TCP_TELNET_PORT || dstPort == TCP_RDP_PORT)
-            direction = FLOW_INCOMING_DIRECTION;
-        else
-            direction = FLOW_OUTGOING_DIRECTION;
+        //flow to the service is incoming, flow from the service is outgoing
+        FlowTask task;
+        task.direction = FLOW_INCOMING_DIRECTION;
+        task.protocol = portTable[dstPort];
+        if(task.protocol == PROTOCOL_NONE)
+        {
+            task.protocol = portTable[srcPort];
+            task.direction = FLOW_OUTGOING_DIRECTION;
+        }
 
 	    // Process rest of new data
-        ip_addr_t srcIp     = ur_get(tmplt, data, F_SRC_IP);
-        ip_addr_t dstIp     = ur_get(tmplt, data, F_DST_IP);
-        uint8_t   tcpFlags  = ur_get(tmplt, data, F_TCP_FLAGS);
-        uint32_t  packets   = ur_get(tmplt, data, F_PACKETS);
-        uint64_t  bytes     = ur_get(tmplt, data, F_BYTES);
-        ur_time_t flowFirstSeen = ur_get(tmplt, data, F_TIME_FIRST);
-        ur_time_t flowLastSeen  = ur_get(tmplt, data, F_TIME_LAST);
-
-        IRecord::MatchStructure structure;
-        structure.flags   = tcpFlags;
-        structure.packets = packets;
-        structure.bytes   = bytes;
-        structure.srcIp   = srcIp;
-        structure.flowFirstSeen = flowFirstSeen;
-        structure.flowLastSeen  = flowLastSeen;
-        structure.dstIp   = dstIp;
+        IRecord::MatchStructure &structure = task.structure;
+        structure.flags   = GET_FIELD(fixed, tcpFlags, tmplt, data, F_TCP_FLAGS);
+        structure.packets = GET_FIELD(fixed, packets, tmplt, data, F_PACKETS);
+        structure.bytes   = GET_FIELD(fixed, bytes, tmplt, data, F_BYTES);
+        structure.srcIp   = GET_FIELD(fixed, srcIp, tmplt, data, F_SRC_IP);
+        structure.dstIp   = GET_FIELD(fixed, dstIp, tmplt, data, F_DST_IP);
         structure.srcPort = srcPort;
         structure.dstPort = dstPort;
+        structure.flowFirstSeen = GET_FIELD(fixed, timeFirst, tmplt, data, F_TIME_FIRST);
+        structure.flowLastSeen  = GET_FIELD(fixed, timeLast, tmplt, data, F_TIME_LAST);
 
-        ret = 0;
+        lastFlowTime = structure.flowLastSeen;
+        updateCheckpoint(checkpointWriter, lastFlowTime, detector, workers);
 
-        // *** SSH ***
-        if(SSH && (dstPort == TCP_SSH_PORT || srcPort == TCP_SSH_PORT))
+        if(detector != NULL)
         {
-            bool state;
-            SSHRecord *record;
-
-            if(direction == FLOW_INCOMING_DIRECTION)
-            {
-                record = new SSHRecord(dstIp, flowLastSeen);
-                state = record->matchWithIncomingSignature(&structure, &whitelist);
-                if(state)
-                    SSHTotalMatchedIncomingFlows++;
-                SSHTotalIncomingFlows++;
-            }
-            else
-            { // FLOW_OUTGOING_DIRECTION
-                record = new SSHRecord(srcIp, flowLastSeen);
-                state = record->matchWithOutgoingSignature(&structure, &whitelist);
-                if(state)
-                    SSHTotalMatchedOutgoingFlows++;
-                SSHTotalOutgoingFlows++;
-            }
-
-            if(state)
-                SSHTotalMatchedFlows++;
-            SSHTotalFlows++;
-
-            SSHHost *host = sshHostMap.findHost(&structure, direction);
-
-            state = host->addRecord(record, &structure, direction);
-            if(!state)
-                delete record;
-            else
-            {				//check for attack
-                SSHHost::ATTACK_STATE attackState = host->checkForAttack(flowLastSeen);
-                if(attackState != SSHHost::NO_ATTACK)
-                {
-                    if(attackState == SSHHost::NEW_ATTACK)
-                        ret = sender->firstReport(host, TCP_SSH_PORT, flowLastSeen, Config::getInstance().getSSHListThreshold());
-                    else if(attackState == SSHHost::ATTACK_REPORT_WAIT || attackState == SSHHost::ATTACK_MIN_EVENTS_WAIT)
-                    {
-                        //waiting for report timeout or min events to report
-                        //no action
-                    }
-                    else if(attackState == SSHHost::END_OF_ATTACK)
-                    {
-                        //clear list
-                        host->clearAllRecords();
-                        host->setNotReported();
-                    }
-                    else if(attackState == SSHHost::REPORT_END_OF_ATTACK)
-                    {
-                        //report and clear list
-                        ret = sender->continuingReport(host, TCP_SSH_PORT, flowLastSeen, true);
-
-                        host->clearAllRecords();
-                        host->setNotReported();
-                    }
-                    else if(attackState == SSHHost::ATTACK)
-                    {
-                        ret = sender->continuingReport(host, TCP_SSH_PORT, flowLastSeen);
-                    }
-                }
-            }
+            ret = detector->processFlow(task.protocol, structure, task.direction, whitelistHandle.get());
+            detector->checkTimeouts(structure.flowLastSeen);
         }
-
-        // *** RDP ***
-        if(RDP && (dstPort == TCP_RDP_PORT || srcPort == TCP_RDP_PORT))
+        else
         {
-            bool state;
-            RDPRecord *record;
-
-            if(direction == FLOW_INCOMING_DIRECTION)
-            {
-                record = new RDPRecord(dstIp, flowLastSeen);
-                state = record->matchWithIncomingSignature(&structure, &whitelist);
-                if(state)
-                    RDPTotalMatchedIncomingFlows++;
-                RDPTotalIncomingFlows++;
-            }
-            else
-            { // FLOW_OUTGOING_DIRECTION
-                record = new RDPRecord(srcIp, flowLastSeen);
-                state = record->matchWithOutgoingSignature(&structure, &whitelist);
-                if(state)
-                    RDPTotalMatchedOutgoingFlows++;
-                RDPTotalOutgoingFlows++;
-            }
-
-            if(state)
-                RDPTotalMatchedFlows++;
-            RDPTotalFlows++;
-
-            RDPHost *host = rdpHostMap.findHost(&structure, direction);
-
-            state = host->addRecord(record, &structure, direction);
-            if(!state)
-                delete record;
-            else
-            {					  //check for attack
-                RDPHost::ATTACK_STATE attackState = host->checkForAttack(flowLastSeen);
-                if(attackState != RDPHost::NO_ATTACK)
-                {
-                    if(attackState == RDPHost::NEW_ATTACK)
-                        ret = sender->firstReport(host, TCP_RDP_PORT, flowLastSeen, Config::getInstance().getRDPListThreshold());
-                    else if(attackState == RDPHost::ATTACK_REPORT_WAIT || attackState == RDPHost::ATTACK_MIN_EVENTS_WAIT)
-                    {
-                        //waiting for report timeout or min events to report
-                        //no action
-                    }
-                    else if(attackState == RDPHost::END_OF_ATTACK)
-                    {
-                        host->clearAllRecords();
-                        host->setNotReported();
-                    }
-                    else if(attackState == RDPHost::REPORT_END_OF_ATTACK)
-                    {
-                        //report and clear list
-                        ret = sender->continuingReport(host, TCP_RDP_PORT, flowLastSeen, true);
-
-                        host->clearAllRecords();
-                        host->setNotReported();
-                    }
-                    else if(attackState == RDPHost::ATTACK)
-                    {
-                        ret = sender->continuingReport(host, TCP_RDP_PORT, flowLastSeen);
-                    }
-                }
+            Worker *worker = workers[getWorkerIndex(getAttackerIp(task), workers.size())];
+            while(!worker->push(task))
+            { //worker is overloaded, send alerts meanwhile
+                ret = sender->flushAlerts();
+                if(ret != TRAP_E_OK)
+                    break;
+                sched_yield();
             }
         }
 
-        // *** TELNET ***
-        if(TELNET && (dstPort == TCP_TELNET_PORT || srcPort == TCP_TELNET_PORT))
-        {
-            bool state;
-            TELNETRecord *record;
+	    //kontrola po odeslani
+	    TRAP_DEFAULT_SEND_DATA_ERROR_HANDLING(ret, continue, break);
 
-            if(direction == FLOW_INCOMING_DIRECTION)
-            {
-                record = new TELNETRecord(dstIp, flowLastSeen);
-                state = record->matchWithIncomingSignature(&structure, &whitelist);
-                if(state)
-                    TELNETTotalMatchedIncomingFlows++;
-                TELNETTotalIncomingFlows++;
-            }
-            else
-            { // FLOW_OUTGOING_DIRECTION
-                record = new TELNETRecord(srcIp, flowLastSeen);
-                state = record->matchWithOutgoingSignature(&structure, &whitelist);
-                if(state)
-                    TELNETTotalMatchedOutgoingFlows++;
-                TELNETTotalOutgoingFlows++;
-            }
+    } // ***** End of main processing loop *****
 
-            if(state)
-                TELNETTotalMatchedFlows++;
-            TELNETTotalFlows++;
+    // ***** Statistics *****
+    for(size_t i = 0; i < workers.size(); i++)
+        workers[i]->finish();
+    sender->flushAlerts();
 
-            TELNETHost *host = telnetHostMap.findHost(&structure, direction);
+    cout.imbue(std::locale(std::locale(), new thousandsSeparator));
+    cout << "Prefilter candidate flows: " << prefilter.getCandidateFlows() << endl;
+    cout << "Prefilter rejected flows: " << prefilter.getRejectedFlows() << endl;
 
-            state = host->addRecord(record, &structure, direction);
-            if(!state)
-                delete record;
-            else
-            {					  //check for attack
-                TELNETHost::ATTACK_STATE attackState = host->checkForAttack(flowLastSeen);
-                if(attackState != TELNETHost::NO_ATTACK)
-                {
-                    if(attackState == TELNETHost::NEW_ATTACK)
-                        ret = sender->firstReport(host, TCP_TELNET_PORT, flowLastSeen, Config::getInstance().getTELNETListThreshold());
-                    else if(attackState == TELNETHost::ATTACK_REPORT_WAIT || attackState == TELNETHost::ATTACK_MIN_EVENTS_WAIT)
-                    {
-                        //waiting for report timeout or min events to report
-                        //no action
-                    }
-                    else if(attackState == TELNETHost::END_OF_ATTACK)
-                    {
-                        host->clearAllRecords();
-                        host->setNotReported();
-                    }
-                    else if(attackState == TELNETHost::REPORT_END_OF_ATTACK)
-                    {
-                        //report and clear list
-                        ret = sender->continuingReport(host, TCP_TELNET_PORT, flowLastSeen, true);
-
-                        host->clearAllRecords();
-                        host->setNotReported();
-                    }
-                    else if(attackState == TELNETHost::ATTACK)
-                    {
-                        ret = sender->continuingReport(host, TCP_TELNET_PORT, flowLastSeen);
-                    }
-                }
-            }
-        }
+    for(int p = 0; p < PROTOCOL_COUNT; p++)
+    {
+        if(!enabled[p])
+            continue;
 
-        //check for timeout
-        if(checkForTimeout(timeOfLastReportCheck, timerForReportCheck, flowLastSeen))
+        ProtocolStats stats;
+        uint32_t hostMapSize = 0;
+        if(detector != NULL)
         {
-            timeOfLastReportCheck = flowLastSeen;
-
-            if(SSH)
-                sshHostMap.checkForAttackTimeout(flowLastSeen, sender);
-            if(RDP)
-                rdpHostMap.checkForAttackTimeout(flowLastSeen, sender);
-            if(TELNET)
-                telnetHostMap.checkForAttackTimeout(flowLastSeen, sender);
+            stats = detector->getStats(p);
+            hostMapSize = detector->getHostMapSize(p);
         }
-        if(checkForTimeout(timeOfLastDeleteCheck, timerForDeleteCheck, flowLastSeen))
+        for(size_t i = 0; i < workers.size(); i++)
         {
-            timeOfLastDeleteCheck = flowLastSeen;
-
-            if(SSH)
-                sshHostMap.deleteOldRecordAndHosts(flowLastSeen);
-            if(RDP)
-                rdpHostMap.deleteOldRecordAndHosts(flowLastSeen);
-            if(TELNET)
-                telnetHostMap.deleteOldRecordAndHosts(flowLastSeen);
+            stats.add(workers[i]->getDetector().getStats(p));
+            hostMapSize += workers[i]->getDetector().getHostMapSize(p);
         }
+        printProtocolStats(PROTOCOLS[p].name, stats, hostMapSize);
+    }
 
-	    //kontrola po odeslani
-	    TRAP_DEFAULT_SEND_DATA_ERROR_HANDLING(ret, continue, break);
-
-    } // ***** End of main processing loop *****
-
-    if(SSH)
+    // ***** Checkpoint on exit *****
+    if(checkpointWriter != NULL)
     {
-        cout.imbue(std::locale(std::locale(), new thousandsSeparator));
-        cout << "SSH Counter: " << SSHTotalFlows << endl;
-        cout << "SSH Incoming Counter: " << SSHTotalIncomingFlows; printFlowPercent(SSHTotalFlows, SSHTotalIncomingFlows); cout<<endl;
-        cout << "SSH Outgoing Counter: " << SSHTotalOutgoingFlows; printFlowPercent(SSHTotalFlows, SSHTotalOutgoingFlows); cout<<endl;
-        cout << "SSH Matched Counter: "  << SSHTotalMatchedFlows; printFlowPercent(SSHTotalFlows, SSHTotalMatchedFlows); cout<<endl;
-	    cout << "SSH Matched Incoming Counter: " << SSHTotalMatchedIncomingFlows; printFlowPercent(SSHTotalMatchedFlows, SSHTotalMatchedIncomingFlows); printFlowPercent(SSHTotalFlows, SSHTotalMatchedIncomingFlows); cout<<endl;
-        cout << "SSH Matched Outgoing Counter: " << SSHTotalMatchedOutgoingFlows; printFlowPercent(SSHTotalMatchedFlows, SSHTotalMatchedOutgoingFlows); printFlowPercent(SSHTotalFlows, SSHTotalMatchedOutgoingFlows); cout<<endl; 
-        cout << "SSH host map size: " << sshHostMap.size() << endl;
-        sshHostMap.clear();
+        //the workers are finished, their hosts are serialized by this thread
+        checkpointWriter->wait();
+        vector<CheckpointBuffer> parts(detectors.size());
+        for(size_t i = 0; i < detectors.size(); i++)
+            detectors[i]->saveCheckpoint(parts[i]);
+        if(checkpointWriter->write(lastFlowTime, parts))
+            cout << "Checkpoint: Hosts saved to \"" << checkpointFilePath << "\".\n";
+        delete checkpointWriter;
     }
-    if(RDP)
+
+    if(detector != NULL)
     {
-        cout.imbue(std::locale(std::locale(), new thousandsSeparator));
-        cout << "RDP Counter: " << RDPTotalFlows << endl;
-	    cout << "RDP Incoming Counter: " << RDPTotalIncomingFlows; printFlowPercent(RDPTotalFlows, RDPTotalIncomingFlows); cout<<endl;
-	    cout << "RDP Outgoing Counter: " << RDPTotalOutgoingFlows; printFlowPercent(RDPTotalFlows, RDPTotalOutgoingFlows); cout<<endl;
-	    cout << "RDP Matched Counter: "  << RDPTotalMatchedFlows; printFlowPercent(RDPTotalFlows, RDPTotalMatchedFlows); cout<<endl;
-	    cout << "RDP Matched Incoming Counter: " << RDPTotalMatchedIncomingFlows; printFlowPercent(RDPTotalMatchedFlows, RDPTotalMatchedIncomingFlows); printFlowPercent(RDPTotalFlows, RDPTotalMatchedIncomingFlows); cout<<endl;
-	    cout << "RDP Matched Outgoing Counter: " << RDPTotalMatchedOutgoingFlows; printFlowPercent(RDPTotalMatchedFlows, RDPTotalMatchedOutgoingFlows); printFlowPercent(RDPTotalFlows, RDPTotalMatchedOutgoingFlows); cout<<endl;
-	    cout << "RDP host map size: " << rdpHostMap.size() << endl;
-	    rdpHostMap.clear();
+        detector->clear();
+        delete detector;
     }
-    if(TELNET)
+    for(size_t i = 0; i < workers.size(); i++)
     {
-        cout.imbue(std::locale(std::locale(), new thousandsSeparator));
-        cout << "TELNET Counter: " << TELNETTotalFlows << endl;
-	    cout << "TELNET Incoming Counter: " << TELNETTotalIncomingFlows; printFlowPercent(TELNETTotalFlows, TELNETTotalIncomingFlows); cout<<endl;
-	    cout << "TELNET Outgoing Counter: " << TELNETTotalOutgoingFlows; printFlowPercent(TELNETTotalFlows, TELNETTotalOutgoingFlows); cout<<endl;
-	    cout << "TELNET Matched Counter: " << TELNETTotalMatchedFlows; printFlowPercent(TELNETTotalFlows, TELNETTotalMatchedFlows); cout<<endl;
-	    cout << "TELNET Matched Incoming Counter: " << TELNETTotalMatchedIncomingFlows; printFlowPercent(TELNETTotalMatchedFlows, TELNETTotalMatchedIncomingFlows); printFlowPercent(TELNETTotalFlows, TELNETTotalMatchedIncomingFlows); cout<<endl;
-	    cout << "TELNET Matched Outgoing Counter: " << TELNETTotalMatchedOutgoingFlows; printFlowPercent(TELNETTotalMatchedFlows, TELNETTotalMatchedOutgoingFlows); printFlowPercent(TELNETTotalFlows, TELNETTotalMatchedOutgoingFlows); cout<<endl;
-	    cout << "TELNET host map size: " << telnetHostMap.size() << endl;
-	    telnetHostMap.clear();
+        workers[i]->getDetector().clear();
+        delete workers[i];
     }
 
+    if(whitelistReloadStarted)
+        pthread_join(whitelistReloadThreadId, NULL);
+    if(configReloadStarted)
+        pthread_join(configReloadThreadId, NULL);
+
+    metrics_server_stop();
     TRAP_DEFAULT_FINALIZATION();
     ur_free_template(tmplt);
     ur_finalize();
@@ -55,6 +55,26 @@ const static uint16_t TCP_RDP_PORT     = 3389;
 const static uint8_t FLOW_INCOMING_DIRECTION = 1;
 const static uint8_t FLOW_OUTGOING_DIRECTION = 2;
 
+/*
+ * Supported protocols. A new service is added by an entry here and in PROTOCOLS,
+ * a record class with its settings (record.h), its host type in ProtocolHosts (host.h)
+ * and the option enabling it.
+ */
+enum PROTOCOL_ID { PROTOCOL_SSH, PROTOCOL_RDP, PROTOCOL_TELNET, PROTOCOL_COUNT };
+
+const static uint8_t PROTOCOL_NONE = 0xFF;
+
+struct ProtocolDescriptor {
+    const char *name;
+    uint16_t    port;
+};
+
+const static ProtocolDescriptor PROTOCOLS[PROTOCOL_COUNT] = {
+    {"SSH",    TCP_SSH_PORT},
+    {"RDP",    TCP_RDP_PORT},
+    {"TELNET", TCP_TELNET_PORT},
+};
+
 
 //ip address comparison for std::map and std::set
 struct cmpByIpAddr {
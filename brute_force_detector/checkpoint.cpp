@@ -0,0 +1,177 @@
+/**
+ * \file checkpoint.cpp
+ * \brief Checkpoint of the host maps, hosts are saved periodically and on exit and loaded at startup
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cstdio>
+#include <iostream>
+#include <unistd.h>
+#include "checkpoint.h"
+#include "detector.h"
+#include "worker.h"
+
+using namespace std;
+
+//Buffer of the checkpoint file
+const static size_t CHECKPOINT_BUFFER_SIZE = 1 << 20;
+
+bool CheckpointWriter::write(ur_time_t savedTime, const vector<CheckpointBuffer> &parts)
+{
+    string tmpPath = path + ".tmp";
+    FILE *file = fopen(tmpPath.c_str(), "wb");
+    if(file == NULL)
+    {
+        cerr << "Error Checkpoint: Cannot create checkpoint file \"" << tmpPath << "\".\n";
+        return false;
+    }
+    setvbuf(file, NULL, _IOFBF, CHECKPOINT_BUFFER_SIZE);
+
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.entrySize = sizeof(CheckpointEntry);
+    header.savedTime = savedTime;
+    for(size_t i = 0; i < parts.size(); i++)
+        header.hosts += parts[i].hosts;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for(size_t i = 0; ok && i < parts.size(); i++)
+    {
+        if(!parts[i].buffer.empty())
+            ok = fwrite(parts[i].buffer.data(), parts[i].buffer.size(), 1, file) == 1;
+    }
+    if(fclose(file) != 0)
+        ok = false;
+
+    if(!ok || rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        cerr << "Error Checkpoint: Cannot save checkpoint to \"" << path << "\".\n";
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+void *CheckpointWriter::run(void *writer)
+{
+    CheckpointWriter *self = static_cast<CheckpointWriter *>(writer);
+
+    self->write(self->savedTime, self->parts);
+    //keep the buffers allocated for the next checkpoint
+    for(size_t i = 0; i < self->parts.size(); i++)
+        self->parts[i].clear();
+
+    self->running.store(false, std::memory_order_release);
+    return NULL;
+}
+
+bool CheckpointWriter::start(ur_time_t savedTime, vector<CheckpointBuffer> &parts)
+{
+    wait();
+
+    this->savedTime = savedTime;
+    this->parts.swap(parts);
+
+    running.store(true, std::memory_order_release);
+    started = pthread_create(&thread, NULL, run, this) == 0;
+    if(!started)
+    {
+        cerr << "Error Checkpoint: Cannot create checkpoint thread!\n";
+        running.store(false, std::memory_order_release);
+    }
+    return started;
+}
+
+void CheckpointWriter::wait()
+{
+    if(started)
+    {
+        pthread_join(thread, NULL);
+        started = false;
+    }
+}
+
+bool loadCheckpoint(const char *path, const vector<Detector *> &detectors)
+{
+    FILE *file = fopen(path, "rb");
+    if(file == NULL)
+        return false;
+
+    //the whole file is read at once and parsed in memory
+    vector<char> data;
+    char chunk[65536];
+    size_t len;
+    while((len = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        data.insert(data.end(), chunk, chunk + len);
+    fclose(file);
+
+    CheckpointReader reader(data.data(), data.size());
+    CheckpointHeader header;
+    if(!reader.get(header) || memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 ||
+       header.version != CHECKPOINT_VERSION || header.entrySize != sizeof(CheckpointEntry))
+    {
+        cerr << "Error Checkpoint: \"" << path << "\" is not a checkpoint of this version of the module.\n";
+        return false;
+    }
+
+    uint64_t loaded = 0;
+    uint64_t i;
+    for(i = 0; i < header.hosts; i++)
+    {
+        uint8_t protocol;
+        ip_addr_t hostIp;
+        if(!reader.get(protocol) || protocol >= PROTOCOL_COUNT || !reader.peek(hostIp))
+            break;
+
+        Detector *detector = detectors[getWorkerIndex(hostIp, detectors.size())];
+        bool inserted;
+        if(!detector->loadHost(protocol, reader, inserted))
+            break;
+        if(inserted)
+            loaded++;
+    }
+
+    if(i != header.hosts)
+        cerr << "Error Checkpoint: Checkpoint \"" << path << "\" is truncated.\n";
+    cout << "Checkpoint: Loaded " << loaded << " of " << header.hosts << " hosts from \"" << path << "\".\n";
+    return true;
+}
@@ -0,0 +1,187 @@
+/**
+ * \file checkpoint.h
+ * \brief Checkpoint of the host maps, hosts are saved periodically and on exit and loaded at startup
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <unirec/ipaddr.h> //ip_addr_t
+#include <unirec/unirec.h> //ur_time_t
+#include <pthread.h>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define CHECKPOINT_MAGIC   "BFCP"
+#define CHECKPOINT_VERSION 1
+
+/*
+ * The file begins with the header, then there are "hosts" hosts, each of them is
+ * uint8_t protocol | host (see Host::save) with two record lists (RecordList::save).
+ * All values are stored in the byte order of the machine, the file is refused when
+ * its version or the size of the stored flows differ from the running module.
+ */
+struct CheckpointHeader {
+    char magic[4];      //CHECKPOINT_MAGIC
+    uint32_t version;   //CHECKPOINT_VERSION
+    uint32_t entrySize; //sizeof(CheckpointEntry)
+    uint32_t reserved;
+    ur_time_t savedTime; //time of the last flow when the checkpoint was taken
+    uint64_t hosts;      //number of hosts
+};
+
+/**
+ * Flow of a record list in the checkpoint
+ */
+struct __attribute__ ((__packed__)) CheckpointEntry {
+    ip_addr_t dstIp;
+    ur_time_t flowLastSeen;
+    uint8_t matched;
+};
+
+/**
+ * Hosts serialized by the thread owning them
+ */
+class CheckpointBuffer {
+
+public:
+    CheckpointBuffer() : hosts(0) {}
+
+    template <class V>
+    inline void put(const V &value) { putBytes(&value, sizeof(V)); }
+
+    inline void putBytes(const void *data, size_t size)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        buffer.insert(buffer.end(), bytes, bytes + size);
+    }
+
+    void clear() { buffer.clear(); hosts = 0; }
+    void swap(CheckpointBuffer &other) { buffer.swap(other.buffer); std::swap(hosts, other.hosts); }
+
+    std::vector<char> buffer;
+    uint64_t hosts;
+};
+
+/**
+ * Reader of the loaded checkpoint, reads fail at the end of the data
+ */
+class CheckpointReader {
+
+public:
+    CheckpointReader(const char *data, size_t size) : pos(data), end(data + size) {}
+
+    template <class V>
+    inline bool get(V &value) { return getBytes(&value, sizeof(V)); }
+
+    //value at the actual position, the position is not moved
+    template <class V>
+    inline bool peek(V &value) const
+    {
+        if((size_t) (end - pos) < sizeof(V))
+            return false;
+        memcpy(&value, pos, sizeof(V));
+        return true;
+    }
+
+    inline bool getBytes(void *data, size_t size)
+    {
+        if((size_t) (end - pos) < size)
+            return false;
+        if(size > 0)
+            memcpy(data, pos, size);
+        pos += size;
+        return true;
+    }
+
+private:
+    const char *pos;
+    const char *end;
+};
+
+/**
+ * Writes checkpoints to the file in a background thread, so that the detection does not wait for the disk
+ *
+ * The file is written to a temporary file first and renamed, the previous checkpoint stays
+ * valid if the module is killed while writing.
+ */
+class CheckpointWriter {
+
+public:
+    CheckpointWriter(const char *path) : path(path), savedTime(0), started(false), running(false) {}
+    ~CheckpointWriter() { wait(); }
+
+    inline bool isRunning() const { return running.load(std::memory_order_acquire); }
+
+    //start writing of the parts (taken from the caller) in the background, returns false if it could not be started
+    bool start(ur_time_t savedTime, std::vector<CheckpointBuffer> &parts);
+
+    //write the parts in the calling thread
+    bool write(ur_time_t savedTime, const std::vector<CheckpointBuffer> &parts);
+
+    //wait for the background writing
+    void wait();
+
+private:
+    std::string path;
+    ur_time_t savedTime;
+    std::vector<CheckpointBuffer> parts;
+
+    pthread_t thread;
+    bool started;
+    std::atomic<bool> running;
+
+    static void *run(void *writer);
+};
+
+class Detector;
+
+/**
+ * Load hosts from the checkpoint file to the detectors, hosts are distributed
+ * among the detectors by the attacker IP as the flows are (getWorkerIndex)
+ * @return false if the file could not be loaded (e.g. there is no checkpoint yet)
+ */
+bool loadCheckpoint(const char *path, const std::vector<Detector *> &detectors);
+
+#endif
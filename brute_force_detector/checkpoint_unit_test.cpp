@@ -0,0 +1,303 @@
+/**
+ * \file checkpoint_unit_test.cpp
+ * \brief Unit test of checkpoint save and load round trip with a different number of detectors
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2014 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include "checkpoint.h"
+#include "config.h"
+#include "detector.h"
+#include "worker.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+//defined in the file of the module
+TelnetServerProfileMap TELNETRecord::TSPMap;
+
+int failCounter = 0;
+
+#define CHECK(cond) do { if (!(cond)) { \
+    cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << endl; \
+    failCounter++; } } while (0)
+
+//attackers stay below the list threshold (30), so no alert is sent and the sender is not needed
+const static int ATTACKERS = 400;
+const static int MAX_FLOWS_OF_ATTACKER = 24;
+
+typedef pair<uint8_t, string> HostKey;
+typedef map<HostKey, string> HostChunks;
+
+/**
+ * Split the serialized hosts to the bytes of every host (format of Host::save and RecordList::save)
+ */
+static bool splitHosts(const CheckpointBuffer &part, HostChunks &chunks)
+{
+    const vector<char> &data = part.buffer;
+    size_t pos = 0;
+
+    for(uint64_t i = 0; i < part.hosts; i++)
+    {
+        size_t start = pos;
+        uint8_t protocol = data[pos];
+        string ip(&data[pos + 1], sizeof(ip_addr_t));
+
+        pos += 1 + sizeof(ip_addr_t) + 3 * sizeof(ur_time_t) + 1;
+        for(int list = 0; list < 2; list++)
+        {
+            uint16_t size;
+            pos += 4 * sizeof(uint32_t);
+            memcpy(&size, &data[pos], sizeof(size));
+            pos += sizeof(size) + size * sizeof(CheckpointEntry);
+            for(int counter = 0; counter < 2; counter++)
+            {
+                uint32_t exact, registers;
+                memcpy(&exact, &data[pos], sizeof(exact));
+                pos += sizeof(exact) + exact * sizeof(uint64_t);
+                memcpy(&registers, &data[pos], sizeof(registers));
+                pos += sizeof(registers) + registers;
+            }
+        }
+        if(pos > data.size())
+            return false;
+        if(!chunks.insert(make_pair(HostKey(protocol, ip), string(&data[start], pos - start))).second)
+            return false; //host saved twice
+    }
+    return pos == data.size();
+}
+
+static void randomFlow(IRecord::MatchStructure &st, uint8_t &direction, const ip_addr_t &attacker, uint16_t port, ur_time_t time)
+{
+    ip_addr_t victim = ip_from_int(0xc0a80000 | (rand() % 64));
+
+    direction = rand() % 4 == 0 ? FLOW_OUTGOING_DIRECTION : FLOW_INCOMING_DIRECTION;
+    st.srcIp = direction == FLOW_INCOMING_DIRECTION ? attacker : victim;
+    st.dstIp = direction == FLOW_INCOMING_DIRECTION ? victim : attacker;
+    st.srcPort = direction == FLOW_INCOMING_DIRECTION ? 1024 + rand() % 60000 : port;
+    st.dstPort = direction == FLOW_INCOMING_DIRECTION ? port : 1024 + rand() % 60000;
+    st.flags = rand() % 3 == 0 ? 0b00000010 : 0b00011011; //SYN only or SYN + ACK + PSH + FIN
+    st.packets = 1 + rand() % 40;
+    st.bytes = 100 + rand() % 6000;
+    st.flowFirstSeen = time;
+    st.flowLastSeen = time;
+}
+
+static void saveAll(const vector<Detector *> &detectors, HostChunks &chunks, vector<CheckpointBuffer> &parts)
+{
+    parts.assign(detectors.size(), CheckpointBuffer());
+    for(size_t i = 0; i < detectors.size(); i++)
+    {
+        detectors[i]->saveCheckpoint(parts[i]);
+        CHECK(splitHosts(parts[i], chunks));
+    }
+}
+
+static void deleteAll(vector<Detector *> &detectors)
+{
+    for(size_t i = 0; i < detectors.size(); i++)
+    {
+        detectors[i]->clear(); //hosts are not freed by the destructor
+        delete detectors[i];
+    }
+    detectors.clear();
+}
+
+/**
+ * Hosts of two detectors are loaded to three, every host must be restored byte for byte
+ * in the detector its flows are dispatched to
+ */
+static void testRoundTrip(const char *path, const bool *enabled, Whitelist *whitelist)
+{
+    vector<Detector *> saved;
+    for(int i = 0; i < 2; i++)
+        saved.push_back(new Detector(enabled, NULL));
+
+    ur_time_t start = ur_time_from_sec_msec(1500000000, 0);
+    for(int a = 0; a < ATTACKERS; a++)
+    {
+        ip_addr_t attacker = ip_from_int(0x0a000000 | (a * 7919));
+        uint8_t protocol = rand() % PROTOCOL_COUNT;
+        int flows = 1 + rand() % MAX_FLOWS_OF_ATTACKER;
+        Detector *detector = saved[getWorkerIndex(attacker, saved.size())];
+
+        for(int f = 0; f < flows; f++)
+        {
+            IRecord::MatchStructure st;
+            uint8_t direction;
+            randomFlow(st, direction, attacker, PROTOCOLS[protocol].port, start + ur_time_from_sec_msec(rand() % 200, 0));
+            detector->processFlow(protocol, st, direction, whitelist);
+        }
+    }
+
+    HostChunks before;
+    vector<CheckpointBuffer> parts;
+    saveAll(saved, before, parts);
+    CHECK(before.size() == (size_t) ATTACKERS);
+
+    CheckpointWriter writer(path);
+    CHECK(writer.write(start, parts));
+
+    vector<Detector *> loaded;
+    for(int i = 0; i < 3; i++)
+        loaded.push_back(new Detector(enabled, NULL));
+    CHECK(loadCheckpoint(path, loaded));
+
+    HostChunks after;
+    for(size_t i = 0; i < loaded.size(); i++)
+    {
+        HostChunks own;
+        vector<CheckpointBuffer> part(1);
+        loaded[i]->saveCheckpoint(part[0]);
+        CHECK(splitHosts(part[0], own));
+
+        for(HostChunks::const_iterator it = own.begin(); it != own.end(); ++it)
+        {
+            ip_addr_t ip;
+            memcpy(&ip, it->first.second.data(), sizeof(ip));
+            CHECK(getWorkerIndex(ip, loaded.size()) == i);
+        }
+        after.insert(own.begin(), own.end());
+    }
+    CHECK(after == before);
+
+    //loading again does not duplicate the hosts
+    CHECK(loadCheckpoint(path, loaded));
+    uint32_t hosts = 0;
+    for(size_t i = 0; i < loaded.size(); i++)
+        for(int p = 0; p < PROTOCOL_COUNT; p++)
+            hosts += loaded[i]->getHostMapSize(p);
+    CHECK(hosts == before.size());
+
+    deleteAll(saved);
+    deleteAll(loaded);
+}
+
+/**
+ * Hosts of a disabled protocol are skipped, a truncated file loads the complete hosts only
+ * and a file of another version is refused
+ */
+static void testBrokenFiles(const char *path, const bool *enabled, Whitelist *whitelist)
+{
+    vector<Detector *> saved(1, new Detector(enabled, NULL));
+    ur_time_t start = ur_time_from_sec_msec(1500000000, 0);
+    for(int a = 0; a < 50; a++)
+    {
+        ip_addr_t attacker = ip_from_int(0x0b000000 | a);
+        IRecord::MatchStructure st;
+        uint8_t direction;
+        randomFlow(st, direction, attacker, PROTOCOLS[a % PROTOCOL_COUNT].port, start);
+        saved[0]->processFlow(a % PROTOCOL_COUNT, st, direction, whitelist);
+    }
+    HostChunks before;
+    vector<CheckpointBuffer> parts;
+    saveAll(saved, before, parts);
+    CheckpointWriter writer(path);
+    CHECK(writer.write(start, parts));
+
+    //without SSH
+    bool noSsh[PROTOCOL_COUNT];
+    for(int p = 0; p < PROTOCOL_COUNT; p++)
+        noSsh[p] = p != PROTOCOL_SSH;
+    vector<Detector *> loaded(1, new Detector(noSsh, NULL));
+    CHECK(loadCheckpoint(path, loaded));
+    CHECK(loaded[0]->getHostMapSize(PROTOCOL_SSH) == 0);
+    CHECK(loaded[0]->getHostMapSize(PROTOCOL_RDP) == saved[0]->getHostMapSize(PROTOCOL_RDP));
+    deleteAll(loaded);
+
+    //cut in the middle of the last host
+    CHECK(truncate(path, sizeof(CheckpointHeader) + parts[0].buffer.size() - 1) == 0);
+    loaded.push_back(new Detector(enabled, NULL));
+    CHECK(loadCheckpoint(path, loaded));
+    uint32_t hosts = 0;
+    for(int p = 0; p < PROTOCOL_COUNT; p++)
+        hosts += loaded[0]->getHostMapSize(p);
+    CHECK(hosts == before.size() - 1);
+    deleteAll(loaded);
+
+    //other version
+    CheckpointHeader header;
+    FILE *file = fopen(path, "r+b");
+    CHECK(file != NULL && fread(&header, sizeof(header), 1, file) == 1);
+    header.version = CHECKPOINT_VERSION + 1;
+    CHECK(fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1);
+    fclose(file);
+    loaded.push_back(new Detector(enabled, NULL));
+    CHECK(!loadCheckpoint(path, loaded));
+    CHECK(loaded[0]->getHostMapSize(PROTOCOL_RDP) == 0);
+
+    deleteAll(saved);
+    deleteAll(loaded);
+}
+
+int main()
+{
+    char path[] = "/tmp/brute_force_checkpoint_XXXXXX";
+    int fd = mkstemp(path);
+    if(fd < 0)
+    {
+        cerr << "Cannot create temporary file" << endl;
+        return 1;
+    }
+    close(fd);
+
+    srand(0);
+    loadProtocolSettings(*Config::getInstance().getSnapshot());
+    bool enabled[PROTOCOL_COUNT];
+    for(int p = 0; p < PROTOCOL_COUNT; p++)
+        enabled[p] = true;
+    Whitelist whitelist;
+
+    testRoundTrip(path, enabled, &whitelist);
+    testBrokenFiles(path, enabled, &whitelist);
+    unlink(path);
+
+    if(failCounter > 0)
+    {
+        cerr << failCounter << " checks failed" << endl;
+        return 1;
+    }
+    return 0;
+}
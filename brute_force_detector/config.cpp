@@ -46,7 +46,7 @@
 
 using namespace std;
 
-Config::Config()
+Config::Config() : generation(0)
 {
     //init default config variables
     GENERAL_CHECK_FOR_REPORT_TIMEOUT = ur_time_from_sec_msec(60, 0);
@@ -168,6 +168,88 @@ Config::Config()
     kw_TELNET_BRUTEFORCE_INC_MIN_BYTES   = "TELNET_BRUTEFORCE_INC_MIN_BYTES";
     kw_TELNET_BRUTEFORCE_INC_MAX_BYTES   = "TELNET_BRUTEFORCE_INC_MAX_BYTES";
 
+    publish();
+}
+
+void Config::publish()
+{
+    std::shared_ptr<ConfigSnapshot> newSnapshot = std::make_shared<ConfigSnapshot>();
+    ConfigSnapshot &s = *newSnapshot;
+
+    s.checkForReportTimeout = GENERAL_CHECK_FOR_REPORT_TIMEOUT;
+    s.checkForDeleteTimeout = GENERAL_CHECK_FOR_DELETE_TIMEOUT;
+
+    //SSH
+    s.ssh.maxListSize    = SSH_LIST_SIZE;
+    s.ssh.listBottomSize = SSH_LIST_SIZE_BOTTOM_TRESHOLD;
+    s.ssh.listThreshold  = SSH_LIST_THRESHOLD;
+    s.ssh.recordTimeout  = SSH_RECORD_TIMEOUT;
+    s.ssh.hostTimeout    = SSH_HOST_TIMEOUT;
+    s.ssh.reportTimeout  = SSH_REPORT_TIMEOUT;
+    s.ssh.attackTimeout  = SSH_ATTACK_TIMEOUT;
+
+    s.ssh.incMinPackets = SSH_BRUTEFORCE_INC_MIN_PACKETS;
+    s.ssh.incMaxPackets = SSH_BRUTEFORCE_INC_MAX_PACKETS;
+    s.ssh.incMinBytes   = SSH_BRUTEFORCE_INC_MIN_BYTES;
+    s.ssh.incMaxBytes   = SSH_BRUTEFORCE_INC_MAX_BYTES;
+
+    s.ssh.outMinPackets = SSH_BRUTEFORCE_OUT_MIN_PACKETS;
+    s.ssh.outMaxPackets = SSH_BRUTEFORCE_OUT_MAX_PACKETS;
+    s.ssh.outMinBytes   = SSH_BRUTEFORCE_OUT_MIN_BYTES;
+    s.ssh.outMaxBytes   = SSH_BRUTEFORCE_OUT_MAX_BYTES;
+
+    //RDP
+    s.rdp.maxListSize    = RDP_LIST_SIZE;
+    s.rdp.listBottomSize = RDP_LIST_SIZE_BOTTOM_TRESHOLD;
+    s.rdp.listThreshold  = RDP_LIST_THRESHOLD;
+    s.rdp.recordTimeout  = RDP_RECORD_TIMEOUT;
+    s.rdp.hostTimeout    = RDP_HOST_TIMEOUT;
+    s.rdp.reportTimeout  = RDP_REPORT_TIMEOUT;
+    s.rdp.attackTimeout  = RDP_ATTACK_TIMEOUT;
+
+    s.rdp.incMinPackets = RDP_BRUTEFORCE_INC_MIN_PACKETS;
+    s.rdp.incMaxPackets = RDP_BRUTEFORCE_INC_MAX_PACKETS;
+    s.rdp.incMinBytes   = RDP_BRUTEFORCE_INC_MIN_BYTES;
+    s.rdp.incMaxBytes   = RDP_BRUTEFORCE_INC_MAX_BYTES;
+
+    s.rdp.outMinPackets = RDP_BRUTEFORCE_OUT_MIN_PACKETS;
+    s.rdp.outMaxPackets = RDP_BRUTEFORCE_OUT_MAX_PACKETS;
+    s.rdp.outMinBytes   = RDP_BRUTEFORCE_OUT_MIN_BYTES;
+    s.rdp.outMaxBytes   = RDP_BRUTEFORCE_OUT_MAX_BYTES;
+
+    //TELNET
+    s.telnet.maxListSize    = TELNET_LIST_SIZE;
+    s.telnet.listBottomSize = TELNET_LIST_SIZE_BOTTOM_TRESHOLD;
+    s.telnet.listThreshold  = TELNET_LIST_THRESHOLD;
+    s.telnet.recordTimeout  = TELNET_RECORD_TIMEOUT;
+    s.telnet.hostTimeout    = TELNET_HOST_TIMEOUT;
+    s.telnet.reportTimeout  = TELNET_REPORT_TIMEOUT;
+    s.telnet.attackTimeout  = TELNET_ATTACK_TIMEOUT;
+
+    s.telnet.incMinPackets = TELNET_BRUTEFORCE_INC_MIN_PACKETS;
+    s.telnet.incMaxPackets = TELNET_BRUTEFORCE_INC_MAX_PACKETS;
+    s.telnet.incMinBytes   = TELNET_BRUTEFORCE_INC_MIN_BYTES;
+    s.telnet.incMaxBytes   = TELNET_BRUTEFORCE_INC_MAX_BYTES;
+
+    //outgoing direction is profiled by TelnetServerProfile
+    s.telnet.outMinPackets = 0;
+    s.telnet.outMaxPackets = 0;
+    s.telnet.outMinBytes   = 0;
+    s.telnet.outMaxBytes   = 0;
+
+    //general settings used by the hosts
+    ProtocolSettings *protocols[] = {&s.ssh, &s.rdp, &s.telnet};
+    for(size_t i = 0; i < sizeof(protocols) / sizeof(protocols[0]); i++)
+    {
+        protocols[i]->attackMinEvToReport = GENERAL_ATTACK_MIN_EVENTS_TO_REPORT;
+        protocols[i]->attackMinRatioToKeepTrackingHost = GENERAL_ATTACK_MIN_RATIO_TO_KEEP_TRACKING_HOST;
+        protocols[i]->checkForDeleteTimeout = GENERAL_CHECK_FOR_DELETE_TIMEOUT;
+        protocols[i]->ignoreFirstSend = GENERAL_IGNORE_FIRST_SEND != 0;
+    }
+
+    std::shared_ptr<const ConfigSnapshot> published(newSnapshot);
+    std::atomic_store(&snapshot, published);
+    generation.fetch_add(1, std::memory_order_release);
 }
 
 void Config::reloadConfig()
@@ -438,5 +520,6 @@ bool Config::initFromFile(string path)
 
     configFile.close();
 
+    publish();
     return true;
 }
@@ -52,75 +52,62 @@
 #include <algorithm>
 #include <cctype>
 #include <cstdlib>
+#include <memory>
+#include <atomic>
+
+/**
+ * Settings of a protocol, general settings used by the hosts are copied here too
+ */
+struct ProtocolSettings {
+    uint16_t  maxListSize;
+    uint16_t  listBottomSize;
+    uint16_t  listThreshold;
+    ur_time_t recordTimeout;
+    ur_time_t hostTimeout;
+    ur_time_t reportTimeout;
+    ur_time_t attackTimeout;
+
+    // INCOMING DIRECTION (ATTACKER -> VICTIM)
+    uint32_t incMinPackets;
+    uint32_t incMaxPackets;
+    uint64_t incMinBytes;
+    uint64_t incMaxBytes;
+
+    // OUTGOING DIRECTION (VICTIM -> ATTACKER)
+    uint32_t outMinPackets;
+    uint32_t outMaxPackets;
+    uint64_t outMinBytes;
+    uint64_t outMaxBytes;
+
+    ur_time_t attackMinEvToReport;
+    double    attackMinRatioToKeepTrackingHost;
+    ur_time_t checkForDeleteTimeout;
+    bool      ignoreFirstSend;
+};
+
+/**
+ * Settings published by Config, never changed after they are published
+ *
+ * Every thread keeps a reference to the last snapshot it took (SettingsHandle),
+ * a reload publishes a new snapshot while the threads keep running.
+ */
+struct ConfigSnapshot {
+    ur_time_t checkForReportTimeout;
+    ur_time_t checkForDeleteTimeout;
+
+    ProtocolSettings ssh;
+    ProtocolSettings rdp;
+    ProtocolSettings telnet;
+};
 
 class Config {
 
 public:
+    //parse the file and publish its settings, must not be called by more threads at once
     bool initFromFile(std::string path);
 
-	inline ur_time_t getGlobalTimerForReportCheck() const {return GENERAL_CHECK_FOR_REPORT_TIMEOUT;}
-	inline ur_time_t getGlobalTimerForDeleteCheck() const {return GENERAL_CHECK_FOR_DELETE_TIMEOUT;}
-	inline ur_time_t getGlobalAttackMinEvToReport() const {return GENERAL_ATTACK_MIN_EVENTS_TO_REPORT;}
-    inline double    getGlobalAttackMinRatioToKeepTrackingHost() const {return GENERAL_ATTACK_MIN_RATIO_TO_KEEP_TRACKING_HOST;}
-
-    inline int       getGlobalIgnoreFirstSend() const {return GENERAL_IGNORE_FIRST_SEND;}
-    
-	//SSH  
-	inline uint16_t  getSSHMaxListSize()       const {return SSH_LIST_SIZE;}  
-    inline uint16_t  getSSHListBottomSize()    const {return SSH_LIST_SIZE_BOTTOM_TRESHOLD;}
-
-	inline uint16_t  getSSHListThreshold()     const {return SSH_LIST_THRESHOLD;}
-	inline ur_time_t getSSHRecordTimeout()     const {return SSH_RECORD_TIMEOUT;}
-	inline ur_time_t getSSHHostTimeout()       const {return SSH_HOST_TIMEOUT;}
-	inline ur_time_t getSSHReportTimeout()     const {return SSH_REPORT_TIMEOUT;}
-	inline ur_time_t getSSHAttackTimeout()     const {return SSH_ATTACK_TIMEOUT;}
-
-    // SSH INCOMING DIRECTION (ATTACKER -> VICTIM)
-    inline uint16_t getSSHBFIncMinPackets()    const  {return SSH_BRUTEFORCE_INC_MIN_PACKETS;}
-    inline uint16_t getSSHBFIncMaxPackets()    const  {return SSH_BRUTEFORCE_INC_MAX_PACKETS;}
-    inline uint16_t getSSHBFIncMinBytes()      const  {return SSH_BRUTEFORCE_INC_MIN_BYTES;}
-    inline uint16_t getSSHBFIncMaxBytes()      const  {return SSH_BRUTEFORCE_INC_MAX_BYTES;}
-	
-    // SSH OUTGOING DIRECTION (VICTIM -> ATTACKER)
-    inline uint16_t getSSHBFOutMinPackets()    const  {return SSH_BRUTEFORCE_OUT_MIN_PACKETS;}
-    inline uint16_t getSSHBFOutMaxPackets()    const  {return SSH_BRUTEFORCE_OUT_MAX_PACKETS;}
-    inline uint16_t getSSHBFOutMinBytes()      const  {return SSH_BRUTEFORCE_OUT_MIN_BYTES;}
-    inline uint16_t getSSHBFOutMaxBytes()      const  {return SSH_BRUTEFORCE_OUT_MAX_BYTES;}	
-	
-	//RDP
-    inline uint16_t  getRDPListBottomSize()    const {return RDP_LIST_SIZE_BOTTOM_TRESHOLD;}
-	inline uint16_t  getRDPMaxListSize()       const {return RDP_LIST_SIZE;}
-	inline uint16_t  getRDPListThreshold()     const {return RDP_LIST_THRESHOLD;}
-	inline ur_time_t getRDPRecordTimeout()     const {return RDP_RECORD_TIMEOUT;}
-	inline ur_time_t getRDPHostTimeout()       const {return RDP_HOST_TIMEOUT;}
-	inline ur_time_t getRDPReportTimeout()     const {return RDP_REPORT_TIMEOUT;}
-	inline ur_time_t getRDPAttackTimeout()     const {return RDP_ATTACK_TIMEOUT;}
-
-    // RDP INCOMING DIRECTION (ATTACKER -> VICTIM)
-    inline uint16_t getRDPBFIncMinPackets()    const  {return RDP_BRUTEFORCE_INC_MIN_PACKETS;}
-    inline uint16_t getRDPBFIncMaxPackets()    const  {return RDP_BRUTEFORCE_INC_MAX_PACKETS;}
-    inline uint16_t getRDPBFIncMinBytes()      const  {return RDP_BRUTEFORCE_INC_MIN_BYTES;}
-    inline uint16_t getRDPBFIncMaxBytes()      const  {return RDP_BRUTEFORCE_INC_MAX_BYTES;}
-	
-	// RDP OUTGOING DIRECTION (VICTIM -> ATTACKER)
-    inline uint16_t getRDPBFOutMinPackets()    const  {return RDP_BRUTEFORCE_OUT_MIN_PACKETS;}
-    inline uint16_t getRDPBFOutMaxPackets()    const  {return RDP_BRUTEFORCE_OUT_MAX_PACKETS;}
-    inline uint16_t getRDPBFOutMinBytes()      const  {return RDP_BRUTEFORCE_OUT_MIN_BYTES;}
-    inline uint32_t getRDPBFOutMaxBytes()      const  {return RDP_BRUTEFORCE_OUT_MAX_BYTES;}
-
-	//TELNET
-    inline uint16_t  getTELNETListBottomSize() const {return TELNET_LIST_SIZE_BOTTOM_TRESHOLD;}
-	inline uint16_t  getTELNETMaxListSize()    const {return TELNET_LIST_SIZE;}
-	inline uint16_t  getTELNETListThreshold()  const {return TELNET_LIST_THRESHOLD;}
-	inline ur_time_t getTELNETRecordTimeout()  const {return TELNET_RECORD_TIMEOUT;}
-	inline ur_time_t getTELNETHostTimeout()    const {return TELNET_HOST_TIMEOUT;}
-	inline ur_time_t getTELNETReportTimeout()  const {return TELNET_REPORT_TIMEOUT;}
-    inline ur_time_t getTELNETAttackTimeout()  const {return TELNET_ATTACK_TIMEOUT;}
-
-    inline uint16_t getTELNETBFIncMinPackets() const  {return TELNET_BRUTEFORCE_INC_MIN_PACKETS;}
-    inline uint16_t getTELNETBFIncMaxPackets() const  {return TELNET_BRUTEFORCE_INC_MAX_PACKETS;}
-    inline uint16_t getTELNETBFIncMinBytes()   const  {return TELNET_BRUTEFORCE_INC_MIN_BYTES;}
-    inline uint16_t getTELNETBFIncMaxBytes()   const  {return TELNET_BRUTEFORCE_INC_MAX_BYTES;}
+    inline uint64_t getGeneration() const { return generation.load(std::memory_order_acquire); }
+    std::shared_ptr<const ConfigSnapshot> getSnapshot() const { return std::atomic_load(&snapshot); }
 
     static Config& getInstance()
     {
@@ -132,6 +119,11 @@ public:
 
 private:
     Config();
+    void publish();
+
+    std::shared_ptr<const ConfigSnapshot> snapshot;
+    std::atomic<uint64_t> generation;
+
     std::string configPath;
 
     //general
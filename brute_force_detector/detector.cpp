@@ -0,0 +1,153 @@
+/**
+ * \file detector.cpp
+ * \brief Detection state of the protocols, owned by one thread
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <string>
+#include "detector.h"
+
+static metrics_counter_t *flowCounter(const char *name, const char *protocol, const char *direction, const char *help)
+{
+    std::string labels = std::string("{protocol=\"") + protocol + "\",direction=\"" + direction + "\"}";
+    return metrics_counter((name + labels).c_str(), help);
+}
+
+static bool checkForTimeout(ur_time_t oldTime, ur_time_t timer, ur_time_t actualTime)
+{
+    if(oldTime + timer <= actualTime)
+        return true;
+    else
+        return false;
+}
+
+Detector::Detector(const bool *enabled, Sender *sender) : sender(sender)
+{
+    for(int i = 0; i < PROTOCOL_COUNT; i++)
+        this->enabled[i] = enabled[i];
+
+    timeOfLastReportCheck = 0;
+    timeOfLastDeleteCheck = 0;
+    //set by loadConfig before the first flow
+    timerForReportCheck = 0;
+    timerForDeleteCheck = 0;
+
+    //metrics of the same name are shared by the detectors of all workers
+    for(int i = 0; i < PROTOCOL_COUNT; i++)
+    {
+        const char *name = PROTOCOLS[i].name;
+        metrics[i].incomingFlows = flowCounter("brute_force_flows_total", name, "incoming", "Flows processed by the detection.");
+        metrics[i].outgoingFlows = flowCounter("brute_force_flows_total", name, "outgoing", "Flows processed by the detection.");
+        metrics[i].matchedIncomingFlows = flowCounter("brute_force_matched_flows_total", name, "incoming", "Flows matching the signature of the protocol.");
+        metrics[i].matchedOutgoingFlows = flowCounter("brute_force_matched_flows_total", name, "outgoing", "Flows matching the signature of the protocol.");
+        metrics[i].hosts = metrics_gauge((std::string("brute_force_hosts{protocol=\"") + name + "\"}").c_str(), "Hosts in the host maps.");
+    }
+    flowTime = metrics_histogram("brute_force_flow_seconds", "Time of the detection of one flow.");
+    reportCheckTime = metrics_histogram("brute_force_check_seconds{check=\"report\"}", "Duration of the checks of the host maps.");
+    deleteCheckTime = metrics_histogram("brute_force_check_seconds{check=\"delete\"}", "Duration of the checks of the host maps.");
+
+    createProtocols<0>();
+}
+
+Detector::~Detector()
+{
+    for(int i = 0; i < PROTOCOL_COUNT; i++)
+        delete protocols[i];
+}
+
+void Detector::loadConfig(const ConfigSnapshot &config)
+{
+    timerForReportCheck = config.checkForReportTimeout;
+    timerForDeleteCheck = config.checkForDeleteTimeout;
+}
+
+void Detector::checkTimeouts(ur_time_t actualTime)
+{
+    if(checkForTimeout(timeOfLastReportCheck, timerForReportCheck, actualTime))
+    {
+        timeOfLastReportCheck = actualTime;
+        uint64_t start = metrics_start();
+
+        for(int i = 0; i < PROTOCOL_COUNT; i++)
+        {
+            if(enabled[i])
+                protocols[i]->checkForAttackTimeout(actualTime);
+        }
+        metrics_stop(reportCheckTime, start);
+    }
+    if(checkForTimeout(timeOfLastDeleteCheck, timerForDeleteCheck, actualTime))
+    {
+        timeOfLastDeleteCheck = actualTime;
+        uint64_t start = metrics_start();
+
+        for(int i = 0; i < PROTOCOL_COUNT; i++)
+        {
+            if(enabled[i])
+                protocols[i]->deleteOldRecordAndHosts(actualTime);
+        }
+        metrics_stop(deleteCheckTime, start);
+
+        //sizes of the host maps of this detector, summed over the workers
+        for(int i = 0; i < PROTOCOL_COUNT; i++)
+            metrics_gauge_set(metrics[i].hosts, protocols[i]->size());
+    }
+}
+
+void Detector::saveCheckpoint(CheckpointBuffer &out)
+{
+    for(int i = 0; i < PROTOCOL_COUNT; i++)
+    {
+        if(enabled[i])
+            protocols[i]->save(out);
+    }
+}
+
+bool Detector::loadHost(uint8_t protocol, CheckpointReader &in, bool &inserted)
+{
+    if(protocol >= PROTOCOL_COUNT)
+        return false;
+    return protocols[protocol]->loadHost(in, enabled[protocol], inserted);
+}
+
+void Detector::clear()
+{
+    for(int i = 0; i < PROTOCOL_COUNT; i++)
+        protocols[i]->clear();
+}
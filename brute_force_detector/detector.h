@@ -0,0 +1,300 @@
+/**
+ * \file detector.h
+ * \brief Detection state of the protocols, owned by one thread
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef DETECTOR_H
+#define DETECTOR_H
+
+#include "brute_force_detector.h"
+#include "record.h"
+#include "host.h"
+#include "sender.h"
+#include "whitelist.h"
+#include "metrics.h"
+#include <tuple>
+#include <type_traits>
+
+/**
+ * Flow counters of a protocol
+ */
+struct ProtocolStats {
+    uint64_t totalFlows;
+    uint64_t totalIncomingFlows;
+    uint64_t totalOutgoingFlows;
+    uint64_t totalMatchedFlows;
+    uint64_t totalMatchedIncomingFlows;
+    uint64_t totalMatchedOutgoingFlows;
+
+    ProtocolStats() : totalFlows(0), totalIncomingFlows(0), totalOutgoingFlows(0), totalMatchedFlows(0),
+                      totalMatchedIncomingFlows(0), totalMatchedOutgoingFlows(0) {}
+
+    void add(const ProtocolStats &other)
+    {
+        totalFlows += other.totalFlows;
+        totalIncomingFlows += other.totalIncomingFlows;
+        totalOutgoingFlows += other.totalOutgoingFlows;
+        totalMatchedFlows += other.totalMatchedFlows;
+        totalMatchedIncomingFlows += other.totalMatchedIncomingFlows;
+        totalMatchedOutgoingFlows += other.totalMatchedOutgoingFlows;
+    }
+};
+
+/**
+ * Runtime metrics of a protocol, shared by the detectors of all workers
+ */
+struct ProtocolMetrics {
+    metrics_counter_t *incomingFlows;
+    metrics_counter_t *outgoingFlows;
+    metrics_counter_t *matchedIncomingFlows;
+    metrics_counter_t *matchedOutgoingFlows;
+    metrics_gauge_t   *hosts;
+};
+
+/**
+ * Host map of one protocol with the detection of its flows, the detector uses the protocols
+ * through this interface only
+ */
+class ProtocolDetector {
+
+public:
+    virtual ~ProtocolDetector() {}
+
+    /**
+     * Match the flow with the signature of the protocol, add it to the host and report the host if it is attacking.
+     * @return value of the last send to the output interface (0 if nothing was sent)
+     */
+    virtual int update(IRecord::MatchStructure &structure, uint8_t direction, Whitelist *whitelist) = 0;
+    virtual void checkForAttackTimeout(ur_time_t actualTime) = 0;
+    virtual void deleteOldRecordAndHosts(ur_time_t actualTime) = 0;
+    virtual void save(CheckpointBuffer &out) = 0;
+    virtual bool loadHost(CheckpointReader &in, bool insert, bool &inserted) = 0;
+    virtual uint32_t size() = 0;
+    virtual void clear() = 0;
+};
+
+/**
+ * Detection of the protocol whose hosts are of type H, the port of the protocol is taken from PROTOCOLS
+ */
+template <class H>
+class HostMapDetector : public ProtocolDetector {
+
+public:
+    HostMapDetector(uint8_t protocol, Sender *sender, ProtocolStats *stats, ProtocolMetrics *metrics)
+        : protocol(protocol), port(PROTOCOLS[protocol].port), sender(sender), stats(stats), metrics(metrics) {}
+
+    int update(IRecord::MatchStructure &structure, uint8_t direction, Whitelist *whitelist)
+    {
+        typedef typename H::RecordType Record;
+
+        int ret = 0;
+        bool state;
+        Record record(direction == FLOW_INCOMING_DIRECTION ? structure.dstIp : structure.srcIp, structure.flowLastSeen);
+
+        if(direction == FLOW_INCOMING_DIRECTION)
+        {
+            state = record.matchWithIncomingSignature(&structure, whitelist);
+            if(state)
+            {
+                stats->totalMatchedIncomingFlows++;
+                metrics_counter_inc(metrics->matchedIncomingFlows);
+            }
+            stats->totalIncomingFlows++;
+            metrics_counter_inc(metrics->incomingFlows);
+        }
+        else
+        { // FLOW_OUTGOING_DIRECTION
+            state = record.matchWithOutgoingSignature(&structure, whitelist);
+            if(state)
+            {
+                stats->totalMatchedOutgoingFlows++;
+                metrics_counter_inc(metrics->matchedOutgoingFlows);
+            }
+            stats->totalOutgoingFlows++;
+            metrics_counter_inc(metrics->outgoingFlows);
+        }
+
+        if(state)
+            stats->totalMatchedFlows++;
+        stats->totalFlows++;
+
+        H *host = hostMap.findHost(&structure, direction);
+
+        if(!host->addRecord(record, structure, direction))
+            return ret;
+
+        //check for attack
+        ur_time_t flowLastSeen = structure.flowLastSeen;
+        typename H::ATTACK_STATE attackState = host->checkForAttack(flowLastSeen);
+        if(attackState == H::NEW_ATTACK)
+            ret = sender->firstReport(host, port, flowLastSeen, Record::settings->listThreshold);
+        else if(attackState == H::ATTACK_REPORT_WAIT || attackState == H::ATTACK_MIN_EVENTS_WAIT)
+        {
+            //waiting for report timeout or min events to report
+            //no action
+        }
+        else if(attackState == H::END_OF_ATTACK)
+        {
+            //clear list
+            host->clearAllRecords();
+            host->setNotReported();
+        }
+        else if(attackState == H::REPORT_END_OF_ATTACK)
+        {
+            //report and clear list
+            ret = sender->continuingReport(host, port, flowLastSeen, true);
+
+            host->clearAllRecords();
+            host->setNotReported();
+        }
+        else if(attackState == H::ATTACK)
+        {
+            ret = sender->continuingReport(host, port, flowLastSeen);
+        }
+        hostMap.watchReportedHost(host);
+
+        return ret;
+    }
+
+    void checkForAttackTimeout(ur_time_t actualTime) { hostMap.checkForAttackTimeout(actualTime, sender, port); }
+    void deleteOldRecordAndHosts(ur_time_t actualTime) { hostMap.deleteOldRecordAndHosts(actualTime); }
+    void save(CheckpointBuffer &out) { hostMap.save(out, protocol); }
+    bool loadHost(CheckpointReader &in, bool insert, bool &inserted) { return hostMap.loadHost(in, insert, inserted); }
+    uint32_t size() { return hostMap.size(); }
+    void clear() { hostMap.clear(); }
+
+private:
+    uint8_t protocol;
+    uint16_t port;
+    Sender *sender;
+    ProtocolStats *stats;
+    ProtocolMetrics *metrics;
+    HostMap<H> hostMap;
+};
+
+/**
+ * Host maps, counters and timeout checks of all enabled protocols
+ *
+ * The detector is used by one thread only. Every attacker is tracked by exactly one
+ * detector, so flows may be split among several detectors by the attacker IP.
+ * Host maps are created from ProtocolHosts, one for every PROTOCOL_ID.
+ */
+class Detector {
+
+public:
+    Detector(const bool *enabled, Sender *sender);
+    ~Detector();
+
+    /**
+     * Process the flow of the protocol, whitelist is used for signature matching
+     * @return value of the last send to the output interface (0 if nothing was sent)
+     */
+    int processFlow(uint8_t protocol, IRecord::MatchStructure &structure, uint8_t direction, Whitelist *whitelist)
+    {
+        uint64_t start = metrics_start();
+        int ret = protocols[protocol]->update(structure, direction, whitelist);
+        metrics_stop(flowTime, start);
+        return ret;
+    }
+
+    /**
+     * Check attack timeouts and delete old hosts, called with the time of every flow
+     */
+    void checkTimeouts(ur_time_t actualTime);
+
+    /**
+     * Use the snapshot taken by the thread of the detector (SettingsHandle)
+     */
+    void loadConfig(const ConfigSnapshot &config);
+
+    /**
+     * Serialize hosts of the enabled protocols, called by the thread of the detector
+     */
+    void saveCheckpoint(CheckpointBuffer &out);
+
+    /**
+     * Load one host of the protocol from the checkpoint, hosts of disabled protocols are skipped
+     * @return false if the checkpoint is corrupted
+     */
+    bool loadHost(uint8_t protocol, CheckpointReader &in, bool &inserted);
+
+    const ProtocolStats &getStats(uint8_t protocol) const { return stats[protocol]; }
+    uint32_t getHostMapSize(uint8_t protocol) { return protocols[protocol]->size(); }
+
+    void clear();
+
+private:
+    Detector(const Detector &);
+    Detector &operator=(const Detector &);
+
+    bool enabled[PROTOCOL_COUNT];
+    Sender *sender;
+
+    ProtocolDetector *protocols[PROTOCOL_COUNT];
+
+    ProtocolStats stats[PROTOCOL_COUNT];
+
+    ProtocolMetrics metrics[PROTOCOL_COUNT];
+    metrics_histogram_t *flowTime;
+    metrics_histogram_t *reportCheckTime;
+    metrics_histogram_t *deleteCheckTime;
+
+    ur_time_t timeOfLastReportCheck;
+    ur_time_t timeOfLastDeleteCheck;
+    ur_time_t timerForReportCheck;
+    ur_time_t timerForDeleteCheck;
+
+    /**
+     * Create the host maps of the protocols from index I on
+     */
+    template <size_t I>
+    typename std::enable_if<I == PROTOCOL_COUNT>::type createProtocols() {}
+
+    template <size_t I>
+    typename std::enable_if<I < PROTOCOL_COUNT>::type createProtocols()
+    {
+        typedef typename std::tuple_element<I, ProtocolHosts>::type Host;
+        protocols[I] = new HostMapDetector<Host>(I, sender, &stats[I], &metrics[I]);
+        createProtocols<I + 1>();
+    }
+};
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * \file distinct_counter.cpp
+ * \brief Counter of distinct IP addresses with bounded memory
+ * \date 2026
+ */
+
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include "distinct_counter.h"
+#include <algorithm>
+
+void DistinctCounter::insert(const ip_addr_t &ip)
+{
+    uint64_t h = hll_hash(&ip, sizeof(ip));
+
+    if(sketch)
+    {
+        hll_t registersView = hll();
+        hll_add(&registersView, h, NULL);
+        return;
+    }
+
+    std::vector<uint64_t>::iterator it = std::lower_bound(exact.begin(), exact.end(), h);
+    if(it != exact.end() && *it == h)
+        return;
+
+    if(exact.size() < DC_EXACT_LIMIT)
+    {
+        exact.insert(it, h);
+        return;
+    }
+
+    //too many addresses, switch to the sketch (registers of a cleared counter are already zeroed)
+    if(registers.empty())
+        registers.assign(1 << DC_HLL_BITS, 0);
+    sketch = true;
+    hll_t registersView = hll();
+    for(size_t i = 0; i < exact.size(); i++)
+        hll_add(&registersView, exact[i], NULL);
+    hll_add(&registersView, h, NULL);
+    exact.clear();
+}
+
+uint32_t DistinctCounter::size() const
+{
+    if(!sketch)
+        return exact.size();
+
+    hll_t registersView = hll_view(const_cast<uint8_t *>(registers.data()), DC_HLL_BITS, 8);
+    return hll_estimate(&registersView);
+}
+
+void DistinctCounter::clear()
+{
+    exact.clear();
+    if(sketch)
+    {
+        hll_t registersView = hll();
+        hll_clear(&registersView);
+        sketch = false;
+    }
+}
+
+void DistinctCounter::save(CheckpointBuffer &out) const
+{
+    out.put<uint32_t>(exact.size());
+    out.putBytes(exact.data(), exact.size() * sizeof(uint64_t));
+    out.put<uint32_t>(sketch ? registers.size() : 0);
+    if(sketch)
+        out.putBytes(registers.data(), registers.size());
+}
+
+bool DistinctCounter::load(CheckpointReader &in)
+{
+    uint32_t exactSize, registersSize;
+
+    if(!in.get(exactSize) || exactSize > DC_EXACT_LIMIT)
+        return false;
+    exact.resize(exactSize);
+    if(!in.getBytes(exact.data(), exactSize * sizeof(uint64_t)))
+        return false;
+
+    if(!in.get(registersSize) || (registersSize != 0 && registersSize != (1 << DC_HLL_BITS)))
+        return false;
+    sketch = registersSize != 0;
+    if(!sketch)
+    {
+        if(!registers.empty())
+        {
+            hll_t registersView = hll();
+            hll_clear(&registersView);
+        }
+        return true;
+    }
+    registers.resize(registersSize);
+    return in.getBytes(registers.data(), registersSize);
+}
@@ -0,0 +1,86 @@
+/**
+ * \file distinct_counter.h
+ * \brief Counter of distinct IP addresses with bounded memory
+ * \date 2026
+ */
+
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef DISTINCT_COUNTER_H
+#define DISTINCT_COUNTER_H
+
+#include <unirec/ipaddr.h> //ip_addr_t
+#include <vector>
+#include "checkpoint.h"
+#include "hll.h"
+
+/**
+ * Counter of distinct IP addresses
+ *
+ * Addresses are counted exactly until DC_EXACT_LIMIT distinct addresses are seen,
+ * then the counter switches to HyperLogLog (common hll) with 2^DC_HLL_BITS registers
+ * (1 KiB, standard error about 3%), so the memory of one counter is bounded.
+ * Cleared counter counts exactly again, its registers are zeroed and kept.
+ */
+class DistinctCounter {
+
+public:
+    DistinctCounter() : sketch(false) {}
+
+    void insert(const ip_addr_t &ip);
+    uint32_t size() const;
+    void clear();
+
+    inline bool isExact() const { return !sketch; }
+
+    void save(CheckpointBuffer &out) const;
+    bool load(CheckpointReader &in);
+
+private:
+    const static size_t DC_EXACT_LIMIT = 64;
+    const static int DC_HLL_BITS = 10;
+
+    std::vector<uint64_t> exact;     //hashes of addresses, sorted, used until the limit is reached
+    std::vector<uint8_t> registers;  //HyperLogLog registers, allocated with the first switch
+    bool sketch;                     //counting by the registers
+
+    inline hll_t hll() { return hll_view(registers.data(), DC_HLL_BITS, 8); }
+};
+
+#endif
@@ -1,6 +1,6 @@
 /**
  * \file host.h
- * \brief Class for every supported host and hostmap
+ * \brief Host and host map templates for every supported protocol
  * \author Vaclav Pacholik <xpacho03@stud.fit.vutbr.cz || vaclavpacholik@gmail.com>
  * \date 2014
  */
@@ -51,27 +51,33 @@
 #include "record.h"
 #include "config.h"
 #include "sender.h"
-#include <typeinfo>
-#include <map>
+#include <vector>
+#include <tuple>
 #include "brute_force_detector.h"
+#include "host_table.h"
+#include "timer_wheel.h"
+#include "checkpoint.h"
 
 /**
- * Base class for host
+ * Host of a protocol, T is the record type of the protocol.
+ * Thresholds and timeouts are taken from T::settings, there are no virtual calls.
  */
 template <class T>
-class IHost {
+class Host {
 
 public:
-    IHost(ip_addr_t _hostIp, ur_time_t _firstSeen)
+    Host(ip_addr_t _hostIp, ur_time_t _firstSeen)
     {
         hostIp = _hostIp;
         firstSeen = _firstSeen;
         timeOfLastReport = 0;
         timeOfLastReceivedRecord = 0;
         scanned = false;
+        hostId = 0;
+        attackTimerArmed = false;
     }
 
-    virtual ~IHost() {}
+    typedef T RecordType;
 
     enum ATTACK_STATE { NO_ATTACK, NEW_ATTACK, ATTACK_REPORT_WAIT, ATTACK,
 	                    ATTACK_MIN_EVENTS_WAIT, END_OF_ATTACK, REPORT_END_OF_ATTACK};
@@ -89,8 +95,22 @@ public:
 	
     inline bool getHostScannedNetwork() { return scanned; }
 
-    virtual bool addRecord(T record, void *structure, uint8_t direction = FLOW_INCOMING_DIRECTION)
+    inline uint64_t getHostId() { return hostId; }
+    inline void setHostId(uint64_t id) { hostId = id; }
+    inline ur_time_t getTimeOfLastReceivedRecord() { return timeOfLastReceivedRecord; }
+    inline bool isAttackTimerArmed() { return attackTimerArmed; }
+    inline void setAttackTimerArmed(bool armed) { attackTimerArmed = armed; }
+
+    bool addRecord(const T &record, const IRecord::MatchStructure &st, uint8_t direction = FLOW_INCOMING_DIRECTION)
     {
+        //scan => SKIP!!!
+        if(isFlowScan(st.packets, st.flags))
+            return false;
+        else if(T::isIgnoredFlow(st))
+            return false;
+
+        timeOfLastReceivedRecord = st.flowLastSeen;
+        clearOldRecords(st.flowLastSeen);
         if(direction == FLOW_INCOMING_DIRECTION)
             recordListIncoming.addRecord(record, isReported());
         else
@@ -99,60 +119,108 @@ public:
     }
 
     void clearOldRecords(ur_time_t actualTime) { recordListIncoming.clearOldRecords(actualTime); recordListOutgoing.clearOldRecords(actualTime);}
-	
-	
-    virtual ur_time_t getHostDeleteTimeout() = 0; 
-	
-    virtual bool canDeleteHost(ur_time_t actualTime)
-    {
-        /*
-         ur_time_t timeOfLastIncomingRecord = recordListIncoming.getTimeOfLastRecord();
-         ur_time_t timeOfLastOutgoingRecord = recordListOutgoing.getTimeOfLastRecord();
-         
-         if(timeOfLastIncomingRecord == 0 && timeOfLastOutgoingRecord == 0) //empty lists
-             return true;
-         
-         
-         ur_time_t timeOfLastRecord = timeOfLastIncomingRecord > timeOfLastOutgoingRecord ? timeOfLastIncomingRecord : timeOfLastOutgoingRecord;
-         */
-        ur_time_t timer = getHostDeleteTimeout();
-        //return checkForTimeout(timeOfLastRecord, timer, actualTime);
-
-        return checkForTimeout(timeOfLastReceivedRecord, timer, actualTime);
 
-    }
-
-    virtual ur_time_t getHostReportTimeout() = 0;
+    inline ur_time_t getHostDeleteTimeout() { return T::settings->hostTimeout; }
+    inline ur_time_t getHostReportTimeout() { return T::settings->reportTimeout; }
+    inline ur_time_t getHostAttackTimeout() { return T::settings->attackTimeout; }
 
-    virtual bool canReportAgain(ur_time_t actualTime)
+    bool canDeleteHost(ur_time_t actualTime)
     {
-        ur_time_t timer = getHostReportTimeout();
-        return checkForTimeout(timeOfLastReport, timer, actualTime);
+        return checkForTimeout(timeOfLastReceivedRecord, getHostDeleteTimeout(), actualTime);
     }
 
-    virtual ur_time_t getHostAttackTimeout() = 0;
+    bool canReportAgain(ur_time_t actualTime)
+    {
+        return checkForTimeout(timeOfLastReport, getHostReportTimeout(), actualTime);
+    }
 
-    virtual bool checkForAttackTimeout(ur_time_t actualTime)
+    bool checkForAttackTimeout(ur_time_t actualTime)
     {
-        ur_time_t timer = getHostAttackTimeout();
-        return checkForTimeout(timeOfLastReport, timer, actualTime);
+        return checkForTimeout(timeOfLastReport, getHostAttackTimeout(), actualTime);
     }
 
-    virtual ATTACK_STATE checkForAttack(ur_time_t actualTime) = 0;
+    ATTACK_STATE checkForAttack(ur_time_t actualTime)
+    {
+        const ProtocolSettings &settings = *T::settings;
+        uint16_t numOfCurrentIncomingMF = recordListIncoming.getActualNumOfMatchedFlows();
+        uint16_t numOfCurrentOutgoingMF = recordListOutgoing.getActualNumOfMatchedFlows();
+
+        if(!isReported())
+        { //no attack yet
+            uint16_t actualListSizeInc = recordListIncoming.getActualNumOfListSize();
+            uint16_t actualListSizeOut = recordListOutgoing.getActualNumOfListSize();
+            uint16_t threshold;
+
+            //Number of records in list is lower than BottomSize, 50 ussually
+            if(actualListSizeInc <= settings.listBottomSize || actualListSizeOut <= settings.listBottomSize)
+                threshold = settings.listThreshold;
+            else
+            { //Number of records is between bottom size and max size
+                uint16_t actualListSize = actualListSizeInc > actualListSizeOut ? actualListSizeInc : actualListSizeOut;
+                if(actualListSize < 100)
+                    threshold = (actualListSize % 100) * 0.9;
+                else
+                    threshold = (actualListSize / 100) * 90;
+            }
+
+            if(numOfCurrentIncomingMF >= threshold || numOfCurrentOutgoingMF >= threshold)
+            {
+                //crossed threshold, new attack detected
+                recordListIncoming.initTotalTargetsSet();
+                recordListOutgoing.initTotalTargetsSet();
+                return NEW_ATTACK;
+            }
+            else
+                return NO_ATTACK;
+        }
+        else
+        { //host is attacking, check for report timeout
+            if(!canReportAgain(actualTime))
+                //timeout nevyprsel, report pripadne pozdeji
+                return ATTACK_REPORT_WAIT;
+
+            uint32_t incomingAttackScale = recordListIncoming.getNumOfMatchedFlowsSinceLastReport();
+            uint32_t incomingTotalFlows  = recordListIncoming.getNumOfTotalFlowsSinceLastReport();
+
+            uint32_t outgoingAttackScale = recordListOutgoing.getNumOfMatchedFlowsSinceLastReport();
+            uint32_t outgoingTotalFlows  = recordListOutgoing.getNumOfTotalFlowsSinceLastReport();
+
+            if(numOfCurrentIncomingMF == 0 && incomingAttackScale == 0 &&
+               numOfCurrentOutgoingMF == 0 && outgoingAttackScale == 0)
+                return END_OF_ATTACK;
+
+            double incomingPer = 0.0;
+            if(incomingTotalFlows > 0.0)
+                incomingPer = (100.0 / incomingTotalFlows) * incomingAttackScale;
+
+            double outgoingPer = 0.0;
+            if(outgoingTotalFlows > 0.0)
+                outgoingPer = (100.0 / outgoingTotalFlows) * outgoingAttackScale;
+
+            bool enoughEvents = incomingAttackScale >= settings.attackMinEvToReport ||
+                                outgoingAttackScale >= settings.attackMinEvToReport;
+
+            if(incomingPer < settings.attackMinRatioToKeepTrackingHost &&
+               outgoingPer < settings.attackMinRatioToKeepTrackingHost)
+                return enoughEvents ? REPORT_END_OF_ATTACK : END_OF_ATTACK;
+
+            return enoughEvents ? ATTACK : ATTACK_MIN_EVENTS_WAIT;
+        }
+    }
 
     RecordList<T>* getPointerToIncomingRecordList() {return &recordListIncoming; }
     RecordList<T>* getPointerToOutgoingRecordList() {return &recordListOutgoing; }
 
-    virtual void clearAllRecords() { recordListIncoming.clearAllRecords(); recordListOutgoing.clearAllRecords();}
+    void clearAllRecords() { recordListIncoming.clearAllRecords(); recordListOutgoing.clearAllRecords();}
 
-    bool isFlowScan(uint32_t *packets, uint8_t *flags)
+    bool isFlowScan(uint32_t packets, uint8_t flags)
     {
-        if((*packets == 1 && *flags == 0b00000010) //SYN
-                || (*packets == 2 && *flags == 0b00000010) //SYN
-                || (*packets == 2 && *flags == 0b00000110) //SYN + RST
-                || (*packets == 1 && *flags == 0b00010010) //SYN + ACK
-                || (*packets == 1 && *flags == 0b00010100) //RST + ACK
-                || (*packets == 3 && *flags == 0b00000010))//3-syn packets
+        if((packets == 1 && flags == 0b00000010) //SYN
+                || (packets == 2 && flags == 0b00000010) //SYN
+                || (packets == 2 && flags == 0b00000110) //SYN + RST
+                || (packets == 1 && flags == 0b00010010) //SYN + ACK
+                || (packets == 1 && flags == 0b00010100) //RST + ACK
+                || (packets == 3 && flags == 0b00000010))//3-syn packets
         {
             scanned = true;
             return true;
@@ -161,6 +229,30 @@ public:
             return false;
     }
 
+    /**
+     * State of the host for the checkpoint, IP and first seen time are stored first,
+     * they are read by the host map to create the host and the rest by load()
+     */
+    void save(CheckpointBuffer &out)
+    {
+        out.put(hostIp);
+        out.put(firstSeen);
+        out.put(timeOfLastReport);
+        out.put(timeOfLastReceivedRecord);
+        out.put<uint8_t>(scanned);
+        recordListIncoming.save(out);
+        recordListOutgoing.save(out);
+    }
+
+    bool load(CheckpointReader &in)
+    {
+        uint8_t storedScanned;
+        if(!in.get(timeOfLastReport) || !in.get(timeOfLastReceivedRecord) || !in.get(storedScanned))
+            return false;
+        scanned = storedScanned != 0;
+        return recordListIncoming.load(in) && recordListOutgoing.load(in);
+    }
+
 protected:
     bool checkForTimeout(ur_time_t flowTime, ur_time_t timer, ur_time_t actualTime)
     {
@@ -171,7 +263,9 @@ protected:
     }
 
     bool scanned;
+    bool attackTimerArmed; //attack timeout of the host is scheduled in the host map
 
+    uint64_t hostId; //unique id of the host in the host map
     ip_addr_t hostIp;
     ur_time_t firstSeen;
     ur_time_t timeOfLastReport;
@@ -180,166 +274,198 @@ protected:
     RecordList<T> recordListOutgoing;
 };
 
-
-class SSHHost : public IHost<SSHRecord*> {
-
-public:
-    SSHHost(ip_addr_t hostIp, ur_time_t firstSeen) : IHost<SSHRecord*> (hostIp,  firstSeen) {}
-
-	virtual bool addRecord(SSHRecord *record, void *structure, uint8_t direction = FLOW_INCOMING_DIRECTION);
-	virtual ATTACK_STATE checkForAttack(ur_time_t actualTime);
-	virtual ur_time_t getHostDeleteTimeout() { return Config::getInstance().getSSHHostTimeout(); }
-    virtual ur_time_t getHostReportTimeout() { return Config::getInstance().getSSHReportTimeout(); }
-    virtual ur_time_t getHostAttackTimeout() { return Config::getInstance().getSSHAttackTimeout(); } 
-};
-
-class RDPHost : public IHost<RDPRecord*> {
-
-public:
-    RDPHost(ip_addr_t hostIp, ur_time_t firstSeen) : IHost<RDPRecord*> (hostIp,  firstSeen) {}
-
-	virtual bool addRecord(RDPRecord *record, void *structure, uint8_t direction = FLOW_INCOMING_DIRECTION);
-	virtual ATTACK_STATE checkForAttack(ur_time_t actualTime);
-	virtual ur_time_t getHostDeleteTimeout() { return Config::getInstance().getRDPHostTimeout(); }
-    virtual ur_time_t getHostReportTimeout() { return Config::getInstance().getRDPReportTimeout(); }
-    virtual ur_time_t getHostAttackTimeout() { return Config::getInstance().getRDPAttackTimeout(); } 
-};
-
-class TELNETHost : public IHost<TELNETRecord*> {
-
-public:
-    TELNETHost(ip_addr_t hostIp, ur_time_t firstSeen) : IHost<TELNETRecord*> (hostIp,  firstSeen) {}
-
-	virtual bool addRecord(TELNETRecord *record, void *structure, uint8_t direction = FLOW_INCOMING_DIRECTION);
-	virtual ATTACK_STATE checkForAttack(ur_time_t actualTime);
-	virtual ur_time_t getHostDeleteTimeout() { return Config::getInstance().getTELNETHostTimeout(); }
-	virtual ur_time_t getHostReportTimeout() { return Config::getInstance().getTELNETReportTimeout(); }
-    virtual ur_time_t getHostAttackTimeout() { return Config::getInstance().getTELNETAttackTimeout(); } 	
-};
+typedef Host<SSHRecord>    SSHHost;
+typedef Host<RDPRecord>    RDPHost;
+typedef Host<TELNETRecord> TELNETHost;
 
 
 //////////////////////////////////////////////////////////////////////////////////////
 /************************************************************************************/
 //////////////////////////////////////////////////////////////////////////////////////
 
-class IHostMap {
+/**
+ * Map of hosts of one protocol, H is the host type of the protocol
+ */
+template <class H>
+class HostMap {
 
 public:
-    IHostMap() {}
-	~IHostMap() {}
+    HostMap() : nextHostId(0) {}
+    ~HostMap() {}
 
-	virtual void clear() = 0;
-	virtual inline uint16_t size() = 0;
+    void clear()
+    {
+        for(size_t i = 0; i < hostMap.capacity(); i++)
+        {
+            if(hostMap.at(i))
+                delete hostMap.at(i);
+        }
+        hostMap.clear();
+        deleteTimers.clear();
+        attackTimers.clear();
+    }
 
-	virtual void deleteOldRecordAndHosts(ur_time_t actualTime) = 0;
-	virtual void checkForAttackTimeout(ur_time_t actualTime, Sender *sender) = 0;
+    inline uint32_t size()
+    {
+        return hostMap.size();
+    }
 
-protected:
+    H *findHost(IRecord::MatchStructure *structure, uint8_t direction = FLOW_INCOMING_DIRECTION)
+    {
+        ip_addr_t ip;
+        if(direction == FLOW_INCOMING_DIRECTION)
+            ip = structure->srcIp;
+        else
+            ip = structure->dstIp; //attacker is now destination address
+
+        H *host = hostMap.find(ip);
+        if(host == NULL)
+        { //not found, create new host
+            host = new H(ip, structure->flowFirstSeen);
+            host->setHostId(nextHostId++);
+            hostMap.insert(ip, host);
+
+            //host which never adds a record is deleted with the next delete check
+            deleteTimers.schedule(ip, host->getHostId(), structure->flowFirstSeen,
+                                  H::RecordType::settings->checkForDeleteTimeout);
+        }
+        return host;
+    }
 
-    template<typename Container>
-    void clearMap(Container *c)
+    void watchReportedHost(H *host)
     {
-        typename Container::iterator it = c->begin();
-        while(it != c->end())
+        if(host->isReported() && !host->isAttackTimerArmed())
         {
-            if(it->second)
-                delete it->second;
-            it++;
-
+            attackTimers.schedule(host->getHostIp(), host->getHostId(), host->getTimeOfLastReport(),
+                                  host->getHostAttackTimeout());
+            host->setAttackTimerArmed(true);
         }
-        c->clear();
     }
 
-    template<typename Container>
-    void clearOldRecAHost(Container *c, ur_time_t actualTime)
+    void deleteOldRecordAndHosts(ur_time_t actualTime)
     {
-        typename Container::iterator it = c->begin();
-        while(it != c->end())
+        expired.clear();
+        deleteTimers.advance(actualTime, expired);
+
+        for(size_t i = 0; i < expired.size(); i++)
         {
-            it->second->clearOldRecords(actualTime);
+            H *host = hostMap.find(expired[i].hostIp);
+            if(host == NULL || host->getHostId() != expired[i].hostId)
+                continue; //host was already deleted
 
-            bool canDelete = it->second->canDeleteHost(actualTime);
-            if(canDelete)
+            host->clearOldRecords(actualTime);
+
+            if(host->canDeleteHost(actualTime))
             {
-                delete it->second;
-                c->erase(it++);
+                hostMap.erase(expired[i].hostIp);
+                delete host;
             }
             else
-                it++;
+            {
+                deleteTimers.schedule(expired[i].hostIp, expired[i].hostId, host->getTimeOfLastReceivedRecord(),
+                                      host->getHostDeleteTimeout());
+            }
         }
     }
-};
-
-class SSHHostMap : public IHostMap {
 
-public:
-    SSHHostMap() {}
-    ~SSHHostMap() {}
-
-    virtual void clear()
-    {
-        IHostMap::clearMap(&hostMap);
-    }
-    virtual inline uint16_t size()
+    //serialize all hosts, every host is preceded by the protocol
+    void save(CheckpointBuffer &out, uint8_t protocol)
     {
-        return hostMap.size();
+        for(size_t i = 0; i < hostMap.capacity(); i++)
+        {
+            H *host = hostMap.at(i);
+            if(host == NULL)
+                continue;
+            out.put(protocol);
+            host->save(out);
+            out.hosts++;
+        }
     }
 
-    SSHHost *findHost(IRecord::MatchStructure *structure, uint8_t direction = FLOW_INCOMING_DIRECTION);
-    virtual void deleteOldRecordAndHosts(ur_time_t actualTime);
-    virtual void checkForAttackTimeout(ur_time_t actualTime, Sender *sender);
-
-private:
-    map<ip_addr_t, SSHHost*, cmpByIpAddr> hostMap;
-};
-
-class RDPHostMap: public IHostMap {
-
-public:
-    RDPHostMap() {}
-    ~RDPHostMap() {}
-
-    virtual void clear()
-    {
-        IHostMap::clearMap(&hostMap);
-    }
-    
-    virtual inline uint16_t size()
+    /**
+     * Create the host from the checkpoint and schedule its timers, the host is dropped
+     * if insert is false (protocol is not enabled) or when the host is already in the map
+     * @return false if the checkpoint is corrupted
+     */
+    bool loadHost(CheckpointReader &in, bool insert, bool &inserted)
     {
-        return hostMap.size();
-    }
+        ip_addr_t ip;
+        ur_time_t firstSeen;
+        inserted = false;
+        if(!in.get(ip) || !in.get(firstSeen))
+            return false;
 
-    RDPHost *findHost(IRecord::MatchStructure *structure, uint8_t direction = FLOW_INCOMING_DIRECTION);
-    virtual void deleteOldRecordAndHosts(ur_time_t actualTime);
-    virtual void checkForAttackTimeout(ur_time_t actualTime, Sender *sender);
+        H *host = new H(ip, firstSeen);
+        if(!host->load(in))
+        {
+            delete host;
+            return false;
+        }
+        if(!insert || hostMap.find(ip) != NULL)
+        {
+            delete host;
+            return true;
+        }
 
-private:
-    map<ip_addr_t, RDPHost*, cmpByIpAddr> hostMap;
-};
+        host->setHostId(nextHostId++);
+        hostMap.insert(ip, host);
+        deleteTimers.schedule(ip, host->getHostId(), host->getTimeOfLastReceivedRecord(),
+                              host->getHostDeleteTimeout());
+        watchReportedHost(host);
+        inserted = true;
+        return true;
+    }
 
+    void checkForAttackTimeout(ur_time_t actualTime, Sender *sender, uint16_t port)
+    {
+        expired.clear();
+        attackTimers.advance(actualTime, expired);
 
-class TELNETHostMap: public IHostMap {
+        for(size_t i = 0; i < expired.size(); i++)
+        {
+            H *host = hostMap.find(expired[i].hostIp);
+            if(host == NULL || host->getHostId() != expired[i].hostId)
+                continue; //host was already deleted
 
-public:
-    TELNETHostMap() {}
-    ~TELNETHostMap() {}
+            host->setAttackTimerArmed(false);
+            if(!host->isReported())
+                continue;
 
-    virtual void clear()
-    {
-        IHostMap::clearMap(&hostMap);
-    }
-    
-    virtual inline uint16_t size()
-    {
-        return hostMap.size();
+            if(host->checkForAttackTimeout(actualTime))
+            {
+                uint32_t numOfEvents = host->getPointerToIncomingRecordList()->getNumOfMatchedFlowsSinceLastReport();
+                if(numOfEvents >= H::RecordType::settings->attackMinEvToReport)
+                {
+                    sender->continuingReport(host, port, actualTime, true);
+                }
+                host->setNotReported();
+                host->clearAllRecords();
+            }
+            else
+                watchReportedHost(host); //reported again since the timer was scheduled
+        }
     }
 
-    TELNETHost *findHost(IRecord::MatchStructure *structure, uint8_t direction = FLOW_INCOMING_DIRECTION);
-    virtual void deleteOldRecordAndHosts(ur_time_t actualTime);
-    virtual void checkForAttackTimeout(ur_time_t actualTime, Sender *sender);
-
 private:
-    map<ip_addr_t, TELNETHost*, cmpByIpAddr> hostMap;
+    /*
+     * Hosts are not swept periodically, every host has a timer in deleteTimers
+     * and every reported host a timer in attackTimers. Timers are never cancelled,
+     * when a timer fires the state of the host is checked again and the timer
+     * is scheduled again if the host is still active. Timers of deleted hosts
+     * are recognized by the host id.
+     */
+    HostTable<H> hostMap;
+    TimerWheel deleteTimers;
+    TimerWheel attackTimers;
+    uint64_t nextHostId;
+    std::vector<TimerEntry> expired;
 };
 
+/*
+ * Host types of the protocols in the order of PROTOCOL_ID, the detector creates a host map for each of them
+ */
+typedef std::tuple<SSHHost, RDPHost, TELNETHost> ProtocolHosts;
+
+static_assert(std::tuple_size<ProtocolHosts>::value == PROTOCOL_COUNT, "every protocol needs its host type");
+
 #endif
@@ -0,0 +1,179 @@
+/**
+ * \file host_table.h
+ * \brief Open addressing hash table of hosts indexed by IP address
+ * \date 2026
+ */
+
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef HOST_TABLE_H
+#define HOST_TABLE_H
+
+#include <unirec/ipaddr.h> //ip_addr_t
+#include <cstring>
+#include <vector>
+
+/**
+ * Hash of an IP address, low bits are used by HostTable, high bits for sharding of hosts
+ */
+static inline uint64_t hashIp(const ip_addr_t &ip)
+{
+    uint64_t h = ip.ui64[0] * 0x9E3779B97F4A7C15ULL ^ ip.ui64[1];
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * Hash table of host pointers with linear probing, the table does not own the hosts
+ *
+ * Removed entries are filled by shifting the following entries back,
+ * so there are no tombstones and lookups stay short under heavy churn.
+ */
+template <class Host>
+class HostTable {
+
+public:
+    HostTable() : count(0), mask(0) { resize(HT_INITIAL_CAPACITY); }
+
+    Host *find(const ip_addr_t &ip) const
+    {
+        for(size_t i = hash(ip) & mask; slots[i].host != NULL; i = (i + 1) & mask)
+        {
+            if(memcmp(&slots[i].ip, &ip, sizeof(ip_addr_t)) == 0)
+                return slots[i].host;
+        }
+        return NULL;
+    }
+
+    //host must not be present in the table
+    void insert(const ip_addr_t &ip, Host *host)
+    {
+        if((count + 1) * 4 > slots.size() * 3)
+            resize(slots.size() * 2);
+
+        size_t i = hash(ip) & mask;
+        while(slots[i].host != NULL)
+            i = (i + 1) & mask;
+
+        slots[i].ip = ip;
+        slots[i].host = host;
+        count++;
+    }
+
+    Host *erase(const ip_addr_t &ip)
+    {
+        size_t i = hash(ip) & mask;
+        while(slots[i].host != NULL && memcmp(&slots[i].ip, &ip, sizeof(ip_addr_t)) != 0)
+            i = (i + 1) & mask;
+
+        Host *host = slots[i].host;
+        if(host == NULL)
+            return NULL;
+
+        //backward shift of the following entries of the cluster
+        size_t hole = i;
+        for(size_t j = (i + 1) & mask; slots[j].host != NULL; j = (j + 1) & mask)
+        {
+            size_t home = hash(slots[j].ip) & mask;
+            if(((j - home) & mask) >= ((j - hole) & mask))
+            {
+                slots[hole] = slots[j];
+                hole = j;
+            }
+        }
+        slots[hole].host = NULL;
+        count--;
+
+        return host;
+    }
+
+    void clear()
+    {
+        std::vector<Slot>().swap(slots);
+        count = 0;
+        resize(HT_INITIAL_CAPACITY);
+    }
+
+    inline uint32_t size() const { return count; }
+
+    //slots for iteration over the table, empty slots return NULL
+    inline size_t capacity() const { return slots.size(); }
+    inline Host *at(size_t slot) const { return slots[slot].host; }
+
+private:
+    const static size_t HT_INITIAL_CAPACITY = 1024;
+
+    struct Slot {
+        ip_addr_t ip;
+        Host *host;
+    };
+
+    std::vector<Slot> slots;
+    uint32_t count;
+    size_t mask;
+
+    static inline size_t hash(const ip_addr_t &ip) { return (size_t) hashIp(ip); }
+
+    void resize(size_t capacity)
+    {
+        std::vector<Slot> old;
+        old.swap(slots);
+
+        Slot empty;
+        memset(&empty, 0, sizeof(Slot));
+        slots.assign(capacity, empty);
+        mask = capacity - 1;
+
+        for(size_t i = 0; i < old.size(); i++)
+        {
+            if(old[i].host == NULL)
+                continue;
+            size_t j = hash(old[i].ip) & mask;
+            while(slots[j].host != NULL)
+                j = (j + 1) & mask;
+            slots[j] = old[i];
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ * \file prefilter.h
+ * \brief Cheap filter of flows before UniRec fields of the flow are read
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef PREFILTER_H
+#define PREFILTER_H
+
+#include <stdint.h>
+#include <cstring>
+#include "brute_force_detector.h"
+
+/**
+ * Bitmap of ports of the enabled services (8 kB, stays in L1 cache)
+ *
+ * Only the protocol and the ports are needed to reject a flow, the test has no branches
+ * and most of the flows are rejected by it.
+ */
+class FlowPrefilter {
+
+public:
+    FlowPrefilter() : totalFlows(0), candidateFlows(0) { memset(ports, 0, sizeof(ports)); }
+
+    void addPort(uint16_t port) { ports[port >> 6] |= 1ULL << (port & 63); }
+
+    inline bool isCandidate(uint8_t protocol, uint16_t srcPort, uint16_t dstPort)
+    {
+        uint64_t match = (ports[dstPort >> 6] >> (dstPort & 63)) | (ports[srcPort >> 6] >> (srcPort & 63));
+        bool candidate = (match & (protocol == TCP_PROTOCOL_NUM)) != 0;
+
+        totalFlows++;
+        candidateFlows += candidate;
+        return candidate;
+    }
+
+    inline uint64_t getCandidateFlows() const { return candidateFlows; }
+    inline uint64_t getRejectedFlows() const { return totalFlows - candidateFlows; }
+
+private:
+    uint64_t ports[65536 / 64];
+    uint64_t totalFlows;
+    uint64_t candidateFlows;
+};
+
+#endif
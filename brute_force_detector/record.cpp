@@ -44,6 +44,18 @@
 
 #include "record.h"
 
+thread_local const ProtocolSettings *SSHRecord::settings = NULL;
+thread_local const ProtocolSettings *RDPRecord::settings = NULL;
+thread_local const ProtocolSettings *TELNETRecord::settings = NULL;
+pthread_mutex_t TELNETRecord::TSPMutex = PTHREAD_MUTEX_INITIALIZER;
+
+void loadProtocolSettings(const ConfigSnapshot &config)
+{
+    SSHRecord::settings = &config.ssh;
+    RDPRecord::settings = &config.rdp;
+    TELNETRecord::settings = &config.telnet;
+}
+
 // ************************************************************/
 // ************************ SSH RECORD  ***********************/
 // ************************************************************/
@@ -54,6 +66,15 @@ SSHRecord::SSHRecord(ip_addr_t dstIp, ur_time_t flowLastSeen)
     this->flowLastSeen = flowLastSeen;
 }
 
+bool SSHRecord::isIgnoredFlow(const MatchStructure &st)
+{
+    if(st.packets == 1 && st.flags == 0b00010000) //skip ack only packet
+        return true;
+    else if(st.packets == 4 && st.flags == 0b00000010) //4 packet SYN request
+        return true;
+    return false;
+}
+
 bool SSHRecord::matchWithIncomingSignature(void *structure, Whitelist *wl)
 {
     IRecord::MatchStructure st = *(IRecord::MatchStructure*)(structure);
@@ -68,9 +89,9 @@ bool SSHRecord::matchWithIncomingSignature(void *structure, Whitelist *wl)
     if((flags & signatureFlags) != signatureFlags)
         return false;
 
-    if(packets > Config::getInstance().getSSHBFIncMaxPackets() || packets < Config::getInstance().getSSHBFIncMinPackets())
+    if(packets > settings->incMaxPackets || packets < settings->incMinPackets)
         return false;
-    if(bytes > Config::getInstance().getSSHBFIncMaxBytes() || bytes < Config::getInstance().getSSHBFIncMinBytes())
+    if(bytes > settings->incMaxBytes || bytes < settings->incMinBytes)
         return false;
 
     if(wl->isWhitelisted(&st.srcIp, &st.dstIp, st.srcPort, st.dstPort))
@@ -94,9 +115,9 @@ bool SSHRecord::matchWithOutgoingSignature(void *structure, Whitelist *wl)
     if((flags & signatureFlags) != signatureFlags)
         return false;
     
-    if(packets > Config::getInstance().getSSHBFOutMaxPackets() || packets < Config::getInstance().getSSHBFOutMinPackets())
+    if(packets > settings->outMaxPackets || packets < settings->outMinPackets)
         return false;
-    if(bytes > Config::getInstance().getSSHBFOutMaxBytes() || bytes < Config::getInstance().getSSHBFOutMinBytes())
+    if(bytes > settings->outMaxBytes || bytes < settings->outMinBytes)
         return false;
 
     if(wl->isWhitelisted(&st.dstIp, &st.srcIp, st.dstPort, st.srcPort)) //swap src/dst ip/port
@@ -166,9 +187,9 @@ bool RDPRecord::matchWithIncomingSignature(void *structure, Whitelist *wl)
     if((flags & signatureFlags) != signatureFlags)
         return false;
 
-    if(packets > Config::getInstance().getRDPBFIncMaxPackets() || packets < Config::getInstance().getRDPBFIncMinPackets())
+    if(packets > settings->incMaxPackets || packets < settings->incMinPackets)
         return false;
-    if(bytes > Config::getInstance().getRDPBFIncMaxBytes() || bytes < Config::getInstance().getRDPBFIncMinBytes())
+    if(bytes > settings->incMaxBytes || bytes < settings->incMinBytes)
         return false;
 
     if(wl->isWhitelisted(&st.srcIp, &st.dstIp, st.srcPort, st.dstPort))
@@ -226,9 +247,9 @@ bool RDPRecord::matchWithOutgoingSignature(void *structure, Whitelist *wl)
     if((flags & signatureFlags) != signatureFlags)
         return false;
     
-    if(packets > Config::getInstance().getRDPBFOutMaxPackets()  || packets < Config::getInstance().getRDPBFOutMinPackets())
+    if(packets > settings->outMaxPackets  || packets < settings->outMinPackets)
         return false;
-    if(bytes > Config::getInstance().getRDPBFOutMaxBytes() || bytes < Config::getInstance().getRDPBFOutMinBytes())
+    if(bytes > settings->outMaxBytes || bytes < settings->outMinBytes)
         return false;
     
     
@@ -266,9 +287,9 @@ bool TELNETRecord::matchWithIncomingSignature(void *structure, Whitelist *wl)
     if((flags & signatureFlags) != signatureFlags)
         return false;
 
-    if(packets > Config::getInstance().getTELNETBFIncMaxPackets() || packets < Config::getInstance().getTELNETBFIncMinPackets())
+    if(packets > settings->incMaxPackets || packets < settings->incMinPackets)
         return false;
-    if(bytes > Config::getInstance().getTELNETBFIncMaxBytes() || bytes < Config::getInstance().getTELNETBFIncMinBytes())
+    if(bytes > settings->incMaxBytes || bytes < settings->incMinBytes)
 	    return false;
 
     if(wl->isWhitelisted(&st.srcIp, &st.dstIp, st.srcPort, st.dstPort))
@@ -294,19 +315,24 @@ bool TELNETRecord::matchWithOutgoingSignature(void *structure, Whitelist *wl)
     if((flags & signatureFlags) != signatureFlags)
         return false;
     
-    TelnetServerProfile * TSPProfile = TSPMap.findProfile(st.srcIp);
-    if(TSPProfile == NULL)
-        TSPProfile = TSPMap.createProfile(st.srcIp, st.flowFirstSeen);
-    
+    //profiles are per server, shared by all detection threads
+    pthread_mutex_lock(&TSPMutex);
+    TelnetServerProfile * TSPProfile = TSPMap.getProfile(st.srcIp, st.flowLastSeen);
+
     TSPProfile->profileWithNewData(packets, bytes);
+
+    bool profiled = TSPProfile->isProfiled();
+    uint32_t maxPackets = TSPProfile->getMaxPackets();
+    uint64_t maxBytes = TSPProfile->getMaxBytes();
+    pthread_mutex_unlock(&TSPMutex);
     
     if(packets < 6)
         return false;
     
     //for max range only
-    if(TSPProfile->isProfiled())
+    if(profiled)
     {
-        if(packets > TSPProfile->getMaxPackets() || bytes > TSPProfile->getMaxBytes())
+        if(packets > maxPackets || bytes > maxBytes)
             return false;
     }
     else
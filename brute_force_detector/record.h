@@ -46,6 +46,7 @@
 #define RECORD_H
 
 #include <iostream>
+#include <pthread.h>
 //class TelnetServerProfileMap;
 #include "telnet_server_profile.h"
 
@@ -57,25 +58,28 @@
 #include "whitelist.h"
 #include <nemea-common.h>
 #include <cassert>
-#include <list>
+#include <vector>
 #include "config.h"
+#include "distinct_counter.h"
+#include "checkpoint.h"
 
 //If we don't have a lot of memory use hash
 //#define USE_HASH 
 
 /**
- * Interface for record
+ * Base of records, record types are used as template parameters of hosts (no virtual calls)
+ *
+ * Every record type provides:
+ *   matchWithIncomingSignature(), matchWithOutgoingSignature() - signature of the flow,
+ *   isIgnoredFlow() - flows not added to the host at all (besides scans),
+ *   settings - protocol settings of the calling thread (see SettingsHandle).
  */
 class IRecord {
 	
 public:
     IRecord () : signatureMatched(false) {}
-    virtual ~IRecord() {}
-    virtual bool matchWithIncomingSignature(void *structure, Whitelist *wl) = 0;
-    virtual bool matchWithOutgoingSignature(void *structure, Whitelist *wl) = 0;
 	
-    inline bool isMatched() { return signatureMatched; }
-    virtual ur_time_t getRecordTimeout() = 0;
+    inline bool isMatched() const { return signatureMatched; }
 
     struct MatchStructure
     {
@@ -90,6 +94,8 @@ public:
         ur_time_t flowLastSeen;
     };
 
+    static bool isIgnoredFlow(const MatchStructure &st) { return false; }
+
 protected:
     bool signatureMatched;
 };
@@ -98,9 +104,11 @@ class SSHRecord : public IRecord {
 	
 public:
     SSHRecord(ip_addr_t dstIp, ur_time_t flowLastSeen);
-    virtual bool matchWithIncomingSignature(void *structure, Whitelist *wl);
-    virtual bool matchWithOutgoingSignature(void *structure, Whitelist *wl);
-    virtual ur_time_t getRecordTimeout() { return Config::getInstance().getSSHRecordTimeout(); }
+    bool matchWithIncomingSignature(void *structure, Whitelist *wl);
+    bool matchWithOutgoingSignature(void *structure, Whitelist *wl);
+    static bool isIgnoredFlow(const MatchStructure &st);
+
+    static thread_local const ProtocolSettings *settings;
 	
     ip_addr_t dstIp;
     ur_time_t flowLastSeen;
@@ -110,9 +118,10 @@ class RDPRecord : public IRecord {
 
 public:
     RDPRecord(ip_addr_t dstIp, ur_time_t flowLastSeen);
-    virtual bool matchWithIncomingSignature(void *structure, Whitelist *wl);
-    virtual bool matchWithOutgoingSignature(void *structure, Whitelist *wl);
-    virtual ur_time_t getRecordTimeout() { return Config::getInstance().getRDPRecordTimeout(); }
+    bool matchWithIncomingSignature(void *structure, Whitelist *wl);
+    bool matchWithOutgoingSignature(void *structure, Whitelist *wl);
+
+    static thread_local const ProtocolSettings *settings;
 
     ip_addr_t dstIp;
     ur_time_t flowLastSeen;
@@ -122,25 +131,81 @@ class TELNETRecord : public IRecord {
 
 public:
     TELNETRecord(ip_addr_t dstIp, ur_time_t flowLastSeen);
-    virtual bool matchWithIncomingSignature(void *structure, Whitelist *wl);
-    virtual bool matchWithOutgoingSignature(void *structure, Whitelist *wl);
-    virtual ur_time_t getRecordTimeout() { return Config::getInstance().getTELNETRecordTimeout(); }
+    bool matchWithIncomingSignature(void *structure, Whitelist *wl);
+    bool matchWithOutgoingSignature(void *structure, Whitelist *wl);
+
+    static thread_local const ProtocolSettings *settings;
 
     ip_addr_t dstIp;
     ur_time_t flowLastSeen;
 
 private:
     static TelnetServerProfileMap TSPMap;
+    static pthread_mutex_t TSPMutex;
 };
 
+/**
+ * Point the settings of all protocols of the calling thread to the snapshot
+ */
+void loadProtocolSettings(const ConfigSnapshot &config);
+
+/**
+ * Reference of one thread to the published configuration, checks for a new snapshot
+ * by one atomic load and points the protocol settings of the thread to it
+ */
+class SettingsHandle {
+
+public:
+    SettingsHandle() : generation(~0ULL) {}
+
+    //returns true when a new snapshot was taken
+    bool update()
+    {
+        Config &config = Config::getInstance();
+        uint64_t actualGeneration = config.getGeneration();
+        if(actualGeneration == generation)
+            return false;
+
+        generation = actualGeneration;
+        snapshot = config.getSnapshot();
+        loadProtocolSettings(*snapshot);
+        return true;
+    }
+
+    const ConfigSnapshot &get() const { return *snapshot; }
+
+private:
+    uint64_t generation;
+    std::shared_ptr<const ConfigSnapshot> snapshot;
+};
+
+/**
+ * Flow stored in the record list, only the data needed after the signature was matched
+ */
+struct RecordEntry {
+    ip_addr_t dstIp;
+    ur_time_t flowLastSeen;
+    bool matched;
+};
+
+//Initial capacity of the ring, it grows up to the max list size
+const static uint16_t RECORD_LIST_INITIAL_CAPACITY = 16;
+
+/**
+ * List of last maxListSize flows of one host and direction
+ *
+ * Flows are kept in a contiguous ring ordered from the oldest one (head),
+ * so adding a flow and removing the oldest/timed out flows only moves indices.
+ * The ring grows up to maxListSize and is never shrunk (except setNewMaxListSize),
+ * in steady state there is no allocation per flow.
+ */
 template<class T>
 class RecordList {
 
 public:
     RecordList();
-    ~RecordList();
 	
-    void addRecord(T record, bool isHostReported);
+    void addRecord(const T &record, bool isHostReported);
     void setNewMaxListSize(uint16_t newMaxListSize);
     void clearOldRecords(ur_time_t actualTime);
     void clearAllRecords();
@@ -153,18 +218,23 @@ public:
     inline void clearNumOfMatchedFlowsSinceLastReport() { matchedFlowsSinceLastReport = 0; }
     inline void clearNumOTotalFlowsSinceLastReport() { totalFlowsSinceLastReport = 0; }
 
-    inline uint16_t getNumOfTargetsSinceLastReport() { return hashedDstIPSet.size(); }
-    inline void clearNumOfTargetsSinceLastReport() { hashedDstIPSet.clear(); }
+    inline uint32_t getNumOfTargetsSinceLastReport() { return dstIPCounter.size(); }
+    inline void clearNumOfTargetsSinceLastReport() { dstIPCounter.clear(); }
 
     inline uint16_t getNumOfCurrentTargets();
 
-    inline uint32_t getNumOfTotalTargetsSinceAttack() { return hashedDstTotalIPSet.size(); }
-    inline void clearNumOfTotalTargetsSinceAttack() { hashedDstTotalIPSet.clear(); }
+    inline uint32_t getNumOfTotalTargetsSinceAttack() { return dstTotalIPCounter.size(); }
+    inline void clearNumOfTotalTargetsSinceAttack() { dstTotalIPCounter.clear(); }
     inline void initTotalTargetsSet();
     std::vector<std::string> getIpsOfVictims();
 
+    //flows and counters of the list for the checkpoint, flows over the max list size are dropped on load
+    void save(CheckpointBuffer &out);
+    bool load(CheckpointReader &in);
+
 private:
-    std::list<T> list;
+    std::vector<RecordEntry> ring; //ring.size() is the capacity of the ring
+    uint16_t head;                 //index of the oldest record
     uint16_t maxListSize;
     uint16_t actualListSize;
     uint16_t actualListMatchedFlows;
@@ -174,8 +244,9 @@ private:
     uint32_t flowCounter;
     uint32_t flowMatchedCounter;
 
-    std::set<ip_addr_t, cmpByIpAddr> hashedDstIPSet;
-    std::set<ip_addr_t, cmpByIpAddr> hashedDstTotalIPSet;
+    //distinct victims (approximate above DistinctCounter exact limit)
+    DistinctCounter dstIPCounter;
+    DistinctCounter dstTotalIPCounter;
 
     char str[46];
 
@@ -186,11 +257,36 @@ private:
         else
             return false;
     }
+
+    //i-th record from the oldest one
+    inline RecordEntry &at(uint16_t i)
+    {
+        uint32_t idx = (uint32_t) head + i;
+        if(idx >= ring.size())
+            idx -= ring.size();
+        return ring[idx];
+    }
+
+    inline void popOldest()
+    {
+        if(ring[head].matched)
+            actualListMatchedFlows--;
+        head++;
+        if(head == ring.size())
+            head = 0;
+        actualListSize--;
+    }
+
+    void resizeRing(uint16_t capacity);
+
+    //store the flow as the newest one, the oldest one is removed from the full list
+    void pushEntry(const RecordEntry &entry);
 };
 
 template <class T>
 RecordList<T>::RecordList()
 {
+    head = 0;
     actualListSize = 0;
     actualListMatchedFlows = 0;
     flowCounter = 0;
@@ -199,40 +295,27 @@ RecordList<T>::RecordList()
     matchedFlowsSinceLastReport = 0;
     totalFlowsSinceLastReport = 0;
 
-    if(typeid(T) == typeid(SSHRecord*))
-        maxListSize = Config::getInstance().getSSHMaxListSize();
-    else if(typeid(T) == typeid(RDPRecord*))
-        maxListSize = Config::getInstance().getRDPMaxListSize();
-    else if(typeid(T) == typeid(TELNETRecord*))
-        maxListSize = Config::getInstance().getTELNETMaxListSize();
-    else     
-    {    
-        std::cerr<<"Error record.h: Max list size for class "<<typeid(T).name()<<" is not defined!\n";    
-        std::terminate();
-    }
+    maxListSize = T::settings->maxListSize;
+    if(maxListSize == 0)
+        maxListSize = 1;
 }
 
 template <class T>
-RecordList<T>::~RecordList()
+void RecordList<T>::resizeRing(uint16_t capacity)
 {
-    while(!list.empty())
-    {
-        T recToDel = list.front();
-        list.pop_front();
-        delete recToDel;
-    }
+    std::vector<RecordEntry> newRing(capacity);
+    for(uint16_t i = 0; i < actualListSize; i++)
+        newRing[i] = at(i);
+
+    ring.swap(newRing);
+    head = 0;
 }
 
 template <class T>
 void RecordList<T>::clearAllRecords()
 {
-    while(!list.empty())
-    {
-        T recToDel = list.front();
-        list.pop_front();
-        delete recToDel;
-    }
-
+    //keep the ring allocated, the host is likely to be active again
+    head = 0;
     actualListSize = 0;
     actualListMatchedFlows = 0;
     flowCounter = 0;
@@ -246,102 +329,90 @@ void RecordList<T>::clearAllRecords()
 
 
 template <class T>
-void RecordList<T>::addRecord(T record, bool isHostReported)
-{	
-    flowCounter++;
-    actualListSize++;
-    if(actualListSize > maxListSize)
+void RecordList<T>::pushEntry(const RecordEntry &entry)
+{
+    if(actualListSize >= maxListSize)
     {   //list is full
         //delete first record
-        if((*list.begin())->isMatched())
-            actualListMatchedFlows--;
-        T recToDelete = list.front();
-        delete recToDelete;
-        list.pop_front();
-        actualListSize--;
+        popOldest();
     }
-	
-    if(record->isMatched())
-    {
-        flowMatchedCounter++;
-        actualListMatchedFlows++; 
+    else if(actualListSize == ring.size())
+    {   //ring is full, but list can grow
+        uint32_t capacity = ring.size() * 2;
+        if(capacity < RECORD_LIST_INITIAL_CAPACITY)
+            capacity = RECORD_LIST_INITIAL_CAPACITY;
+        if(capacity > maxListSize)
+            capacity = maxListSize;
+        resizeRing(capacity);
     }
+
+    if(entry.matched)
+        actualListMatchedFlows++;
+
+    actualListSize++;
+    at(actualListSize - 1) = entry;
+}
+
+template <class T>
+void RecordList<T>::addRecord(const T &record, bool isHostReported)
+{	
+    flowCounter++;
+    if(record.isMatched())
+        flowMatchedCounter++;
 	
     if(isHostReported)
     {
         totalFlowsSinceLastReport++;
 
-        if(record->isMatched())
+        if(record.isMatched())
         {
             matchedFlowsSinceLastReport++;
             
-            hashedDstIPSet.insert(record->dstIp);   
-            hashedDstTotalIPSet.insert(record->dstIp);
+            dstIPCounter.insert(record.dstIp);
+            dstTotalIPCounter.insert(record.dstIp);
         }
     }
 
-    list.push_back(record); //finally push record to a list
+    //finally store record to the ring
+    RecordEntry entry;
+    entry.dstIp = record.dstIp;
+    entry.flowLastSeen = record.flowLastSeen;
+    entry.matched = record.isMatched();
+    pushEntry(entry);
 }
 
 template <class T>
 void RecordList<T>::setNewMaxListSize(uint16_t newMaxListSize)
 {
-    uint32_t currentMaxSize = maxListSize;
+    if(newMaxListSize == 0)
+        newMaxListSize = 1;
 
-    if (currentMaxSize > newMaxListSize)
+    while (actualListSize > newMaxListSize)
     {
-        while (actualListSize > newMaxListSize)
-        {
-            //delete first record
-            T recToDelete = list.front();
+        //delete first record
+        popOldest();
+    }
 
-            if (recToDelete->isMatched())
-                actualListMatchedFlows--;
+    if(ring.size() > newMaxListSize)
+        resizeRing(newMaxListSize);
 
-            delete recToDelete;
-            list.pop_front();
-            actualListSize--;
-        }
-    }
     maxListSize = newMaxListSize;
 }
 
 template <class T>
 void RecordList<T>::clearOldRecords(ur_time_t actualTime)
 {
-    if(list.empty())
-        return;
-
-    T rec = list.front();
-    ur_time_t timer = rec->getRecordTimeout();
+    ur_time_t timer = T::settings->recordTimeout;
 
-    typename std::list<T>::iterator it = list.begin();
-
-    while(it != list.end())
-    {
-        ur_time_t flowTime = (*it)->flowLastSeen;
-        if (checkForTimeout(flowTime, timer, actualTime))
-        {
-            if ((*it)->isMatched())
-            {
-                actualListMatchedFlows--;
-            }
-
-            actualListSize--;
-
-            delete *it;
-            list.erase(it++);
-        }
-        else
-            break;
-    }
+    while(actualListSize > 0 && checkForTimeout(ring[head].flowLastSeen, timer, actualTime))
+        popOldest();
 }
 
 template <class T>
 ur_time_t RecordList<T>::getTimeOfLastRecord()
 {
-    if(!list.empty())
-        return list.back()->flowLastSeen;
+    if(actualListSize > 0)
+        return at(actualListSize - 1).flowLastSeen;
     else
         return 0;
 }
@@ -350,13 +421,11 @@ template<class T>
 uint16_t RecordList<T>::getNumOfCurrentTargets()
 {
     std::set<ip_addr_t, cmpByIpAddr> dstIpSet;
-    for(typename std::list<T>::iterator it = list.begin(); it != list.end(); ++it)
+    for(uint16_t i = 0; i < actualListSize; i++)
     {
-        if((*it)->isMatched())
-        {
-            ip_addr_t dstIp = (*it)->dstIp;
-            dstIpSet.insert(dstIp);
-        }
+        const RecordEntry &entry = at(i);
+        if(entry.matched)
+            dstIpSet.insert(entry.dstIp);
     }
     return dstIpSet.size();
 }
@@ -364,14 +433,11 @@ uint16_t RecordList<T>::getNumOfCurrentTargets()
 template<class T>
 void RecordList<T>::initTotalTargetsSet()
 {
-    for(typename std::list<T>::iterator it = list.begin(); it != list.end(); ++it)
+    for(uint16_t i = 0; i < actualListSize; i++)
     {
-        if((*it)->isMatched())
-        {
-            ip_addr_t dstIp = (*it)->dstIp;
-
-            hashedDstTotalIPSet.insert(dstIp);
-        }
+        const RecordEntry &entry = at(i);
+        if(entry.matched)
+            dstTotalIPCounter.insert(entry.dstIp);
     }
 }
 
@@ -380,12 +446,12 @@ std::vector<std::string> RecordList<T>::getIpsOfVictims()
 {
     std::vector<std::string> tmpIpsOfVictims;
 
-    for(typename std::list<T>::iterator it = list.begin(); it != list.end(); ++it)
+    for(uint16_t i = 0; i < actualListSize; i++)
     {
-        if((*it)->isMatched())
+        RecordEntry &entry = at(i);
+        if(entry.matched)
         {
-            ip_addr_t dstIp = (*it)->dstIp;
-            ip_to_str(&dstIp, str);
+            ip_to_str(&entry.dstIp, str);
 
             tmpIpsOfVictims.push_back(std::string(str));
         }
@@ -394,4 +460,52 @@ std::vector<std::string> RecordList<T>::getIpsOfVictims()
     return tmpIpsOfVictims;
 }
 
+template<class T>
+void RecordList<T>::save(CheckpointBuffer &out)
+{
+    out.put(flowCounter);
+    out.put(flowMatchedCounter);
+    out.put(matchedFlowsSinceLastReport);
+    out.put(totalFlowsSinceLastReport);
+
+    out.put(actualListSize);
+    for(uint16_t i = 0; i < actualListSize; i++)
+    {
+        const RecordEntry &entry = at(i);
+        CheckpointEntry stored;
+        stored.dstIp = entry.dstIp;
+        stored.flowLastSeen = entry.flowLastSeen;
+        stored.matched = entry.matched;
+        out.put(stored);
+    }
+
+    dstIPCounter.save(out);
+    dstTotalIPCounter.save(out);
+}
+
+template<class T>
+bool RecordList<T>::load(CheckpointReader &in)
+{
+    uint16_t size;
+
+    if(!in.get(flowCounter) || !in.get(flowMatchedCounter) ||
+       !in.get(matchedFlowsSinceLastReport) || !in.get(totalFlowsSinceLastReport) || !in.get(size))
+        return false;
+
+    for(uint16_t i = 0; i < size; i++)
+    {
+        CheckpointEntry stored;
+        if(!in.get(stored))
+            return false;
+
+        RecordEntry entry;
+        entry.dstIp = stored.dstIp;
+        entry.flowLastSeen = stored.flowLastSeen;
+        entry.matched = stored.matched != 0;
+        pushEntry(entry);
+    }
+
+    return dstIPCounter.load(in) && dstTotalIPCounter.load(in);
+}
+
 #endif
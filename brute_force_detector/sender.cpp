@@ -55,7 +55,7 @@ UR_FIELDS(
 )
 
 
-Sender::Sender(bool *success)
+Sender::Sender(bool *success) : queued(false)
 {
     std::string unirecSpecifier = "DETECTION_TIME,WARDEN_TYPE,SRC_IP,PROTOCOL,DST_PORT,EVENT_SCALE,NOTE";
 
@@ -74,4 +74,39 @@ Sender::~Sender()
         ur_free_template (outTemplate);
 }
 
+int Sender::flushAlerts()
+{
+    int sendState = TRAP_E_OK;
+    Alert alert;
+
+    while(alertQueue.pop(alert))
+        sendState = sendAlert(alert);
+    return sendState;
+}
+
+int Sender::sendAlert(const Alert &alert)
+{
+    //get size of note
+    uint16_t noteSize = alert.note.size() + 1; //plus '\0'
 
+    void *rec = ur_create_record(outTemplate, noteSize);
+
+    //@WARDEN_REPORT=DETECTION_TIME,WARDEN_TYPE,SRC_IP,PROTOCOL,DST_PORT,EVENT_SCALE,
+    //               NOTE (IP addresses of victims)
+    //set fields
+    ur_set(outTemplate, rec, F_DETECTION_TIME, alert.detectionTime);
+    ur_set(outTemplate, rec, F_WARDEN_TYPE, WT_BRUTEFORCE);
+    ur_set(outTemplate, rec, F_SRC_IP, alert.srcIp);
+    ur_set(outTemplate, rec, F_DST_PORT, alert.dstPort);
+    ur_set(outTemplate, rec, F_PROTOCOL, TCP_PROTOCOL_NUM);
+    ur_set(outTemplate, rec, F_EVENT_SCALE, alert.intensity);
+
+    //set dynamic field
+    ur_set_string(outTemplate, rec, F_NOTE, alert.note.c_str());
+
+    //send
+    int sendState = trap_send(0, rec, ur_rec_size(outTemplate, rec));
+
+    ur_free_record(rec);
+    return sendState;
+}
@@ -52,6 +52,7 @@
 #include <iostream>
 #include <vector>
 #include "config.h"
+#include "worker_queue.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -65,8 +66,23 @@ using namespace std;
 //WARDEN_TYPE
 #define WT_BRUTEFORCE      2
 
+/**
+ * @desc Output message, filled by the thread owning the host
+ */
+struct Alert
+{
+    ur_time_t detectionTime;
+    ip_addr_t srcIp;
+    uint16_t  dstPort;
+    uint32_t  intensity;
+    string    note;
+};
+
 /**
  * @desc Class for handling output messages
+ *
+ * Reports may be created by several worker threads, in that case the alerts are queued
+ * (enableQueue) and sent by the thread calling flushAlerts.
  */
 class Sender
 {
@@ -74,10 +90,21 @@ public:
     Sender(bool *success);
     ~Sender();
 
+    /**
+     * Queue the alerts instead of sending them, reports are then thread safe
+     */
+    void enableQueue() { queued = true; }
+
+    /**
+     * Send queued alerts, must be called by one thread only
+     * @return state of the last send
+     */
+    int flushAlerts();
+
     template <class Host>
     int firstReport(Host *host, uint16_t dstPort, ur_time_t actualTime, uint16_t detectionThreshold)
     {
-        if(Config::getInstance().getGlobalIgnoreFirstSend())
+        if(Host::RecordType::settings->ignoreFirstSend)
         {   ///Ignore first report
             host->setReportTime(actualTime);
             return TRAP_E_OK;
@@ -111,6 +138,10 @@ public:
 
 private:
     ur_template_t *outTemplate;
+    bool queued;
+    MPSCQueue<Alert> alertQueue;
+
+    int sendAlert(const Alert &alert);
 
     template <class Host>
     int send(Host *host, uint16_t dstPort, ur_time_t actualTime, uint32_t intensity, bool endOfAttack = false, string stringNote = string())
@@ -140,31 +171,21 @@ private:
         }
         note.erase(note.length(),1);
 
-		//get size of note
-        uint16_t noteSize = note.size() + 1; //plus '\0'
-
-        void *rec = ur_create_record(outTemplate, noteSize);
-
-        //@WARDEN_REPORT=DETECTION_TIME,WARDEN_TYPE,SRC_IP,PROTOCOL,DST_PORT,EVENT_SCALE,
-        //               NOTE (IP addresses of victims)
-        //set fields
-        ur_set(outTemplate, rec, F_DETECTION_TIME, actualTime);
-        ur_set(outTemplate, rec, F_WARDEN_TYPE, WT_BRUTEFORCE);
-        ur_set(outTemplate, rec, F_SRC_IP, host->getHostIp());
-        ur_set(outTemplate, rec, F_DST_PORT, dstPort);
-        ur_set(outTemplate, rec, F_PROTOCOL, TCP_PROTOCOL_NUM);
-        ur_set(outTemplate, rec, F_EVENT_SCALE, intensity);
-
-        //set dynamic field
-        ur_set_string(outTemplate, rec, F_NOTE, note.c_str());
-
-        //send
-        int sendState = trap_send(0, rec, ur_rec_size(outTemplate, rec));
+        Alert alert;
+        alert.detectionTime = actualTime;
+        alert.srcIp = host->getHostIp();
+        alert.dstPort = dstPort;
+        alert.intensity = intensity;
+        alert.note.swap(note);
 
         host->setReportTime(actualTime);
 
-        ur_free_record(rec);
-        return sendState;
+        if(queued)
+        {
+            alertQueue.push(alert);
+            return TRAP_E_OK;
+        }
+        return sendAlert(alert);
     }
 };
 
@@ -43,8 +43,20 @@
  */
 
 #include "telnet_server_profile.h"
+#include "host_table.h"
+#include <cstring>
 using namespace std;
-#include <iostream>
+
+void TelnetServerProfile::reset(ur_time_t firstSeen)
+{
+    timeOfCreation = firstSeen;
+    timeOfLastFlow = firstSeen;
+    profiled = false;
+    listSize = 0;
+    next = 0;
+    maxBytes = 0;
+    maxPackets = 0;
+}
 
 void TelnetServerProfile::profileWithNewData(uint32_t packets, uint64_t bytes)
 {
@@ -63,16 +75,12 @@ void TelnetServerProfile::profileWithNewData(uint32_t packets, uint64_t bytes)
     static uint16_t profileCounter = 0;
     profileCounter++;
     
-    if(listSize >= TSPArraySize)
-    {
-        byteList.pop_front();
-        packetList.pop_front();
-        listSize--;
-    }
-    
-    byteList.push_back(bytes);
-    packetList.push_back(packets);
-    listSize++;
+    //the oldest flow is overwritten when the ring is full
+    byteList[next] = bytes;
+    packetList[next] = packets;
+    next = (next + 1) % TSPArraySize;
+    if(listSize < TSPArraySize)
+        listSize++;
     
     if(!profiled && listSize == TSPArraySize)
     {
@@ -88,41 +96,92 @@ void TelnetServerProfile::profileWithNewData(uint32_t packets, uint64_t bytes)
 
 void TelnetServerProfile::countNewMaxValues()
 {
-    size_t n = packetList.size() / 2;
+    size_t n = listSize / 2;
     
-    vector<uint32_t> packetVector;
-    vector<uint64_t> byteVector;  
+    uint32_t packetVector[TSPArraySize];
+    uint64_t byteVector[TSPArraySize];
     
-    copy(packetList.begin(), packetList.end(), back_inserter(packetVector));
-    copy(byteList.begin(),   byteList.end(),   back_inserter(byteVector));
+    std::copy(packetList, packetList + listSize, packetVector);
+    std::copy(byteList,   byteList + listSize,   byteVector);
     
     //median
-    nth_element(byteVector.begin(),   byteVector.begin() + n,   byteVector.end());
-    nth_element(packetVector.begin(), packetVector.begin() + n, packetVector.end());
+    std::nth_element(byteVector,   byteVector + n,   byteVector + listSize);
+    std::nth_element(packetVector, packetVector + n, packetVector + listSize);
     
     maxPackets = packetVector[n] + 5;
     maxBytes   = byteVector[n] + 500;
-    
-    //char *c = new char[55];
-    //ip_to_str(&serverIp,c);
-    //std::cout<<"Profilovano "<<c<<": "<<maxPackets<<" "<<maxBytes<<std::endl; ///delete c;
 }
 
-TelnetServerProfile * TelnetServerProfileMap::createProfile(ip_addr_t ip, ur_time_t firstSeen)
+TelnetServerProfileMap::TelnetServerProfileMap() : count(0), mask(0), timeOfLastExpiryCheck(0)
 {
-    TelnetServerProfile *TSP;
-    
-    TSP = new TelnetServerProfile(firstSeen, ip);
-    TSPMap.insert(std::pair<ip_addr_t, TelnetServerProfile*>(ip, TSP));
-    
-    return TSP;
+    rebuild(TSP_INITIAL_CAPACITY, 0);
 }
 
-TelnetServerProfile * TelnetServerProfileMap::findProfile(ip_addr_t & hostIp) const
+TelnetServerProfile * TelnetServerProfileMap::getProfile(const ip_addr_t &serverIp, ur_time_t actualTime)
 {
-    std::map<ip_addr_t, TelnetServerProfile*, cmpByIpAddr>::const_iterator it = TSPMap.find(hostIp);
-    if(it == TSPMap.end())
-        return NULL;
-    
-    return it->second;
+    if(timeOfLastExpiryCheck + TSPExpiryCheck <= actualTime)
+    {
+        timeOfLastExpiryCheck = actualTime;
+        rebuild(slots.size(), actualTime);
+    }
+
+    size_t i = hashIp(serverIp) & mask;
+    for(; slots[i].used; i = (i + 1) & mask)
+    {
+        if(memcmp(&slots[i].ip, &serverIp, sizeof(ip_addr_t)) == 0)
+        {
+            slots[i].profile.setTimeOfLastFlow(actualTime);
+            return &slots[i].profile;
+        }
+    }
+
+    //not found, create new profile
+    if((count + 1) * 4 > slots.size() * 3)
+    {
+        rebuild(slots.size() * 2, 0);
+        for(i = hashIp(serverIp) & mask; slots[i].used; i = (i + 1) & mask)
+            ;
+    }
+
+    slots[i].ip = serverIp;
+    slots[i].used = true;
+    slots[i].profile.reset(actualTime);
+    count++;
+
+    return &slots[i].profile;
+}
+
+void TelnetServerProfileMap::rebuild(size_t capacity, ur_time_t actualTime)
+{
+    std::vector<Slot> old;
+    old.swap(slots);
+
+    //shrink the table if most of the profiles were deleted
+    uint32_t live = 0;
+    for(size_t i = 0; i < old.size(); i++)
+    {
+        if(old[i].used && (actualTime == 0 || old[i].profile.getTimeOfLastFlow() + TSPIdleTimeout > actualTime))
+            live++;
+        else
+            old[i].used = false;
+    }
+    while(capacity > TSP_INITIAL_CAPACITY && live * 4 < capacity)
+        capacity /= 2;
+
+    Slot empty;
+    memset(&empty.ip, 0, sizeof(ip_addr_t));
+    empty.used = false;
+    slots.assign(capacity, empty);
+    mask = capacity - 1;
+    count = live;
+
+    for(size_t i = 0; i < old.size(); i++)
+    {
+        if(!old[i].used)
+            continue;
+        size_t j = hashIp(old[i].ip) & mask;
+        while(slots[j].used)
+            j = (j + 1) & mask;
+        slots[j] = old[i];
+    }
 }
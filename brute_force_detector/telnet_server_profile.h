@@ -49,49 +49,81 @@
 #include "brute_force_detector.h"
 #include <unirec/ipaddr.h> //ip_addr_t
 #include <unirec/unirec.h> //ur_time_t
-#include <map>
-#include <list>
 #include <vector>
 #include <algorithm>
-#include <iterator>
 
 const static uint16_t TSPArraySize = 15;
 const static uint8_t profileEvery = 10;
 
+//profile of a server without telnet flows is deleted after this time
+const static ur_time_t TSPIdleTimeout = ur_time_from_sec_msec(86400, 0);
+//period of deleting of idle profiles
+const static ur_time_t TSPExpiryCheck = ur_time_from_sec_msec(3600, 0);
+
+/**
+ * Profile of last flows of a telnet server, the flows are kept in a fixed ring
+ */
 class TelnetServerProfile
 {
 public:    
-    TelnetServerProfile(ur_time_t firstSeen, ip_addr_t ip) : timeOfCreation(firstSeen), serverIp(ip), profiled(false),
-                                                             listSize(0), maxBytes(0), maxPackets(0) {}
+    TelnetServerProfile() { reset(0); }
+    void reset(ur_time_t firstSeen);
+
     bool isProfiled() const {return profiled;}
     uint32_t getMaxPackets() const { return maxPackets; }
     uint64_t getMaxBytes() const { return maxBytes; }
     void profileWithNewData(uint32_t packets, uint64_t bytes);
-    
+
+    inline ur_time_t getTimeOfLastFlow() const { return timeOfLastFlow; }
+    inline void setTimeOfLastFlow(ur_time_t time) { timeOfLastFlow = time; }
     
 private:
     ur_time_t timeOfCreation;
-    ip_addr_t serverIp;
+    ur_time_t timeOfLastFlow;
     bool profiled;
    
-    std::list<uint64_t> byteList;
-    std::list<uint32_t> packetList;
+    uint64_t byteList[TSPArraySize];
+    uint32_t packetList[TSPArraySize];
     uint16_t listSize;
+    uint16_t next; //position of the next flow in the ring
     
     uint64_t maxBytes;
     uint32_t maxPackets;
     void countNewMaxValues();   
 };
 
+/**
+ * Profiles stored in a flat hash table with linear probing, idle profiles are deleted
+ */
 class TelnetServerProfileMap
 {
 public:
-    TelnetServerProfileMap() {};
-    TelnetServerProfile * createProfile(ip_addr_t ip, ur_time_t firstSeen);
-    TelnetServerProfile * findProfile(ip_addr_t & hostIp) const;
+    TelnetServerProfileMap();
+
+    /**
+     * Find profile of the server or create a new one
+     * Returned pointer is valid only until the next call.
+     */
+    TelnetServerProfile * getProfile(const ip_addr_t &serverIp, ur_time_t actualTime);
+
+    inline uint32_t size() const { return count; }
     
 private:
-    std::map<ip_addr_t, TelnetServerProfile*, cmpByIpAddr> TSPMap;
+    const static size_t TSP_INITIAL_CAPACITY = 256;
+
+    struct Slot {
+        ip_addr_t ip;
+        bool used;
+        TelnetServerProfile profile;
+    };
+
+    std::vector<Slot> slots;
+    uint32_t count;
+    size_t mask;
+    ur_time_t timeOfLastExpiryCheck;
+
+    //move profiles to a table of the given capacity, profiles idle at actualTime are dropped (if not 0)
+    void rebuild(size_t capacity, ur_time_t actualTime);
 };
 
-#endif 
+#endif
@@ -0,0 +1,195 @@
+/**
+ * \file telnet_server_profile_unit_test.cpp
+ * \brief Unit test of telnet server profiles, ring and flat table against a list and map model
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2014 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include "telnet_server_profile.h"
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <map>
+#include <vector>
+
+using namespace std;
+
+int failCounter = 0;
+
+#define CHECK(cond) do { if (!(cond)) { \
+    cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << endl; \
+    failCounter++; } } while (0)
+
+/**
+ * Profile kept as lists of the last flows with the medians computed on vectors
+ */
+struct ModelProfile
+{
+    list<uint32_t> packetList;
+    list<uint64_t> byteList;
+    bool profiled;
+    uint32_t maxPackets;
+    uint64_t maxBytes;
+
+    ModelProfile() : profiled(false), maxPackets(0), maxBytes(0) {}
+
+    void countNewMaxValues()
+    {
+        vector<uint32_t> packetVector(packetList.begin(), packetList.end());
+        vector<uint64_t> byteVector(byteList.begin(), byteList.end());
+        size_t n = packetVector.size() / 2;
+
+        nth_element(packetVector.begin(), packetVector.begin() + n, packetVector.end());
+        nth_element(byteVector.begin(), byteVector.begin() + n, byteVector.end());
+        maxPackets = packetVector[n] + 5;
+        maxBytes = byteVector[n] + 500;
+    }
+};
+
+//the counter of flows between recomputations is shared by all profiles, as in the detector
+static uint16_t modelCounter = 0;
+
+static void modelProfile(ModelProfile &p, uint32_t packets, uint64_t bytes)
+{
+    if(packets < 6)
+        return;
+
+    modelCounter++;
+    if(p.packetList.size() >= TSPArraySize)
+    {
+        p.packetList.pop_front();
+        p.byteList.pop_front();
+    }
+    p.packetList.push_back(packets);
+    p.byteList.push_back(bytes);
+
+    if(!p.profiled && p.packetList.size() == TSPArraySize)
+    {
+        p.countNewMaxValues();
+        p.profiled = true;
+    }
+    else if(p.profiled && modelCounter == profileEvery)
+    {
+        p.countNewMaxValues();
+        modelCounter = 0;
+    }
+}
+
+static ip_addr_t serverIp(uint32_t i)
+{
+    ip_addr_t ip;
+    memset(&ip, 0, sizeof(ip));
+    if(i % 2)
+    {
+        ip.ui8[0] = 0x20;
+        ip.ui32[3] = i;
+    }
+    else
+    {
+        ip = ip_from_int(0x0A000000 | i);
+    }
+    return ip;
+}
+
+//random flows over many servers within one day, the table is swept and grows meanwhile
+static void testAgainstModel()
+{
+    const uint32_t servers = 300;
+    TelnetServerProfileMap map;
+    std::map<uint32_t, ModelProfile> model;
+    ur_time_t t = ur_time_from_sec_msec(1000000, 0);
+
+    srand(1);
+    for(uint32_t i = 0; i < 300000; i++)
+    {
+        uint32_t s = rand() % servers;
+        uint32_t packets = rand() % 20;
+        uint64_t bytes = 100 + rand() % 5000;
+        t += ur_time_from_sec_msec(0, rand() % 200);
+
+        TelnetServerProfile *p = map.getProfile(serverIp(s), t);
+        ModelProfile &m = model[s];
+
+        p->profileWithNewData(packets, bytes);
+        modelProfile(m, packets, bytes);
+
+        CHECK(p->isProfiled() == m.profiled);
+        CHECK(p->getMaxPackets() == m.maxPackets);
+        CHECK(p->getMaxBytes() == m.maxBytes);
+        CHECK(p->getTimeOfLastFlow() == t);
+        if(failCounter > 0)
+            return;
+    }
+    CHECK(map.size() == servers);
+}
+
+//a server without flows for a day starts a new profile, other servers are kept
+static void testExpiry()
+{
+    TelnetServerProfileMap map;
+    ur_time_t t = ur_time_from_sec_msec(1000000, 0);
+
+    for(uint32_t i = 0; i < TSPArraySize; i++)
+    {
+        map.getProfile(serverIp(1), t)->profileWithNewData(10, 1000);
+        map.getProfile(serverIp(2), t)->profileWithNewData(10, 1000);
+    }
+    CHECK(map.getProfile(serverIp(1), t)->isProfiled());
+
+    for(uint32_t h = 1; h <= 25; h++)
+        map.getProfile(serverIp(2), t + ur_time_from_sec_msec(h * 3600, 0));
+    t += ur_time_from_sec_msec(25 * 3600, 0);
+
+    CHECK(map.getProfile(serverIp(2), t)->isProfiled());
+    CHECK(!map.getProfile(serverIp(1), t)->isProfiled());
+    CHECK(map.size() == 2);
+}
+
+int main()
+{
+    testAgainstModel();
+    testExpiry();
+
+    if(failCounter > 0)
+    {
+        cerr << failCounter << " checks failed" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+/**
+ * \file timer_wheel.cpp
+ * \brief Hierarchical timer wheel for host timeouts
+ * \date 2026
+ */
+
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include "timer_wheel.h"
+
+void TimerWheel::schedule(const ip_addr_t &hostIp, uint64_t hostId, ur_time_t actualTime, ur_time_t timeout)
+{
+    TimerKey key;
+    key.hostIp = hostIp;
+    key.hostId = hostId;
+
+    //timers which already passed fire with the next step, a timer lost on memory error
+    //only keeps the host until the next one
+    ip_wheel_add(&wheel, &key, ur_time_get_sec(actualTime + timeout));
+}
+
+void TimerWheel::advance(ur_time_t actualTime, std::vector<TimerEntry> &expired)
+{
+    TimerKey key;
+    uint64_t expire;
+
+    while(ip_wheel_pop(&wheel, ur_time_get_sec(actualTime), &key, &expire))
+    {
+        TimerEntry entry;
+        entry.hostIp = key.hostIp;
+        entry.hostId = key.hostId;
+        entry.expire = expire;
+        expired.push_back(entry);
+    }
+}
+
+void TimerWheel::clear()
+{
+    ip_wheel_destroy(&wheel);
+    ip_wheel_init(&wheel, sizeof(TimerKey));
+}
@@ -0,0 +1,92 @@
+/**
+ * \file timer_wheel.h
+ * \brief Hierarchical timer wheel for host timeouts
+ * \date 2026
+ */
+
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <unirec/ipaddr.h> //ip_addr_t
+#include <unirec/unirec.h> //ur_time_t
+#include <vector>
+#include "ip_wheel.h"
+
+/**
+ * Timer of a host, the host is identified by its IP and id (to ignore timers of deleted hosts)
+ */
+struct TimerEntry {
+    ip_addr_t hostIp;
+    uint64_t hostId;
+    uint32_t expire; //seconds
+};
+
+/**
+ * Timers of hosts with one second resolution, kept in the common ip_wheel
+ *
+ * Timers are not cancelled, the owner checks the state of the host when the
+ * timer fires and schedules it again if needed, so advancing costs
+ * O(expired timers).
+ */
+class TimerWheel {
+public:
+    TimerWheel() { ip_wheel_init(&wheel, sizeof(TimerKey)); }
+    ~TimerWheel() { ip_wheel_destroy(&wheel); }
+
+    void schedule(const ip_addr_t &hostIp, uint64_t hostId, ur_time_t actualTime, ur_time_t timeout);
+    void advance(ur_time_t actualTime, std::vector<TimerEntry> &expired);
+    void clear();
+    inline uint32_t size() const { return ip_wheel_count(&wheel); }
+
+private:
+    //key of the timer in the wheel
+    struct TimerKey {
+        ip_addr_t hostIp;
+        uint64_t hostId;
+    };
+
+    ip_wheel_t wheel;
+
+    TimerWheel(const TimerWheel &);
+    TimerWheel &operator=(const TimerWheel &);
+};
+
+#endif
@@ -44,6 +44,8 @@
  */
 
 #include "whitelist.h"
+#include <algorithm>
+#include <map>
 
 using namespace std;
 
@@ -73,6 +75,15 @@ void WhitelistedPorts::addSinglePort(uint16_t port)
    addPortRange(port, port);
 }
 
+void WhitelistedPorts::getRanges(std::vector<Range> &ranges) const
+{
+   for (std::set<Range, RangeCompare>::const_iterator it = portRangeList.begin(); it != portRangeList.end(); ++it) {
+      if (it->first <= it->second) {
+         ranges.push_back(*it);
+      }
+   }
+}
+
 // ************************************************************/
 // ************************ IPTRIE  ***************************/
 // ************************************************************/
@@ -100,6 +111,175 @@ IPTrie::~IPTrie()
    }
 }
 
+// ************************************************************/
+// ******************** WHITELIST TRIE  ***********************/
+// ************************************************************/
+
+void WhitelistTrie::collectRules(const IPTrie *node, Rule &rule, std::vector<Rule> &rules)
+{
+   if (node->set) {
+      Rule r = rule;
+      if (node->allPorts) {
+         r.ports.push_back(WhitelistedPorts::Range(0, 65535));
+      } else if (node->whitelistedPorts != NULL) {
+         node->whitelistedPorts->getRanges(r.ports);
+      }
+      if (!r.ports.empty()) {
+         rules.push_back(r);
+      }
+   }
+
+   int byte = rule.prefix / 8;
+   uint8_t bit = 0x80 >> (rule.prefix % 8);
+   rule.prefix++;
+   if (node->left != NULL) {
+      rule.key[byte] &= ~bit;
+      collectRules(node->left, rule, rules);
+   }
+   if (node->right != NULL) {
+      rule.key[byte] |= bit;
+      collectRules(node->right, rule, rules);
+      rule.key[byte] &= ~bit;
+   }
+   rule.prefix--;
+}
+
+uint32_t WhitelistTrie::addPortSet(std::vector<WhitelistedPorts::Range> set)
+{
+   if (set.empty()) {
+      return 0;
+   }
+
+   //merge overlapping and adjacent ranges
+   std::sort(set.begin(), set.end());
+   size_t n = 0;
+   for (size_t i = 1; i < set.size(); i++) {
+      if ((uint32_t) set[i].first <= (uint32_t) set[n].second + 1) {
+         set[n].second = std::max(set[n].second, set[i].second);
+      } else {
+         set[++n] = set[i];
+      }
+   }
+   set.resize(n + 1);
+
+   //entries of most nodes share few port sets
+   for (size_t i = 0; i < portSets.size(); i++) {
+      if (portSets[i].count == set.size() && std::equal(set.begin(), set.end(), ranges.begin() + portSets[i].offset)) {
+         return i + 1;
+      }
+   }
+
+   PortSet portSet;
+   portSet.offset = ranges.size();
+   portSet.count = set.size();
+   ranges.insert(ranges.end(), set.begin(), set.end());
+   portSets.push_back(portSet);
+   return portSets.size();
+}
+
+uint32_t WhitelistTrie::buildNode(std::vector<const Rule *> &rules, int depth, int ipBytes,
+                                  std::vector<WhitelistedPorts::Range> inherited, uint32_t fallback)
+{
+   Node node;
+   memset(node.key, 0, sizeof(node.key));
+   if (!rules.empty()) {
+      memcpy(node.key, rules[0]->key, sizeof(node.key));
+   }
+   node.from = depth;
+   node.fallback = fallback;
+
+   //path compression, skip bytes shared by all rules
+   while (depth < ipBytes - 1 && !rules.empty()) {
+      bool shared = true;
+      for (size_t i = 0; i < rules.size() && shared; i++) {
+         shared = rules[i]->prefix >= 8 * (depth + 1) && rules[i]->key[depth] == node.key[depth];
+      }
+      if (!shared) {
+         break;
+      }
+
+      //rules ending at the end of the skipped byte cover the whole subtree
+      size_t n = 0;
+      for (size_t i = 0; i < rules.size(); i++) {
+         if (rules[i]->prefix == 8 * (depth + 1)) {
+            inherited.insert(inherited.end(), rules[i]->ports.begin(), rules[i]->ports.end());
+         } else {
+            rules[n++] = rules[i];
+         }
+      }
+      rules.resize(n);
+      depth++;
+   }
+
+   node.depth = depth;
+   node.base = entries.size();
+   entries.resize(entries.size() + 256);
+
+   uint32_t index = nodes.size();
+   nodes.push_back(node);
+
+   for (int b = 0; b < 256; b++) {
+      std::vector<WhitelistedPorts::Range> slotPorts = inherited;
+      std::vector<const Rule *> childRules;
+
+      for (size_t i = 0; i < rules.size(); i++) {
+         const Rule *rule = rules[i];
+         if (rule->prefix > 8 * (depth + 1)) {
+            if (rule->key[depth] == b) {
+               childRules.push_back(rule);
+            }
+         } else {
+            int bits = rule->prefix - 8 * depth;
+            uint8_t mask = bits == 0 ? 0 : (uint8_t) (0xFF << (8 - bits));
+            if ((rule->key[depth] & mask) == (b & mask)) {
+               slotPorts.insert(slotPorts.end(), rule->ports.begin(), rule->ports.end());
+            }
+         }
+      }
+
+      uint32_t portSet = addPortSet(slotPorts);
+      uint32_t child = 0;
+      if (!childRules.empty()) {
+         child = buildNode(childRules, depth + 1, ipBytes, slotPorts, portSet);
+      }
+
+      entries[node.base + b].child = child;
+      entries[node.base + b].portSet = portSet;
+   }
+
+   return index;
+}
+
+void WhitelistTrie::build(const IPTrie *ipTrie, int ipBytes)
+{
+   nodes.clear();
+   entries.clear();
+   portSets.clear();
+   ranges.clear();
+
+   std::vector<Rule> rules;
+   Rule rule;
+   memset(rule.key, 0, sizeof(rule.key));
+   rule.prefix = 0;
+   collectRules(ipTrie, rule, rules);
+   if (rules.empty()) {
+      return;
+   }
+
+   //rules of the whole address space (prefix 0) are inherited by the root
+   std::vector<WhitelistedPorts::Range> inherited;
+   std::vector<const Rule *> rest;
+   for (size_t i = 0; i < rules.size(); i++) {
+      if (rules[i].prefix == 0) {
+         inherited.insert(inherited.end(), rules[i].ports.begin(), rules[i].ports.end());
+      } else {
+         rest.push_back(&rules[i]);
+      }
+   }
+
+   buildNode(rest, 0, ipBytes, inherited, addPortSet(inherited));
+}
+
 // ************************************************************/
 // ******************** WHITELISTPARSER  **********************/
 // ************************************************************/
@@ -112,6 +292,7 @@ void WhitelistParser::init(IPTrie *ipv4Src, IPTrie *ipv4Dst, IPTrie *ipv6Src, IP
    this->ipv6Dst = ipv6Dst;
 
    rulesCounter = 0;
+   modified = true;
 }
 
 
@@ -122,9 +303,6 @@ void WhitelistParser::init(IPTrie *ipv4Src, IPTrie *ipv4Dst, IPTrie *ipv6Src, IP
 
 Whitelist::Whitelist()
 {
-   locked = false;
-   wlFileName = NULL;
-
    ipv4Src = new IPTrie();
    ipv4Dst = new IPTrie();
    ipv6Src = new IPTrie();
@@ -141,9 +319,8 @@ Whitelist::~Whitelist()
    delete ipv6Dst;
 }
 
-bool Whitelist::init(char *fileName, bool verbose)
+bool Whitelist::init(const char *fileName, bool verbose)
 {
-   wlFileName = fileName;
    ifstream ifs;
    ifs.open(fileName, ifstream::in);
    if (!ifs.is_open()) {
@@ -153,125 +330,39 @@ bool Whitelist::init(char *fileName, bool verbose)
    parser.parse(&ifs, verbose);
    ifs.close();
 
+   compile();
    return true;
 }
 
 bool Whitelist::isWhitelisted(const ip_addr_t *srcIp, const ip_addr_t *dstIp, uint16_t srcPort, uint16_t dstPort)
 {
-   locked = true;
    bool found = false;
+
+   if (parser.isModified()) {
+      compile();
+   }
 	
    if (ip_is4(srcIp)) {
       //ipv4
       //check src addr first
-      found = trieSearch(ipv4Src, (uint8_t*) srcIp + 8, 4, srcPort);
-      if (found) {
-         locked = false;
-         return true;
-      }
-
-      found = trieSearch(ipv4Dst, (uint8_t*) dstIp + 8, 4, dstPort);
-      if (found) {
-         locked = false;
-         return true;
-      }
+      found = ipv4SrcSearch.search((uint8_t*) srcIp + 8, srcPort)
+              || ipv4DstSearch.search((uint8_t*) dstIp + 8, dstPort);
    } else {        //ipv6
-      //check src addr first
-      found = trieSearch(ipv6Src, (uint8_t*) srcIp, 6, srcPort);
-      if (found) {
-         locked = false;
-         return true;
-      }
-
-      //check dst addr
-      found = trieSearch(ipv6Dst, (uint8_t*) dstIp, 6, dstPort);
-      if (found) {
-         locked = false;
-         return true;
-      }
-   }
-
-   locked = false;
-   return false;
-}
-
-bool Whitelist::trieSearch(IPTrie *ipTrie, uint8_t *ip, uint8_t ipType, uint16_t port)
-{
-   IPTrie *currentNode = ipTrie;
-   int iRange = (ipType == 4) ? 4 : 16; // 32bits : 128bits
-
-   for (int i = 0; i < iRange; i++) {
-      for (int u = 7; u >= 0; u--) {
-         //change last known node
-         if (currentNode->set) {
-            //vsechny porty
-            if (currentNode->allPorts) {
-               return true;
-            }
-            if (currentNode->whitelistedPorts != NULL) {
-               if ((currentNode->whitelistedPorts->findPort(port)) == true) {
-                  return true;
-               }
-            }
-         }
-
-         //search right
-         if (((ip[i] >> u) & 1) > 0) {
-            currentNode = currentNode->right;
-         } else { //search left
-            currentNode = currentNode->left;
-         }
-
-         if (currentNode == NULL) {
-            return false;
-         }
-      }
+      //check src addr first, then dst addr
+      found = ipv6SrcSearch.search((uint8_t*) srcIp, srcPort)
+              || ipv6DstSearch.search((uint8_t*) dstIp, dstPort);
    }
 
-   // last chance to return true
-   if (currentNode->set) {
-      if (currentNode->allPorts) {
-         return true;
-      }
-      if (currentNode->whitelistedPorts != NULL) {
-         if ((currentNode->whitelistedPorts->findPort(port)) == true) {
-            return true;
-         }
-      }
-   }
-
-   return false;
+   return found;
 }
 
-void Whitelist::reloadWhitelist()
+void Whitelist::compile()
 {
-   if (wlFileName != NULL) {
-      ifstream ifs;
-      ifs.open(wlFileName, ifstream::in);
-      if (!ifs.is_open()) {
-         cerr << "Error Whitelist: Cannot open whitelist file!\n";
-         return;
-      }
-
-      delete ipv4Src;
-      delete ipv4Dst;
-      delete ipv6Src;
-      delete ipv6Dst;
-
-      ipv4Src = new IPTrie();
-      ipv4Dst = new IPTrie();
-      ipv6Src = new IPTrie();
-      ipv6Dst = new IPTrie();
-
-      parser.init(ipv4Src, ipv4Dst, ipv6Src, ipv6Dst);
-      parser.parse(&ifs, false);
-
-      ifs.close();
-
-      cout << "Whitelist: Whitelist reloaded successfully.\n";
-   } else {
-      cerr << "Error Whitelist: Whitelist path is not set!\n";
-   }
+   ipv4SrcSearch.build(ipv4Src, 4);
+   ipv4DstSearch.build(ipv4Dst, 4);
+   ipv6SrcSearch.build(ipv6Src, 16);
+   ipv6DstSearch.build(ipv6Dst, 16);
+   parser.clearModified();
 }
 
 // ************************************************************/
@@ -520,6 +611,7 @@ void WhitelistParser::addIPAndSelectedPorts(uint8_t *ip, uint8_t prefix, IPTrie
          }
          
          currentNode->set = true;
+         modified = true;
          rulesCounter++;
       }
    }
@@ -536,6 +628,7 @@ void WhitelistParser::addIPAndSelectedPorts(uint8_t *ip, uint8_t prefix, IPTrie
       }
 
       currentNode->set = true;
+      modified = true;
       rulesCounter++;
    }
 }
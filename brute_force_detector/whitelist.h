@@ -49,10 +49,12 @@
 #include <fstream>
 #include <cstdlib>
 #include <set>  
+#include <vector>
 #include <iostream>
 #include <string>
 #include <unirec/unirec.h>
 #include <csignal> 
+#include <cstring>
 
 
 //WHITELIST PARSER VARIABLES
@@ -98,8 +100,14 @@ public:
     */
    bool findPort(uint16_t port);
 
-private:
    typedef std::pair<uint16_t, uint16_t> Range;
+   /**
+    * @desc Get whitelisted port ranges (sorted)
+    * @param ranges Output vector, ranges are appended
+    */
+   void getRanges(std::vector<Range> &ranges) const;
+
+private:
    struct RangeCompare
    {
       bool operator()(const Range& r1, const Range& r2) const
@@ -133,6 +141,113 @@ public:
    WhitelistedPorts *whitelistedPorts;
 };
 
+// ************************************************************/
+// ******************** WHITELIST TRIE  ***********************/
+// ************************************************************/
+
+/**
+ * @desc Compressed IP trie with 8-bit stride used for searching, compiled from IPTrie
+ *
+ * Nodes and their 256 entries are stored in contiguous arrays. Entries are leaf pushed,
+ * every entry holds the union of ports of all rules covering it, so the search ends
+ * with the last visited node. Chains of nodes with a single child are compressed,
+ * the skipped bytes of the address are compared with the key of the node.
+ */
+class WhitelistTrie {
+public:
+   WhitelistTrie() {}
+
+   /**
+    * @desc Build the trie from rules of the IP trie
+    * @param ipTrie IP trie
+    * @param ipBytes Length of addresses in bytes (4 or 16)
+    */
+   void build(const IPTrie *ipTrie, int ipBytes);
+
+   /**
+    * @desc Find given ip address and port
+    * @param ip IP address as array
+    * @param port Searched port
+    * @return true if port or ip is whitelisted, false otherwise
+    */
+   inline bool search(const uint8_t *ip, uint16_t port) const
+   {
+      if (nodes.empty()) {
+         return false;
+      }
+
+      uint32_t portSet;
+      const Node *node = &nodes[0];
+      while (1) {
+         //compare bytes skipped by path compression
+         if (memcmp(ip + node->from, node->key + node->from, node->depth - node->from) != 0) {
+            portSet = node->fallback;
+            break;
+         }
+
+         const Entry &entry = entries[node->base + ip[node->depth]];
+         if (entry.child == 0) {
+            portSet = entry.portSet;
+            break;
+         }
+         node = &nodes[entry.child];
+      }
+
+      return portSet != 0 && findPort(portSet, port);
+   }
+
+private:
+   struct Entry {
+      uint32_t child;   //index of child node, 0 if none (the root is never a child)
+      uint32_t portSet; //index of port set + 1, 0 if nothing is whitelisted
+   };
+
+   struct Node {
+      uint8_t key[16];  //address bytes on the path to the node
+      uint8_t from;     //first byte of the key not checked by the parent
+      uint8_t depth;    //byte of the address selecting the entry
+      uint32_t base;    //index of the first entry
+      uint32_t fallback; //port set of addresses not matching the key
+   };
+
+   struct Rule {
+      uint8_t key[16];
+      uint8_t prefix;
+      std::vector<WhitelistedPorts::Range> ports;
+   };
+
+   struct PortSet {
+      uint32_t offset; //first range in ranges
+      uint32_t count;
+   };
+
+   std::vector<Node> nodes;
+   std::vector<Entry> entries;
+   std::vector<PortSet> portSets;
+   std::vector<WhitelistedPorts::Range> ranges;
+
+   inline bool findPort(uint32_t portSet, uint16_t port) const
+   {
+      const PortSet &set = portSets[portSet - 1];
+      uint32_t l = set.offset, r = set.offset + set.count;
+      //find the last range starting at or before port
+      while (l < r) {
+         uint32_t m = (l + r) / 2;
+         if (ranges[m].first <= port) {
+            l = m + 1;
+         } else {
+            r = m;
+         }
+      }
+      return l > set.offset && port <= ranges[l - 1].second;
+   }
+
+   void collectRules(const IPTrie *node, Rule &rule, std::vector<Rule> &rules);
+   uint32_t addPortSet(std::vector<WhitelistedPorts::Range> set);
+   uint32_t buildNode(std::vector<const Rule *> &rules, int depth, int ipBytes,
+                      std::vector<WhitelistedPorts::Range> inherited, uint32_t fallback);
+};
+
 // ************************************************************/
 // ******************** WHITELISTPARSER  **********************/
 // ************************************************************/
@@ -145,6 +260,7 @@ public:
    {
       rulesCounter = 0;
       verbose = false;
+      modified = false;
    }
 
    /**
@@ -166,12 +282,19 @@ public:
       return checkPrefixAndPortsAndAdd(ip, direction, prefix, ports);
    }
 
+   /**
+    * @desc Rules were added since the last call of clearModified
+    */
+   bool isModified() const { return modified; }
+   void clearModified() { modified = false; }
+
 private:
    IPTrie *ipv4Src;
    IPTrie *ipv4Dst;
    IPTrie *ipv6Src;
    IPTrie *ipv6Dst;
    bool verbose;
+   bool modified;
    uint32_t rulesCounter;
 
    /**
@@ -208,11 +331,11 @@ public:
    ~Whitelist();
 
    /**
-    * @desc init whitelist
+    * @desc init whitelist, whitelist is reloaded by creating a new instance
     * @param fileName name of whitelist file
     * @param detectionMode detection mode
     */
-   bool init(char *fileName, bool verbose);
+   bool init(const char *fileName, bool verbose);
 
    /**
     * @desc check given record and host source ip if is whitelisted
@@ -221,19 +344,6 @@ public:
     */
    bool isWhitelisted(const ip_addr_t *srcIp, const ip_addr_t *dstIp, uint16_t srcPort, uint16_t dstPort);
 
-   /**
-    * @desc get status for configuration reload
-    */
-   sig_atomic_t isLockedForConfigurationReload()
-   {
-      return locked;
-   }
-
-   /**
-    * @desc reaload whitelist, all previous configuration will be erased
-    */
-   void reloadWhitelist();
-
    /**
     * \brief Only for unit testing!
     *
@@ -245,22 +355,19 @@ public:
    }
 private:
    /**
-    * @desc  Find given ip address and port inside IP trie structure
-    * @param ipTrie IP trie
-    * @param ip IP address as array
-    * @param ipType Type of IP address 4 or 6
-    * @param port Searched port
-    * @return true if port or ip is filtered, false otherwise
+    * @desc Compile IP tries into tries used for searching
     */
-   bool trieSearch(IPTrie *ipTrie, uint8_t *ip, uint8_t ipType, uint16_t port);
+   void compile();
 
    WhitelistParser parser;
+   WhitelistTrie ipv4SrcSearch;
+   WhitelistTrie ipv4DstSearch;
+   WhitelistTrie ipv6SrcSearch;
+   WhitelistTrie ipv6DstSearch;
    IPTrie *ipv4Src;
    IPTrie *ipv4Dst;
    IPTrie *ipv6Src;
    IPTrie *ipv6Dst;
-   sig_atomic_t locked;
-   char *wlFileName;
 };
 
 #endif
\ No newline at end of file
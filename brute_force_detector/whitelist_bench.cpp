@@ -0,0 +1,114 @@
+/**
+ * \file whitelist_bench.cpp
+ * \brief Benchmark of whitelist lookups on synthetic rules
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include "whitelist.h"
+#include <cstdio>
+#include "bench.h"
+
+using namespace std;
+
+#define RULE_CNT 5000
+#define QUERY_CNT (1 << 20)
+#define QUERY_ROUNDS 4
+
+struct Query {
+    ip_addr_t srcIp;
+    ip_addr_t dstIp;
+    uint16_t srcPort;
+    uint16_t dstPort;
+};
+
+int main()
+{
+    Whitelist *wl = new Whitelist();
+    WhitelistParser *parser = wl->getPointerToParser();
+    vector<ip_addr_t> ruleIps(RULE_CNT);
+    vector<Query> queries(QUERY_CNT);
+    volatile int sink = 0;
+
+    // Rules for /16 - /32 prefixes in all directions, some of them only for
+    // selected ports
+    for (int i = 0; i < RULE_CNT; i++) {
+        string ports;
+        ruleIps[i] = ip_from_int((uint32_t) bench_rand());
+        switch (bench_rand() % 3) {
+        case 0:
+            ports = string();
+            break;
+        case 1:
+            ports = "22,23,80,443";
+            break;
+        default:
+            ports = "1000-2000,8080";
+            break;
+        }
+        parser->addSelectedPortRule(ruleIps[i], bench_rand() % 3, 16 + bench_rand() % 17, ports);
+    }
+
+    // Half of the queries hit a rule address
+    for (int i = 0; i < QUERY_CNT; i++) {
+        queries[i].srcIp = (i % 2) ? ruleIps[bench_rand() % RULE_CNT] : ip_from_int((uint32_t) bench_rand());
+        queries[i].dstIp = ip_from_int((uint32_t) bench_rand());
+        queries[i].srcPort = bench_rand() % 65536;
+        queries[i].dstPort = (i % 4) ? 22 : bench_rand() % 65536;
+    }
+
+    // The first query compiles the rules
+    double start = bench_now_ns();
+    unsigned long startAllocations = bench_allocations();
+    sink += wl->isWhitelisted(&queries[0].srcIp, &queries[0].dstIp, queries[0].srcPort, queries[0].dstPort);
+    bench_report("Whitelist compile (per rule)", RULE_CNT, start, startAllocations);
+
+    start = bench_now_ns();
+    startAllocations = bench_allocations();
+    for (int r = 0; r < QUERY_ROUNDS; r++) {
+        for (int i = 0; i < QUERY_CNT; i++) {
+            const Query &q = queries[i];
+            sink += wl->isWhitelisted(&q.srcIp, &q.dstIp, q.srcPort, q.dstPort);
+        }
+    }
+    bench_report("Whitelist::isWhitelisted", (uint64_t) QUERY_ROUNDS * QUERY_CNT, start, startAllocations);
+
+    delete wl;
+    (void) sink;
+    return 0;
+}
@@ -0,0 +1,154 @@
+/**
+ * \file worker.cpp
+ * \brief Detection worker threads, flows are sharded by the attacker IP
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <sched.h>
+#include "worker.h"
+
+Worker::Worker(const bool *enabled, Sender *sender, SharedWhitelist *whitelist)
+    : detector(enabled, sender), whitelist(whitelist), queue(WORKER_QUEUE_SIZE),
+      started(false), done(false), checkpointState(CHECKPOINT_IDLE), sleeping(false)
+{
+}
+
+Worker::~Worker()
+{
+    finish();
+}
+
+bool Worker::start()
+{
+    started = pthread_create(&thread, NULL, run, this) == 0;
+    return started;
+}
+
+void Worker::finish()
+{
+    if(!started)
+        return;
+    done.store(true, std::memory_order_release);
+    wakeUp();
+    pthread_join(thread, NULL);
+    started = false;
+}
+
+void Worker::requestCheckpoint()
+{
+    checkpointState.store(CHECKPOINT_REQUESTED, std::memory_order_release);
+    wakeUp();
+}
+
+bool Worker::takeCheckpoint(CheckpointBuffer &buffer)
+{
+    if(checkpointState.load(std::memory_order_acquire) != CHECKPOINT_READY)
+        return false;
+
+    buffer.swap(checkpoint);
+    checkpoint.clear();
+    checkpointState.store(CHECKPOINT_IDLE, std::memory_order_relaxed);
+    return true;
+}
+
+void Worker::serveCheckpoint()
+{
+    if(checkpointState.load(std::memory_order_acquire) != CHECKPOINT_REQUESTED)
+        return;
+
+    detector.saveCheckpoint(checkpoint);
+    checkpointState.store(CHECKPOINT_READY, std::memory_order_release);
+}
+
+void *Worker::run(void *worker)
+{
+    static_cast<Worker *>(worker)->loop();
+    return NULL;
+}
+
+void Worker::loop()
+{
+    FlowTask task;
+    unsigned idle = 0;
+
+    while(true)
+    {
+        if(queue.pop(task))
+        {
+            idle = 0;
+            //a reloaded configuration is taken between flows
+            if(settings.update())
+                detector.loadConfig(settings.get());
+            detector.processFlow(task.protocol, task.structure, task.direction, whitelist.get());
+            detector.checkTimeouts(task.structure.flowLastSeen);
+            serveCheckpoint();
+            continue;
+        }
+
+        serveCheckpoint();
+
+        //queue is empty
+        if(done.load(std::memory_order_acquire))
+        {
+            if(queue.empty())
+                break;
+        }
+        else if(++idle < WORKER_SPIN)
+            sched_yield();
+        else
+            sleep();
+    }
+}
+
+bool Worker::hasWork()
+{
+    return !queue.empty() || done.load(std::memory_order_acquire) ||
+           checkpointState.load(std::memory_order_acquire) == CHECKPOINT_REQUESTED;
+}
+
+void Worker::sleep()
+{
+    std::unique_lock<std::mutex> lock(wakeLock);
+    sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while(!hasWork())
+        wake.wait(lock);
+    sleeping.store(false, std::memory_order_relaxed);
+}
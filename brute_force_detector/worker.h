@@ -0,0 +1,213 @@
+/**
+ * \file worker.h
+ * \brief Detection worker threads, flows are sharded by the attacker IP
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <pthread.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include "brute_force_detector.h"
+#include "detector.h"
+#include "host_table.h"
+#include "worker_queue.h"
+#include "whitelist.h"
+#include "checkpoint.h"
+
+/**
+ * Whitelist shared by all threads, replaced as a whole
+ *
+ * Readers keep their own reference (WhitelistHandle), the old whitelist is
+ * released by the last thread which used it.
+ */
+class SharedWhitelist {
+
+public:
+    SharedWhitelist() : generation(0) {}
+
+    //takes ownership of the whitelist
+    void publish(Whitelist *whitelist)
+    {
+        std::shared_ptr<Whitelist> newWhitelist(whitelist);
+        std::atomic_store(&current, newWhitelist);
+        generation.fetch_add(1, std::memory_order_release);
+    }
+
+    inline uint64_t getGeneration() const { return generation.load(std::memory_order_acquire); }
+    std::shared_ptr<Whitelist> get() const { return std::atomic_load(&current); }
+
+private:
+    std::shared_ptr<Whitelist> current;
+    std::atomic<uint64_t> generation;
+};
+
+/**
+ * Reference of one thread to the shared whitelist, checks for a new whitelist by one atomic load
+ */
+class WhitelistHandle {
+
+public:
+    WhitelistHandle(SharedWhitelist *shared) : shared(shared), generation(~0ULL) {}
+
+    Whitelist *get()
+    {
+        uint64_t actualGeneration = shared->getGeneration();
+        if(actualGeneration != generation)
+        {
+            generation = actualGeneration;
+            whitelist = shared->get();
+        }
+        return whitelist.get();
+    }
+
+private:
+    SharedWhitelist *shared;
+    uint64_t generation;
+    std::shared_ptr<Whitelist> whitelist;
+};
+
+/**
+ * Flow passed from the receiving thread to a worker
+ */
+struct FlowTask {
+    IRecord::MatchStructure structure;
+    uint8_t protocol;
+    uint8_t direction;
+};
+
+/**
+ * Attacker IP of the flow, all flows of one attacker must be processed by the same worker
+ */
+inline const ip_addr_t &getAttackerIp(const FlowTask &task)
+{
+    return task.direction == FLOW_INCOMING_DIRECTION ? task.structure.srcIp : task.structure.dstIp;
+}
+
+/**
+ * Index of the worker processing flows of the attacker, high bits of the hash are used
+ * because low bits select the slot in the host tables of the worker
+ */
+inline unsigned getWorkerIndex(const ip_addr_t &attackerIp, unsigned workers)
+{
+    return (hashIp(attackerIp) >> 32) % workers;
+}
+
+/**
+ * Thread with its own detector (host maps), whitelist and settings handles, fed by a SPSC queue
+ */
+class Worker {
+
+public:
+    Worker(const bool *enabled, Sender *sender, SharedWhitelist *whitelist);
+    ~Worker();
+
+    bool start();
+
+    //receiving thread only, returns false if the queue is full
+    inline bool push(const FlowTask &task)
+    {
+        if(!queue.push(task))
+            return false;
+        wakeUp();
+        return true;
+    }
+
+    //process the rest of queued flows and end the thread
+    void finish();
+
+    Detector &getDetector() { return detector; }
+
+    //receiving thread only, the worker serializes its hosts between flows
+    void requestCheckpoint();
+
+    //receiving thread only, takes the hosts if the worker has already serialized them
+    bool takeCheckpoint(CheckpointBuffer &buffer);
+
+private:
+    //flows buffered for one worker
+    const static size_t WORKER_QUEUE_SIZE = 16384;
+    //polls of an empty queue before the worker goes to sleep
+    const static unsigned WORKER_SPIN = 64;
+
+    Detector detector;
+    WhitelistHandle whitelist;
+    SettingsHandle settings;
+    SPSCQueue<FlowTask> queue;
+
+    pthread_t thread;
+    bool started;
+    std::atomic<bool> done;
+
+    enum CHECKPOINT_STATE { CHECKPOINT_IDLE, CHECKPOINT_REQUESTED, CHECKPOINT_READY };
+    std::atomic<int> checkpointState;
+    CheckpointBuffer checkpoint;
+
+    /*
+     * Idle worker waits on the condition variable. Setting sleeping and checking the queue
+     * (worker) and pushing and checking sleeping (receiving thread) are ordered by full
+     * fences, so either the worker sees the flow or the receiving thread wakes it up.
+     */
+    std::mutex wakeLock;
+    std::condition_variable wake;
+    std::atomic<bool> sleeping;
+
+    static void *run(void *worker);
+    void loop();
+    void serveCheckpoint();
+    bool hasWork();
+    void sleep();
+
+    inline void wakeUp()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(sleeping.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(wakeLock);
+            wake.notify_one();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ * \file worker_queue.h
+ * \brief Lock-free queues between the receiving thread, detection workers and the sender
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef WORKER_QUEUE_H
+#define WORKER_QUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+/**
+ * Bounded single producer single consumer ring, used for flows from the receiving thread to a worker
+ */
+template <class T>
+class SPSCQueue {
+
+public:
+    //capacity must be a power of two
+    SPSCQueue(size_t capacity) : ring(capacity), mask(capacity - 1), head(0), tail(0) {}
+
+    //producer only, returns false if the queue is full
+    bool push(const T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if(t - head.load(std::memory_order_acquire) > mask)
+            return false;
+        ring[t & mask] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    //consumer only, returns false if the queue is empty
+    bool pop(T &item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if(h == tail.load(std::memory_order_acquire))
+            return false;
+        item = ring[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> ring;
+    size_t mask;
+
+    //head and tail are written by different threads, keep them on separate cache lines
+    std::atomic<size_t> head;
+    char padding[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail;
+};
+
+/**
+ * Unbounded multiple producer single consumer queue (intrusive list with a stub node)
+ *
+ * Producers never wait for each other, push is one exchange. Used for alerts from
+ * workers to the sender, alerts are rare so a node is allocated for every item.
+ */
+template <class T>
+class MPSCQueue {
+
+public:
+    MPSCQueue() : head(&stub), tail(&stub) { stub.next.store(NULL, std::memory_order_relaxed); }
+
+    ~MPSCQueue()
+    {
+        T item;
+        while(pop(item))
+            ;
+        if(tail != &stub)
+            delete tail;
+    }
+
+    //any thread
+    void push(const T &item)
+    {
+        Node *node = new Node(item);
+        Node *prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    /*
+     * Consumer only, returns false if the queue is empty or a producer is in the middle
+     * of push (the item is returned by one of the next calls).
+     */
+    bool pop(T &item)
+    {
+        Node *first = tail->next.load(std::memory_order_acquire);
+        if(first == NULL)
+            return false;
+
+        //first becomes the new stub, its item is taken
+        item = first->item;
+        first->item = T();
+        if(tail != &stub)
+            delete tail;
+        tail = first;
+        return true;
+    }
+
+private:
+    struct Node {
+        Node() {}
+        Node(const T &_item) : item(_item) { next.store(NULL, std::memory_order_relaxed); }
+
+        T item;
+        std::atomic<Node *> next;
+    };
+
+    Node stub;
+    std::atomic<Node *> head; //last pushed node
+    Node *tail;               //consumed node, tail->next is the next item
+};
+
+#endif
@@ -0,0 +1,211 @@
+/**
+ * \file affinity.c
+ * \brief Placement of threads on configured CPUs and of their memory on the local NUMA node.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "affinity.h"
+
+/* Memory policy of mbind (linux/mempolicy.h), libnuma is not needed for the syscall. */
+#define AFFINITY_MPOL_PREFERRED 1
+#define AFFINITY_MPOL_MF_MOVE (1 << 1)
+
+/* Highest supported NUMA node + 1. */
+#define AFFINITY_MAX_NODES 1024
+
+/* CPUs of the list in the order of pinning. */
+static int cpu_list[CPU_SETSIZE];
+static int cpu_count = 0;
+
+/* Number of pinned threads, the next one takes cpu_list[next_cpu % cpu_count]. */
+static unsigned int next_cpu = 0;
+
+int affinity_init(const char *cpus)
+{
+   const char *pos = cpus;
+   cpu_set_t allowed;
+
+   cpu_count = 0;
+   next_cpu = 0;
+   if (cpus == NULL || *cpus == '\0' || strcmp(cpus, "-") == 0) {
+      return 0;
+   }
+   if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+      CPU_ZERO(&allowed);
+   }
+
+   while (*pos != '\0') {
+      char *end;
+      unsigned long first, last, cpu;
+
+      while (*pos == ' ') {
+         pos++;
+      }
+      first = strtoul(pos, &end, 10);
+      if (end == pos) {
+         goto wrong;
+      }
+      last = first;
+      if (*end == '-') {
+         pos = end + 1;
+         last = strtoul(pos, &end, 10);
+         if (end == pos || last < first) {
+            goto wrong;
+         }
+      }
+      if (last >= CPU_SETSIZE) {
+         goto wrong;
+      }
+      for (cpu = first; cpu <= last; cpu++) {
+         if (!CPU_ISSET(cpu, &allowed)) {
+            fprintf(stderr, "Error: CPU %lu of the affinity list \"%s\" is not available.\n", cpu, cpus);
+            cpu_count = 0;
+            return -1;
+         }
+         if (cpu_count < CPU_SETSIZE) {
+            cpu_list[cpu_count++] = (int) cpu;
+         }
+      }
+      while (*end == ' ') {
+         end++;
+      }
+      if (*end == ',') {
+         end++;
+      } else if (*end != '\0') {
+         goto wrong;
+      }
+      pos = end;
+   }
+   return 0;
+
+wrong:
+   fprintf(stderr, "Error: Wrong list of CPUs \"%s\" (expected e.g. \"0-7,16-23\").\n", cpus);
+   cpu_count = 0;
+   return -1;
+}
+
+int affinity_enabled(void)
+{
+   return cpu_count > 0;
+}
+
+/* Take the next CPU of the list into the set, returns the CPU or -1 when threads are not pinned. */
+static int take_cpu(cpu_set_t *set)
+{
+   int cpu;
+   if (cpu_count == 0) {
+      return -1;
+   }
+   cpu = cpu_list[__atomic_fetch_add(&next_cpu, 1, __ATOMIC_RELAXED) % cpu_count];
+   CPU_ZERO(set);
+   CPU_SET(cpu, set);
+   return cpu;
+}
+
+int affinity_pin_self(void)
+{
+   cpu_set_t set;
+   int cpu = take_cpu(&set);
+   if (cpu < 0) {
+      return -1;
+   }
+   if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+      fprintf(stderr, "Warning: Thread could not be pinned to CPU %d.\n", cpu);
+      return -1;
+   }
+   return cpu;
+}
+
+int affinity_thread_create(pthread_t *thread, void *(*start)(void *), void *arg)
+{
+   pthread_attr_t attr;
+   cpu_set_t set;
+   int rc;
+
+   if (take_cpu(&set) < 0) {
+      return pthread_create(thread, NULL, start, arg);
+   }
+   rc = pthread_attr_init(&attr);
+   if (rc != 0) {
+      return rc;
+   }
+   rc = pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+   if (rc == 0) {
+      rc = pthread_create(thread, &attr, start, arg);
+   }
+   pthread_attr_destroy(&attr);
+   return rc;
+}
+
+int affinity_bind_local(void *addr, size_t size)
+{
+   unsigned long mask[AFFINITY_MAX_NODES / (8 * sizeof(unsigned long))];
+   unsigned int cpu, node;
+   uintptr_t page = (uintptr_t) sysconf(_SC_PAGESIZE);
+   uintptr_t start, end;
+
+   if (cpu_count == 0 || addr == NULL || size == 0) {
+      return 0;
+   }
+   if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0 || node >= AFFINITY_MAX_NODES) {
+      return -1;
+   }
+   memset(mask, 0, sizeof(mask));
+   mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+
+   // Whole pages of the memory, pages shared with another allocation are moved too
+   start = (uintptr_t) addr & ~(page - 1);
+   end = ((uintptr_t) addr + size + page - 1) & ~(page - 1);
+   if (syscall(SYS_mbind, start, end - start, AFFINITY_MPOL_PREFERRED, mask, AFFINITY_MAX_NODES,
+               AFFINITY_MPOL_MF_MOVE) != 0) {
+      return -1;
+   }
+   return 0;
+}
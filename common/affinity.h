@@ -0,0 +1,95 @@
+/**
+ * \file affinity.h
+ * \brief Placement of threads on configured CPUs and of their memory on the local NUMA node.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef DETECTORS_COMMON_AFFINITY_H
+#define DETECTORS_COMMON_AFFINITY_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Set the list of CPUs the threads of the module are pinned to, e.g.
+ * "0-7,16-23" (list format of taskset and /sys). Every thread started by
+ * affinity_thread_create (or pinned by affinity_pin_self) takes the next CPU
+ * of the list in turns, so the order of pinning decides the placement. NULL,
+ * empty string or "-" leaves the placement to the kernel. Call it before
+ * starting the threads. Returns 0 on success, -1 on a wrong list (with a
+ * message on stderr).
+ */
+int affinity_init(const char *cpus);
+
+/** Threads are pinned (a list of CPUs was set). */
+int affinity_enabled(void);
+
+/**
+ * Pin the calling thread to the next CPU of the list. Memory the thread
+ * touches first is then allocated on its NUMA node, so pin the thread before
+ * it initializes its tables. Returns the CPU, or -1 when threads are not
+ * pinned or pinning failed.
+ */
+int affinity_pin_self(void);
+
+/**
+ * Create a thread pinned to the next CPU of the list (it runs on the CPU
+ * from its start), the same as pthread_create when threads are not pinned.
+ * Returns 0 on success or an error number of pthread_create.
+ */
+int affinity_thread_create(pthread_t *thread, void *(*start)(void *), void *arg);
+
+/**
+ * Move memory (e.g. a table allocated and initialized by another thread) to
+ * the NUMA node of the calling thread and prefer the node for its pages
+ * allocated later (mbind). Does nothing when threads are not pinned. Returns
+ * 0 on success, -1 when the memory could not be bound (e.g. a kernel without
+ * NUMA), the memory is usable in both cases.
+ */
+int affinity_bind_local(void *addr, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
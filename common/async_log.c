@@ -0,0 +1,355 @@
+/**
+ * \file async_log.c
+ * \brief Asynchronous log writer, records are passed through a lock-free ring to a writer thread.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "async_log.h"
+
+/* Period of checking the ring by the idle writer thread (us). */
+#define ASYNC_LOG_POLL 5000
+
+/* Maximal number of bytes of records written in one batch, the file is flushed after every batch. */
+#define ASYNC_LOG_BATCH (64 * 1024)
+
+/* Minimal capacity of the ring. */
+#define ASYNC_LOG_MIN_CAPACITY 4096
+
+/* Type of the record filling the end of the ring when a record does not fit before its end. */
+#define ASYNC_LOG_PAD 0xffff
+
+/* Size of records is aligned to the size of their header. */
+#define ASYNC_LOG_ALIGN(size) (((size) + sizeof(record_hdr_t) - 1) & ~(uint64_t) (sizeof(record_hdr_t) - 1))
+
+/**
+ * Header of a record in the ring. Committed is set (with release semantics)
+ * when the record is filled, the writer thread zeroes the written records
+ * before it releases their space.
+ */
+typedef struct record_hdr_s {
+   uint32_t size;      /**< Size of the data of the record. */
+   uint16_t type;      /**< Type of the record. */
+   uint8_t committed;  /**< Record is filled. */
+   uint8_t reserved;
+} record_hdr_t;
+
+struct async_log_s {
+   uint64_t head;               /**< Position of the next reservation (shared by producers). */
+   uint8_t pad0[56];
+   uint64_t tail;               /**< Position of the first record not written yet (writer thread). */
+   uint64_t written;            /**< Position up to which the records are written and flushed. */
+   uint64_t dropped;            /**< Number of dropped records. */
+   uint8_t pad1[40];
+   uint8_t *ring;               /**< Ring of records. */
+   uint64_t capacity;           /**< Size of the ring (power of two). */
+   FILE *file;                  /**< Output file (NULL if none). */
+   int close_file;              /**< File was opened by the log. */
+   int sync;                    /**< Sync policy. */
+   async_log_format_t format;   /**< Formatter of binary records. */
+   void *format_arg;            /**< Argument of the formatter. */
+   int stop;                    /**< Writer thread should stop when the ring is empty. */
+   pthread_t thread;            /**< Writer thread. */
+};
+
+static double async_log_now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Write records from the ring, returns number of bytes of the written records. */
+static uint64_t async_log_drain(async_log_t *log)
+{
+   uint64_t tail = log->tail, done = 0, len;
+   record_hdr_t *hdr;
+
+   while (done < ASYNC_LOG_BATCH) {
+      hdr = (record_hdr_t *) (log->ring + (tail & (log->capacity - 1)));
+      if (!__atomic_load_n(&hdr->committed, __ATOMIC_ACQUIRE)) {
+         break;
+      }
+      if (hdr->type == ASYNC_LOG_TEXT) {
+         if (log->file != NULL) {
+            fwrite(hdr + 1, 1, hdr->size, log->file);
+         }
+      } else if (hdr->type != ASYNC_LOG_PAD && log->format != NULL) {
+         log->format(log->file, hdr->type, hdr + 1, hdr->size, log->format_arg);
+      }
+      len = ASYNC_LOG_ALIGN(sizeof(record_hdr_t) + hdr->size);
+      memset(hdr, 0, len);
+      tail += len;
+      done += len;
+      __atomic_store_n(&log->tail, tail, __ATOMIC_RELEASE);
+   }
+   return done;
+}
+
+static void async_log_sync(async_log_t *log)
+{
+   if (log->file != NULL) {
+      fflush(log->file);
+      /* Fails on pipes and terminals, there is nothing to sync then. */
+      fsync(fileno(log->file));
+   }
+}
+
+static void *async_log_writer(void *arg)
+{
+   async_log_t *log = (async_log_t *) arg;
+   double last_sync = async_log_now();
+   int dirty = 0;
+
+   for (;;) {
+      if (async_log_drain(log) > 0) {
+         if (log->file != NULL) {
+            fflush(log->file);
+         }
+         dirty = 1;
+         if (log->sync == ASYNC_LOG_SYNC_BATCH) {
+            async_log_sync(log);
+            dirty = 0;
+         }
+         __atomic_store_n(&log->written, log->tail, __ATOMIC_RELEASE);
+      } else if (__atomic_load_n(&log->stop, __ATOMIC_ACQUIRE) &&
+                 log->tail == __atomic_load_n(&log->head, __ATOMIC_ACQUIRE)) {
+         break;
+      } else {
+         usleep(ASYNC_LOG_POLL);
+      }
+      if (dirty && log->sync > 0 && async_log_now() - last_sync >= log->sync) {
+         async_log_sync(log);
+         last_sync = async_log_now();
+         dirty = 0;
+      }
+   }
+   if (log->sync != ASYNC_LOG_SYNC_NEVER) {
+      async_log_sync(log);
+   } else if (log->file != NULL) {
+      fflush(log->file);
+   }
+   return NULL;
+}
+
+async_log_t *async_log_open(const char *path, uint32_t capacity, int sync,
+                            async_log_format_t format, void *arg)
+{
+   async_log_t *log;
+   uint64_t size = ASYNC_LOG_MIN_CAPACITY;
+
+   while (size < capacity) {
+      size <<= 1;
+   }
+   log = (async_log_t *) calloc(1, sizeof(async_log_t));
+   if (log == NULL) {
+      fprintf(stderr, "Error: Not enough memory for log.\n");
+      return NULL;
+   }
+   log->ring = (uint8_t *) calloc(size, 1);
+   if (log->ring == NULL) {
+      fprintf(stderr, "Error: Not enough memory for log.\n");
+      free(log);
+      return NULL;
+   }
+   log->capacity = size;
+   log->sync = sync;
+   log->format = format;
+   log->format_arg = arg;
+
+   if (path != NULL && strcmp(path, "-") == 0) {
+      log->file = stdout;
+   } else if (path != NULL) {
+      log->file = fopen(path, "a");
+      if (log->file == NULL) {
+         fprintf(stderr, "Error: Could not open log file %s: %s.\n", path, strerror(errno));
+         free(log->ring);
+         free(log);
+         return NULL;
+      }
+      log->close_file = 1;
+   }
+
+   if (pthread_create(&log->thread, NULL, async_log_writer, log) != 0) {
+      fprintf(stderr, "Error: Could not create log writer thread.\n");
+      if (log->close_file) {
+         fclose(log->file);
+      }
+      free(log->ring);
+      free(log);
+      return NULL;
+   }
+   return log;
+}
+
+void *async_log_reserve(async_log_t *log, uint16_t type, uint32_t size)
+{
+   uint64_t len = ASYNC_LOG_ALIGN(sizeof(record_hdr_t) + (uint64_t) size);
+   uint64_t head, tail, pos, contiguous, total;
+   record_hdr_t *hdr;
+
+   if (len > log->capacity / 2) {
+      __atomic_fetch_add(&log->dropped, 1, __ATOMIC_RELAXED);
+      return NULL;
+   }
+
+   head = __atomic_load_n(&log->head, __ATOMIC_RELAXED);
+   do {
+      pos = head & (log->capacity - 1);
+      contiguous = log->capacity - pos;
+      /* Record which does not fit before the end of the ring starts at its beginning. */
+      total = len <= contiguous ? len : contiguous + len;
+      tail = __atomic_load_n(&log->tail, __ATOMIC_ACQUIRE);
+      if (head + total - tail > log->capacity) {
+         __atomic_fetch_add(&log->dropped, 1, __ATOMIC_RELAXED);
+         return NULL;
+      }
+   } while (!__atomic_compare_exchange_n(&log->head, &head, head + total, 1,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+   if (total != len) {
+      hdr = (record_hdr_t *) (log->ring + pos);
+      hdr->size = contiguous - sizeof(record_hdr_t);
+      hdr->type = ASYNC_LOG_PAD;
+      __atomic_store_n(&hdr->committed, 1, __ATOMIC_RELEASE);
+      pos = 0;
+   }
+   hdr = (record_hdr_t *) (log->ring + pos);
+   hdr->size = size;
+   hdr->type = type;
+   return hdr + 1;
+}
+
+void async_log_commit(async_log_t *log, void *record)
+{
+   (void) log;
+   __atomic_store_n(&((record_hdr_t *) record - 1)->committed, 1, __ATOMIC_RELEASE);
+}
+
+int async_log_write(async_log_t *log, uint16_t type, const void *data, uint32_t size)
+{
+   void *record = async_log_reserve(log, type, size);
+
+   if (record == NULL) {
+      return -1;
+   }
+   memcpy(record, data, size);
+   async_log_commit(log, record);
+   return 0;
+}
+
+int async_log_vprintf(async_log_t *log, const char *format, va_list args)
+{
+   char line[ASYNC_LOG_LINE], *buffer;
+   va_list copy;
+   int len, ret;
+
+   va_copy(copy, args);
+   len = vsnprintf(line, sizeof(line), format, copy);
+   va_end(copy);
+   if (len < 0) {
+      return -1;
+   }
+   if ((size_t) len < sizeof(line)) {
+      return async_log_write(log, ASYNC_LOG_TEXT, line, len);
+   }
+
+   buffer = (char *) malloc(len + 1);
+   if (buffer == NULL) {
+      __atomic_fetch_add(&log->dropped, 1, __ATOMIC_RELAXED);
+      return -1;
+   }
+   vsnprintf(buffer, len + 1, format, args);
+   ret = async_log_write(log, ASYNC_LOG_TEXT, buffer, len);
+   free(buffer);
+   return ret;
+}
+
+int async_log_printf(async_log_t *log, const char *format, ...)
+{
+   va_list args;
+   int ret;
+
+   va_start(args, format);
+   ret = async_log_vprintf(log, format, args);
+   va_end(args);
+   return ret;
+}
+
+uint64_t async_log_dropped(const async_log_t *log)
+{
+   return __atomic_load_n(&log->dropped, __ATOMIC_RELAXED);
+}
+
+void async_log_flush(async_log_t *log)
+{
+   uint64_t target = __atomic_load_n(&log->head, __ATOMIC_ACQUIRE);
+
+   while (__atomic_load_n(&log->written, __ATOMIC_ACQUIRE) < target) {
+      usleep(ASYNC_LOG_POLL / 5);
+   }
+}
+
+void async_log_close(async_log_t *log)
+{
+   uint64_t dropped;
+
+   if (log == NULL) {
+      return;
+   }
+   __atomic_store_n(&log->stop, 1, __ATOMIC_RELEASE);
+   pthread_join(log->thread, NULL);
+
+   dropped = async_log_dropped(log);
+   if (dropped > 0) {
+      fprintf(stderr, "Warning: %llu log records were dropped, the writer could not keep up.\n",
+              (unsigned long long) dropped);
+   }
+   if (log->close_file) {
+      fclose(log->file);
+   }
+   free(log->ring);
+   free(log);
+}
@@ -0,0 +1,121 @@
+/**
+ * \file async_log.h
+ * \brief Asynchronous log writer, records are passed through a lock-free ring to a writer thread.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef DETECTORS_COMMON_ASYNC_LOG_H
+#define DETECTORS_COMMON_ASYNC_LOG_H
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Type of text records, they are written to the file as they are. Binary records use types from 1. */
+#define ASYNC_LOG_TEXT 0
+
+/* Sync policies (positive value is the minimal number of seconds between two fsyncs). */
+#define ASYNC_LOG_SYNC_NEVER (-1) /* file is only flushed after every batch */
+#define ASYNC_LOG_SYNC_BATCH 0    /* file is synced after every batch */
+
+/* Default capacity of the ring (bytes). */
+#define ASYNC_LOG_DEFAULT_CAPACITY (1 << 20)
+
+/* Maximal length of a record formatted by async_log_printf on stack, longer ones are allocated. */
+#define ASYNC_LOG_LINE 1024
+
+typedef struct async_log_s async_log_t;
+
+/**
+ * Formats a binary record, called by the writer thread for records of types
+ * other than ASYNC_LOG_TEXT. File is NULL when the log was opened without one
+ * (e.g. when the records say to which file they belong).
+ */
+typedef void (*async_log_format_t)(FILE *file, uint16_t type, const void *data, uint32_t size, void *arg);
+
+/**
+ * Open the log and start its writer thread.
+ * Path is opened for appending, "-" means standard output and NULL no file.
+ * Capacity of the ring is rounded up to a power of two, a record may take at
+ * most half of it. Format (with its argument arg) may be NULL when only text
+ * records are written. Returns NULL on error (with a message on stderr).
+ */
+async_log_t *async_log_open(const char *path, uint32_t capacity, int sync,
+                            async_log_format_t format, void *arg);
+
+/**
+ * Reserve a record of given type and size in the ring, the record has to be
+ * filled and passed to async_log_commit. Records are written in order of
+ * their reservation. Returns NULL when the ring is full, the record is dropped
+ * and counted. Any thread may write to the log.
+ */
+void *async_log_reserve(async_log_t *log, uint16_t type, uint32_t size);
+
+/** Pass a filled record returned by async_log_reserve to the writer thread. */
+void async_log_commit(async_log_t *log, void *record);
+
+/** Copy a record to the log. Returns 0 on success, -1 when it was dropped. */
+int async_log_write(async_log_t *log, uint16_t type, const void *data, uint32_t size);
+
+/** Format a text record. Returns 0 on success, -1 when it was dropped. */
+int async_log_printf(async_log_t *log, const char *format, ...)
+   __attribute__((format(printf, 2, 3)));
+int async_log_vprintf(async_log_t *log, const char *format, va_list args);
+
+/** Number of records dropped because the ring was full. */
+uint64_t async_log_dropped(const async_log_t *log);
+
+/** Wait until all records reserved before the call are written (and flushed). */
+void async_log_flush(async_log_t *log);
+
+/**
+ * Write all the records, sync the file, stop the writer thread and free the
+ * log. Nothing may write to the log any longer. Accepts NULL.
+ */
+void async_log_close(async_log_t *log);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
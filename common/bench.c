@@ -0,0 +1,130 @@
+/**
+ * \file bench.c
+ * \brief Helpers of micro-benchmarks (make bench): inputs, timing and allocation counting.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include "bench.h"
+
+/* Allocation functions of glibc, the interposed ones call them. */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+static uint64_t rand_state = 88172645463325252ULL;
+
+/* Modules may allocate from their own threads. */
+static unsigned long allocations = 0;
+
+static void count_allocation(void)
+{
+   __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size)
+{
+   count_allocation();
+   return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+   count_allocation();
+   return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+   count_allocation();
+   return __libc_realloc(ptr, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+   count_allocation();
+   return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+   void *p;
+
+   if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0) {
+      return EINVAL;
+   }
+   count_allocation();
+   p = __libc_memalign(alignment, size);
+   if (p == NULL) {
+      return ENOMEM;
+   }
+   *memptr = p;
+   return 0;
+}
+
+uint64_t bench_rand(void)
+{
+   rand_state ^= rand_state << 13;
+   rand_state ^= rand_state >> 7;
+   rand_state ^= rand_state << 17;
+   return rand_state;
+}
+
+double bench_now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+unsigned long bench_allocations(void)
+{
+   return __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+}
+
+void bench_report(const char *name, uint64_t ops, double start, unsigned long start_allocations)
+{
+   printf("%-32s %10lu ops %10.1f ns/op %8.3f allocs/op\n", name, (unsigned long) ops,
+          (bench_now_ns() - start) / ops, (double) (bench_allocations() - start_allocations) / ops);
+}
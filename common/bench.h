@@ -0,0 +1,79 @@
+/**
+ * \file bench.h
+ * \brief Helpers of micro-benchmarks (make bench): inputs, timing and allocation counting.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef DETECTORS_COMMON_BENCH_H
+#define DETECTORS_COMMON_BENCH_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Next number of a fixed xorshift sequence, so that the inputs are the same
+ * on every run and every platform.
+ */
+uint64_t bench_rand(void);
+
+/** Monotonic time in nanoseconds. */
+double bench_now_ns(void);
+
+/**
+ * Number of allocations done by the program so far. The benchmark library
+ * interposes malloc, calloc, realloc and the aligned allocation functions,
+ * so allocations of C modules are counted as well as operator new (which
+ * allocates by malloc). It is linked only to benchmark programs.
+ */
+unsigned long bench_allocations(void);
+
+/**
+ * Print the time and allocations per operation of a kernel measured since
+ * start (bench_now_ns()) and start_allocations (bench_allocations()).
+ */
+void bench_report(const char *name, uint64_t ops, double start, unsigned long start_allocations);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DETECTORS_COMMON_BENCH_H */
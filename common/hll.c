@@ -0,0 +1,201 @@
+/**
+ * \file hll.c
+ * \brief HyperLogLog counting of distinct keys over registers owned by the caller.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <string.h>
+#include <math.h>
+#include "hll.h"
+
+#define HASH_MULT 0x9e3779b97f4a7c15ULL
+
+/* Size of the header of serialized registers (bits and width). */
+#define HLL_HEADER 2
+
+uint64_t hll_hash(const void *key, size_t size)
+{
+   const uint8_t *p = (const uint8_t *) key;
+   uint64_t h, w[2] = { 0, 0 };
+
+   if (size == 16) {
+      memcpy(w, p, 16);
+      h = w[0] * HASH_MULT ^ w[1];
+   } else {
+      h = HASH_MULT * size;
+      for (; size >= 8; size -= 8, p += 8) {
+         memcpy(w, p, 8);
+         h = (h ^ w[0]) * HASH_MULT;
+      }
+      w[0] = 0;
+      memcpy(w, p, size);
+      h ^= w[0];
+   }
+
+   h ^= h >> 33;
+   h *= 0xff51afd7ed558ccdULL;
+   h ^= h >> 33;
+   h *= 0xc4ceb9fe1a85ec53ULL;
+   h ^= h >> 33;
+   return h;
+}
+
+static inline uint8_t max_rank(const hll_t *hll)
+{
+   return hll->width == 8 ? 64 - hll->bits + 1 : HLL_MAX_RANK4;
+}
+
+static inline void set_register(const hll_t *hll, uint32_t index, uint8_t rank)
+{
+   if (hll->width == 8) {
+      hll->registers[index] = rank;
+   } else {
+      int shift = (index & 1) * 4;
+      uint8_t *reg = &hll->registers[index / 2];
+      *reg = (uint8_t) ((*reg & ~(0xf << shift)) | (rank << shift));
+   }
+}
+
+uint8_t hll_add(const hll_t *hll, uint64_t hash, uint8_t *old)
+{
+   uint32_t index = (uint32_t) (hash >> (64 - hll->bits));
+   /* Position of the first 1 bit of the rest of the hash, the guard bit limits it */
+   uint8_t rank = (uint8_t) (__builtin_clzll((hash << hll->bits) | (1ULL << (hll->bits - 1))) + 1);
+   uint8_t current = hll_get(hll, index);
+
+   if (rank > max_rank(hll)) {
+      rank = max_rank(hll);
+   }
+   if (rank <= current) {
+      return 0;
+   }
+   set_register(hll, index, rank);
+   if (old != NULL) {
+      *old = current;
+   }
+   return rank;
+}
+
+uint32_t hll_estimate_sum(uint8_t bits, double inv_sum, uint32_t zeros)
+{
+   const double m = (double) (1U << bits);
+   double estimate = 0.7213 / (1.0 + 1.079 / m) * m * m / inv_sum;
+
+   /* Small range correction (linear counting) */
+   if (estimate <= 2.5 * m && zeros != 0) {
+      estimate = m * log(m / zeros);
+   }
+   return (uint32_t) (estimate + 0.5);
+}
+
+uint32_t hll_estimate(const hll_t *hll)
+{
+   uint32_t m = 1U << hll->bits;
+   uint32_t zeros = 0;
+   double sum = 0.0;
+   uint32_t i;
+
+   for (i = 0; i < m; i++) {
+      uint8_t rank = hll_get(hll, i);
+      sum += ldexp(1.0, -rank);
+      if (rank == 0) {
+         zeros++;
+      }
+   }
+   return hll_estimate_sum(hll->bits, sum, zeros);
+}
+
+int hll_merge(const hll_t *hll, const hll_t *other)
+{
+   uint32_t m = 1U << hll->bits;
+   uint32_t i;
+
+   if (hll->bits != other->bits || hll->width != other->width) {
+      return -1;
+   }
+   for (i = 0; i < m; i++) {
+      uint8_t rank = hll_get(other, i);
+      if (rank > hll_get(hll, i)) {
+         set_register(hll, i, rank);
+      }
+   }
+   return 0;
+}
+
+void hll_clear(const hll_t *hll)
+{
+   memset(hll->registers, 0, hll_size(hll->bits, hll->width));
+}
+
+size_t hll_save(const hll_t *hll, void *buffer, size_t size)
+{
+   size_t len = hll_size(hll->bits, hll->width);
+   uint8_t *out = (uint8_t *) buffer;
+
+   if (size < HLL_HEADER + len) {
+      return 0;
+   }
+   out[0] = hll->bits;
+   out[1] = hll->width;
+   memcpy(out + HLL_HEADER, hll->registers, len);
+   return HLL_HEADER + len;
+}
+
+size_t hll_load(const hll_t *hll, const void *buffer, size_t size)
+{
+   size_t len = hll_size(hll->bits, hll->width);
+   const uint8_t *in = (const uint8_t *) buffer;
+   hll_t loaded;
+   uint32_t i;
+
+   if (size < HLL_HEADER + len || in[0] != hll->bits || in[1] != hll->width) {
+      return 0;
+   }
+   /* Ranks over the maximum can't be produced by hll_add */
+   loaded = hll_view((uint8_t *) in + HLL_HEADER, hll->bits, hll->width);
+   if (hll->width == 8) {
+      for (i = 0; i < len; i++) {
+         if (hll_get(&loaded, i) > max_rank(hll)) {
+            return 0;
+         }
+      }
+   }
+   memcpy(hll->registers, in + HLL_HEADER, len);
+   return HLL_HEADER + len;
+}
@@ -0,0 +1,145 @@
+/**
+ * \file hll.h
+ * \brief HyperLogLog counting of distinct keys over registers owned by the caller.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef DETECTORS_COMMON_HLL_H
+#define DETECTORS_COMMON_HLL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Range of the number of index bits, there are 2^bits registers. */
+#define HLL_MIN_BITS 4
+#define HLL_MAX_BITS 16
+
+/* Ranks of registers of 4 bits saturate at this value. */
+#define HLL_MAX_RANK4 15
+
+/**
+ * View of HyperLogLog registers stored by the caller (inline in a record,
+ * in a vector etc.). Registers have 8 bits, or 4 bits (two in a byte) where
+ * the size of records matters, their ranks saturate at HLL_MAX_RANK4 which
+ * is enough for 2^bits * 2^15 distinct keys. The standard error is about
+ * 1.04 / sqrt(2^bits).
+ *
+ * The register of a hash is given by its top bits and the rank by the
+ * number of leading zeros of the rest, so sketches of the same bits and
+ * width are merged by taking the maximum of each register.
+ */
+typedef struct hll_s {
+   uint8_t *registers; /**< 2^bits registers of width bits each, zeroed when empty. */
+   uint8_t bits; /**< Number of index bits (HLL_MIN_BITS to HLL_MAX_BITS). */
+   uint8_t width; /**< Bits of a register, 8 or 4. */
+} hll_t;
+
+/** Size of registers in bytes. */
+static inline size_t hll_size(uint8_t bits, uint8_t width)
+{
+   return ((size_t) 1 << bits) * width / 8;
+}
+
+/** View of registers. */
+static inline hll_t hll_view(uint8_t *registers, uint8_t bits, uint8_t width)
+{
+   hll_t hll;
+
+   hll.registers = registers;
+   hll.bits = bits;
+   hll.width = width;
+   return hll;
+}
+
+/** Value of a register. */
+static inline uint8_t hll_get(const hll_t *hll, uint32_t index)
+{
+   if (hll->width == 8) {
+      return hll->registers[index];
+   }
+   return (hll->registers[index / 2] >> ((index & 1) * 4)) & 0xf;
+}
+
+/** 64 bit hash of a key (16 B of ip_addr_t are hashed by two multiplications). */
+uint64_t hll_hash(const void *key, size_t size);
+
+/**
+ * Add a hash to the registers. Returns the new rank of its register if it
+ * was increased (and the previous one in old if it's not NULL), 0 if the
+ * registers did not change.
+ */
+uint8_t hll_add(const hll_t *hll, uint64_t hash, uint8_t *old);
+
+/**
+ * Estimate from the sum of 2^-register over all registers and the number
+ * of zero registers, for callers which keep them up to date on hll_add.
+ */
+uint32_t hll_estimate_sum(uint8_t bits, double inv_sum, uint32_t zeros);
+
+/** Estimated number of distinct hashes added to the registers. */
+uint32_t hll_estimate(const hll_t *hll);
+
+/** Add all hashes of other to hll. Returns -1 if bits or width differ. */
+int hll_merge(const hll_t *hll, const hll_t *other);
+
+/** Remove all hashes (zero the registers). */
+void hll_clear(const hll_t *hll);
+
+/**
+ * Serialize the registers (bits, width and registers) to the buffer.
+ * Returns the number of bytes written, 0 if the buffer is too small.
+ */
+size_t hll_save(const hll_t *hll, void *buffer, size_t size);
+
+/**
+ * Load registers serialized by hll_save, bits and width of hll have to
+ * match the serialized ones. Returns the number of bytes read, 0 if the
+ * data are invalid (the registers are not changed then).
+ */
+size_t hll_load(const hll_t *hll, const void *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DETECTORS_COMMON_HLL_H */
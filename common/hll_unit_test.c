@@ -0,0 +1,210 @@
+/**
+ * \file hll_unit_test.c
+ * \brief Unit test for the HyperLogLog counting of distinct keys
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "hll.h"
+
+static int fail_counter = 0;
+
+#define CHECK(cond, msg) { if (!(cond)) { fprintf(stderr, "FAIL: %s\n", msg); fail_counter++; } }
+
+/** Add keys first to last - 1 (as 16 B addresses) to the registers. */
+static void add_keys(const hll_t *hll, uint64_t first, uint64_t last)
+{
+   uint64_t key[2];
+
+   for (; first < last; first++) {
+      key[0] = first;
+      key[1] = first * 31 + 7;
+      hll_add(hll, hll_hash(key, sizeof(key)), NULL);
+   }
+}
+
+/** Relative error of the estimate of n keys. */
+static double error(const hll_t *hll, uint64_t n)
+{
+   return fabs((double) hll_estimate(hll) - (double) n) / (double) n;
+}
+
+/** Estimates of 8 and 4 bit registers are within 4 standard errors */
+static void test_accuracy(void)
+{
+   static const uint64_t counts[] = { 100, 1000, 10000, 100000, 1000000 };
+   static const uint8_t bits[] = { 10, 6, 12 };
+   static const uint8_t widths[] = { 8, 4, 8 };
+   uint8_t registers[1 << 12];
+   char msg[100];
+   size_t i, j;
+
+   for (j = 0; j < sizeof(bits); j++) {
+      hll_t hll = hll_view(registers, bits[j], widths[j]);
+      double limit = 4 * 1.04 / sqrt((double) (1U << bits[j]));
+      uint64_t added = 0;
+
+      hll_clear(&hll);
+      CHECK(hll_estimate(&hll) == 0, "empty registers");
+      for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+         add_keys(&hll, added, counts[i]);
+         added = counts[i];
+         snprintf(msg, sizeof(msg), "estimate of %lu keys with %u bits of width %u (error %.3f)",
+                  (unsigned long) counts[i], bits[j], widths[j], error(&hll, counts[i]));
+         CHECK(error(&hll, counts[i]) <= limit, msg);
+      }
+      // Keys added again do not change the registers
+      add_keys(&hll, 0, 1000);
+      CHECK(error(&hll, added) <= limit, "duplicate keys not counted");
+   }
+
+   // Few keys are counted almost exactly by linear counting
+   {
+      hll_t hll = hll_view(registers, 10, 8);
+      hll_clear(&hll);
+      add_keys(&hll, 0, 10);
+      CHECK(hll_estimate(&hll) == 10, "small cardinality");
+   }
+}
+
+/** hll_add reports changes of registers and ranks of 4 bits saturate */
+static void test_add(void)
+{
+   uint8_t registers[1 << 10];
+   hll_t hll = hll_view(registers, 10, 8);
+   hll_t small = hll_view(registers, 4, 4);
+   uint8_t old = 0xff, rank;
+
+   hll_clear(&hll);
+   // Top bits select the register, leading zeros of the rest give the rank
+   rank = hll_add(&hll, (5ULL << 54) | (1ULL << 50), &old);
+   CHECK(rank == 4 && old == 0 && hll_get(&hll, 5) == 4, "rank of hash");
+   CHECK(hll_add(&hll, (5ULL << 54) | (1ULL << 52), NULL) == 0, "lower rank does not change register");
+   CHECK(hll_add(&hll, 5ULL << 54, &old) == 64 - 10 + 1 && old == 4, "rank of zero rest");
+
+   hll_clear(&small);
+   CHECK(hll_add(&small, 3ULL << 60, NULL) == HLL_MAX_RANK4 && hll_get(&small, 3) == HLL_MAX_RANK4, "4 bit rank saturates");
+   CHECK(hll_get(&small, 2) == 0 && (registers[1] & 0x0f) == 0, "neighbour register of 4 bits untouched");
+   CHECK(hll_size(4, 4) == 8 && hll_size(10, 8) == 1024, "size of registers");
+}
+
+/** Merged registers estimate the union */
+static void test_merge(void)
+{
+   static const uint8_t widths[] = { 8, 4 };
+   uint8_t a_regs[1 << 10], b_regs[1 << 10], u_regs[1 << 10];
+   size_t w;
+
+   for (w = 0; w < sizeof(widths); w++) {
+      hll_t a = hll_view(a_regs, 10, widths[w]);
+      hll_t b = hll_view(b_regs, 10, widths[w]);
+      hll_t u = hll_view(u_regs, 10, widths[w]);
+      hll_t other = hll_view(b_regs, 9, widths[w]);
+
+      hll_clear(&a);
+      hll_clear(&b);
+      hll_clear(&u);
+      add_keys(&a, 0, 60000);
+      add_keys(&b, 40000, 100000);
+      add_keys(&u, 0, 100000);
+
+      CHECK(hll_merge(&a, &b) == 0, "merge");
+      // Merge of overlapping sets equals registers of their union
+      CHECK(memcmp(a_regs, u_regs, hll_size(10, widths[w])) == 0, "merged registers are registers of union");
+      CHECK(error(&a, 100000) <= 4 * 1.04 / 32, "estimate of union");
+      CHECK(hll_merge(&a, &other) == -1, "merge of different bits rejected");
+      other = hll_view(b_regs, 10, 12 - widths[w]);
+      CHECK(hll_merge(&a, &other) == -1, "merge of different width rejected");
+   }
+}
+
+/** Serialized registers are loaded with the same estimate */
+static void test_serialization(void)
+{
+   uint8_t regs[1 << 10], loaded_regs[1 << 10], buffer[2 + (1 << 10)];
+   hll_t hll = hll_view(regs, 10, 8);
+   hll_t loaded = hll_view(loaded_regs, 10, 8);
+   hll_t small = hll_view(regs, 10, 4);
+   size_t len;
+
+   hll_clear(&hll);
+   add_keys(&hll, 0, 5000);
+   len = hll_save(&hll, buffer, sizeof(buffer));
+   CHECK(len == sizeof(buffer), "size of serialized registers");
+   CHECK(hll_save(&hll, buffer, sizeof(buffer) - 1) == 0, "save to short buffer");
+
+   memset(loaded_regs, 0xff, sizeof(loaded_regs));
+   CHECK(hll_load(&loaded, buffer, len) == len, "load");
+   CHECK(memcmp(regs, loaded_regs, sizeof(regs)) == 0 && hll_estimate(&loaded) == hll_estimate(&hll), "loaded registers");
+
+   // Invalid data leave the registers unchanged
+   hll_clear(&loaded);
+   CHECK(hll_load(&loaded, buffer, len - 1) == 0, "short data rejected");
+   CHECK(hll_load(&small, buffer, len) == 0, "different width rejected");
+   buffer[0] = 11;
+   CHECK(hll_load(&loaded, buffer, len) == 0, "different bits rejected");
+   buffer[0] = 10;
+   buffer[2] = 64;
+   CHECK(hll_load(&loaded, buffer, len) == 0, "invalid rank rejected");
+   CHECK(hll_estimate(&loaded) == 0, "registers unchanged by invalid data");
+
+   // Sketch of 4 bit registers
+   hll_clear(&small);
+   add_keys(&small, 0, 300);
+   len = hll_save(&small, buffer, sizeof(buffer));
+   loaded = hll_view(loaded_regs, 10, 4);
+   CHECK(len == 2 + 512 && hll_load(&loaded, buffer, len) == len && hll_estimate(&loaded) == hll_estimate(&small), "4 bit registers");
+}
+
+int main(void)
+{
+   test_accuracy();
+   test_add();
+   test_merge();
+   test_serialization();
+
+   if (fail_counter > 0) {
+      fprintf(stderr, "%d test(s) failed\n", fail_counter);
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,360 @@
+/**
+ * \file ip_table.c
+ * \brief Open addressing hash table with inline values keyed by IP addresses (or other short keys).
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ip_table.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Alignment of values stored in slots. */
+#define IP_TABLE_ALIGN 8
+
+/* Minimal number of slots, at least one group. */
+#define IP_TABLE_MIN_SIZE IP_TABLE_GROUP
+
+#define HASH_MULT 0x9e3779b97f4a7c15ULL
+
+static inline uint64_t hash_key(const ip_table_t *table, const void *key)
+{
+   const uint8_t *p = (const uint8_t *) key;
+   uint32_t n = table->key_size;
+   uint64_t h = HASH_MULT * n;
+   uint64_t w;
+   uint32_t w32;
+
+   for (; n >= 8; n -= 8, p += 8) {
+      memcpy(&w, p, 8);
+      h = (h ^ w) * HASH_MULT;
+      h ^= h >> 32;
+   }
+   if (n >= 4) {
+      memcpy(&w32, p, 4);
+      h = (h ^ w32) * HASH_MULT;
+      n -= 4;
+      p += 4;
+   }
+   for (; n > 0; n--, p++) {
+      h = (h ^ *p) * HASH_MULT;
+   }
+
+   h ^= h >> 33;
+   h *= 0xff51afd7ed558ccdULL;
+   h ^= h >> 33;
+   h *= 0xc4ceb9fe1a85ec53ULL;
+   h ^= h >> 33;
+   return h;
+}
+
+/* Keys of the usual sizes are compared without a call of memcmp. */
+static inline int key_equal(const void *a, const void *b, uint32_t key_size)
+{
+   uint64_t a64[2], b64[2];
+   uint32_t a32, b32;
+
+   switch (key_size) {
+   case 4:
+      memcpy(&a32, a, 4);
+      memcpy(&b32, b, 4);
+      return a32 == b32;
+   case 8:
+      memcpy(a64, a, 8);
+      memcpy(b64, b, 8);
+      return a64[0] == b64[0];
+   case 16:
+      memcpy(a64, a, 16);
+      memcpy(b64, b, 16);
+      return ((a64[0] ^ b64[0]) | (a64[1] ^ b64[1])) == 0;
+   default:
+      return memcmp(a, b, key_size) == 0;
+   }
+}
+
+#ifdef __SSE2__
+/* Bitmask of slots of the group with given tag. */
+static inline uint32_t group_match(const uint8_t *group, uint8_t tag)
+{
+   __m128i tags = _mm_loadu_si128((const __m128i *) group);
+   return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(tags, _mm_set1_epi8((char) tag)));
+}
+
+/* Bitmask of empty or deleted slots of the group (only these have the highest bit set). */
+static inline uint32_t group_free(const uint8_t *group)
+{
+   return (uint32_t) _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) group));
+}
+#else
+static inline uint32_t group_match(const uint8_t *group, uint8_t tag)
+{
+   uint32_t mask = 0;
+   int i;
+
+   for (i = 0; i < IP_TABLE_GROUP; ++i) {
+      mask |= (uint32_t) (group[i] == tag) << i;
+   }
+   return mask;
+}
+
+static inline uint32_t group_free(const uint8_t *group)
+{
+   uint32_t mask = 0;
+   int i;
+
+   for (i = 0; i < IP_TABLE_GROUP; ++i) {
+      mask |= (uint32_t) (group[i] >> 7) << i;
+   }
+   return mask;
+}
+#endif
+
+/* Set tag of a slot, tags of the first group are repeated after the last slot. */
+static inline void set_tag(ip_table_t *table, uint32_t index, uint8_t tag)
+{
+   table->tags[index] = tag;
+   table->tags[((index - IP_TABLE_GROUP) & (table->size - 1)) + IP_TABLE_GROUP] = tag;
+}
+
+/**
+ * Find slot of the key, returns table->size if the key isn't in the table.
+ * Groups are probed quadratically until a group with an empty slot.
+ */
+static uint32_t find_slot(const ip_table_t *table, const void *key, uint64_t hash)
+{
+   uint32_t mask = table->size - 1;
+   uint32_t pos = (uint32_t) (hash >> 7) & mask;
+   uint8_t tag = (uint8_t) (hash & 0x7f);
+   uint32_t step = 0;
+   uint32_t match;
+
+   for (;;) {
+      const uint8_t *group = table->tags + pos;
+      for (match = group_match(group, tag); match != 0; match &= match - 1) {
+         uint32_t index = (pos + __builtin_ctz(match)) & mask;
+         if (key_equal(ip_table_key(table, index), key, table->key_size)) {
+            return index;
+         }
+      }
+      if (group_match(group, IP_TABLE_EMPTY) != 0) {
+         return table->size;
+      }
+      step += IP_TABLE_GROUP;
+      pos = (pos + step) & mask;
+   }
+}
+
+/* First empty or deleted slot on the probe sequence of the hash. */
+static uint32_t find_free(const ip_table_t *table, uint64_t hash)
+{
+   uint32_t mask = table->size - 1;
+   uint32_t pos = (uint32_t) (hash >> 7) & mask;
+   uint32_t step = 0;
+   uint32_t match;
+
+   while ((match = group_free(table->tags + pos)) == 0) {
+      step += IP_TABLE_GROUP;
+      pos = (pos + step) & mask;
+   }
+   return (pos + __builtin_ctz(match)) & mask;
+}
+
+static int alloc_slots(ip_table_t *table, uint32_t size)
+{
+   table->tags = (uint8_t *) malloc(size + IP_TABLE_GROUP);
+   table->slots = (uint8_t *) malloc((size_t) size * table->slot_size);
+   if (table->tags == NULL || table->slots == NULL) {
+      free(table->tags);
+      free(table->slots);
+      return -1;
+   }
+   memset(table->tags, IP_TABLE_EMPTY, size + IP_TABLE_GROUP);
+   table->size = size;
+   return 0;
+}
+
+ip_table_t *ip_table_init(uint32_t size, uint32_t key_size, uint32_t value_size)
+{
+   ip_table_t *table;
+   uint32_t table_size = IP_TABLE_MIN_SIZE;
+
+   if (key_size == 0 || key_size > IP_TABLE_MAX_KEY) {
+      return NULL;
+   }
+   table = (ip_table_t *) calloc(1, sizeof(ip_table_t));
+   if (table == NULL) {
+      return NULL;
+   }
+
+   while (table_size < size) {
+      table_size *= 2;
+   }
+   table->key_size = key_size;
+   table->value_size = value_size;
+   table->value_offset = (key_size + IP_TABLE_ALIGN - 1) / IP_TABLE_ALIGN * IP_TABLE_ALIGN;
+   table->slot_size = (table->value_offset + value_size + IP_TABLE_ALIGN - 1) / IP_TABLE_ALIGN * IP_TABLE_ALIGN;
+
+   if (alloc_slots(table, table_size) != 0) {
+      free(table);
+      return NULL;
+   }
+   return table;
+}
+
+/**
+ * Move used slots to new arrays of given size (drops deleted slots).
+ */
+static int rehash(ip_table_t *table, uint32_t size)
+{
+   uint8_t *old_tags = table->tags;
+   uint8_t *old_slots = table->slots;
+   uint32_t old_size = table->size;
+   uint32_t i;
+
+   if (alloc_slots(table, size) != 0) {
+      table->tags = old_tags;
+      table->slots = old_slots;
+      return -1;
+   }
+
+   for (i = 0; i < old_size; ++i) {
+      if ((old_tags[i] & 0x80) == 0) {
+         const uint8_t *slot = old_slots + (size_t) i * table->slot_size;
+         uint32_t j = find_free(table, hash_key(table, slot));
+         set_tag(table, j, old_tags[i]);
+         memcpy(ip_table_key(table, j), slot, table->slot_size);
+      }
+   }
+
+   free(old_tags);
+   free(old_slots);
+   table->deleted = 0;
+   return 0;
+}
+
+void *ip_table_search(const ip_table_t *table, const void *key)
+{
+   uint32_t index = find_slot(table, key, hash_key(table, key));
+   return index == table->size ? NULL : ip_table_value(table, index);
+}
+
+void *ip_table_search_or_insert(ip_table_t *table, const void *key)
+{
+   uint64_t hash = hash_key(table, key);
+   uint32_t index = find_slot(table, key, hash);
+   uint8_t *slot;
+
+   if (index != table->size) {
+      return ip_table_value(table, index);
+   }
+
+   /* Keep used and deleted slots under 7/8 of the table, grow only when
+    * used slots take over a half of it (otherwise just drop deleted ones). */
+   if ((uint64_t) (table->count + table->deleted + 1) * 8 > (uint64_t) table->size * 7) {
+      if (rehash(table, table->count * 2 >= table->size ? table->size * 2 : table->size) != 0) {
+         return NULL;
+      }
+   }
+
+   index = find_free(table, hash);
+   if (table->tags[index] == IP_TABLE_DELETED) {
+      table->deleted--;
+   }
+   set_tag(table, index, (uint8_t) (hash & 0x7f));
+   slot = ip_table_key(table, index);
+   memset(slot, 0, table->slot_size);
+   memcpy(slot, key, table->key_size);
+   table->count++;
+   return ip_table_value(table, index);
+}
+
+int ip_table_remove(ip_table_t *table, const void *key)
+{
+   uint32_t index = find_slot(table, key, hash_key(table, key));
+
+   if (index == table->size) {
+      return 0;
+   }
+   ip_table_delete(table, index);
+   return 1;
+}
+
+uint32_t ip_table_next(const ip_table_t *table, uint32_t index)
+{
+   for (++index; index < table->size; ++index) {
+      if (ip_table_used(table, index)) {
+         break;
+      }
+   }
+   return index;
+}
+
+uint32_t ip_table_first(const ip_table_t *table)
+{
+   if (ip_table_used(table, 0)) {
+      return 0;
+   }
+   return ip_table_next(table, 0);
+}
+
+void ip_table_delete(ip_table_t *table, uint32_t index)
+{
+   set_tag(table, index, IP_TABLE_DELETED);
+   table->count--;
+   table->deleted++;
+}
+
+void ip_table_clean(ip_table_t *table)
+{
+   memset(table->tags, IP_TABLE_EMPTY, table->size + IP_TABLE_GROUP);
+   table->count = 0;
+   table->deleted = 0;
+}
+
+void ip_table_destroy(ip_table_t *table)
+{
+   if (table != NULL) {
+      free(table->tags);
+      free(table->slots);
+      free(table);
+   }
+}
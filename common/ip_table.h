@@ -0,0 +1,148 @@
+/**
+ * \file ip_table.h
+ * \brief Open addressing hash table with inline values keyed by IP addresses (or other short keys).
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef DETECTORS_COMMON_IP_TABLE_H
+#define DETECTORS_COMMON_IP_TABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Number of slots whose tags are compared at once (one SSE2 register). */
+#define IP_TABLE_GROUP 16
+
+/* Maximal size of a key in bytes. */
+#define IP_TABLE_MAX_KEY 32
+
+/* Tags of slots, used slots have the lowest 7 bits of the hash of their key. */
+#define IP_TABLE_EMPTY 0x80
+#define IP_TABLE_DELETED 0xfe
+
+/**
+ * Hash table with keys of a fixed size (4 B for IPv4, 16 B for IPv6 or
+ * ip_addr_t, 8 B for IPv4 with a port etc.) and values of a fixed size stored
+ * inline next to the keys. Every slot has a one byte tag with a part of the
+ * hash of its key, searching compares the tags of a whole group of slots by
+ * one SIMD instruction and only the keys with a matching tag are compared.
+ *
+ * Pointers to values are valid until the next insert, which may move them.
+ * Deleted slots are only marked, so deleting during iteration is safe.
+ */
+typedef struct ip_table_s {
+   uint8_t *tags; /**< Tags of slots, the first group is repeated at the end. */
+   uint8_t *slots; /**< Array of slots (key followed by value). */
+   uint32_t size; /**< Number of slots (power of 2). */
+   uint32_t count; /**< Number of used slots. */
+   uint32_t deleted; /**< Number of deleted slots. */
+   uint32_t key_size; /**< Size of key stored in each slot. */
+   uint32_t value_size; /**< Size of value stored in each slot. */
+   uint32_t value_offset; /**< Offset of value in a slot (key size aligned). */
+   uint32_t slot_size; /**< Size of slot including key and value. */
+} ip_table_t;
+
+/**
+ * Create table with given initial number of slots (rounded up to power of 2),
+ * size of keys (at most IP_TABLE_MAX_KEY) and size of values (can be 0 for
+ * sets). Returns NULL on memory error or invalid key size.
+ */
+ip_table_t *ip_table_init(uint32_t size, uint32_t key_size, uint32_t value_size);
+
+/** Find value of the key, NULL if the key is not in the table. */
+void *ip_table_search(const ip_table_t *table, const void *key);
+
+/**
+ * Find value of the key or insert a zeroed one. The table grows when it's
+ * 7/8 full, so pointers to values are valid only until the next insert.
+ * Returns NULL on memory error.
+ */
+void *ip_table_search_or_insert(ip_table_t *table, const void *key);
+
+/** Delete the key if it is in the table. Returns 1 if it was deleted, 0 otherwise. */
+int ip_table_remove(ip_table_t *table, const void *key);
+
+/** Index of the first used slot, table->size if the table is empty. */
+uint32_t ip_table_first(const ip_table_t *table);
+
+/** Index of the next used slot after index, table->size at the end. */
+uint32_t ip_table_next(const ip_table_t *table, uint32_t index);
+
+/** Whether the slot is used. */
+static inline int ip_table_used(const ip_table_t *table, uint32_t index)
+{
+   return (table->tags[index] & 0x80) == 0;
+}
+
+/** Key stored in used slot. */
+static inline void *ip_table_key(const ip_table_t *table, uint32_t index)
+{
+   return table->slots + (size_t) index * table->slot_size;
+}
+
+/** Value stored in used slot. */
+static inline void *ip_table_value(const ip_table_t *table, uint32_t index)
+{
+   return table->slots + (size_t) index * table->slot_size + table->value_offset;
+}
+
+/** Index of the slot of a value returned by the table. */
+static inline uint32_t ip_table_index(const ip_table_t *table, const void *value)
+{
+   return (uint32_t) (((const uint8_t *) value - table->value_offset - table->slots) / table->slot_size);
+}
+
+/** Delete used slot (it's safe during iteration). */
+void ip_table_delete(ip_table_t *table, uint32_t index);
+
+/** Delete all slots. */
+void ip_table_clean(ip_table_t *table);
+
+/** Free the table. */
+void ip_table_destroy(ip_table_t *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DETECTORS_COMMON_IP_TABLE_H */
@@ -0,0 +1,260 @@
+/**
+ * \file ip_table_unit_test.c
+ * \brief Unit test for the hash table of IP addresses
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ip_table.h"
+
+static int fail_counter = 0;
+
+#define CHECK(cond, msg) { if (!(cond)) { fprintf(stderr, "FAIL: %s\n", msg); fail_counter++; } }
+
+#define KEYS 100000
+
+/** Value stored with the keys of the table. */
+typedef struct value_s {
+   uint32_t key;
+   uint32_t inserted;
+} value_t;
+
+/** Number of used slots found by iteration. */
+static uint32_t iterate_count(const ip_table_t *table)
+{
+   uint32_t count = 0;
+   uint32_t i;
+
+   for (i = ip_table_first(table); i < table->size; i = ip_table_next(table, i)) {
+      count++;
+   }
+   return count;
+}
+
+/** Insert, find and grow */
+static void test_insert(void)
+{
+   ip_table_t *table = ip_table_init(16, sizeof(uint32_t), sizeof(value_t));
+   uint32_t key, found = 0;
+   value_t *value;
+   int ok = 1;
+
+   CHECK(table != NULL, "init");
+   if (table == NULL) {
+      return;
+   }
+   for (key = 0; key < KEYS; key++) {
+      value = (value_t *) ip_table_search_or_insert(table, &key);
+      if (value == NULL || value->key != 0 || value->inserted != 0) {
+         ok = 0;
+         continue;
+      }
+      value->key = key;
+      value->inserted = 1;
+   }
+   CHECK(ok, "inserted values are zeroed");
+   CHECK(table->count == KEYS, "count after insert");
+   CHECK(table->size >= KEYS && (table->size & (table->size - 1)) == 0, "table grew to power of 2");
+   CHECK((uint64_t) table->count * 8 <= (uint64_t) table->size * 7, "table under 7/8 full");
+
+   // All keys survived the rehashes with their values
+   for (key = 0; key < KEYS; key++) {
+      value = (value_t *) ip_table_search(table, &key);
+      if (value != NULL && value->key == key && value->inserted == 1) {
+         found++;
+      }
+   }
+   CHECK(found == KEYS, "all keys found after grow");
+   for (key = KEYS; key < 2 * KEYS; key++) {
+      if (ip_table_search(table, &key) != NULL) {
+         break;
+      }
+   }
+   CHECK(key == 2 * KEYS, "missing keys not found");
+
+   // Insert of an existing key returns its value
+   key = 42;
+   value = (value_t *) ip_table_search_or_insert(table, &key);
+   CHECK(value != NULL && value->key == 42 && table->count == KEYS, "insert of existing key");
+   CHECK(ip_table_index(table, value) < table->size && ip_table_key(table, ip_table_index(table, value)) != NULL &&
+         *(uint32_t *) ip_table_key(table, ip_table_index(table, value)) == 42, "index of value");
+   CHECK(iterate_count(table) == KEYS, "iteration visits all keys");
+
+   ip_table_clean(table);
+   CHECK(table->count == 0 && iterate_count(table) == 0, "clean");
+   key = 1;
+   CHECK(ip_table_search(table, &key) == NULL, "cleaned key not found");
+   ip_table_destroy(table);
+}
+
+/** Delete keeps the probe sequences of other keys and deleted slots are reused */
+static void test_delete(void)
+{
+   ip_table_t *table = ip_table_init(1024, sizeof(uint32_t), sizeof(value_t));
+   uint32_t key, found = 0, deleted;
+   uint32_t size;
+
+   CHECK(table != NULL, "init");
+   if (table == NULL) {
+      return;
+   }
+   // Fill the table close to its limit so that probe sequences cross groups
+   for (key = 0; key < 880; key++) {
+      ((value_t *) ip_table_search_or_insert(table, &key))->key = key;
+   }
+   size = table->size;
+   CHECK(size == 1024, "no grow under 7/8");
+
+   for (key = 0; key < 880; key += 2) {
+      CHECK(ip_table_remove(table, &key) == 1, "remove existing key");
+   }
+   key = 0;
+   CHECK(ip_table_remove(table, &key) == 0, "remove deleted key");
+   key = 5000;
+   CHECK(ip_table_remove(table, &key) == 0, "remove missing key");
+   CHECK(table->count == 440 && table->deleted == 440, "counts after remove");
+
+   for (key = 0; key < 880; key++) {
+      value_t *value = (value_t *) ip_table_search(table, &key);
+      if (key % 2 == 0 ? value == NULL : (value != NULL && value->key == key)) {
+         found++;
+      }
+   }
+   CHECK(found == 880, "remaining keys found behind deleted slots");
+
+   // Reinserted keys take deleted slots
+   deleted = table->deleted;
+   key = 0;
+   CHECK(ip_table_search_or_insert(table, &key) != NULL, "reinsert");
+   CHECK(table->deleted == deleted - 1 || table->deleted == 0, "deleted slot reused");
+
+   // Deleting during iteration visits every key once
+   found = 0;
+   for (key = ip_table_first(table); key < table->size; key = ip_table_next(table, key)) {
+      ip_table_delete(table, key);
+      found++;
+   }
+   CHECK(found == 441 && table->count == 0 && iterate_count(table) == 0, "delete during iteration");
+   ip_table_destroy(table);
+}
+
+/** Churn of inserts and deletes rehashes without growing */
+static void test_rehash(void)
+{
+   ip_table_t *table = ip_table_init(256, sizeof(uint32_t), 0);
+   uint32_t key, i, found = 0;
+
+   CHECK(table != NULL, "init");
+   if (table == NULL) {
+      return;
+   }
+   // At most 100 live keys, the deleted slots are dropped by rehash in place
+   for (key = 0; key < 100000; key++) {
+      ip_table_search_or_insert(table, &key);
+      if (key >= 100) {
+         i = key - 100;
+         ip_table_remove(table, &i);
+      }
+   }
+   CHECK(table->count == 100, "count after churn");
+   CHECK(table->size == 256, "table did not grow on churn");
+   CHECK((uint64_t) (table->count + table->deleted) * 8 <= (uint64_t) table->size * 7, "deleted slots dropped");
+   for (key = 100000 - 100; key < 100000; key++) {
+      if (ip_table_search(table, &key) != NULL) {
+         found++;
+      }
+   }
+   CHECK(found == 100, "live keys found after churn");
+   ip_table_destroy(table);
+}
+
+/** Keys of other sizes (ip_addr_t and odd sizes compared by memcmp) */
+static void test_key_sizes(void)
+{
+   static const uint32_t sizes[] = { 5, 8, 16, IP_TABLE_MAX_KEY };
+   uint8_t key[IP_TABLE_MAX_KEY];
+   uint32_t s, i, found;
+
+   CHECK(ip_table_init(16, 0, 4) == NULL, "key size 0 rejected");
+   CHECK(ip_table_init(16, IP_TABLE_MAX_KEY + 1, 4) == NULL, "too long key rejected");
+
+   for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+      ip_table_t *table = ip_table_init(16, sizes[s], sizeof(uint32_t));
+      CHECK(table != NULL, "init");
+      if (table == NULL) {
+         continue;
+      }
+      CHECK(table->value_offset % 8 == 0 && table->slot_size % 8 == 0, "aligned values");
+      memset(key, 0, sizeof(key));
+      for (i = 0; i < 1000; i++) {
+         // Keys differ only in their last byte or two
+         key[sizes[s] - 1] = (uint8_t) i;
+         key[sizes[s] - 2] = (uint8_t) (i >> 8);
+         *(uint32_t *) ip_table_search_or_insert(table, key) = i;
+      }
+      found = 0;
+      for (i = 0; i < 1000; i++) {
+         uint32_t *value;
+         key[sizes[s] - 1] = (uint8_t) i;
+         key[sizes[s] - 2] = (uint8_t) (i >> 8);
+         value = (uint32_t *) ip_table_search(table, key);
+         if (value != NULL && *value == i) {
+            found++;
+         }
+      }
+      CHECK(found == 1000 && table->count == 1000, "keys of all sizes found");
+      ip_table_destroy(table);
+   }
+}
+
+int main(void)
+{
+   test_insert();
+   test_delete();
+   test_rehash();
+   test_key_sizes();
+
+   if (fail_counter > 0) {
+      fprintf(stderr, "%d test(s) failed\n", fail_counter);
+      return 1;
+   }
+   return 0;
+}
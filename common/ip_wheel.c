@@ -0,0 +1,256 @@
+/**
+ * \file ip_wheel.c
+ * \brief Hierarchical timer wheel of keys of an ip_table (expiration of idle records).
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ip_wheel.h"
+#include "ip_table.h"
+
+/* Number of ticks covered by all levels. */
+#define IP_WHEEL_SPAN (1ULL << (IP_WHEEL_BITS * IP_WHEEL_LEVELS))
+
+#define SLOT_INITIAL_SIZE 8
+
+int ip_wheel_init(ip_wheel_t *wheel, uint32_t key_size)
+{
+   if (key_size == 0 || key_size > IP_TABLE_MAX_KEY) {
+      return -1;
+   }
+   memset(wheel, 0, sizeof(ip_wheel_t));
+   wheel->key_size = key_size;
+   wheel->timer_size = (sizeof(uint64_t) + key_size + 7) / 8 * 8;
+   return 0;
+}
+
+static int slot_push(ip_wheel_slot_t *slot, const uint8_t *timer, uint32_t timer_size)
+{
+   if (slot->count == slot->size) {
+      uint32_t size = slot->size == 0 ? SLOT_INITIAL_SIZE : slot->size * 2;
+      uint8_t *timers = (uint8_t *) realloc(slot->timers, (size_t) size * timer_size);
+      if (timers == NULL) {
+         return -1;
+      }
+      slot->timers = timers;
+      slot->size = size;
+   }
+   memcpy(slot->timers + (size_t) slot->count * timer_size, timer, timer_size);
+   slot->count++;
+   return 0;
+}
+
+/**
+ * Put timer to the slot of the lowest level which covers its expiration, or
+ * to the expired timers. Timers beyond the span of the wheel are put to the
+ * last slot of the highest level and placed again when it is cascaded.
+ */
+static int place(ip_wheel_t *wheel, const uint8_t *timer)
+{
+   uint64_t expires;
+   uint64_t delta;
+   int level;
+
+   memcpy(&expires, timer, sizeof(expires));
+   if (expires <= wheel->now) {
+      return slot_push(&wheel->expired, timer, wheel->timer_size);
+   }
+
+   delta = expires - wheel->now;
+   if (delta >= IP_WHEEL_SPAN) {
+      delta = IP_WHEEL_SPAN - 1;
+      expires = wheel->now + delta;
+   }
+   for (level = 0; level < IP_WHEEL_LEVELS - 1 && delta >= (1ULL << (IP_WHEEL_BITS * (level + 1))); level++);
+   return slot_push(&wheel->levels[level][(expires >> (IP_WHEEL_BITS * level)) & (IP_WHEEL_SLOTS - 1)],
+                    timer, wheel->timer_size);
+}
+
+/**
+ * Place all timers of the slot again (to lower levels). The array of the
+ * slot is kept for reuse unless some timer got back to the same slot.
+ */
+static int replace_slot(ip_wheel_t *wheel, ip_wheel_slot_t *slot)
+{
+   ip_wheel_slot_t old = *slot;
+   uint32_t i;
+   int ret = 0;
+
+   if (old.count == 0) {
+      return 0;
+   }
+   memset(slot, 0, sizeof(ip_wheel_slot_t));
+   for (i = 0; i < old.count; ++i) {
+      if (place(wheel, old.timers + (size_t) i * wheel->timer_size) != 0) {
+         /* The timer is lost */
+         wheel->count--;
+         ret = -1;
+      }
+   }
+
+   if (slot->timers == NULL) {
+      slot->timers = old.timers;
+      slot->size = old.size;
+   } else {
+      free(old.timers);
+   }
+   return ret;
+}
+
+/* Move timers of the slot to the expired ones. */
+static int expire_slot(ip_wheel_t *wheel, ip_wheel_slot_t *slot)
+{
+   uint32_t i;
+
+   if (slot->count == 0) {
+      return 0;
+   }
+   if (wheel->expired.count == 0) {
+      /* Just swap the arrays */
+      ip_wheel_slot_t tmp = wheel->expired;
+      wheel->expired = *slot;
+      *slot = tmp;
+      return 0;
+   }
+   for (i = 0; i < slot->count; ++i) {
+      if (slot_push(&wheel->expired, slot->timers + (size_t) i * wheel->timer_size, wheel->timer_size) != 0) {
+         /* The remaining timers are lost */
+         wheel->count -= slot->count - i;
+         slot->count = 0;
+         return -1;
+      }
+   }
+   slot->count = 0;
+   return 0;
+}
+
+/* Move time of the wheel by one tick. */
+static int tick(ip_wheel_t *wheel)
+{
+   int level;
+
+   wheel->now++;
+   for (level = IP_WHEEL_LEVELS - 1; level > 0; level--) {
+      if ((wheel->now & ((1ULL << (IP_WHEEL_BITS * level)) - 1)) == 0) {
+         uint32_t index = (wheel->now >> (IP_WHEEL_BITS * level)) & (IP_WHEEL_SLOTS - 1);
+         if (replace_slot(wheel, &wheel->levels[level][index]) != 0) {
+            return -1;
+         }
+      }
+   }
+   return expire_slot(wheel, &wheel->levels[0][wheel->now & (IP_WHEEL_SLOTS - 1)]);
+}
+
+/* Jump to time now, all timers are placed again. */
+static int jump(ip_wheel_t *wheel, uint64_t now)
+{
+   int level, i;
+
+   wheel->now = now;
+   for (level = 0; level < IP_WHEEL_LEVELS; level++) {
+      for (i = 0; i < IP_WHEEL_SLOTS; i++) {
+         if (replace_slot(wheel, &wheel->levels[level][i]) != 0) {
+            return -1;
+         }
+      }
+   }
+   return 0;
+}
+
+int ip_wheel_add(ip_wheel_t *wheel, const void *key, uint64_t expires)
+{
+   uint8_t timer[sizeof(uint64_t) + IP_TABLE_MAX_KEY + 8];
+
+   memcpy(timer, &expires, sizeof(expires));
+   memcpy(timer + sizeof(expires), key, wheel->key_size);
+   if (place(wheel, timer) != 0) {
+      return -1;
+   }
+   wheel->count++;
+   return 0;
+}
+
+int ip_wheel_pop(ip_wheel_t *wheel, uint64_t now, void *key, uint64_t *expires)
+{
+   const uint8_t *timer;
+
+   while (wheel->expired_pos == wheel->expired.count) {
+      wheel->expired.count = 0;
+      wheel->expired_pos = 0;
+      if (wheel->now >= now) {
+         return 0;
+      }
+      if (wheel->count == 0) {
+         /* Nothing to move */
+         wheel->now = now;
+         return 0;
+      }
+      /* Timers which can't be moved on memory error are lost, the time
+       * still moves. */
+      if (now - wheel->now >= IP_WHEEL_SPAN) {
+         jump(wheel, now);
+      } else {
+         tick(wheel);
+      }
+   }
+
+   timer = wheel->expired.timers + (size_t) wheel->expired_pos * wheel->timer_size;
+   memcpy(expires, timer, sizeof(uint64_t));
+   memcpy(key, timer + sizeof(uint64_t), wheel->key_size);
+   wheel->expired_pos++;
+   wheel->count--;
+   return 1;
+}
+
+void ip_wheel_destroy(ip_wheel_t *wheel)
+{
+   int level, i;
+
+   for (level = 0; level < IP_WHEEL_LEVELS; level++) {
+      for (i = 0; i < IP_WHEEL_SLOTS; i++) {
+         free(wheel->levels[level][i].timers);
+      }
+   }
+   free(wheel->expired.timers);
+   memset(wheel->levels, 0, sizeof(wheel->levels));
+   memset(&wheel->expired, 0, sizeof(wheel->expired));
+   wheel->count = 0;
+   wheel->expired_pos = 0;
+}
@@ -0,0 +1,124 @@
+/**
+ * \file ip_wheel.h
+ * \brief Hierarchical timer wheel of keys of an ip_table (expiration of idle records).
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef DETECTORS_COMMON_IP_WHEEL_H
+#define DETECTORS_COMMON_IP_WHEEL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Slots of one level are 2^IP_WHEEL_BITS, level L has slots 2^(IP_WHEEL_BITS * L) ticks long. */
+#define IP_WHEEL_BITS 6
+#define IP_WHEEL_SLOTS (1 << IP_WHEEL_BITS)
+
+/* Number of levels, timers further than 2^(IP_WHEEL_BITS * IP_WHEEL_LEVELS) ticks are kept in the last level. */
+#define IP_WHEEL_LEVELS 4
+
+/** Array of timers (expiration time followed by key). */
+typedef struct ip_wheel_slot_s {
+   uint8_t *timers;
+   uint32_t count;
+   uint32_t size;
+} ip_wheel_slot_t;
+
+/**
+ * Timer wheel storing copies of keys with expiration times (in ticks of
+ * the caller, usually seconds of flow time). Adding a timer and taking an
+ * expired one are O(1), timers are moved to lower levels once per slot of
+ * the upper level.
+ *
+ * Timers can't be removed or changed. The usual use is to keep the time of
+ * the scheduled timer in the record too: when the timer expires, the record
+ * is looked up and the timer is ignored when the record was deleted or
+ * scheduled again (the times differ), or the record is scheduled again when
+ * it was modified in the meantime.
+ *
+ * The host timers of brute_force_detector are kept in it too. The other
+ * wheels of the modules are not of this kind: timers of sip_bf_detector are
+ * embedded in its objects and removed with them, hoststatsnemea collects one
+ * ring of seconds bounded by its timeouts from two threads under a lock and
+ * amplification_detection links the entries of its history table, which
+ * move to another second on every flow.
+ */
+typedef struct ip_wheel_s {
+   ip_wheel_slot_t levels[IP_WHEEL_LEVELS][IP_WHEEL_SLOTS];
+   ip_wheel_slot_t expired; /**< Expired timers not taken yet. */
+   uint32_t expired_pos; /**< Index of the next expired timer. */
+   uint64_t now; /**< Time of the wheel, all timers up to it are expired. */
+   uint32_t count; /**< Number of timers in the wheel (including expired). */
+   uint32_t key_size;
+   uint32_t timer_size;
+} ip_wheel_t;
+
+/** Initialize empty wheel for keys of given size, returns -1 for invalid size. */
+int ip_wheel_init(ip_wheel_t *wheel, uint32_t key_size);
+
+/**
+ * Add timer of the key expiring at given time (times in the past expire at
+ * the next ip_wheel_pop). Returns 0 on success and -1 on memory error.
+ */
+int ip_wheel_add(ip_wheel_t *wheel, const void *key, uint64_t expires);
+
+/**
+ * Take one timer which expired at time now (the time of the wheel only
+ * moves forward). The key is copied to key and its time to expires.
+ * Returns 1 if a timer was taken, 0 if there is no expired timer.
+ */
+int ip_wheel_pop(ip_wheel_t *wheel, uint64_t now, void *key, uint64_t *expires);
+
+/** Number of timers in the wheel. */
+static inline uint32_t ip_wheel_count(const ip_wheel_t *wheel)
+{
+   return wheel->count;
+}
+
+/** Free all timers. */
+void ip_wheel_destroy(ip_wheel_t *wheel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DETECTORS_COMMON_IP_WHEEL_H */
@@ -0,0 +1,206 @@
+/**
+ * \file ip_wheel_unit_test.c
+ * \brief Unit test for the timer wheel of keys
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ip_wheel.h"
+
+static int fail_counter = 0;
+
+#define CHECK(cond, msg) { if (!(cond)) { fprintf(stderr, "FAIL: %s\n", msg); fail_counter++; } }
+
+/* Number of ticks covered by all levels of the wheel. */
+#define SPAN (1ULL << (IP_WHEEL_BITS * IP_WHEEL_LEVELS))
+
+/** Key of the timers (like ip_addr_t). */
+typedef struct timer_key_s {
+   uint64_t id;
+   uint64_t check;
+} timer_key_t;
+
+/**
+ * Move the wheel tick by tick up to end, every timer has to be taken exactly
+ * at its expiration time and with its key. Returns the number of timers taken.
+ */
+static uint32_t pop_ticks(ip_wheel_t *wheel, uint64_t start, uint64_t end, uint64_t step)
+{
+   uint64_t now, expires;
+   uint32_t taken = 0;
+   int on_time = 1, keys = 1;
+   timer_key_t key;
+
+   for (now = start; now <= end; now += step) {
+      while (ip_wheel_pop(wheel, now, &key, &expires)) {
+         // Timers expire in the step of their expiration, never sooner
+         if (expires > now || expires + step <= now) {
+            on_time = 0;
+         }
+         if (key.check != ~key.id || key.id != expires) {
+            keys = 0;
+         }
+         taken++;
+      }
+   }
+   CHECK(on_time, "timers expire on time");
+   CHECK(keys, "keys of timers");
+   return taken;
+}
+
+static int add(ip_wheel_t *wheel, uint64_t expires)
+{
+   timer_key_t key = { expires, ~expires };
+
+   return ip_wheel_add(wheel, &key, expires);
+}
+
+/** Timers of all levels are cascaded down and expire exactly on time */
+static void test_cascade(void)
+{
+   ip_wheel_t wheel;
+   uint64_t expires;
+   uint32_t added = 0;
+   int ok = 1;
+   timer_key_t key;
+
+   CHECK(ip_wheel_init(&wheel, 0) == -1, "key size 0 rejected");
+   CHECK(ip_wheel_init(&wheel, sizeof(timer_key_t)) == 0, "init");
+
+   // Timers in all levels (slots of 1, 64, 4096 and 262144 ticks)
+   for (expires = 1; expires < 300000; expires = expires * 5 / 4 + 1) {
+      ok &= add(&wheel, expires) == 0;
+      ok &= add(&wheel, expires) == 0;
+      added += 2;
+   }
+   CHECK(ok, "add");
+   CHECK(ip_wheel_count(&wheel) == added, "count after add");
+   CHECK(pop_ticks(&wheel, 0, 300000, 1) == added, "all timers taken");
+   CHECK(ip_wheel_count(&wheel) == 0, "count after pop");
+
+   // Timers added while the wheel runs, some of them already expired
+   for (expires = 300000; expires < 310000; expires += 7) {
+      add(&wheel, expires);
+   }
+   add(&wheel, 100);
+   CHECK(ip_wheel_pop(&wheel, 300000, &key, &expires) == 1 && expires == 300000, "timer expiring now");
+   CHECK(ip_wheel_pop(&wheel, 300000, &key, &expires) == 1 && expires == 100, "past timer expires at next pop");
+   CHECK(ip_wheel_pop(&wheel, 300000, &key, &expires) == 0, "no more expired timers");
+   added = ip_wheel_count(&wheel);
+   CHECK(added == (310000 - 300000) / 7, "count of timers added on the run");
+   CHECK(pop_ticks(&wheel, 300001, 310000, 1) == added, "timers added on the run");
+   ip_wheel_destroy(&wheel);
+}
+
+/**
+ * Timers beyond the span of the wheel are kept in its last slot and placed
+ * again until their own expiration.
+ */
+static void test_far_deadline(void)
+{
+   ip_wheel_t wheel;
+   uint64_t expires, far = 3 * SPAN + 12345;
+   timer_key_t key;
+
+   ip_wheel_init(&wheel, sizeof(timer_key_t));
+   add(&wheel, far);
+   add(&wheel, SPAN - 1);
+   add(&wheel, SPAN);
+
+   // Steps shorter than the span, the wheel ticks through all slots
+   CHECK(pop_ticks(&wheel, 0, SPAN + 4096, 4096) == 2, "deadlines around the span");
+   CHECK(ip_wheel_count(&wheel) == 1, "far deadline is not taken sooner");
+   CHECK(pop_ticks(&wheel, SPAN + 8192, far - 1, SPAN / 4) == 0, "far deadline is not taken on cascades");
+   CHECK(ip_wheel_pop(&wheel, far - 1, &key, &expires) == 0, "far deadline is not taken before its time");
+   CHECK(ip_wheel_pop(&wheel, far, &key, &expires) == 1 && expires == far && key.id == far, "far deadline is taken at its time");
+   ip_wheel_destroy(&wheel);
+}
+
+/** Jumps of time over the whole span place all timers again */
+static void test_time_jump(void)
+{
+   ip_wheel_t wheel;
+   uint64_t start = 1700000000, expires;
+   uint32_t taken = 0;
+   timer_key_t key;
+   int i;
+
+   ip_wheel_init(&wheel, sizeof(timer_key_t));
+
+   // The first pop moves the wheel from 0 to the flow time
+   CHECK(ip_wheel_pop(&wheel, start, &key, &expires) == 0, "empty wheel moves to the time");
+   for (i = 1; i <= 1000; i++) {
+      add(&wheel, start + (uint64_t) i * 1000);
+   }
+   CHECK(pop_ticks(&wheel, start, start + 500000, 1) == 500, "timers before the jump");
+
+   // Jump over the span, the rest expired together
+   while (ip_wheel_pop(&wheel, start + 10 * SPAN, &key, &expires)) {
+      taken++;
+   }
+   CHECK(taken == 500 && ip_wheel_count(&wheel) == 0, "timers after the jump");
+
+   // A jump of a nonempty wheel keeps timers which did not expire yet
+   add(&wheel, start + 20 * SPAN);
+   add(&wheel, start + 10 * SPAN + 5);
+   CHECK(ip_wheel_pop(&wheel, start + 15 * SPAN, &key, &expires) == 1 && expires == start + 10 * SPAN + 5, "expired timer after jump");
+   CHECK(ip_wheel_pop(&wheel, start + 15 * SPAN, &key, &expires) == 0, "later timer kept after jump");
+   CHECK(ip_wheel_pop(&wheel, start + 20 * SPAN, &key, &expires) == 1 && expires == start + 20 * SPAN, "later timer taken");
+
+   // Time of the wheel does not move back
+   add(&wheel, start + 20 * SPAN + 1);
+   CHECK(ip_wheel_pop(&wheel, start, &key, &expires) == 0, "time does not move back");
+   CHECK(ip_wheel_pop(&wheel, start + 20 * SPAN + 1, &key, &expires) == 1, "timer after old time");
+   ip_wheel_destroy(&wheel);
+}
+
+int main(void)
+{
+   test_cascade();
+   test_far_deadline();
+   test_time_jump();
+
+   if (fail_counter > 0) {
+      fprintf(stderr, "%d test(s) failed\n", fail_counter);
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,474 @@
+/**
+ * \file metrics.c
+ * \brief Runtime metrics of the detectors (counters, gauges and histograms) exported in Prometheus text format.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "metrics.h"
+
+/* Waiting for a request of a client (ms), clients which do not send any get the metrics anyway. */
+#define METRICS_REQUEST_TIMEOUT 100
+
+/* Period of checking the stop of the server thread (ms). */
+#define METRICS_POLL_TIMEOUT 500
+
+/* Quantiles printed for histograms. */
+static const double metrics_quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+typedef enum metrics_type_e {
+   METRICS_COUNTER,
+   METRICS_GAUGE,
+   METRICS_HISTOGRAM
+} metrics_type_t;
+
+/**
+ * Registered metric.
+ */
+typedef struct metrics_entry_s {
+   metrics_type_t type;
+   char *name;
+   char *help;
+   void *metric;
+} metrics_entry_t;
+
+static metrics_entry_t metrics[METRICS_MAX];
+static int metrics_cnt = 0;
+static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+
+volatile int metrics_active = 0;
+
+static int next_slot = 0;
+static __thread int thread_slot = -1;
+
+static int server_fd = -1;
+static char *server_path = NULL;
+static pthread_t server_thread;
+static volatile int server_stop = 0;
+
+int metrics_thread_slot(void)
+{
+   if (__builtin_expect(thread_slot < 0, 0)) {
+      thread_slot = __atomic_fetch_add(&next_slot, 1, __ATOMIC_RELAXED);
+      if (thread_slot >= METRICS_MAX_THREADS) {
+         thread_slot = METRICS_MAX_THREADS - 1;
+      }
+   }
+   return thread_slot;
+}
+
+static void *metrics_register(metrics_type_t type, const char *name, const char *help, size_t size)
+{
+   void *metric = NULL;
+   int i;
+
+   pthread_mutex_lock(&metrics_lock);
+   for (i = 0; i < metrics_cnt; i++) {
+      if (metrics[i].type == type && strcmp(metrics[i].name, name) == 0) {
+         metric = metrics[i].metric;
+         goto unlock;
+      }
+   }
+   if (metrics_cnt == METRICS_MAX) {
+      goto unlock;
+   }
+   metrics[metrics_cnt].name = strdup(name);
+   metrics[metrics_cnt].help = strdup(help);
+   metric = calloc(1, size);
+   if (metrics[metrics_cnt].name == NULL || metrics[metrics_cnt].help == NULL || metric == NULL) {
+      free(metrics[metrics_cnt].name);
+      free(metrics[metrics_cnt].help);
+      free(metric);
+      metric = NULL;
+      goto unlock;
+   }
+   metrics[metrics_cnt].type = type;
+   metrics[metrics_cnt].metric = metric;
+   metrics_cnt++;
+unlock:
+   pthread_mutex_unlock(&metrics_lock);
+   return metric;
+}
+
+metrics_counter_t *metrics_counter(const char *name, const char *help)
+{
+   return (metrics_counter_t *) metrics_register(METRICS_COUNTER, name, help, sizeof(metrics_counter_t));
+}
+
+metrics_gauge_t *metrics_gauge(const char *name, const char *help)
+{
+   return (metrics_gauge_t *) metrics_register(METRICS_GAUGE, name, help, sizeof(metrics_gauge_t));
+}
+
+metrics_histogram_t *metrics_histogram(const char *name, const char *help)
+{
+   return (metrics_histogram_t *) metrics_register(METRICS_HISTOGRAM, name, help, sizeof(metrics_histogram_t));
+}
+
+/**
+ * Index of the bucket of a value, values below METRICS_HIST_SUB have their own
+ * buckets, every higher power of two is split into METRICS_HIST_SUB buckets.
+ */
+static inline int hist_bucket(uint64_t value)
+{
+   int exp;
+
+   if (value < METRICS_HIST_SUB) {
+      return (int) value;
+   }
+   exp = 63 - __builtin_clzll(value);
+   if (exp > METRICS_HIST_MAX_EXP) {
+      return METRICS_HIST_BUCKETS - 1;
+   }
+   return (exp - METRICS_HIST_SUB_BITS + 1) * METRICS_HIST_SUB +
+          (int) ((value >> (exp - METRICS_HIST_SUB_BITS)) & (METRICS_HIST_SUB - 1));
+}
+
+/** Highest value of a bucket. */
+static uint64_t hist_bucket_max(int bucket)
+{
+   int exp, sub;
+
+   if (bucket < METRICS_HIST_SUB) {
+      return bucket;
+   }
+   exp = bucket / METRICS_HIST_SUB + METRICS_HIST_SUB_BITS - 1;
+   sub = bucket % METRICS_HIST_SUB;
+   return (((uint64_t) (METRICS_HIST_SUB + sub + 1)) << (exp - METRICS_HIST_SUB_BITS)) - 1;
+}
+
+void metrics_histogram_add(metrics_histogram_t *histogram, uint64_t value)
+{
+   uint64_t *buckets, *expected = NULL;
+   int slot;
+
+   if (histogram == NULL) {
+      return;
+   }
+   slot = metrics_thread_slot();
+   buckets = __atomic_load_n(&histogram->slots[slot], __ATOMIC_ACQUIRE);
+   if (buckets == NULL) {
+      // Buckets followed by count and sum of samples
+      buckets = (uint64_t *) calloc(METRICS_HIST_BUCKETS + 2, sizeof(uint64_t));
+      if (buckets == NULL) {
+         return;
+      }
+      if (!__atomic_compare_exchange_n(&histogram->slots[slot], &expected, buckets, 0,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+         // Slot shared by more threads was set meanwhile
+         free(buckets);
+         buckets = expected;
+      }
+   }
+   __atomic_fetch_add(&buckets[hist_bucket(value)], 1, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&buckets[METRICS_HIST_BUCKETS], 1, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&buckets[METRICS_HIST_BUCKETS + 1], value, __ATOMIC_RELAXED);
+}
+
+static uint64_t value_sum(const metrics_value_t *value)
+{
+   uint64_t sum = 0;
+   int i;
+
+   for (i = 0; i < METRICS_MAX_THREADS; i++) {
+      sum += __atomic_load_n(&value->slots[i].value, __ATOMIC_RELAXED);
+   }
+   return sum;
+}
+
+/**
+ * Print one sample, name of the metric is split to the family and labels,
+ * suffix is appended to the family and label is added to the labels.
+ */
+static void print_sample(FILE *f, const char *name, const char *suffix, const char *label, const char *value)
+{
+   const char *labels = strchr(name, '{');
+   int family_len = labels != NULL ? (int) (labels - name) : (int) strlen(name);
+
+   fprintf(f, "%.*s%s", family_len, name, suffix);
+   if (labels != NULL && label != NULL) {
+      fprintf(f, "%.*s,%s}", (int) strlen(labels) - 1, labels, label);
+   } else if (labels != NULL) {
+      fprintf(f, "%s", labels);
+   } else if (label != NULL) {
+      fprintf(f, "{%s}", label);
+   }
+   fprintf(f, " %s\n", value);
+}
+
+static void print_histogram(FILE *f, const char *name, metrics_histogram_t *histogram)
+{
+   uint64_t buckets[METRICS_HIST_BUCKETS + 2];
+   uint64_t *slot, cumulative = 0, rank;
+   char label[64], value[64];
+   int i, j, exp, q;
+
+   memset(buckets, 0, sizeof(buckets));
+   for (i = 0; i < METRICS_MAX_THREADS; i++) {
+      slot = __atomic_load_n(&histogram->slots[i], __ATOMIC_ACQUIRE);
+      if (slot == NULL) {
+         continue;
+      }
+      for (j = 0; j < METRICS_HIST_BUCKETS + 2; j++) {
+         buckets[j] += __atomic_load_n(&slot[j], __ATOMIC_RELAXED);
+      }
+   }
+
+   // Cumulative buckets at powers of two, the values are in seconds
+   for (exp = METRICS_HIST_SUB_BITS, i = 0; exp <= METRICS_HIST_MAX_EXP; exp++) {
+      for (; i < (exp - METRICS_HIST_SUB_BITS + 1) * METRICS_HIST_SUB; i++) {
+         cumulative += buckets[i];
+      }
+      snprintf(label, sizeof(label), "le=\"%.9g\"", (double) (1ULL << exp) / 1e9);
+      snprintf(value, sizeof(value), "%llu", (unsigned long long) cumulative);
+      print_sample(f, name, "_bucket", label, value);
+   }
+   snprintf(value, sizeof(value), "%llu", (unsigned long long) buckets[METRICS_HIST_BUCKETS]);
+   print_sample(f, name, "_bucket", "le=\"+Inf\"", value);
+   snprintf(value, sizeof(value), "%.9g", (double) buckets[METRICS_HIST_BUCKETS + 1] / 1e9);
+   print_sample(f, name, "_sum", NULL, value);
+   snprintf(value, sizeof(value), "%llu", (unsigned long long) buckets[METRICS_HIST_BUCKETS]);
+   print_sample(f, name, "_count", NULL, value);
+
+   // Quantiles (highest values of the buckets containing them) as a comment, they are computed from the buckets by Prometheus
+   fprintf(f, "# QUANTILES %s", name);
+   for (q = 0; q < (int) (sizeof(metrics_quantiles) / sizeof(metrics_quantiles[0])); q++) {
+      rank = (uint64_t) (metrics_quantiles[q] * buckets[METRICS_HIST_BUCKETS] + 0.5);
+      cumulative = 0;
+      for (i = 0; i < METRICS_HIST_BUCKETS - 1; i++) {
+         cumulative += buckets[i];
+         if (cumulative >= rank) {
+            break;
+         }
+      }
+      fprintf(f, " %g=%.9g", metrics_quantiles[q], buckets[METRICS_HIST_BUCKETS] == 0 ? 0.0 : (double) hist_bucket_max(i) / 1e9);
+   }
+   fprintf(f, "\n");
+}
+
+/** Returns true if two metrics belong to one family (their names before the labels are equal). */
+static int same_family(int a, int b)
+{
+   size_t len = strcspn(metrics[a].name, "{");
+
+   return strcspn(metrics[b].name, "{") == len && strncmp(metrics[a].name, metrics[b].name, len) == 0;
+}
+
+static void print_metric(FILE *f, int idx)
+{
+   char value[32];
+
+   switch (metrics[idx].type) {
+   case METRICS_COUNTER:
+      snprintf(value, sizeof(value), "%llu", (unsigned long long) value_sum((metrics_value_t *) metrics[idx].metric));
+      print_sample(f, metrics[idx].name, "", NULL, value);
+      break;
+   case METRICS_GAUGE:
+      snprintf(value, sizeof(value), "%lld", (long long) value_sum((metrics_value_t *) metrics[idx].metric));
+      print_sample(f, metrics[idx].name, "", NULL, value);
+      break;
+   case METRICS_HISTOGRAM:
+      print_histogram(f, metrics[idx].name, (metrics_histogram_t *) metrics[idx].metric);
+      break;
+   }
+}
+
+char *metrics_format(void)
+{
+   static const char *types[] = { "counter", "gauge", "histogram" };
+   char printed[METRICS_MAX];
+   char *out = NULL;
+   size_t out_size = 0;
+   FILE *f;
+   int i, j, len;
+
+   f = open_memstream(&out, &out_size);
+   if (f == NULL) {
+      return NULL;
+   }
+   pthread_mutex_lock(&metrics_lock);
+   // Metrics of one family may be registered interleaved with others, all of them are printed under one HELP and TYPE
+   memset(printed, 0, sizeof(printed));
+   for (i = 0; i < metrics_cnt; i++) {
+      if (printed[i]) {
+         continue;
+      }
+      len = (int) strcspn(metrics[i].name, "{");
+      fprintf(f, "# HELP %.*s %s\n", len, metrics[i].name, metrics[i].help);
+      fprintf(f, "# TYPE %.*s %s\n", len, metrics[i].name, types[metrics[i].type]);
+      for (j = i; j < metrics_cnt; j++) {
+         if (!printed[j] && same_family(i, j)) {
+            print_metric(f, j);
+            printed[j] = 1;
+         }
+      }
+   }
+   pthread_mutex_unlock(&metrics_lock);
+   if (fclose(f) != 0) {
+      free(out);
+      return NULL;
+   }
+   return out;
+}
+
+static int send_all(int fd, const char *data, size_t size)
+{
+   ssize_t sent;
+
+   while (size > 0) {
+      sent = send(fd, data, size, MSG_NOSIGNAL);
+      if (sent < 0 && errno == EINTR) {
+         continue;
+      }
+      if (sent <= 0) {
+         return -1;
+      }
+      data += sent;
+      size -= sent;
+   }
+   return 0;
+}
+
+/** Serve one client, the metrics are sent as HTTP response to HTTP requests and as plain text otherwise. */
+static void serve_client(int fd)
+{
+   static const char *http_header = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n";
+   struct pollfd pfd = { fd, POLLIN, 0 };
+   char request[1024];
+   ssize_t len = 0;
+   char *body;
+
+   if (poll(&pfd, 1, METRICS_REQUEST_TIMEOUT) > 0) {
+      len = recv(fd, request, sizeof(request), 0);
+   }
+   body = metrics_format();
+   if (body == NULL) {
+      return;
+   }
+   if (len >= 4 && memcmp(request, "GET ", 4) == 0 && send_all(fd, http_header, strlen(http_header)) != 0) {
+      free(body);
+      return;
+   }
+   send_all(fd, body, strlen(body));
+   free(body);
+}
+
+static void *server_loop(void *arg)
+{
+   struct pollfd pfd;
+   int client;
+
+   (void) arg;
+   while (!server_stop) {
+      pfd.fd = server_fd;
+      pfd.events = POLLIN;
+      if (poll(&pfd, 1, METRICS_POLL_TIMEOUT) <= 0) {
+         continue;
+      }
+      client = accept(server_fd, NULL, NULL);
+      if (client < 0) {
+         continue;
+      }
+      serve_client(client);
+      close(client);
+   }
+   return NULL;
+}
+
+int metrics_server_start(const char *path)
+{
+   struct sockaddr_un addr;
+
+   if (server_fd >= 0 || strlen(path) >= sizeof(addr.sun_path)) {
+      return -1;
+   }
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strcpy(addr.sun_path, path);
+
+   server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+   if (server_fd < 0) {
+      return -1;
+   }
+   unlink(path);
+   if (bind(server_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(server_fd, 8) != 0) {
+      goto error;
+   }
+   server_path = strdup(path);
+   if (server_path == NULL) {
+      goto error;
+   }
+   server_stop = 0;
+   if (pthread_create(&server_thread, NULL, server_loop, NULL) != 0) {
+      free(server_path);
+      server_path = NULL;
+      goto error;
+   }
+   metrics_active = 1;
+   return 0;
+
+error:
+   unlink(path);
+   close(server_fd);
+   server_fd = -1;
+   return -1;
+}
+
+void metrics_server_stop(void)
+{
+   if (server_fd < 0) {
+      return;
+   }
+   metrics_active = 0;
+   server_stop = 1;
+   pthread_join(server_thread, NULL);
+   close(server_fd);
+   server_fd = -1;
+   unlink(server_path);
+   free(server_path);
+   server_path = NULL;
+}
@@ -0,0 +1,185 @@
+/**
+ * \file metrics.h
+ * \brief Runtime metrics of the detectors (counters, gauges and histograms) exported in Prometheus text format.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef DETECTORS_COMMON_METRICS_H
+#define DETECTORS_COMMON_METRICS_H
+
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Number of per-thread slots of a metric, further threads share the last slot. */
+#define METRICS_MAX_THREADS 32
+
+/* Maximal number of registered metrics. */
+#define METRICS_MAX 64
+
+/* Sub-buckets of one power of two in histograms (3 bits, relative error below 12.5%). */
+#define METRICS_HIST_SUB_BITS 3
+#define METRICS_HIST_SUB (1 << METRICS_HIST_SUB_BITS)
+
+/* Highest power of two of histogram values (ns), larger values fall into the last bucket. */
+#define METRICS_HIST_MAX_EXP 40
+
+/* Number of histogram buckets. */
+#define METRICS_HIST_BUCKETS ((METRICS_HIST_MAX_EXP - METRICS_HIST_SUB_BITS + 2) * METRICS_HIST_SUB)
+
+/**
+ * Value of one thread aligned to a cache line, so that threads do not share lines.
+ */
+typedef struct metrics_slot_s {
+   uint64_t value;
+   uint64_t pad[7];
+} metrics_slot_t;
+
+/**
+ * Counter or gauge. Every thread updates its own slot, the exported value is
+ * the sum of all slots. Gauges are set per thread (e.g. size of the table of
+ * a worker), so the sum is the value of the whole module.
+ */
+typedef struct metrics_value_s {
+   metrics_slot_t slots[METRICS_MAX_THREADS];
+} metrics_value_t;
+
+/**
+ * Histogram of durations in nanoseconds with log-linear buckets (as in HDR
+ * histograms). Buckets of a thread are allocated by its first sample.
+ */
+typedef struct metrics_histogram_s {
+   uint64_t *slots[METRICS_MAX_THREADS]; /**< Buckets, count and sum of each thread. */
+} metrics_histogram_t;
+
+typedef metrics_value_t metrics_counter_t;
+typedef metrics_value_t metrics_gauge_t;
+
+/* Set while the metrics server is running, samples are not measured otherwise. */
+extern volatile int metrics_active;
+
+/* Returns slot of the calling thread. */
+int metrics_thread_slot(void);
+
+/**
+ * Register a metric or return the already registered one of the same name.
+ * Name may contain labels, e.g. "flows_total{protocol=\"ssh\"}", metrics of
+ * the same name without labels form one family, help is printed once for it.
+ * Returns NULL when too many metrics are registered or on memory error,
+ * update functions accept NULL and do nothing.
+ */
+metrics_counter_t *metrics_counter(const char *name, const char *help);
+metrics_gauge_t *metrics_gauge(const char *name, const char *help);
+metrics_histogram_t *metrics_histogram(const char *name, const char *help);
+
+/** Add to the counter. */
+static inline void metrics_counter_add(metrics_counter_t *counter, uint64_t value)
+{
+   if (counter != NULL) {
+      __atomic_fetch_add(&counter->slots[metrics_thread_slot()].value, value, __ATOMIC_RELAXED);
+   }
+}
+
+/** Increment the counter. */
+static inline void metrics_counter_inc(metrics_counter_t *counter)
+{
+   metrics_counter_add(counter, 1);
+}
+
+/** Set value of the gauge for the calling thread. */
+static inline void metrics_gauge_set(metrics_gauge_t *gauge, int64_t value)
+{
+   if (gauge != NULL) {
+      __atomic_store_n(&gauge->slots[metrics_thread_slot()].value, (uint64_t) value, __ATOMIC_RELAXED);
+   }
+}
+
+/** Add a sample (duration in ns) to the histogram. */
+void metrics_histogram_add(metrics_histogram_t *histogram, uint64_t value);
+
+/** Monotonic time in nanoseconds used for durations. */
+static inline uint64_t metrics_now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Start of a measured section, returns 0 if the metrics are not exported
+ * (the clock is not read then).
+ */
+static inline uint64_t metrics_start(void)
+{
+   return metrics_active ? metrics_now() : 0;
+}
+
+/** End of a measured section started by metrics_start, adds its duration to the histogram. */
+static inline void metrics_stop(metrics_histogram_t *histogram, uint64_t start)
+{
+   if (start != 0) {
+      metrics_histogram_add(histogram, metrics_now() - start);
+   }
+}
+
+/**
+ * Write all metrics in Prometheus text format to a newly allocated string.
+ * Returns NULL on memory error, the string is freed by the caller.
+ */
+char *metrics_format(void);
+
+/**
+ * Start thread serving the metrics on an UNIX socket at path. A client gets
+ * the metrics in Prometheus text format (as HTTP response if it sends an HTTP
+ * request, e.g. curl --unix-socket path http://localhost/metrics).
+ * Returns 0 on success and -1 on error.
+ */
+int metrics_server_start(const char *path);
+
+/** Stop the metrics thread and remove its socket. */
+void metrics_server_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
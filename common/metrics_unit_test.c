@@ -0,0 +1,135 @@
+/**
+ * \file metrics_unit_test.c
+ * \brief Unit test for the runtime metrics
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "metrics.h"
+
+static int fail_counter = 0;
+
+#define CHECK(cond, msg) { if (!(cond)) { fprintf(stderr, "FAIL: %s\n", msg); fail_counter++; } }
+
+/** Number of occurrences of a line in the text. */
+static int count_lines(const char *text, const char *line)
+{
+   size_t len = strlen(line);
+   const char *p = text;
+   int count = 0;
+
+   while ((p = strstr(p, line)) != NULL) {
+      if ((p == text || p[-1] == '\n') && p[len] == '\n') {
+         count++;
+      }
+      p += len;
+   }
+   return count;
+}
+
+/** Position of a line in the text, -1 if it is missing. */
+static long line_pos(const char *text, const char *line)
+{
+   const char *p = strstr(text, line);
+
+   return p != NULL ? (long) (p - text) : -1;
+}
+
+int main(void)
+{
+   static const char *protocols[] = { "ssh", "rdp", "telnet" };
+   metrics_counter_t *flows[3], *matched[3];
+   metrics_gauge_t *hosts[3];
+   metrics_histogram_t *histogram;
+   char name[64];
+   char *out;
+   int i;
+
+   // Families registered interleaved, once per protocol (as brute_force_detector does)
+   for (i = 0; i < 3; i++) {
+      snprintf(name, sizeof(name), "test_flows_total{protocol=\"%s\"}", protocols[i]);
+      flows[i] = metrics_counter(name, "Received flows.");
+      snprintf(name, sizeof(name), "test_matched_flows_total{protocol=\"%s\"}", protocols[i]);
+      matched[i] = metrics_counter(name, "Matched flows.");
+      snprintf(name, sizeof(name), "test_hosts{protocol=\"%s\"}", protocols[i]);
+      hosts[i] = metrics_gauge(name, "Hosts in the table.");
+   }
+   histogram = metrics_histogram("test_seconds", "Duration.");
+   CHECK(metrics_counter("test_flows_total{protocol=\"ssh\"}", "Received flows.") == flows[0], "registered twice");
+
+   for (i = 0; i < 3; i++) {
+      metrics_counter_add(flows[i], 10 + i);
+      metrics_counter_inc(matched[i]);
+      metrics_gauge_set(hosts[i], -i);
+   }
+   metrics_histogram_add(histogram, 1000);
+   metrics_histogram_add(histogram, 3000);
+
+   out = metrics_format();
+   CHECK(out != NULL, "format");
+   if (out == NULL) {
+      return 1;
+   }
+
+   CHECK(count_lines(out, "# TYPE test_flows_total counter") == 1, "TYPE of counter family once");
+   CHECK(count_lines(out, "# HELP test_flows_total Received flows.") == 1, "HELP of counter family once");
+   CHECK(count_lines(out, "# TYPE test_matched_flows_total counter") == 1, "TYPE of second family once");
+   CHECK(count_lines(out, "# TYPE test_hosts gauge") == 1, "TYPE of gauge family once");
+   CHECK(count_lines(out, "# TYPE test_seconds histogram") == 1, "TYPE of histogram once");
+
+   CHECK(count_lines(out, "test_flows_total{protocol=\"ssh\"} 10") == 1, "counter value");
+   CHECK(count_lines(out, "test_flows_total{protocol=\"telnet\"} 12") == 1, "counter value of last protocol");
+   CHECK(count_lines(out, "test_hosts{protocol=\"telnet\"} -2") == 1, "gauge value");
+   CHECK(count_lines(out, "test_seconds_count 2") == 1, "histogram count");
+   CHECK(count_lines(out, "test_seconds_bucket{le=\"+Inf\"} 2") == 1, "histogram +Inf bucket");
+
+   // Samples of a family follow its TYPE line, before the next family starts
+   CHECK(line_pos(out, "# TYPE test_flows_total counter") < line_pos(out, "test_flows_total{protocol=\"rdp\"} 11"), "sample after its TYPE");
+   CHECK(line_pos(out, "test_flows_total{protocol=\"telnet\"} 12") < line_pos(out, "# TYPE test_matched_flows_total counter"), "family contiguous");
+   CHECK(line_pos(out, "test_matched_flows_total{protocol=\"telnet\"} 1") < line_pos(out, "# TYPE test_hosts gauge"), "second family contiguous");
+   free(out);
+
+   if (fail_counter > 0) {
+      fprintf(stderr, "%d test(s) failed\n", fail_counter);
+      return 1;
+   }
+   return 0;
+}
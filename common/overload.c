@@ -0,0 +1,84 @@
+/**
+ * \file overload.c
+ * \brief Overload controller, measures the load of a processing thread and sheds records in declared degraded modes.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "overload.h"
+
+void overload_init(overload_t *overload, const char *prefix, double threshold)
+{
+   char name[128];
+
+   memset(overload, 0, sizeof(overload_t));
+   overload->threshold = threshold > 1 ? 1 : threshold;
+   overload->window_start = metrics_now();
+
+   snprintf(name, sizeof(name), "%s_shed_total", prefix);
+   overload->shed_metric = metrics_counter(name, "Records shed in degraded modes of the overload controller.");
+   snprintf(name, sizeof(name), "%s_overload_level", prefix);
+   overload->level_metric = metrics_gauge(name, "Degradation levels of the processing threads (0 = normal operation), summed over the threads.");
+   snprintf(name, sizeof(name), "%s_load_permille", prefix);
+   overload->load_metric = metrics_gauge(name, "Busy time of the processing threads in the last second, summed over the threads.");
+   snprintf(name, sizeof(name), "%s_record_cost_ns", prefix);
+   overload->cost_metric = metrics_gauge(name, "Average time of processing of a record in the last second, summed over the threads.");
+}
+
+void overload_update(overload_t *overload, uint64_t now)
+{
+   double load = (double) overload->busy / (double) (now - overload->window_start);
+
+   if (load >= overload->threshold) {
+      if (overload->level < OVERLOAD_MAX_LEVEL) {
+         overload->level++;
+      }
+   } else if (load < overload->threshold * OVERLOAD_HYSTERESIS && overload->level > 0) {
+      overload->level--;
+   }
+
+   metrics_gauge_set(overload->level_metric, overload->level);
+   metrics_gauge_set(overload->load_metric, (int64_t) (load * 1000));
+   metrics_gauge_set(overload->cost_metric, overload->records ? (int64_t) (overload->busy / overload->records) : 0);
+
+   overload->window_start = now;
+   overload->busy = 0;
+   overload->records = 0;
+}
@@ -0,0 +1,160 @@
+/**
+ * \file overload.h
+ * \brief Overload controller, measures the load of a processing thread and sheds records in declared degraded modes.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef DETECTORS_COMMON_OVERLOAD_H
+#define DETECTORS_COMMON_OVERLOAD_H
+
+#include <stdint.h>
+#include "metrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Length of the window the load is measured in (ns). */
+#define OVERLOAD_WINDOW 1000000000ULL
+
+/* Highest level of degradation, hosts are sampled 1:2^level at a level. */
+#define OVERLOAD_MAX_LEVEL 4
+
+/* The level is lowered when the load falls below this fraction of the threshold. */
+#define OVERLOAD_HYSTERESIS 0.75
+
+/**
+ * Controller of one processing thread. The thread marks the time it spends
+ * on records (between receiving them), the fraction of busy time in a window
+ * is its load. Input the thread cannot keep up with is buffered by libtrap
+ * (its depth cannot be read), the receive then returns immediately and the
+ * load approaches 1. When the load exceeds the threshold, the level is raised
+ * by one every window (and lowered when the load drops below the hysteresis),
+ * the module sheds records declared as expendable at levels above 0.
+ */
+typedef struct overload_s {
+   double threshold;       /**< Load raising the level, 0 disables the controller. */
+   uint32_t level;         /**< Current level, 0 is the normal operation. */
+   uint64_t window_start;  /**< Start of the current window. */
+   uint64_t busy_start;    /**< Start of processing of the current records. */
+   uint64_t busy;          /**< Time spent on records in the window. */
+   uint64_t records;       /**< Records processed in the window. */
+   uint64_t shed;          /**< Records shed by this thread since the start. */
+   metrics_counter_t *shed_metric;
+   metrics_gauge_t *level_metric;
+   metrics_gauge_t *load_metric;
+   metrics_gauge_t *cost_metric;
+} overload_t;
+
+/**
+ * Initialize the controller, its metrics are named by prefix (e.g.
+ * "<prefix>_shed_total"). Threshold is the load (0..1] raising the level,
+ * 0 disables shedding. Metrics are registered, so call it before starting the
+ * threads of the module.
+ */
+void overload_init(overload_t *overload, const char *prefix, double threshold);
+
+/** Evaluate the finished window, called by overload_end. */
+void overload_update(overload_t *overload, uint64_t now);
+
+/** Start of processing of received records. */
+static inline void overload_begin(overload_t *overload)
+{
+   if (overload->threshold > 0) {
+      overload->busy_start = metrics_now();
+   }
+}
+
+/** End of processing of records started by overload_begin. */
+static inline void overload_end(overload_t *overload, uint32_t records)
+{
+   if (overload->threshold > 0) {
+      uint64_t now = metrics_now();
+      overload->busy += now - overload->busy_start;
+      overload->records += records;
+      if (now - overload->window_start >= OVERLOAD_WINDOW) {
+         overload_update(overload, now);
+      }
+   }
+}
+
+/** The thread is in a degraded mode. */
+static inline int overload_degraded(const overload_t *overload)
+{
+   return overload->level > 0;
+}
+
+/** Count records shed by the module (e.g. skipped noise). */
+static inline void overload_shed(overload_t *overload, uint32_t records)
+{
+   overload->shed += records;
+   metrics_counter_add(overload->shed_metric, records);
+}
+
+/** Mix bits of a host hash (finalizer of splitmix64), so that any bits of it can be sampled. */
+static inline uint64_t overload_mix(uint64_t hash)
+{
+   hash ^= hash >> 30;
+   hash *= 0xbf58476d1ce4e5b9ULL;
+   hash ^= hash >> 27;
+   hash *= 0x94d049bb133111ebULL;
+   hash ^= hash >> 31;
+   return hash;
+}
+
+/**
+ * Deterministic sampling of hosts: at level L only hosts whose mixed hash
+ * has the top L bits zero are kept, so a kept host keeps all its records and
+ * the hosts kept at a level are kept at the lower levels too. Returns 1 when
+ * the record of the host should be processed, 0 when it is shed (counted).
+ */
+static inline int overload_keep(overload_t *overload, uint64_t hash)
+{
+   if (overload->level == 0 || (overload_mix(hash) >> (64 - overload->level)) == 0) {
+      return 1;
+   }
+   overload_shed(overload, 1);
+   return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * \file ur_fixed.h
+ * \brief Direct access to the fields of records of a fixed UniRec template.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef DETECTORS_COMMON_UR_FIXED_H
+#define DETECTORS_COMMON_UR_FIXED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unirec/unirec.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A module describes the records of its input template by a packed structure
+ * with the fields in the order UniRec lays them out (by size from the largest,
+ * fields of the same size by name, headers of variable length fields last) and
+ * by a table of the offsets of the fields in the structure.
+ *
+ * When the negotiated input template matches the table, the records are read
+ * through the structure with offsets known at compile time. Otherwise (e.g. the
+ * sender adds more fields) the generic access through the template is used.
+ */
+
+/* Offset of a field of the template in the record structure. */
+typedef struct ur_fixed_field_s {
+   ur_field_id_t id;
+   uint16_t offset;
+} ur_fixed_field_t;
+
+/* Header of a variable length field in the fixed part of a record. */
+typedef struct __attribute__ ((__packed__)) ur_fixed_var_s {
+   uint16_t offset; /* offset of the data from the end of the fixed part */
+   uint16_t length;
+} ur_fixed_var_t;
+
+#define UR_FIXED_FIELD(rec_type, member, field_id) \
+   { (ur_field_id_t) (field_id), (uint16_t) offsetof(rec_type, member) }
+
+#define UR_FIXED_FIELD_COUNT(fields) (sizeof(fields) / sizeof((fields)[0]))
+
+/**
+ * \brief Check whether records of a template are laid out as the record structure.
+ * \param[in] tmplt Negotiated template.
+ * \param[in] fields Offsets of all the fields in the structure.
+ * \param[in] count Number of the fields.
+ * \param[in] rec_size Size of the structure.
+ * \return 1 when the template has exactly the given fields at the given offsets, 0 otherwise.
+ */
+static inline int ur_fixed_match(const ur_template_t *tmplt, const ur_fixed_field_t *fields, size_t count, size_t rec_size)
+{
+   size_t i;
+
+   if (tmplt == NULL || tmplt->count != count || tmplt->static_size != rec_size) {
+      return 0;
+   }
+   for (i = 0; i < count; i++) {
+      if (!ur_is_present(tmplt, fields[i].id) || tmplt->offset[fields[i].id] != fields[i].offset) {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+/*
+ * Access to a field of a record, directly through the record structure when
+ * the template matches (fixed is nonzero), through the template otherwise.
+ * Variable length fields are accessed by their headers in the structure.
+ * The type of a field is taken from the structure, so field_id may be passed
+ * through other macros (ur_get() pastes it to the name of the type).
+ */
+#define ur_fixed_get(fixed, rec_type, member, tmplt, data, field_id) \
+   ((fixed) ? ((const rec_type *) (data))->member : \
+              *(const __typeof__(((const rec_type *) 0)->member) *) ((const char *) (data) + (tmplt)->offset[field_id]))
+
+#define ur_fixed_get_ptr(fixed, rec_type, member, tmplt, data, field_id) \
+   ((fixed) ? (void *) ((const char *) (data) + offsetof(rec_type, member)) : \
+              ur_get_ptr_by_id(tmplt, data, field_id))
+
+#define ur_fixed_var_len(fixed, rec_type, member, tmplt, data, field_id) \
+   ((fixed) ? ((const rec_type *) (data))->member.length : ur_get_var_len(tmplt, data, field_id))
+
+#define ur_fixed_var_ptr(fixed, rec_type, member, tmplt, data, field_id) \
+   ((fixed) ? (const char *) (data) + sizeof(rec_type) + ((const rec_type *) (data))->member.offset : \
+              (const char *) ur_get_ptr_by_id(tmplt, data, field_id))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DETECTORS_COMMON_UR_FIXED_H */
@@ -52,17 +52,23 @@
 #include <time.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <string.h>
 #include <libtrap/trap.h>
 #include <unirec/unirec.h>
 #include "fields.h"
-#include <b_plus_tree.h>
+#include "ip_table.h"
+#include "src_sketch.h"
 #include <stdbool.h>
 #include <assert.h>
 
 /*#define DEBUG1
 #define DEBUG2*/
 
-#define NUM_OF_ITEMS_IN_TREE_LEAF 5
+/* Initial number of slots in the table of destination records. */
+#define DST_TABLE_INITIAL_SIZE 4096
+
+/* Number of slots of the table whose windows are moved for each flow. */
+#define SWEEP_SLOTS_PER_FLOW 16
 
 /* ---------------------------------------------------------------------- */
 /*
@@ -105,23 +111,11 @@
 #warning (MAX_FLOW_LEN + MAX_FLOW_DELAY) should be divisible by INTERVAL
 #endif
 
-/* Number of entries in SRC_IP table. Should be divisible by 8. */
-#define N_TABLE_SIZE 64 * 8
-
-#if (N_TABLE_SIZE) % 8 != 0
-#warning N_TABLE_SIZE should be divisible by 8
-#endif
-
 #define MIN_TIME_BETWEEN_REPORT 5 * 60
 
 #if (MIN_TIME_BETWEEN_REPORT) % (INTERVAL) != 0
 #warning MIN_TIME_BETWEEN_REPORT should be divisible by INTERVAL
 #endif
-/*
- * Number of descendants of each tree node ("order" or "branching factor" of
- * the tree).
- */
-#define TREE_BRANCH_FACTOR 16
 
 /**
  * Definition of fields used in UniRec templates (for both input and output
@@ -165,6 +159,8 @@ trap_module_info_t *module_info = NULL;
    PARAM('c', "threshold_ip_count_rate", "Rate between the increase of number of unique SRC_IP addresses in next 2 windows and the average from previous windows to consider this behavior as a flood attack.", required_argument, "uint16") \
    PARAM('s', "mask_source_addresses", "Get only prefix bits from source addresses corresponding given mask, default value/mask is 24.", required_argument, "uint8") \
    PARAM('d', "mask_destination_addresses", "Get only prefix bits from destination addresses corresponding given mask, default value/mask is 32.", required_argument, "uint8") \
+   PARAM('S', "mask_source_addresses_v6", "Get only prefix bits from IPv6 source addresses corresponding given mask, default value/mask is 48.", required_argument, "uint8") \
+   PARAM('D', "mask_destination_addresses_v6", "Get only prefix bits from IPv6 destination addresses corresponding given mask, default value/mask is 128.", required_argument, "uint8") \
    PARAM('p', "min_threshold_before_pruning", "Minimal size of flow traffic (average of flow in windows) in kb/s which will not be removed. Entries containing less flow will be removed. Default value is 10kb/s.", required_argument, "uint64")
 
 static int stop = 0;
@@ -177,7 +173,7 @@ TRAP_DEFAULT_SIGNAL_HANDLER(stop = 1)
  * Struct with information about flood.
  */
 typedef struct flood_s {
-   uint32_t dst_ip;
+   ip_addr_t dst_ip;
    uint32_t last_reported;
    uint64_t total_bytes;
    uint64_t uuid;
@@ -192,8 +188,9 @@ typedef struct flood_s {
 
 typedef struct dst_addr_record_s {
    uint64_t bytes_per_int[N_INTERVALS];
-   uint16_t src_ip_per_int[N_INTERVALS];
-   char src_ip_table[N_TABLE_SIZE / 8];
+   uint32_t src_ip_per_int[N_INTERVALS];
+   src_sketch_t src_ip_sketch; /* unique SRC_IPs of the current interval */
+   uint32_t int_num; /* absolute number (time / INTERVAL) of the latest interval */
    uint64_t total;
    flood_t *flood_info;
 } dst_addr_record_t;
@@ -206,6 +203,8 @@ typedef struct param_s {
    uint16_t threshold_ip_cnt_rate;
    uint8_t src_mask;
    uint8_t dst_mask;
+   uint8_t src_mask6;
+   uint8_t dst_mask6;
 } param_t;
 
 static param_t param;
@@ -219,25 +218,51 @@ uint32_t current_time = 0;
  */
 uint32_t current_int_start = 0;
 
-/* Index of the current interval in addr_record_t.bytes_per_int. */
-int current_int_idx = N_INTERVALS - 1;
+/*
+ * Index of the current interval in addr_record_t.bytes_per_int (interval
+ * windows are circular buffers indexed by absolute interval number).
+ */
+int current_int_idx = 0;
+
+/* Next slot of the table to be swept. */
+uint32_t sweep_position = 0;
 
 /***********************************************/
 
-int compare_32b(void *a, void *b)
+/**
+ * A function that keeps only the prefix of given length of an address (mask
+ * of IPv4 address is used for IPv4, mask6 for IPv6).
+ */
+void mask_address(ip_addr_t *ip, uint8_t mask, uint8_t mask6)
 {
-   uint32_t *h1, *h2;
-   h1 = (uint32_t *) a;
-   h2 = (uint32_t *) b;
-   if (*h1 == *h2) {
-      return EQUAL;
-   } else if (*h1 < *h2) {
-      return LESS;
-   } else {
-      return MORE;
+   int i;
+
+   if (ip_is4(ip)) {
+      ip->ui32[2] &= mask == 0 ? 0 : htonl((uint32_t)0xffffffff << (32 - mask));
+      return;
+   }
+   for (i = 0; i < 4; ++i) {
+      if (mask6 >= 32) {
+         mask6 -= 32;
+      } else {
+         ip->ui32[i] &= mask6 == 0 ? 0 : htonl((uint32_t)0xffffffff << (32 - mask6));
+         mask6 = 0;
+      }
    }
 }
 
+/**
+ * A function that returns 32 bits of an address used in EVENT_ID (the
+ * address itself for IPv4).
+ */
+uint32_t get_address_id(const ip_addr_t *ip)
+{
+   if (ip_is4(ip)) {
+      return ip_get_v4_as_int(ip);
+   }
+   return ip->ui32[0] ^ ip->ui32[1] ^ ip->ui32[2] ^ ip->ui32[3];
+}
+
 /**
  * A function that returns true only if the flood has been successfully
  * reported, otherwise returns false.
@@ -256,8 +281,7 @@ bool report_flood(flood_t *flood_info, ur_template_t *out_tmplt, void *out_rec,
    #ifdef DEBUG1
    printf("######## reporting flood:\n");
    char addr[64];
-   ip_addr_t ip_key = ip_from_int((flood_info->dst_ip));
-   ip_to_str(&ip_key, addr);
+   ip_to_str(&flood_info->dst_ip, addr);
    printf("# DST_IP: %s\n", addr);
    printf("# BYTES: %lu\n", flood_info->total_bytes);
    printf("# DURATION: %u\n", time_last ? time_last - flood_info->last_reported : 0);
@@ -272,7 +296,7 @@ bool report_flood(flood_t *flood_info, ur_template_t *out_tmplt, void *out_rec,
       flood_info->avg_ip_cnt_current = 0;
    }
 
-   ur_set(out_tmplt, out_rec, F_DST_IP, ip_from_int(flood_info->dst_ip));
+   ur_set(out_tmplt, out_rec, F_DST_IP, flood_info->dst_ip);
    ur_set(out_tmplt, out_rec, F_BYTES, flood_info->total_bytes);
    ur_set(out_tmplt, out_rec, F_TIME_FIRST, ur_time_from_sec_msec(flood_info->last_reported, 0));
    if (time_last == 0) {
@@ -313,63 +337,57 @@ bool report_flood(flood_t *flood_info, ur_template_t *out_tmplt, void *out_rec,
 }
 
 /**
- * A function that moves each tree entry, returns whether the operation was
- * successfull.
+ * A function that moves windows of the record to the current interval (the
+ * windows are caught up lazily, when the record is touched or swept), returns
+ * whether the operation was successfull. Expired is set when the record
+ * should be deleted, its sketch is cleared then.
  */
-bool move_window(int move, bpt_t *b_plus_tree, ur_template_t *out_tmplt,
+bool move_window(dst_addr_record_t *rec, bool *expired, ur_template_t *out_tmplt,
                  void *out_rec)
 {
+   uint32_t current_int_num = current_int_start / INTERVAL;
 
-   #ifdef DEBUG2
-   printf("Move window by %d\n", move);
-   #endif
-   /* Create a structure for iterating through the leaves. */
-   bpt_list_item_t *b_item = bpt_list_init(b_plus_tree);
-   if (b_item == NULL) {
-      fprintf(stderr, "ERROR: could not initialize a list iterator structure\n");
-      return false;
+   *expired = false;
+   if (rec->int_num == 0) {
+      /* New record. */
+      rec->int_num = current_int_num;
+      return true;
    }
 
-   dst_addr_record_t *rec = NULL;
-   int has_next = 0;
-
-   /*
-    * Get the first value from the list. Function returns 1 if there are more
-    * values, 0 if there are no values.
-    */
-   has_next = bpt_list_start(b_plus_tree, b_item);
-   while (has_next == 1) {
-      int i, j;
-      /* Get the value from B+ item structure */
-      rec = b_item->value;
-      if (rec == NULL) {
-         /*There is a problem in the tree. This case should be unreachable*/
-         fprintf(stderr, "ERROR during iteration through the tree. Value is NULL\n");
-         bpt_list_clean(b_item);
-         return false;
+   while (rec->int_num < current_int_num) {
+      int i;
+      /* Record's interval is the latest one of its windows. */
+      int rec_int_idx = rec->int_num % N_INTERVALS;
+      uint32_t rec_int_start = rec->int_num * INTERVAL;
+      int move = current_int_num - rec->int_num;
+      if (move > N_INTERVALS) {
+         move = N_INTERVALS;
       }
+      #ifdef DEBUG2
+      printf("Move window by %d\n", move);
+      #endif
 
       /* Check the end of the flood. */
       if (rec->flood_info != NULL && rec->flood_info->is_valid == true) {
          int last_flood = -1;
-         for (i = current_int_idx + 1; i < current_int_idx + 1 + N_INTERVALS; ++i) {
+         for (i = rec_int_idx + 1; i < rec_int_idx + 1 + N_INTERVALS; ++i) {
             if (rec->bytes_per_int[i % N_INTERVALS] >= param.threshold_flow_rate * rec->flood_info->avg_flow_original
                && rec->src_ip_per_int[ i % N_INTERVALS] >= param.threshold_ip_cnt_rate * rec->flood_info->avg_ip_cnt_original) {
-               last_flood = i - current_int_idx - 1;
+               last_flood = i - rec_int_idx - 1;
             }
          }
          if (last_flood == -1) {
             if (rec->flood_info->avg_flow_original >= param.min_traffic_before_attack) {
-               report_flood(rec->flood_info, out_tmplt, out_rec, current_int_start + INTERVAL);
+               report_flood(rec->flood_info, out_tmplt, out_rec, rec_int_start + INTERVAL);
             }
             free(rec->flood_info);
             rec->flood_info = NULL;
          } else if (last_flood < move) {
-            for (i = current_int_idx + 1; i < current_int_idx + 1 + last_flood + 1; ++i) {
+            for (i = rec_int_idx + 1; i < rec_int_idx + 1 + last_flood + 1; ++i) {
                rec->flood_info->total_bytes += rec->bytes_per_int[i % N_INTERVALS] - rec->flood_info->avg_flow_original;
             }
             if (rec->flood_info->avg_flow_original >= param.min_traffic_before_attack) {
-               report_flood(rec->flood_info, out_tmplt, out_rec, current_int_start + INTERVAL);
+               report_flood(rec->flood_info, out_tmplt, out_rec, rec_int_start + INTERVAL);
             }
             free(rec->flood_info);
             rec->flood_info = NULL;
@@ -379,27 +397,25 @@ bool move_window(int move, bpt_t *b_plus_tree, ur_template_t *out_tmplt,
       /* Calculate the average flow and the number of SRC_IP before the flood. */
       if (rec->flood_info != NULL && rec->flood_info->is_valid == false) {
          /* Calculate the number of windows before the flood begins. */
-         int int_size = (rec->flood_info->last_reported - current_int_start + (N_INTERVALS - 1) * INTERVAL) / INTERVAL;
+         int int_size = (rec->flood_info->last_reported - rec_int_start + (N_INTERVALS - 1) * INTERVAL) / INTERVAL;
          int empty_window = 0;
          if (int_size == 0) {
             fprintf(stderr, "ERROR during calculating average flow\n");
-            bpt_list_clean(b_item);
             return false;
          }
          /* Skip windows with no traffic. */
-         for (i = current_int_idx + 1; i < current_int_idx + 1 + int_size; ++i) {
+         for (i = rec_int_idx + 1; i < rec_int_idx + 1 + int_size; ++i) {
             if (rec->bytes_per_int[i % N_INTERVALS] != 0) {
                break;
             }
             empty_window++;
          }
-         for (; i < current_int_idx + 1 + int_size; ++i) {
+         for (; i < rec_int_idx + 1 + int_size; ++i) {
             rec->flood_info->avg_flow_original += rec->bytes_per_int[i % N_INTERVALS];
             rec->flood_info->avg_ip_cnt_original += rec->src_ip_per_int[i % N_INTERVALS];
          }
          if (int_size - empty_window <= 0) {
             fprintf(stderr, "ERROR during calculating average flow\n");
-            bpt_list_clean(b_item);
             return false;
          }
          rec->flood_info->avg_flow_original /= (int_size - empty_window);
@@ -410,10 +426,10 @@ bool move_window(int move, bpt_t *b_plus_tree, ur_template_t *out_tmplt,
       /* Move window and set new intervals to 0. */
       if(rec->flood_info != NULL && rec->flood_info->is_valid == true) {
          int int_start = 0;
-         if (current_int_start - (N_INTERVALS - 1) * INTERVAL < rec->flood_info->last_reported) {
-            int_start = (rec->flood_info->last_reported - current_int_start + (N_INTERVALS - 1) * INTERVAL) / INTERVAL;
+         if (rec_int_start - (N_INTERVALS - 1) * INTERVAL < rec->flood_info->last_reported) {
+            int_start = (rec->flood_info->last_reported - rec_int_start + (N_INTERVALS - 1) * INTERVAL) / INTERVAL;
          }
-         for (i = current_int_idx + 1 + int_start; i < current_int_idx + 1 + move; ++i) {
+         for (i = rec_int_idx + 1 + int_start; i < rec_int_idx + 1 + move; ++i) {
             if (rec->bytes_per_int[i % N_INTERVALS] > rec->flood_info->avg_flow_original) {
                rec->flood_info->total_bytes += rec->bytes_per_int[i % N_INTERVALS] - rec->flood_info->avg_flow_original;
                rec->flood_info->avg_ip_cnt_current += rec->src_ip_per_int[i % N_INTERVALS];
@@ -426,34 +442,31 @@ bool move_window(int move, bpt_t *b_plus_tree, ur_template_t *out_tmplt,
          }
       }
 
-      for (i = current_int_idx + 1; i < current_int_idx + 1 + move; ++i) {
+      for (i = rec_int_idx + 1; i < rec_int_idx + 1 + move; ++i) {
          rec->total -= rec->bytes_per_int[i % N_INTERVALS];
          rec->bytes_per_int[i % N_INTERVALS] = 0;
          rec->src_ip_per_int[i % N_INTERVALS] = 0;
       }
-      for (j = 0; j < N_TABLE_SIZE / 8; ++j) {
-         rec->src_ip_table[j] = 0;
-      }
+      src_sketch_reset(&rec->src_ip_sketch);
+      rec->int_num += move;
 
       /* If there is no flow / bytes for ip address, leaf is deleted. */
-      uint64_t bytes = 0;
-      for (i = 0; i < N_INTERVALS; ++i) {
-         bytes += rec->bytes_per_int[i];
-      }
-
       if (rec->total <= param.min_threshold_pruning) {
          /* Delete the flood_info struct if it exists and report. */
          if (rec->flood_info != NULL) {
             if (rec->flood_info->is_valid == true
                && rec->flood_info->avg_flow_original >= param.min_traffic_before_attack) {
-               report_flood(rec->flood_info, out_tmplt, out_rec, current_int_start + INTERVAL);
+               report_flood(rec->flood_info, out_tmplt, out_rec, rec_int_start + INTERVAL);
             }
             free(rec->flood_info);
             rec->flood_info = NULL;
          }
-         has_next = bpt_list_item_del(b_plus_tree, b_item);
+         /* Registers are kept by src_sketch_reset, the record is dropped or started again. */
+         src_sketch_clear(&rec->src_ip_sketch);
+         *expired = true;
+         return true;
       } else {
-         uint32_t time_last = current_int_start - (N_INTERVALS - 1 - move) * INTERVAL;
+         uint32_t time_last = rec_int_start - (N_INTERVALS - 1 - move) * INTERVAL;
          if (rec->flood_info != NULL
             && rec->flood_info->last_reported + MIN_TIME_BETWEEN_REPORT <= time_last) {
             if (rec->flood_info->avg_flow_original >= param.min_traffic_before_attack) {
@@ -463,41 +476,50 @@ bool move_window(int move, bpt_t *b_plus_tree, ur_template_t *out_tmplt,
                rec->flood_info = NULL;
             }
          }
-         has_next = bpt_list_item_next(b_plus_tree, b_item);
       }
    }
-   bpt_list_clean(b_item);
    return true;
 }
 
 /**
- * A function that deletes a tree and additional allocated structure. Returns
- * true after a successful deletion, otherwise false.
+ * A function that moves windows of the next few slots of the table, so that
+ * records which are not updated anymore are reported and deleted too.
  */
-bool delete_tree(bpt_t *b_plus_tree, ur_template_t *out_tmplt, void *out_rec)
+bool sweep_records(ip_table_t *table, ur_template_t *out_tmplt, void *out_rec)
 {
-   /* Create a structure for iterating through the leaves. */
-   bpt_list_item_t *b_item = bpt_list_init(b_plus_tree);
-   if (b_item == NULL) {
-      fprintf(stderr, "ERROR: could not initialize a list iterator structure\n");
-      return false;
+   int i;
+   bool expired;
+
+   for (i = 0; i < SWEEP_SLOTS_PER_FLOW; ++i) {
+      if (sweep_position >= table->size) {
+         sweep_position = 0;
+      }
+      if (ip_table_used(table, sweep_position)) {
+         if (move_window(ip_table_value(table, sweep_position), &expired, out_tmplt, out_rec) == false) {
+            return false;
+         }
+         if (expired) {
+            ip_table_delete(table, sweep_position);
+         }
+      }
+      sweep_position++;
    }
+   return true;
+}
 
+/**
+ * A function that reports floods and deletes all records of the table.
+ * Returns true after a successful deletion, otherwise false.
+ */
+bool delete_records(ip_table_t *table, ur_template_t *out_tmplt, void *out_rec)
+{
    dst_addr_record_t *rec = NULL;
-   int has_next = 0;
+   uint32_t idx;
+   bool expired;
 
-   /*
-    * Get the first value from the list. Function returns 1 if there are more
-    * values, 0 if there are no values.
-    */
-   has_next = bpt_list_start(b_plus_tree, b_item);
-   while (has_next == 1) {
-      /* Get value from B+ item structure. */
-      rec = b_item->value;
-      if (rec == NULL) {
-         /* There is a problem in the tree. This case should be unreachable. */
-         fprintf(stderr, "ERROR during iteration through the tree. Value is NULL\n");
-         bpt_list_clean(b_item);
+   for (idx = ip_table_first(table); idx < table->size; idx = ip_table_next(table, idx)) {
+      rec = ip_table_value(table, idx);
+      if (move_window(rec, &expired, out_tmplt, out_rec) == false) {
          return false;
       }
       /* Delete the flood_info struct if it exists and report. */
@@ -519,23 +541,13 @@ bool delete_tree(bpt_t *b_plus_tree, ur_template_t *out_tmplt, void *out_rec)
          free(rec->flood_info);
          rec->flood_info = NULL;
       }
-      has_next = bpt_list_item_next(b_plus_tree, b_item);
+      src_sketch_clear(&rec->src_ip_sketch);
    }
-   bpt_list_clean(b_item);
 
-   bpt_clean(b_plus_tree);
+   ip_table_clean(table);
    return true;
 }
 
-/**
- * A function that returns an index for SRC_IP in src_ip_table.
- */
-uint32_t get_index(ip_addr_t *src_ip)
-{
-   /* TODO find some better hash function */
-   return ip_get_v4_as_int(src_ip) % (N_TABLE_SIZE - 1);
-}
-
 int main(int argc, char **argv)
 {
    int ret;
@@ -546,7 +558,7 @@ int main(int argc, char **argv)
    void *out_rec = NULL;
    ur_template_t *out_tmplt = NULL;
    ur_template_t *in_tmplt = NULL;
-   uint32_t key;
+   ip_addr_t key;
 
    param.minimal_attack_size = 1000 * 1000 / 8 * INTERVAL;
    param.min_threshold_pruning = 10 * 1000 / 8 * INTERVAL * N_INTERVALS;
@@ -555,8 +567,10 @@ int main(int argc, char **argv)
    param.threshold_ip_cnt_rate = 4;
    param.src_mask = 24;
    param.dst_mask = 32;
+   param.src_mask6 = 48;
+   param.dst_mask6 = 128;
 
-   bpt_t *b_plus_tree = NULL;
+   ip_table_t *table = NULL;
 
    /***** TRAP initialization *****/
 
@@ -637,6 +651,18 @@ int main(int argc, char **argv)
          }
          break;
 
+      case 'S':
+         if (sscanf(optarg,"%" SCNu8, &param.src_mask6) != 1) {
+            invalid_argument = true;
+         }
+         break;
+
+      case 'D':
+         if (sscanf(optarg,"%" SCNu8, &param.dst_mask6) != 1) {
+            invalid_argument = true;
+         }
+         break;
+
       default:
          invalid_argument = true;
          break;
@@ -654,10 +680,14 @@ int main(int argc, char **argv)
       fprintf(stderr, "Invalid value of argument. Mask must be between 0 and 32.\n");
       goto cleanup;
    }
+   if (param.src_mask6 > 128 || param.dst_mask6 > 128) {
+      fprintf(stderr, "Invalid value of argument. IPv6 mask must be between 0 and 128.\n");
+      goto cleanup;
+   }
 
-   b_plus_tree = bpt_init(NUM_OF_ITEMS_IN_TREE_LEAF, &compare_32b, sizeof(dst_addr_record_t), sizeof(uint32_t));
-   if (b_plus_tree == NULL) {
-      fprintf(stderr, "ERROR: Could not initialize B_PLUS_TREE\n");
+   table = ip_table_init(DST_TABLE_INITIAL_SIZE, sizeof(ip_addr_t), sizeof(dst_addr_record_t));
+   if (table == NULL) {
+      fprintf(stderr, "ERROR: Could not initialize table of destination records\n");
       goto cleanup;
    }
 
@@ -703,19 +733,13 @@ int main(int argc, char **argv)
 
       src_ip = &ur_get(in_tmplt, in_rec, F_SRC_IP);
       dst_ip = &ur_get(in_tmplt, in_rec, F_DST_IP);
-      src_ip->ui32[2] &= htonl((uint32_t)0xffffffff << (32 - param.src_mask));
-      dst_ip->ui32[2] &= htonl((uint32_t)0xffffffff << (32 - param.dst_mask));
-
-
-      /* Filter ip_v4 addresses only. */
-      if (ip_is4(dst_ip) != 1) {
-         continue;
-      }
+      mask_address(src_ip, param.src_mask, param.src_mask6);
+      mask_address(dst_ip, param.dst_mask, param.dst_mask6);
 
       #ifdef DEBUG2
       char addr[64];
       ip_to_str(src_ip, addr);
-      printf("%s\t(%u)\t",addr, get_index(src_ip));
+      printf("%s\t(%016" PRIx64 ")\t",addr, src_sketch_hash(src_ip));
       ip_to_str(dst_ip, addr);
       printf("->%s\t",addr);
       printf("(%lu)\n",ur_get(in_tmplt, in_rec, F_BYTES));
@@ -748,8 +772,8 @@ int main(int argc, char **argv)
             }
             current_time = flow_end;
 
-            /* Delete and re-create whole B+ tree */
-            if (delete_tree(b_plus_tree, out_tmplt, out_rec) != true) {
+            /* Delete all records */
+            if (delete_records(table, out_tmplt, out_rec) != true) {
                goto cleanup;
             }
 
@@ -758,34 +782,31 @@ int main(int argc, char **argv)
              * (or equal to) the flow end.
              */
             current_int_start = flow_end - flow_end % INTERVAL;
-
-            b_plus_tree = NULL;
-            b_plus_tree = bpt_init(NUM_OF_ITEMS_IN_TREE_LEAF, &compare_32b, sizeof(dst_addr_record_t), sizeof(uint32_t));
-            if (b_plus_tree == NULL) {
-               fprintf(stderr, "ERROR: Could not reinitialize B_PLUS_TREE\n");
-               goto cleanup;
-            }
+            current_int_idx = (current_int_start / INTERVAL) % N_INTERVALS;
          }
          /* Set current_time to the end timestamp of the current flow. */
          current_time = flow_end;
       }
 
-      /* Move time windows if necessary. */
+      /*
+       * Move the current interval if necessary, windows of records are moved
+       * when they are updated or swept.
+       */
       if (current_time >= current_int_start + INTERVAL) {
          int move = (current_time - current_int_start) / INTERVAL;
-         if (move_window(move, b_plus_tree, out_tmplt, out_rec) == false) {
-            goto cleanup;
-         }
-         current_int_idx = (current_int_idx + move) % N_INTERVALS;
          current_int_start += INTERVAL * move;
+         current_int_idx = (current_int_start / INTERVAL) % N_INTERVALS;
+      }
+      if (sweep_records(table, out_tmplt, out_rec) == false) {
+         goto cleanup;
       }
 
       /* Search the records for dst_ip. */
-      key = ip_get_v4_as_int(dst_ip);
+      key = *dst_ip;
 
-      void *new_item = bpt_search_or_insert(b_plus_tree, &key);
+      void *new_item = ip_table_search_or_insert(table, &key);
       if (new_item == NULL) {
-         fprintf(stderr, "ERROR: could not allocate dst_addr_record_t structure in leaf node of the B+ tree.\n");
+         fprintf(stderr, "ERROR: could not allocate dst_addr_record_t structure in the table of destination records.\n");
          goto cleanup;
       }
 
@@ -806,14 +827,19 @@ int main(int argc, char **argv)
       assert(flow_end < current_int_start + INTERVAL);
 
       dst_addr_record_t *rec = new_item;
+      bool expired;
 
-      uint32_t src_ip_idx = get_index(src_ip);
-      uint32_t src_ip_bit = src_ip_idx % 8;
-      src_ip_idx /= 8;
+      if (move_window(rec, &expired, out_tmplt, out_rec) == false) {
+         goto cleanup;
+      }
+      if (expired) {
+         /* Start again as a new record (its sketch is already cleared). */
+         memset(rec, 0, sizeof(dst_addr_record_t));
+         rec->int_num = current_int_start / INTERVAL;
+      }
 
-      if ((rec->src_ip_table[src_ip_idx] & (1 << src_ip_bit)) == 0) {
-         rec->src_ip_table[src_ip_idx] |= (1 << src_ip_bit);
-         rec->src_ip_per_int[current_int_idx]++;
+      if (src_sketch_add(&rec->src_ip_sketch, src_sketch_hash(src_ip))) {
+         rec->src_ip_per_int[current_int_idx] = src_sketch_count(&rec->src_ip_sketch);
       }
 
       for (i = 0; i < N_INTERVALS && bytes > 0; ++i) {
@@ -905,7 +931,7 @@ int main(int argc, char **argv)
                rec->flood_info->last_reported = current_int_start - INTERVAL * relative_flood_begin;
                rec->flood_info->dst_ip = key;
                rec->flood_info->uuid = (uint64_t) rand() << 32;
-               rec->flood_info->uuid += (uint32_t) key;
+               rec->flood_info->uuid += get_address_id(&key);
                break;
             }
          }
@@ -913,48 +939,29 @@ int main(int argc, char **argv)
    }
 
    #ifdef DEBUG1
-   /* End - print whole tree */
+   /* End - print whole table */
    printf("--- END - printing all records ---\n");
-   /* Create a structure for iterating through the leaves */
-   bpt_list_item_t *b_item = bpt_list_init(b_plus_tree);
-   if (b_item == NULL) {
-      fprintf(stderr, "ERROR: could not initialize a list iterator structure\n");
-      goto cleanup;
-   }
 
    dst_addr_record_t *rec = NULL;
-   int has_next = 0;
+   uint32_t idx;
 
-   /*
-    * Get first value from the list. Function returns 1 if there are more
-    * values, 0 if there is no value.
-    */
-   has_next = bpt_list_start(b_plus_tree, b_item);
-   while (has_next == 1) {
-      /* Get the value from B+ item structure. */
-      rec = b_item->value;
-      if (rec == NULL) {
-         /* There is problem in the tree. This case should be unreachable. */
-         fprintf(stderr, "ERROR during iteration through the tree. Value is NULL\n");
-         bpt_list_clean(b_item);
-         goto cleanup;
-      }
-      /* Convert key to IP address and print. */
+   for (idx = ip_table_first(table); idx < table->size; idx = ip_table_next(table, idx)) {
+      rec = ip_table_value(table, idx);
+      /* Convert key to string and print. */
       char addr[64];
-      ip_addr_t ip_key = ip_from_int( *(uint32_t *) (b_item->key));
-      ip_to_str(&ip_key, addr);
+      ip_to_str(ip_table_key(table, idx), addr);
       printf("%s  %lu\t\n", addr, rec->total);
-
-      has_next = bpt_list_item_next(b_plus_tree, b_item);
    }
-   bpt_list_clean(b_item);
    #endif
 
    /***** Cleanup *****/
 cleanup:
    fflush(stderr);
 
-   delete_tree(b_plus_tree, out_tmplt, out_rec);
+   if (table != NULL) {
+      delete_records(table, out_tmplt, out_rec);
+      ip_table_destroy(table);
+   }
 
    /* Do all the necessary cleanup in libtrap before exiting. */
    TRAP_DEFAULT_FINALIZATION();
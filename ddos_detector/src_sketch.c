@@ -0,0 +1,131 @@
+/**
+ * \file src_sketch.c
+ * \brief Sketch counting unique source addresses for ddos_detector.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "src_sketch.h"
+
+uint64_t src_sketch_hash(const ip_addr_t *ip)
+{
+   return hll_hash(ip, sizeof(ip_addr_t));
+}
+
+/**
+ * Update register by hash, returns true if the register was increased.
+ */
+static bool add_to_registers(src_sketch_t *sketch, uint64_t hash)
+{
+   hll_t hll = hll_view(sketch->registers, SRC_SKETCH_PRECISION, 8);
+   uint8_t old;
+   uint8_t rank = hll_add(&hll, hash, &old);
+
+   if (rank == 0) {
+      return false;
+   }
+   if (old == 0) {
+      sketch->zeros--;
+   }
+   sketch->inv_sum += ldexp(1.0, -rank) - ldexp(1.0, -old);
+   return true;
+}
+
+bool src_sketch_add(src_sketch_t *sketch, uint64_t hash)
+{
+   int i;
+
+   if (sketch->dense) {
+      return add_to_registers(sketch, hash);
+   }
+
+   for (i = 0; i < sketch->sparse_cnt; ++i) {
+      if (sketch->sparse[i] == hash) {
+         return false;
+      }
+   }
+   if (sketch->sparse_cnt < SRC_SKETCH_SPARSE_SIZE) {
+      sketch->sparse[sketch->sparse_cnt++] = hash;
+      return true;
+   }
+
+   /* Sparse list is full, switch to HyperLogLog registers (zeroed if kept by reset). */
+   if (sketch->registers == NULL) {
+      sketch->registers = (uint8_t *) calloc(SRC_SKETCH_REGISTERS, sizeof(uint8_t));
+      if (sketch->registers == NULL) {
+         fprintf(stderr, "ERROR: could not allocate registers of source sketch.\n");
+         return false;
+      }
+   }
+   sketch->dense = true;
+   sketch->zeros = SRC_SKETCH_REGISTERS;
+   sketch->inv_sum = SRC_SKETCH_REGISTERS;
+   for (i = 0; i < sketch->sparse_cnt; ++i) {
+      add_to_registers(sketch, sketch->sparse[i]);
+   }
+   add_to_registers(sketch, hash);
+   return true;
+}
+
+uint32_t src_sketch_count(const src_sketch_t *sketch)
+{
+   if (!sketch->dense) {
+      return sketch->sparse_cnt;
+   }
+   return hll_estimate_sum(SRC_SKETCH_PRECISION, sketch->inv_sum, sketch->zeros);
+}
+
+void src_sketch_reset(src_sketch_t *sketch)
+{
+   if (sketch->dense) {
+      hll_t hll = hll_view(sketch->registers, SRC_SKETCH_PRECISION, 8);
+      hll_clear(&hll);
+   }
+   sketch->dense = false;
+   sketch->sparse_cnt = 0;
+}
+
+void src_sketch_clear(src_sketch_t *sketch)
+{
+   free(sketch->registers);
+   memset(sketch, 0, sizeof(src_sketch_t));
+}
@@ -0,0 +1,93 @@
+/**
+ * \file src_sketch.h
+ * \brief Sketch counting unique source addresses for ddos_detector.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef DDOS_DETECTOR_SRC_SKETCH_H
+#define DDOS_DETECTOR_SRC_SKETCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <unirec/unirec.h>
+#include "hll.h"
+
+/* Number of distinct sources counted exactly before switching to HyperLogLog. */
+#define SRC_SKETCH_SPARSE_SIZE 8
+
+/* Precision of HyperLogLog (number of index bits), standard error is about 3%. */
+#define SRC_SKETCH_PRECISION 10
+
+/* Number of HyperLogLog registers. */
+#define SRC_SKETCH_REGISTERS (1 << SRC_SKETCH_PRECISION)
+
+/**
+ * Number of unique sources. Few sources are kept as exact list of their
+ * hashes inline, registers of HyperLogLog (common hll) are allocated when
+ * the list is full and kept by src_sketch_reset for the next interval.
+ * The estimate is maintained incrementally, so reading it is O(1).
+ */
+typedef struct src_sketch_s {
+   uint64_t sparse[SRC_SKETCH_SPARSE_SIZE]; /**< Hashes of sources in sparse mode. */
+   uint8_t *registers; /**< HyperLogLog registers, NULL until first needed. */
+   double inv_sum; /**< Sum of 2^-register over all registers. */
+   uint16_t zeros; /**< Number of zero registers. */
+   uint8_t sparse_cnt; /**< Number of hashes in sparse list. */
+   bool dense; /**< Sources are counted by the registers. */
+} src_sketch_t;
+
+/** 64 bit hash of (masked) source address (hll_hash). */
+uint64_t src_sketch_hash(const ip_addr_t *ip);
+
+/**
+ * Add hash of a source to the sketch. Returns true if the count could change.
+ * On memory error the sketch stays in sparse mode and the count saturates.
+ */
+bool src_sketch_add(src_sketch_t *sketch, uint64_t hash);
+
+/** Estimated number of unique sources added to the sketch. */
+uint32_t src_sketch_count(const src_sketch_t *sketch);
+
+/** Remove all sources from the sketch, its registers are zeroed and kept. */
+void src_sketch_reset(src_sketch_t *sketch);
+
+/** Remove all sources from the sketch (and free its registers). */
+void src_sketch_clear(src_sketch_t *sketch);
+
+#endif /* DDOS_DETECTOR_SRC_SKETCH_H */
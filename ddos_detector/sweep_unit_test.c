@@ -0,0 +1,216 @@
+/**
+ * \file sweep_unit_test.c
+ * \brief Unit test of expiry of ddos_detector records, their sketches must be freed.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * Registers of the sketches are counted, so that a record expired with a
+ * dense sketch is seen to free them. The translation units are included with
+ * the allocation functions and main() renamed.
+ */
+static long live_allocations = 0;
+
+static void *counted_calloc(size_t nmemb, size_t size)
+{
+   void *ptr = calloc(nmemb, size);
+   if (ptr != NULL) {
+      live_allocations++;
+   }
+   return ptr;
+}
+
+static void counted_free(void *ptr)
+{
+   if (ptr != NULL) {
+      live_allocations--;
+   }
+   free(ptr);
+}
+
+#define calloc counted_calloc
+#define free counted_free
+#include "src_sketch.c"
+#define main ddos_detector_main
+#include "ddos_detector.c"
+#undef main
+#undef free
+#undef calloc
+
+#define RECORD_CNT 1000
+#define SOURCE_CNT 100
+
+static int fail_counter = 0;
+
+#define CHECK(cond, msg) { if (!(cond)) { fprintf(stderr, "FAIL: %s\n", msg); fail_counter++; } }
+
+static void set_current_time(uint32_t time)
+{
+   current_time = time;
+   current_int_start = time - time % INTERVAL;
+   current_int_idx = (current_int_start / INTERVAL) % N_INTERVALS;
+}
+
+/** Add sources to the record until its sketch is dense. */
+static void add_sources(dst_addr_record_t *rec, uint32_t seed)
+{
+   uint32_t i;
+
+   for (i = 0; i < SOURCE_CNT; ++i) {
+      ip_addr_t src = ip_from_int(seed * SOURCE_CNT + i);
+      src_sketch_add(&rec->src_ip_sketch, src_sketch_hash(&src));
+   }
+}
+
+static ip_table_t *fill_table(uint32_t start)
+{
+   ip_table_t *table = ip_table_init(DST_TABLE_INITIAL_SIZE, sizeof(ip_addr_t), sizeof(dst_addr_record_t));
+   bool expired;
+   uint32_t i;
+
+   set_current_time(start);
+   for (i = 0; i < RECORD_CNT; ++i) {
+      ip_addr_t key = ip_from_int(0x0a000000 + i);
+      dst_addr_record_t *rec = ip_table_search_or_insert(table, &key);
+      move_window(rec, &expired, NULL, NULL);
+      add_sources(rec, i);
+   }
+   return table;
+}
+
+/**
+ * Records without traffic are swept out of the table after their windows
+ * pass, the registers of their dense sketches must be freed.
+ */
+static void test_sweep(void)
+{
+   ip_table_t *table = fill_table(1000000);
+   uint32_t i;
+
+   CHECK(table->count == RECORD_CNT, "records inserted");
+   CHECK(live_allocations == RECORD_CNT, "sketches of records are dense");
+
+   /* Every slot is swept within size / SWEEP_SLOTS_PER_FLOW flows. */
+   set_current_time(1000000 + (N_INTERVALS + 1) * INTERVAL);
+   for (i = 0; i <= table->size / SWEEP_SLOTS_PER_FLOW; ++i) {
+      CHECK(sweep_records(table, NULL, NULL), "sweep without errors");
+   }
+   CHECK(table->count == 0, "records swept out");
+   CHECK(live_allocations == 0, "registers of swept records freed");
+
+   ip_table_destroy(table);
+}
+
+/**
+ * A record updated after its windows passed starts again with an empty
+ * sketch, its registers are freed and allocated again when needed.
+ */
+static void test_update_expired(void)
+{
+   ip_table_t *table = fill_table(2000000);
+   bool expired;
+   uint32_t i;
+
+   set_current_time(2000000 + (N_INTERVALS + 1) * INTERVAL);
+   for (i = 0; i < RECORD_CNT; ++i) {
+      ip_addr_t key = ip_from_int(0x0a000000 + i);
+      dst_addr_record_t *rec = ip_table_search(table, &key);
+      move_window(rec, &expired, NULL, NULL);
+      CHECK(expired, "record expired");
+      CHECK(rec->src_ip_sketch.registers == NULL && !rec->src_ip_sketch.dense, "sketch of expired record cleared");
+   }
+   CHECK(live_allocations == 0, "registers of expired records freed");
+
+   CHECK(delete_records(table, NULL, NULL), "delete without errors");
+   ip_table_destroy(table);
+}
+
+/**
+ * Records with traffic keep their registers when the windows move, they
+ * are freed when all records are deleted.
+ */
+static void test_keep_and_delete(void)
+{
+   ip_table_t *table = fill_table(3000000);
+   bool expired;
+   uint32_t i;
+
+   param.min_threshold_pruning = 0;
+   for (i = 0; i < RECORD_CNT; ++i) {
+      ip_addr_t key = ip_from_int(0x0a000000 + i);
+      dst_addr_record_t *rec = ip_table_search(table, &key);
+      rec->bytes_per_int[current_int_idx] = 1000;
+      rec->total = 1000;
+   }
+   set_current_time(3000000 + INTERVAL);
+   for (i = 0; i <= table->size / SWEEP_SLOTS_PER_FLOW; ++i) {
+      CHECK(sweep_records(table, NULL, NULL), "sweep without errors");
+   }
+   CHECK(table->count == RECORD_CNT, "records with traffic kept");
+   CHECK(live_allocations == RECORD_CNT, "registers kept for the next interval");
+
+   for (i = 0; i < RECORD_CNT; ++i) {
+      ip_addr_t key = ip_from_int(0x0a000000 + i);
+      dst_addr_record_t *rec = ip_table_search(table, &key);
+      move_window(rec, &expired, NULL, NULL);
+      CHECK(!expired && src_sketch_count(&rec->src_ip_sketch) == 0, "sketch reset in the new interval");
+   }
+
+   CHECK(delete_records(table, NULL, NULL), "delete without errors");
+   CHECK(live_allocations == 0, "registers of deleted records freed");
+   ip_table_destroy(table);
+}
+
+int main(void)
+{
+   test_sweep();
+   test_update_expired();
+   test_keep_and_delete();
+
+   if (fail_counter > 0) {
+      fprintf(stderr, "%d test(s) failed\n", fail_counter);
+      return 1;
+   }
+   return 0;
+}
@@ -53,9 +53,10 @@
 #include <libtrap/trap.h>
 #include <unirec/unirec.h>
 #include "fields.h"
-#include <b_plus_tree.h>
 #include <stdbool.h>
 #include <time.h>
+#include "ip_table.h"
+#include "ip_wheel.h"
 
 #define MAX_PACKETS 1 // Maximum number of packets in suspicious flow
 
@@ -64,7 +65,8 @@
 #define TCP_PROTOCOL 0x6
 #define TCP_FLAGS_SYN 0x2
 
-#define NUM_OF_ITEMS_IN_TREE_LEAF 5
+#define TABLE_INITIAL_SIZE 4096
+#define EXPIRED_ITEMS_PER_FLOW 16 // Maximum number of expired timers checked per flow
 #define TRUE 1
 #define FALSE 0
 
@@ -109,7 +111,7 @@ trap_module_info_t *module_info = NULL;
 #define MODULE_PARAMS(PARAM) \
    PARAM('n', "numaddrs-threshold", "Send alert after this number of DST_IP are contacted by one SRC_IP × DST_PORT combination (default 50).", required_argument, "uint32") \
    PARAM('d', "idle-threshold", "Discard entry for an SRC_IP × DST_PORT combination after it has been unchanged this many seconds (default 300).", required_argument, "uint16") \
-   PARAM('p', "pruning-interval", "Prune DST_IP tables with this interval in seconds (default 60).", required_argument, "uint16")
+   PARAM('p', "pruning-interval", "Ignored, kept for compatibility (idle entries are pruned continuously).", required_argument, "uint16")
 
 
 static int stop = 0;
@@ -121,10 +123,12 @@ TRAP_DEFAULT_SIGNAL_HANDLER(stop = 1)
 typedef struct item_s item_t;
 
 struct item_s {
-   time_t ts_modified;
+   time_t ts_modified; // TIME_LAST of the last modifying flow (in seconds)
+   time_t ts_queued; // Time of modification when the timer of the key was added
    uint32_t static_addrs[STATIC_ADDR_ARR_SIZE];
-   uint32_t *dynamic_addrs;
-   uint8_t addr_cnt;
+   uint32_t *dynamic_addrs; // Open addressing set of all addresses (0 is empty slot), allocated after STATIC_ADDR_ARR_SIZE addresses
+   uint32_t addr_cnt;
+   uint8_t zero_addr; // Address 0.0.0.0 is in the set of dynamic_addrs
    uint8_t alerted;
    ur_time_t ts_first;
    ur_time_t ts_last;
@@ -145,30 +149,49 @@ typedef struct param_s {
 
 static param_t param;
 
+// Number of slots of sets of addresses is 2^addr_set_bits (at least twice
+// numaddrs_threshold)
+static uint8_t addr_set_bits = 0;
+
 /***********************************************/
 
-int compare_64b(void *a, void *b)
+/**
+ * Function inserts address into the set of dynamic_addrs. Returns 1 if
+ * the address was added, 0 if it is already present.
+ */
+int addr_set_insert(item_t *info, uint32_t addr)
 {
-   uint64_t *h1, *h2;
-   h1 = (uint64_t *) a;
-   h2 = (uint64_t *) b;
-   if (*h1 == *h2) {
-      return EQUAL;
-   } else if (*h1 < *h2) {
-      return LESS;
-   } else {
-      return MORE;
+   uint32_t mask = (1U << addr_set_bits) - 1;
+   uint32_t x;
+
+   if (addr == 0) {
+      if (info->zero_addr) {
+         return 0;
+      }
+      info->zero_addr = TRUE;
+      return 1;
    }
-}
 
+   // Fibonacci hashing, the set is never more than half full so there is
+   // always an empty slot
+   for (x = (uint32_t) (addr * 2654435761U) >> (32 - addr_set_bits);
+        info->dynamic_addrs[x] != 0; x = (x + 1) & mask) {
+      if (info->dynamic_addrs[x] == addr) {
+         return 0;
+      }
+   }
+   info->dynamic_addrs[x] = addr;
+   return 1;
+}
 
 /**
  * Function returns 1 in case of alert, 0 on already present or
- * successful added address and -1 in case of error.
+ * successful added address and -1 in case of error. The ts_flow is
+ * the time of the flow used as the time of modification.
  */
-int insert_addr(void *p, uint32_t int_dst_ip)
+int insert_addr(void *p, uint32_t int_dst_ip, time_t ts_flow)
 {
-   int x = 0;
+   uint32_t x = 0;
    item_t *info = NULL;
 
    if (p == NULL) {
@@ -177,34 +200,37 @@ int insert_addr(void *p, uint32_t int_dst_ip)
 
    info = (item_t *) p;
 
-   for (x = 0; x < info->addr_cnt; x++) {
-      if (x < STATIC_ADDR_ARR_SIZE) {
+   if (info->dynamic_addrs == NULL) {
+      for (x = 0; x < info->addr_cnt; x++) {
          if (info->static_addrs[x] == int_dst_ip) {
-            time(&info->ts_modified); // Update the time of table modification
-            return 0;
-         }
-      } else {
-         if (info->dynamic_addrs[x - STATIC_ADDR_ARR_SIZE] == int_dst_ip) {
-            time(&info->ts_modified); // Update the time of table modification
+            info->ts_modified = ts_flow; // Update the time of table modification
             return 0;
          }
       }
-   }
 
-   if (info->addr_cnt < STATIC_ADDR_ARR_SIZE) {
-      // Insert the new address into first free index
-      info->static_addrs[info->addr_cnt] = int_dst_ip;
-   } else {
-      if (info->addr_cnt == STATIC_ADDR_ARR_SIZE) {
-         // Inserting first address to dynamic array - allocate the
-         // array
-         info->dynamic_addrs = (uint32_t *) calloc((param.numaddrs_threshold - STATIC_ADDR_ARR_SIZE), sizeof(uint32_t));
+      if (info->addr_cnt < STATIC_ADDR_ARR_SIZE) {
+         // Insert the new address into first free index
+         info->static_addrs[info->addr_cnt] = int_dst_ip;
+      } else {
+         // Inserting first address to dynamic set - allocate the set
+         // and move all static addresses to it (static ones are kept
+         // for the alert)
+         info->dynamic_addrs = (uint32_t *) calloc(1U << addr_set_bits, sizeof(uint32_t));
+         if (info->dynamic_addrs == NULL) {
+            return -1;
+         }
+         for (x = 0; x < STATIC_ADDR_ARR_SIZE; x++) {
+            addr_set_insert(info, info->static_addrs[x]);
+         }
+         addr_set_insert(info, int_dst_ip);
       }
-      info->dynamic_addrs[info->addr_cnt - STATIC_ADDR_ARR_SIZE] = int_dst_ip;
+   } else if (addr_set_insert(info, int_dst_ip) == 0) {
+      info->ts_modified = ts_flow; // Update the time of table modification
+      return 0;
    }
 
    info->addr_cnt++;
-   time(&info->ts_modified); // Update the time of table modification
+   info->ts_modified = ts_flow; // Update the time of table modification
 
    if (info->addr_cnt >= param.numaddrs_threshold) {
       info->alerted = TRUE;
@@ -253,10 +279,65 @@ int send_alert(ur_template_t *out_tmplt, void *out_rec,
    return trap_send(0, out_rec, ur_rec_size(out_tmplt, out_rec));
 }
 
+/**
+ * Function adds timer of the key, the item expires when it's not
+ * modified in over idle_threshold after ts. Returns 0 on success and
+ * -1 in case of error.
+ */
+static inline int schedule_item(ip_wheel_t *wheel, uint64_t key, item_t *item, time_t ts)
+{
+   item->ts_queued = ts;
+   return ip_wheel_add(wheel, &key, ts + param.idle_threshold + 1);
+}
+
+/**
+ * Function deletes a few items of the table which weren't modified in
+ * over idle_threshold, the keys are taken from the expired timers.
+ * Items modified in the meantime are scheduled again. Returns 0 on
+ * success, -1 in case of error and 1 if sending of an alert failed.
+ */
+int expire_items(ip_table_t *table, ip_wheel_t *wheel, time_t ts_cur_time,
+                 ur_template_t *out_tmplt, void *out_rec)
+{
+   uint64_t key;
+   uint64_t expires;
+   item_t *value_pt = NULL;
+   int ret_val = TRAP_E_OK;
+   int x;
+
+   for (x = 0; x < EXPIRED_ITEMS_PER_FLOW && ip_wheel_pop(wheel, ts_cur_time, &key, &expires); x++) {
+      value_pt = ip_table_search(table, &key);
+      if (value_pt == NULL || (uint64_t) (value_pt->ts_queued + param.idle_threshold + 1) != expires) {
+         continue; // Item was deleted or the key was scheduled again
+      }
+
+      // Delete the item if it wasn't modified in over
+      // idle_threshold
+      if ((ts_cur_time - value_pt->ts_modified) > param.idle_threshold) {
+         if (value_pt->alerted) {
+            // send alert about trailing scanned addresses
+            ret_val = send_alert(out_tmplt, out_rec, (treekey_t *) &key, value_pt);
+         }
+         // free dynamic array of addresses
+         if (value_pt->dynamic_addrs != NULL) {
+            free(value_pt->dynamic_addrs);
+         }
+         ip_table_delete(table, ip_table_index(table, value_pt));
+         // stop on error, do nothing on timeout in order to
+         // continue pruning
+         TRAP_DEFAULT_SEND_ERROR_HANDLING(ret_val, (void) 0, return 1);
+      } else if (schedule_item(wheel, key, value_pt, value_pt->ts_modified) != 0) {
+         fprintf(stderr, "ERROR: could not allocate timer wheel.\n");
+         return -1;
+      }
+   }
+   return 0;
+}
+
 int main(int argc, char **argv)
 {
-   time_t ts_last_pruning;
-   time_t ts_cur_time;
+   time_t ts_cur_time = 0;
+   time_t ts_flow;
    signed char opt;
    int ret_val = 0;
    const void *recv_data;
@@ -279,14 +360,16 @@ int main(int argc, char **argv)
    param.idle_threshold = 5 * 60;
    param.pruning_interval = 1 * 60;
 
-   bpt_t *b_plus_tree = bpt_init(NUM_OF_ITEMS_IN_TREE_LEAF, &compare_64b, sizeof(item_t), sizeof(uint64_t));
-   if (b_plus_tree == NULL) {
-      fprintf(stderr, "ERROR: Could not initialize B_PLUS_TREE\n");
+   ip_table_t *table = ip_table_init(TABLE_INITIAL_SIZE, sizeof(uint64_t), sizeof(item_t));
+   if (table == NULL) {
+      fprintf(stderr, "ERROR: Could not initialize table of sources\n");
       fflush(stderr);
       return 0;
    }
    void *new_item = NULL;
    item_t *np = NULL;
+   ip_wheel_t wheel;
+   ip_wheel_init(&wheel, sizeof(uint64_t));
 
    ur_template_t *out_tmplt = NULL, *in_tmplt = NULL;
    void *out_rec = NULL;
@@ -354,6 +437,11 @@ int main(int argc, char **argv)
       return -1;
    }
 
+   // Size of sets of addresses, the alert is sent before a set is more
+   // than half full
+   for (addr_set_bits = 4; addr_set_bits < 31
+        && (1ULL << addr_set_bits) < 2ULL * param.numaddrs_threshold; addr_set_bits++);
+
    // ***** Create UniRec templates *****
    in_tmplt = ur_create_input_template(0, NULL, NULL);
    if (in_tmplt == NULL){
@@ -383,9 +471,6 @@ int main(int argc, char **argv)
 
    trap_ifcctl(TRAPIFC_OUTPUT, 0, TRAPCTL_SETTIMEOUT, TRAP_NO_WAIT);
 
-   // Initialize time of last pruning of the B+ tree
-   time(&ts_last_pruning);
-
    while (!stop) {
       ret_val = TRAP_RECEIVE(0, recv_data, recv_data_size, in_tmplt);
       TRAP_DEFAULT_RECV_ERROR_HANDLING(ret_val, continue, break);
@@ -402,6 +487,13 @@ int main(int argc, char **argv)
          }
       }
 
+      // Current time is the latest TIME_LAST of flows, so that the
+      // timeouts work the same for data read from files
+      ts_flow = ur_time_get_sec(ur_get(in_tmplt, recv_data, F_TIME_LAST));
+      if (ts_flow > ts_cur_time) {
+         ts_cur_time = ts_flow;
+      }
+
       src_ip = &ur_get(in_tmplt, recv_data, F_SRC_IP);
       dst_ip = &ur_get(in_tmplt, recv_data, F_DST_IP);
 
@@ -411,29 +503,37 @@ int main(int argc, char **argv)
       }
 
       packets = ur_get(in_tmplt, recv_data, F_PACKETS);
-      dst_port = ur_get(in_tmplt, recv_data, F_DST_PORT); // key to B+ tree
+      dst_port = ur_get(in_tmplt, recv_data, F_DST_PORT); // key to the table
       protocol = ur_get(in_tmplt, recv_data, F_PROTOCOL);
       tcp_flags = ur_get(in_tmplt, recv_data, F_TCP_FLAGS);
 
-      int_src_ip = ip_get_v4_as_int(src_ip); // also key to B+ tree
+      int_src_ip = ip_get_v4_as_int(src_ip); // also key to the table
       int_dst_ip = ip_get_v4_as_int(dst_ip);
 
       // Concatenate ip_v4 SRC_IP and DST_PORT to uint64 (used as a
-      // key value in B+ tree)
+      // key in the table)
       key_to_tree.fields.src_ip = int_src_ip;
       key_to_tree.fields.dst_port = dst_port;
 
       if (packets == MAX_PACKETS && (protocol == TCP_PROTOCOL && (tcp_flags == TCP_FLAGS_SYN))) {
-         new_item = bpt_search_or_insert(b_plus_tree, &(key_to_tree.key));
+         new_item = ip_table_search_or_insert(table, &(key_to_tree.key));
          if (new_item == NULL) {
             fprintf(stderr,
-                    "ERROR: could not allocate port-scan info structure in leaf node of the B+ tree.\n");
+                    "ERROR: could not allocate port-scan info structure in the table.\n");
             fflush(stderr);
             goto cleanup;
          }
          ts_first = ur_get(in_tmplt, recv_data, F_TIME_FIRST);
          ts_last = ur_get(in_tmplt, recv_data, F_TIME_LAST);
          np = (item_t *) new_item;
+         if (np->ts_modified == 0) {
+            // New item - schedule its expiration
+            if (schedule_item(&wheel, key_to_tree.key, np, ur_time_get_sec(ts_last)) != 0) {
+               fprintf(stderr, "ERROR: could not allocate timer wheel.\n");
+               fflush(stderr);
+               goto cleanup;
+            }
+         }
          if (np->addr_cnt == 0) {
             // New or just reported item
             np->ts_first = ts_first;
@@ -447,7 +547,12 @@ int main(int argc, char **argv)
             }
          }
 
-         if (insert_addr(new_item, int_dst_ip) == 1) {
+         ret_val = insert_addr(new_item, int_dst_ip, ur_time_get_sec(ts_last));
+         if (ret_val == -1) {
+            fprintf(stderr, "ERROR: could not allocate set of addresses.\n");
+            fflush(stderr);
+            goto cleanup;
+         } else if (ret_val == 1) {
             // Scan detected
             ret_val = send_alert(out_tmplt, out_rec, &key_to_tree, np);
             // free dynamic array of addresses
@@ -458,9 +563,10 @@ int main(int argc, char **argv)
             // clear scanned addresses regardless of whether
             // trap_send() was successful
             np->addr_cnt = 0;
+            np->zero_addr = FALSE;
             memset(np->static_addrs, 0, sizeof(uint32_t) * STATIC_ADDR_ARR_SIZE);
             // break on error, do nothing on timeout in order to
-            // perform tree pruning
+            // perform table pruning
             TRAP_DEFAULT_SEND_ERROR_HANDLING(ret_val, (void) 0, break);
          }
 
@@ -468,62 +574,19 @@ int main(int argc, char **argv)
          // flow of unsatisfied condition (TCP, packet number)
       }
 
-      // B+ tree pruning
-      time(&ts_cur_time);
-      if ((ts_cur_time - ts_last_pruning) > param.pruning_interval) {
-         item_t *value_pt = NULL;
-         bpt_list_item_t *b_item = NULL;
-         int has_next = 0;
-
-         // Create a structure for iterating throw the leaves
-         b_item = bpt_list_init(b_plus_tree);
-         if (b_item == NULL) {
-            fprintf(stderr, "ERROR: could not initialize a list iterator structure\n");
-            goto cleanup;
-         }
-
-         printf("==== PRUNING THE TREE ====\noriginal number of values: %lu\n", bpt_item_cnt(b_plus_tree));
-
-         // Get first value from the list. Function returns 1 if there
-         // are more values, 0 if there is no value
-         has_next = bpt_list_start(b_plus_tree, b_item);
-         while (has_next == TRUE) {
-            // Get the value from B+ item structure
-            value_pt = b_item->value;
-            if (value_pt == NULL) {
-               //there is problem in the tree. This case should be
-               //unreachable
-               fprintf(stderr, "ERROR during iteration through the tree. Value is NULL\n");
-               goto cleanup;
-            }
-
-            // Delete the item if it wasn't modified in over
-            // idle_threshold
-            if ((ts_cur_time - value_pt->ts_modified) > param.idle_threshold) {
-               if (value_pt->alerted) {
-                  // send alert about trailing scanned addresses
-                  ret_val = send_alert(out_tmplt, out_rec, (treekey_t *) b_item->key, value_pt);
-               }
-               // free dynamic array of addresses
-               if (value_pt->dynamic_addrs != NULL) {
-                  free(value_pt->dynamic_addrs);
-               }
-               has_next = bpt_list_item_del(b_plus_tree, b_item);
-               // break on error, do nothing on timeout in order to
-               // continue tree pruning
-               TRAP_DEFAULT_SEND_ERROR_HANDLING(ret_val, (void) 0, break);
-            } else { // Get next item from the list
-               has_next = bpt_list_item_next(b_plus_tree, b_item);
-            }
-         }
-         printf("\nnumber of values after pruning: %lu\n", bpt_item_cnt(b_plus_tree));
-         time(&ts_last_pruning);
+      // Table pruning - a few items with expired timers
+      ret_val = expire_items(table, &wheel, ts_cur_time, out_tmplt, out_rec);
+      if (ret_val == -1) {
+         goto cleanup;
+      } else if (ret_val == 1) {
+         break;
       }
    }
 
    // ***** Cleanup *****
 cleanup:
-   bpt_clean(b_plus_tree);
+   ip_table_destroy(table);
+   ip_wheel_destroy(&wheel);
    ur_free_template(in_tmplt);
    ur_free_template(out_tmplt);
    ur_free_record(out_rec);
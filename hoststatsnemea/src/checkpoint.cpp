@@ -0,0 +1,263 @@
+/**
+ * \file checkpoint.cpp
+ * \brief Saving and loading of the statistics table to/from a checkpoint file
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include "checkpoint.h"
+#include "profile.h"
+#include "aux_func.h"
+
+#define CHECKPOINT_BUFFER_SIZE (1024 * 1024)  // Size of the stdio buffer
+
+/** \brief Save all records of the table to the checkpoint file
+ * The checkpoint is written to a temporary file which replaces the previous
+ * checkpoint when it is complete. Nothing is saved before the records of the
+ * previous checkpoint are loaded.
+ * \param now Current time of the module
+ * \return True on success, false otherwise
+ */
+bool HostProfile::save_checkpoint(uint32_t now)
+{
+   if (checkpoint_file.empty() || !__atomic_load_n(&checkpoint_ready, __ATOMIC_ACQUIRE)) {
+      return false;
+   }
+
+   string tmp_file = checkpoint_file + ".tmp";
+   FILE *file = fopen(tmp_file.c_str(), "wb");
+   if (file == NULL) {
+      log(LOG_ERR, "Error: Failed to create the checkpoint file '%s'.",
+         tmp_file.c_str());
+      return false;
+   }
+   setvbuf(file, NULL, _IOFBF, CHECKPOINT_BUFFER_SIZE);
+
+   checkpoint_header_t header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+   header.version = CHECKPOINT_VERSION;
+   header.saved_time = now;
+   header.key_size = sizeof(hosts_key_t);
+   header.record_size = sizeof(hosts_record_t);
+   header.ssh_size = sizeof(ssh_data_t);
+   header.dns_size = sizeof(dns_data_t);
+   bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+   StatTableIter *table_iter = new StatTableIter(*stat_table);
+   if (!table_iter->valid()) {
+      ok = false;
+   }
+
+   // Every row is locked by the iterator while its records are written
+   while (ok && table_iter->next()) {
+      const hosts_key_t &key = table_iter->key();
+      hosts_record_t rec = table_iter->record();
+      const ssh_data_t *ssh = rec.ssh_data;
+      const dns_data_t *dns = rec.dns_data;
+      rec.ssh_data = NULL;
+      rec.dns_data = NULL;
+
+      uint8_t flags = 0;
+      if (ssh != NULL) flags |= CHECKPOINT_F_SSH;
+      if (dns != NULL) flags |= CHECKPOINT_F_DNS;
+
+      ok = fwrite(&key, sizeof(key), 1, file) == 1 &&
+         fwrite(&rec, sizeof(rec), 1, file) == 1 &&
+         fwrite(&flags, sizeof(flags), 1, file) == 1 &&
+         (ssh == NULL || fwrite(ssh, sizeof(*ssh), 1, file) == 1) &&
+         (dns == NULL || fwrite(dns, sizeof(*dns), 1, file) == 1);
+      ++header.count;
+   }
+
+   delete table_iter;
+
+   // The number of records is known at the end
+   ok = ok && fseek(file, 0, SEEK_SET) == 0 &&
+      fwrite(&header, sizeof(header), 1, file) == 1;
+   if (fclose(file) != 0) {
+      ok = false;
+   }
+
+   if (!ok || rename(tmp_file.c_str(), checkpoint_file.c_str()) != 0) {
+      log(LOG_ERR, "Error: Failed to save the checkpoint to '%s'.",
+         checkpoint_file.c_str());
+      unlink(tmp_file.c_str());
+      return false;
+   }
+
+   log(LOG_INFO, "Checkpoint with %lu records saved to '%s'.",
+      (unsigned long) header.count, checkpoint_file.c_str());
+   return true;
+}
+
+/** \brief Load records from the checkpoint file into the table
+ * Timestamps of the records are shifted by the time elapsed since the
+ * checkpoint was saved, so the records expire the same time after the start as
+ * they would after the save. Hosts updated by new flows before their records
+ * are loaded keep the new records. A checkpoint older than the active timeout
+ * is ignored.
+ * \param now Current time of the module
+ * \return True if the checkpoint was loaded, false otherwise
+ */
+bool HostProfile::load_checkpoint(uint32_t now)
+{
+   bool ok = false;
+   uint64_t loaded = 0;
+   uint64_t i = 0;
+   uint32_t shift;
+   checkpoint_header_t header;
+
+   FILE *file = fopen(checkpoint_file.c_str(), "rb");
+   if (file == NULL) {
+      log(LOG_INFO, "No checkpoint '%s' to load.", checkpoint_file.c_str());
+      goto done;
+   }
+   setvbuf(file, NULL, _IOFBF, CHECKPOINT_BUFFER_SIZE);
+
+   if (fread(&header, sizeof(header), 1, file) != 1 ||
+       memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 ||
+       header.version != CHECKPOINT_VERSION ||
+       header.key_size != sizeof(hosts_key_t) ||
+       header.record_size != sizeof(hosts_record_t) ||
+       header.ssh_size != sizeof(ssh_data_t) ||
+       header.dns_size != sizeof(dns_data_t)) {
+      log(LOG_ERR, "Error: '%s' is not a checkpoint of this version of the "
+         "module.", checkpoint_file.c_str());
+      goto done;
+   }
+
+   shift = (now > header.saved_time) ? now - header.saved_time : 0;
+   if (shift > (uint32_t) active_timeout) {
+      log(LOG_WARNING, "Warning: Checkpoint '%s' is older than the active "
+         "timeout, it is not loaded.", checkpoint_file.c_str());
+      goto done;
+   }
+
+   for (i = 0; i < header.count; ++i) {
+      hosts_key_t key;
+      hosts_record_t rec;
+      uint8_t flags;
+      if (fread(&key, sizeof(key), 1, file) != 1 ||
+          fread(&rec, sizeof(rec), 1, file) != 1 ||
+          fread(&flags, sizeof(flags), 1, file) != 1) {
+         break;
+      }
+
+      rec.ssh_data = NULL;
+      rec.dns_data = NULL;
+      bool complete = true;
+      if (flags & CHECKPOINT_F_SSH) {
+         rec.ssh_data = new ssh_data_t;
+         complete = fread(rec.ssh_data, sizeof(ssh_data_t), 1, file) == 1;
+      }
+      if (complete && (flags & CHECKPOINT_F_DNS)) {
+         rec.dns_data = new dns_data_t;
+         complete = fread(rec.dns_data, sizeof(dns_data_t), 1, file) == 1;
+      }
+
+      rec.first_rec_ts += shift;
+      rec.last_rec_ts += shift;
+
+      if (!complete || !insert_record(key, rec)) {
+         delete rec.ssh_data;
+         delete rec.dns_data;
+      } else {
+         ++loaded;
+      }
+
+      if (!complete) {
+         break;
+      }
+   }
+
+   if (i != header.count) {
+      log(LOG_ERR, "Error: Checkpoint '%s' is truncated.", checkpoint_file.c_str());
+   }
+   log(LOG_INFO, "Loaded %lu of %lu records from checkpoint '%s'.",
+      (unsigned long) loaded, (unsigned long) header.count,
+      checkpoint_file.c_str());
+   ok = true;
+
+done:
+   if (file != NULL) {
+      fclose(file);
+   }
+
+   // New checkpoints can replace the loaded one
+   __atomic_store_n(&checkpoint_ready, true, __ATOMIC_RELEASE);
+   return ok;
+}
+
+/** \brief Insert the loaded record into the table
+ * \param key Key of the record
+ * \param record Record (the table takes the ownership of its subprofiles)
+ * \return False if the table already contains a record of the host
+ */
+bool HostProfile::insert_record(const hosts_key_t &key, const hosts_record_t &record)
+{
+   stat_lock_t lock;
+   if (stat_table->find(key, lock) != NULL) {
+      // The host has already been updated by new flows
+      stat_table->unlock(lock);
+      return false;
+   }
+
+   hosts_key_t kicked_key;       // for possibly kicked key
+   hosts_record_t kicked_data;   // for possibly kicked data
+   int rc = stat_table->insert(key, record, kicked_key, kicked_data);
+
+   switch (rc) {
+   case FHT_INSERT_STASH_LOST:
+   case FHT_INSERT_LOST:
+      // Another item was kicked out of the table
+      drop_record(kicked_key, kicked_data);
+      break;
+   case FHT_INSERT_FAILED:
+      // Something managed to insert the host sooner
+      return false;
+   default:
+      break;
+   }
+
+   timers->add(key, record.first_rec_ts, expiration(record));
+   return true;
+}
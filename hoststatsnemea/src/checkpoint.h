@@ -0,0 +1,75 @@
+/**
+ * \file checkpoint.h
+ * \brief Format of the checkpoint file with records of the statistics table
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <stdint.h>
+
+#define CHECKPOINT_MAGIC    "HSCP"
+#define CHECKPOINT_VERSION  2 // 2: sketches use the registers of common hll
+
+// Flags of a record in the checkpoint, data of subprofiles follow the record
+#define CHECKPOINT_F_SSH    0x1
+#define CHECKPOINT_F_DNS    0x2
+
+/*
+ * The file begins with the header, then there are "count" records, each of
+ * them consists of:
+ *   hosts_key_t | hosts_record_t (pointers cleared) | uint8_t flags |
+ *   ssh_data_t (if CHECKPOINT_F_SSH) | dns_data_t (if CHECKPOINT_F_DNS)
+ * The sizes of the structures are stored in the header, the file is refused
+ * when they differ from the running module.
+ */
+struct checkpoint_header_t {
+   char magic[4];          // CHECKPOINT_MAGIC
+   uint32_t version;       // CHECKPOINT_VERSION
+   uint32_t saved_time;    // Time of the module when the checkpoint was saved
+   uint32_t key_size;      // sizeof(hosts_key_t)
+   uint32_t record_size;   // sizeof(hosts_record_t)
+   uint32_t ssh_size;      // sizeof(ssh_data_t)
+   uint32_t dns_size;      // sizeof(dns_data_t)
+   uint32_t reserved;
+   uint64_t count;         // Number of records
+};
+
+#endif
@@ -316,3 +316,125 @@ void check_new_rules_dns(const hosts_key_t &addr, const hosts_record_t &rec)
       reportEvent(evt);
    }
 }
+
+//////////////////////////////////
+// Batch evaluation of the rules
+
+// Relative error of the estimates computed by the rules in single precision
+#define RULES_BATCH_EST_SLACK 1e-5
+
+/** \brief Add the record to the batch
+ * The batch takes the ownership of the data of subprofiles in the record.
+ * \param[in] key Key of the record
+ * \param[in] rec Record
+ * \return True if the batch is full
+ */
+bool RulesBatch::add(const hosts_key_t &key, const hosts_record_t &rec)
+{
+   int i = count++;
+   keys[i] = key;
+   records[i] = rec;
+
+   out_req_uniqueips[i] = rec.out_req_uniqueips;
+   out_all_syn_cnt[i] = rec.out_all_syn_cnt;
+   out_all_ack_cnt[i] = rec.out_all_ack_cnt;
+   in_all_syn_cnt[i] = rec.in_all_syn_cnt;
+   in_all_syn_packets[i] = rec.in_all_syn_packets;
+   in_req_packets[i] = rec.in_req_packets;
+   out_all_packets[i] = rec.out_all_packets;
+   out_req_packets[i] = rec.out_req_packets;
+   out_all_flows[i] = rec.out_all_flows;
+   out_all_uniqueips[i] = MAX(rec.out_all_uniqueips, 1U);
+
+   // Same estimates as in check_new_rules(), the differences wrap around
+   uint32_t in_unknown = rec.in_all_flows - (rec.in_req_flows + rec.in_rsp_flows);
+   uint32_t out_unknown = rec.out_all_flows - (rec.out_req_flows + rec.out_rsp_flows);
+   est_in_req_flows[i] = rec.in_req_flows + (double) in_unknown *
+      general_conf.dos_req_rsp_est_ratio;
+   est_out_req_flows[i] = rec.out_req_flows + (double) out_unknown *
+      general_conf.dos_req_rsp_est_ratio;
+
+   if (rec.ssh_data != NULL) {
+      ssh_out_req_syn_cnt[i] = rec.ssh_data->out_req_syn_cnt;
+      ssh_out_rsp_syn_cnt[i] = rec.ssh_data->out_rsp_syn_cnt;
+      ssh_in_req_syn_cnt[i] = rec.ssh_data->in_req_syn_cnt;
+      ssh_in_rsp_syn_cnt[i] = rec.ssh_data->in_rsp_syn_cnt;
+   } else {
+      ssh_out_req_syn_cnt[i] = 0;
+      ssh_out_rsp_syn_cnt[i] = 0;
+      ssh_in_req_syn_cnt[i] = 0;
+      ssh_in_rsp_syn_cnt[i] = 0;
+   }
+
+   if (rec.dns_data != NULL) {
+      dns_out_rsp_overlimit_cnt[i] = rec.dns_data->out_rsp_overlimit_cnt;
+      dns_in_rsp_overlimit_cnt[i] = rec.dns_data->in_rsp_overlimit_cnt;
+   } else {
+      dns_out_rsp_overlimit_cnt[i] = 0;
+      dns_in_rsp_overlimit_cnt[i] = 0;
+   }
+
+   return count == RULES_BATCH_SIZE;
+}
+
+/** \brief Mark the records which may match any rule
+ * Every loop evaluates a necessary condition of some rules for the whole
+ * batch. Estimates are computed in double precision with a small slack, so
+ * a record is never skipped because of rounding.
+ * \param[in] generic Evaluate the general rules too
+ */
+void RulesBatch::evaluate(bool generic)
+{
+   const int n = count;
+   uint8_t *__restrict m = mask;
+
+   // SSH bruteforce (victim or attacker)
+   const float req_thr = ssh_conf.bruteforce_req_threshold;
+   const float data_thr = ssh_conf.bruteforce_data_threshold;
+   for (int i = 0; i < n; ++i) {
+      m[i] = ((ssh_out_rsp_syn_cnt[i] > data_thr) & (ssh_in_req_syn_cnt[i] > req_thr)) |
+         ((ssh_out_req_syn_cnt[i] > req_thr) & (ssh_in_rsp_syn_cnt[i] > data_thr));
+   }
+
+   // DNS amplification (misused server or victim)
+   const float amp_thr = dns_conf.dns_amplif_threshold;
+   for (int i = 0; i < n; ++i) {
+      m[i] |= (dns_out_rsp_overlimit_cnt[i] > amp_thr) |
+         (dns_in_rsp_overlimit_cnt[i] > amp_thr);
+   }
+
+   if (!generic) {
+      return;
+   }
+
+   // Horizontal SYN scan
+   const float scan_ips = general_conf.syn_scan_ips;
+   for (int i = 0; i < n; ++i) {
+      m[i] |= (out_req_uniqueips[i] >= scan_ips) &
+         (out_all_syn_cnt[i] >= out_all_ack_cnt[i]);
+   }
+
+   const uint32_t victim_syn = general_conf.dos_victim_connections_synflood;
+   const uint32_t victim_others = general_conf.dos_victim_connections_others;
+   const double attacker_syn = general_conf.dos_attacker_connections_synflood;
+   const double attacker_others = general_conf.dos_attacker_connections_others;
+   const double slack = 1.0 + RULES_BATCH_EST_SLACK;
+
+   if (!general_conf.dos_detection_type) {
+      // DoS victim and attacker based on flows
+      for (int i = 0; i < n; ++i) {
+         m[i] |= (in_all_syn_cnt[i] > victim_syn) |
+            (est_in_req_flows[i] * slack + 1.0 > victim_others) |
+            (out_all_flows[i] >= attacker_syn * out_all_uniqueips[i]) |
+            (est_out_req_flows[i] * slack + 1.0 >= attacker_others * out_all_uniqueips[i]);
+      }
+   } else {
+      // DoS victim and attacker based on packets
+      for (int i = 0; i < n; ++i) {
+         m[i] |= (in_all_syn_packets[i] > victim_syn) |
+            (in_req_packets[i] > victim_others) |
+            (out_all_packets[i] >= attacker_syn * out_all_uniqueips[i]) |
+            (out_req_packets[i] >= attacker_others * out_all_uniqueips[i]);
+      }
+   }
+}
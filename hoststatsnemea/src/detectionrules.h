@@ -166,4 +166,63 @@ extern struct ssh_detector_config ssh_conf;
 void check_new_rules_dns(const hosts_key_t &addr, const hosts_record_t &rec);
 extern struct dns_detector_config dns_conf;
 
+/////////////////////////////////////////////////////////////////
+// Batch evaluation of the rules
+
+#define RULES_BATCH_SIZE 256
+
+/**
+ * \brief Batch of records waiting for the detection rules.
+ * Counters used by the threshold conditions of the rules are transposed into
+ * columns and the conditions are evaluated over the whole batch by branch-free
+ * loops, which the compiler vectorises. Conditions are only necessary ones, so
+ * the records which may match any rule have to be checked by the rules above.
+ */
+class RulesBatch {
+private:
+   int count;
+   hosts_key_t keys[RULES_BATCH_SIZE];
+   hosts_record_t records[RULES_BATCH_SIZE];
+   uint8_t mask[RULES_BATCH_SIZE];    // Non-zero if the record may match a rule
+
+   // Columns with counters of the records
+   float out_req_uniqueips[RULES_BATCH_SIZE];
+   uint32_t out_all_syn_cnt[RULES_BATCH_SIZE];
+   uint32_t out_all_ack_cnt[RULES_BATCH_SIZE];
+   uint32_t in_all_syn_cnt[RULES_BATCH_SIZE];
+   uint32_t in_all_syn_packets[RULES_BATCH_SIZE];
+   uint32_t in_req_packets[RULES_BATCH_SIZE];
+   uint32_t out_all_packets[RULES_BATCH_SIZE];
+   uint32_t out_req_packets[RULES_BATCH_SIZE];
+   double est_in_req_flows[RULES_BATCH_SIZE];
+   double est_out_req_flows[RULES_BATCH_SIZE];
+   double out_all_flows[RULES_BATCH_SIZE];
+   double out_all_uniqueips[RULES_BATCH_SIZE];  // at least 1
+   float ssh_out_req_syn_cnt[RULES_BATCH_SIZE];
+   float ssh_out_rsp_syn_cnt[RULES_BATCH_SIZE];
+   float ssh_in_req_syn_cnt[RULES_BATCH_SIZE];
+   float ssh_in_rsp_syn_cnt[RULES_BATCH_SIZE];
+   float dns_out_rsp_overlimit_cnt[RULES_BATCH_SIZE];
+   float dns_in_rsp_overlimit_cnt[RULES_BATCH_SIZE];
+
+public:
+   RulesBatch() : count(0) {};
+
+   // Copy the record to the batch, returns true when the batch is full
+   bool add(const hosts_key_t &key, const hosts_record_t &rec);
+   // Find the records which may match any rule
+   void evaluate(bool generic);
+   // Remove all records from the batch
+   void clear() {count = 0;};
+
+   // Number of records in the batch
+   int size() const {return count;};
+   // The record may match a rule (valid after evaluate())
+   bool candidate(int i) const {return mask[i] != 0;};
+   // Key of the record
+   const hosts_key_t &key(int i) const {return keys[i];};
+   // Copy of the record
+   hosts_record_t &record(int i) {return records[i];};
+};
+
 #endif
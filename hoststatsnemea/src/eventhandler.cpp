@@ -39,8 +39,10 @@
 #include "hs_config.h"
 #include "aux_func.h"
 #include "profile.h"
+#include "async_log.h"
 
-#include <fstream>
+#include <cstring>
+#include <algorithm>
 extern "C" {
    #include <libtrap/trap.h>
    #include "fields.h"
@@ -56,50 +58,91 @@ string getProtoString(uint8_t proto);
 string getTypeString(uint8_t type);
 string getTimeString(const uint32_t &timestamp);
 
-void reportEvent(const Event& event)
+// Type of records of the event log (binary EventRecord followed by the note)
+#define EVENT_LOG_EVENT 1
+
+// Maximal number of addresses, ports and protocols of an event written to the log
+#define EVENT_LOG_MAX_ITEMS 4
+
+// Event copied by the processing thread, its line is formatted by the writer thread
+struct EventRecord {
+   uint32_t time_first, time_last;
+   uint32_t scale;
+   uint8_t type;
+   uint8_t proto_cnt, src_addr_cnt, dst_addr_cnt, src_port_cnt, dst_port_cnt;
+   uint8_t proto[EVENT_LOG_MAX_ITEMS];
+   uint16_t src_port[EVENT_LOG_MAX_ITEMS], dst_port[EVENT_LOG_MAX_ITEMS];
+   ip_addr_t src_addr[EVENT_LOG_MAX_ITEMS], dst_addr[EVENT_LOG_MAX_ITEMS];
+};
+
+// Log of events, lines are appended to the daily files by its writer thread
+static async_log_t *event_log = NULL;
+
+// Daily file opened by the writer thread
+static string event_log_path;
+static FILE *event_log_file = NULL;
+
+// Copy at most EVENT_LOG_MAX_ITEMS items of the vector to the record
+template<class T>
+static uint8_t copyItems(T *dst, const vector<T> &src)
+{
+   size_t cnt = min(src.size(), (size_t) EVENT_LOG_MAX_ITEMS);
+   copy(src.begin(), src.begin() + cnt, dst);
+   return cnt;
+}
+
+// Format the event to a line and append it to its daily file
+static void writeEvent(FILE *, uint16_t type, const void *data, uint32_t size, void *)
 {
-   string first_t = getTimeString(event.time_first);
-   string last_t = getTimeString(event.time_last);
+   EventRecord record;
+
+   if (type != EVENT_LOG_EVENT || size < sizeof(record))
+      return;
+   memcpy(&record, data, sizeof(record));
+
+   string first_t = getTimeString(record.time_first);
+   string last_t = getTimeString(record.time_last);
 
    // Print info about event into a string
    stringstream line;
    char ip_str[INET6_ADDRSTRLEN];
    line << first_t << ';' << last_t << ';';
-   line << getTypeString(event.type) << ';';
-   for (vector<uint8_t>::const_iterator it = event.proto.begin(); it != event.proto.end(); ++it) {
-      if (it != event.proto.begin())
+   line << getTypeString(record.type) << ';';
+   for (int i = 0; i < record.proto_cnt; i++) {
+      if (i != 0)
          line << ',';
-      line << (int)*it;
+      line << (int)record.proto[i];
    }
    line << ';';
-   for (vector<ip_addr_t>::const_iterator it = event.src_addr.begin(); it != event.src_addr.end(); ++it) {
-      if (it != event.src_addr.begin())
+   for (int i = 0; i < record.src_addr_cnt; i++) {
+      if (i != 0)
          line << ',';
-      ip_to_str(&(*it), ip_str);
+      ip_to_str(&record.src_addr[i], ip_str);
       line << ip_str;
    }
    line << ';';
-   for (vector<ip_addr_t>::const_iterator it = event.dst_addr.begin(); it != event.dst_addr.end(); ++it) {
-      if (it != event.dst_addr.begin())
+   for (int i = 0; i < record.dst_addr_cnt; i++) {
+      if (i != 0)
          line << ',';
-      ip_to_str(&(*it), ip_str);
+      ip_to_str(&record.dst_addr[i], ip_str);
       line << ip_str;
    }
    line << ';';
-   for (vector<uint16_t>::const_iterator it = event.src_port.begin(); it != event.src_port.end(); ++it) {
-      if (it != event.src_port.begin())
+   for (int i = 0; i < record.src_port_cnt; i++) {
+      if (i != 0)
          line << ',';
-      line << *it;
+      line << record.src_port[i];
    }
    line << ';';
-   for (vector<uint16_t>::const_iterator it = event.dst_port.begin(); it != event.dst_port.end(); ++it) {
-      if (it != event.dst_port.begin())
+   for (int i = 0; i < record.dst_port_cnt; i++) {
+      if (i != 0)
          line << ',';
-      line << *it;
+      line << record.dst_port[i];
    }
    line << ';';
-   line << event.scale << ';';
-   line << event.note << '\n';
+   line << record.scale << ';';
+   line.write((const char *) data + sizeof(record), size - sizeof(record));
+   line << '\n';
 
    // Write the line to a log file
    Configuration *config = Configuration::getInstance();
@@ -107,25 +150,66 @@ void reportEvent(const Event& event)
    string path = config->getValue("detection-log");
    config->unlock();
 
-   string y = first_t.substr(0,4);
-   string m = first_t.substr(4,2);
-   string d = first_t.substr(6,2);
-   string h = first_t.substr(8,2);
-   string n = first_t.substr(10,2);
-
-   if (!path.empty()) {
-      if (path[path.size()-1] != '/')
-         path += '/';
-      path += y + m + d + ".log";
-
-      // Open file and append the line
-      ofstream logfile(path.c_str(), ios_base::app);
-      if (logfile.good()) {
-         logfile << line.str();
-         logfile.close();
-      }
-      else {
+   if (path.empty())
+      return;
+   if (path[path.size()-1] != '/')
+      path += '/';
+   path += first_t.substr(0,8) + ".log";
+
+   // Keep the file opened until the first line of the next day
+   if (event_log_file == NULL || event_log_path != path) {
+      if (event_log_file != NULL)
+         fclose(event_log_file);
+      event_log_path = path;
+      event_log_file = fopen(path.c_str(), "a");
+      if (event_log_file == NULL) {
          log(LOG_ERR, "Can't open log file \"%s\".", path.c_str());
+         return;
+      }
+   }
+   string text = line.str();
+   fwrite(text.data(), 1, text.size(), event_log_file);
+   fflush(event_log_file);
+}
+
+bool openEventLog()
+{
+   event_log = async_log_open(NULL, ASYNC_LOG_DEFAULT_CAPACITY, ASYNC_LOG_SYNC_NEVER,
+      writeEvent, NULL);
+   return event_log != NULL;
+}
+
+void closeEventLog()
+{
+   async_log_close(event_log);
+   event_log = NULL;
+   if (event_log_file != NULL) {
+      fclose(event_log_file);
+      event_log_file = NULL;
+   }
+}
+
+void reportEvent(const Event& event)
+{
+   // Pass a copy of the event to the writer thread of the log, it formats the line
+   if (event_log != NULL) {
+      size_t note_len = min(event.note.size(), (size_t) ASYNC_LOG_DEFAULT_CAPACITY / 4);
+      char *data = (char *) async_log_reserve(event_log, EVENT_LOG_EVENT, sizeof(EventRecord) + note_len);
+      if (data != NULL) {
+         EventRecord record;
+         memset(&record, 0, sizeof(record));
+         record.time_first = event.time_first;
+         record.time_last = event.time_last;
+         record.scale = event.scale;
+         record.type = event.type;
+         record.proto_cnt = copyItems(record.proto, event.proto);
+         record.src_addr_cnt = copyItems(record.src_addr, event.src_addr);
+         record.dst_addr_cnt = copyItems(record.dst_addr, event.dst_addr);
+         record.src_port_cnt = copyItems(record.src_port, event.src_port);
+         record.dst_port_cnt = copyItems(record.dst_port, event.dst_port);
+         memcpy(data, &record, sizeof(record));
+         memcpy(data + sizeof(record), event.note.data(), note_len);
+         async_log_commit(event_log, data);
       }
    }
 
@@ -125,6 +125,12 @@ public:
    }
 };
 
+// Start the writer thread of the event log (detection-log), events are written to it by reportEvent
+bool openEventLog();
+
+// Write the rest of the event log and stop its writer thread
+void closeEventLog();
+
 void reportEvent(const Event& event);
 
 
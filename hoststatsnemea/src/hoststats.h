@@ -51,6 +51,7 @@ extern "C" {
 }
 
 #include <stdint.h>
+#include "sketch.h"
 
 #define DIR_FLAG_REQ   0x8   //Request
 #define DIR_FLAG_RSP   0x4   //Response
@@ -125,6 +126,11 @@ struct hosts_record_t {
    // Timestamps
    uint32_t first_rec_ts; ///< timestamp of first flow
    uint32_t last_rec_ts;  ///< timestamp of last flow
+   // Sketches of unique peers (used instead of BloomFilters if enabled)
+   peer_sketch_t in_all_peers;
+   peer_sketch_t in_req_peers;
+   peer_sketch_t out_all_peers;
+   peer_sketch_t out_req_peers;
    // Subprofiles
    ssh_data_t *ssh_data;  ///< SSH subprofile
    dns_data_t *dns_data;  ///< DNS subprofile
@@ -137,9 +143,6 @@ struct hosts_record_t {
 // key
 typedef ip_addr_t hosts_key_t;
 
-// hash table
-typedef fht_table_t stat_table_t;
-
 ////////////////////////////////////
 
 // BloomFilter key
@@ -53,9 +53,13 @@
 #include "aux_func.h"
 #include "processdata.h"
 #include "detectionrules.h"
+#include "eventhandler.h"
 #include "hs_config.h"
+#include "metrics.h"
+#include "affinity.h"
 #include <unistd.h>
 #include <getopt.h>
+#include <glob.h>
 //TRAP
 extern "C" {
    #include <libtrap/trap.h>
@@ -76,6 +80,7 @@ extern sp_list_ptr_v subprofile_list;
 // Status information
 static bool offline_mode = false; // Run in offline mode
 static bool send_eos = true;
+static string offline_files;       // Files analyzed in offline mode (empty = TRAP)
 
 // Define section
 #define DEF_REQUIRED_TMPL "SRC_IP,DST_IP,SRC_PORT,DST_PORT,PROTOCOL,PACKETS,BYTES,TIME_FIRST,TIME_LAST,TCP_FLAGS,LINK_BIT_FIELD,DIR_BIT_FIELD"  // required input UniRec items
@@ -112,7 +117,8 @@ trap_module_info_t *module_info = NULL;
 #define MODULE_PARAMS(PARAM) \
   PARAM('c', "config", "Load configuration from file.", required_argument, "string") \
   PARAM('F', "offline", "Run module in OFFLINE mode. It is used for analysis of already captured flows. As a source can be used module such as nfreader, trapreplay, etc.", no_argument, "none") \
-  PARAM('n', "no_message", "Don't send end-of-stream message.", no_argument, "none")
+  PARAM('n', "no_message", "Don't send end-of-stream message.", no_argument, "none") \
+  PARAM('r', "files", "Run module in OFFLINE mode and analyze the files (comma separated list of files or glob patterns, e.g. \"/data/flows/*.trapcap\") read in parallel.", required_argument, "string")
 
 /** \brief Parse arguments
  * \param[in] argc Argument count
@@ -133,6 +139,10 @@ int arguments(int argc, char *argv[], const char *module_getopt_string, const st
       case 'n':
          send_eos = false;
          break;
+      case 'r':
+         offline_mode = true;
+         offline_files = string(optarg);
+         break;
       default:  // invalid arguments
          return 0;
       }
@@ -147,10 +157,12 @@ void terminate_daemon(int signal)
 {
    switch (signal) {
    case SIGTERM:
+      offline_files_stop();
       trap_terminate();
       log(LOG_NOTICE, "Cought TERM signal...");
       break;
    case SIGINT:
+      offline_files_stop();
       trap_terminate();
       log(LOG_NOTICE, "Cought INT signal...");
       break;
@@ -159,6 +171,40 @@ void terminate_daemon(int signal)
    }
 }
 
+/** \brief Get the list of files to analyze
+ * \param[in] list Comma separated list of files or glob patterns
+ * \param[out] files Files in the order of the list (matches of a pattern
+ * are sorted by name)
+ * \return False when a pattern doesn't match any file, true otherwise
+ */
+bool expand_files(const string &list, vector<string> &files)
+{
+   size_t begin = 0;
+   while (begin <= list.size()) {
+      size_t end = list.find(',', begin);
+      if (end == string::npos) {
+         end = list.size();
+      }
+      string pattern = trim(list.substr(begin, end - begin));
+      begin = end + 1;
+      if (pattern.empty()) {
+         continue;
+      }
+
+      glob_t matches;
+      if (glob(pattern.c_str(), 0, NULL, &matches) != 0) {
+         log(LOG_ERR, "ERROR: No file matches '%s'.", pattern.c_str());
+         globfree(&matches);
+         return false;
+      }
+      for (size_t i = 0; i < matches.gl_pathc; ++i) {
+         files.push_back(matches.gl_pathv[i]);
+      }
+      globfree(&matches);
+   }
+   return !files.empty();
+}
+
 /** \brief Check if UniRec template is subset of another UniRec template
  * Both templates must be initialized.
  * \param[in] main_tmpl Primary template
@@ -298,6 +344,13 @@ int main(int argc, char *argv[])
 
    /* Some variables initialization because of goto */
    ur_field_id_t dir_flag_id = F_DIRECTION_FLAGS;
+   vector<string> files;
+
+   /* Socket serving runtime metrics (empty = disabled) */
+   string metrics_socket = trim(config->getValue("metrics-socket"));
+
+   /* CPUs the threads are pinned to (empty = placement by the kernel) */
+   string cpu_affinity = trim(config->getValue("cpu-affinity"));
 
    tmpl_in = ur_create_input_template(0, DEF_REQUIRED_TMPL, NULL);
    tmpl_out = ur_create_output_template(0, "EVENT_TYPE,TIME_FIRST,TIME_LAST,SRC_IP,"
@@ -384,8 +437,31 @@ int main(int argc, char *argv[])
    /* Configuration loaded */
    config->unlock();
 
-   /* Create class for storing flow records */
-   MainProfile = new HostProfile();
+   /* Files to analyze in OFFLINE mode */
+   if (!offline_files.empty() && !expand_files(offline_files, files)) {
+      goto exitC;
+   }
+
+   /* Threads take the CPUs in turns, the main thread first, so that the table
+    * it allocates is placed on the NUMA node of its CPU */
+   if (affinity_init(cpu_affinity.c_str()) != 0) {
+      log(LOG_ERR, "Error: Wrong list of CPUs in 'cpu-affinity'.");
+      goto exitC;
+   }
+   affinity_pin_self();
+
+   /* Create class for storing flow records (records of the files are merged,
+    * so unique IPs have to be counted by sketches) */
+   MainProfile = new HostProfile(!files.empty());
+
+   if (!openEventLog()) {
+      log(LOG_ERR, "Error: Failed to start writer of the event log.");
+   }
+
+   if (!metrics_socket.empty() && metrics_server_start(metrics_socket.c_str()) != 0) {
+      log(LOG_ERR, "Error: Failed to serve metrics on socket '%s'.",
+         metrics_socket.c_str());
+   }
 
    /* Register termination signals */
    signal(SIGTERM, terminate_daemon);
@@ -396,16 +472,26 @@ int main(int argc, char *argv[])
       log(LOG_INFO, "HostStatsNemea: ONLINE mode");
       pthread_t data_reader_thread = 0;
       pthread_t data_process_thread = 0;
+      pthread_t checkpoint_thread = 0;
       sigset_t signal_mask;
       int rc = 0;
 
-      rc = pthread_create(&data_reader_thread, NULL, &data_reader_trap, NULL);
+      if (!MainProfile->checkpoint_file.empty()) {
+         // Records from the last run are loaded along with new flows
+         rc = affinity_thread_create(&checkpoint_thread, &checkpoint_loader, NULL);
+         if (rc) {
+            log(LOG_ERR, "Error: Failed to start loading of the checkpoint.");
+            checkpoint_thread = 0;
+         }
+      }
+
+      rc = affinity_thread_create(&data_reader_thread, &data_reader_trap, NULL);
       if (rc) {
          trap_terminate();
          goto exitD;
       }
 
-      rc = pthread_create(&data_process_thread, NULL, &data_process_trap, NULL);
+      rc = affinity_thread_create(&data_process_thread, &data_process_trap, NULL);
       if (rc) {
          trap_terminate();
          goto exitD;
@@ -430,10 +516,18 @@ exitD:
          pthread_join(data_process_thread, NULL);
       }
 
+      if (checkpoint_thread != 0) {
+         pthread_join(checkpoint_thread, NULL);
+      }
+
    } else {
       // OFFLINE MODE ----------------------------------------------------------
       log(LOG_INFO, "HostStatsNemea: OFFLINE mode");
-      offline_analyzer();
+      if (!files.empty()) {
+         offline_files_analyzer(files);
+      } else {
+         offline_analyzer();
+      }
    }
 
    if (send_eos) {
@@ -443,9 +537,11 @@ exitD:
    }
 
    log(LOG_DEBUG, "Exiting... releasing memory");
+   metrics_server_stop();
 
    // Delete all records
    delete MainProfile;
+   closeEventLog();
 
 exitC:
    unregister_subprofiles();
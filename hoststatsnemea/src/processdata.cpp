@@ -46,9 +46,15 @@
 #include <csignal>
 #include <pthread.h>
 #include <unistd.h>
+#include <string.h>
 #include "processdata.h"
 #include "aux_func.h" // various simple conversion functions
+#include "hs_config.h"
 #include "profile.h"
+#include "updateworkers.h"
+#include "metrics.h"
+#include "overload.h"
+#include "affinity.h"
 
 extern "C" {
    #include <libtrap/trap.h>
@@ -63,6 +69,18 @@ extern ur_template_t *tmpl_in;
 HostProfile *MainProfile       = NULL; // Global profile
 uint32_t hs_time               = 0;
 
+// Threads updating the main profile (NULL if the reader updates it)
+static UpdateWorkers *workers  = NULL;
+
+// Runtime metrics of the reader
+static metrics_counter_t *flows_metric = metrics_counter(
+   "hoststats_flows_total", "Flows received and passed to the update of the profile.");
+static metrics_histogram_t *update_metric = metrics_histogram(
+   "hoststats_flow_seconds", "Time of the reader spent on one flow (update or passing to the workers).");
+
+// Overload controller of the reader (ONLINE mode only, disabled otherwise)
+static overload_t overload;
+
 // Status information
 static bool processing_data = false;
 static bool terminated  = false;    // TRAP terminated by the user
@@ -75,6 +93,115 @@ static pthread_mutex_t det_processing = PTHREAD_MUTEX_INITIALIZER;
 /////////////////////////////////////////
 // Host stats processing functions
 
+/** \brief Start update workers if they are enabled in the configuration
+ * \return False when the workers couldn't be started, true otherwise
+ */
+static bool start_update_workers()
+{
+   if (MainProfile->update_workers <= 0) {
+      return true;
+   }
+
+   workers = new UpdateWorkers(MainProfile, MainProfile->update_workers);
+   if (!workers->start()) {
+      delete workers;
+      workers = NULL;
+      return false;
+   }
+   return true;
+}
+
+/** \brief Process all queued flows and stop update workers
+ */
+static void stop_update_workers()
+{
+   delete workers;
+   workers = NULL;
+}
+
+/** \brief Get new data from the TRAP
+ * The update workers use the input template, so when the format of the data
+ * changes, the flows queued before have to be processed before the template
+ * is updated.
+ * \param[out] data Received data
+ * \param[out] data_size Size of the received data
+ * \return Return code of the TRAP
+ */
+static int receive_data(const void **data, uint16_t *data_size)
+{
+   int ret;
+   if (workers == NULL) {
+      ret = TRAP_RECEIVE(0, *data, *data_size, tmpl_in);
+      return ret;
+   }
+
+   ret = trap_recv(0, data, data_size);
+   if (ret != TRAP_E_FORMAT_CHANGED) {
+      return ret;
+   }
+
+   workers->wait_idle();
+
+   const char *spec = NULL;
+   uint8_t data_fmt;
+   if (trap_get_data_fmt(TRAPIFC_INPUT, 0, &data_fmt, &spec) != TRAP_E_OK) {
+      log(LOG_ERR, "Error: data format was not loaded.");
+      return ret;
+   }
+
+   ur_template_t *tmpl = ur_define_fields_and_update_template(spec, tmpl_in);
+   if (tmpl == NULL) {
+      log(LOG_ERR, "Error: template could not be edited.");
+      return ret;
+   }
+   tmpl_in = tmpl;
+   return ret;
+}
+
+/** \brief Swap/clear BloomFilters in order with the updates
+ */
+static void swap_bloomfilters()
+{
+   if (workers != NULL) {
+      workers->swap_bf();
+   } else {
+      MainProfile->swap_bf();
+   }
+}
+
+/** \brief Hash of the host for sampling of the hosts in overload
+ * \param host IP address of the host
+ * \return Hash of the address
+ */
+static inline uint64_t host_hash(const hosts_key_t &host)
+{
+   return host.ui64[0] ^ host.ui64[1];
+}
+
+/** \brief Update the main profile and subprofiles by the flow
+ * \param data Flow record from the TRAP
+ * \param data_size Size of the flow record
+ */
+static void update_profile(const void *data, uint16_t data_size)
+{
+   uint64_t start = metrics_start();
+   // In overload subprofiles are updated only for the sampled hosts
+   bool src_subprofiles = true;
+   bool dst_subprofiles = true;
+   if (overload_degraded(&overload)) {
+      src_subprofiles = overload_keep(&overload, host_hash(ur_get(tmpl_in, data, F_SRC_IP)));
+      dst_subprofiles = overload_keep(&overload, host_hash(ur_get(tmpl_in, data, F_DST_IP)));
+   }
+   if (workers != NULL) {
+      workers->update(data, data_size, tmpl_in, hs_time, src_subprofiles,
+         dst_subprofiles);
+   } else {
+      MainProfile->update(data, tmpl_in, src_subprofiles, dst_subprofiles);
+   }
+   metrics_counter_inc(flows_metric);
+   metrics_stop(update_metric, start);
+}
+
 /** \brief Signal alarm handling
  * Use only in ONLINE mode!
  * Based on the alarm signal runs in regular (user defined) intervals thread
@@ -126,19 +253,25 @@ void *data_reader_trap(void *args)
    // even if no records are coming
    trap_ifcctl(TRAPIFC_INPUT, 0, TRAPCTL_SETTIMEOUT, RECV_TIMEOUT * MSEC);
 
+   overload_init(&overload, "hoststats", MainProfile->overload_load);
+
+   if (!start_update_workers()) {
+      terminated = true;
+   }
+
    while (!end_of_steam && !terminated) {
       const void *data;
       uint16_t data_size;
 
       // Get new data from TRAP with exception handling
-      ret = TRAP_RECEIVE(0, data, data_size, tmpl_in);
+      ret = receive_data(&data, &data_size);
       if (ret != TRAP_E_OK) {
          switch (ret) {
          case TRAP_E_TIMEOUT:
             if (flow_time != 0) {
                flow_time += RECV_TIMEOUT;
                if (flow_time >= next_bf_change) {
-                  MainProfile->swap_bf();
+                  swap_bloomfilters();
                   next_bf_change += (MainProfile->active_timeout/2);
                }
             }
@@ -170,6 +303,8 @@ void *data_reader_trap(void *args)
          break;
       }
 
+      overload_begin(&overload);
+
       // First flow
       if (flow_time == 0) {
          // Get time and setup alarm
@@ -184,16 +319,22 @@ void *data_reader_trap(void *args)
 
       if (flow_time >= next_bf_change) {
          // Swap/clear BloomFilters
-         MainProfile->swap_bf();
+         swap_bloomfilters();
          next_bf_change += (MainProfile->active_timeout/2);
       }
 
       // Update main profile and subprofiles
-      MainProfile->update(data, tmpl_in, true);
+      update_profile(data, data_size);
+      overload_end(&overload, 1);
    }
 
    // TRAP TERMINATED, exiting...
    log(LOG_INFO, "Reading from the TRAP ended.");
+   if (overload.shed > 0) {
+      log(LOG_INFO, "Subprofile updates of %lu hosts were shed in overload.",
+         (unsigned long) overload.shed);
+   }
+   stop_update_workers();
 
    // Wait until the end of the current processing and run it again (to end)
    pthread_mutex_lock(&det_processing);
@@ -209,6 +350,8 @@ void *data_reader_trap(void *args)
  */
 void *data_process_trap(void *args)
 {
+   uint32_t next_checkpoint = time(NULL) + MainProfile->checkpoint_interval;
+
    // First lock of this mutex
    pthread_mutex_lock(&detector_start);
 
@@ -223,6 +366,12 @@ void *data_process_trap(void *args)
 
       MainProfile->check_table(false);
 
+      // Periodic checkpoint of the remaining records
+      if (MainProfile->checkpoint_interval > 0 && hs_time >= next_checkpoint) {
+         MainProfile->save_checkpoint(hs_time);
+         next_checkpoint = hs_time + MainProfile->checkpoint_interval;
+      }
+
       processing_data = false;
       pthread_mutex_unlock(&det_processing);
    }
@@ -233,11 +382,22 @@ void *data_process_trap(void *args)
       MainProfile->check_table(true);
    } else {
       log(LOG_INFO, "Main profile processing ended.");
+      // The records are loaded again after restart of the module
+      MainProfile->save_checkpoint(time(NULL));
    }
 
    pthread_exit(NULL);
 }
 
+/**
+ * Thread loading records from the checkpoint while new flows are received
+ */
+void *checkpoint_loader(void *args)
+{
+   MainProfile->load_checkpoint(time(NULL));
+   pthread_exit(NULL);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // OFFLINE mode
 ////////////////////////////////////////////////////////////////////////////////
@@ -256,12 +416,16 @@ void offline_analyzer()
    uint32_t flow_time           = 0; // seconds from rec->last
    uint32_t check_time          = 0;
 
+   if (!start_update_workers()) {
+      return;
+   }
+
    while (!end_of_steam && !terminated) {
       const void *data;
       uint16_t data_size;
 
       // Get new data from TRAP with exception catch
-      ret = TRAP_RECEIVE(0, data, data_size, tmpl_in);
+      ret = receive_data(&data, &data_size);
       if (ret != TRAP_E_OK) {
          switch (ret) {
          case TRAP_E_TERMINATED:
@@ -272,6 +436,7 @@ void offline_analyzer()
          default:
             log(LOG_ERR, "Error: getting new data from TRAP failed: %s)\n",
                trap_last_error_msg);
+            stop_update_workers();
             return;
          }
       }
@@ -281,6 +446,7 @@ void offline_analyzer()
          if (data_size > 1) {
             log(LOG_ERR, "Error: data with wrong size received (expected size: "
                "%u, received size: %i)", ur_rec_fixlen_size(tmpl_in), data_size);
+            stop_update_workers();
             return;
          }
          end_of_steam = true;
@@ -299,27 +465,239 @@ void offline_analyzer()
       if (flow_time > hs_time) {
          hs_time = flow_time;
          if (flow_time >= next_bf_change) {
-            MainProfile->swap_bf();
+            swap_bloomfilters();
             next_bf_change += (MainProfile->active_timeout/2);
          }
       }
 
       // Update main profile and subprofiles
-      MainProfile->update(data, tmpl_in, true);
+      update_profile(data, data_size);
 
       if (hs_time < check_time) {
          // Get new data from TRAP
          continue;
       }
 
-      // Check records in table
+      // Check records in table (after the queued flows are processed)
+      if (workers != NULL) {
+         workers->wait_idle();
+      }
       MainProfile->check_table(false);
       check_time += MainProfile->det_start_time;
    }
 
+   stop_update_workers();
+
    // TRAP CONNECTION CLOSED or TRAP TERMINATED, exiting...
    if (!terminated && end_of_steam) {
       log(LOG_INFO, "Reading from the TRAP ended. Checking the remaining records.");
       MainProfile->check_table(true);
    }
 }
+
+////////////////////////////////////////////////////////////////////////////////
+// OFFLINE mode with files
+////////////////////////////////////////////////////////////////////////////////
+
+// Fields are defined by all readers in one global registry
+static pthread_mutex_t fields_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile bool files_stop = false;   // Reading of the files interrupted
+
+// One file read by one thread into a private profile
+struct file_reader_t {
+   pthread_t thread;
+   HostProfile *profile;
+   std::string file;
+   uint64_t flows;
+   bool failed;
+};
+
+/** \brief Get the template of the data in the file
+ * \param ctx Context of the file
+ * \param tmpl Template of the previous data (NULL if none)
+ * \return New template or NULL if the data don't contain the required items
+ */
+static ur_template_t *file_template(trap_ctx_t *ctx, ur_template_t *tmpl)
+{
+   const char *spec = NULL;
+   uint8_t data_fmt;
+   if (trap_ctx_get_data_fmt(ctx, TRAPIFC_INPUT, 0, &data_fmt, &spec) != TRAP_E_OK) {
+      ur_free_template(tmpl);
+      return NULL;
+   }
+
+   pthread_mutex_lock(&fields_lock);
+   tmpl = ur_define_fields_and_update_template(spec, tmpl);
+   pthread_mutex_unlock(&fields_lock);
+   if (tmpl == NULL) {
+      return NULL;
+   }
+
+   // The profile uses all items of the input template
+   ur_field_id_t id = UR_ITER_BEGIN;
+   while ((id = ur_iter_fields(tmpl_in, id)) != UR_ITER_END) {
+      if (!ur_is_present(tmpl, id)) {
+         log(LOG_ERR, "Error: Unirec item '%s' is missing in the file.",
+            ur_get_name(id));
+         ur_free_template(tmpl);
+         return NULL;
+      }
+   }
+   return tmpl;
+}
+
+/**
+ * Thread reading all flows of the file into its profile (without checking)
+ */
+static void *file_reader(void *args)
+{
+   file_reader_t *reader = (file_reader_t *) args;
+   reader->flows = 0;
+   reader->failed = true;
+
+   // The file is the only input interface of the context
+   trap_module_info_t info;
+   memset(&info, 0, sizeof(info));
+   info.name = (char *) "hoststatsnemea";
+   info.description = (char *) "HostStatsNemea file reader";
+   info.num_ifc_in = 1;
+   info.num_ifc_out = 0;
+
+   char ifc_types[] = "f";
+   char *ifc_params[] = {(char *) reader->file.c_str()};
+   trap_ifc_spec_t ifc_spec;
+   ifc_spec.types = ifc_types;
+   ifc_spec.params = ifc_params;
+
+   trap_ctx_t *ctx = trap_ctx_init(&info, ifc_spec);
+   if (ctx == NULL || trap_ctx_get_last_error(ctx) != TRAP_E_OK) {
+      log(LOG_ERR, "Error: Failed to open the file '%s': %s", reader->file.c_str(),
+         (ctx != NULL) ? trap_ctx_get_last_error_msg(ctx) : "");
+      if (ctx != NULL) {
+         trap_ctx_finalize(&ctx);
+      }
+      pthread_exit(NULL);
+   }
+
+   char *tmpl_str = ur_template_string(tmpl_in);
+   trap_ctx_set_required_fmt(ctx, 0, TRAP_FMT_UNIREC, tmpl_str);
+   free(tmpl_str);
+
+   ur_template_t *tmpl = NULL;
+   uint32_t now = 0;
+   while (!files_stop) {
+      const void *data;
+      uint16_t data_size;
+
+      int ret = trap_ctx_recv(ctx, 0, &data, &data_size);
+      if (ret == TRAP_E_FORMAT_CHANGED) {
+         tmpl = file_template(ctx, tmpl);
+         if (tmpl == NULL) {
+            log(LOG_ERR, "Error: Unsupported data format in the file '%s'.",
+               reader->file.c_str());
+            break;
+         }
+      } else if (ret == TRAP_E_TERMINATED) {
+         reader->failed = false;
+         break;
+      } else if (ret != TRAP_E_OK) {
+         log(LOG_ERR, "Error: Reading of the file '%s' failed: %s",
+            reader->file.c_str(), trap_ctx_get_last_error_msg(ctx));
+         break;
+      }
+
+      if (tmpl == NULL || data_size < ur_rec_fixlen_size(tmpl)) {
+         // end of stream
+         reader->failed = (tmpl == NULL || data_size > 1);
+         break;
+      }
+
+      // The time of the private profile is given by its flows only
+      uint32_t flow_time = ur_time_get_sec(ur_get(tmpl, data, F_TIME_LAST));
+      if (flow_time > now) {
+         now = flow_time;
+      }
+
+      uint8_t dir_flags;
+      if (reader->profile->flow_direction(data, tmpl, dir_flags)) {
+         reader->profile->update_src(data, tmpl, dir_flags, now, 0);
+         reader->profile->update_dst(data, tmpl, dir_flags, now, 0);
+      }
+      ++reader->flows;
+   }
+
+   if (tmpl != NULL) {
+      ur_free_template(tmpl);
+   }
+   trap_ctx_finalize(&ctx);
+   pthread_exit(NULL);
+}
+
+/** \brief Analysis of captured files in Offline mode
+ * The files are read in windows of "offline-readers" files. Every file of
+ * a window is read by its own thread into a private profile, the profiles
+ * are merged into the main profile at the end of the window and all
+ * records are checked. Unique IPs are counted by sketches, so that they
+ * can be merged.
+ * \param files Files ordered by the time of the flows
+ */
+void offline_files_analyzer(const std::vector<std::string> &files)
+{
+   Configuration *conf = Configuration::getInstance();
+   conf->lock();
+   int reader_cnt = conf->get_cfg_val("Offline readers", "offline-readers",
+      D_OFFLINE_READERS, 1);
+   conf->unlock();
+
+   if ((size_t) reader_cnt > files.size()) {
+      reader_cnt = files.size();
+   }
+
+   std::vector<file_reader_t> readers(reader_cnt);
+   for (int i = 0; i < reader_cnt; ++i) {
+      readers[i].profile = new HostProfile(true);
+   }
+
+   for (size_t first = 0; first < files.size() && !files_stop; first += reader_cnt) {
+      size_t cnt = files.size() - first;
+      if (cnt > (size_t) reader_cnt) {
+         cnt = reader_cnt;
+      }
+
+      for (size_t i = 0; i < cnt; ++i) {
+         readers[i].file = files[first + i];
+         if (affinity_thread_create(&readers[i].thread, &file_reader, &readers[i])) {
+            log(LOG_ERR, "Error: Failed to start reading of the file '%s'.",
+               readers[i].file.c_str());
+            readers[i].thread = 0;
+         }
+      }
+
+      // Window boundary, merge the hosts of all files and check them
+      for (size_t i = 0; i < cnt; ++i) {
+         if (readers[i].thread == 0) {
+            continue;
+         }
+         pthread_join(readers[i].thread, NULL);
+         log(LOG_INFO, "File '%s' read (%llu flows)%s.", readers[i].file.c_str(),
+            (unsigned long long) readers[i].flows,
+            readers[i].failed ? " with an error" : "");
+         MainProfile->merge(*readers[i].profile);
+      }
+
+      if (!files_stop) {
+         MainProfile->check_table(true);
+      }
+   }
+
+   for (int i = 0; i < reader_cnt; ++i) {
+      delete readers[i].profile;
+   }
+}
+
+/** \brief Interrupt the analysis of the files
+ */
+void offline_files_stop()
+{
+   files_stop = true;
+}
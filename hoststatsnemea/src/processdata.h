@@ -45,14 +45,23 @@
 #ifndef _PROCESS_DATA_H
 #define _PROCESS_DATA_H
 
+#include <string>
+#include <vector>
+
 #define RECV_TIMEOUT 1 //seconds
 #define MSEC         1000000
 
 // ONLINE MODE THREADS
 void *data_reader_trap(void *args); //for thread
 void *data_process_trap(void *args); //for thread
+void *checkpoint_loader(void *args); //for thread
 
 // OFFLINE MODE FUNCTION
 void offline_analyzer();
 
+// OFFLINE MODE WITH FILES
+#define D_OFFLINE_READERS 4   // default number of files read at once
+void offline_files_analyzer(const std::vector<std::string> &files);
+void offline_files_stop();
+
 #endif
@@ -47,6 +47,7 @@
 #include "aux_func.h"
 #include "hs_config.h"
 #include "detectionrules.h"
+#include "metrics.h"
 extern "C" {
    #include "fields.h"
 }
@@ -55,6 +56,24 @@ using namespace std;
 extern uint32_t hs_time;
 extern sp_list_ptr_v subprofile_list;
 
+// Runtime metrics of the checks of the table
+static metrics_histogram_t *check_expired_metric = metrics_histogram(
+   "hoststats_check_seconds{check=\"expired\"}", "Duration of the checks of the table.");
+static metrics_histogram_t *check_all_metric = metrics_histogram(
+   "hoststats_check_seconds{check=\"all\"}", "Duration of the checks of the table.");
+static metrics_counter_t *checked_metric = metrics_counter(
+   "hoststats_checked_records_total", "Records checked by the detectors and removed from the table.");
+static metrics_counter_t *delayed_metric = metrics_counter(
+   "hoststats_delayed_records_total", "Records taken from the timer wheel before their expiration.");
+static metrics_gauge_t *timers_metric = metrics_gauge(
+   "hoststats_timer_entries", "Entries of the timer wheel (records of the table and their older entries).");
+static metrics_gauge_t *records_metric = metrics_gauge(
+   "hoststats_table_records", "Records in the statistics table.");
+static metrics_gauge_t *capacity_metric = metrics_gauge(
+   "hoststats_table_capacity", "Slots of the statistics table.");
+static metrics_gauge_t *load_metric = metrics_gauge(
+   "hoststats_table_load_permille", "Records per thousand slots of the statistics table.");
+
 // DEFAULT VALUES OF THE MAIN PROFILE (in seconds)
 #define D_TABLE_SIZE (65536)
 #define D_ACTIVE_TIMEOUT   300   // default value (in seconds)
@@ -62,11 +81,13 @@ extern sp_list_ptr_v subprofile_list;
 #define D_DET_START_PAUSE  10    // default time between starts of detector (in seconds)
 
 #define STAT_TABLE_STASH_SIZE 4
+#define D_TABLE_MAX_MEMORY 0     // table does not grow by default [MiB]
 
 /** \brief Constructor of statistics class
  * Load configuration and prepare new statistics table
+ * \param sketches Count unique IPs by sketches regardless of the configuration
  */
-HostProfile::HostProfile()
+HostProfile::HostProfile(bool sketches)
 {
    Configuration *conf = Configuration::getInstance();
    conf->lock();
@@ -74,6 +95,8 @@ HostProfile::HostProfile()
    // Load configuration data and update profile (and subprofiles) variables
    table_size = conf->get_cfg_val("Table size", "table-size", D_TABLE_SIZE,
       D_TABLE_SIZE);
+   int table_max_memory = conf->get_cfg_val("Table memory limit",
+      "table-max-memory", D_TABLE_MAX_MEMORY, 0);
 
    // Check size of table
    // Find the smallest power of two that is greater or equal to a given value
@@ -101,6 +124,23 @@ HostProfile::HostProfile()
       D_INACTIVE_TIMEOUT, 1);
    detector_status = conf->get_cfg_val("generic rules", "rules-generic");
    port_flowdir = conf->get_cfg_val("port flowdirection", "port-flowdir");
+   update_workers = conf->get_cfg_val("Update workers", "update-workers", 0, 0);
+   overload_load = conf->get_cfg_val("Overload load", "overload-load", 0.0f);
+   peer_sketches = sketches ||
+      conf->get_cfg_val("unique IPs sketches", "uniqueips-sketches");
+   batch = NULL;
+   if (conf->get_cfg_val("batch evaluation of rules", "rules-batch")) {
+      batch = new RulesBatch();
+   }
+   checkpoint_file = trim(conf->getValue("checkpoint-file"));
+   checkpoint_interval = conf->get_cfg_val("Checkpoint interval",
+      "checkpoint-interval", 0, 0);
+   // Nothing is saved until the previous checkpoint is loaded
+   checkpoint_ready = false;
+
+   // Every update worker has its own BloomFilters for the hosts it owns
+   int bf_set_cnt = (update_workers > 0) ? update_workers : 1;
+   int bf_size = 2 * table_size / bf_set_cnt;
 
    // Update subprofile configuration
    for(sp_list_ptr_iter it = subprofile_list.begin();
@@ -113,29 +153,50 @@ HostProfile::HostProfile()
 
       // Copy subprofile's pointer and do some configurations
       sp_list.push_back(sbp_ptr);
-      sbp_ptr->bloomfilters_init(2 * table_size);
+      if (peer_sketches) {
+         sbp_ptr->sketches_enable();
+      } else {
+         sbp_ptr->bloomfilters_init(bf_size, bf_set_cnt);
+      }
    }
+   sp_dispatch.init(sp_list);
    conf->unlock();
 
    // Initialization of hosts stats table
-   stat_table = fht_init(table_size / FHT_TABLE_COLS, sizeof(hosts_key_t),
-      sizeof(hosts_record_t), STAT_TABLE_STASH_SIZE);
-   if (stat_table == NULL) {
+   stat_table = new StatTable();
+   if (!stat_table->init(table_size / FHT_TABLE_COLS, STAT_TABLE_STASH_SIZE,
+         (uint64_t) table_max_memory << 20, &kicked_record, this)) {
       log(LOG_CRIT, "CRITICAL ERROR: Failed to initialize the statistics table.");
       exit(1);
    }
 
+   // Records are added to the wheel when they are created and they are
+   // collected by the next start of detectors after they expire
+   int horizon = (active_timeout < inactive_timeout) ? inactive_timeout : active_timeout;
+   timers = new TimerWheel(horizon + det_start_time);
+
+   if (peer_sketches) {
+      // Unique IPs are counted by the records themselves
+      log(LOG_DEBUG, "process_data: Counting unique IPs by sketches in records.");
+      return;
+   }
+
    // Create BloomFilters
    bloom_parameters bp;
-   bp.projected_element_count = 2 * table_size;
+   bp.projected_element_count = bf_size;
    bp.false_positive_probability = 0.01;
    bp.compute_optimal_parameters();
-   log(LOG_DEBUG, "process_data: Creating Bloom Filter, table size: %lu, hashes: %u",
-      bp.optimal_parameters.table_size, bp.optimal_parameters.number_of_hashes);
-   bf_com_active = new bloom_filter(bp);
-   bf_com_learn = new bloom_filter(bp);
-   bf_dir_active = new bloom_filter(bp);
-   bf_dir_learn = new bloom_filter(bp);
+   log(LOG_DEBUG, "process_data: Creating Bloom Filter, table size: %lu, hashes: %u, "
+      "sets: %d", bp.optimal_parameters.table_size,
+      bp.optimal_parameters.number_of_hashes, bf_set_cnt);
+   for (int i = 0; i < bf_set_cnt; ++i) {
+      profile_bf_t set;
+      set.com_active = new bloom_filter(bp);
+      set.com_learn = new bloom_filter(bp);
+      set.dir_active = new bloom_filter(bp);
+      set.dir_learn = new bloom_filter(bp);
+      bf_sets.push_back(set);
+   }
 }
 
 /** \brief Destructor of statistics class
@@ -146,13 +207,17 @@ HostProfile::~HostProfile()
    release();
 
    // Delete hosts stats table
-   fht_destroy(stat_table);
+   delete stat_table;
+   delete timers;
+   delete batch;
 
    // Delete BloomFilters
-   delete bf_com_active;
-   delete bf_com_learn;
-   delete bf_dir_active;
-   delete bf_dir_learn;
+   for (size_t i = 0; i < bf_sets.size(); ++i) {
+      delete bf_sets[i].com_active;
+      delete bf_sets[i].com_learn;
+      delete bf_sets[i].dir_active;
+      delete bf_sets[i].dir_learn;
+   }
 
    // Delete all BloomFilters in subprofiles
    for(sp_list_ptr_iter it = sp_list.begin(); it != sp_list.end(); ++it) {
@@ -168,27 +233,39 @@ HostProfile::~HostProfile()
  *
  * \param record Pointer to the data from the TRAP
  * \param tmpl_in Pointer to the TRAP input interface
- * \param subprofiles When True update active subprofiles
+ * \param src_subprofiles When True update active subprofiles of the source
+ * \param dst_subprofiles When True update active subprofiles of the destination
  */
 void HostProfile::update(const void *record, const ur_template_t *tmpl_in,
-      bool subprofiles)
+      bool src_subprofiles, bool dst_subprofiles)
+{
+   uint8_t dir_flags;
+   if (!flow_direction(record, tmpl_in, dir_flags)) {
+      return;
+   }
+
+   update_src(record, tmpl_in, dir_flags, hs_time, 0, src_subprofiles);
+   update_dst(record, tmpl_in, dir_flags, hs_time, 0, dst_subprofiles);
+}
+
+/** \brief Filter fragments of flows and get the direction of the flow
+ *
+ * \param[in] record Pointer to the data from the TRAP
+ * \param[in] tmpl_in Pointer to the TRAP input interface
+ * \param[out] dir_flags Direction flags (request, response,...)
+ * \return False when the flow should be skipped, true otherwise
+ */
+bool HostProfile::flow_direction(const void *record, const ur_template_t *tmpl_in,
+   uint8_t &dir_flags) const
 {
    // basic filter for fragments of flows
    if (ur_get(tmpl_in, record, F_SRC_PORT) == 0 &&
        ur_get(tmpl_in, record, F_DST_PORT) == 0 &&
        ur_get(tmpl_in, record, F_PROTOCOL) == 17) {
       // Skip UDP flows with source and destination port "0"
-      return;
+      return false;
    }
 
-   // create key for the BloomFilter
-   bloom_key_t bloom_key;
-   bloom_key.src_ip = ur_get(tmpl_in, record, F_SRC_IP);
-   bloom_key.dst_ip = ur_get(tmpl_in, record, F_DST_IP);
-
-   // common part
-   uint8_t tcp_flags = ur_get(tmpl_in, record, F_TCP_FLAGS);
-   uint8_t dir_flags;
    if (port_flowdir) {
       // ignore flowdir from record and create custom
       dir_flags = DIR_FLAG_NRC;
@@ -206,27 +283,47 @@ void HostProfile::update(const void *record, const ur_template_t *tmpl_in,
       // use flowdir from unirec
       dir_flags = ur_get(tmpl_in, record, F_DIRECTION_FLAGS);
    }
+   return true;
+}
 
-   // Macros
-   #define ADD(dst, src) \
-      safe_add(dst, src);
+// Macros
+#define ADD(dst, src) \
+   safe_add(dst, src);
 
-   #define INC(value) \
-      safe_inc(value);
+#define INC(value) \
+   safe_inc(value);
 
-   /////////////////////////////////////////////////////////////////////////////
-   // SOURCE IP
+/** \brief Update the record of the source IP address of the flow
+ *
+ * The records of one host have to be always updated by the same worker
+ * (the same set of BloomFilters).
+ *
+ * \param record Pointer to the data from the TRAP
+ * \param tmpl_in Pointer to the TRAP input interface
+ * \param dir_flags Direction flags from flow_direction()
+ * \param now Current time of the module
+ * \param bf_set Set of BloomFilters of the updating worker
+ * \param subprofiles When True update active subprofiles
+ */
+void HostProfile::update_src(const void *record, const ur_template_t *tmpl_in,
+   uint8_t dir_flags, uint32_t now, int bf_set, bool subprofiles)
+{
+   // create key for the BloomFilter
+   bloom_key_t bloom_key;
+   bloom_key.src_ip = ur_get(tmpl_in, record, F_SRC_IP);
+   bloom_key.dst_ip = ur_get(tmpl_in, record, F_DST_IP);
+   uint8_t tcp_flags = ur_get(tmpl_in, record, F_TCP_FLAGS);
 
    // get source record and set/update timestamps
-   int8_t *src_lock = NULL;
-   hosts_record_t& src_host_rec = get_record(bloom_key.src_ip, &src_lock);
+   stat_lock_t src_lock;
+   hosts_record_t& src_host_rec = get_record(bloom_key.src_ip, src_lock);
    if (!src_host_rec.in_all_flows && !src_host_rec.out_all_flows) {
-      src_host_rec.first_rec_ts = hs_time;
+      src_host_rec.first_rec_ts = now;
+      src_host_rec.last_rec_ts = src_host_rec.first_rec_ts;
+      timers->add(bloom_key.src_ip, src_host_rec.first_rec_ts,
+         expiration(src_host_rec));
    }
-   src_host_rec.last_rec_ts = hs_time;
-
-   // find/add records in the BloomFilters (get info about presence of this flow)
-   bool src_present = false;
+   src_host_rec.last_rec_ts = now;
 
    // Items inserted in this BloomFilter use MSB of timestamp to determine
    // record origin (inserted by source IP or destination IP)
@@ -235,9 +332,34 @@ void HostProfile::update(const void *record, const ur_template_t *tmpl_in,
    // | -- (src_ip) --  | -- (dst_ip) -- |  0XXX XXXX XXXX XXXX   |
    bloom_key.rec_time = src_host_rec.first_rec_ts % (std::numeric_limits<uint16_t>::max() + 1);
    bloom_key.rec_time &= ((1 << 15) - 1);
-   src_present = bf_com_active->containsinsert((const unsigned char *) &bloom_key,
-      sizeof(bloom_key_t));
-   bf_com_learn->insert((const unsigned char *) &bloom_key, sizeof(bloom_key_t));
+
+   // find/add records in the BloomFilters (get info about presence of this flow)
+   bool src_present = false;
+   bool req_present = false;
+
+   if (peer_sketches) {
+      // the counters of unique IPs are set by the sketches
+      sketch_count(src_host_rec.out_all_peers, bloom_key.dst_ip,
+         src_host_rec.out_all_uniqueips);
+      if (dir_flags & DIR_FLAG_REQ) {
+         sketch_count(src_host_rec.out_req_peers, bloom_key.dst_ip,
+            src_host_rec.out_req_uniqueips);
+      }
+      src_present = true;
+      req_present = true;
+   } else {
+      profile_bf_t &bf = bf_sets[bf_set];
+      src_present = bf.com_active->containsinsert((const unsigned char *)
+         &bloom_key, sizeof(bloom_key_t));
+      bf.com_learn->insert((const unsigned char *) &bloom_key, sizeof(bloom_key_t));
+
+      if (dir_flags & DIR_FLAG_REQ) {
+         req_present = bf.dir_active->containsinsert((const unsigned char *)
+            &bloom_key, sizeof(bloom_key_t));
+         bf.dir_learn->insert((const unsigned char *) &bloom_key,
+            sizeof(bloom_key_t));
+      }
+   }
 
    // UPDATE STATS
    // all flows
@@ -257,11 +379,6 @@ void HostProfile::update(const void *record, const ur_template_t *tmpl_in,
 
    if (dir_flags & DIR_FLAG_REQ) {
       // request flows
-      bool req_present = bf_dir_active->containsinsert((const unsigned char *)
-         &bloom_key, sizeof(bloom_key_t));
-      bf_dir_learn->insert((const unsigned char *) &bloom_key,
-         sizeof(bloom_key_t));
-
       ADD(src_host_rec.out_req_bytes, ur_get(tmpl_in, record, F_BYTES));
       ADD(src_host_rec.out_req_packets, ur_get(tmpl_in, record, F_PACKETS));
       if (!req_present) INC(src_host_rec.out_req_uniqueips);
@@ -282,36 +399,75 @@ void HostProfile::update(const void *record, const ur_template_t *tmpl_in,
    }
 
    if (subprofiles) {
-      // update subprofiles
-      for(sp_list_ptr_iter it = sp_list.begin(); it != sp_list.end(); ++it) {
-         (*it)->update_src_ip(src_host_rec, record, tmpl_in, dir_flags, bloom_key);
+      // update subprofiles of the flow (usually none)
+      uint8_t sp_mask = sp_dispatch.get_mask(ur_get(tmpl_in, record, F_PROTOCOL),
+         ur_get(tmpl_in, record, F_SRC_PORT), ur_get(tmpl_in, record, F_DST_PORT));
+      if (sp_mask) {
+         sp_flow_t flow;
+         sp_flow_init(flow, record, tmpl_in, dir_flags);
+         sp_dispatch.update_src(sp_mask, src_host_rec, flow, bloom_key, bf_set);
       }
    }
 
-   fht_unlock_data(src_lock);
+   stat_table->unlock(src_lock);
+}
 
-   /////////////////////////////////////////////////////////////////////////////
-   // DESTINATION IP
+/** \brief Update the record of the destination IP address of the flow
+ * See description for #update_src
+ */
+void HostProfile::update_dst(const void *record, const ur_template_t *tmpl_in,
+   uint8_t dir_flags, uint32_t now, int bf_set, bool subprofiles)
+{
+   // create key for the BloomFilter
+   bloom_key_t bloom_key;
+   bloom_key.src_ip = ur_get(tmpl_in, record, F_SRC_IP);
+   bloom_key.dst_ip = ur_get(tmpl_in, record, F_DST_IP);
+   uint8_t tcp_flags = ur_get(tmpl_in, record, F_TCP_FLAGS);
 
-   int8_t *dst_lock = NULL;
-   hosts_record_t& dst_host_rec = get_record(bloom_key.dst_ip, &dst_lock);
+   stat_lock_t dst_lock;
+   hosts_record_t& dst_host_rec = get_record(bloom_key.dst_ip, dst_lock);
    if (!dst_host_rec.in_all_flows && !dst_host_rec.out_all_flows) {
-      dst_host_rec.first_rec_ts = hs_time;
+      dst_host_rec.first_rec_ts = now;
+      dst_host_rec.last_rec_ts = dst_host_rec.first_rec_ts;
+      timers->add(bloom_key.dst_ip, dst_host_rec.first_rec_ts,
+         expiration(dst_host_rec));
    }
 
-   dst_host_rec.last_rec_ts = hs_time;
-
-   // find/add record in the BloomFilters (get info about presence of this flow)
-   bool dst_present = false;
+   dst_host_rec.last_rec_ts = now;
 
    // Presence for destination IP
    // |    source IP    | destination IP | first record timestamp |
    // | -- (src_ip) --  | -- (dst_ip) -- |  1XXX XXXX XXXX XXXX   |
    bloom_key.rec_time = dst_host_rec.first_rec_ts % (std::numeric_limits<uint16_t>::max() + 1);
    bloom_key.rec_time |= (1 << 15);
-   dst_present = bf_com_active->containsinsert((const unsigned char *) &bloom_key,
-      sizeof(bloom_key_t));
-   bf_com_learn->insert((const unsigned char *) &bloom_key, sizeof(bloom_key_t));
+
+   // find/add record in the BloomFilters (get info about presence of this flow)
+   bool dst_present = false;
+   bool req_present = false;
+
+   if (peer_sketches) {
+      // the counters of unique IPs are set by the sketches
+      sketch_count(dst_host_rec.in_all_peers, bloom_key.src_ip,
+         dst_host_rec.in_all_uniqueips);
+      if (dir_flags & DIR_FLAG_REQ) {
+         sketch_count(dst_host_rec.in_req_peers, bloom_key.src_ip,
+            dst_host_rec.in_req_uniqueips);
+      }
+      dst_present = true;
+      req_present = true;
+   } else {
+      profile_bf_t &bf = bf_sets[bf_set];
+      dst_present = bf.com_active->containsinsert((const unsigned char *)
+         &bloom_key, sizeof(bloom_key_t));
+      bf.com_learn->insert((const unsigned char *) &bloom_key, sizeof(bloom_key_t));
+
+      if (dir_flags & DIR_FLAG_REQ) {
+         req_present = bf.dir_active->containsinsert((const unsigned char *)
+            &bloom_key, sizeof(bloom_key_t));
+         bf.dir_learn->insert((const unsigned char *) &bloom_key,
+            sizeof(bloom_key_t));
+      }
+   }
 
    // UPDATE STATS
    // all flows
@@ -332,11 +488,6 @@ void HostProfile::update(const void *record, const ur_template_t *tmpl_in,
 
    if (dir_flags & DIR_FLAG_REQ) {
       // request flows
-      bool req_present = bf_dir_active->containsinsert((const unsigned char *)
-         &bloom_key, sizeof(bloom_key_t));
-      bf_dir_learn->insert((const unsigned char *) &bloom_key,
-         sizeof(bloom_key_t));
-
       ADD(dst_host_rec.in_req_bytes, ur_get(tmpl_in, record, F_BYTES));
       ADD(dst_host_rec.in_req_packets, ur_get(tmpl_in, record, F_PACKETS));
       if (!req_present) INC(dst_host_rec.in_req_uniqueips);
@@ -357,16 +508,17 @@ void HostProfile::update(const void *record, const ur_template_t *tmpl_in,
    }
 
    if (subprofiles) {
-      // update subprofiles
-      for(sp_list_ptr_iter it = sp_list.begin(); it != sp_list.end(); ++it) {
-         (*it)->update_dst_ip(dst_host_rec, record, tmpl_in, dir_flags, bloom_key);
+      // update subprofiles of the flow (usually none)
+      uint8_t sp_mask = sp_dispatch.get_mask(ur_get(tmpl_in, record, F_PROTOCOL),
+         ur_get(tmpl_in, record, F_SRC_PORT), ur_get(tmpl_in, record, F_DST_PORT));
+      if (sp_mask) {
+         sp_flow_t flow;
+         sp_flow_init(flow, record, tmpl_in, dir_flags);
+         sp_dispatch.update_dst(sp_mask, dst_host_rec, flow, bloom_key, bf_set);
       }
    }
 
-   fht_unlock_data(dst_lock);
-
-   #undef ADD
-   #undef INC
+   stat_table->unlock(dst_lock);
 }
 
 /** \brief Remove the record by the key
@@ -375,9 +527,8 @@ void HostProfile::update(const void *record, const ur_template_t *tmpl_in,
  */
 void HostProfile::remove_by_key(const hosts_key_t &key)
 {
-   int8_t *lock = NULL;
-   hosts_record_t *rec = (hosts_record_t *) fht_get_data_with_stash_locked(
-      stat_table, (char*) key.bytes, &lock);
+   stat_lock_t lock;
+   hosts_record_t *rec = stat_table->find(key, lock);
    if (rec == NULL) {
       // not found
       return;
@@ -387,38 +538,163 @@ void HostProfile::remove_by_key(const hosts_key_t &key)
       (*it)->delete_record(*rec);
    }
 
-   int ret = fht_remove_with_stash_locked(stat_table, (char*) key.bytes, lock);
-   if (ret) {
+   if (!stat_table->remove(key, lock)) {
       log(LOG_DEBUG, "Failed to remove locked item in remove_by_key.");
-      fht_unlock_data(lock);
    }
 }
 
-/** \brief Remove subprofiles and clean the table of stats
+/** \brief Add the counters of another record of the same host
+ * Unique IPs are merged exactly only when they are counted by sketches,
+ * otherwise the peers seen by both records are counted twice.
+ * \param[in,out] rec Record of the table
+ * \param[in] other Merged record
  */
-void HostProfile::release()
+void HostProfile::merge_record(hosts_record_t &rec, const hosts_record_t &other)
 {
-   // Remove all subprofiles
-   fht_iter_t *table_iter = fht_init_iter(stat_table);
-   if (table_iter == NULL) {
-      log(LOG_ERR, "Error: Failed to remove all subprofiles. Table iterator "
-         "failed.");
+   ADD(rec.in_all_flows, other.in_all_flows);
+   ADD(rec.in_req_flows, other.in_req_flows);
+   ADD(rec.in_rsp_flows, other.in_rsp_flows);
+   ADD(rec.in_all_packets, other.in_all_packets);
+   ADD(rec.in_all_syn_packets, other.in_all_syn_packets);
+   ADD(rec.in_req_packets, other.in_req_packets);
+   ADD(rec.in_rsp_packets, other.in_rsp_packets);
+   ADD(rec.in_all_bytes, other.in_all_bytes);
+   ADD(rec.in_req_bytes, other.in_req_bytes);
+   ADD(rec.in_rsp_bytes, other.in_rsp_bytes);
+   ADD(rec.in_req_rst_cnt, other.in_req_rst_cnt);
+   ADD(rec.in_all_rst_cnt, other.in_all_rst_cnt);
+   ADD(rec.in_all_psh_cnt, other.in_all_psh_cnt);
+   ADD(rec.in_req_psh_cnt, other.in_req_psh_cnt);
+   ADD(rec.in_all_ack_cnt, other.in_all_ack_cnt);
+   ADD(rec.in_req_ack_cnt, other.in_req_ack_cnt);
+   ADD(rec.in_req_syn_cnt, other.in_req_syn_cnt);
+   ADD(rec.in_rsp_syn_cnt, other.in_rsp_syn_cnt);
+   ADD(rec.in_rsp_ack_cnt, other.in_rsp_ack_cnt);
+   ADD(rec.in_all_syn_cnt, other.in_all_syn_cnt);
+   ADD(rec.in_all_fin_cnt, other.in_all_fin_cnt);
+   ADD(rec.in_all_urg_cnt, other.in_all_urg_cnt);
+   rec.in_linkbitfield |= other.in_linkbitfield;
+
+   ADD(rec.out_all_flows, other.out_all_flows);
+   ADD(rec.out_req_flows, other.out_req_flows);
+   ADD(rec.out_rsp_flows, other.out_rsp_flows);
+   ADD(rec.out_all_packets, other.out_all_packets);
+   ADD(rec.out_req_packets, other.out_req_packets);
+   ADD(rec.out_rsp_packets, other.out_rsp_packets);
+   ADD(rec.out_all_bytes, other.out_all_bytes);
+   ADD(rec.out_req_bytes, other.out_req_bytes);
+   ADD(rec.out_rsp_bytes, other.out_rsp_bytes);
+   ADD(rec.out_all_rst_cnt, other.out_all_rst_cnt);
+   ADD(rec.out_req_rst_cnt, other.out_req_rst_cnt);
+   ADD(rec.out_all_psh_cnt, other.out_all_psh_cnt);
+   ADD(rec.out_req_psh_cnt, other.out_req_psh_cnt);
+   ADD(rec.out_all_ack_cnt, other.out_all_ack_cnt);
+   ADD(rec.out_req_ack_cnt, other.out_req_ack_cnt);
+   ADD(rec.out_rsp_ack_cnt, other.out_rsp_ack_cnt);
+   ADD(rec.out_all_syn_cnt, other.out_all_syn_cnt);
+   ADD(rec.out_req_syn_cnt, other.out_req_syn_cnt);
+   ADD(rec.out_rsp_syn_cnt, other.out_rsp_syn_cnt);
+   ADD(rec.out_all_fin_cnt, other.out_all_fin_cnt);
+   ADD(rec.out_all_urg_cnt, other.out_all_urg_cnt);
+   rec.out_linkbitfield |= other.out_linkbitfield;
+
+   if (peer_sketches) {
+      sketch_merge(rec.in_all_peers, other.in_all_peers);
+      sketch_merge(rec.in_req_peers, other.in_req_peers);
+      sketch_merge(rec.out_all_peers, other.out_all_peers);
+      sketch_merge(rec.out_req_peers, other.out_req_peers);
+      rec.in_all_uniqueips = sketch_counter(rec.in_all_peers);
+      rec.in_req_uniqueips = sketch_counter(rec.in_req_peers);
+      rec.out_all_uniqueips = sketch_counter(rec.out_all_peers);
+      rec.out_req_uniqueips = sketch_counter(rec.out_req_peers);
    } else {
-      // Iterate over the table of stats
-      while (fht_get_next_iter(table_iter) != FHT_ITER_RET_END) {
-         hosts_record_t &temp = *((hosts_record_t *) table_iter->data_ptr);
+      ADD(rec.in_req_uniqueips, other.in_req_uniqueips);
+      ADD(rec.in_all_uniqueips, other.in_all_uniqueips);
+      ADD(rec.out_req_uniqueips, other.out_req_uniqueips);
+      ADD(rec.out_all_uniqueips, other.out_all_uniqueips);
+   }
 
-         // Iterate over subprofiles
-         for (sp_list_ptr_iter it = sp_list.begin(); it != sp_list.end(); ++it){
-            (*it)->delete_record(temp);
+   if (other.first_rec_ts < rec.first_rec_ts) {
+      rec.first_rec_ts = other.first_rec_ts;
+   }
+   if (other.last_rec_ts > rec.last_rec_ts) {
+      rec.last_rec_ts = other.last_rec_ts;
+   }
+}
+
+#undef ADD
+#undef INC
+
+/** \brief Move all records of another profile to this profile
+ * Records of hosts which are in both profiles are merged. The other profile
+ * is empty afterwards. Both profiles have to use the same subprofiles.
+ * \param other Merged profile
+ */
+void HostProfile::merge(HostProfile &other)
+{
+   StatTableIter table_iter(*other.stat_table);
+   if (!table_iter.valid()) {
+      log(LOG_ERR, "Error: Failed to merge stats tables. The table iterator "
+         "failed.");
+      return;
+   }
+
+   uint32_t counter_merged = 0;
+   uint32_t counter_moved = 0;
+   while (table_iter.next()) {
+      hosts_record_t &other_rec = table_iter.record();
+      const hosts_key_t &key = table_iter.key();
+
+      stat_lock_t lock;
+      hosts_record_t &rec = get_record(key, lock);
+      if (!rec.in_all_flows && !rec.out_all_flows) {
+         // new record, take over the record with its subprofiles
+         rec = other_rec;
+         timers->add(key, rec.first_rec_ts, expiration(rec));
+         ++counter_moved;
+      } else {
+         merge_record(rec, other_rec);
+         for (sp_list_ptr_iter it = sp_list.begin(); it != sp_list.end(); ++it) {
+            (*it)->merge_record(rec, other_rec);
          }
+         ++counter_merged;
       }
+      stat_table->unlock(lock);
+
+      table_iter.remove();
+   }
+
+   other.timers->clear();
+   log(LOG_DEBUG, "Profiles merged. Records moved: %d, merged: %d",
+      counter_moved, counter_merged);
+}
 
-      fht_destroy_iter(table_iter);
+/** \brief Remove subprofiles and clean the table of stats
+ */
+void HostProfile::release()
+{
+   // Remove all subprofiles
+   {
+      StatTableIter table_iter(*stat_table);
+      if (!table_iter.valid()) {
+         log(LOG_ERR, "Error: Failed to remove all subprofiles. Table iterator "
+            "failed.");
+      } else {
+         // Iterate over the table of stats
+         while (table_iter.next()) {
+            hosts_record_t &temp = table_iter.record();
+
+            // Iterate over subprofiles
+            for (sp_list_ptr_iter it = sp_list.begin(); it != sp_list.end(); ++it){
+               (*it)->delete_record(temp);
+            }
+         }
+      }
    }
 
    // Clear table
-   fht_clear(stat_table);
+   stat_table->clear();
+   timers->clear();
 }
 
 /** \brief Swap/clean BloomFilters
@@ -426,19 +702,36 @@ void HostProfile::release()
  */
 void HostProfile::swap_bf()
 {
-   bf_com_active->clear();
-   bloom_filter *tmp = bf_com_active;
-   bf_com_active = bf_com_learn;
-   bf_com_learn = tmp;
+   for (size_t i = 0; i < bf_sets.size(); ++i) {
+      swap_bf(i);
+   }
+}
 
-   bf_dir_active->clear();
-   tmp = bf_dir_active;
-   bf_dir_active = bf_dir_learn;
-   bf_dir_learn = tmp;
+/** \brief Swap/clean BloomFilters of one update worker
+ * \param bf_set Set of BloomFilters of the worker
+ */
+void HostProfile::swap_bf(int bf_set)
+{
+   if (bf_set >= (int) bf_sets.size()) {
+      // unique IPs are counted by sketches
+      return;
+   }
+
+   profile_bf_t &bf = bf_sets[bf_set];
+
+   bf.com_active->clear();
+   bloom_filter *tmp = bf.com_active;
+   bf.com_active = bf.com_learn;
+   bf.com_learn = tmp;
+
+   bf.dir_active->clear();
+   tmp = bf.dir_active;
+   bf.dir_active = bf.dir_learn;
+   bf.dir_learn = tmp;
 
    // Swap BloomFilters in subprofiles
    for(sp_list_ptr_iter it = sp_list.begin(); it != sp_list.end(); ++it) {
-      (*it)->bloomfilters_swap();
+      (*it)->bloomfilters_swap(bf_set);
    }
 }
 
@@ -476,12 +769,11 @@ void HostProfile::check_record(const hosts_key_t &key, const hosts_record_t &rec
  * \param[out] lock Lock of the record
  * \return Referece to the record
  */
-hosts_record_t& HostProfile::get_record(const hosts_key_t& key, int8_t **lock)
+hosts_record_t& HostProfile::get_record(const hosts_key_t& key, stat_lock_t &lock)
 {
    hosts_record_t *rec = NULL;
    do {
-      rec = (hosts_record_t *) fht_get_data_with_stash_locked(stat_table,
-         (char*) key.bytes, lock);
+      rec = stat_table->find(key, lock);
 
       if (rec == NULL) {
          // the item doesn't exist, create new empty one
@@ -489,19 +781,13 @@ hosts_record_t& HostProfile::get_record(const hosts_key_t& key, int8_t **lock)
          hosts_record_t kicked_data;   // for possibly kicked data
          hosts_record_t new_empty;
 
-         int rc = fht_insert_with_stash(stat_table, (char*) key.bytes,
-            (void*) &new_empty, (char*) kicked_key.bytes, (void *) &kicked_data);
+         int rc = stat_table->insert(key, new_empty, kicked_key, kicked_data);
 
          switch (rc) {
          case FHT_INSERT_STASH_LOST:
          case FHT_INSERT_LOST:
             // Another item was kicked out of the table
-            check_record(kicked_key, kicked_data);
-
-            // Delete subprofiles in the kicked item
-            for(sp_list_ptr_iter it = sp_list.begin(); it != sp_list.end(); ++it) {
-               (*it)->delete_record(kicked_data);
-            }
+            drop_record(kicked_key, kicked_data);
             break;
          case FHT_INSERT_FAILED:
             // Something managed to insert an item sooner -> get record
@@ -516,52 +802,222 @@ hosts_record_t& HostProfile::get_record(const hosts_key_t& key, int8_t **lock)
    return *rec;
 }
 
-/** \breif Check all flow records in table
+/** \brief Check the record kicked out of the table and delete its subprofiles
+ * \param key Key of the record
+ * \param record The kicked record
+ */
+void HostProfile::drop_record(const hosts_key_t &key, hosts_record_t &record)
+{
+   check_record(key, record);
+
+   // Delete subprofiles in the kicked item
+   for(sp_list_ptr_iter it = sp_list.begin(); it != sp_list.end(); ++it) {
+      (*it)->delete_record(record);
+   }
+}
+
+/** \brief Record kicked out of the table while the table grows
+ * \param arg The profile of the table
+ * \param key Key of the record
+ * \param record The kicked record
+ */
+void HostProfile::kicked_record(void *arg, const hosts_key_t &key,
+   hosts_record_t &record)
+{
+   ((HostProfile *) arg)->drop_record(key, record);
+}
+
+/** \brief Get the expiration time of the record
+ * The record is checked when it is in the table longer than the active timeout
+ * or it has not been updated for the inactive timeout.
+ * \param record Record of the table
+ * \return Time when the record expires
+ */
+uint32_t HostProfile::expiration(const hosts_record_t &record) const
+{
+   uint32_t active = record.first_rec_ts + active_timeout;
+   uint32_t inactive = record.last_rec_ts + inactive_timeout;
+   return (active < inactive) ? active : inactive;
+}
+
+/** \breif Check expired flow records in table
  * If a record is valid and it is in the table longer than a specified
  * time or has not been updated for specified time then the record is
- * checked by detectors and invalidated.
+ * checked by detectors and invalidated. Only the records collected from the
+ * timer wheel are visited, records which have been updated since they were
+ * added are added again with their new expiration time.
  * \param[in] check_all If true, ignore (in)active timeout and check every valid flow
  */
 void HostProfile::check_table(bool check_all)
 {
-   // Init table iterator
-   fht_iter_t *table_iter = fht_init_iter(stat_table);
-   if (table_iter == NULL) {
-      log(LOG_ERR, "Error: Failed to check stats table. The table iterator failed.");
+   uint64_t start = metrics_start();
+   if (check_all) {
+      check_whole_table();
+      metrics_stop(check_all_metric, start);
       return;
    }
 
+   std::vector<timer_entry_t> expired;
+   timers->collect(hs_time, expired);
+
    log(LOG_DEBUG, "Detectors started...");
    uint32_t counter_checked = 0;
-   uint32_t counter_intable = 0;
+   uint32_t counter_delayed = 0;
 
-   // Iterate over the table of stats
-   while (fht_get_next_iter(table_iter) != FHT_ITER_RET_END) {
-      ++counter_intable;
+   for (size_t i = 0; i < expired.size(); ++i) {
+      const hosts_key_t &key = expired[i].key;
+      stat_lock_t lock;
+      hosts_record_t *rec = stat_table->find(key, lock);
+      if (rec == NULL) {
+         // the record has already been kicked out and checked
+         continue;
+      }
 
-      // Get record and check timestamps
-      hosts_record_t &rec = *((hosts_record_t *) table_iter->data_ptr);
-      if (!check_all &&
-         rec.first_rec_ts + active_timeout > hs_time &&
-         rec.last_rec_ts + inactive_timeout > hs_time) {
+      if (rec->first_rec_ts != expired[i].first_rec_ts) {
+         // a newer record with the same key, it has its own entry in the wheel
+         stat_table->unlock(lock);
          continue;
       }
 
-      // Get key and check record
-      const hosts_key_t &key = *((hosts_key_t *) table_iter->key_ptr);
-      check_record(key, rec);
+      uint32_t expires = expiration(*rec);
+      if (expires > hs_time) {
+         timers->add(key, rec->first_rec_ts, expires);
+         stat_table->unlock(lock);
+         ++counter_delayed;
+         continue;
+      }
 
-      // Delete subprofiles in the kicked item
-      for(sp_list_ptr_iter it = sp_list.begin(); it != sp_list.end(); ++it) {
-         (*it)->delete_record(rec);
+      bool batch_full = false;
+      if (batch != NULL) {
+         // the record is checked and its subprofiles deleted with the batch
+         batch_full = batch->add(key, *rec);
+      } else {
+         check_record(key, *rec);
+
+         // Delete subprofiles in the expired item
+         for(sp_list_ptr_iter it = sp_list.begin(); it != sp_list.end(); ++it) {
+            (*it)->delete_record(*rec);
+         }
       }
 
       // Remove record
-      fht_remove_iter(table_iter);
+      if (!stat_table->remove(key, lock)) {
+         log(LOG_DEBUG, "Failed to remove locked item in check_table.");
+      }
       ++counter_checked;
+
+      if (batch_full) {
+         check_batch();
+      }
    }
 
-   fht_destroy_iter(table_iter);
+   if (batch != NULL) {
+      check_batch();
+   }
+
+   log(LOG_DEBUG, "Detectors ended. Records expired: %lu, checked and "
+      "removed: %d, not expired yet: %d", (unsigned long) expired.size(),
+      counter_checked, counter_delayed);
+
+   metrics_counter_add(checked_metric, counter_checked);
+   metrics_counter_add(delayed_metric, counter_delayed);
+   metrics_gauge_set(timers_metric, timers->size());
+   table_metrics();
+   metrics_stop(check_expired_metric, start);
+}
+
+/** \brief Update the metrics of the size of the table
+ */
+void HostProfile::table_metrics()
+{
+   uint64_t capacity = stat_table->capacity();
+   uint64_t records = stat_table->size();
+   metrics_gauge_set(records_metric, records);
+   metrics_gauge_set(capacity_metric, capacity);
+   metrics_gauge_set(load_metric, capacity ? records * 1000 / capacity : 0);
+}
+
+/** \brief Check all flow records in table
+ * Every valid record is checked by detectors and invalidated.
+ */
+void HostProfile::check_whole_table()
+{
+   log(LOG_DEBUG, "Detectors started...");
+   uint32_t counter_checked = 0;
+   uint32_t counter_intable = 0;
+
+   {
+      // Init table iterator
+      StatTableIter table_iter(*stat_table);
+      if (!table_iter.valid()) {
+         log(LOG_ERR, "Error: Failed to check stats table. The table iterator failed.");
+         return;
+      }
+
+      // Iterate over the table of stats
+      while (table_iter.next()) {
+         ++counter_intable;
+
+         // Get record and its key and check the record
+         hosts_record_t &rec = table_iter.record();
+         const hosts_key_t &key = table_iter.key();
+         bool batch_full = false;
+         if (batch != NULL) {
+            batch_full = batch->add(key, rec);
+         } else {
+            check_record(key, rec);
+
+            // Delete subprofiles in the kicked item
+            for(sp_list_ptr_iter it = sp_list.begin(); it != sp_list.end(); ++it) {
+               (*it)->delete_record(rec);
+            }
+         }
+
+         // Remove record
+         table_iter.remove();
+         ++counter_checked;
+
+         if (batch_full) {
+            check_batch();
+         }
+      }
+   }
+
+   if (batch != NULL) {
+      check_batch();
+   }
+   timers->clear();
    log(LOG_DEBUG, "Detectors ended. Records in the table: %d, "
       "checked and removed: %d", counter_intable, counter_checked);
+
+   metrics_counter_add(checked_metric, counter_checked);
+   metrics_gauge_set(timers_metric, 0);
+   table_metrics();
+}
+
+/** \brief Check the records collected in the batch
+ * Conditions of the rules are evaluated for the whole batch first, only the
+ * records which may match some rule are checked by detectors. Subprofiles
+ * of all records are deleted.
+ */
+void HostProfile::check_batch()
+{
+   batch->evaluate(detector_status);
+
+   uint32_t counter_candidates = 0;
+   for (int i = 0; i < batch->size(); ++i) {
+      hosts_record_t &rec = batch->record(i);
+      if (batch->candidate(i)) {
+         check_record(batch->key(i), rec);
+         ++counter_candidates;
+      }
+
+      for(sp_list_ptr_iter it = sp_list.begin(); it != sp_list.end(); ++it) {
+         (*it)->delete_record(rec);
+      }
+   }
+
+   log(LOG_DEBUG, "Batch of %d records checked, %u of them by detectors.",
+      batch->size(), counter_candidates);
+   batch->clear();
 }
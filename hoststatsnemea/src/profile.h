@@ -45,10 +45,13 @@
 #ifndef _PROFILE_H_
 #define _PROFILE_H_
 
+#include <string>
 #include <vector>
 #include <BloomFilter.hpp>
 #include "hoststats.h"
 #include "subprofiles.h"
+#include "timerwheel.h"
+#include "stattable.h"
 
 extern "C" {
    #include <unirec/unirec.h>
@@ -68,37 +71,91 @@ extern "C" {
 
 /* -------------------- MAIN PROFILE -------------------- */
 
-class HostProfile {
-private:
-   stat_table_t *stat_table;   // Statistics table
+class RulesBatch;
 
+// Set of BloomFilters used by one update worker
+struct profile_bf_t {
    // Pointers to common active/learning BloomFilter
-   bloom_filter *bf_com_active, *bf_com_learn;
+   bloom_filter *com_active, *com_learn;
    // Pointer to active/learning BloomFilter for flow direction (req/rsp)
-   bloom_filter *bf_dir_active, *bf_dir_learn;
+   bloom_filter *dir_active, *dir_learn;
+};
+
+class HostProfile {
+private:
+   StatTable *stat_table;      // Statistics table
+   TimerWheel *timers;         // Expiration of the records in the table
+   RulesBatch *batch;          // Expired records checked together (NULL if disabled)
+
+   // BloomFilters, one set per update worker (only one without the workers)
+   std::vector<profile_bf_t> bf_sets;
 
    int table_size;            // Size of table
    bool detector_status;      // Main profile detector active/inactive
    bool port_flowdir;         // Flow direction based on port value (0[off]/1[on])
+   bool peer_sketches;        // Unique IPs counted by sketches instead of BloomFilters
    sp_list_ptr_v sp_list;     // List of enabled subprofiles
+   SubprofileDispatch sp_dispatch;  // Subprofiles by protocols and ports of flows
+   bool checkpoint_ready;     // The previous checkpoint has been loaded
 
    // Get the reference of record from the table
-   hosts_record_t& get_record(const hosts_key_t& key, int8_t **lock);
+   hosts_record_t& get_record(const hosts_key_t& key, stat_lock_t &lock);
+
+   // Check the record kicked out of the table and delete its subprofiles
+   void drop_record(const hosts_key_t &key, hosts_record_t &record);
+
+   // Callback of the table for the records kicked out while it grows
+   static void kicked_record(void *arg, const hosts_key_t &key,
+      hosts_record_t &record);
+
+   // Update the metrics of the size of the table
+   void table_metrics();
+
+   // Run detectors on each record in table regardless of timeouts
+   void check_whole_table();
+
+   // Get the time when the record should be checked
+   uint32_t expiration(const hosts_record_t &record) const;
+
+   // Run detectors on the records in the batch and delete them
+   void check_batch();
+
+   // Insert the record loaded from the checkpoint
+   bool insert_record(const hosts_key_t &key, const hosts_record_t &record);
+
+   // Add the counters of another record of the same host
+   void merge_record(hosts_record_t &record, const hosts_record_t &other);
 
 public:
    int active_timeout;
    int inactive_timeout;
    int det_start_time;
+   int update_workers;        // Number of update threads (0 = update by the reader)
+   float overload_load;       // Load of the reader degrading the updates (0 = disabled)
+   std::string checkpoint_file;  // File with the checkpoint (empty = disabled)
+   int checkpoint_interval;   // Period of checkpoints (0 = only on exit)
 
    // Constructor
-   HostProfile();
+   HostProfile(bool sketches = false);
 
    // Destructor
    ~HostProfile();
 
    // Update the main profile and subprofiles
    void update(const void *record, const ur_template_t *tmplt,
-      bool subprofiles = true);
+      bool src_subprofiles = true, bool dst_subprofiles = true);
+
+   // Filter the flow and get its direction flags
+   bool flow_direction(const void *record, const ur_template_t *tmplt,
+      uint8_t &dir_flags) const;
+
+   // Update the record of the source IP of the flow
+   void update_src(const void *record, const ur_template_t *tmplt,
+      uint8_t dir_flags, uint32_t now, int bf_set, bool subprofiles = true);
+
+   // Update the record of the destination IP of the flow
+   void update_dst(const void *record, const ur_template_t *tmplt,
+      uint8_t dir_flags, uint32_t now, int bf_set, bool subprofiles = true);
 
    // Remove record from the main profile and subprofiles
    void remove_by_key(const hosts_key_t &key);
@@ -106,15 +163,27 @@ public:
    // Release all stats loaded in memory
    void release();
 
+   // Move all records of another profile to this profile
+   void merge(HostProfile &other);
+
    // Clear active BloomFilter and swap pointers
    void swap_bf();
 
+   // Clear active BloomFilter and swap pointers in one set
+   void swap_bf(int bf_set);
+
    // Run detectors on the record
    void check_record(const hosts_key_t &key, const hosts_record_t &record,
       bool subprofiles = true);
 
    // Run detectors on each record in table
    void check_table(bool check_all);
+
+   // Save all records to the checkpoint file
+   bool save_checkpoint(uint32_t now);
+
+   // Load records from the checkpoint file
+   bool load_checkpoint(uint32_t now);
 };
 
 #endif
@@ -0,0 +1,127 @@
+/**
+ * \file sketch.h
+ * \brief Small HyperLogLog sketch (common hll) counting unique peers of a host
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef _SKETCH_H_
+#define _SKETCH_H_
+
+#include <stdint.h>
+
+extern "C" {
+   #include <unirec/unirec.h>
+}
+#include "hll.h"
+
+#define SKETCH_REGISTERS   64    // Number of registers (power of two)
+#define SKETCH_INDEX_BITS  6     // log2(SKETCH_REGISTERS)
+
+// Sketch of a set of IP addresses stored directly in a record (4 bits per register)
+struct peer_sketch_t {
+   uint8_t regs[SKETCH_REGISTERS / 2];
+};
+
+/** \brief View of the registers of the sketch for the hll functions
+ * \param[in] sketch Sketch
+ * \return View of the registers
+ */
+inline hll_t sketch_hll(const peer_sketch_t &sketch)
+{
+   return hll_view(const_cast<uint8_t *>(sketch.regs), SKETCH_INDEX_BITS, 4);
+}
+
+/** \brief Add the IP address to the sketch
+ * \param[in,out] sketch Sketch
+ * \param[in] ip IP address
+ * \return True if the sketch has changed (the estimate may have changed)
+ */
+inline bool sketch_insert(peer_sketch_t &sketch, const ip_addr_t &ip)
+{
+   hll_t hll = sketch_hll(sketch);
+   return hll_add(&hll, hll_hash(&ip, sizeof(ip)), NULL) != 0;
+}
+
+/** \brief Estimate the number of unique IP addresses in the sketch
+ * \param[in] sketch Sketch
+ * \return Estimated number of unique addresses
+ */
+inline uint32_t sketch_estimate(const peer_sketch_t &sketch)
+{
+   hll_t hll = sketch_hll(sketch);
+   return hll_estimate(&hll);
+}
+
+/** \brief Add all IP addresses of the other sketch to the sketch
+ * \param[in,out] sketch Sketch
+ * \param[in] other Merged sketch
+ */
+inline void sketch_merge(peer_sketch_t &sketch, const peer_sketch_t &other)
+{
+   hll_t hll = sketch_hll(sketch);
+   hll_t other_hll = sketch_hll(other);
+   hll_merge(&hll, &other_hll);
+}
+
+/** \brief Get the counter of unique IPs from the sketch
+ * \param[in] sketch Sketch
+ * \return Estimate limited to the size of the counter
+ */
+inline uint16_t sketch_counter(const peer_sketch_t &sketch)
+{
+   uint32_t estimate = sketch_estimate(sketch);
+   return (estimate > 0xffff) ? 0xffff : estimate;
+}
+
+/** \brief Add the IP address to the sketch and update the counter of unique IPs
+ * \param[in,out] sketch Sketch
+ * \param[in] ip IP address
+ * \param[in,out] counter Counter of unique IPs of the record
+ */
+inline void sketch_count(peer_sketch_t &sketch, const ip_addr_t &ip,
+   uint16_t &counter)
+{
+   if (!sketch_insert(sketch, ip)) {
+      return;
+   }
+
+   counter = sketch_counter(sketch);
+}
+
+#endif
@@ -0,0 +1,502 @@
+/**
+ * \file stattable.cpp
+ * \brief Statistics table growing up to a memory limit
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <unistd.h>
+#include "stattable.h"
+#include "aux_func.h"
+#include "metrics.h"
+#include "affinity.h"
+
+// Runtime metrics of the table
+static metrics_counter_t *kicked_metric = metrics_counter(
+   "hoststats_table_kicked_total", "Records kicked out of the statistics table by new records.");
+static metrics_counter_t *stash_metric = metrics_counter(
+   "hoststats_table_stash_inserts_total", "Records inserted into the stash of a full row of the table.");
+static metrics_counter_t *growths_metric = metrics_counter(
+   "hoststats_table_growths_total", "Doublings of the statistics table.");
+static metrics_counter_t *moved_metric = metrics_counter(
+   "hoststats_table_moved_total", "Records moved to the new table during the growth.");
+
+// Memory of one slot of the table (key, record and a part of the lock of its row)
+#define STAT_TABLE_SLOT_SIZE (sizeof(hosts_key_t) + sizeof(hosts_record_t) + 1)
+
+/** \brief Constructor of the table
+ * The table is allocated by init().
+ */
+StatTable::StatTable()
+{
+   current = NULL;
+   previous = NULL;
+   rows = 0;
+   max_rows = 0;
+   stash_size = 0;
+   records = 0;
+   generation = 0;
+   epochs[0].operations = 0;
+   epochs[1].operations = 0;
+   kicked = NULL;
+   kicked_arg = NULL;
+   grow_running = false;
+   grow_requested = false;
+   stop = false;
+   pthread_mutex_init(&lock, NULL);
+   pthread_mutex_init(&grow_lock, NULL);
+   pthread_cond_init(&grow_cond, NULL);
+}
+
+/** \brief Destructor of the table
+ * Records have to be released (their subprofiles) before.
+ */
+StatTable::~StatTable()
+{
+   if (grow_running) {
+      pthread_mutex_lock(&grow_lock);
+      stop = true;
+      pthread_cond_signal(&grow_cond);
+      pthread_mutex_unlock(&grow_lock);
+      pthread_join(grow_thread, NULL);
+   }
+
+   if (current != NULL) {
+      fht_destroy(current);
+   }
+   pthread_cond_destroy(&grow_cond);
+   pthread_mutex_destroy(&grow_lock);
+   pthread_mutex_destroy(&lock);
+}
+
+/** \brief Allocate the table
+ * The table is doubled while the old and the new table together fit into
+ * the memory limit, each time its size doubles.
+ * \param rows Initial number of rows (power of two)
+ * \param stash Size of the stash of the table
+ * \param max_memory Memory limit of the table in bytes (0 = fixed size)
+ * \param kicked Called for the records kicked out during the growth
+ * \param kicked_arg Argument of the kicked function
+ * \return True on success, false otherwise
+ */
+bool StatTable::init(uint32_t rows, uint32_t stash, uint64_t max_memory,
+   stat_kicked_t kicked, void *kicked_arg)
+{
+   current = fht_init(rows, sizeof(hosts_key_t), sizeof(hosts_record_t), stash);
+   if (current == NULL) {
+      return false;
+   }
+
+   this->rows = rows;
+   this->stash_size = stash;
+   this->kicked = kicked;
+   this->kicked_arg = kicked_arg;
+
+   max_rows = rows;
+   while (max_rows <= (1U << 30) &&
+      3 * (uint64_t) max_rows * FHT_TABLE_COLS * STAT_TABLE_SLOT_SIZE <= max_memory) {
+      max_rows *= 2;
+   }
+   if (max_rows == rows) {
+      // fixed size, no growth thread
+      return true;
+   }
+
+   log(LOG_DEBUG, "Statistics table can grow from %u to %u rows.", rows, max_rows);
+   if (affinity_thread_create(&grow_thread, &run, this) != 0) {
+      log(LOG_ERR, "Error: Failed to start the thread of the table growth, "
+         "the table has a fixed size.");
+      max_rows = rows;
+      return true;
+   }
+   grow_running = true;
+   return true;
+}
+
+/** \brief Start an operation with the tables
+ * The operation is counted in the epoch of the current generation. When the
+ * generation changes meanwhile the operation is moved to the new epoch, so
+ * the growth thread does not miss it.
+ * \return Epoch of the operation
+ */
+int StatTable::enter()
+{
+   while (true) {
+      uint32_t gen = __atomic_load_n(&generation, __ATOMIC_SEQ_CST);
+      int epoch = gen & 1;
+      __atomic_add_fetch(&epochs[epoch].operations, 1, __ATOMIC_SEQ_CST);
+      if (__atomic_load_n(&generation, __ATOMIC_SEQ_CST) == gen) {
+         return epoch;
+      }
+      __atomic_sub_fetch(&epochs[epoch].operations, 1, __ATOMIC_RELEASE);
+   }
+}
+
+/** \brief Finish an operation with the tables
+ * \param epoch Epoch returned by enter()
+ */
+void StatTable::leave(int epoch)
+{
+   __atomic_sub_fetch(&epochs[epoch].operations, 1, __ATOMIC_RELEASE);
+}
+
+/** \brief Wait until all operations of the epoch are finished
+ * \param epoch Epoch of the previous generation
+ */
+void StatTable::drain(int epoch)
+{
+   while (__atomic_load_n(&epochs[epoch].operations, __ATOMIC_ACQUIRE) != 0) {
+      usleep(STAT_TABLE_DRAIN_SLEEP);
+   }
+}
+
+/** \brief Find the record in the table and lock it
+ * During the growth the record is searched in the new table first.
+ * \param[in] key Key of the record
+ * \param[out] lock Lock of the record
+ * \return Record or NULL if it's not in the table
+ */
+hosts_record_t *StatTable::find(const hosts_key_t &key, stat_lock_t &lock)
+{
+   lock.epoch = enter();
+
+   fht_table_t *table = __atomic_load_n(&current, __ATOMIC_SEQ_CST);
+   hosts_record_t *rec = (hosts_record_t *) fht_get_data_with_stash_locked(
+      table, (char*) key.bytes, &lock.row);
+   if (rec == NULL) {
+      table = __atomic_load_n(&previous, __ATOMIC_SEQ_CST);
+      if (table != NULL) {
+         rec = (hosts_record_t *) fht_get_data_with_stash_locked(
+            table, (char*) key.bytes, &lock.row);
+      }
+   }
+
+   if (rec == NULL) {
+      leave(lock.epoch);
+      return NULL;
+   }
+   lock.table = table;
+   return rec;
+}
+
+/** \brief Unlock the record
+ * \param lock Lock returned by find()
+ */
+void StatTable::unlock(stat_lock_t &lock)
+{
+   fht_unlock_data(lock.row);
+   leave(lock.epoch);
+}
+
+/** \brief Remove the locked record
+ * \param key Key of the record
+ * \param lock Lock returned by find()
+ * \return True if the record was removed
+ */
+bool StatTable::remove(const hosts_key_t &key, stat_lock_t &lock)
+{
+   bool removed = fht_remove_with_stash_locked(lock.table, (char*) key.bytes,
+      lock.row) == FHT_REMOVE_OK;
+   if (removed) {
+      __atomic_sub_fetch(&records, 1, __ATOMIC_RELAXED);
+   } else {
+      fht_unlock_data(lock.row);
+   }
+   leave(lock.epoch);
+   return removed;
+}
+
+/** \brief Insert the record into the current table
+ * \param[in] key Key of the record
+ * \param[in] record The record
+ * \param[out] kicked_key Key of the record kicked out of the table
+ * \param[out] kicked_record Record kicked out of the table
+ * \return Return code of fht_insert_with_stash()
+ */
+int StatTable::insert(const hosts_key_t &key, const hosts_record_t &record,
+   hosts_key_t &kicked_key, hosts_record_t &kicked_record)
+{
+   int epoch = enter();
+   fht_table_t *table = __atomic_load_n(&current, __ATOMIC_SEQ_CST);
+   int rc = fht_insert_with_stash(table, (char*) key.bytes, (void*) &record,
+      (char*) kicked_key.bytes, (void*) &kicked_record);
+   leave(epoch);
+
+   switch (rc) {
+   case FHT_INSERT_OK:
+      __atomic_add_fetch(&records, 1, __ATOMIC_RELAXED);
+      break;
+   case FHT_INSERT_STASH_OK:
+      __atomic_add_fetch(&records, 1, __ATOMIC_RELAXED);
+      metrics_counter_inc(stash_metric);
+      break;
+   case FHT_INSERT_STASH_LOST:
+      metrics_counter_inc(stash_metric);
+      // fall through
+   case FHT_INSERT_LOST:
+      metrics_counter_inc(kicked_metric);
+      // the row is full, grow even though the table is not full yet
+      request_growth();
+      return rc;
+   default:
+      return rc;
+   }
+
+   if (should_grow()) {
+      request_growth();
+   }
+   return rc;
+}
+
+/** \brief Remove all records
+ * Subprofiles of the records have to be deleted before.
+ */
+void StatTable::clear()
+{
+   pthread_mutex_lock(&lock);
+   fht_clear(current);
+   __atomic_store_n(&records, 0, __ATOMIC_RELAXED);
+   pthread_mutex_unlock(&lock);
+}
+
+/** \brief Number of records in the table
+ */
+uint32_t StatTable::size() const
+{
+   return __atomic_load_n(&records, __ATOMIC_RELAXED);
+}
+
+/** \brief Number of slots of the current table
+ */
+uint64_t StatTable::capacity() const
+{
+   return (uint64_t) __atomic_load_n(&rows, __ATOMIC_RELAXED) * FHT_TABLE_COLS;
+}
+
+/** \brief The current table is full enough to be doubled
+ */
+bool StatTable::should_grow() const
+{
+   uint32_t limit = __atomic_load_n(&max_rows, __ATOMIC_RELAXED);
+   return __atomic_load_n(&rows, __ATOMIC_RELAXED) < limit &&
+      size() * (uint64_t) STAT_TABLE_GROW_DEN > capacity() * STAT_TABLE_GROW_NUM;
+}
+
+/** \brief Wake up the growth thread
+ * Only the first request is signalled, the others are ignored until the
+ * thread takes it.
+ */
+void StatTable::request_growth()
+{
+   uint32_t limit = __atomic_load_n(&max_rows, __ATOMIC_RELAXED);
+   if (!grow_running || __atomic_load_n(&grow_requested, __ATOMIC_RELAXED) ||
+      __atomic_load_n(&rows, __ATOMIC_RELAXED) >= limit) {
+      return;
+   }
+
+   pthread_mutex_lock(&grow_lock);
+   __atomic_store_n(&grow_requested, true, __ATOMIC_RELAXED);
+   pthread_cond_signal(&grow_cond);
+   pthread_mutex_unlock(&grow_lock);
+}
+
+/** \brief Double the table
+ * The new table replaces the current one, then the records inserted into the
+ * old table by the operations which started before are moved after them. The
+ * old table is freed when no operation can be using it. Operations with the
+ * records continue meanwhile, the records being moved are locked in the old
+ * table until they are in the new one.
+ */
+void StatTable::grow()
+{
+   uint32_t new_rows = rows * 2;
+   fht_table_t *table = fht_init(new_rows, sizeof(hosts_key_t),
+      sizeof(hosts_record_t), stash_size);
+   if (table == NULL) {
+      log(LOG_ERR, "Error: Failed to allocate the statistics table with %u "
+         "rows, the table will not grow anymore.", new_rows);
+      __atomic_store_n(&max_rows, rows, __ATOMIC_RELAXED);
+      return;
+   }
+
+   // New operations insert into the new table
+   __atomic_store_n(&previous, current, __ATOMIC_SEQ_CST);
+   __atomic_store_n(&current, table, __ATOMIC_SEQ_CST);
+   __atomic_store_n(&rows, new_rows, __ATOMIC_RELAXED);
+   drain(__atomic_fetch_add(&generation, 1, __ATOMIC_SEQ_CST) & 1);
+
+   fht_iter_t *iter = fht_init_iter(previous);
+   uint32_t moved = 0;
+   uint32_t lost = 0;
+   while (iter != NULL && fht_get_next_iter(iter) != FHT_ITER_RET_END) {
+      const hosts_key_t &key = *((hosts_key_t *) iter->key_ptr);
+      hosts_record_t &rec = *((hosts_record_t *) iter->data_ptr);
+
+      // The record is still locked in the old table while it's inserted
+      hosts_key_t kicked_key;
+      hosts_record_t kicked_rec;
+      int rc = fht_insert_with_stash(current, (char*) key.bytes, (void*) &rec,
+         (char*) kicked_key.bytes, (void*) &kicked_rec);
+      switch (rc) {
+      case FHT_INSERT_STASH_LOST:
+      case FHT_INSERT_LOST:
+         kicked(kicked_arg, kicked_key, kicked_rec);
+         ++lost;
+         break;
+      case FHT_INSERT_FAILED:
+         // a record was created for the host in the new table meanwhile
+         kicked(kicked_arg, key, rec);
+         ++lost;
+         break;
+      default:
+         ++moved;
+         break;
+      }
+      fht_remove_iter(iter);
+   }
+   if (iter != NULL) {
+      fht_destroy_iter(iter);
+   } else {
+      log(LOG_ERR, "Error: Failed to move the records of the statistics table.");
+   }
+   __atomic_sub_fetch(&records, lost, __ATOMIC_RELAXED);
+
+   // Operations of the old epoch may still search the old table
+   fht_table_t *old = previous;
+   __atomic_store_n(&previous, (fht_table_t *) NULL, __ATOMIC_SEQ_CST);
+   drain(__atomic_fetch_add(&generation, 1, __ATOMIC_SEQ_CST) & 1);
+   fht_destroy(old);
+
+   metrics_counter_inc(growths_metric);
+   metrics_counter_add(moved_metric, moved);
+   metrics_counter_add(kicked_metric, lost);
+   log(LOG_INFO, "Statistics table doubled to %u rows, records moved: %u, "
+      "lost: %u", new_rows, moved, lost);
+}
+
+/** \brief Thread function of the growth
+ * \param arg The table
+ */
+void *StatTable::run(void *arg)
+{
+   StatTable *table = (StatTable *) arg;
+
+   while (true) {
+      pthread_mutex_lock(&table->grow_lock);
+      while (!table->grow_requested && !table->stop) {
+         pthread_cond_wait(&table->grow_cond, &table->grow_lock);
+      }
+      bool stop = table->stop;
+      pthread_mutex_unlock(&table->grow_lock);
+      if (stop) {
+         break;
+      }
+
+      pthread_mutex_lock(&table->lock);
+      table->grow();
+      // the table may need to grow again after a burst of new hosts
+      while (table->should_grow()) {
+         table->grow();
+      }
+      pthread_mutex_unlock(&table->lock);
+
+      pthread_mutex_lock(&table->grow_lock);
+      __atomic_store_n(&table->grow_requested, false, __ATOMIC_RELAXED);
+      pthread_mutex_unlock(&table->grow_lock);
+   }
+
+   return NULL;
+}
+
+/* -------------------- ITERATOR -------------------- */
+
+/** \brief Constructor of the iterator
+ * \param table Iterated table
+ */
+StatTableIter::StatTableIter(StatTable &table) : table(table)
+{
+   pthread_mutex_lock(&table.lock);
+   iter = fht_init_iter(table.current);
+}
+
+/** \brief Destructor of the iterator
+ */
+StatTableIter::~StatTableIter()
+{
+   if (iter != NULL) {
+      fht_destroy_iter(iter);
+   }
+   pthread_mutex_unlock(&table.lock);
+}
+
+/** \brief The iterator has been created successfully
+ */
+bool StatTableIter::valid() const
+{
+   return iter != NULL;
+}
+
+/** \brief Move to the next record
+ * \return False at the end of the table
+ */
+bool StatTableIter::next()
+{
+   return fht_get_next_iter(iter) != FHT_ITER_RET_END;
+}
+
+/** \brief Key of the current record
+ */
+const hosts_key_t &StatTableIter::key() const
+{
+   return *((hosts_key_t *) iter->key_ptr);
+}
+
+/** \brief Current record
+ */
+hosts_record_t &StatTableIter::record() const
+{
+   return *((hosts_record_t *) iter->data_ptr);
+}
+
+/** \brief Remove the current record
+ */
+void StatTableIter::remove()
+{
+   fht_remove_iter(iter);
+   __atomic_sub_fetch(&table.records, 1, __ATOMIC_RELAXED);
+}
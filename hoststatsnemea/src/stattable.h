@@ -0,0 +1,190 @@
+/**
+ * \file stattable.h
+ * \brief Statistics table growing up to a memory limit (header file)
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef _STATTABLE_H_
+#define _STATTABLE_H_
+
+#include <pthread.h>
+#include "hoststats.h"
+
+// Records of the table per slot when the growth is requested (1/2), rows
+// of four slots start to overflow to the stash above it
+#define STAT_TABLE_GROW_NUM 1
+#define STAT_TABLE_GROW_DEN 2
+
+// Sleep of the growth thread while it waits for operations with the old table [us]
+#define STAT_TABLE_DRAIN_SLEEP 100
+
+// Record removed from the table by the table itself (kicked out by a new record)
+typedef void (*stat_kicked_t)(void *arg, const hosts_key_t &key, hosts_record_t &record);
+
+// Lock of a record found in the table, released by unlock() or remove()
+struct stat_lock_t {
+   int8_t *row;            // Lock of the row of the record
+   fht_table_t *table;     // Table containing the record
+   int epoch;              // Epoch of the operation holding the lock
+};
+
+/* -------------------- STATISTICS TABLE -------------------- */
+
+/**
+ * Fast hash table of host records which grows without stopping its users.
+ * When the table is half full (or a record is kicked out) and the memory limit
+ * allows a table of double size, a separate thread allocates the new table.
+ * New records are inserted into the new table, records are searched in both
+ * tables and the thread moves the records of the old table one by one to the
+ * new one. The old table is freed when no operation started before the
+ * migration ended can use it (every operation is counted in the epoch it
+ * started in). Iterations and the growth exclude each other.
+ */
+class StatTable {
+private:
+   struct epoch_t {
+      uint32_t operations;    // Running operations started in the epoch
+      char pad[60];           // Keeps the epochs in different cache lines
+   };
+
+   fht_table_t *current;      // New records are inserted into this table
+   fht_table_t *previous;     // Table being moved to the current one (NULL if none)
+   uint32_t rows;             // Rows of the current table
+   uint32_t max_rows;         // The table does not grow beyond this number of rows
+   uint32_t stash_size;       // Stash of every table
+   uint32_t records;          // Records in both tables
+   uint32_t generation;       // Incremented when the tables change, its parity is the epoch
+   epoch_t epochs[2];
+
+   stat_kicked_t kicked;      // Called for records kicked out by the growth thread
+   void *kicked_arg;
+
+   pthread_mutex_t lock;      // Held by the growth and by the iterations
+   pthread_mutex_t grow_lock; // Protects grow_requested and stop
+   pthread_cond_t grow_cond;
+   pthread_t grow_thread;
+   bool grow_running;
+   bool grow_requested;
+   bool stop;
+
+   // Start an operation and get its epoch
+   int enter();
+   // Finish an operation
+   void leave(int epoch);
+   // Wait until all operations of the epoch are finished
+   void drain(int epoch);
+
+   // Ask the growth thread to double the table if it is allowed
+   void request_growth();
+   // The current table should be doubled
+   bool should_grow() const;
+   // Double the table and move all records to the new table
+   void grow();
+   // Thread function of the growth
+   static void *run(void *arg);
+
+   friend class StatTableIter;
+
+public:
+   // Constructor
+   StatTable();
+
+   // Destructor, stops the growth thread and frees the tables
+   ~StatTable();
+
+   // Allocate the table, it can grow up to max_memory bytes (0 = fixed size)
+   bool init(uint32_t rows, uint32_t stash, uint64_t max_memory,
+      stat_kicked_t kicked, void *kicked_arg);
+
+   // Find the record and lock it (NULL if it's not in the table)
+   hosts_record_t *find(const hosts_key_t &key, stat_lock_t &lock);
+
+   // Unlock the record found by find()
+   void unlock(stat_lock_t &lock);
+
+   // Remove the record found by find() (it's unlocked in any case)
+   bool remove(const hosts_key_t &key, stat_lock_t &lock);
+
+   // Insert the record, returns FHT_INSERT_* as fht_insert_with_stash()
+   int insert(const hosts_key_t &key, const hosts_record_t &record,
+      hosts_key_t &kicked_key, hosts_record_t &kicked_record);
+
+   // Remove all records
+   void clear();
+
+   // Number of records
+   uint32_t size() const;
+
+   // Number of slots of the current table (without the stash)
+   uint64_t capacity() const;
+};
+
+/**
+ * Iteration over all records of the table, the table does not grow while
+ * the iterator exists. Rows are locked by the iterator as by fht_iter_t.
+ */
+class StatTableIter {
+private:
+   StatTable &table;
+   fht_iter_t *iter;
+
+public:
+   // Constructor, waits for the growth in progress
+   StatTableIter(StatTable &table);
+
+   // Destructor
+   ~StatTableIter();
+
+   // The iterator has been created successfully
+   bool valid() const;
+
+   // Move to the next record, false at the end
+   bool next();
+
+   // Key of the current record
+   const hosts_key_t &key() const;
+
+   // Current record
+   hosts_record_t &record() const;
+
+   // Remove the current record
+   void remove();
+};
+
+#endif
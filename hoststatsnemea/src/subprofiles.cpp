@@ -42,6 +42,7 @@
  *
  */
 
+#include <string.h>
 #include "subprofiles.h"
 #include "detectionrules.h"
 extern "C" {
@@ -50,11 +51,12 @@ extern "C" {
 
 /* HOW TO ADD NEW SUBPROFILE:
  * 1) In subprofiles.h create new class derived from class "SubprofileBase".
- *    This class must consists of 4 required functions from base class:
+ *    This class must consists of 5 required functions from base class:
  *       - update_src_ip(...)
  *       - update_dst_ip(...)
  *       - check_record(...)
  *       - delete record(...)
+ *       - merge_record(...)
  *    Also define data structure for statistic record about a host.
  *
  * 2) In hoststats.h add a declaration of data structure to "List of
@@ -73,6 +75,15 @@ extern "C" {
  *       - name of the subprofile
  *       - required UniRec template
  *       - number of required BloomFilters (optional)
+ *       - type of the subprofile (optional, see below)
+ *    and add_port() to specify protocols and ports of the flows processed
+ *    by the subprofile. update_src_ip()/update_dst_ip() are called only for
+ *    these flows and get the items of the flow in sp_flow_t. When you add
+ *    a new type into sp_type_t and a case into SubprofileDispatch, the
+ *    subprofile is called directly instead of the virtual call.
+ *    BloomFilters are used through bloomfilters_get_presence() with the set
+ *    passed to update_src_ip()/update_dst_ip(), each update worker has its
+ *    own set.
  *    Note: check_record() function is a function with detector of a suspicious
  *       behavior. You should add this function to detection_rules.cpp(/.h).
  *
@@ -118,14 +129,18 @@ void unregister_subprofiles() {
  * \param[in] name Name of new subprofile
  * \param[in] tmpl_str Required UniRec items
  * \param[in] bloom_filters_cnt A number of required BloomFilter pairs
+ * \param[in] type Type of the subprofile in the dispatch
  */
 SubprofileBase::SubprofileBase(std::string name, std::string tmpl_str,
-   int bloom_filters_cnt)
+   int bloom_filters_cnt, sp_type_t type)
 {
    sbp_enabled = false;
    sbp_name = trim(name);
    sbp_tmpl = trim(tmpl_str);
    sbp_bloom_cnt = bloom_filters_cnt;
+   sbp_bloom_sets = 0;
+   sbp_sketches = false;
+   sbp_type = type;
 
    log(LOG_DEBUG, "Subprofile '%s' created.", sbp_name.c_str());
 }
@@ -138,11 +153,26 @@ SubprofileBase::~SubprofileBase()
    log(LOG_DEBUG, "Subprofile '%s' destroyed.", sbp_name.c_str());
 }
 
+/** \brief Process flows with the protocol and the port
+ * The subprofile is updated by flows with the protocol and the source or
+ * the destination port.
+ * \param[in] protocol Protocol of the flows
+ * \param[in] port Source or destination port of the flows
+ */
+void SubprofileBase::add_port(uint8_t protocol, uint16_t port)
+{
+   sp_port_t item;
+   item.protocol = protocol;
+   item.port = port;
+   sbp_ports.push_back(item);
+}
+
 /** \brief Initialization of BloomFilters
  * Create new instances of BloomFilters with specified size
  * \param[in] size Size of each BloomFilter
+ * \param[in] sets Number of independent sets of the BloomFilter pairs
  */
-void SubprofileBase::bloomfilters_init(int size)
+void SubprofileBase::bloomfilters_init(int size, int sets)
 {
    if (sbp_bloom_cnt <= 0) {
       // No bloomfilters required
@@ -155,7 +185,8 @@ void SubprofileBase::bloomfilters_init(int size)
    bp.false_positive_probability = 0.01;
    bp.compute_optimal_parameters();
 
-   for (int i = 0; i < sbp_bloom_cnt; ++i) {
+   sbp_bloom_sets = sets;
+   for (int i = 0; i < sbp_bloom_cnt * sbp_bloom_sets; ++i) {
       bloom_filters_t pair;
       pair.bf_active = new bloom_filter(bp);
       pair.bf_learn = new bloom_filter(bp);
@@ -172,15 +203,23 @@ void SubprofileBase::bloomfilters_destroy() {
       delete pair.bf_learn;
       bloom_filters.pop_back();
    }
+   sbp_bloom_sets = 0;
 }
 
 /** \brief Swap BloomFilters
  * Clear active BloomFilter and swap active and learning BloomFilter.
+ * \param[in] set Set of the BloomFilter pairs
  */
-void SubprofileBase::bloomfilters_swap()
+void SubprofileBase::bloomfilters_swap(int set)
 {
-   std::vector<bloom_filters_t>::iterator it = bloom_filters.begin();
-   while (it != bloom_filters.end()) {
+   if (set >= sbp_bloom_sets) {
+      return;
+   }
+
+   std::vector<bloom_filters_t>::iterator it = bloom_filters.begin() +
+      set * sbp_bloom_cnt;
+   std::vector<bloom_filters_t>::iterator end = it + sbp_bloom_cnt;
+   while (it != end) {
       it->bf_active->clear();
       bloom_filter *tmp = it->bf_active;
       it->bf_active = it->bf_learn;
@@ -192,12 +231,14 @@ void SubprofileBase::bloomfilters_swap()
 /** \brief Test whether key is in the set and than insert key
  *
  * \param[in] key Key
+ * \param[in] set Set of the BloomFilter pairs
  * \param[in] index Index of BloomFilter pair according to the number of pairs
  * defined in the constructor (0th pair by default).
  * \return True if key is known, otherwise false.
  */
-bool SubprofileBase::bloomfilters_get_presence(const bloom_key_t &key, int index) {
-   bloom_filters_t &filter = bloom_filters[index];
+bool SubprofileBase::bloomfilters_get_presence(const bloom_key_t &key, int set,
+   int index) {
+   bloom_filters_t &filter = bloom_filters[set * sbp_bloom_cnt + index];
    bool status = filter.bf_active->containsinsert((const unsigned char *) &key,
       sizeof(bloom_key_t));
    filter.bf_learn->insert((const unsigned char *) &key, sizeof(bloom_key_t));
@@ -207,8 +248,10 @@ bool SubprofileBase::bloomfilters_get_presence(const bloom_key_t &key, int index
 
 /******************************* SSH subprofile *******************************/
 // Constructor
-SSHSubprofile::SSHSubprofile() : SubprofileBase("ssh", "SRC_IP,DST_IP,SRC_PORT,DST_PORT,PROTOCOL,PACKETS,BYTES,TIME_FIRST,TIME_LAST,TCP_FLAGS,LINK_BIT_FIELD,DIR_BIT_FIELD", 1)
+SSHSubprofile::SSHSubprofile() : SubprofileBase("ssh", "SRC_IP,DST_IP,SRC_PORT,DST_PORT,PROTOCOL,PACKETS,BYTES,TIME_FIRST,TIME_LAST,TCP_FLAGS,LINK_BIT_FIELD,DIR_BIT_FIELD", 1, SP_TYPE_SSH)
 {
+   // Flow filter
+   add_port(6, 22);
 }
 
 // Destructor
@@ -216,73 +259,65 @@ SSHSubprofile::~SSHSubprofile()
 {
 }
 
-// Flow filter
-bool SSHSubprofile::flow_filter(const void* data, const ur_template_t* tmplt)
-{
-   return (ur_get(tmplt, data, F_PROTOCOL) == 6
-      && (
-         ur_get(tmplt, data, F_SRC_PORT) == 22 ||
-         ur_get(tmplt, data, F_DST_PORT) == 22
-      ));
-}
-
 // Update a record of source IP address
-bool SSHSubprofile::update_src_ip(hosts_record_t &main_record, const void *data,
-   const ur_template_t *tmplt, uint8_t dir_flags, const bloom_key_t &ips)
+bool SSHSubprofile::update_src_ip(hosts_record_t &main_record, const sp_flow_t &flow,
+   const bloom_key_t &ips, int bf_set)
 {
-   /* Flow filter and record creator */
-   if (!flow_filter(data, tmplt)) {
-      return 0;
-   }
+   /* Record creator */
    if (main_record.ssh_data == NULL) {
       main_record.ssh_data = new ssh_data_t;
    }
 
    /* Update items */
-   bool src_present = bloomfilters_get_presence(ips);
-   uint8_t tcp_flags = ur_get(tmplt, data, F_TCP_FLAGS);
+   uint8_t tcp_flags = flow.tcp_flags;
    ssh_data_t &src_host_rec = *main_record.ssh_data;
 
-   if (!src_present) INC(src_host_rec.out_all_uniqueips);
+   if (sketches_enabled()) {
+      sketch_count(src_host_rec.out_all_peers, ips.dst_ip,
+         src_host_rec.out_all_uniqueips);
+   } else if (!bloomfilters_get_presence(ips, bf_set)) {
+      INC(src_host_rec.out_all_uniqueips);
+   }
 
-   if (dir_flags & DIR_FLAG_REQ) {
+   if (flow.dir_flags & DIR_FLAG_REQ) {
       // request flows
-      ADD(src_host_rec.out_req_packets, ur_get(tmplt, data, F_PACKETS));
+      ADD(src_host_rec.out_req_packets, flow.packets);
       if (tcp_flags & TCP_SYN) INC(src_host_rec.out_req_syn_cnt);
-   } else if (dir_flags & DIR_FLAG_RSP) {
+   } else if (flow.dir_flags & DIR_FLAG_RSP) {
       // respose flows
-      ADD(src_host_rec.out_rsp_packets, ur_get(tmplt, data, F_PACKETS));
+      ADD(src_host_rec.out_rsp_packets, flow.packets);
       if (tcp_flags & TCP_SYN) INC(src_host_rec.out_rsp_syn_cnt);
    }
    return 1;
 }
 
 // Update a record of destination IP address
-bool SSHSubprofile::update_dst_ip(hosts_record_t &main_record, const void *data,
-   const ur_template_t *tmplt, uint8_t dir_flags, const bloom_key_t &ips)
+bool SSHSubprofile::update_dst_ip(hosts_record_t &main_record, const sp_flow_t &flow,
+   const bloom_key_t &ips, int bf_set)
 {
-   /* Flow filter and record creator */
-   if (!flow_filter(data, tmplt)) {
-      return 0;
-   }
+   /* Record creator */
    if (main_record.ssh_data == NULL) {
       main_record.ssh_data = new ssh_data_t;
    }
 
    /* Update items */
-   bool dst_present = bloomfilters_get_presence(ips);
-   uint8_t tcp_flags = ur_get(tmplt, data, F_TCP_FLAGS);
+   uint8_t tcp_flags = flow.tcp_flags;
    ssh_data_t &dst_host_rec = *main_record.ssh_data;
 
-   if (!dst_present) INC(dst_host_rec.in_all_uniqueips);
+   if (sketches_enabled()) {
+      sketch_count(dst_host_rec.in_all_peers, ips.src_ip,
+         dst_host_rec.in_all_uniqueips);
+   } else if (!bloomfilters_get_presence(ips, bf_set)) {
+      INC(dst_host_rec.in_all_uniqueips);
+   }
 
-   if (dir_flags & DIR_FLAG_REQ) {
+   if (flow.dir_flags & DIR_FLAG_REQ) {
       // request flows
-      ADD(dst_host_rec.in_req_packets, ur_get(tmplt, data, F_PACKETS));
+      ADD(dst_host_rec.in_req_packets, flow.packets);
       if (tcp_flags & TCP_SYN) INC(dst_host_rec.in_req_syn_cnt);
-   } else if (dir_flags & DIR_FLAG_RSP) {
+   } else if (flow.dir_flags & DIR_FLAG_RSP) {
       // respose flows
-      ADD(dst_host_rec.in_rsp_packets, ur_get(tmplt, data, F_PACKETS));
+      ADD(dst_host_rec.in_rsp_packets, flow.packets);
       if (tcp_flags & TCP_SYN) INC(dst_host_rec.in_rsp_syn_cnt);
    }
    return 1;
@@ -310,10 +345,53 @@ bool SSHSubprofile::delete_record(hosts_record_t &record)
    }
 }
 
+// Merge record
+bool SSHSubprofile::merge_record(hosts_record_t &record, hosts_record_t &other)
+{
+   if (other.ssh_data == NULL) {
+      return 0;
+   }
+   if (record.ssh_data == NULL) {
+      record.ssh_data = other.ssh_data;
+      other.ssh_data = NULL;
+      return 1;
+   }
+
+   ssh_data_t &host_rec = *record.ssh_data;
+   const ssh_data_t &other_rec = *other.ssh_data;
+
+   ADD(host_rec.out_req_packets, other_rec.out_req_packets);
+   ADD(host_rec.out_rsp_packets, other_rec.out_rsp_packets);
+   ADD(host_rec.out_req_syn_cnt, other_rec.out_req_syn_cnt);
+   ADD(host_rec.out_rsp_syn_cnt, other_rec.out_rsp_syn_cnt);
+   ADD(host_rec.in_req_packets, other_rec.in_req_packets);
+   ADD(host_rec.in_rsp_packets, other_rec.in_rsp_packets);
+   ADD(host_rec.in_req_syn_cnt, other_rec.in_req_syn_cnt);
+   ADD(host_rec.in_rsp_syn_cnt, other_rec.in_rsp_syn_cnt);
+
+   if (sketches_enabled()) {
+      sketch_merge(host_rec.out_all_peers, other_rec.out_all_peers);
+      host_rec.out_all_uniqueips = sketch_counter(host_rec.out_all_peers);
+      sketch_merge(host_rec.in_all_peers, other_rec.in_all_peers);
+      host_rec.in_all_uniqueips = sketch_counter(host_rec.in_all_peers);
+   } else {
+      // peers seen by both records are counted twice
+      ADD(host_rec.out_all_uniqueips, other_rec.out_all_uniqueips);
+      ADD(host_rec.in_all_uniqueips, other_rec.in_all_uniqueips);
+   }
+
+   delete other.ssh_data;
+   other.ssh_data = NULL;
+   return 1;
+}
+
 /******************************* DNS subprofile *******************************/
 // Constructor
-DNSSubprofile::DNSSubprofile() : SubprofileBase("dns", "SRC_IP,DST_IP,SRC_PORT,DST_PORT,PROTOCOL,PACKETS,BYTES,TIME_FIRST,TIME_LAST,TCP_FLAGS,LINK_BIT_FIELD,DIR_BIT_FIELD")
+DNSSubprofile::DNSSubprofile() : SubprofileBase("dns", "SRC_IP,DST_IP,SRC_PORT,DST_PORT,PROTOCOL,PACKETS,BYTES,TIME_FIRST,TIME_LAST,TCP_FLAGS,LINK_BIT_FIELD,DIR_BIT_FIELD", 0, SP_TYPE_DNS)
 {
+   // Flow filter
+   add_port(6, 53);
+   add_port(17, 53);
 }
 
 // Destructor
@@ -321,35 +399,22 @@ DNSSubprofile::~DNSSubprofile()
 {
 }
 
-// Flow filter
-bool DNSSubprofile::flow_filter(const void* data, const ur_template_t* tmplt)
-{
-   return ((ur_get(tmplt, data, F_PROTOCOL) == 6  ||
-            ur_get(tmplt, data, F_PROTOCOL) == 17)
-            &&
-           (ur_get(tmplt, data, F_SRC_PORT) == 53 ||
-            ur_get(tmplt, data, F_DST_PORT) == 53));
-}
-
 // Update a record of source IP address
-bool DNSSubprofile::update_src_ip(hosts_record_t& main_record, const void* data,
-   const ur_template_t* tmplt, uint8_t dir_flags, const bloom_key_t& ips)
+bool DNSSubprofile::update_src_ip(hosts_record_t& main_record, const sp_flow_t& flow,
+   const bloom_key_t& ips, int bf_set)
 {
-   /* Flow filter and record creator */
-   if (!flow_filter(data, tmplt)) {
-      return 0;
-   }
+   /* Record creator */
    if (main_record.dns_data == NULL) {
       main_record.dns_data = new dns_data_t;
    }
 
    /* Update items */
    dns_data_t &src_host_rec = *main_record.dns_data;
-   size_t packets_in_flow = ur_get(tmplt, data, F_PACKETS);
+   size_t packets_in_flow = flow.packets;
    if (!packets_in_flow) {
       packets_in_flow = 1;
    }
-   if (dir_flags & DIR_FLAG_RSP && (ur_get(tmplt, data, F_BYTES) / packets_in_flow) >=
+   if (flow.dir_flags & DIR_FLAG_RSP && (flow.bytes / packets_in_flow) >=
       DNS_BYTES_OVERLIMIT) {
       INC(src_host_rec.out_rsp_overlimit_cnt);
    }
@@ -357,24 +422,21 @@ bool DNSSubprofile::update_src_ip(hosts_record_t& main_record, const void* data,
 }
 
 // Update a record of destination IP address
-bool DNSSubprofile::update_dst_ip(hosts_record_t& main_record, const void* data,
-   const ur_template_t* tmplt, uint8_t dir_flags, const bloom_key_t& ips)
+bool DNSSubprofile::update_dst_ip(hosts_record_t& main_record, const sp_flow_t& flow,
+   const bloom_key_t& ips, int bf_set)
 {
-   /* Flow filter and record creator */
-   if (!flow_filter(data, tmplt)) {
-      return 0;
-   }
+   /* Record creator */
    if (main_record.dns_data == NULL) {
       main_record.dns_data = new dns_data_t;
    }
 
    /* Update items */
    dns_data_t &dst_host_rec = *main_record.dns_data;
-   size_t packets_in_flow = ur_get(tmplt, data, F_PACKETS);
+   size_t packets_in_flow = flow.packets;
    if (!packets_in_flow) {
       packets_in_flow = 1;
    }
-   if (dir_flags & DIR_FLAG_RSP && (ur_get(tmplt, data, F_BYTES) / packets_in_flow) >=
+   if (flow.dir_flags & DIR_FLAG_RSP && (flow.bytes / packets_in_flow) >=
       DNS_BYTES_OVERLIMIT) {
       INC(dst_host_rec.in_rsp_overlimit_cnt);
    }
@@ -404,4 +466,162 @@ bool DNSSubprofile::delete_record(hosts_record_t &record)
    }
 }
 
+// Merge record
+bool DNSSubprofile::merge_record(hosts_record_t &record, hosts_record_t &other)
+{
+   if (other.dns_data == NULL) {
+      return 0;
+   }
+   if (record.dns_data == NULL) {
+      record.dns_data = other.dns_data;
+      other.dns_data = NULL;
+      return 1;
+   }
+
+   ADD(record.dns_data->in_rsp_overlimit_cnt, other.dns_data->in_rsp_overlimit_cnt);
+   ADD(record.dns_data->out_rsp_overlimit_cnt, other.dns_data->out_rsp_overlimit_cnt);
+
+   delete other.dns_data;
+   other.dns_data = NULL;
+   return 1;
+}
+
 /* Add your new subprofile here ... */
+
+/***************************** Subprofile dispatch ****************************/
+
+/** \brief Extract the items of a flow for subprofiles
+ * \param[out] flow Items of the flow
+ * \param[in] data New data from TRAP
+ * \param[in] tmplt Input template
+ * \param[in] dir_flags Direction flag (request, response,...)
+ */
+void sp_flow_init(sp_flow_t &flow, const void *data, const ur_template_t *tmplt,
+   uint8_t dir_flags)
+{
+   flow.bytes = ur_get(tmplt, data, F_BYTES);
+   flow.packets = ur_get(tmplt, data, F_PACKETS);
+   flow.src_port = ur_get(tmplt, data, F_SRC_PORT);
+   flow.dst_port = ur_get(tmplt, data, F_DST_PORT);
+   flow.protocol = ur_get(tmplt, data, F_PROTOCOL);
+   flow.tcp_flags = ur_get(tmplt, data, F_TCP_FLAGS);
+   flow.dir_flags = dir_flags;
+}
+
+// Constructor
+SubprofileDispatch::SubprofileDispatch()
+{
+   sp_cnt = 0;
+   memset(proto_slot, 0, sizeof(proto_slot));
+   port_masks = NULL;
+}
+
+// Destructor
+SubprofileDispatch::~SubprofileDispatch()
+{
+   delete [] port_masks;
+}
+
+/** \brief Build the tables from the list of enabled subprofiles
+ * Every subprofile gets one bit of the mask and the bit is set for all
+ * protocols and ports of the subprofile.
+ * \param[in] list List of enabled subprofiles
+ */
+void SubprofileDispatch::init(const sp_list_ptr_v &list)
+{
+   delete [] port_masks;
+   port_masks = NULL;
+   memset(proto_slot, 0, sizeof(proto_slot));
+   sp_cnt = 0;
+
+   // One table of ports for every protocol used by the subprofiles
+   int slots = 0;
+   for (sp_list_ptr_citer it = list.begin(); it != list.end(); ++it) {
+      const std::vector<sp_port_t> &ports = (*it)->get_ports();
+      for (size_t i = 0; i < ports.size(); ++i) {
+         if (proto_slot[ports[i].protocol] == 0) {
+            proto_slot[ports[i].protocol] = ++slots;
+         }
+      }
+   }
+   if (slots == 0) {
+      return;
+   }
+
+   port_masks = new uint8_t[(size_t) slots << 16];
+   memset(port_masks, 0, (size_t) slots << 16);
+
+   for (sp_list_ptr_citer it = list.begin(); it != list.end(); ++it) {
+      if (sp_cnt == SP_DISPATCH_MAX) {
+         log(LOG_ERR, "Too many subprofiles, subprofile '%s' is not updated.",
+            (*it)->get_name().c_str());
+         continue;
+      }
+
+      const std::vector<sp_port_t> &ports = (*it)->get_ports();
+      for (size_t i = 0; i < ports.size(); ++i) {
+         size_t slot = proto_slot[ports[i].protocol] - 1;
+         port_masks[(slot << 16) + ports[i].port] |= (1 << sp_cnt);
+      }
+      sp[sp_cnt++] = *it;
+   }
+}
+
+/** \brief Update the subprofiles in the mask of a source IP address record
+ * Known types of subprofiles are called directly, others by virtual call.
+ * \param[in] mask Mask of subprofiles (see #get_mask)
+ * \param[in,out] main_record Main record to update
+ * \param[in] flow Items of the flow
+ * \param[in] ips BloomFilter key
+ * \param[in] bf_set Set of BloomFilters of the updating worker
+ */
+void SubprofileDispatch::update_src(uint8_t mask, hosts_record_t &main_record,
+   const sp_flow_t &flow, const bloom_key_t &ips, int bf_set)
+{
+   while (mask) {
+      SubprofileBase *sbp_ptr = sp[__builtin_ctz(mask)];
+      mask &= mask - 1;
+
+      switch (sbp_ptr->get_type()) {
+      case SP_TYPE_DNS:
+         static_cast<DNSSubprofile *>(sbp_ptr)->DNSSubprofile::update_src_ip(
+            main_record, flow, ips, bf_set);
+         break;
+      case SP_TYPE_SSH:
+         static_cast<SSHSubprofile *>(sbp_ptr)->SSHSubprofile::update_src_ip(
+            main_record, flow, ips, bf_set);
+         break;
+      /* Add your new subprofile here ... */
+      default:
+         sbp_ptr->update_src_ip(main_record, flow, ips, bf_set);
+         break;
+      }
+   }
+}
+
+/** \brief Update the subprofiles in the mask of a destination IP address record
+ * See description for #update_src
+ */
+void SubprofileDispatch::update_dst(uint8_t mask, hosts_record_t &main_record,
+   const sp_flow_t &flow, const bloom_key_t &ips, int bf_set)
+{
+   while (mask) {
+      SubprofileBase *sbp_ptr = sp[__builtin_ctz(mask)];
+      mask &= mask - 1;
+
+      switch (sbp_ptr->get_type()) {
+      case SP_TYPE_DNS:
+         static_cast<DNSSubprofile *>(sbp_ptr)->DNSSubprofile::update_dst_ip(
+            main_record, flow, ips, bf_set);
+         break;
+      case SP_TYPE_SSH:
+         static_cast<SSHSubprofile *>(sbp_ptr)->SSHSubprofile::update_dst_ip(
+            main_record, flow, ips, bf_set);
+         break;
+      /* Add your new subprofile here ... */
+      default:
+         sbp_ptr->update_dst_ip(main_record, flow, ips, bf_set);
+         break;
+      }
+   }
+}
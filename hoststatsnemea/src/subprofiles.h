@@ -57,6 +57,34 @@ extern "C" {
 
 class SubprofileBase;
 
+// Types of subprofiles with a direct call in the dispatch
+enum sp_type_t {
+   SP_TYPE_OTHER = 0,
+   SP_TYPE_DNS,
+   SP_TYPE_SSH
+};
+
+// Protocol and port of the flows processed by a subprofile
+struct sp_port_t {
+   uint8_t protocol;
+   uint16_t port;
+};
+
+// Items of a flow extracted once for all subprofiles
+struct sp_flow_t {
+   uint64_t bytes;
+   uint32_t packets;
+   uint16_t src_port;
+   uint16_t dst_port;
+   uint8_t protocol;
+   uint8_t tcp_flags;
+   uint8_t dir_flags;
+};
+
+// Extract the items of a flow for subprofiles
+void sp_flow_init(sp_flow_t &flow, const void *data, const ur_template_t *tmplt,
+   uint8_t dir_flags);
+
 // Typedefs for the vector of pointers on subprofiles
 typedef std::vector<SubprofileBase *> sp_list_ptr_v;
 typedef sp_list_ptr_v::iterator sp_list_ptr_iter;
@@ -81,6 +109,14 @@ private:
    bool sbp_enabled;
    // Bloom filters pairs
    int sbp_bloom_cnt;
+   // Number of sets of the pairs (one set per update worker)
+   int sbp_bloom_sets;
+   // Unique IPs are counted by sketches in the records instead of BloomFilters
+   bool sbp_sketches;
+   // Type of the subprofile
+   sp_type_t sbp_type;
+   // Protocols and ports of the flows processed by the subprofile
+   std::vector<sp_port_t> sbp_ports;
 
    // Structure for active and learning Bloom Filters
    struct bloom_filters_t {
@@ -90,9 +126,14 @@ private:
    // BloomFilters
    std::vector<bloom_filters_t> bloom_filters;
 
+protected:
+   // Process flows with the protocol and the source or destination port
+   void add_port(uint8_t protocol, uint16_t port);
+
 public:
    // Constructor
-   SubprofileBase(std::string name, std::string tmpl_str, int bloom_filters_cnt = 0);
+   SubprofileBase(std::string name, std::string tmpl_str, int bloom_filters_cnt = 0,
+      sp_type_t type = SP_TYPE_OTHER);
    // Destructor
    virtual ~SubprofileBase();
 
@@ -106,35 +147,42 @@ public:
    void disable() {sbp_enabled = false;};
    // Enable subprofile
    void enable() {sbp_enabled = true;};
+   // Type of the subprofile
+   sp_type_t get_type() {return sbp_type;};
+   // Protocols and ports of the flows processed by the subprofile
+   const std::vector<sp_port_t> &get_ports() {return sbp_ports;};
 
    // Init BloomFilters
-   void bloomfilters_init(int size);
+   void bloomfilters_init(int size, int sets = 1);
    // Destroy BloomFilters
    void bloomfilters_destroy();
    // Swap BloomFilters
-   void bloomfilters_swap();
+   void bloomfilters_swap(int set);
    // Test whether key is in the set and than insert key
-   bool bloomfilters_get_presence(const bloom_key_t &key, int index = 0);
+   bool bloomfilters_get_presence(const bloom_key_t &key, int set, int index = 0);
+   // Count unique IPs by sketches instead of BloomFilters
+   void sketches_enable() {sbp_sketches = true;};
+   // Status of the sketches
+   bool sketches_enabled() {return sbp_sketches;};
 
    /** \brief Update a record of source IP address
-    * Update the record with new data from TRAP. The record is updated if
-    * a flow data belongs to the subprofile. If the record does not exist,
-    * new one is created.
+    * Update the record with new data from TRAP. The function is called only
+    * for flows with a protocol and a port of the subprofile (see #add_port).
+    * If the record does not exist, new one is created.
     * \param[in,out] main_record Main record to update
-    * \param[in] data New data from TRAP
-    * \param[in] tmplt Input template
-    * \param[in] dir_flags Direction flag (request, response,...)
+    * \param[in] flow Items of the flow
     * \param[in] ips BloomFilter key
+    * \param[in] bf_set Set of BloomFilters of the updating worker
     * \return True when data belongs to the subprofile, false otherwise
     */
-   virtual bool update_src_ip(hosts_record_t &main_record, const void *data,
-      const ur_template_t *tmplt, uint8_t dir_flags, const bloom_key_t &ips) = 0;
+   virtual bool update_src_ip(hosts_record_t &main_record, const sp_flow_t &flow,
+      const bloom_key_t &ips, int bf_set) = 0;
 
    /** \brief Update a record of destination IP address
     * See description for #update_src_ip
     */
-   virtual bool update_dst_ip(hosts_record_t &main_record, const void *data,
-      const ur_template_t *tmplt, uint8_t dir_flags, const bloom_key_t &ips) = 0;
+   virtual bool update_dst_ip(hosts_record_t &main_record, const sp_flow_t &flow,
+      const bloom_key_t &ips, int bf_set) = 0;
 
    /** \brief Check rules in a record
     * Use detection rules only if subprofile exists
@@ -148,6 +196,15 @@ public:
     * \param[in,out] record Main record with general statistics
     */
    virtual bool delete_record(hosts_record_t &record) = 0;
+
+   /** \brief Add a subprofile of another record of the same host
+    * The subprofile of the other record is moved or added to the subprofile
+    * of the record and removed from the other record.
+    * \param[in,out] record Main record with general statistics
+    * \param[in,out] other Merged main record
+    * \return True, if the subprofile of the other record exists, false otherwise
+    */
+   virtual bool merge_record(hosts_record_t &record, hosts_record_t &other) = 0;
 };
 
 
@@ -160,12 +217,14 @@ struct ssh_data_t {
    uint16_t out_req_syn_cnt;
    uint16_t out_rsp_syn_cnt;
    uint16_t out_all_uniqueips;
+   peer_sketch_t out_all_peers;
 
    uint16_t in_req_packets;
    uint16_t in_rsp_packets;
    uint16_t in_req_syn_cnt;
    uint16_t in_rsp_syn_cnt;
    uint16_t in_all_uniqueips;
+   peer_sketch_t in_all_peers;
 
    ssh_data_t() {
       memset(this, 0, sizeof(ssh_data_t));
@@ -175,21 +234,18 @@ struct ssh_data_t {
 /** \brief SSH subprofile
  */
 class SSHSubprofile : public SubprofileBase {
-private:
-   // A filter for incomming flows
-   bool flow_filter(const void *data, const ur_template_t *tmplt);
-
 public:
    SSHSubprofile();
    ~SSHSubprofile();
 
    // Definition of required functions
-   bool update_src_ip(hosts_record_t &main_record, const void *data,
-      const ur_template_t *tmplt, uint8_t dir_flags, const bloom_key_t &ips);
-   bool update_dst_ip(hosts_record_t &main_record, const void *data,
-      const ur_template_t *tmplt, uint8_t dir_flags, const bloom_key_t &ips);
+   bool update_src_ip(hosts_record_t &main_record, const sp_flow_t &flow,
+      const bloom_key_t &ips, int bf_set);
+   bool update_dst_ip(hosts_record_t &main_record, const sp_flow_t &flow,
+      const bloom_key_t &ips, int bf_set);
    bool check_record(const hosts_key_t &key, const hosts_record_t &record);
    bool delete_record(hosts_record_t &record);
+   bool merge_record(hosts_record_t &record, hosts_record_t &other);
 };
 
 /******************************* DNS subprofile *******************************/
@@ -209,22 +265,67 @@ private:
    // A threshold for excessive average packet size in flows
    static const unsigned DNS_BYTES_OVERLIMIT = 1000;
 
-   // A filter for incomming flows
-   bool flow_filter(const void *data, const ur_template_t *tmplt);
-
 public:
    DNSSubprofile();
    ~DNSSubprofile();
 
    // Definition of required functions
-   bool update_src_ip(hosts_record_t &main_record, const void *data,
-      const ur_template_t *tmplt, uint8_t dir_flags, const bloom_key_t &ips);
-   bool update_dst_ip(hosts_record_t &main_record, const void *data,
-      const ur_template_t *tmplt, uint8_t dir_flags, const bloom_key_t &ips);
+   bool update_src_ip(hosts_record_t &main_record, const sp_flow_t &flow,
+      const bloom_key_t &ips, int bf_set);
+   bool update_dst_ip(hosts_record_t &main_record, const sp_flow_t &flow,
+      const bloom_key_t &ips, int bf_set);
    bool check_record(const hosts_key_t &key, const hosts_record_t &record);
    bool delete_record(hosts_record_t &record);
+   bool merge_record(hosts_record_t &record, hosts_record_t &other);
 };
 
 /* Add your new subprofile here ... */
 
+/***************************** Subprofile dispatch ****************************/
+// Maximal number of subprofiles in the dispatch (bits of the mask)
+#define SP_DISPATCH_MAX 8
+
+/** \brief Dispatch of flows to subprofiles
+ * The table of protocols and ports is built from the enabled subprofiles,
+ * so subprofiles of a flow are found by one lookup and only these subprofiles
+ * are updated.
+ */
+class SubprofileDispatch {
+private:
+   SubprofileBase *sp[SP_DISPATCH_MAX];   // Subprofiles by bits of the mask
+   int sp_cnt;
+   uint8_t proto_slot[256];   // Table of ports of the protocol (0 = none)
+   uint8_t *port_masks;       // Masks of subprofiles, 65536 per table
+
+public:
+   SubprofileDispatch();
+   ~SubprofileDispatch();
+
+   // Build the tables from the list of enabled subprofiles
+   void init(const sp_list_ptr_v &list);
+
+   /** \brief Get subprofiles of the flow
+    * \param[in] protocol Protocol of the flow
+    * \param[in] src_port Source port of the flow
+    * \param[in] dst_port Destination port of the flow
+    * \return Mask of subprofiles (0 if no subprofile applies)
+    */
+   uint8_t get_mask(uint8_t protocol, uint16_t src_port, uint16_t dst_port) const
+   {
+      uint8_t slot = proto_slot[protocol];
+      if (slot == 0) {
+         return 0;
+      }
+      const uint8_t *ports = port_masks + ((size_t) (slot - 1) << 16);
+      return ports[src_port] | ports[dst_port];
+   }
+
+   // Update the subprofiles in the mask of a source IP address record
+   void update_src(uint8_t mask, hosts_record_t &main_record,
+      const sp_flow_t &flow, const bloom_key_t &ips, int bf_set);
+   // Update the subprofiles in the mask of a destination IP address record
+   void update_dst(uint8_t mask, hosts_record_t &main_record,
+      const sp_flow_t &flow, const bloom_key_t &ips, int bf_set);
+};
+
 #endif
@@ -0,0 +1,145 @@
+/**
+ * \file timerwheel.cpp
+ * \brief Queue of records of the statistics table ordered by their expiration
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include "timerwheel.h"
+
+/** \brief Constructor of the timer wheel
+ * Prepare a power of two slots which cover the horizon.
+ * \param horizon The longest time (in seconds) between adding and expiration
+ */
+TimerWheel::TimerWheel(uint32_t horizon)
+{
+   uint32_t size = 1;
+   while (size <= horizon + 1) {
+      size <<= 1;
+   }
+
+   slots.resize(size);
+   mask = size - 1;
+   current = 0;
+   entries = 0;
+   pthread_mutex_init(&lock, NULL);
+}
+
+/** \brief Destructor of the timer wheel
+ */
+TimerWheel::~TimerWheel()
+{
+   pthread_mutex_destroy(&lock);
+}
+
+/** \brief Add the record to the slot of its expiration
+ * Records which should have already expired are added to the next collected slot.
+ * \param key Key of the record
+ * \param first_rec_ts Timestamp of the first flow of the record
+ * \param expires Time of the expiration
+ */
+void TimerWheel::add(const hosts_key_t &key, uint32_t first_rec_ts, uint32_t expires)
+{
+   timer_entry_t entry;
+   entry.key = key;
+   entry.first_rec_ts = first_rec_ts;
+
+   pthread_mutex_lock(&lock);
+   if (current != 0 && expires <= current) {
+      expires = current + 1;
+   }
+   slots[expires & mask].push_back(entry);
+   ++entries;
+   pthread_mutex_unlock(&lock);
+}
+
+/** \brief Collect entries of the expired slots
+ * Every slot is visited at most once, so after a long pause (or on the first
+ * call) the whole wheel is collected and the caller reschedules the records
+ * which have not expired yet.
+ * \param[in] now Current time
+ * \param[out] expired Vector where the entries are appended
+ */
+void TimerWheel::collect(uint32_t now, std::vector<timer_entry_t> &expired)
+{
+   pthread_mutex_lock(&lock);
+   if (current != 0 && now <= current) {
+      pthread_mutex_unlock(&lock);
+      return;
+   }
+
+   uint32_t count = mask + 1;
+   if (current != 0 && now - current < count) {
+      count = now - current;
+   }
+
+   for (uint32_t i = 0; i < count; ++i) {
+      std::vector<timer_entry_t> &slot = slots[(now - i) & mask];
+      expired.insert(expired.end(), slot.begin(), slot.end());
+      entries -= slot.size();
+      slot.clear();
+   }
+
+   current = now;
+   pthread_mutex_unlock(&lock);
+}
+
+/** \brief Remove all entries from the wheel
+ */
+void TimerWheel::clear()
+{
+   pthread_mutex_lock(&lock);
+   for (uint32_t i = 0; i <= mask; ++i) {
+      std::vector<timer_entry_t>().swap(slots[i]);
+   }
+   entries = 0;
+   pthread_mutex_unlock(&lock);
+}
+
+/** \brief Get the number of entries in the wheel
+ * Every record of the table has at least one entry, older entries of the
+ * records which have been rescheduled stay until their slots are collected.
+ * \return Number of entries waiting for their expiration
+ */
+size_t TimerWheel::size()
+{
+   pthread_mutex_lock(&lock);
+   size_t count = entries;
+   pthread_mutex_unlock(&lock);
+   return count;
+}
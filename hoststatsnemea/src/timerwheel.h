@@ -0,0 +1,91 @@
+/**
+ * \file timerwheel.h
+ * \brief Queue of records of the statistics table ordered by their expiration (header file)
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef _TIMERWHEEL_H_
+#define _TIMERWHEEL_H_
+
+#include <vector>
+#include <pthread.h>
+#include "hoststats.h"
+
+// Record of the statistics table waiting for its expiration
+struct timer_entry_t {
+   hosts_key_t key;
+   uint32_t first_rec_ts;  ///< distinguishes the record from older records with the same key
+};
+
+/* -------------------- TIMER WHEEL -------------------- */
+
+/**
+ * Ring of one second slots with keys of the records which expire in that second.
+ * A record may be taken earlier than it expires or it may not exist any more,
+ * the caller has to check the record and add it again if necessary.
+ */
+class TimerWheel {
+private:
+   std::vector<std::vector<timer_entry_t> > slots;
+   uint32_t mask;             // Number of slots - 1
+   uint32_t current;          // Last collected second (0 before the first collection)
+   size_t entries;            // Number of entries in all slots
+   pthread_mutex_t lock;      // Entries are added by the reader and collected by the detector
+
+public:
+   // Constructor, horizon is the longest time between adding and expiration
+   TimerWheel(uint32_t horizon);
+
+   // Destructor
+   ~TimerWheel();
+
+   // Add the record which expires at the given time
+   void add(const hosts_key_t &key, uint32_t first_rec_ts, uint32_t expires);
+
+   // Move entries of all seconds up to now to the vector
+   void collect(uint32_t now, std::vector<timer_entry_t> &expired);
+
+   // Remove all entries
+   void clear();
+
+   // Number of entries waiting for their expiration
+   size_t size();
+};
+
+#endif
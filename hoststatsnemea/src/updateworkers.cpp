@@ -0,0 +1,419 @@
+/**
+ * \file updateworkers.cpp
+ * \brief Threads updating the main profile, each of them owns a part of the hosts
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sched.h>
+#include "updateworkers.h"
+#include "profile.h"
+#include "aux_func.h"
+#include "metrics.h"
+#include "affinity.h"
+extern "C" {
+   #include "fields.h"
+}
+
+extern ur_template_t *tmpl_in;
+
+// Time of the update of one host record by a worker
+static metrics_histogram_t *worker_update_metric = metrics_histogram(
+   "hoststats_worker_update_seconds", "Time of the update of one record of a flow by an update worker.");
+
+/* -------------------- QUEUE OF A WORKER -------------------- */
+
+/** \brief Allocate the buffer of the queue
+ * \return True on success, false otherwise
+ */
+bool UpdateQueue::init()
+{
+   buffer = (char *) malloc(UPDATE_QUEUE_SIZE);
+   reserved = 0;
+   head = 0;
+   tail = 0;
+   return buffer != NULL;
+}
+
+/** \brief Free the buffer of the queue
+ */
+void UpdateQueue::destroy()
+{
+   free(buffer);
+   buffer = NULL;
+}
+
+/** \brief Reserve space for a message
+ * A message never wraps around the end of the buffer, the rest of the buffer
+ * is filled by a padding message instead.
+ * \param data_size Size of the flow record
+ * \return Pointer to the header of the message or NULL if the queue is full
+ */
+upd_msg_t *UpdateQueue::reserve(uint16_t data_size)
+{
+   uint32_t size = (sizeof(upd_msg_t) + data_size + UPD_MSG_ALIGN - 1) &
+      ~(uint32_t) (UPD_MSG_ALIGN - 1);
+   uint32_t pos = head & (UPDATE_QUEUE_SIZE - 1);
+   uint32_t padding = 0;
+   if (UPDATE_QUEUE_SIZE - pos < size) {
+      padding = UPDATE_QUEUE_SIZE - pos;
+   }
+
+   uint32_t used = head - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+   if (UPDATE_QUEUE_SIZE - used < padding + size) {
+      return NULL;
+   }
+
+   if (padding != 0) {
+      upd_msg_t *pad_msg = (upd_msg_t *) (buffer + pos);
+      pad_msg->size = padding;
+      pad_msg->type = UPD_MSG_PAD;
+      pos = 0;
+   }
+
+   upd_msg_t *msg = (upd_msg_t *) (buffer + pos);
+   msg->size = size;
+   msg->data_size = data_size;
+   reserved = head + padding + size;
+   return msg;
+}
+
+/** \brief Publish the message returned by the last reserve()
+ */
+void UpdateQueue::push()
+{
+   __atomic_store_n(&head, reserved, __ATOMIC_RELEASE);
+}
+
+/** \brief Get the oldest message, padding is skipped
+ * \return Pointer to the header of the message or NULL if the queue is empty
+ */
+upd_msg_t *UpdateQueue::front()
+{
+   uint32_t last = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+   while (tail != last) {
+      upd_msg_t *msg = (upd_msg_t *) (buffer + (tail & (UPDATE_QUEUE_SIZE - 1)));
+      if (msg->type != UPD_MSG_PAD) {
+         return msg;
+      }
+      __atomic_store_n(&tail, tail + msg->size, __ATOMIC_RELEASE);
+   }
+   return NULL;
+}
+
+/** \brief Release the message returned by front()
+ */
+void UpdateQueue::pop()
+{
+   upd_msg_t *msg = (upd_msg_t *) (buffer + (tail & (UPDATE_QUEUE_SIZE - 1)));
+   __atomic_store_n(&tail, tail + msg->size, __ATOMIC_RELEASE);
+}
+
+/** \brief Check whether the worker has processed all messages
+ * Called by the producer only.
+ */
+bool UpdateQueue::empty()
+{
+   return __atomic_load_n(&tail, __ATOMIC_ACQUIRE) == head;
+}
+
+/* -------------------- UPDATE WORKERS -------------------- */
+
+/** \brief Constructor of the workers
+ * \param profile Main profile updated by the workers
+ * \param count Number of the workers (sets of BloomFilters of the profile)
+ */
+UpdateWorkers::UpdateWorkers(HostProfile *profile, int count)
+   : profile(profile)
+{
+   for (int i = 0; i < count; ++i) {
+      worker_t *worker = new worker_t;
+      worker->owner = this;
+      worker->index = i;
+      worker->running = false;
+      worker->stop = false;
+      worker->sleeping = 0;
+      pthread_mutex_init(&worker->lock, NULL);
+      pthread_cond_init(&worker->wake, NULL);
+      pthread_cond_init(&worker->idle, NULL);
+      workers.push_back(worker);
+   }
+}
+
+/** \brief Destructor of the workers
+ */
+UpdateWorkers::~UpdateWorkers()
+{
+   stop();
+   for (size_t i = 0; i < workers.size(); ++i) {
+      pthread_cond_destroy(&workers[i]->idle);
+      pthread_cond_destroy(&workers[i]->wake);
+      pthread_mutex_destroy(&workers[i]->lock);
+      delete workers[i];
+   }
+}
+
+/** \brief Allocate the queues and start the threads
+ * \return True on success, false otherwise (started workers are stopped)
+ */
+bool UpdateWorkers::start()
+{
+   for (size_t i = 0; i < workers.size(); ++i) {
+      worker_t *worker = workers[i];
+      if (!worker->queue.init()) {
+         log(LOG_ERR, "Error: Failed to allocate the queue of update worker %d.",
+            worker->index);
+         stop();
+         return false;
+      }
+      if (affinity_thread_create(&worker->thread, &UpdateWorkers::run, worker) != 0) {
+         log(LOG_ERR, "Error: Failed to start update worker %d.", worker->index);
+         worker->queue.destroy();
+         stop();
+         return false;
+      }
+      worker->running = true;
+   }
+
+   log(LOG_DEBUG, "Started %lu update workers.", (unsigned long) workers.size());
+   return true;
+}
+
+/** \brief Stop the workers after they process their queued messages
+ */
+void UpdateWorkers::stop()
+{
+   for (size_t i = 0; i < workers.size(); ++i) {
+      if (workers[i]->running) {
+         __atomic_store_n(&workers[i]->stop, true, __ATOMIC_RELEASE);
+         wake_up(workers[i]);
+      }
+   }
+
+   for (size_t i = 0; i < workers.size(); ++i) {
+      worker_t *worker = workers[i];
+      if (!worker->running) {
+         continue;
+      }
+      pthread_join(worker->thread, NULL);
+      worker->queue.destroy();
+      worker->running = false;
+      worker->stop = false;
+   }
+}
+
+/** \brief Get the worker owning the host
+ * \param host IP address of the host
+ * \return Index of the worker
+ */
+int UpdateWorkers::owner(const hosts_key_t &host) const
+{
+   uint32_t hash = host.ui32[0] ^ host.ui32[1] ^ host.ui32[2] ^ host.ui32[3];
+   hash *= 0x9e3779b1;
+   return (int) (((uint64_t) hash * workers.size()) >> 32);
+}
+
+/** \brief Copy the message to the queue of the worker
+ * \param worker Index of the worker
+ * \param type Type of the message
+ * \param record Flow record (NULL if the message has no record)
+ * \param size Size of the flow record
+ * \param dir_flags Direction flags of the flow
+ * \param now Time of the module
+ * \param subprofiles Update subprofiles of the host
+ */
+void UpdateWorkers::push(int worker, uint8_t type, const void *record,
+   uint16_t size, uint8_t dir_flags, uint32_t now, bool subprofiles)
+{
+   UpdateQueue &queue = workers[worker]->queue;
+   upd_msg_t *msg;
+   while ((msg = queue.reserve(size)) == NULL) {
+      usleep(UPDATE_IDLE_SLEEP);
+   }
+
+   msg->time = now;
+   msg->type = type;
+   msg->dir_flags = dir_flags;
+   msg->subprofiles = subprofiles;
+   if (size != 0) {
+      memcpy(msg + 1, record, size);
+   }
+   queue.push();
+   wake_up(workers[worker]);
+}
+
+/** \brief Pass the flow to the workers owning its source and destination host
+ * \param record Flow record from the TRAP
+ * \param size Size of the flow record
+ * \param tmplt Input template
+ * \param now Time of the module
+ * \param src_subprofiles Update subprofiles of the source host
+ * \param dst_subprofiles Update subprofiles of the destination host
+ */
+void UpdateWorkers::update(const void *record, uint16_t size,
+   const ur_template_t *tmplt, uint32_t now, bool src_subprofiles,
+   bool dst_subprofiles)
+{
+   uint8_t dir_flags;
+   if (!profile->flow_direction(record, tmplt, dir_flags)) {
+      return;
+   }
+
+   push(owner(ur_get(tmplt, record, F_SRC_IP)), UPD_MSG_SRC, record, size,
+      dir_flags, now, src_subprofiles);
+   push(owner(ur_get(tmplt, record, F_DST_IP)), UPD_MSG_DST, record, size,
+      dir_flags, now, dst_subprofiles);
+}
+
+/** \brief Let all workers swap their BloomFilters
+ * Flows queued before are still evaluated with the current filters.
+ */
+void UpdateWorkers::swap_bf()
+{
+   for (size_t i = 0; i < workers.size(); ++i) {
+      push(i, UPD_MSG_SWAP_BF, NULL, 0, 0, 0);
+   }
+}
+
+/** \brief Wait until the workers process all queued messages
+ */
+void UpdateWorkers::wait_idle()
+{
+   for (size_t i = 0; i < workers.size(); ++i) {
+      worker_t *worker = workers[i];
+      if (!worker->running) {
+         continue;
+      }
+      // The worker signals idle under the lock, after the check below
+      pthread_mutex_lock(&worker->lock);
+      while (!worker->queue.empty()) {
+         pthread_cond_wait(&worker->idle, &worker->lock);
+      }
+      pthread_mutex_unlock(&worker->lock);
+   }
+}
+
+/** \brief Wake the worker up if it waits for a message
+ * Called by the reader after it publishes a message or stops the worker.
+ * \param worker Pointer to the worker
+ */
+void UpdateWorkers::wake_up(worker_t *worker)
+{
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   if (__atomic_load_n(&worker->sleeping, __ATOMIC_RELAXED)) {
+      pthread_mutex_lock(&worker->lock);
+      pthread_cond_signal(&worker->wake);
+      pthread_mutex_unlock(&worker->lock);
+   }
+}
+
+/** \brief Wait until the empty queue gets a message or the worker is stopped
+ * The worker polls the queue a few times before it sleeps on the condition
+ * variable, so a busy reader does not have to wake it up for every flow.
+ * \param worker Pointer to the worker
+ */
+void UpdateWorkers::wait_message(worker_t *worker)
+{
+   for (int i = 0; i < UPDATE_SPIN; ++i) {
+      if (worker->queue.front() != NULL ||
+          __atomic_load_n(&worker->stop, __ATOMIC_ACQUIRE)) {
+         return;
+      }
+      sched_yield();
+   }
+
+   pthread_mutex_lock(&worker->lock);
+   __atomic_store_n(&worker->sleeping, 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   pthread_cond_signal(&worker->idle);
+   while (worker->queue.front() == NULL &&
+          !__atomic_load_n(&worker->stop, __ATOMIC_ACQUIRE)) {
+      pthread_cond_wait(&worker->wake, &worker->lock);
+   }
+   __atomic_store_n(&worker->sleeping, 0, __ATOMIC_RELAXED);
+   pthread_mutex_unlock(&worker->lock);
+}
+
+/** \brief Thread function of a worker
+ * \param arg Pointer to the worker
+ */
+void *UpdateWorkers::run(void *arg)
+{
+   worker_t *worker = (worker_t *) arg;
+   HostProfile *profile = worker->owner->profile;
+
+   while (true) {
+      upd_msg_t *msg = worker->queue.front();
+      if (msg == NULL) {
+         if (__atomic_load_n(&worker->stop, __ATOMIC_ACQUIRE)) {
+            // Messages pushed before the stop are visible now
+            if (worker->queue.front() == NULL) {
+               break;
+            }
+            continue;
+         }
+         wait_message(worker);
+         continue;
+      }
+
+      const void *record = msg + 1;
+      uint64_t start = metrics_start();
+      switch (msg->type) {
+      case UPD_MSG_SRC:
+         profile->update_src(record, tmpl_in, msg->dir_flags, msg->time,
+            worker->index, msg->subprofiles);
+         break;
+      case UPD_MSG_DST:
+         profile->update_dst(record, tmpl_in, msg->dir_flags, msg->time,
+            worker->index, msg->subprofiles);
+         break;
+      case UPD_MSG_SWAP_BF:
+         profile->swap_bf(worker->index);
+         break;
+      default:
+         break;
+      }
+      metrics_stop(worker_update_metric, start);
+      worker->queue.pop();
+   }
+
+   return NULL;
+}
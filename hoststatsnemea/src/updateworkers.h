@@ -0,0 +1,181 @@
+/**
+ * \file updateworkers.h
+ * \brief Threads updating the main profile, each of them owns a part of the hosts
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef _UPDATEWORKERS_H_
+#define _UPDATEWORKERS_H_
+
+#include <vector>
+#include <pthread.h>
+#include "hoststats.h"
+
+extern "C" {
+   #include <unirec/unirec.h>
+}
+
+class HostProfile;
+
+#define UPDATE_QUEUE_SIZE  (4 * 1024 * 1024)  // Size of a queue in bytes (power of two)
+#define UPDATE_IDLE_SLEEP  50                 // Sleep when a queue is full [us]
+#define UPDATE_SPIN        64                 // Polls of an empty queue before the worker sleeps
+
+// Types of messages in the queue
+enum upd_msg_type_t {
+   UPD_MSG_PAD,      // Unused space to the end of the buffer
+   UPD_MSG_SRC,      // Update the record of the source IP of the flow
+   UPD_MSG_DST,      // Update the record of the destination IP of the flow
+   UPD_MSG_SWAP_BF   // Swap BloomFilters of the worker
+};
+
+// Header of a message, the flow record follows it
+struct upd_msg_t {
+   uint32_t size;       // Size of the whole message (multiple of UPD_MSG_ALIGN)
+   uint32_t time;       // Time of the module when the flow was received
+   uint16_t data_size;  // Size of the flow record
+   uint8_t type;        // Type of the message (upd_msg_type_t)
+   uint8_t dir_flags;   // Direction flags of the flow
+   uint8_t subprofiles; // Update subprofiles of the host
+};
+
+#define UPD_MSG_ALIGN 16
+
+/* -------------------- QUEUE OF A WORKER -------------------- */
+
+/**
+ * Single producer single consumer ring of messages with variable size.
+ * The reader fills the message returned by reserve() and publishes it by push(),
+ * the worker processes the message returned by front() and releases it by pop().
+ */
+class UpdateQueue {
+private:
+   char *buffer;
+   uint32_t reserved;   // Position of the head after the reserved message
+   uint32_t head;       // Written by the producer only
+   char pad[64];        // Keeps head and tail in different cache lines
+   uint32_t tail;       // Written by the consumer only
+
+public:
+   // Allocate the buffer
+   bool init();
+   // Free the buffer
+   void destroy();
+   // Get space for a message with the record of the given size (NULL if full)
+   upd_msg_t *reserve(uint16_t data_size);
+   // Publish the reserved message
+   void push();
+   // Get the oldest message (NULL if empty)
+   upd_msg_t *front();
+   // Release the oldest message
+   void pop();
+   // All messages have been processed
+   bool empty();
+};
+
+/* -------------------- UPDATE WORKERS -------------------- */
+
+/**
+ * Both records of the hosts of a flow are updated by the workers which own
+ * them, so every record (and its BloomFilters) is updated by one thread only.
+ */
+class UpdateWorkers {
+private:
+   /*
+    * An idle worker waits on wake. Setting sleeping and checking the queue
+    * (worker) and pushing and checking sleeping (reader) are ordered by full
+    * fences, so either the worker sees the message or the reader wakes it up.
+    */
+   struct worker_t {
+      UpdateWorkers *owner;
+      int index;           // Index of the worker (and its set of BloomFilters)
+      UpdateQueue queue;
+      pthread_t thread;
+      bool running;
+      bool stop;           // No more messages will be pushed
+      int sleeping;        // The worker waits on wake
+      pthread_mutex_t lock;
+      pthread_cond_t wake; // Signalled when a message is pushed or the worker is stopped
+      pthread_cond_t idle; // Signalled when the worker goes to sleep, for wait_idle()
+   };
+
+   HostProfile *profile;
+   std::vector<worker_t *> workers;
+
+   // Thread function of a worker
+   static void *run(void *arg);
+
+   // Wait until the empty queue gets a message or the worker is stopped
+   static void wait_message(worker_t *worker);
+
+   // Wake the worker up if it sleeps
+   static void wake_up(worker_t *worker);
+
+   // Get the worker owning the host
+   int owner(const hosts_key_t &host) const;
+
+   // Push the message to the worker, waits while the queue is full
+   void push(int worker, uint8_t type, const void *record, uint16_t size,
+      uint8_t dir_flags, uint32_t now, bool subprofiles = true);
+
+public:
+   // Constructor
+   UpdateWorkers(HostProfile *profile, int count);
+
+   // Destructor, stops the workers
+   ~UpdateWorkers();
+
+   // Start the threads
+   bool start();
+
+   // Process all queued messages and stop the threads
+   void stop();
+
+   // Pass the flow to the workers owning its hosts
+   void update(const void *record, uint16_t size, const ur_template_t *tmplt,
+      uint32_t now, bool src_subprofiles = true, bool dst_subprofiles = true);
+
+   // Swap BloomFilters of all workers after their queued flows
+   void swap_bf();
+
+   // Wait until all queued messages are processed
+   void wait_idle();
+};
+
+#endif
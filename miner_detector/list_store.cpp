@@ -0,0 +1,483 @@
+/**
+ * \file list_store.cpp
+ * \brief Memory-mapped persistent store of verdict database.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "list_store.h"
+
+
+//#define DEBUG
+
+#ifdef DEBUG
+#define DEBUG_PRINT(...) do{ fprintf( stderr, "DEBUG: "  __VA_ARGS__ ); } while( false )
+#else
+#define DEBUG_PRINT(...) do{ } while ( false )
+#endif
+
+
+using namespace std;
+
+
+/**
+ * \brief Compute checksum of a record, it covers everything except the checksum itself.
+ * \param rec        Record to compute checksum of.
+ * \param generation Generation of the store file.
+ * \return Checksum of the record.
+ */
+static uint32_t record_checksum(const list_store_record_t *rec, uint32_t generation)
+{
+    return SuperFastHash((const char*) rec, offsetof(list_store_record_t, checksum)) ^ generation ^ 0x5a5a5a5a;
+}
+
+
+/**
+ * \brief Fill record of the store file.
+ */
+static void fill_record(list_store_record_t *rec, const list_key_t &key, uint8_t op, const list_item_t &item, uint32_t seq)
+{
+    memset(rec, 0, sizeof(list_store_record_t));
+    rec->ip = key.ip;
+    rec->port = key.port;
+    rec->verdict = item.verdict;
+    rec->op = op;
+    rec->timestamp = item.timestamp;
+    rec->seq = seq;
+}
+
+
+ListStore::ListStore()
+{
+    fd = -1;
+    map = NULL;
+    map_size = 0;
+    generation = 0;
+    capacity = 0;
+    count = 0;
+    live = 0;
+    pthread_mutex_init(&mutex, NULL);
+}
+
+ListStore::~ListStore()
+{
+    close();
+    pthread_mutex_destroy(&mutex);
+}
+
+
+list_store_record_t *ListStore::records(void)
+{
+    return (list_store_record_t*) (map + sizeof(list_store_header_t));
+}
+
+
+/**
+ * \brief Map store file, header of the file must be valid.
+ * \param fd       Opened store file.
+ * \param capacity Number of records in the file.
+ * \return True on success, false otherwise.
+ */
+bool ListStore::map_file(int fd, uint32_t capacity)
+{
+    size_t size = sizeof(list_store_header_t) + (size_t) capacity * sizeof(list_store_record_t);
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not map list store '%s': %s\n", fname.c_str(), strerror(errno));
+        return false;
+    }
+
+    this->fd = fd;
+    this->map = (char*) ptr;
+    this->map_size = size;
+    this->capacity = capacity;
+    this->generation = ((list_store_header_t*) ptr)->generation;
+    return true;
+}
+
+
+void ListStore::unmap_file(void)
+{
+    if (map) {
+        munmap(map, map_size);
+        map = NULL;
+        map_size = 0;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+
+/**
+ * \brief Open store file, new file is created if it does not exist or is not valid.
+ * \param fname Name of the store file.
+ * \return True on success, false otherwise.
+ */
+bool ListStore::open(const char *fname)
+{
+    struct stat st;
+    list_store_header_t header;
+
+    this->fname = fname;
+
+    int fd = ::open(fname, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "Error: Could not open list store '%s': %s\n", fname, strerror(errno));
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return false;
+    }
+
+    bool valid = st.st_size >= (off_t) sizeof(list_store_header_t) &&
+                 pread(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header) &&
+                 memcmp(header.magic, LIST_STORE_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version == LIST_STORE_VERSION &&
+                 header.record_size == sizeof(list_store_record_t);
+
+    if (!valid) {
+        if (st.st_size > 0) {
+            fprintf(stderr, "Warning: List store '%s' is not valid, creating new one.\n", fname);
+        }
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, LIST_STORE_MAGIC, sizeof(header.magic));
+        header.version = LIST_STORE_VERSION;
+        header.generation = (uint32_t) time(NULL);
+        header.record_size = sizeof(list_store_record_t);
+
+        st.st_size = sizeof(list_store_header_t) + (off_t) LIST_STORE_INITIAL_RECORDS * sizeof(list_store_record_t);
+        if (ftruncate(fd, 0) < 0 || ftruncate(fd, st.st_size) < 0 ||
+            pwrite(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)) {
+            fprintf(stderr, "Error: Could not create list store '%s': %s\n", fname, strerror(errno));
+            ::close(fd);
+            return false;
+        }
+    }
+
+    uint32_t capacity = (st.st_size - sizeof(list_store_header_t)) / sizeof(list_store_record_t);
+    if (!map_file(fd, capacity)) {
+        ::close(fd);
+        return false;
+    }
+
+    // Log ends with first record which was not completely written
+    list_store_record_t *rec = records();
+    count = 0;
+    while (count < capacity && rec[count].seq == count + 1 &&
+           rec[count].checksum == record_checksum(&rec[count], generation)) {
+        count++;
+    }
+
+    DEBUG_PRINT("List store '%s' opened with %u records\n", fname, count);
+    return true;
+}
+
+
+/**
+ * \brief Replay log of the store into verdict database.
+ * \param db Verdict database.
+ */
+void ListStore::load(fht_table_t *db)
+{
+    list_key_t key;
+    list_store_record_t *rec = records();
+
+    pthread_mutex_lock(&mutex);
+    for (uint32_t i = 0; i < count; i++) {
+        memset(&key, 0, sizeof(list_key_t));
+        key.ip = rec[i].ip;
+        key.port = rec[i].port;
+
+        if (rec[i].op == LIST_STORE_REMOVE) {
+            fht_remove(db, &key);
+            continue;
+        }
+
+        list_item_t *item = (list_item_t*) fht_get_data(db, &key);
+        if (item) {
+            // Server was classified again
+            if (item->timestamp != BWL_PERMANENT_RECORD) {
+                item->timestamp = rec[i].timestamp;
+                item->verdict = rec[i].verdict;
+            }
+        } else {
+            list_item_t new_item;
+            memset(&new_item, 0, sizeof(list_item_t));
+            new_item.timestamp = rec[i].timestamp;
+            new_item.verdict = rec[i].verdict;
+            fht_insert(db, &key, &new_item, NULL, NULL);
+        }
+    }
+
+    // Count of items is known only after compaction, expect no removals
+    live = count;
+    pthread_mutex_unlock(&mutex);
+}
+
+
+/**
+ * \brief Double size of the store file.
+ * \return True on success, false otherwise.
+ */
+bool ListStore::grow(void)
+{
+    uint32_t new_capacity = capacity * 2;
+    off_t size = sizeof(list_store_header_t) + (off_t) new_capacity * sizeof(list_store_record_t);
+
+    if (ftruncate(fd, size) < 0) {
+        fprintf(stderr, "Error: Could not grow list store '%s': %s\n", fname.c_str(), strerror(errno));
+        return false;
+    }
+
+    int file = fd;
+    munmap(map, map_size);
+    map = NULL;
+    if (!map_file(file, new_capacity)) {
+        unmap_file();
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * \brief Append record to the log, called with mutex locked.
+ */
+void ListStore::write_record(const list_key_t &key, uint8_t op, const list_item_t &item)
+{
+    if (map == NULL || (count == capacity && !grow())) {
+        return;
+    }
+
+    list_store_record_t *rec = &records()[count];
+    fill_record(rec, key, op, item, count + 1);
+
+    // Record becomes valid only after all its fields are written
+    __sync_synchronize();
+    rec->checksum = record_checksum(rec, generation);
+    count++;
+}
+
+
+/**
+ * \brief Record server added to verdict database, permanent records are
+ *        not stored because they are read from configured files.
+ * \param key  IP address and port of the server.
+ * \param item Verdict of the server and time when it was classified.
+ */
+void ListStore::add(const list_key_t &key, const list_item_t &item)
+{
+    if (item.timestamp == BWL_PERMANENT_RECORD) {
+        return;
+    }
+
+    pthread_mutex_lock(&mutex);
+    write_record(key, LIST_STORE_ADD, item);
+    live++;
+    pthread_mutex_unlock(&mutex);
+}
+
+
+/**
+ * \brief Record server removed from verdict database.
+ * \param key IP address and port of the server.
+ */
+void ListStore::remove(const list_key_t &key)
+{
+    list_item_t item;
+    memset(&item, 0, sizeof(list_item_t));
+
+    pthread_mutex_lock(&mutex);
+    write_record(key, LIST_STORE_REMOVE, item);
+    if (live > 0) {
+        live--;
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+
+/**
+ * \brief Check if the log is much larger than content of the database.
+ * \return True if compaction should be done.
+ */
+bool ListStore::needs_compaction(void)
+{
+    pthread_mutex_lock(&mutex);
+    bool ret = map != NULL && count >= LIST_STORE_INITIAL_RECORDS / 2 && count > 2 * live;
+    pthread_mutex_unlock(&mutex);
+    return ret;
+}
+
+
+/**
+ * \brief Write records of all non-permanent items of a database to file.
+ * \return True on success, false otherwise.
+ */
+bool ListStore::dump_db(fht_table_t *db, int out_fd, uint32_t generation, uint32_t &seq)
+{
+    list_store_record_t buffer[256];
+    size_t used = 0;
+    bool ret = true;
+
+    fht_iter_t *iter = fht_init_iter(db);
+    while (fht_get_next_iter(iter) == FHT_ITER_RET_OK) {
+        const list_item_t *item = (list_item_t*)iter->data_ptr;
+        if (item->timestamp == BWL_PERMANENT_RECORD) {
+            continue;
+        }
+
+        list_store_record_t *rec = &buffer[used++];
+        fill_record(rec, *((list_key_t*)iter->key_ptr), LIST_STORE_ADD, *item, ++seq);
+        rec->checksum = record_checksum(rec, generation);
+
+        if (used == sizeof(buffer) / sizeof(buffer[0])) {
+            ret = ret && write(out_fd, buffer, sizeof(buffer)) == (ssize_t) sizeof(buffer);
+            used = 0;
+        }
+    }
+    fht_destroy_iter(iter);
+
+    if (used > 0) {
+        ret = ret && write(out_fd, buffer, used * sizeof(list_store_record_t)) == (ssize_t) (used * sizeof(list_store_record_t));
+    }
+    return ret;
+}
+
+
+/**
+ * \brief Rewrite the log from current content of the database. New file is written
+ *        aside and renamed over the old one, so either of them is valid after a crash.
+ * \param db Verdict database.
+ * \return True on success, false otherwise.
+ */
+bool ListStore::compact(fht_table_t *db)
+{
+    list_store_header_t header;
+    uint32_t seq = 0;
+    string tmp_fname = fname + ".tmp";
+
+    pthread_mutex_lock(&mutex);
+    if (map == NULL) {
+        pthread_mutex_unlock(&mutex);
+        return false;
+    }
+
+    memcpy(&header, map, sizeof(header));
+    header.generation = generation + 1;
+
+    int out_fd = ::open(tmp_fname.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0) {
+        fprintf(stderr, "Error: Could not create '%s': %s\n", tmp_fname.c_str(), strerror(errno));
+        pthread_mutex_unlock(&mutex);
+        return false;
+    }
+
+    bool ok = write(out_fd, &header, sizeof(header)) == (ssize_t) sizeof(header) &&
+              dump_db(db, out_fd, header.generation, seq);
+
+    // Leave free space for appended records
+    uint32_t new_capacity = LIST_STORE_INITIAL_RECORDS;
+    while (new_capacity < 2 * seq) {
+        new_capacity *= 2;
+    }
+    off_t size = sizeof(list_store_header_t) + (off_t) new_capacity * sizeof(list_store_record_t);
+    ok = ok && ftruncate(out_fd, size) == 0 && fsync(out_fd) == 0 &&
+         rename(tmp_fname.c_str(), fname.c_str()) == 0;
+
+    if (!ok) {
+        fprintf(stderr, "Error: Could not compact list store '%s': %s\n", fname.c_str(), strerror(errno));
+        ::close(out_fd);
+        unlink(tmp_fname.c_str());
+        pthread_mutex_unlock(&mutex);
+        return false;
+    }
+
+    unmap_file();
+    if (!map_file(out_fd, new_capacity)) {
+        ::close(out_fd);
+        pthread_mutex_unlock(&mutex);
+        return false;
+    }
+    count = live = seq;
+
+    DEBUG_PRINT("List store '%s' compacted to %u records\n", fname.c_str(), count);
+    pthread_mutex_unlock(&mutex);
+    return true;
+}
+
+
+/**
+ * \brief Flush appended records to disk.
+ * \param wait Wait until the records are written.
+ */
+void ListStore::sync(bool wait)
+{
+    pthread_mutex_lock(&mutex);
+    if (map) {
+        msync(map, map_size, wait ? MS_SYNC : MS_ASYNC);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+
+/**
+ * \brief Flush and close the store file.
+ */
+void ListStore::close(void)
+{
+    sync(true);
+
+    pthread_mutex_lock(&mutex);
+    unmap_file();
+    pthread_mutex_unlock(&mutex);
+}
@@ -0,0 +1,138 @@
+/**
+ * \file list_store.h
+ * \brief Memory-mapped persistent store of verdict database.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef LIST_STORE_H
+#define LIST_STORE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <unirec/unirec.h>
+#include <nemea-common.h>
+
+#include <string>
+
+#include "miner_detector.h"
+
+
+/**
+ * Identification of the store file.
+ */
+#define LIST_STORE_MAGIC "MDLSTORE"
+#define LIST_STORE_VERSION 1
+
+/**
+ * Number of records of newly created store file, file grows by doubling.
+ */
+#define LIST_STORE_INITIAL_RECORDS 65536
+
+/**
+ * Operations recorded in the store.
+ */
+#define LIST_STORE_ADD 0
+#define LIST_STORE_REMOVE 1
+
+
+/**
+ * \brief Header of the store file.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t generation;   ///< Changed by every compaction, part of record checksum
+    uint32_t record_size;
+    uint32_t reserved[3];
+} list_store_header_t;
+
+/**
+ * \brief Record of the store file, one change of verdict database.
+ */
+typedef struct {
+    ip_addr_t ip;
+    uint16_t port;
+    uint8_t verdict;       ///< VERDICT_BLACKLIST or VERDICT_WHITELIST
+    uint8_t op;            ///< LIST_STORE_ADD or LIST_STORE_REMOVE
+    uint32_t timestamp;    ///< Time when the server was classified
+    uint32_t seq;          ///< Index of the record + 1, zero for free space
+    uint32_t checksum;     ///< Written last, invalid checksum ends the log
+} list_store_record_t;
+
+
+/**
+ * Class keeping log of changes of verdict database in a memory-mapped file.
+ * Changes are appended as they happen, so the file survives crash of the module up to
+ * the last appended record and of the system up to the last sync. Log is rewritten
+ * from the database when it grows much larger than its content.
+ */
+class ListStore {
+    private:
+        std::string fname;
+        int fd;
+        char *map;
+        size_t map_size;
+        uint32_t generation;
+        uint32_t capacity;  ///< Number of records which fit into the mapping
+        uint32_t count;     ///< Number of valid records
+        uint32_t live;      ///< Estimation of number of items in the database
+        pthread_mutex_t mutex;
+
+        list_store_record_t *records(void);
+        bool map_file(int fd, uint32_t capacity);
+        void unmap_file(void);
+        bool grow(void);
+        void write_record(const list_key_t &key, uint8_t op, const list_item_t &item);
+        bool dump_db(fht_table_t *db, int out_fd, uint32_t generation, uint32_t &seq);
+
+    public:
+        ListStore();
+        ~ListStore();
+        bool open(const char *fname);
+        void load(fht_table_t *db);
+        void add(const list_key_t &key, const list_item_t &item);
+        void remove(const list_key_t &key);
+        bool needs_compaction(void);
+        bool compact(fht_table_t *db);
+        void sync(bool wait);
+        void close(void);
+};
+
+#endif
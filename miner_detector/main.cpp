@@ -87,6 +87,8 @@ int main(int argc, char **argv)
     trap_ifcctl(TRAPIFC_OUTPUT, 0, TRAPCTL_BUFFERSWITCH, 0);
     trap_ifcctl(TRAPIFC_OUTPUT, 0, TRAPCTL_SETTIMEOUT, 10000);
     trap_ifcctl(TRAPIFC_OUTPUT, 0, TRAPCTL_AUTOFLUSH_TIMEOUT, 60000);
+    // Process incomplete batch of flows when input is idle
+    trap_ifcctl(TRAPIFC_INPUT, 0, TRAPCTL_SETTIMEOUT, FLOW_BATCH_TIMEOUT);
 
 
     // Initialize sender
@@ -165,10 +167,15 @@ int main(int argc, char **argv)
         FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS)
         return 4;
     }
+    // records of the template are read directly while it matches the one created here
+    bool fixed = miner_detector_input_fixed(tmplt);
 
 
 
     // ***** Main processing loop *****
+    flow_record_t batch[FLOW_BATCH_SIZE];
+    size_t batch_size = 0;
+
     while (!STOP) {
         // Receive data from any interface, wait until data are available
         const void *data;
@@ -188,11 +195,16 @@ int main(int argc, char **argv)
                 fprintf(stderr, "Template could not be edited");
                 break;
             }
+            fixed = miner_detector_input_fixed(tmplt);
             continue;
         }
 
 
-        TRAP_DEFAULT_GET_DATA_ERROR_HANDLING(ret, continue, break);
+        TRAP_DEFAULT_GET_DATA_ERROR_HANDLING(ret, {
+            miner_detector_process_batch(batch, batch_size);
+            batch_size = 0;
+            continue;
+        }, break);
 
 
         // Check size of received data
@@ -206,9 +218,16 @@ int main(int argc, char **argv)
         }
 
         // ***** Miner detector process data *****
-        miner_detector_process_data(tmplt, data);
+        miner_detector_read_flow(tmplt, fixed, data, &batch[batch_size++]);
+        if (batch_size == FLOW_BATCH_SIZE) {
+            miner_detector_process_batch(batch, batch_size);
+            batch_size = 0;
+        }
     }
 
+    // Process remaining flows
+    miner_detector_process_batch(batch, batch_size);
+
     // Wait for miner detector to finish
     //printf("DEBUG_MAIN: Waiting for miner detector to finish...\n");
     STOP = 1;
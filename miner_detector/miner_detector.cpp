@@ -64,11 +64,16 @@
 #include "miner_detector.h"
 #include "utils.h"
 #include "sender.h"
+#include "prober.h"
+#include "suspect_queue.h"
+#include "list_store.h"
+#include "affinity.h"
 
 #include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <map>
+#include <queue>
 #include <string>
 #include <vector>
 
@@ -86,8 +91,7 @@ using namespace std;
 
 
 //vector<>
-fht_table_t *BLACKLIST_DB;
-fht_table_t *WHITELIST_DB;
+fht_table_t *VERDICT_DB;
 fht_table_t *SUSPECT_DB;
 pthread_t MINER_DETECTOR_CHECK_THREAD_ID;
 pthread_t MINER_DETECTOR_LISTTIMEOUT_THREAD_ID;
@@ -106,23 +110,61 @@ uint32_t WHITELIST_DB_SIZE;
 uint32_t WHITELIST_DB_STASH_SIZE;
 uint32_t BLACKLIST_DB_SIZE;
 uint32_t BLACKLIST_DB_STASH_SIZE;
+uint32_t VERDICT_DB_SIZE;
+uint32_t VERDICT_DB_STASH_SIZE;
+StratumProber STRATUM_PROBER;
+SuspectQueue DIRTY_SUSPECTS;
+ListStore LIST_STORE;
+bool LIST_STORE_FLAG;
+
+/**
+ * \brief Scheduled check of suspect timeouts.
+ */
+struct suspect_timer_t {
+    uint32_t due;
+    suspect_item_key_t key;
+
+    suspect_timer_t(uint32_t due, const suspect_item_key_t &key) : due(due), key(key) {}
+    bool operator>(const suspect_timer_t &other) const { return due > other.due; }
+};
+
+/**
+ * Suspects ordered by time of their next timeout check, used only by check thread.
+ */
+priority_queue<suspect_timer_t, vector<suspect_timer_t>, greater<suspect_timer_t> > SUSPECT_TIMERS;
 
 extern int STOP;
 extern Sender *SENDER;
 
 
 
+/**
+ * \brief Get verdict of a server from verdict database.
+ * \param key IP address and port of the server.
+ * \return VERDICT_BLACKLIST, VERDICT_WHITELIST or VERDICT_NONE if server was not classified.
+ */
+static inline uint8_t get_verdict(list_key_t *key)
+{
+    list_item_t *item = (list_item_t*) fht_get_data(VERDICT_DB, key);
+    return item ? item->verdict : VERDICT_NONE;
+}
+
+
 /**
  * \brief Reads IP addresses with ports from specified file into database.
- * \param db    Database to read data into.
- * \param fname Name of the file from which to read.
+ * \param db      Database to read data into.
+ * \param fname   Name of the file from which to read.
+ * \param verdict Verdict of servers in the file.
  * \return True on success, False otherwise.
  */
-void create_db_from_file(fht_table_t *db, string fname)
+void create_db_from_file(fht_table_t *db, string fname, uint8_t verdict)
 {
     list_key_t key;
 
-    uint32_t value = BWL_PERMANENT_RECORD;
+    list_item_t value;
+    memset(&value, 0, sizeof(list_item_t));
+    value.timestamp = BWL_PERMANENT_RECORD;
+    value.verdict = verdict;
     fstream fin;
     fin.open(fname.c_str(), ios::in);
 
@@ -163,8 +205,11 @@ void create_db_from_file(fht_table_t *db, string fname)
             case FHT_INSERT_LOST:   // Insert kicked out item
                                     DEBUG_PRINT("Not enough space to store items in DB when reading from input file.\n");
                                     break;
-            case FHT_INSERT_FAILED: // Item with same key is already in the table, this can not happen or can?
-                                    DEBUG_PRINT("Item '%s:%u' has multiple occurrences in input file.\n", ip.c_str(), port);
+            case FHT_INSERT_FAILED: // Item with same key is already in the table, blacklist file wins
+                                    DEBUG_PRINT("Item '%s:%u' has multiple occurrences in input files.\n", ip.c_str(), port);
+                                    if (verdict == VERDICT_BLACKLIST) {
+                                        ((list_item_t*) fht_get_data(db, &key))->verdict = verdict;
+                                    }
                                     break;
         }
     }
@@ -186,25 +231,12 @@ bool initialize_suspect_db(void)
 }
 
 /**
- * \brief Initialize whitelist database.
- * \return True on success, false otherwise.
- */
-bool initialize_whitelist_db(void)
-{
-    if ((WHITELIST_DB = fht_init(WHITELIST_DB_SIZE, sizeof(list_key_t), sizeof(uint32_t), WHITELIST_DB_STASH_SIZE)) == NULL) {
-        return false;
-    } else {
-        return true;
-    }
-}
-
-/**
- * \brief Initialize whitelist database.
+ * \brief Initialize verdict database holding both blacklisted and whitelisted servers.
  * \return True on success, false otherwise.
  */
-bool initialize_blacklist_db(void)
+bool initialize_verdict_db(void)
 {
-    if ((BLACKLIST_DB = fht_init(BLACKLIST_DB_SIZE, sizeof(list_key_t), sizeof(uint32_t), BLACKLIST_DB_STASH_SIZE)) == NULL) {
+    if ((VERDICT_DB = fht_init(VERDICT_DB_SIZE, sizeof(list_key_t), sizeof(list_item_t), VERDICT_DB_STASH_SIZE)) == NULL) {
         return false;
     } else {
         return true;
@@ -704,7 +736,7 @@ void insert_suspect_to_db(suspect_item_key_t &key, suspect_item_t &suspect)
         check_key.ip = pool_ip;
         check_key.port = port;
 
-        if (fht_get_data(BLACKLIST_DB, &check_key) || lost_suspect.flagged) {
+        if (get_verdict(&check_key) == VERDICT_BLACKLIST || lost_suspect.flagged) {
             // Is blacklisted -> report
             SENDER->send(miner_ip, pool_ip, port, lost_suspect.first_seen, lost_suspect.last_seen, lost_suspect.packets);
         }
@@ -713,10 +745,11 @@ void insert_suspect_to_db(suspect_item_key_t &key, suspect_item_t &suspect)
 
 /**
  * \brief Store current W/B list database in file for use in next run.
- * \param db Database from which the data will be read.
- * \param fname File name to which the data will be written.
+ * \param db      Database from which the data will be read.
+ * \param fname   File name to which the data will be written.
+ * \param verdict Verdict of servers to be written.
  */
- void store_list_db(fht_table_t *db, const char *fname)
+ void store_list_db(fht_table_t *db, const char *fname, uint8_t verdict)
  {
     char buff[128];
     ofstream myfile;
@@ -730,6 +763,10 @@ void insert_suspect_to_db(suspect_item_key_t &key, suspect_item_t &suspect)
 
     fht_iter_t *iter = fht_init_iter(db);
     while (fht_get_next_iter(iter) == FHT_ITER_RET_OK) {
+        if (((list_item_t*)iter->data_ptr)->verdict != verdict) {
+            continue;
+        }
+
         // Get IP address and port from iterator
         ip_addr_t *ip = &((list_key_t*)iter->key_ptr)->ip;
         uint16_t *port = &((list_key_t*)iter->key_ptr)->port;
@@ -764,7 +801,7 @@ void export_suspects(void)
         key.ip = *pool_ip;
         key.port = port;
 
-        if (fht_get_data(BLACKLIST_DB, &key)) {
+        if (get_verdict(&key) == VERDICT_BLACKLIST) {
             // Is blacklisted -> report
             SENDER->send(*miner_ip, *pool_ip, port, ((suspect_item_t*)iter->data_ptr)->first_seen, ((suspect_item_t*)iter->data_ptr)->last_seen, ((suspect_item_t*)iter->data_ptr)->packets);
         }
@@ -780,8 +817,7 @@ void export_suspects(void)
  */
 void *list_timeout_thread(void *data)
 {
-    fht_iter_t *black_iter = fht_init_iter(BLACKLIST_DB);
-    fht_iter_t *white_iter = fht_init_iter(WHITELIST_DB);
+    fht_iter_t *iter = fht_init_iter(VERDICT_DB);
 
     while(!STOP) {
         uint32_t white_expired_sum = 0;
@@ -793,55 +829,53 @@ void *list_timeout_thread(void *data)
 
         DEBUG_PRINT("[%s] New round of checking black/white list\n", timestr);
 
-        // Check blacklist DB
-        fht_reinit_iter(black_iter);
+        // Check verdict DB
+        fht_reinit_iter(iter);
 
-        // Cycle through every item in blacklist DB
-        while (fht_get_next_iter(black_iter) == FHT_ITER_RET_OK) {
+        // Cycle through every item in verdict DB
+        while (fht_get_next_iter(iter) == FHT_ITER_RET_OK) {
             if (STOP) {
                 DEBUG_PRINT("STOP signal detected\n");
                 break;
             }
 
+            list_item_t *item = (list_item_t*)iter->data_ptr;
+
             // Check timestamp if it is permanent
-            if (*((uint32_t*)black_iter->data_ptr) == BWL_PERMANENT_RECORD) {
+            if (item->timestamp == BWL_PERMANENT_RECORD) {
                 continue; // Permanent records do not expire
             }
 
-            // Check timestamp if it expired
-            if (CURRENT_TIME - *((uint32_t*)black_iter->data_ptr) >= BL_ITEM_EXPIRE_TIME) {
-                black_expired_sum++;
-                fht_remove_iter(black_iter); // Record has expired
+            // Check timestamp if it expired, records restored from list store
+            // may be newer than flows seen so far
+            bool black = item->verdict == VERDICT_BLACKLIST;
+            if (CURRENT_TIME >= item->timestamp &&
+                CURRENT_TIME - item->timestamp >= (black ? BL_ITEM_EXPIRE_TIME : WL_ITEM_EXPIRE_TIME)) {
+                if (black) {
+                    black_expired_sum++;
+                } else {
+                    white_expired_sum++;
+                }
+                if (LIST_STORE_FLAG) {
+                    LIST_STORE.remove(*((list_key_t*)iter->key_ptr));
+                }
+                fht_remove_iter(iter); // Record has expired
                 continue;
             }
         }
 
-        // Check whitelist DB
-        fht_reinit_iter(white_iter);
-
-        // Cycle through every item in blacklist DB
-        while (fht_get_next_iter(white_iter) == FHT_ITER_RET_OK) {
-            if (STOP) {
-                DEBUG_PRINT("STOP signal detected\n");
-                break;
-            }
 
-            // Check timestamp if it is permanent
-            if (*((uint32_t*)white_iter->data_ptr) == BWL_PERMANENT_RECORD) {
-                continue; // Permanent records do not expire
-            }
+        DEBUG_PRINT("Expired items in lists: black = %u, white = %u\n", black_expired_sum, white_expired_sum);
 
-            // Check timestamp if it expired
-            if (CURRENT_TIME - *((uint32_t*)white_iter->data_ptr) >= WL_ITEM_EXPIRE_TIME) {
-                white_expired_sum++;
-                fht_remove_iter(white_iter); // Record has expired
-                continue;
+        // Rewrite list store when it holds mostly outdated records, flush it otherwise
+        if (LIST_STORE_FLAG && !STOP) {
+            if (LIST_STORE.needs_compaction()) {
+                LIST_STORE.compact(VERDICT_DB);
+            } else {
+                LIST_STORE.sync(false);
             }
         }
 
-
-        DEBUG_PRINT("Expired items in lists: black = %u, white = %u\n", black_expired_sum, white_expired_sum);
-
         // Wait for next iteration
         if (!STOP) {
             sleep(BWL_LIST_EXPIRE_SLEEP_DURATION);
@@ -853,23 +887,209 @@ void *list_timeout_thread(void *data)
     return NULL;
 }
 
+/**
+ * \brief Store result of stratum check of a server, called by prober thread.
+ * \param pool    IP address and port of the checked server.
+ * \param suspect Suspect whose score triggered the check.
+ * \param ret     Result of the check.
+ * \param pool_id ID of matched mining pool.
+ */
+void stratum_check_done(const list_key_t &pool, const suspect_item_key_t &suspect, int ret, uint8_t pool_id)
+{
+    list_key_t key = pool;
+    list_key_t lost_key;
+    list_item_t item;
+    list_item_t lost_item;
+
+    memset(&item, 0, sizeof(list_item_t));
+    item.timestamp = CURRENT_TIME;
+
+    if (ret == STRATUM_MATCH) {
+        // Add pool IP to blacklist
+        DEBUG_PRINT("Stratum detected(%s), blacklisting!\n", stratum_mpool_string(pool_id));
+        item.verdict = VERDICT_BLACKLIST;
+        ret = fht_insert(VERDICT_DB, &key, &item, &lost_key, &lost_item);
+
+        // Other suspects of the server are flagged at their next update or timeout
+        int8_t *lock = NULL;
+        suspect_item_key_t suspect_key = suspect;
+        suspect_item_t *suspect_item = (suspect_item_t*) fht_get_data_locked(SUSPECT_DB, &suspect_key, &lock);
+        if (suspect_item) {
+            suspect_item->pool_id = pool_id;
+            suspect_item->flagged = true;
+            fht_unlock_data(lock);
+        }
+    } else {
+        // Add pool IP to whitelist, its suspects are removed at their next update or timeout
+        DEBUG_PRINT("Stratum not detected(%s), whitelisting!\n", stratum_error_string(ret));
+        item.verdict = VERDICT_WHITELIST;
+        ret = fht_insert(VERDICT_DB, &key, &item, &lost_key, &lost_item);
+    }
+
+    // Keep persistent store in sync with the database
+    if (LIST_STORE_FLAG) {
+        if (ret == FHT_INSERT_OK || ret == FHT_INSERT_LOST) {
+            LIST_STORE.add(key, item);
+        }
+        if (ret == FHT_INSERT_LOST) {
+            LIST_STORE.remove(lost_key);
+        }
+    }
+
+    // Check insert to DB
+    switch (ret) {
+        case FHT_INSERT_OK:     // Insert was successfull
+                                break;
+        case FHT_INSERT_LOST:   // Insert kicked out item
+                                DEBUG_PRINT("Some item was kicked out from W/BList DB due to inserting new one.\n");
+                                break;
+        case FHT_INSERT_FAILED: // Item with same key is already in the table, this can not happen or can?
+                                DEBUG_PRINT("Inserting failed!\n");
+                                break;
+    }
+}
+
+/**
+ * \brief Schedule check of suspect timeouts, called with suspect locked.
+ * \param key     Key of the suspect.
+ * \param suspect Locked suspect.
+ * \param due     Time when the suspect should be checked.
+ */
+void schedule_suspect_check(const suspect_item_key_t &key, suspect_item_t *suspect, uint32_t due)
+{
+    // Only the earliest entry of a suspect is valid, later ones are skipped when popped
+    if (suspect->check_time == 0 || due < suspect->check_time) {
+        suspect->check_time = due;
+        SUSPECT_TIMERS.push(suspect_timer_t(due, key));
+    }
+}
+
+
+/**
+ * \brief Check suspect against blacklist/whitelist database and its score,
+ *        export or remove it when its timeout expired.
+ * \param key   Key of the suspect.
+ * \param timer Time of popped timer which triggered the check, 0 for updated suspect.
+ */
+void check_suspect(suspect_item_key_t &key, uint32_t timer)
+{
+    int8_t *lock = NULL;
+    bool blacklisted_flag = false;
+    ip_addr_t *miner_ip = &key.suspect_ip;
+    ip_addr_t *pool_ip = &key.pool_ip;
+    uint16_t port = key.port;
+
+    suspect_item_t *suspect = (suspect_item_t*) fht_get_data_locked(SUSPECT_DB, &key, &lock);
+    if (suspect == NULL) {
+        return; // Suspect was already removed or kicked out
+    }
+    if (timer) {
+        if (suspect->check_time != timer) {
+            fht_unlock_data(lock);
+            return; // Suspect is scheduled at another time
+        }
+        suspect->check_time = 0;
+    } else {
+        suspect->dirty = false;
+    }
+
+    list_key_t list_key;
+    memset(&list_key, 0, sizeof(list_key_t));
+    list_key.ip = *pool_ip;
+    list_key.port = port;
+
+    // Check if pool IP is blacklisted or whitelisted
+    uint8_t verdict = get_verdict(&list_key);
+    if (verdict == VERDICT_BLACKLIST) {
+        blacklisted_flag = true;
+        suspect->flagged = true;
+    } else if (verdict == VERDICT_WHITELIST) {
+        // Remove suspect from database
+        fht_unlock_data(lock);
+        fht_remove(SUSPECT_DB, &key);
+        return;
+    } else {
+        // Check score
+        uint32_t score = compute_suspect_score(*suspect);
+        uint8_t weka_flag = compute_weka_tree(*suspect);
+        if (score >= SUSPECT_SCORE_THRESHOLD && weka_flag && CHECK_STRATUM_FLAG) {
+            // Check pool IP if it support stratum protocol, result is stored
+            // into blacklist/whitelist by stratum_check_done()
+            if (STRATUM_PROBER.submit(list_key, key)) {
+                // Keep suspect until its server is classified
+                schedule_suspect_check(key, suspect, CURRENT_TIME + CHECK_THREAD_SLEEP_PERIOD);
+                fht_unlock_data(lock);
+                return;
+            }
+        }
+    }
+
+    // Check if expired (INACTIVE TIMEOUT)
+    if (CURRENT_TIME - suspect->last_seen >= TIMEOUT_INACTIVE) {
+        // Inactive timeout expired
+        suspect_item_t tmp = *suspect;
+        fht_unlock_data(lock);
+        if (blacklisted_flag) {
+            SENDER->send(*miner_ip, *pool_ip, port, tmp.first_seen, tmp.last_seen, tmp.packets);
+        }
+        fht_remove(SUSPECT_DB, &key);
+        return;
+    }
+
+    // Check flow last seen timestamp (ACTIVE TIMEOUT)
+    if (CURRENT_TIME - suspect->last_exported >= TIMEOUT_EXPORT) {
+        // Export timeout expired, send data to output
+        if (blacklisted_flag) {
+            SENDER->send(*miner_ip, *pool_ip, port, suspect->first_seen, suspect->last_seen, suspect->packets);
+            // Reset last exported time
+            suspect->last_exported = CURRENT_TIME;
+        } else {
+            fht_unlock_data(lock);
+            fht_remove(SUSPECT_DB, &key);
+            return;
+        }
+    }
+
+    // Check again when the earlier of the timeouts expires
+    uint32_t due = std::min(suspect->last_seen + TIMEOUT_INACTIVE, suspect->last_exported + TIMEOUT_EXPORT);
+    schedule_suspect_check(key, suspect, std::max(due, CURRENT_TIME + 1));
+    fht_unlock_data(lock);
+}
+
+
+/**
+ * \brief Check every suspect in suspect database, used when some updated
+ *        suspects were dropped from the queue.
+ */
+void check_all_suspects(void)
+{
+    vector<suspect_item_key_t> keys;
+
+    // Iterator holds lock of current row, collect keys first
+    fht_iter_t *iter = fht_init_iter(SUSPECT_DB);
+    while (fht_get_next_iter(iter) == FHT_ITER_RET_OK) {
+        keys.push_back(*(suspect_item_key_t*)iter->key_ptr);
+    }
+    fht_destroy_iter(iter);
+
+    for (size_t i = 0; i < keys.size() && !STOP; i++) {
+        check_suspect(keys[i], 0);
+    }
+}
+
+
 /**
  * \brief Thread for checking, exporting and removing suspects from database.
+ *        Only suspects updated since the last round and suspects whose timeout
+ *        expired are checked.
  * \param data Nothing, null.
  * \return Nothing, null.
  */
 void *check_thread(void *data)
 {
-    ip_addr_t *miner_ip, *pool_ip;
-    uint16_t port;
-    char buff[128];
-    fht_iter_t *iter = fht_init_iter(SUSPECT_DB);
+    suspect_item_key_t key;
 
-    // Cycle through suspect database and check for suspects with high score
     while(!STOP) {
-        fht_reinit_iter(iter);
-
-   
         time_t timestamp = CURRENT_TIME;
         struct tm tmp_tm;
         char timestr[200];
@@ -877,112 +1097,20 @@ void *check_thread(void *data)
 
         DEBUG_PRINT("[%s] New round of passive testing\n", timestr);
 
-        // Cycle through every suspect in DB
-        while (fht_get_next_iter(iter) == FHT_ITER_RET_OK) {
-            bool blacklisted_flag = false;
-
-            if (STOP) {
-                DEBUG_PRINT("STOP signal detected\n");
-                break;
-            }
-            // Get IP addresses and port from iterator
-            miner_ip = &((suspect_item_key_t*)iter->key_ptr)->suspect_ip;
-            pool_ip = &((suspect_item_key_t*)iter->key_ptr)->pool_ip;
-            port = ((suspect_item_key_t*)iter->key_ptr)->port;
-
-            list_key_t key;
-            memset(&key, 0, sizeof(list_key_t));
-            key.ip = *pool_ip;
-            key.port = port;
-
-            // Check if pool IP is in blacklist database
-            if (fht_get_data(BLACKLIST_DB, &key)) {
-                blacklisted_flag = true;
-                ((suspect_item_t*)iter->data_ptr)->flagged = true;
-            } // Check if pool IP is in the whitelist database
-            else if (fht_get_data(WHITELIST_DB, &key)) {
-                // Remove suspect from database
-                fht_remove_iter(iter);
-                continue;
-            } else {
-                // Check score
-                uint32_t score = compute_suspect_score(*(suspect_item_t*)iter->data_ptr);
-                uint8_t weka_flag = compute_weka_tree(*(suspect_item_t*)iter->data_ptr);
-                if (score >= SUSPECT_SCORE_THRESHOLD && weka_flag) {
-                    int ret;
-                    uint32_t timestamp = CURRENT_TIME;
-                    uint8_t pool_id;
-                    if (CHECK_STRATUM_FLAG) {
-                        // Check pool IP if it support stratum protocol
-                        ip_to_str(pool_ip, buff);
-                        if ((ret = stratum_check_server(buff, port, &pool_id)) == STRATUM_MATCH) {
-                            // Add pool IP to blacklist
-                            DEBUG_PRINT("Stratum detected(%s), blacklisting!\n", stratum_mpool_string(pool_id));
-                            ret = fht_insert(BLACKLIST_DB, &key, &timestamp, NULL, NULL);
-                            blacklisted_flag = true;
-                            ((suspect_item_t*)iter->data_ptr)->pool_id = pool_id;
-                            ((suspect_item_t*)iter->data_ptr)->flagged = true;
-                        } else {
-                            // Add pool IP to whitelist
-                            DEBUG_PRINT("Stratum not detected(%s), whitelisting!\n", stratum_error_string(ret));
-                            ret = fht_insert(WHITELIST_DB, &key, &timestamp, NULL, NULL);
-                            fht_remove_iter(iter);
-                            continue;
-                        }
-                    } else {
-                        // DEBUG
-                        /*if (fht_get_data(BLACKLIST_DB, &key)) {
-                            DEBUG_PRINT("Stratum detected(-), blacklisting!\n");
-                            blacklisted_flag = true;
-                            ((suspect_item_t*)iter->data_ptr)->flagged = true;
-                            ret = FHT_INSERT_OK;
-                        } else {
-                            //DEBUG_PRINT("Stratum not detected(-), whitelisting!\n");
-                            ret = fht_insert(WHITELIST_DB, &key, &timestamp, NULL, NULL);
-                            fht_remove_iter(iter);
-                            continue;
-                        }*/
-                        // Not checking for stratum, rely only on score
-                        ret = STRATUM_NOT_USED; //FHT_INSERT_OK;//ret = fht_insert(BLACKLIST_DB, &key, &value, NULL, NULL);
-                    }
-                    // Check insert to DB
-                    switch (ret) {
-                        case STRATUM_NOT_USED:  // Not using stratum checker
-                                                break;
-                        case FHT_INSERT_OK:     // Insert was successfull
-                                                break;
-                        case FHT_INSERT_LOST:   // Insert kicked out item
-                                                DEBUG_PRINT("Some item was kicked out from W/BList DB due to inserting new one.\n");
-                                                break;
-                        case FHT_INSERT_FAILED: // Item with same key is already in the table, this can not happen or can?
-                                                DEBUG_PRINT("Inserting failed!\n");
-                                                break;
-                    }
-                }
-            }
-
-            // For every item in suspect db, check if expired (INACTIVE TIMEOUT)
-            if (CURRENT_TIME - ((suspect_item_t*)iter->data_ptr)->last_seen >= TIMEOUT_INACTIVE) {
-                // Inactive timeout expired
-                if (blacklisted_flag) {
-                    SENDER->send(*miner_ip, *pool_ip, port, ((suspect_item_t*)iter->data_ptr)->first_seen,((suspect_item_t*)iter->data_ptr)->last_seen, ((suspect_item_t*)iter->data_ptr)->packets);
-                }
-                fht_remove_iter(iter);
-                continue;
-            }
+        // Check suspects updated by flows
+        if (DIRTY_SUSPECTS.overflowed()) {
+            DEBUG_PRINT("Queue of updated suspects overflowed, checking all suspects\n");
+            check_all_suspects();
+        }
+        while (!STOP && DIRTY_SUSPECTS.pop(key)) {
+            check_suspect(key, 0);
+        }
 
-            // Check flow last seen timestamp (ACTIVE TIMEOUT)
-            if (CURRENT_TIME - ((suspect_item_t*)iter->data_ptr)->last_exported >= TIMEOUT_EXPORT) {
-                // Export timeout expired, send data to output
-                if (blacklisted_flag) {
-                    SENDER->send(*miner_ip, *pool_ip, port, ((suspect_item_t*)iter->data_ptr)->first_seen, ((suspect_item_t*)iter->data_ptr)->last_seen, ((suspect_item_t*)iter->data_ptr)->packets);
-                    // Reset last exported time
-                    ((suspect_item_t*)iter->data_ptr)->last_exported = CURRENT_TIME;
-                } else {
-                    fht_remove_iter(iter);
-                    continue;
-                }
-            }
+        // Check suspects whose timeout expired
+        while (!STOP && !SUSPECT_TIMERS.empty() && SUSPECT_TIMERS.top().due <= CURRENT_TIME) {
+            suspect_timer_t timer = SUSPECT_TIMERS.top();
+            SUSPECT_TIMERS.pop();
+            check_suspect(timer.key, timer.due);
         }
 
         if (!STOP) {
@@ -990,21 +1118,27 @@ void *check_thread(void *data)
         }
     }
 
-    // Free iterator
-    fht_destroy_iter(iter);
+    // Drop checks in progress, no more results may be stored into databases
+    STRATUM_PROBER.stop();
 
     // We are terminating, export every blacklisted suspect
     export_suspects();
 
     // Write current blacklist/whitelist database to file for further use
-    store_list_db(BLACKLIST_DB, BL_STORE_FILE);
-    store_list_db(WHITELIST_DB, WL_STORE_FILE);
+    store_list_db(VERDICT_DB, BL_STORE_FILE, VERDICT_BLACKLIST);
+    store_list_db(VERDICT_DB, WL_STORE_FILE, VERDICT_WHITELIST);
+
+    // Flush all records of persistent store to disk
+    if (LIST_STORE_FLAG) {
+        LIST_STORE_FLAG = false;
+        LIST_STORE.close();
+    }
 
     // Free all databases
     fht_destroy(SUSPECT_DB);
-    fht_destroy(BLACKLIST_DB);
-    fht_destroy(WHITELIST_DB);
+    fht_destroy(VERDICT_DB);
 
+    stratum_free();
 
     DEBUG_PRINT("Terminating checking thread\n");
     return NULL;
@@ -1034,23 +1168,52 @@ bool miner_detector_initialization(config_struct_t* config)
     BLACKLIST_DB_SIZE = config->blacklist_db_size;
     BLACKLIST_DB_STASH_SIZE = config->blacklist_db_stash_size;
 
-    DEBUG_PRINT("SuspectDB size = %u\nWhitelistDB size = %u\nBlacklistDB size = %u\n", SUSPECT_DB_SIZE, WHITELIST_DB_SIZE, BLACKLIST_DB_SIZE);
+    // One table holds servers of both lists, keep its rows power of two
+    VERDICT_DB_SIZE = 1;
+    while (VERDICT_DB_SIZE < BLACKLIST_DB_SIZE + WHITELIST_DB_SIZE) {
+        VERDICT_DB_SIZE <<= 1;
+    }
+    VERDICT_DB_STASH_SIZE = max(BLACKLIST_DB_STASH_SIZE, WHITELIST_DB_STASH_SIZE);
+
+    DEBUG_PRINT("SuspectDB size = %u\nVerdictDB size = %u\n", SUSPECT_DB_SIZE, VERDICT_DB_SIZE);
+
+    // Pin the main thread before it creates the DBs, so they are placed on the NUMA node of its CPU
+    if (affinity_init(config->cpu_affinity) != 0) {
+        return false;
+    }
+    affinity_pin_self();
 
     // Create DBs
-    if (!initialize_suspect_db() || !initialize_whitelist_db() || !initialize_blacklist_db()) {
+    if (!initialize_suspect_db() || !initialize_verdict_db()) {
         fprintf(stderr, "Error initializing databases!\n");
         return false;
     }
 
+    if (!DIRTY_SUSPECTS.init(SUSPECT_QUEUE_SIZE)) {
+        fprintf(stderr, "Error initializing queue of updated suspects!\n");
+        return false;
+    }
+
 
     if (strcmp(config->blacklist_file, "-") != 0) {
         // Create blacklist DB
-        create_db_from_file(BLACKLIST_DB, config->blacklist_file);
+        create_db_from_file(VERDICT_DB, config->blacklist_file, VERDICT_BLACKLIST);
     }
 
     if (strcmp(config->whitelist_file, "-") != 0) {
          // Create whitelist DB
-        create_db_from_file(WHITELIST_DB, config->whitelist_file);
+        create_db_from_file(VERDICT_DB, config->whitelist_file, VERDICT_WHITELIST);
+    }
+
+    if (strcmp(config->list_store_file, "-") != 0) {
+        // Restore servers classified in previous runs
+        if (!LIST_STORE.open(config->list_store_file)) {
+            fprintf(stderr, "Error opening list store!\n");
+            return false;
+        }
+        LIST_STORE.load(VERDICT_DB);
+        LIST_STORE.compact(VERDICT_DB);
+        LIST_STORE_FLAG = true;
     }
 
     if (strcmp(config->store_blacklist_file, "-") != 0) {
@@ -1073,12 +1236,24 @@ bool miner_detector_initialization(config_struct_t* config)
     stratum_set_timeout(STRATUM_CONN_TIMEOUT, config->conn_timeout);
     stratum_set_timeout(STRATUM_READ_TIMEOUT, config->read_timeout);
 
+    // Compile patterns of stratum replies, they are shared by check threads
+    if (CHECK_STRATUM_FLAG && !stratum_init()) {
+        fprintf(stderr, "Error compiling stratum patterns!\n");
+        return false;
+    }
+
+    // Start prober checking suspicious servers in background
+    if (CHECK_STRATUM_FLAG && !STRATUM_PROBER.start(config->stratum_max_probes, config->stratum_dest_rate, stratum_check_done)) {
+        fprintf(stderr, "Error starting stratum prober!\n");
+        return false;
+    }
+
 
     // Create checking thread
-    pthread_create(&MINER_DETECTOR_CHECK_THREAD_ID, NULL, check_thread, NULL);
+    affinity_thread_create(&MINER_DETECTOR_CHECK_THREAD_ID, check_thread, NULL);
 
     // Create whitelist/blacklist timeout thread
-    pthread_create(&MINER_DETECTOR_LISTTIMEOUT_THREAD_ID, NULL, list_timeout_thread, NULL);
+    affinity_thread_create(&MINER_DETECTOR_LISTTIMEOUT_THREAD_ID, list_timeout_thread, NULL);
 
     return true;
 }
@@ -1086,65 +1261,114 @@ bool miner_detector_initialization(config_struct_t* config)
 
 
 /**
- * \brief Processes flow data, finds suspicious flows and updates suspect database.
+ * Offsets of the fields of the input template in input_record_t.
+ */
+static const ur_fixed_field_t INPUT_RECORD_FIELDS[] = {
+    UR_FIXED_FIELD(input_record_t, dst_ip, F_DST_IP),
+    UR_FIXED_FIELD(input_record_t, src_ip, F_SRC_IP),
+    UR_FIXED_FIELD(input_record_t, bytes, F_BYTES),
+    UR_FIXED_FIELD(input_record_t, time_first, F_TIME_FIRST),
+    UR_FIXED_FIELD(input_record_t, time_last, F_TIME_LAST),
+    UR_FIXED_FIELD(input_record_t, packets, F_PACKETS),
+    UR_FIXED_FIELD(input_record_t, dst_port, F_DST_PORT),
+    UR_FIXED_FIELD(input_record_t, src_port, F_SRC_PORT),
+    UR_FIXED_FIELD(input_record_t, protocol, F_PROTOCOL),
+    UR_FIXED_FIELD(input_record_t, tcp_flags, F_TCP_FLAGS),
+};
+
+
+
+/**
+ * \brief Check whether records of the negotiated template can be read as input_record_t.
+ * \param tmplt Template of the input interface.
+ * \return True when the template has exactly the fields of the input template.
+ */
+bool miner_detector_input_fixed(const ur_template_t *tmplt)
+{
+    return ur_fixed_match(tmplt, INPUT_RECORD_FIELDS, UR_FIXED_FIELD_COUNT(INPUT_RECORD_FIELDS), sizeof(input_record_t));
+}
+
+
+
+/**
+ * \brief Copy fields used by the detector out of UniRec record and update global timestamp.
  * \param tmplt Template of given Unirec data.
+ * \param fixed True when the template matches input_record_t (see miner_detector_input_fixed()).
  * \param data  Flow data.
+ * \param flow  Copied fields are stored here.
  */
-void miner_detector_process_data(ur_template_t *tmplt, const void *data)
+void miner_detector_read_flow(ur_template_t *tmplt, bool fixed, const void *data, flow_record_t *flow)
 {
-    bool blacklist_dst_flag = false;
-    bool suspect_flag = false;
-    bool only_ack_flow_flag = false;
-    bool only_ackpush_flow_flag = false;
-    bool syn_flow_flag = false;
-    bool rst_flow_flag = false;
-    bool fin_flow_flag = false;
-    int8_t *lock = NULL;
+    if (fixed) {
+        const input_record_t *rec = (const input_record_t *) data;
+
+        flow->src_ip = rec->src_ip;
+        flow->dst_ip = rec->dst_ip;
+        flow->src_port = rec->src_port;
+        flow->dst_port = rec->dst_port;
+        flow->protocol = rec->protocol;
+        flow->tcp_flags = rec->tcp_flags;
+        flow->packets = rec->packets;
+        flow->bytes = rec->bytes;
+        flow->time_last = ur_time_get_sec(rec->time_last);
+    } else {
+        flow->src_ip = ur_get(tmplt, data, F_SRC_IP);
+        flow->dst_ip = ur_get(tmplt, data, F_DST_IP);
+        flow->src_port = ur_get(tmplt, data, F_SRC_PORT);
+        flow->dst_port = ur_get(tmplt, data, F_DST_PORT);
+        flow->protocol = ur_get(tmplt, data, F_PROTOCOL);
+        flow->tcp_flags = ur_get(tmplt, data, F_TCP_FLAGS);
+        flow->packets = ur_get(tmplt, data, F_PACKETS);
+        flow->bytes = ur_get(tmplt, data, F_BYTES);
+        flow->time_last = ur_time_get_sec(ur_get(tmplt, data, F_TIME_LAST));
+    }
 
     // Update global timestamp
-    uint32_t actual_time = ur_time_get_sec(ur_get(tmplt, data, F_TIME_LAST));
+    uint32_t actual_time = flow->time_last;
     if (actual_time > CURRENT_TIME) {
         if (actual_time - CURRENT_TIME > 300) {
             DEBUG_PRINT("WARNING: TIMEJUMP by %u\n", actual_time - CURRENT_TIME);
         }
         CURRENT_TIME = actual_time;
     }
+}
 
-    // Convert src/dst ip to string
-    ip_addr_t src_ip = ur_get(tmplt, data, F_SRC_IP);
-    ip_addr_t dst_ip = ur_get(tmplt, data, F_DST_IP);
-
-    // Store ports
-    uint16_t src_port = ur_get(tmplt, data, F_SRC_PORT);
-    uint16_t dst_port = ur_get(tmplt, data, F_DST_PORT);
-
-    list_key_t key;
 
-    memset(&key, 0, sizeof(list_key_t));
-    key.ip = dst_ip;
-    key.port = dst_port;
-    // If destination is blacklisted, tag flow as suspect
-    if (fht_get_data(BLACKLIST_DB, &key)) {
-        blacklist_dst_flag = suspect_flag = true;
-    }
+/**
+ * \brief Find suspicious flow and update suspect database.
+ * \param flow        Flow data.
+ * \param dst_verdict Verdict of destination IP and port.
+ * \param src_verdict Verdict of source IP and port.
+ */
+void process_flow(const flow_record_t &flow, uint8_t dst_verdict, uint8_t src_verdict)
+{
+    bool blacklist_dst_flag = false;
+    bool suspect_flag = false;
+    bool only_ack_flow_flag = false;
+    bool only_ackpush_flow_flag = false;
+    bool syn_flow_flag = false;
+    bool rst_flow_flag = false;
+    bool fin_flow_flag = false;
+    int8_t *lock = NULL;
 
     // If destination is whitelisted, do not add suspect to databse
-    if (fht_get_data(WHITELIST_DB, &key)) {
+    if (dst_verdict == VERDICT_WHITELIST) {
         return;
     }
 
+    // If destination is blacklisted, tag flow as suspect
+    if (dst_verdict == VERDICT_BLACKLIST) {
+        blacklist_dst_flag = suspect_flag = true;
+    }
 
-    memset(&key, 0, sizeof(list_key_t));
-    key.ip = src_ip;
-    key.port = src_port;
     // If source is blacklisted, do nothing for now
-    if (fht_get_data(BLACKLIST_DB, &key)) {
+    if (src_verdict == VERDICT_BLACKLIST) {
         return;
     }
 
     // Check if flow is TCP and check TCP flags
-    if (ur_get(tmplt, data, F_PROTOCOL) == PROTO_TCP) {
-        uint8_t tcp_flags = ur_get(tmplt, data, F_TCP_FLAGS);
+    if (flow.protocol == PROTO_TCP) {
+        uint8_t tcp_flags = flow.tcp_flags;
 
         only_ack_flow_flag = tcp_flags == TCP_ACK;
         only_ackpush_flow_flag = tcp_flags == (TCP_ACK | TCP_PSH);
@@ -1157,7 +1381,9 @@ void miner_detector_process_data(ur_template_t *tmplt, const void *data)
     }
 
     // Check if IP addresses are already suspects
-    suspect_item_key_t suspect_key = create_suspect_key(src_ip, dst_ip, dst_port);
+    ip_addr_t src_ip = flow.src_ip;
+    ip_addr_t dst_ip = flow.dst_ip;
+    suspect_item_key_t suspect_key = create_suspect_key(src_ip, dst_ip, flow.dst_port);
     suspect_item_t *suspect = (suspect_item_t*) fht_get_data_locked(SUSPECT_DB, &suspect_key, &lock);
     if (suspect) {
         // Update suspect
@@ -1168,10 +1394,15 @@ void miner_detector_process_data(ur_template_t *tmplt, const void *data)
         suspect->rst_flows += (int) rst_flow_flag;
         suspect->fin_flows += (int) fin_flow_flag;
         suspect->other_flows += (int) (!only_ack_flow_flag && !only_ackpush_flow_flag);
-        suspect->req_flows += (int) (ur_get(tmplt, data, F_SRC_PORT) > ur_get(tmplt, data, F_DST_PORT));
-        suspect->packets += ur_get(tmplt, data, F_PACKETS);
-        suspect->bytes += ur_get(tmplt, data, F_BYTES);
-        suspect->last_seen = ur_time_get_sec(ur_get(tmplt, data, F_TIME_LAST));
+        suspect->req_flows += (int) (flow.src_port > flow.dst_port);
+        suspect->packets += flow.packets;
+        suspect->bytes += flow.bytes;
+        suspect->last_seen = flow.time_last;
+
+        // Let check thread score the suspect again
+        if (!suspect->dirty) {
+            suspect->dirty = DIRTY_SUSPECTS.push(suspect_key);
+        }
 
         suspect_flag = false;
         fht_unlock_data(lock);
@@ -1193,17 +1424,68 @@ void miner_detector_process_data(ur_template_t *tmplt, const void *data)
         suspect.rst_flows = (int) rst_flow_flag;
         suspect.fin_flows = (int) fin_flow_flag;
         suspect.other_flows = (int) (!only_ack_flow_flag && !only_ackpush_flow_flag);
-        suspect.req_flows = (int) (ur_get(tmplt, data, F_SRC_PORT) > ur_get(tmplt, data, F_DST_PORT));
-        suspect.packets = ur_get(tmplt, data, F_PACKETS);
-        suspect.bytes = ur_get(tmplt, data, F_BYTES);
-        suspect.first_seen = ur_time_get_sec(ur_get(tmplt, data, F_TIME_LAST));
-        suspect.last_seen = ur_time_get_sec(ur_get(tmplt, data, F_TIME_LAST));
-        suspect.last_exported = ur_time_get_sec(ur_get(tmplt, data, F_TIME_LAST));
-
-        // Insert suspect to database
+        suspect.req_flows = (int) (flow.src_port > flow.dst_port);
+        suspect.packets = flow.packets;
+        suspect.bytes = flow.bytes;
+        suspect.first_seen = flow.time_last;
+        suspect.last_seen = flow.time_last;
+        suspect.last_exported = flow.time_last;
+        suspect.dirty = true;
+
+        // Insert suspect to database, queue it after it can be found by check thread
         insert_suspect_to_db(suspect_key, suspect);
+        DIRTY_SUSPECTS.push(suspect_key);
     }
 
 }
 
 
+/**
+ * \brief Processes batch of flows, verdicts of all flows are looked up first
+ *        and then the suspect database is updated flow by flow.
+ * \param flows Flow data.
+ * \param count Number of flows.
+ */
+void miner_detector_process_batch(const flow_record_t *flows, size_t count)
+{
+    uint8_t dst_verdict[FLOW_BATCH_SIZE];
+    uint8_t src_verdict[FLOW_BATCH_SIZE];
+    list_key_t key;
+
+    memset(&key, 0, sizeof(list_key_t));
+
+    for (size_t start = 0; start < count; start += FLOW_BATCH_SIZE) {
+        size_t n = min(count - start, (size_t) FLOW_BATCH_SIZE);
+
+        // One lookup per endpoint, flows to whitelisted servers need no more
+        for (size_t i = 0; i < n; i++) {
+            key.ip = flows[start + i].dst_ip;
+            key.port = flows[start + i].dst_port;
+            dst_verdict[i] = get_verdict(&key);
+            src_verdict[i] = VERDICT_NONE;
+            if (dst_verdict[i] != VERDICT_WHITELIST) {
+                key.ip = flows[start + i].src_ip;
+                key.port = flows[start + i].src_port;
+                src_verdict[i] = get_verdict(&key);
+            }
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            process_flow(flows[start + i], dst_verdict[i], src_verdict[i]);
+        }
+    }
+}
+
+
+/**
+ * \brief Processes flow data, finds suspicious flows and updates suspect database.
+ * \param tmplt Template of given Unirec data.
+ * \param data  Flow data.
+ */
+void miner_detector_process_data(ur_template_t *tmplt, const void *data)
+{
+    flow_record_t flow;
+
+    miner_detector_read_flow(tmplt, false, data, &flow);
+    miner_detector_process_batch(&flow, 1);
+}
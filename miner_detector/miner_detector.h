@@ -8,6 +8,7 @@
 
 #include <stdint.h>
 #include <unirec/unirec.h>
+#include "ur_fixed.h"
 
 #ifndef _H_MINER_DETECTOR
 #define _H_MINER_DETECTOR
@@ -99,6 +100,24 @@
 #define BWL_PERMANENT_RECORD 0
 
 
+/**
+ * Verdicts of servers in verdict database.
+ */
+#define VERDICT_BLACKLIST 0
+#define VERDICT_WHITELIST 1
+#define VERDICT_NONE 0xff
+
+/**
+ * Number of flows processed in one batch.
+ */
+#define FLOW_BATCH_SIZE 64
+
+/**
+ * Time [us] after which incomplete batch of flows is processed when no flow arrives.
+ */
+#define FLOW_BATCH_TIMEOUT 1000000
+
+
 /**
  * After what time whitelisted item will expire in seconds.
  */
@@ -145,11 +164,13 @@ typedef struct suspect_item {
     uint32_t first_seen;
     uint32_t last_seen;
     uint32_t last_exported;
+    uint32_t check_time; ///< Time of scheduled timeout check, 0 if not scheduled
+    bool dirty;          ///< Suspect waits in queue of updated suspects
 } suspect_item_t;
 
 
 /**
- * \brief Key to whitelist/blacklist table.
+ * \brief Key to verdict table.
  */
 typedef struct {
     ip_addr_t ip;
@@ -157,6 +178,50 @@ typedef struct {
 } list_key_t;
 
 
+/**
+ * \brief Item of verdict table, server is either blacklisted or whitelisted.
+ */
+typedef struct {
+    uint32_t timestamp; ///< Time when server was classified, BWL_PERMANENT_RECORD for servers from files
+    uint8_t verdict;    ///< VERDICT_BLACKLIST or VERDICT_WHITELIST
+} list_item_t;
+
+
+/**
+ * \brief Fields of a flow used by the detector, copied out of the UniRec record
+ *        so that flows can be processed in batches.
+ */
+typedef struct {
+    ip_addr_t src_ip;
+    ip_addr_t dst_ip;
+    uint16_t src_port;
+    uint16_t dst_port;
+    uint8_t protocol;
+    uint8_t tcp_flags;
+    uint32_t packets;
+    uint64_t bytes;
+    uint32_t time_last;
+} flow_record_t;
+
+
+/**
+ * \brief Record of the input template as UniRec lays it out, used to read the
+ *        fields directly when the negotiated template matches (see ur_fixed.h).
+ */
+typedef struct __attribute__ ((__packed__)) {
+    ip_addr_t dst_ip;
+    ip_addr_t src_ip;
+    uint64_t bytes;
+    ur_time_t time_first;
+    ur_time_t time_last;
+    uint32_t packets;
+    uint16_t dst_port;
+    uint16_t src_port;
+    uint8_t protocol;
+    uint8_t tcp_flags;
+} input_record_t;
+
+
 /**
  * Structure containing information used for configurating.
  */
@@ -180,11 +245,19 @@ typedef struct __attribute__ ((__packed__)) {
     uint32_t blacklist_db_stash_size;
     uint32_t whitelist_db_size;
     uint32_t whitelist_db_stash_size;
+
+    uint32_t stratum_max_probes;
+    uint32_t stratum_dest_rate;
+    char list_store_file[256];
+    char cpu_affinity[256];
 } config_struct_t;
 
 
 
 bool miner_detector_initialization(config_struct_t*);
+bool miner_detector_input_fixed(const ur_template_t *);
+void miner_detector_read_flow(ur_template_t *, bool, const void *, flow_record_t *);
+void miner_detector_process_batch(const flow_record_t *, size_t);
 void miner_detector_process_data(ur_template_t *, const void *);
 
 
@@ -138,6 +138,26 @@ static char const *MODULE_CONFIG_PATTERN_STRING =
             "<type>uint32_t</type>"
             "<default-value>4</default-value>"
         "</element>"
+        "<element type=\"optional\">"
+            "<name>stratum_max_probes</name>"
+            "<type>uint32_t</type>"
+            "<default-value>64</default-value>"
+        "</element>"
+        "<element type=\"optional\">"
+            "<name>stratum_dest_rate</name>"
+            "<type>uint32_t</type>"
+            "<default-value>2</default-value>"
+        "</element>"
+        "<element type=\"optional\">"
+            "<name>list_store_file</name>"
+            "<type size=\"256\">string</type>"
+            "<default-value>-</default-value>"
+        "</element>"
+        "<element type=\"optional\">"
+            "<name>cpu_affinity</name>"
+            "<type size=\"256\">string</type>"
+            "<default-value>-</default-value>"
+        "</element>"
     "</struct>"
 "</configuration>";
 
@@ -0,0 +1,534 @@
+/**
+ * \file prober.cpp
+ * \brief Asynchronous stratum prober of suspicious mining pool servers.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "prober.h"
+#include "utils.h"
+#include "affinity.h"
+
+#include <algorithm>
+
+
+//#define DEBUG
+
+#ifdef DEBUG
+#define DEBUG_PRINT(...) do{ fprintf( stderr, "DEBUG: "  __VA_ARGS__ ); } while( false )
+#else
+#define DEBUG_PRINT(...) do{ } while ( false )
+#endif
+
+
+using namespace std;
+
+
+bool list_key_less::operator()(const list_key_t &a, const list_key_t &b) const
+{
+    int cmp = memcmp(&a.ip, &b.ip, sizeof(ip_addr_t));
+    return cmp < 0 || (cmp == 0 && a.port < b.port);
+}
+
+bool ip_addr_less::operator()(const ip_addr_t &a, const ip_addr_t &b) const
+{
+    return memcmp(&a, &b, sizeof(ip_addr_t)) < 0;
+}
+
+
+/**
+ * \brief Get monotonic time in milliseconds.
+ */
+static uint64_t prober_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+StratumProber::StratumProber()
+{
+    epoll_fd = -1;
+    wake_fd = -1;
+    running = false;
+    stop_flag = false;
+    max_probes = 0;
+    dest_interval = 0;
+    callback = NULL;
+    pthread_mutex_init(&mutex, NULL);
+}
+
+StratumProber::~StratumProber()
+{
+    stop();
+    pthread_mutex_destroy(&mutex);
+}
+
+
+/**
+ * \brief Create epoll instance and start prober thread.
+ * \param max_probes Maximum number of servers checked at the same time.
+ * \param dest_rate  Maximum number of new connections per second to one destination IP, 0 for unlimited.
+ * \param callback   Function called with result of every check.
+ * \return True on success, false otherwise.
+ */
+bool StratumProber::start(uint32_t max_probes, uint32_t dest_rate, prober_callback_t callback)
+{
+    struct epoll_event ev;
+
+    this->max_probes = max_probes > 0 ? max_probes : 1;
+    this->dest_interval = dest_rate > 0 ? 1000 / dest_rate : 0;
+    this->callback = callback;
+
+    if ((epoll_fd = epoll_create1(0)) < 0) {
+        fprintf(stderr, "Error: Could not create epoll instance: %s\n", strerror(errno));
+        return false;
+    }
+    if ((wake_fd = eventfd(0, EFD_NONBLOCK)) < 0) {
+        fprintf(stderr, "Error: Could not create eventfd: %s\n", strerror(errno));
+        close(epoll_fd);
+        epoll_fd = -1;
+        return false;
+    }
+
+    // Event without probe wakes up the thread after submit
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) < 0) {
+        fprintf(stderr, "Error: Could not add eventfd to epoll: %s\n", strerror(errno));
+        close(wake_fd);
+        close(epoll_fd);
+        wake_fd = epoll_fd = -1;
+        return false;
+    }
+
+    stop_flag = false;
+    if (affinity_thread_create(&thread_id, thread_main, this) != 0) {
+        fprintf(stderr, "Error: Could not create prober thread.\n");
+        close(wake_fd);
+        close(epoll_fd);
+        wake_fd = epoll_fd = -1;
+        return false;
+    }
+    running = true;
+
+    return true;
+}
+
+
+/**
+ * \brief Stop prober thread, checks in progress are dropped without calling the callback.
+ */
+void StratumProber::stop(void)
+{
+    if (running) {
+        uint64_t one = 1;
+
+        stop_flag = true;
+        if (write(wake_fd, &one, sizeof(one)) < 0) {
+            DEBUG_PRINT("Could not wake up prober thread\n");
+        }
+        pthread_join(thread_id, NULL);
+        running = false;
+    }
+
+    for (size_t i = 0; i < active.size(); i++) {
+        close_probe(active[i]);
+        delete active[i];
+    }
+    active.clear();
+
+    pthread_mutex_lock(&mutex);
+    for (size_t i = 0; i < waiting.size(); i++) {
+        delete waiting[i];
+    }
+    waiting.clear();
+    pending.clear();
+    pthread_mutex_unlock(&mutex);
+
+    if (wake_fd >= 0) {
+        close(wake_fd);
+        wake_fd = -1;
+    }
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+}
+
+
+/**
+ * \brief Queue server for stratum check, safe to call from any thread.
+ * \param pool    IP address and port of the server.
+ * \param suspect Suspect which triggered the check, passed to the callback.
+ * \return True if check of the server is queued or already in progress, false otherwise.
+ */
+bool StratumProber::submit(const list_key_t &pool, const suspect_item_key_t &suspect)
+{
+    uint64_t one = 1;
+
+    if (!running) {
+        return false;
+    }
+
+    pthread_mutex_lock(&mutex);
+    if (!pending.insert(pool).second) {
+        // Server is already being checked
+        pthread_mutex_unlock(&mutex);
+        return true;
+    }
+
+    probe_t *probe = new probe_t;
+    probe->pool = pool;
+    probe->suspect = suspect;
+    probe->probe = 0;
+    probe->fd = -1;
+    probe->connecting = false;
+    probe->deadline = 0;
+    waiting.push_back(probe);
+    pthread_mutex_unlock(&mutex);
+
+    if (write(wake_fd, &one, sizeof(one)) < 0) {
+        DEBUG_PRINT("Could not wake up prober thread\n");
+    }
+    return true;
+}
+
+
+void *StratumProber::thread_main(void *arg)
+{
+    ((StratumProber*) arg)->run();
+    return NULL;
+}
+
+
+/**
+ * \brief Main loop of prober thread.
+ */
+void StratumProber::run(void)
+{
+    struct epoll_event events[PROBER_MAX_EVENTS];
+
+    while (!stop_flag) {
+        uint64_t now = prober_now();
+        uint64_t wake_at = start_waiting(now);
+
+        // Sleep until the nearest timeout or rate limited start
+        for (size_t i = 0; i < active.size(); i++) {
+            if (active[i]->deadline < wake_at) {
+                wake_at = active[i]->deadline;
+            }
+        }
+        int wait = wake_at > now ? (int) (wake_at - now) : 0;
+
+        int n = epoll_wait(epoll_fd, events, PROBER_MAX_EVENTS, wait);
+        if (n < 0 && errno != EINTR) {
+            fprintf(stderr, "Error: epoll_wait failed in prober thread: %s\n", strerror(errno));
+            break;
+        }
+
+        now = prober_now();
+        for (int i = 0; i < n; i++) {
+            probe_t *probe = (probe_t*) events[i].data.ptr;
+            if (probe == NULL) {
+                uint64_t cnt;
+                if (read(wake_fd, &cnt, sizeof(cnt)) < 0) {
+                    DEBUG_PRINT("Could not read prober eventfd\n");
+                }
+                continue;
+            }
+            handle_event(probe, now);
+        }
+
+        expire_active(now);
+    }
+
+    DEBUG_PRINT("Terminating prober thread\n");
+}
+
+
+/**
+ * \brief Start connections of waiting checks while concurrency and per-destination
+ *        rate limits allow.
+ * \param now Current time [ms].
+ * \return Time [ms] when next rate limited check may start, or latest time to wake up.
+ */
+uint64_t StratumProber::start_waiting(uint64_t now)
+{
+    uint64_t wake_at = now + PROBER_MAX_WAIT;
+    vector<probe_t*> ready;
+
+    pthread_mutex_lock(&mutex);
+    size_t cnt = waiting.size();
+    while (cnt-- > 0 && active.size() + ready.size() < max_probes) {
+        probe_t *probe = waiting.front();
+        waiting.pop_front();
+
+        map<ip_addr_t, uint64_t, ip_addr_less>::iterator it = dest_next.find(probe->pool.ip);
+        if (it != dest_next.end() && it->second > now) {
+            // Rate limited, keep it in the queue
+            if (it->second < wake_at) {
+                wake_at = it->second;
+            }
+            waiting.push_back(probe);
+            continue;
+        }
+        if (dest_interval) {
+            dest_next[probe->pool.ip] = now + dest_interval;
+        }
+        ready.push_back(probe);
+    }
+    pthread_mutex_unlock(&mutex);
+
+    // Forget destinations which are not limited anymore
+    if (dest_next.size() > 2 * max_probes) {
+        map<ip_addr_t, uint64_t, ip_addr_less>::iterator it = dest_next.begin();
+        while (it != dest_next.end()) {
+            if (it->second <= now) {
+                dest_next.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < ready.size(); i++) {
+        start_probe(ready[i], now);
+    }
+
+    return wake_at;
+}
+
+
+/**
+ * \brief Open nonblocking connection for current probe of a check.
+ * \param probe Check to start.
+ * \param now   Current time [ms].
+ */
+void StratumProber::start_probe(probe_t *probe, uint64_t now)
+{
+    struct sockaddr_in serv_addr;
+    struct epoll_event ev;
+
+    active.push_back(probe);
+    probe->connecting = true;
+    probe->deadline = now + (uint64_t) stratum_get_timeout(STRATUM_CONN_TIMEOUT) * 1000;
+
+    if (!ip_is4(&probe->pool.ip)) {
+        // Stratum check connects only over IPv4
+        finish(probe, ERR_CONNECT, 0);
+        return;
+    }
+
+    if ((probe->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0) {
+        DEBUG_PRINT("Could not create socket\n");
+        finish(probe, ERR_SOCKET_CREATE, 0);
+        return;
+    }
+
+    // Clear and copy IP and port to server structure
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_addr.s_addr = probe->pool.ip.ui32[2];
+    serv_addr.sin_port = htons(probe->pool.port);
+
+    if (connect(probe->fd, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0 && errno != EINPROGRESS) {
+        DEBUG_PRINT("Connect error...\n");
+        finish(probe, ERR_CONNECT, 0);
+        return;
+    }
+
+    // Writability is reported also for connect finishing immediately
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLOUT;
+    ev.data.ptr = probe;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, probe->fd, &ev) < 0) {
+        finish(probe, ERR_SELECT, 0);
+    }
+}
+
+
+/**
+ * \brief Advance state of a check after epoll event on its socket.
+ * \param probe Check whose socket is ready.
+ * \param now   Current time [ms].
+ */
+void StratumProber::handle_event(probe_t *probe, uint64_t now)
+{
+    if (probe->connecting) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        const char *request = stratum_probe_request(probe->probe);
+        struct epoll_event ev;
+
+        if (getsockopt(probe->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+            DEBUG_PRINT("Connect error...\n");
+            finish(probe, ERR_CONNECT, 0);
+            return;
+        }
+
+        // Send data to server, request fits in the empty socket buffer
+        DEBUG_PRINT("Sending data to server: '%s'\n", request);
+        if (write(probe->fd, request, strlen(request)) < 0) {
+            DEBUG_PRINT("No data was written\n");
+            finish(probe, ERR_WRITE, 0);
+            return;
+        }
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = probe;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, probe->fd, &ev) < 0) {
+            finish(probe, ERR_SELECT, 0);
+            return;
+        }
+        probe->connecting = false;
+        probe->deadline = now + (uint64_t) stratum_get_timeout(STRATUM_READ_TIMEOUT) * 1000;
+    } else {
+        char buffer[256];
+        uint8_t pool_id;
+
+        ssize_t n = read(probe->fd, buffer, 255);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return;
+            }
+            DEBUG_PRINT("Read error: %s(%d)\n", strerror(errno), (int) n);
+            finish(probe, ERR_READ, 0);
+            return;
+        }
+        buffer[n] = 0;
+        DEBUG_PRINT("%s\n", buffer);
+
+        if (find_stratum_in_data(probe->probe, buffer, &pool_id) == STRATUM_MATCH) {
+            finish(probe, STRATUM_MATCH, pool_id);
+        } else if (probe->probe + 1 < stratum_probe_count()) {
+            next_probe(probe);
+        } else {
+            finish(probe, STRATUM_NO_MATCH, 0);
+        }
+    }
+}
+
+
+/**
+ * \brief Finish checks whose connect or read timed out.
+ * \param now Current time [ms].
+ */
+void StratumProber::expire_active(uint64_t now)
+{
+    size_t i = 0;
+    while (i < active.size()) {
+        probe_t *probe = active[i];
+        if (probe->deadline <= now) {
+            // finish() removes the check from active
+            finish(probe, probe->connecting ? ERR_CONNECT_TIMEOUT : ERR_READ_TIMEOUT, 0);
+            continue;
+        }
+        i++;
+    }
+}
+
+
+/**
+ * \brief Close connection of a check and queue its next probe, new connection
+ *        is subject to the same limits as a new check.
+ * \param probe Check to continue.
+ */
+void StratumProber::next_probe(probe_t *probe)
+{
+    close_probe(probe);
+    active.erase(find(active.begin(), active.end(), probe));
+    probe->probe++;
+
+    pthread_mutex_lock(&mutex);
+    waiting.push_front(probe);
+    pthread_mutex_unlock(&mutex);
+}
+
+
+/**
+ * \brief Finish a check and report its result.
+ * \param probe   Finished check.
+ * \param ret     Result of the check.
+ * \param pool_id ID of matched mining pool.
+ */
+void StratumProber::finish(probe_t *probe, int ret, uint8_t pool_id)
+{
+    close_probe(probe);
+    active.erase(find(active.begin(), active.end(), probe));
+
+    callback(probe->pool, probe->suspect, ret, pool_id);
+
+    pthread_mutex_lock(&mutex);
+    pending.erase(probe->pool);
+    pthread_mutex_unlock(&mutex);
+
+    delete probe;
+}
+
+
+/**
+ * \brief Close socket of a check.
+ * \param probe Check whose connection is closed.
+ */
+void StratumProber::close_probe(probe_t *probe)
+{
+    if (probe->fd >= 0) {
+        // Closing removes socket from epoll set
+        close(probe->fd);
+        probe->fd = -1;
+    }
+}
@@ -0,0 +1,153 @@
+/**
+ * \file prober.h
+ * \brief Asynchronous stratum prober of suspicious mining pool servers.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef PROBER_H
+#define PROBER_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <unirec/unirec.h>
+
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "miner_detector.h"
+
+
+/**
+ * Maximum number of epoll events processed in one iteration.
+ */
+#define PROBER_MAX_EVENTS 64
+
+/**
+ * Maximum time [ms] the prober thread waits for events before checking its queue and STOP.
+ */
+#define PROBER_MAX_WAIT 1000
+
+
+/**
+ * \brief Called by prober thread when check of a server is finished.
+ * \param pool    IP address and port of the checked server.
+ * \param suspect Suspect whose score triggered the check.
+ * \param ret     STRATUM_MATCH if server speaks stratum, STRATUM_NO_MATCH or error code otherwise.
+ * \param pool_id ID of matched mining pool, valid only on STRATUM_MATCH.
+ */
+typedef void (*prober_callback_t)(const list_key_t &pool, const suspect_item_key_t &suspect, int ret, uint8_t pool_id);
+
+
+/**
+ * \brief Comparison of blacklist/whitelist keys for ordered containers.
+ */
+struct list_key_less {
+    bool operator()(const list_key_t &a, const list_key_t &b) const;
+};
+
+/**
+ * \brief Comparison of IP addresses for ordered containers.
+ */
+struct ip_addr_less {
+    bool operator()(const ip_addr_t &a, const ip_addr_t &b) const;
+};
+
+
+/**
+ * \brief State of one server check, probes of all pools are sent over
+ *        separate connections one after another.
+ */
+typedef struct {
+    list_key_t pool;            ///< Checked server
+    suspect_item_key_t suspect; ///< Suspect which triggered the check
+    size_t probe;               ///< Index of currently sent probe
+    int fd;                     ///< Socket of current connection, -1 if not connected
+    bool connecting;            ///< Waiting for connect, otherwise waiting for reply
+    uint64_t deadline;          ///< Time [ms] when current connect or read times out
+} probe_t;
+
+
+/**
+ * Class checking servers for stratum protocol without blocking on any of them.
+ * Connections are driven by epoll in own thread, number of connections in progress
+ * and rate of new connections to one destination IP are limited.
+ */
+class StratumProber {
+    private:
+        int epoll_fd;
+        int wake_fd;
+        bool running;
+        volatile bool stop_flag;
+        pthread_t thread_id;
+        pthread_mutex_t mutex;
+
+        uint32_t max_probes;
+        uint64_t dest_interval;
+        prober_callback_t callback;
+
+        // Shared with submitting threads, guarded by mutex
+        std::deque<probe_t*> waiting;
+        std::set<list_key_t, list_key_less> pending;
+
+        // Used only by prober thread
+        std::vector<probe_t*> active;
+        std::map<ip_addr_t, uint64_t, ip_addr_less> dest_next;
+
+        static void *thread_main(void *arg);
+        void run(void);
+        uint64_t start_waiting(uint64_t now);
+        void start_probe(probe_t *probe, uint64_t now);
+        void handle_event(probe_t *probe, uint64_t now);
+        void expire_active(uint64_t now);
+        void next_probe(probe_t *probe);
+        void finish(probe_t *probe, int ret, uint8_t pool_id);
+        void close_probe(probe_t *probe);
+
+    public:
+        StratumProber();
+        ~StratumProber();
+        bool start(uint32_t max_probes, uint32_t dest_rate, prober_callback_t callback);
+        void stop(void);
+        bool submit(const list_key_t &pool, const suspect_item_key_t &suspect);
+};
+
+#endif
@@ -0,0 +1,127 @@
+/**
+ * \file suspect_queue.cpp
+ * \brief Lock-free queue of suspects updated by the flow processing thread.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdlib.h>
+
+#include "suspect_queue.h"
+
+
+SuspectQueue::SuspectQueue()
+{
+    ring = NULL;
+    mask = 0;
+    head = tail = 0;
+    overflow = 0;
+}
+
+SuspectQueue::~SuspectQueue()
+{
+    free(ring);
+}
+
+
+/**
+ * \brief Allocate the ring.
+ * \param size Number of keys held by the queue, must be power of two.
+ * \return True on success, false otherwise.
+ */
+bool SuspectQueue::init(uint32_t size)
+{
+    if (size == 0 || (size & (size - 1)) != 0) {
+        return false;
+    }
+    if ((ring = (suspect_item_key_t*) malloc(size * sizeof(suspect_item_key_t))) == NULL) {
+        return false;
+    }
+    mask = size - 1;
+    head = tail = 0;
+    overflow = 0;
+    return true;
+}
+
+
+/**
+ * \brief Add key to the queue, called only by producer.
+ * \param key Key of updated suspect.
+ * \return True on success, false if the queue is full.
+ */
+bool SuspectQueue::push(const suspect_item_key_t &key)
+{
+    uint32_t t = tail;
+
+    if (t - __atomic_load_n(&head, __ATOMIC_ACQUIRE) > mask) {
+        __atomic_store_n(&overflow, 1, __ATOMIC_RELEASE);
+        return false;
+    }
+    ring[t & mask] = key;
+    __atomic_store_n(&tail, t + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+
+/**
+ * \brief Remove key from the queue, called only by consumer.
+ * \param key Removed key is stored here.
+ * \return True on success, false if the queue is empty.
+ */
+bool SuspectQueue::pop(suspect_item_key_t &key)
+{
+    uint32_t h = head;
+
+    if (h == __atomic_load_n(&tail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    key = ring[h & mask];
+    __atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+
+/**
+ * \brief Check and clear overflow, called only by consumer.
+ * \return True if some key was dropped since the last call.
+ */
+bool SuspectQueue::overflowed(void)
+{
+    return __atomic_exchange_n(&overflow, 0, __ATOMIC_ACQ_REL) != 0;
+}
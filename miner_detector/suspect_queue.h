@@ -0,0 +1,81 @@
+/**
+ * \file suspect_queue.h
+ * \brief Lock-free queue of suspects updated by the flow processing thread.
+ * \date 2026
+ */
+
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef SUSPECT_QUEUE_H
+#define SUSPECT_QUEUE_H
+
+#include <stdint.h>
+#include <unirec/unirec.h>
+
+#include "miner_detector.h"
+
+
+/**
+ * Number of suspect keys held by the queue, must be power of two.
+ */
+#define SUSPECT_QUEUE_SIZE 65536
+
+
+/**
+ * Single producer, single consumer ring of suspect keys. Producer is the thread
+ * processing flows, consumer is the check thread. When the ring is full, the key
+ * is dropped and overflow is reported to the consumer instead.
+ */
+class SuspectQueue {
+    private:
+        suspect_item_key_t *ring;
+        uint32_t mask;
+        volatile uint32_t head; ///< Next slot to be read, written by consumer
+        volatile uint32_t tail; ///< Next slot to be written, written by producer
+        volatile uint32_t overflow;
+
+    public:
+        SuspectQueue();
+        ~SuspectQueue();
+        bool init(uint32_t size);
+        bool push(const suspect_item_key_t &key);
+        bool pop(suspect_item_key_t &key);
+        bool overflowed(void);
+};
+
+#endif
@@ -58,6 +58,36 @@ const char *MINER_POOL_ZCASH_STR2 = "{\"id\": 1, \"method\": \"mining.subscribe\
 */
 
 
+/**
+ * \brief Stratum probe of one mining pool type, request sent to server
+ *        and pattern of its reply.
+ */
+typedef struct {
+    uint8_t pool_id;
+    const char **request;
+    const char *pattern;
+} stratum_probe_t;
+
+/**
+ * Probes in order in which they are sent to checked server.
+ */
+static const stratum_probe_t STRATUM_PROBES[] = {
+    {STRATUM_MPOOL_BITCOIN,  &MINER_POOL_BITCOIN_STR,  "mining.notify"},
+    {STRATUM_MPOOL_MONERO,   &MINER_POOL_MONERO_STR,   ".*blob.*job_id.*target.*"},
+    {STRATUM_MPOOL_ETHEREUM, &MINER_POOL_ETHEREUM_STR, "jsonrpc.*result\":[ \t]*true"},
+    {STRATUM_MPOOL_ZCASH,    &MINER_POOL_ZCASH_STR,    "mining.set_target"}
+};
+
+#define STRATUM_PROBES_COUNT (sizeof(STRATUM_PROBES) / sizeof(STRATUM_PROBES[0]))
+
+/**
+ * Patterns of the probes, compiled once by stratum_init() and only read by check threads.
+ */
+static regex_t STRATUM_PROBES_PREG[STRATUM_PROBES_COUNT];
+
+static bool STRATUM_PROBES_COMPILED = false;
+
+
 /*
  * Default values for timeouts in seconds
  */
@@ -226,35 +256,95 @@ int get_data(char *ip, int port, const char *data_out, char **data_in)
 
 
 /**
- * \brief Check using regex for stratum protocol in specified data.
- * \param re_str Regular expression to find in data.
- * \param data Data to be checked for stratum protocol.
- * \return 1 on successfull match, 0 otherwise.
+ * \brief Compile patterns of all stratum probes, must be called before
+ *        the first stratum_check_server().
+ * \return True on success, false otherwise.
  */
-int find_stratum_in_data(const char *re_str, char *data)
+bool stratum_init(void)
 {
-    const char *regex_str = re_str;
-    regex_t preg;
-    int res;
-
-    // Compile regular expression
-    if ((res = regcomp(&preg, regex_str, REG_NOSUB)) != 0) {
-        char reg_err_buf[100];
-        regerror(res, &preg, reg_err_buf, 99);
-        fprintf(stderr, "Error: %s\n", reg_err_buf);
-        return ERR_REGEX;
+    if (STRATUM_PROBES_COMPILED) {
+        return true;
+    }
+
+    for (size_t i = 0; i < STRATUM_PROBES_COUNT; i++) {
+        int res;
+        if ((res = regcomp(&STRATUM_PROBES_PREG[i], STRATUM_PROBES[i].pattern, REG_NOSUB)) != 0) {
+            char reg_err_buf[100];
+            regerror(res, &STRATUM_PROBES_PREG[i], reg_err_buf, 99);
+            fprintf(stderr, "Error: %s\n", reg_err_buf);
+            while (i-- > 0) {
+                regfree(&STRATUM_PROBES_PREG[i]);
+            }
+            return false;
+        }
     }
 
-    // Check regex
-    if (regexec(&preg, data, 0, NULL, 0) != REG_NOMATCH) {
-        // Pattern was found
-	DEBUG_PRINT("stratum detected\n");
-        return STRATUM_MATCH;
-    } else {
-        // Pattern was not found
-	DEBUG_PRINT("stratum NOT detected\n");
-        return STRATUM_NO_MATCH;
+    STRATUM_PROBES_COMPILED = true;
+    return true;
+}
+
+
+/**
+ * \brief Free compiled patterns of stratum probes.
+ */
+void stratum_free(void)
+{
+    if (!STRATUM_PROBES_COMPILED) {
+        return;
+    }
+
+    for (size_t i = 0; i < STRATUM_PROBES_COUNT; i++) {
+        regfree(&STRATUM_PROBES_PREG[i]);
+    }
+    STRATUM_PROBES_COMPILED = false;
+}
+
+
+/**
+ * \brief Get number of stratum probes sent to checked server.
+ * \return Number of probes.
+ */
+size_t stratum_probe_count(void)
+{
+    return STRATUM_PROBES_COUNT;
+}
+
+
+/**
+ * \brief Get request of stratum probe.
+ * \param probe Index of probe.
+ * \return Request to be sent to checked server.
+ */
+const char *stratum_probe_request(size_t probe)
+{
+    return *STRATUM_PROBES[probe].request;
+}
+
+
+/**
+ * \brief Check data for patterns of all mining pools, starting with the pool
+ *        whose probe was sent.
+ * \param probe Index of probe the data is reply to.
+ * \param data Data to be checked for stratum protocol.
+ * \param pool_id ID of matched mining pool will be stored here.
+ * \return STRATUM_MATCH on successfull match, STRATUM_NO_MATCH otherwise.
+ */
+int find_stratum_in_data(size_t probe, const char *data, uint8_t *pool_id)
+{
+    for (size_t i = 0; i < STRATUM_PROBES_COUNT; i++) {
+        size_t j = (probe + i) % STRATUM_PROBES_COUNT;
+
+        if (regexec(&STRATUM_PROBES_PREG[j], data, 0, NULL, 0) != REG_NOMATCH) {
+            // Pattern was found
+            DEBUG_PRINT("stratum detected\n");
+            *pool_id = STRATUM_PROBES[j].pool_id;
+            return STRATUM_MATCH;
+        }
     }
+
+    // Pattern was not found
+    DEBUG_PRINT("stratum NOT detected\n");
+    return STRATUM_NO_MATCH;
 }
 
 
@@ -269,62 +359,25 @@ int find_stratum_in_data(const char *re_str, char *data)
 int stratum_check_server(char *ip, uint16_t port, uint8_t *pool_id)
 {
     char *data_in = NULL;
-    int ret;
+    int ret = STRATUM_NO_MATCH;
 
-    // TEST FOR BITCOIN
-    if ((ret = get_data(ip, port, MINER_POOL_BITCOIN_STR, &data_in)) == DATA_OK) {
-        ret = find_stratum_in_data("mining.notify", data_in);
-        free(data_in);
+    if (!STRATUM_PROBES_COMPILED) {
+        return ERR_REGEX;
+    }
 
-        if (ret == STRATUM_MATCH) {
-            DEBUG_PRINT("BITCOIN\n");
-            *pool_id = STRATUM_MPOOL_BITCOIN;
+    // Send probes of mining pools until one of them is answered by a stratum reply
+    for (size_t i = 0; i < STRATUM_PROBES_COUNT; i++) {
+        if ((ret = get_data(ip, port, *STRATUM_PROBES[i].request, &data_in)) != DATA_OK) {
             return ret;
         }
 
-        // TEST FOR MONERO
-        if ((ret = get_data(ip, port, MINER_POOL_MONERO_STR, &data_in)) == DATA_OK) {
-            ret = find_stratum_in_data(".*blob.*job_id.*target.*", data_in);
-            free(data_in);
-
-            if (ret == STRATUM_MATCH) {
-                DEBUG_PRINT("MONERO\n");
-                *pool_id = STRATUM_MPOOL_MONERO;
-                return ret;
-            }
+        ret = find_stratum_in_data(i, data_in, pool_id);
+        free(data_in);
 
-            // TEST FOR ETHEREUM
-            if ((ret = get_data(ip, port, MINER_POOL_ETHEREUM_STR, &data_in)) == DATA_OK) {
-                ret = find_stratum_in_data("jsonrpc.*result\":[ \t]*true", data_in);
-                free(data_in);
-
-                if (ret == STRATUM_MATCH) {
-                    DEBUG_PRINT("ETHEREUM\n");
-                    *pool_id = STRATUM_MPOOL_ETHEREUM;
-                    return ret;
-                }
-
-                // TEST FOR ZCASH
-                if ((ret = get_data(ip, port, MINER_POOL_ZCASH_STR, &data_in)) == DATA_OK) {
-                    ret = find_stratum_in_data("mining.set_target", data_in);
-                    free(data_in);
-
-                    if (ret == STRATUM_MATCH) {
-                        DEBUG_PRINT("ZCASH\n");
-                        *pool_id = STRATUM_MPOOL_ZCASH;
-                        return ret;
-                    }
-                } else {
-                    return ret;
-                }
-            } else {
-                return ret;
-            }
-        } else {
+        if (ret == STRATUM_MATCH) {
+            DEBUG_PRINT("%s\n", stratum_mpool_string(*pool_id));
             return ret;
         }
-    } else {
-        return ret;
     }
 
     return ret;
@@ -348,6 +401,22 @@ void stratum_set_timeout(int type, int timeout)
 }
 
 
+/**
+ * \brief Get timeout of stratum protocol checker.
+ * \param type Type of timeout to get.
+ * \return Value of timeout in seconds.
+ */
+int stratum_get_timeout(int type)
+{
+    switch (type) {
+        case STRATUM_CONN_TIMEOUT: return CONNECTION_TIMEOUT;
+        case STRATUM_READ_TIMEOUT: return READ_TIMEOUT;
+        default: fprintf(stderr, "Stratum checker: Unknown timeout type '%d'\n", type);
+                 return 0;
+    }
+}
+
+
 /**
  * \brief USED ONLY FOR TESTING PURPOSES. Function convert error code
  *        to brief error message.
@@ -47,8 +47,14 @@ enum miner_pool_ids {
 };
 
 suspect_item_key_t create_suspect_key(ip_addr_t& suspect, ip_addr_t& pool, uint16_t port);
+bool stratum_init(void);
+void stratum_free(void);
 int stratum_check_server(char *ip, uint16_t port, uint8_t *pool_id);
+size_t stratum_probe_count(void);
+const char *stratum_probe_request(size_t probe);
+int find_stratum_in_data(size_t probe, const char *data, uint8_t *pool_id);
 void stratum_set_timeout(int type, int timeout);
+int stratum_get_timeout(int type);
 const char *stratum_error_string(int err);
 const char *stratum_mpool_string(uint8_t id);
 #endif
@@ -0,0 +1,545 @@
+#!/usr/bin/python3
+#
+# Replay of trapcap files (or of a synthetic flow stream) into a detector.
+# The module reads the flows from a file interface at maximum rate, its run
+# time, CPU time and peak RSS are measured and the alerts written to its
+# output interfaces can be compared with golden CSV files.
+#
+# Copyright (C) 2026 CESNET
+#
+# LICENSE TERMS
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in
+#    the documentation and/or other materials provided with the
+#    distribution.
+# 3. Neither the name of the Company nor the names of its contributors
+#    may be used to endorse or promote products derived from this
+#    software without specific prior written permission.
+#
+# ALTERNATIVELY, provided that this notice is retained in full, this
+# product may be distributed under the terms of the GNU General Public
+# License (GPL) version 2 or later, in which case the provisions
+# of the GPL apply INSTEAD OF those given above.
+#
+# This software is provided ``as is'', and any express or implied
+# warranties, including, but not limited to, the implied warranties of
+# merchantability and fitness for a particular purpose are disclaimed.
+# In no event shall the company or contributors be liable for any
+# direct, indirect, incidental, special, exemplary, or consequential
+# damages (including, but not limited to, procurement of substitute
+# goods or services; loss of use, data, or profits; or business
+# interruption) however caused and on any theory of liability, whether
+# in contract, strict liability, or tort (including negligence or
+# otherwise) arising in any way out of the use of this software, even
+# if advised of the possibility of such damage.
+#
+
+import argparse
+import csv
+import datetime
+import ipaddress
+import os
+import random
+import resource
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+# Data format of UniRec records in the trapcap header
+TRAP_FMT_UNIREC = 2
+# Maximal size of a buffer written to a trapcap file
+MAX_BUFFER_SIZE = 65000
+
+# Sizes of the UniRec types with fixed length, all other types are dynamic
+UR_TYPE_SIZES = {
+    "char": 1, "int8": 1, "uint8": 1,
+    "int16": 2, "uint16": 2,
+    "int32": 4, "uint32": 4, "float": 4,
+    "int64": 8, "uint64": 8, "double": 8, "time": 8,
+    "macaddr": 6, "ipaddr": 16,
+}
+UR_INT_FORMATS = {
+    "int8": "b", "uint8": "B", "int16": "h", "uint16": "H",
+    "int32": "i", "uint32": "I", "int64": "q", "uint64": "Q",
+    "float": "f", "double": "d",
+}
+
+# Template of the synthetic flow stream (in the order of the UniRec record)
+SYNTHETIC_SPEC = "ipaddr DST_IP,ipaddr SRC_IP,uint64 BYTES,time TIME_FIRST," \
+                 "time TIME_LAST,uint32 PACKETS,uint16 DST_PORT," \
+                 "uint16 SRC_PORT,uint8 PROTOCOL,uint8 TCP_FLAGS"
+SYNTHETIC_START = 1455131180 # 2016-02-10T19:06:20, as in testdata of vportscan_detector
+SYNTHETIC_VSCANNERS = 10 # Sources scanning 60 ports of one destination
+SYNTHETIC_VSCAN_PORTS = 60
+SYNTHETIC_HSCANNERS = 2 # Sources scanning port 22 of 100 destinations
+SYNTHETIC_HSCAN_ADDRS = 100
+SYNTHETIC_AMPLIF_PORTS = (53, 123, 19) # Ports of the amplification attacks, 2 attacks per port
+SYNTHETIC_AMPLIF_STEP = 20 # Milliseconds between flows of the amplification stream
+SYNTHETIC_BRUTE_PORTS = (22, 3389) # Services of the brute force attackers (SSH, RDP), 8 attackers per service
+SYNTHETIC_BRUTE_ATTACKERS = 8
+SYNTHETIC_BRUTE_STEP = 10 # Milliseconds between flows of the brute force stream
+
+
+class Template:
+    """Layout of UniRec records given by the specifier of the template."""
+
+    def __init__(self, spec):
+        self.spec = spec
+        self.fields = [] # (type, name, offset) of fixed length fields or (type, name, None)
+        offset = 0
+        dynamic = []
+        for field in spec.split(","):
+            ur_type, name = field.strip().split(" ")
+            if ur_type in UR_TYPE_SIZES:
+                self.fields.append([ur_type, name, offset])
+                offset += UR_TYPE_SIZES[ur_type]
+            else:
+                dynamic.append([ur_type, name, None])
+        # Dynamic fields have 4B headers (offset and length) behind the fixed length fields
+        for field in dynamic:
+            field[2] = offset
+            offset += 4
+        self.fields += dynamic
+        self.fixlen = offset
+        self.index = dict((f[1], i) for i, f in enumerate(self.fields))
+
+    def header(self):
+        return [f[0] + " " + f[1] for f in self.fields]
+
+    def values(self, rec):
+        """Returns fields of a record converted to strings (as printed by the logger)."""
+        return [format_value(ur_type, field_data(rec, ur_type, offset, self.fixlen))
+                for ur_type, _, offset in self.fields]
+
+
+def field_data(rec, ur_type, offset, fixlen):
+    if ur_type in UR_TYPE_SIZES:
+        return rec[offset:offset + UR_TYPE_SIZES[ur_type]]
+    var_offset, var_len = struct.unpack_from("<HH", rec, offset)
+    return rec[fixlen + var_offset:fixlen + var_offset + var_len]
+
+
+def format_time(data):
+    (value,) = struct.unpack("<Q", data)
+    sec = value >> 32
+    msec = min(999, ((value & 0xffffffff) * 1000 + 0x80000000) >> 32)
+    stamp = datetime.datetime.fromtimestamp(sec, datetime.timezone.utc)
+    return stamp.strftime("%Y-%m-%dT%H:%M:%S") + ".%03d" % msec
+
+
+def format_ip(data):
+    if data[:8] == bytes(8) and data[12:] == b"\xff\xff\xff\xff":
+        return str(ipaddress.IPv4Address(data[8:12]))
+    return str(ipaddress.IPv6Address(data))
+
+
+def format_value(ur_type, data):
+    if ur_type == "ipaddr":
+        return format_ip(data)
+    if ur_type == "time":
+        return format_time(data)
+    if ur_type == "macaddr":
+        return ":".join("%02x" % b for b in data)
+    if ur_type == "char":
+        return data.decode("latin-1")
+    if ur_type == "string":
+        return '"' + data.decode("utf-8", "replace") + '"'
+    if ur_type in UR_INT_FORMATS:
+        (value,) = struct.unpack("<" + UR_INT_FORMATS[ur_type], data)
+        return ("%g" % value) if ur_type in ("float", "double") else str(value)
+    return data.hex()
+
+
+def pack_time(sec, msec):
+    return (sec << 32) | ((msec << 32) // 1000)
+
+
+def pack_ip4(addr):
+    return bytes(8) + ipaddress.IPv4Address(addr).packed + b"\xff\xff\xff\xff"
+
+
+def read_trapcap(path):
+    """Reads a trapcap file, returns the template specifier and the list of records."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) == 0:
+        return None, []
+    if len(data) < 8 or data[0] != TRAP_FMT_UNIREC:
+        raise ValueError("%s: not a trapcap file with UniRec records" % path)
+    (spec_len,) = struct.unpack_from(">I", data, 4)
+    spec = data[8:8 + spec_len].decode("ascii").rstrip("\0")
+    records = []
+    pos = 8 + spec_len
+    while pos + 4 <= len(data):
+        (buf_size,) = struct.unpack_from(">I", data, pos)
+        pos += 4
+        end = pos + buf_size
+        while pos + 2 <= end:
+            (rec_size,) = struct.unpack_from(">H", data, pos)
+            pos += 2
+            if rec_size > 1: # Records of 1 byte mark the end of data
+                records.append(data[pos:pos + rec_size])
+            pos += rec_size
+        pos = end
+    return spec, records
+
+
+def write_trapcap(path, spec, records):
+    """Writes records to a trapcap file terminated by the end of data record."""
+    spec_data = spec.encode("ascii")
+    with open(path, "wb") as f:
+        f.write(struct.pack(">B3xI", TRAP_FMT_UNIREC, len(spec_data)) + spec_data)
+        buf = []
+        buf_size = 0
+        for rec in records + [b"\0"]:
+            if buf_size + len(rec) + 2 > MAX_BUFFER_SIZE:
+                f.write(struct.pack(">I", buf_size) + b"".join(buf))
+                buf = []
+                buf_size = 0
+            buf.append(struct.pack(">H", len(rec)) + rec)
+            buf_size += len(rec) + 2
+        f.write(struct.pack(">I", buf_size) + b"".join(buf))
+
+
+def synthetic_flow(ms, src, dst, sport, dport, proto, flags, packets, nbytes, duration=0):
+    t_first = pack_time(SYNTHETIC_START + ms // 1000, ms % 1000)
+    t_last = pack_time(SYNTHETIC_START + (ms + duration) // 1000, (ms + duration) % 1000)
+    return pack_ip4(dst) + pack_ip4(src) + \
+        struct.pack("<QQQIHHBB", nbytes, t_first, t_last, packets, dport, sport, proto, flags)
+
+
+def generate_flows(count, seed=1):
+    """Generates a stream of count flows (one per millisecond) with vertical and horizontal scans.
+
+    The background traffic consists of TCP connections with full handshake and
+    of UDP flows, none of them looks like a scan. Every vertical scanner probes
+    60 ports of one destination by SYN flows and every horizontal scanner
+    probes port 22 of 100 destinations, the probes are evenly spread over the
+    whole stream. The stream is deterministic for the given count and seed."""
+    rnd = random.Random(seed)
+    scanners = []
+    for i in range(SYNTHETIC_VSCANNERS):
+        scanners.append([("10.0.0.%d" % (i + 1), "192.168.1.%d" % (i + 1), 1000 + j)
+                         for j in range(SYNTHETIC_VSCAN_PORTS)])
+    for i in range(SYNTHETIC_HSCANNERS):
+        scanners.append([("10.0.1.%d" % (i + 1), "192.168.2.%d" % (j + 1), 22)
+                         for j in range(SYNTHETIC_HSCAN_ADDRS)])
+    # Interleave the probes of all scanners
+    probes = [s[k] for k in range(max(len(s) for s in scanners)) for s in scanners if k < len(s)]
+    step = max(1, count // max(1, len(probes)))
+    flows = []
+    for ms in range(count):
+        if ms % step == 0 and ms // step < len(probes):
+            src, dst, dport = probes[ms // step]
+            flows.append(synthetic_flow(ms, src, dst, 40000 + ms % 20000, dport, 6, 0x02, 1, 44))
+        elif rnd.random() < 0.8:
+            packets = rnd.randint(5, 200)
+            flows.append(synthetic_flow(ms, "172.16.%d.%d" % (rnd.randint(0, 255), rnd.randint(1, 254)),
+                                        "172.17.%d.%d" % (rnd.randint(0, 255), rnd.randint(1, 254)),
+                                        rnd.randint(1024, 65535), rnd.choice((80, 443, 22, 25)), 6, 0x1b,
+                                        packets, packets * rnd.randint(60, 1500), rnd.randint(0, 5000)))
+        else:
+            packets = rnd.randint(1, 10)
+            flows.append(synthetic_flow(ms, "172.16.%d.%d" % (rnd.randint(0, 255), rnd.randint(1, 254)),
+                                        "172.17.%d.%d" % (rnd.randint(0, 255), rnd.randint(1, 254)),
+                                        rnd.randint(1024, 65535), rnd.choice((53, 123, 443)), 17, 0,
+                                        packets, packets * rnd.randint(60, 512), rnd.randint(0, 1000)))
+    return SYNTHETIC_SPEC, flows
+
+
+def generate_amplification(count, seed=1):
+    """Generates a stream of count flows (one per 20 ms) with amplification attacks.
+
+    Every port of SYNTHETIC_AMPLIF_PORTS is attacked twice, each attack lasts
+    a fifth of the stream: one reflector sends 8 responses of about 3000 bytes
+    per second to the victim and receives a small query from the victim every
+    3 seconds. The other flows are short UDP query/response pairs on the same
+    ports and TCP connections, one side of them always uses a port above 1023.
+    The stream is deterministic for the given count and seed."""
+    rnd = random.Random(seed)
+    duration = count * SYNTHETIC_AMPLIF_STEP
+    events = []
+    for p, port in enumerate(SYNTHETIC_AMPLIF_PORTS):
+        for a in range(2):
+            attack = 2 * p + a
+            reflector = "10.0.3.%d" % (attack + 1)
+            victim = "192.168.3.%d" % (attack + 1)
+            start = (attack * duration) // (2 * len(SYNTHETIC_AMPLIF_PORTS) + 2)
+            for ms in range(start, start + duration // 5, 125):
+                events.append((ms, synthetic_flow(ms, reflector, victim, port, 30000 + attack, 17, 0,
+                                                  3, 3000 + rnd.randint(0, 7), rnd.randint(0, 500))))
+            for ms in range(start, start + duration // 5, 3000):
+                events.append((ms, synthetic_flow(ms, victim, reflector, 30000 + attack, port, 17, 0,
+                                                  1, 60 + rnd.randint(0, 7))))
+    for _ in range(max(0, count - len(events))):
+        ms = rnd.randrange(duration)
+        client = "172.16.%d.%d" % (rnd.randint(0, 255), rnd.randint(1, 254))
+        server = "172.17.%d.%d" % (rnd.randint(0, 255), rnd.randint(1, 254))
+        sport = rnd.randint(1024, 65535)
+        if rnd.random() < 0.5:
+            port = rnd.choice(SYNTHETIC_AMPLIF_PORTS)
+            if rnd.random() < 0.5:
+                events.append((ms, synthetic_flow(ms, client, server, sport, port, 17, 0, 1, rnd.randint(60, 120))))
+            else:
+                events.append((ms, synthetic_flow(ms, server, client, port, sport, 17, 0,
+                                                  1, rnd.randint(80, 500))))
+        else:
+            packets = rnd.randint(5, 200)
+            events.append((ms, synthetic_flow(ms, client, server, sport, rnd.choice((80, 443, 22, 25)), 6, 0x1b,
+                                              packets, packets * rnd.randint(60, 1500), rnd.randint(0, 5000))))
+    events.sort(key=lambda e: e[0])
+    return SYNTHETIC_SPEC, [flow for _, flow in events]
+
+
+def generate_brute_force(count, seed=1):
+    """Generates a stream of count flows (one per 10 ms) with SSH and RDP login attempts.
+
+    Every service of SYNTHETIC_BRUTE_PORTS is attacked by 8 attackers, each of
+    them tries to log in to 4 victims about once per second: half of them during
+    the whole stream, the others during a third of it. Every fourth attempt is
+    also seen as the response of the victim. The other flows are TCP connections
+    to the same and other services with the sizes of ordinary sessions. The
+    stream is deterministic for the given count and seed."""
+    rnd = random.Random(seed)
+    duration = count * SYNTHETIC_BRUTE_STEP
+    events = []
+    for p, port in enumerate(SYNTHETIC_BRUTE_PORTS):
+        for a in range(SYNTHETIC_BRUTE_ATTACKERS):
+            attacker = "10.0.4.%d" % (p * SYNTHETIC_BRUTE_ATTACKERS + a + 1)
+            start = 0 if a % 2 == 0 else (a * duration) // (3 * SYNTHETIC_BRUTE_ATTACKERS)
+            end = duration if a % 2 == 0 else start + duration // 3
+            for n, ms in enumerate(range(start + rnd.randrange(1000), end, 1000)):
+                victim = "192.168.4.%d" % (4 * a + n % 4 + 1)
+                sport = 30000 + rnd.randint(0, 20000)
+                if port == 22:
+                    packets, nbytes = rnd.randint(11, 30), rnd.randint(1000, 5000)
+                else:
+                    packets, nbytes = rnd.randint(20, 100), rnd.randint(2200, 8000)
+                events.append((ms, synthetic_flow(ms, attacker, victim, sport, port, 6, 0x1b,
+                                                  packets, nbytes, rnd.randint(0, 900))))
+                if n % 4 == 0:
+                    events.append((ms, synthetic_flow(ms, victim, attacker, port, sport, 6, 0x1b,
+                                                      packets, nbytes, rnd.randint(0, 900))))
+    for _ in range(max(0, count - len(events))):
+        ms = rnd.randrange(duration)
+        packets = rnd.randint(5, 200)
+        events.append((ms, synthetic_flow(ms, "172.16.%d.%d" % (rnd.randint(0, 255), rnd.randint(1, 254)),
+                                          "172.17.%d.%d" % (rnd.randint(0, 255), rnd.randint(1, 254)),
+                                          rnd.randint(1024, 65535), rnd.choice((80, 443, 25) + SYNTHETIC_BRUTE_PORTS),
+                                          6, 0x1b, packets, packets * rnd.randint(60, 1500), rnd.randint(0, 5000))))
+    events.sort(key=lambda e: e[0])
+    return SYNTHETIC_SPEC, [flow for _, flow in events]
+
+
+def scale_records(tmplt, records, scale):
+    """Repeats the records scale times, every copy is shifted behind the previous one in time."""
+    times = [offset for ur_type, _, offset in tmplt.fields if ur_type == "time"]
+    if scale <= 1 or not records or not times:
+        return records * max(1, scale)
+    first = min(struct.unpack_from("<Q", rec, times[0])[0] for rec in records) >> 32
+    last = max(struct.unpack_from("<Q", rec, off)[0] for rec in records for off in times) >> 32
+    span = (last - first + 1) << 32
+    scaled = []
+    for copy in range(scale):
+        for rec in records:
+            rec = bytearray(rec)
+            for off in times:
+                (value,) = struct.unpack_from("<Q", rec, off)
+                struct.pack_into("<Q", rec, off, value + copy * span)
+            scaled.append(bytes(rec))
+    return scaled
+
+
+def percentile(values, p):
+    values = sorted(values)
+    k = (len(values) - 1) * p / 100.0
+    lo = int(k)
+    hi = min(lo + 1, len(values) - 1)
+    return values[lo] + (values[hi] - values[lo]) * (k - lo)
+
+
+def run_module(cmd, in_path, out_paths):
+    """Runs the module once, returns its wall time, CPU time, peak RSS (kB) and exit code."""
+    ifc = ",".join(["f:" + in_path] + ["f:" + p for p in out_paths])
+    for p in out_paths:
+        if os.path.exists(p):
+            os.remove(p)
+    start = time.monotonic()
+    proc = subprocess.Popen([cmd[0], "-i", ifc] + cmd[1:], stdout=subprocess.DEVNULL)
+    _, status, usage = os.wait4(proc.pid, 0)
+    wall = time.monotonic() - start
+    proc.returncode = os.waitstatus_to_exitcode(status) if hasattr(os, "waitstatus_to_exitcode") else status
+    return wall, usage.ru_utime + usage.ru_stime, usage.ru_maxrss, proc.returncode
+
+
+def output_rows(path):
+    if not os.path.exists(path):
+        return None, []
+    spec, records = read_trapcap(path)
+    if spec is None:
+        return None, []
+    tmplt = Template(spec)
+    return tmplt.header(), [tmplt.values(rec) for rec in records]
+
+
+def read_golden(path):
+    with open(path, newline="") as f:
+        rows = list(csv.reader(f))
+    if not rows:
+        return None, []
+    return rows[0], rows[1:]
+
+
+def compare_rows(header, rows, golden_header, golden_rows, ignore_fields, ignore_order):
+    """Returns a list of differences (empty when the output matches the golden file)."""
+    if not rows and not golden_rows:
+        return []
+    if header is not None and golden_header is not None and header != golden_header:
+        return ["template differs: %s != %s" % (",".join(header), ",".join(golden_header))]
+    names = [h.split(" ")[-1] for h in (header or golden_header)]
+    keep = [i for i, name in enumerate(names) if name not in ignore_fields]
+    rows = [[r[i] for i in keep] for r in rows]
+    golden_rows = [[r[i] for i in keep] for r in golden_rows]
+    if ignore_order:
+        rows.sort()
+        golden_rows.sort()
+    diffs = []
+    for i in range(max(len(rows), len(golden_rows))):
+        got = ",".join(rows[i]) if i < len(rows) else "<missing>"
+        exp = ",".join(golden_rows[i]) if i < len(golden_rows) else "<missing>"
+        if got != exp:
+            diffs.append("record %d: got %s, expected %s" % (i + 1, got, exp))
+    return diffs
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Replays a trapcap file (or a synthetic flow stream) into a module at maximum rate, "
+                    "measures its throughput and resources and compares its alerts with golden CSV files.",
+        usage="%(prog)s [options] -- MODULE [MODULE_ARGS...]")
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("-r", "--read", metavar="FILE", help="Input trapcap file.")
+    source.add_argument("-g", "--generate", metavar="COUNT", type=int,
+                        help="Generate a synthetic stream of COUNT flows with vertical and horizontal scans.")
+    source.add_argument("-a", "--amplification", metavar="COUNT", type=int,
+                        help="Generate a synthetic stream of COUNT flows with amplification attacks.")
+    source.add_argument("-b", "--brute-force", metavar="COUNT", type=int,
+                        help="Generate a synthetic stream of COUNT flows with SSH and RDP brute force attacks.")
+    parser.add_argument("-s", "--scale", metavar="K", type=int, default=1,
+                        help="Repeat the input K times, shifted in time (default: 1).")
+    parser.add_argument("-n", "--runs", metavar="N", type=int, default=5,
+                        help="Number of runs of the module (default: 5).")
+    parser.add_argument("-o", "--outputs", metavar="N", type=int, default=1,
+                        help="Number of output interfaces of the module (default: 1).")
+    parser.add_argument("--golden", metavar="CSV", action="append", default=[],
+                        help="Golden alerts of the next output interface (repeat for more interfaces).")
+    parser.add_argument("--update-golden", action="store_true",
+                        help="Write the output of the first run to the golden files instead of comparing.")
+    parser.add_argument("--ignore-order", action="store_true",
+                        help="Compare alerts regardless of their order.")
+    parser.add_argument("--ignore-fields", metavar="LIST", default="",
+                        help="Comma separated list of fields excluded from comparison.")
+    parser.add_argument("--save-input", metavar="FILE",
+                        help="Save the replayed (generated or scaled) input to a trapcap file.")
+    parser.add_argument("--keep", metavar="DIR",
+                        help="Directory for the input and output trapcap files (default: temporary).")
+    parser.add_argument("module", nargs=argparse.REMAINDER, help="Module and its arguments.")
+    args = parser.parse_args()
+
+    cmd = args.module[1:] if args.module[:1] == ["--"] else args.module
+    if not cmd:
+        parser.error("module to run is missing")
+    if len(args.golden) > args.outputs:
+        parser.error("more golden files than output interfaces")
+
+    if args.generate is not None:
+        spec, records = generate_flows(args.generate * max(1, args.scale))
+    elif args.amplification is not None:
+        spec, records = generate_amplification(args.amplification * max(1, args.scale))
+    elif args.brute_force is not None:
+        spec, records = generate_brute_force(args.brute_force * max(1, args.scale))
+    else:
+        spec, records = read_trapcap(args.read)
+        if spec is None:
+            parser.error("%s is empty" % args.read)
+        records = scale_records(Template(spec), records, args.scale)
+
+    workdir = args.keep or tempfile.mkdtemp(prefix="trapcap_replay.")
+    os.makedirs(workdir, exist_ok=True)
+    in_path = os.path.join(workdir, "input.trapcap")
+    write_trapcap(in_path, spec, records)
+    if args.save_input:
+        shutil.copyfile(in_path, args.save_input)
+    out_paths = [os.path.join(workdir, "output%d.trapcap" % i) for i in range(args.outputs)]
+
+    walls, cpus, rss = [], [], 0
+    results = None
+    ret = 0
+    for run in range(max(1, args.runs)):
+        wall, cpu, maxrss, code = run_module(cmd, in_path, out_paths)
+        if code != 0:
+            sys.stderr.write("ERROR: %s exited with %d in run %d.\n" % (cmd[0], code, run + 1))
+            ret = 2
+            break
+        walls.append(wall)
+        cpus.append(cpu)
+        rss = max(rss, maxrss)
+        outputs = [output_rows(p) for p in out_paths]
+        if results is None:
+            results = outputs
+        elif outputs != results:
+            sys.stderr.write("ERROR: output of run %d differs from the first run.\n" % (run + 1))
+            ret = 1
+
+    if walls:
+        n = len(records)
+        print("module:          %s" % " ".join(cmd))
+        print("records:         %d (%d runs)" % (n, len(walls)))
+        print("throughput:      %.0f records/s (median run)" % (n / percentile(walls, 50)))
+        print("run time [s]:    p50 %.3f, p90 %.3f, p99 %.3f, min %.3f, max %.3f" %
+              (percentile(walls, 50), percentile(walls, 90), percentile(walls, 99), min(walls), max(walls)))
+        print("per record [us]: p50 %.3f, p90 %.3f, p99 %.3f" %
+              tuple(percentile(walls, p) / max(1, n) * 1e6 for p in (50, 90, 99)))
+        print("CPU time [s]:    p50 %.3f (%.0f%% of run time)" %
+              (percentile(cpus, 50), 100.0 * percentile(cpus, 50) / max(1e-9, percentile(walls, 50))))
+        print("peak RSS:        %d kB" % rss)
+        for i, (header, rows) in enumerate(results):
+            print("output %d:        %d records" % (i, len(rows)))
+
+    ignore_fields = set(f for f in args.ignore_fields.split(",") if f)
+    for i, golden in enumerate(args.golden if results is not None else []):
+        header, rows = results[i]
+        if args.update_golden:
+            with open(golden, "w", newline="") as f:
+                writer = csv.writer(f, lineterminator="\n")
+                if header is not None:
+                    writer.writerow(header)
+                    writer.writerows(rows)
+            print("golden %s: updated" % golden)
+            continue
+        golden_header, golden_rows = read_golden(golden)
+        diffs = compare_rows(header, rows, golden_header, golden_rows, ignore_fields, args.ignore_order)
+        if diffs:
+            print("golden %s: %d differences" % (golden, len(diffs)))
+            for d in diffs[:20]:
+                print("  " + d)
+            ret = max(ret, 1)
+        else:
+            print("golden %s: match" % golden)
+
+    if not args.keep:
+        shutil.rmtree(workdir, ignore_errors=True)
+    return ret
+
+
+if __name__ == "__main__":
+    sys.exit(main())
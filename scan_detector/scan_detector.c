@@ -0,0 +1,972 @@
+/**
+ * \file scan_detector.c
+ * \brief Detector of horizontal, vertical and block scans in one pass over flows.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <libtrap/trap.h>
+#include <unirec/unirec.h>
+#include "fields.h"
+#include <b_plus_tree.h>
+#include <stdbool.h>
+
+#define MAX_PACKETS_HORIZONTAL 1 // Maximum number of packets in suspicious flow of a horizontal (and block) scan
+#define MAX_PACKETS_VERTICAL 4 // Maximum number of packets in suspicious flow of a vertical scan
+
+#define STATIC_ARR_SIZE 10 // Number of values of a set stored without hashing
+
+#define TCP_PROTOCOL 0x6
+#define TCP_FLAGS_SYN 0x2
+
+#define NUM_OF_ITEMS_IN_TREE_LEAF 5
+#define EXPIRY_QUEUE_INITIAL_SIZE 1024
+#define EXPIRED_ITEMS_PER_FLOW 16 // Maximum number of keys of each expiry queue checked per flow
+#define TRUE 1
+#define FALSE 0
+
+// Output interfaces
+#define IFC_HORIZONTAL 0
+#define IFC_VERTICAL 1
+#define IFC_BLOCK 2
+
+ip_addr_t nulladdr = { .ui64 = { 0, 0 } };
+
+UR_FIELDS (
+   ipaddr DST_IP,
+   ipaddr SRC_IP,
+   uint16 DST_PORT,
+   uint16 SRC_PORT,
+
+   uint32 PACKETS,
+   uint8 PROTOCOL,
+   uint8 TCP_FLAGS,
+
+   uint8 EVENT_TYPE,
+   time TIME_FIRST,
+   time TIME_LAST,
+   uint32 ADDR_CNT,
+   uint32 ADDR_THRSD,
+   uint32 PORT_CNT,
+
+   ipaddr DST_IP0,
+   ipaddr DST_IP1,
+   ipaddr DST_IP2,
+   ipaddr DST_IP3
+)
+
+trap_module_info_t *module_info = NULL;
+
+#define MODULE_BASIC_INFO(BASIC) \
+  BASIC("scan_detector", "This module is a simple, threshold-based detector of horizontal, vertical and block scans which processes incoming flow records in one pass. Horizontal scans (number of destination addresses per source address and destination port, the same as haddrscan_detector) are reported on the first output interface, vertical scans (number of destination ports per pair of addresses, the same as vportscan_detector) on the second one and block scans (number of destination addresses and ports per source address) on the third one.", 1, 3)
+
+
+/**
+ * Definition of module parameters - every parameter has short_opt,
+ * long_opt, description, flag whether an argument is required or
+ * optional (NULL) Module parameter argument types: int8, int16,
+ * int32, int64, uint8, uint16, uint32, uint64, float, string.
+ *
+ * See README.md for more detailed descriptions of these parameters.
+ */
+#define MODULE_PARAMS(PARAM) \
+   PARAM('n', "numaddrs-threshold", "Send horizontal scan alert after this number of DST_IP are contacted by one SRC_IP × DST_PORT combination (default 50).", required_argument, "uint32") \
+   PARAM('m', "numports-threshold", "Send vertical scan alert after this number of DST_PORT are contacted by one SRC_IP × DST_IP combination (default 50).", required_argument, "uint32") \
+   PARAM('b', "block-threshold", "Send block scan alert after this number of DST_IP and this number of DST_PORT are contacted by one SRC_IP (default 0 - disabled).", required_argument, "uint32") \
+   PARAM('d', "idle-threshold", "Discard entry after it has been unchanged this many seconds (default 300).", required_argument, "uint16") \
+   PARAM('p', "pruning-interval", "Ignored, kept for compatibility (idle entries are pruned continuously).", required_argument, "uint16")
+
+
+static int stop = 0;
+
+// Function to handle SIGTERM and SIGINT signals (used to stop the
+// module)
+TRAP_DEFAULT_SIGNAL_HANDLER(stop = 1)
+
+/**
+ * Set of addresses or ports. First STATIC_ARR_SIZE values are stored in
+ * the static array, after that all values are moved to open addressing
+ * set (0 is the empty slot).
+ */
+typedef struct value_set_s {
+   uint32_t static_values[STATIC_ARR_SIZE];
+   uint32_t *dynamic_values;
+   uint32_t cnt;
+   uint8_t zero_value; // Value 0 is in the set of dynamic_values
+} value_set_t;
+
+// Times all items of the trees start with
+typedef struct item_times_s {
+   time_t ts_modified;
+   time_t ts_queued;
+} item_times_t;
+
+// Item of the horizontal scans tree (key SRC_IP × DST_PORT)
+typedef struct horizontal_item_s {
+   time_t ts_modified; // TIME_LAST of the last modifying flow (in seconds)
+   time_t ts_queued; // Time of the key in the expiry queue
+   value_set_t addrs;
+   uint8_t alerted;
+   ur_time_t ts_first;
+   ur_time_t ts_last;
+} horizontal_item_t;
+
+// Item of the vertical scans tree (key DST_IP × SRC_IP)
+typedef struct vertical_item_s {
+   time_t ts_modified; // TIME_LAST of the last modifying flow (in seconds)
+   time_t ts_queued; // Time of the key in the expiry queue
+   value_set_t ports;
+   ur_time_t ts_first;
+   ur_time_t ts_last;
+} vertical_item_t;
+
+// Item of the block scans tree (key SRC_IP)
+typedef struct block_item_s {
+   time_t ts_modified; // TIME_LAST of the last modifying flow (in seconds)
+   time_t ts_queued; // Time of the key in the expiry queue
+   value_set_t addrs;
+   value_set_t ports;
+   uint8_t alerted;
+   ur_time_t ts_first;
+   ur_time_t ts_last;
+} block_item_t;
+
+// Item of the expiry queue
+typedef struct expiry_item_s {
+   uint64_t key;
+   time_t ts; // Time of the last modification when the key was queued
+} expiry_item_t;
+
+// Queue (ring buffer) of keys of the tree ordered by the time of queueing,
+// every item of the tree is queued once
+typedef struct expiry_queue_s {
+   expiry_item_t *items;
+   uint32_t size;
+   uint32_t first;
+   uint32_t cnt;
+} expiry_queue_t;
+
+typedef union treekey_u {
+   struct {
+      uint32_t src_ip;
+      uint16_t dst_port; } fields;
+   uint64_t key;
+} treekey_t;
+
+typedef struct param_s {
+   uint32_t numaddrs_threshold;
+   uint32_t numports_threshold;
+   uint32_t block_threshold;
+   uint16_t idle_threshold;
+   uint16_t pruning_interval;
+} param_t;
+
+static param_t param;
+
+// Numbers of slots of the sets are 2^bits (at least twice the threshold)
+static uint8_t addr_set_bits = 0;
+static uint8_t port_set_bits = 0;
+static uint8_t block_set_bits = 0;
+
+/***********************************************/
+
+int compare_64b(void *a, void *b)
+{
+   uint64_t *h1, *h2;
+   h1 = (uint64_t *) a;
+   h2 = (uint64_t *) b;
+   if (*h1 == *h2) {
+      return EQUAL;
+   } else if (*h1 < *h2) {
+      return LESS;
+   } else {
+      return MORE;
+   }
+}
+
+/**
+ * Function returns the number of bits of a set for given threshold.
+ */
+uint8_t set_bits(uint32_t threshold)
+{
+   uint8_t bits;
+
+   for (bits = 5; bits < 31 && (1ULL << bits) < 2ULL * threshold; bits++);
+   return bits;
+}
+
+/**
+ * Function returns home slot of the value in a set of 2^bits slots.
+ */
+static inline uint32_t set_home(uint32_t value, uint8_t bits)
+{
+   return (uint32_t) (value * 2654435761U) >> (32 - bits);
+}
+
+/**
+ * Function inserts value (not present) into the dynamic set.
+ */
+void set_dynamic_insert(value_set_t *set, uint32_t value, uint8_t bits)
+{
+   uint32_t mask = (1U << bits) - 1;
+   uint32_t x;
+
+   if (value == 0) {
+      set->zero_value = TRUE;
+      return;
+   }
+
+   // The set is never more than half full so there is always an empty slot
+   for (x = set_home(value, bits); set->dynamic_values[x] != 0; x = (x + 1) & mask);
+   set->dynamic_values[x] = value;
+}
+
+/**
+ * Function finds value in the dynamic set. If remove is set, the found
+ * value is removed (following values of the cluster are shifted back).
+ * Returns 1 if the value was found, 0 otherwise.
+ */
+int set_dynamic_find(value_set_t *set, uint32_t value, uint8_t bits, int remove)
+{
+   uint32_t mask = (1U << bits) - 1;
+   uint32_t x, y, home;
+
+   if (value == 0) {
+      if (set->zero_value == FALSE) {
+         return 0;
+      }
+      if (remove) {
+         set->zero_value = FALSE;
+      }
+      return 1;
+   }
+
+   for (x = set_home(value, bits); set->dynamic_values[x] != value; x = (x + 1) & mask) {
+      if (set->dynamic_values[x] == 0) {
+         return 0;
+      }
+   }
+   if (!remove) {
+      return 1;
+   }
+
+   for (y = (x + 1) & mask; set->dynamic_values[y] != 0; y = (y + 1) & mask) {
+      home = set_home(set->dynamic_values[y], bits);
+      // Move the value to the free slot if it's not between the slot and
+      // its home slot
+      if (((y - home) & mask) >= ((y - x) & mask)) {
+         set->dynamic_values[x] = set->dynamic_values[y];
+         x = y;
+      }
+   }
+   set->dynamic_values[x] = 0;
+   return 1;
+}
+
+/**
+ * Function adds value to the set of 2^bits slots. If remove is set,
+ * a value already present is removed from the set instead. Returns 1
+ * if the value was added, 0 if it was present and -1 in case of error.
+ */
+int set_insert(value_set_t *set, uint32_t value, uint8_t bits, int remove)
+{
+   uint32_t x;
+
+   if (set->dynamic_values != NULL) {
+      if (set_dynamic_find(set, value, bits, remove)) {
+         if (remove) {
+            set->cnt--;
+         }
+         return 0;
+      }
+      set_dynamic_insert(set, value, bits);
+      set->cnt++;
+      return 1;
+   }
+
+   for (x = 0; x < set->cnt; x++) {
+      if (set->static_values[x] == value) {
+         if (remove) {
+            set->static_values[x] = set->static_values[set->cnt - 1];
+            set->static_values[set->cnt - 1] = 0;
+            set->cnt--;
+         }
+         return 0;
+      }
+   }
+
+   if (set->cnt < STATIC_ARR_SIZE) {
+      set->static_values[set->cnt] = value;
+   } else {
+      // Inserting first value to dynamic set - allocate the set and
+      // move all static values to it (static ones are kept for the
+      // alert)
+      set->dynamic_values = (uint32_t *) calloc(1U << bits, sizeof(uint32_t));
+      if (set->dynamic_values == NULL) {
+         return -1;
+      }
+      for (x = 0; x < STATIC_ARR_SIZE; x++) {
+         set_dynamic_insert(set, set->static_values[x], bits);
+      }
+      set_dynamic_insert(set, value, bits);
+   }
+   set->cnt++;
+   return 1;
+}
+
+/**
+ * Function removes all values of the set.
+ */
+void set_clear(value_set_t *set)
+{
+   free(set->dynamic_values);
+   memset(set, 0, sizeof(value_set_t));
+}
+
+/**
+ * Function updates the first and the last time stamp of an item.
+ */
+static inline void update_times(ur_time_t *item_first, ur_time_t *item_last, int empty,
+                                ur_time_t ts_first, ur_time_t ts_last)
+{
+   if (empty) {
+      // New or just reported item
+      *item_first = ts_first;
+      *item_last = ts_last;
+   } else {
+      if (*item_first > ts_first) {
+         *item_first = ts_first;
+      }
+      if (*item_last < ts_last) {
+         *item_last = ts_last;
+      }
+   }
+}
+
+int send_horizontal_alert(ur_template_t *out_tmplt, void *out_rec,
+                          treekey_t *key, horizontal_item_t *np)
+{
+   ur_set(out_tmplt, out_rec, F_EVENT_TYPE, 1);
+   ur_set(out_tmplt, out_rec, F_TIME_FIRST, np->ts_first);
+   ur_set(out_tmplt, out_rec, F_TIME_LAST, np->ts_last);
+
+   ur_set(out_tmplt, out_rec, F_SRC_IP, ip_from_int(key->fields.src_ip));
+   ur_set(out_tmplt, out_rec, F_DST_PORT, key->fields.dst_port);
+   ur_set(out_tmplt, out_rec, F_PROTOCOL, TCP_PROTOCOL);
+
+   ur_set(out_tmplt, out_rec, F_ADDR_THRSD, param.numaddrs_threshold);
+   ur_set(out_tmplt, out_rec, F_ADDR_CNT, np->addrs.cnt);
+
+   switch (np->addrs.cnt - 1) {
+      // no breaks!
+      case 0:
+         ur_set(out_tmplt, out_rec, F_DST_IP1, nulladdr);
+      case 1:
+         ur_set(out_tmplt, out_rec, F_DST_IP2, nulladdr);
+      case 2:
+         ur_set(out_tmplt, out_rec, F_DST_IP3, nulladdr);
+   }
+
+   switch (np->addrs.cnt - 1) {
+      // no breaks!
+      default:
+         ur_set(out_tmplt, out_rec, F_DST_IP3, ip_from_int(np->addrs.static_values[3]));
+      case 2:
+         ur_set(out_tmplt, out_rec, F_DST_IP2, ip_from_int(np->addrs.static_values[2]));
+      case 1:
+         ur_set(out_tmplt, out_rec, F_DST_IP1, ip_from_int(np->addrs.static_values[1]));
+      case 0:
+         ur_set(out_tmplt, out_rec, F_DST_IP0, ip_from_int(np->addrs.static_values[0]));
+   }
+
+   return trap_send(IFC_HORIZONTAL, out_rec, ur_rec_size(out_tmplt, out_rec));
+}
+
+int send_vertical_alert(ur_template_t *out_tmplt, void *out_rec,
+                        ur_template_t *in_tmplt, const void *in_rec, vertical_item_t *np)
+{
+   ur_copy_fields(out_tmplt, out_rec, in_tmplt, in_rec);
+
+   ur_set(out_tmplt, out_rec, F_EVENT_TYPE, 1);
+   ur_set(out_tmplt, out_rec, F_PORT_CNT, np->ports.cnt);
+   ur_set(out_tmplt, out_rec, F_TIME_FIRST, np->ts_first);
+   ur_set(out_tmplt, out_rec, F_TIME_LAST, np->ts_last);
+
+   return trap_send(IFC_VERTICAL, out_rec, ur_rec_size(out_tmplt, out_rec));
+}
+
+int send_block_alert(ur_template_t *out_tmplt, void *out_rec,
+                     uint32_t src_ip, block_item_t *np)
+{
+   ur_set(out_tmplt, out_rec, F_EVENT_TYPE, 1);
+   ur_set(out_tmplt, out_rec, F_TIME_FIRST, np->ts_first);
+   ur_set(out_tmplt, out_rec, F_TIME_LAST, np->ts_last);
+
+   ur_set(out_tmplt, out_rec, F_SRC_IP, ip_from_int(src_ip));
+   ur_set(out_tmplt, out_rec, F_PROTOCOL, TCP_PROTOCOL);
+
+   ur_set(out_tmplt, out_rec, F_ADDR_THRSD, param.block_threshold);
+   ur_set(out_tmplt, out_rec, F_ADDR_CNT, np->addrs.cnt);
+   ur_set(out_tmplt, out_rec, F_PORT_CNT, np->ports.cnt);
+
+   return trap_send(IFC_BLOCK, out_rec, ur_rec_size(out_tmplt, out_rec));
+}
+
+/**
+ * Function appends key to the expiry queue, ts is the time of the last
+ * modification of the item. Returns 0 on success and -1 in case of
+ * error.
+ */
+int expiry_queue_push(expiry_queue_t *queue, uint64_t key, time_t ts)
+{
+   if (queue->cnt == queue->size) {
+      // Double the size of the ring buffer, items are moved to start
+      uint32_t new_size = queue->size == 0 ? EXPIRY_QUEUE_INITIAL_SIZE : 2 * queue->size;
+      expiry_item_t *items = (expiry_item_t *) malloc(new_size * sizeof(expiry_item_t));
+      uint32_t x;
+
+      if (items == NULL) {
+         return -1;
+      }
+      for (x = 0; x < queue->cnt; x++) {
+         items[x] = queue->items[(queue->first + x) % queue->size];
+      }
+      free(queue->items);
+      queue->items = items;
+      queue->size = new_size;
+      queue->first = 0;
+   }
+
+   queue->items[(queue->first + queue->cnt) % queue->size].key = key;
+   queue->items[(queue->first + queue->cnt) % queue->size].ts = ts;
+   queue->cnt++;
+   return 0;
+}
+
+/**
+ * Function removes the first key of the expiry queue if its item could
+ * be expired at ts_cur_time (unmodified for more than idle_threshold).
+ * Returns 1 if the key was removed, 0 otherwise.
+ */
+int expiry_queue_pop(expiry_queue_t *queue, time_t ts_cur_time, time_t idle_threshold, expiry_item_t *item)
+{
+   if (queue->cnt == 0 || (ts_cur_time - queue->items[queue->first].ts) <= idle_threshold) {
+      return 0;
+   }
+   *item = queue->items[queue->first];
+   queue->first = (queue->first + 1) % queue->size;
+   queue->cnt--;
+   return 1;
+}
+
+/**
+ * Function frees the sets of an item of the tree of given type.
+ */
+void release_item(void *value, int ifc)
+{
+   if (ifc == IFC_HORIZONTAL) {
+      set_clear(&((horizontal_item_t *) value)->addrs);
+   } else if (ifc == IFC_VERTICAL) {
+      set_clear(&((vertical_item_t *) value)->ports);
+   } else {
+      set_clear(&((block_item_t *) value)->addrs);
+      set_clear(&((block_item_t *) value)->ports);
+   }
+}
+
+/**
+ * Function queues key of a new item for expiration. Returns 0 on
+ * success and -1 in case of error.
+ */
+int queue_new_item(expiry_queue_t *queue, uint64_t key, item_times_t *times, time_t ts_flow)
+{
+   if (times->ts_modified != 0) {
+      return 0;
+   }
+   times->ts_queued = ts_flow;
+   if (expiry_queue_push(queue, key, ts_flow) != 0) {
+      fprintf(stderr, "ERROR: could not allocate expiry queue.\n");
+      return -1;
+   }
+   return 0;
+}
+
+/**
+ * Function deletes a few items of the tree which weren't modified in
+ * over idle_threshold, the keys are taken from the expiry queue. Items
+ * modified in the meantime are queued again. Alerts about trailing
+ * scanned addresses of alerted horizontal items are sent. Returns 0 on
+ * success, -1 in case of error and 1 if sending of an alert failed.
+ */
+int expire_items(bpt_t *tree, expiry_queue_t *queue, int ifc, time_t ts_cur_time,
+                 ur_template_t *out_tmplt, void *out_rec)
+{
+   expiry_item_t expiry_item;
+   item_times_t *times = NULL;
+   int ret_val = TRAP_E_OK;
+   int x;
+
+   for (x = 0; x < EXPIRED_ITEMS_PER_FLOW
+        && expiry_queue_pop(queue, ts_cur_time, param.idle_threshold, &expiry_item); x++) {
+      times = bpt_search(tree, &expiry_item.key);
+      if (times == NULL || times->ts_queued != expiry_item.ts) {
+         continue; // Item was deleted or the key was queued again
+      }
+
+      if ((ts_cur_time - times->ts_modified) > param.idle_threshold) {
+         if (ifc == IFC_HORIZONTAL && ((horizontal_item_t *) times)->alerted) {
+            // send alert about trailing scanned addresses
+            ret_val = send_horizontal_alert(out_tmplt, out_rec, (treekey_t *) &expiry_item.key,
+                                            (horizontal_item_t *) times);
+         }
+         release_item(times, ifc);
+         bpt_item_del(tree, &expiry_item.key);
+         // stop on error, do nothing on timeout in order to
+         // continue pruning
+         TRAP_DEFAULT_SEND_ERROR_HANDLING(ret_val, (void) 0, return 1);
+      } else {
+         times->ts_queued = times->ts_modified;
+         if (expiry_queue_push(queue, expiry_item.key, times->ts_queued) != 0) {
+            fprintf(stderr, "ERROR: could not allocate expiry queue.\n");
+            return -1;
+         }
+      }
+   }
+   return 0;
+}
+
+/**
+ * Function frees the sets of all items of the tree (before the tree is
+ * cleaned).
+ */
+void release_tree(bpt_t *tree, int ifc)
+{
+   bpt_list_item_t *b_item = NULL;
+   int has_next = 0;
+
+   b_item = bpt_list_init(tree);
+   if (b_item == NULL) {
+      return;
+   }
+   has_next = bpt_list_start(tree, b_item);
+   while (has_next == TRUE) {
+      if (b_item->value != NULL) {
+         release_item(b_item->value, ifc);
+      }
+      has_next = bpt_list_item_next(tree, b_item);
+   }
+   bpt_list_clean(b_item);
+}
+
+/**
+ * Function parses an unsigned threshold of the parameter. Returns false
+ * for an invalid value or a value lower than min.
+ */
+bool parse_threshold(const char *arg, uint32_t *value, uint32_t min, const char *name)
+{
+   if (sscanf(arg, "%" SCNu32, value) != 1) {
+      return false;
+   } else if (*value < min) {
+      fprintf(stderr, "%s < %" PRIu32 " makes no sense.\n", name, min);
+      return false;
+   }
+   return true;
+}
+
+int main(int argc, char **argv)
+{
+   time_t ts_cur_time = 0;
+   time_t ts_flow;
+   signed char opt;
+   int ret_val = 0;
+   const void *recv_data;
+   uint16_t recv_data_size = 0;
+
+   // Needed fields
+   ip_addr_t *src_ip = NULL;
+   ip_addr_t *dst_ip = NULL;
+   uint32_t packets = 0;
+   uint8_t protocol = 0;
+   uint8_t tcp_flags = 0;
+   uint16_t dst_port = 0;
+
+   treekey_t horizontal_key = { .key = 0 };
+   uint64_t vertical_key = 0;
+   uint64_t block_key = 0;
+   uint32_t int_src_ip = 0;
+   uint32_t int_dst_ip = 0;
+   ur_time_t ts_first, ts_last;
+
+   bpt_t *horizontal_tree = NULL, *vertical_tree = NULL, *block_tree = NULL;
+   bpt_t *trees[3] = { NULL, NULL, NULL };
+   horizontal_item_t *hp = NULL;
+   vertical_item_t *vp = NULL;
+   block_item_t *bp = NULL;
+   expiry_queue_t expiry_queue[3] = { { NULL, 0, 0, 0 }, { NULL, 0, 0, 0 }, { NULL, 0, 0, 0 } };
+
+   ur_template_t *in_tmplt = NULL;
+   ur_template_t *out_tmplt[3] = { NULL, NULL, NULL };
+   void *out_rec[3] = { NULL, NULL, NULL };
+   int i;
+
+   param.numaddrs_threshold = 50;
+   param.numports_threshold = 50;
+   param.block_threshold = 0;
+   param.idle_threshold = 5 * 60;
+   param.pruning_interval = 1 * 60;
+
+   /***** TRAP initialization *****/
+
+   /*
+    * Macro allocates and initializes module_info structure according
+    * to MODULE_BASIC_INFO and MODULE_PARAMS definitions earlier in
+    * this file. It also creates a string with short_opt letters for
+    * getopt function called "module_getopt_string" and long_options
+    * field for getopt_long function in variable "long_options"
+    */
+   INIT_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS)
+   /*
+    * Let TRAP library parse program arguments, extract its parameters
+    * and initialize module interfaces
+    */
+   TRAP_DEFAULT_INITIALIZATION(argc, argv, *module_info);
+
+   TRAP_REGISTER_DEFAULT_SIGNAL_HANDLER();
+
+   bool invalid_argument = false;
+
+   while ((opt = TRAP_GETOPT(argc, argv, module_getopt_string, long_options)) != -1
+      && invalid_argument == false) {
+      switch (opt) {
+         case 'n':
+            invalid_argument = !parse_threshold(optarg, &param.numaddrs_threshold, 2, "Numaddrs threshold");
+            break;
+
+         case 'm':
+            invalid_argument = !parse_threshold(optarg, &param.numports_threshold, 2, "Numports threshold");
+            break;
+
+         case 'b':
+            invalid_argument = !parse_threshold(optarg, &param.block_threshold, 0, "Block threshold");
+            break;
+
+         case 'd':
+            if (sscanf(optarg, "%" SCNu16, &param.idle_threshold) != 1) {
+               invalid_argument = true;
+            } else if (param.idle_threshold < 1) {
+               fprintf(stderr, "Idle threshold < 1 makes no sense.\n");
+               invalid_argument = true;
+            }
+            break;
+
+         case 'p':
+            if (sscanf(optarg, "%" SCNu16, &param.pruning_interval) != 1) {
+               invalid_argument = true;
+            } else if (param.pruning_interval < 1) {
+               fprintf(stderr, "Pruning interval < 1 makes no sense.\n");
+               invalid_argument = true;
+            }
+            break;
+
+         default:
+            invalid_argument = true;
+            break;
+      }
+   }
+
+   if (invalid_argument == true) {
+      fprintf(stderr, "Invalid arguments.\n");
+      FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+      TRAP_DEFAULT_FINALIZATION();
+      return -1;
+   }
+
+   // Sizes of sets, the alerts are sent before a set is more than half
+   // full
+   addr_set_bits = set_bits(param.numaddrs_threshold);
+   port_set_bits = set_bits(param.numports_threshold);
+   block_set_bits = set_bits(param.block_threshold);
+
+   horizontal_tree = bpt_init(NUM_OF_ITEMS_IN_TREE_LEAF, &compare_64b, sizeof(horizontal_item_t), sizeof(uint64_t));
+   vertical_tree = bpt_init(NUM_OF_ITEMS_IN_TREE_LEAF, &compare_64b, sizeof(vertical_item_t), sizeof(uint64_t));
+   block_tree = bpt_init(NUM_OF_ITEMS_IN_TREE_LEAF, &compare_64b, sizeof(block_item_t), sizeof(uint64_t));
+   if (horizontal_tree == NULL || vertical_tree == NULL || block_tree == NULL) {
+      fprintf(stderr, "ERROR: Could not initialize B_PLUS_TREE\n");
+      fflush(stderr);
+      goto cleanup;
+   }
+   trees[IFC_HORIZONTAL] = horizontal_tree;
+   trees[IFC_VERTICAL] = vertical_tree;
+   trees[IFC_BLOCK] = block_tree;
+
+   // ***** Create UniRec templates *****
+   in_tmplt = ur_create_input_template(0, NULL, NULL);
+   if (in_tmplt == NULL){
+      fprintf(stderr, "ERROR: Input template could not be created.\n");
+      fflush(stderr);
+      goto cleanup;
+   }
+
+   // Templates of haddrscan_detector, vportscan_detector and block scans
+   out_tmplt[IFC_HORIZONTAL] = ur_create_output_template(IFC_HORIZONTAL,
+                                                        "EVENT_TYPE,TIME_FIRST,TIME_LAST,"
+                                                        "SRC_IP,DST_PORT,PROTOCOL,"
+                                                        "ADDR_CNT,ADDR_THRSD,"
+                                                        "DST_IP0,DST_IP1,DST_IP2,DST_IP3",
+                                                        NULL);
+   out_tmplt[IFC_VERTICAL] = ur_create_output_template(IFC_VERTICAL,
+                                                      "EVENT_TYPE,TIME_FIRST,TIME_LAST,SRC_IP,DST_IP,"
+                                                      "SRC_PORT,DST_PORT,PROTOCOL,PORT_CNT",
+                                                      NULL);
+   out_tmplt[IFC_BLOCK] = ur_create_output_template(IFC_BLOCK,
+                                                   "EVENT_TYPE,TIME_FIRST,TIME_LAST,"
+                                                   "SRC_IP,PROTOCOL,ADDR_CNT,PORT_CNT,ADDR_THRSD",
+                                                   NULL);
+   for (i = 0; i < 3; i++) {
+      if (out_tmplt[i] == NULL){
+         fprintf(stderr, "ERROR: Output template could not be created.\n");
+         fflush(stderr);
+         goto cleanup;
+      }
+      // Allocate memory for output record
+      out_rec[i] = ur_create_record(out_tmplt[i], 0);
+      if (out_rec[i] == NULL){
+         fprintf(stderr, "ERROR: Output record could not be created.\n");
+         fflush(stderr);
+         goto cleanup;
+      }
+      trap_ifcctl(TRAPIFC_OUTPUT, i, TRAPCTL_SETTIMEOUT, TRAP_NO_WAIT);
+   }
+
+   while (!stop) {
+      ret_val = TRAP_RECEIVE(0, recv_data, recv_data_size, in_tmplt);
+      TRAP_DEFAULT_RECV_ERROR_HANDLING(ret_val, continue, break);
+      // Check size of received data
+      if (recv_data_size < ur_rec_fixlen_size(in_tmplt)) {
+         if (recv_data_size <= 1) {
+            break; // End of data (used for testing purposes)
+         } else {
+            fprintf(stderr,
+                    "ERROR: data with wrong size received (expected size: >= %hu, received size: %hu)\n",
+                    ur_rec_fixlen_size(in_tmplt), recv_data_size);
+            fflush(stderr);
+            goto cleanup;
+         }
+      }
+
+      // Current time is the latest TIME_LAST of flows, so that the
+      // timeouts work the same for data read from files
+      ts_flow = ur_time_get_sec(ur_get(in_tmplt, recv_data, F_TIME_LAST));
+      if (ts_flow > ts_cur_time) {
+         ts_cur_time = ts_flow;
+      }
+
+      src_ip = &ur_get(in_tmplt, recv_data, F_SRC_IP);
+      dst_ip = &ur_get(in_tmplt, recv_data, F_DST_IP);
+
+      // Filter ip_v4 addresses
+      if (ip_is4(src_ip) != 1 || ip_is4(dst_ip) != 1) {
+         continue;
+      }
+
+      packets = ur_get(in_tmplt, recv_data, F_PACKETS);
+      dst_port = ur_get(in_tmplt, recv_data, F_DST_PORT);
+      protocol = ur_get(in_tmplt, recv_data, F_PROTOCOL);
+      tcp_flags = ur_get(in_tmplt, recv_data, F_TCP_FLAGS);
+
+      // The filter of all scan types, the horizontal (and block) scans
+      // are further restricted to one packet flows
+      if (packets <= MAX_PACKETS_VERTICAL && (protocol == TCP_PROTOCOL && (tcp_flags == TCP_FLAGS_SYN))) {
+         int_src_ip = ip_get_v4_as_int(src_ip);
+         int_dst_ip = ip_get_v4_as_int(dst_ip);
+         ts_first = ur_get(in_tmplt, recv_data, F_TIME_FIRST);
+         ts_last = ur_get(in_tmplt, recv_data, F_TIME_LAST);
+         ts_flow = ur_time_get_sec(ts_last);
+
+         // Vertical scans - concatenate ip_v4 DST_IP and ip_v4 SRC_IP
+         vertical_key = ((uint64_t) int_dst_ip << 32) | int_src_ip;
+         vp = bpt_search_or_insert(vertical_tree, &vertical_key);
+         if (vp == NULL) {
+            fprintf(stderr, "ERROR: could not allocate port-scan info structure in leaf node of the B+ tree.\n");
+            fflush(stderr);
+            goto cleanup;
+         }
+         if (queue_new_item(&expiry_queue[IFC_VERTICAL], vertical_key, (item_times_t *) vp, ts_flow) != 0) {
+            goto cleanup;
+         }
+         update_times(&vp->ts_first, &vp->ts_last, vp->ports.cnt == 0, ts_first, ts_last);
+         // Repeating destination port is removed (benign traffic)
+         ret_val = set_insert(&vp->ports, dst_port, port_set_bits, TRUE);
+         if (ret_val == -1) {
+            fprintf(stderr, "ERROR: could not allocate set of ports.\n");
+            fflush(stderr);
+            goto cleanup;
+         }
+         vp->ts_modified = ts_flow;
+         if (vp->ports.cnt >= param.numports_threshold) {
+            // Scan detected
+            ret_val = send_vertical_alert(out_tmplt[IFC_VERTICAL], out_rec[IFC_VERTICAL], in_tmplt, recv_data, vp);
+            // delete item from tree no matter how successful was trap_send()
+            set_clear(&vp->ports);
+            bpt_item_del(vertical_tree, &vertical_key);
+            // break on error, do nothing on timeout in order to
+            // perform tree pruning
+            TRAP_DEFAULT_SEND_ERROR_HANDLING(ret_val, (void) 0, break);
+         }
+      }
+
+      if (packets == MAX_PACKETS_HORIZONTAL && (protocol == TCP_PROTOCOL && (tcp_flags == TCP_FLAGS_SYN))) {
+         // Horizontal scans - concatenate ip_v4 SRC_IP and DST_PORT
+         horizontal_key.fields.src_ip = int_src_ip;
+         horizontal_key.fields.dst_port = dst_port;
+         hp = bpt_search_or_insert(horizontal_tree, &horizontal_key.key);
+         if (hp == NULL) {
+            fprintf(stderr, "ERROR: could not allocate address-scan info structure in leaf node of the B+ tree.\n");
+            fflush(stderr);
+            goto cleanup;
+         }
+         if (queue_new_item(&expiry_queue[IFC_HORIZONTAL], horizontal_key.key, (item_times_t *) hp, ts_flow) != 0) {
+            goto cleanup;
+         }
+         update_times(&hp->ts_first, &hp->ts_last, hp->addrs.cnt == 0, ts_first, ts_last);
+         ret_val = set_insert(&hp->addrs, int_dst_ip, addr_set_bits, FALSE);
+         if (ret_val == -1) {
+            fprintf(stderr, "ERROR: could not allocate set of addresses.\n");
+            fflush(stderr);
+            goto cleanup;
+         }
+         hp->ts_modified = ts_flow;
+         if (hp->addrs.cnt >= param.numaddrs_threshold) {
+            // Scan detected
+            hp->alerted = TRUE;
+            ret_val = send_horizontal_alert(out_tmplt[IFC_HORIZONTAL], out_rec[IFC_HORIZONTAL], &horizontal_key, hp);
+            // clear scanned addresses regardless of whether
+            // trap_send() was successful
+            set_clear(&hp->addrs);
+            TRAP_DEFAULT_SEND_ERROR_HANDLING(ret_val, (void) 0, break);
+         }
+
+         // Block scans - the same source address over all ports
+         if (param.block_threshold > 0) {
+            block_key = int_src_ip;
+            bp = bpt_search_or_insert(block_tree, &block_key);
+            if (bp == NULL) {
+               fprintf(stderr, "ERROR: could not allocate block-scan info structure in leaf node of the B+ tree.\n");
+               fflush(stderr);
+               goto cleanup;
+            }
+            if (queue_new_item(&expiry_queue[IFC_BLOCK], block_key, (item_times_t *) bp, ts_flow) != 0) {
+               goto cleanup;
+            }
+            update_times(&bp->ts_first, &bp->ts_last, bp->addrs.cnt == 0, ts_first, ts_last);
+            // Stop counting the dimension which already reached the
+            // threshold, so that the set stays at most half full
+            if ((bp->addrs.cnt < param.block_threshold
+                 && set_insert(&bp->addrs, int_dst_ip, block_set_bits, FALSE) == -1)
+                || (bp->ports.cnt < param.block_threshold
+                 && set_insert(&bp->ports, dst_port, block_set_bits, FALSE) == -1)) {
+               fprintf(stderr, "ERROR: could not allocate set of block scan.\n");
+               fflush(stderr);
+               goto cleanup;
+            }
+            bp->ts_modified = ts_flow;
+            if (bp->addrs.cnt >= param.block_threshold && bp->ports.cnt >= param.block_threshold) {
+               // Scan detected
+               bp->alerted = TRUE;
+               ret_val = send_block_alert(out_tmplt[IFC_BLOCK], out_rec[IFC_BLOCK], int_src_ip, bp);
+               set_clear(&bp->addrs);
+               set_clear(&bp->ports);
+               TRAP_DEFAULT_SEND_ERROR_HANDLING(ret_val, (void) 0, break);
+            }
+         }
+      }
+
+      // B+ trees pruning - a few items from each expiry queue
+      for (i = 0; i < 3; i++) {
+         ret_val = expire_items(trees[i], &expiry_queue[i], i, ts_cur_time, out_tmplt[i], out_rec[i]);
+         if (ret_val != 0) {
+            break;
+         }
+      }
+      if (ret_val == -1) {
+         goto cleanup;
+      } else if (ret_val == 1) {
+         break;
+      }
+   }
+
+   // ***** Cleanup *****
+cleanup:
+   if (horizontal_tree != NULL) {
+      release_tree(horizontal_tree, IFC_HORIZONTAL);
+      bpt_clean(horizontal_tree);
+   }
+   if (vertical_tree != NULL) {
+      release_tree(vertical_tree, IFC_VERTICAL);
+      bpt_clean(vertical_tree);
+   }
+   if (block_tree != NULL) {
+      release_tree(block_tree, IFC_BLOCK);
+      bpt_clean(block_tree);
+   }
+   ur_free_template(in_tmplt);
+   for (i = 0; i < 3; i++) {
+      free(expiry_queue[i].items);
+      ur_free_template(out_tmplt[i]);
+      ur_free_record(out_rec[i]);
+   }
+   ur_finalize();
+   TRAP_DEFAULT_FINALIZATION();
+   FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS)
+   return 0;
+}
+
+/* local variables: */
+/* c-basic-offset: 3; */
+/* end: */
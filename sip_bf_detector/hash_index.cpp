@@ -0,0 +1,339 @@
+/**
+ * \file hash_index.cpp
+ * \brief Open addressing hash tables of users and user-client communications used by sip_bf_detector.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include "hash_index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+uint64_t hash_user_name(const char *name, uint16_t length)
+{
+   uint64_t hash = 14695981039346656037ULL;
+
+   for (uint16_t i = 0; i < length; i++) {
+      hash ^= (uint8_t) name[i];
+      hash *= 1099511628211ULL;
+   }
+
+   return hash;
+}
+
+bool NameTable::init(uint32_t size)
+{
+   m_count = 0;
+   m_mask = size - 1;
+   m_entries = (entry_t *) malloc((size / 2) * sizeof(entry_t));
+   m_slots = (uint32_t *) calloc(size, sizeof(uint32_t));
+   if (!m_entries || !m_slots) {
+      fprintf(stderr, "ERROR: NameTable::init - malloc failed.\n");
+      free(m_entries);
+      free(m_slots);
+      m_entries = NULL;
+      m_slots = NULL;
+      return false;
+   }
+
+   return true;
+}
+
+void NameTable::destroy()
+{
+   free(m_entries);
+   free(m_slots);
+   m_entries = NULL;
+   m_slots = NULL;
+   m_count = 0;
+}
+
+void NameTable::clear()
+{
+   memset(m_slots, 0, (m_mask + 1) * sizeof(uint32_t));
+   m_count = 0;
+}
+
+void *NameTable::find(uint64_t hash, const char *name, uint16_t length) const
+{
+   for (uint32_t i = hash & m_mask; m_slots[i] != 0; i = (i + 1) & m_mask) {
+      const entry_t *e = &m_entries[m_slots[i] - 1];
+      if (e->hash == hash && strncmp(e->name, name, length) == 0 && e->name[length] == '\0') {
+         return e->item;
+      }
+   }
+
+   return NULL;
+}
+
+bool NameTable::insert(uint64_t hash, const char *name, void *item)
+{
+   // keep the load factor at most 1/2, the entry array holds exactly that many items
+   if (m_count == (m_mask + 1) / 2 && !resize((m_mask + 1) * 2)) {
+      return false;
+   }
+
+   uint32_t i = hash & m_mask;
+   while (m_slots[i] != 0) {
+      i = (i + 1) & m_mask;
+   }
+
+   m_entries[m_count].hash = hash;
+   m_entries[m_count].name = name;
+   m_entries[m_count].item = item;
+   m_count++;
+   m_slots[i] = m_count;
+
+   return true;
+}
+
+void NameTable::remove(uint64_t hash, const void *item)
+{
+   uint32_t i = hash & m_mask;
+   while (m_slots[i] != 0 && m_entries[m_slots[i] - 1].item != item) {
+      i = (i + 1) & m_mask;
+   }
+
+   if (m_slots[i] == 0) {
+      return;
+   }
+
+   uint32_t entry = m_slots[i] - 1;
+   removeSlot(i);
+
+   // move the last entry to the freed place to keep the entry array dense
+   m_count--;
+   if (entry != m_count) {
+      m_slots[findSlot(m_entries[m_count].hash, m_count)] = entry + 1;
+      m_entries[entry] = m_entries[m_count];
+   }
+}
+
+uint32_t NameTable::count() const
+{
+   return m_count;
+}
+
+void *NameTable::get(uint32_t index) const
+{
+   return m_entries[index].item;
+}
+
+uint32_t NameTable::findSlot(uint64_t hash, uint32_t entry) const
+{
+   uint32_t i = hash & m_mask;
+   while (m_slots[i] != entry + 1) {
+      i = (i + 1) & m_mask;
+   }
+
+   return i;
+}
+
+void NameTable::removeSlot(uint32_t slot)
+{
+   // backward shift deletion, no tombstones are left in the table
+   uint32_t hole = slot;
+   uint32_t i = (slot + 1) & m_mask;
+
+   while (m_slots[i] != 0) {
+      uint32_t home = m_entries[m_slots[i] - 1].hash & m_mask;
+      if (((i - home) & m_mask) >= ((i - hole) & m_mask)) {
+         m_slots[hole] = m_slots[i];
+         hole = i;
+      }
+
+      i = (i + 1) & m_mask;
+   }
+
+   m_slots[hole] = 0;
+}
+
+bool NameTable::resize(uint32_t size)
+{
+   entry_t *entries = (entry_t *) realloc(m_entries, (size / 2) * sizeof(entry_t));
+   if (!entries) {
+      fprintf(stderr, "ERROR: NameTable::resize - realloc failed.\n");
+      return false;
+   }
+
+   m_entries = entries;
+   uint32_t *slots = (uint32_t *) calloc(size, sizeof(uint32_t));
+   if (!slots) {
+      fprintf(stderr, "ERROR: NameTable::resize - calloc failed.\n");
+      return false;
+   }
+
+   free(m_slots);
+   m_slots = slots;
+   m_mask = size - 1;
+   for (uint32_t e = 0; e < m_count; e++) {
+      uint32_t i = m_entries[e].hash & m_mask;
+      while (m_slots[i] != 0) {
+         i = (i + 1) & m_mask;
+      }
+
+      m_slots[i] = e + 1;
+   }
+
+   return true;
+}
+
+bool PairIndex::init(uint32_t size)
+{
+   m_count = 0;
+   m_mask = size - 1;
+   m_slots = (slot_t *) calloc(size, sizeof(slot_t));
+   if (!m_slots) {
+      fprintf(stderr, "ERROR: PairIndex::init - calloc failed.\n");
+      return false;
+   }
+
+   return true;
+}
+
+void PairIndex::destroy()
+{
+   free(m_slots);
+   m_slots = NULL;
+   m_count = 0;
+}
+
+void PairIndex::clear()
+{
+   memset(m_slots, 0, (m_mask + 1) * sizeof(slot_t));
+   m_count = 0;
+}
+
+uint32_t PairIndex::hash(const void *first, const void *second)
+{
+   uint64_t h = (uint64_t) (uintptr_t) first * 0x9e3779b97f4a7c15ULL;
+   h ^= (uint64_t) (uintptr_t) second + 0x632be59bd9b4e019ULL + (h << 6) + (h >> 2);
+   h ^= h >> 33;
+   h *= 0xff51afd7ed558ccdULL;
+   h ^= h >> 33;
+
+   return (uint32_t) h;
+}
+
+void *PairIndex::find(const void *first, const void *second) const
+{
+   for (uint32_t i = hash(first, second) & m_mask; m_slots[i].item; i = (i + 1) & m_mask) {
+      if (m_slots[i].first == first && m_slots[i].second == second) {
+         return m_slots[i].item;
+      }
+   }
+
+   return NULL;
+}
+
+bool PairIndex::insert(const void *first, const void *second, void *item)
+{
+   if ((m_count + 1) * 2 > m_mask + 1 && !resize((m_mask + 1) * 2)) {
+      return false;
+   }
+
+   uint32_t i = hash(first, second) & m_mask;
+   while (m_slots[i].item) {
+      i = (i + 1) & m_mask;
+   }
+
+   m_slots[i].first = first;
+   m_slots[i].second = second;
+   m_slots[i].item = item;
+   m_count++;
+
+   return true;
+}
+
+void PairIndex::remove(const void *first, const void *second)
+{
+   uint32_t i = hash(first, second) & m_mask;
+   while (m_slots[i].item && !(m_slots[i].first == first && m_slots[i].second == second)) {
+      i = (i + 1) & m_mask;
+   }
+
+   if (!m_slots[i].item) {
+      return;
+   }
+
+   // backward shift deletion, no tombstones are left in the table
+   uint32_t hole = i;
+   i = (i + 1) & m_mask;
+   while (m_slots[i].item) {
+      uint32_t home = hash(m_slots[i].first, m_slots[i].second) & m_mask;
+      if (((i - home) & m_mask) >= ((i - hole) & m_mask)) {
+         m_slots[hole] = m_slots[i];
+         hole = i;
+      }
+
+      i = (i + 1) & m_mask;
+   }
+
+   m_slots[hole].item = NULL;
+   m_count--;
+}
+
+bool PairIndex::resize(uint32_t size)
+{
+   slot_t *old = m_slots;
+   uint32_t old_size = m_mask + 1;
+
+   m_slots = (slot_t *) calloc(size, sizeof(slot_t));
+   if (!m_slots) {
+      fprintf(stderr, "ERROR: PairIndex::resize - calloc failed.\n");
+      m_slots = old;
+      return false;
+   }
+
+   m_mask = size - 1;
+   for (uint32_t j = 0; j < old_size; j++) {
+      if (old[j].item) {
+         uint32_t i = hash(old[j].first, old[j].second) & m_mask;
+         while (m_slots[i].item) {
+            i = (i + 1) & m_mask;
+         }
+
+         m_slots[i] = old[j];
+      }
+   }
+
+   free(old);
+   return true;
+}
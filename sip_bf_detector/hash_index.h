@@ -0,0 +1,122 @@
+/**
+ * \file hash_index.h
+ * \brief Open addressing hash tables of users and user-client communications used by sip_bf_detector.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef SIP_BF_DETECTOR_HASH_INDEX_H
+#define SIP_BF_DETECTOR_HASH_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define DEFAULT_NAME_TABLE_SIZE  16
+#define DEFAULT_PAIR_INDEX_SIZE  16
+
+/**
+ * \brief Compute 64-bit FNV-1a hash of a user name.
+ *
+ * \param[in] name pointer to the name (not null terminated)
+ * \param[in] length length of the name
+ * \return hash of the name
+ */
+uint64_t hash_user_name(const char *name, uint16_t length);
+
+/**
+ * \brief Table of items indexed by an interned name and its 64-bit hash.
+ *
+ * Items are kept in a dense array which can be iterated with count() and get(),
+ * the hash slots only point into it. Removing an item moves the last item
+ * to its place, so iterate from the end when removing items during iteration.
+ * The name of an item is not copied, it has to stay valid while the item is in the table.
+ */
+class NameTable {
+public:
+   bool init(uint32_t size);
+   void destroy();
+   void clear();
+   void *find(uint64_t hash, const char *name, uint16_t length) const;
+   bool insert(uint64_t hash, const char *name, void *item);
+   void remove(uint64_t hash, const void *item);
+   uint32_t count() const;
+   void *get(uint32_t index) const;
+private:
+   struct entry_t {
+      uint64_t hash;
+      const char *name;
+      void *item;
+   };
+
+   bool resize(uint32_t size);
+   uint32_t findSlot(uint64_t hash, uint32_t entry) const;
+   void removeSlot(uint32_t slot);
+
+   entry_t *m_entries;
+   uint32_t *m_slots;                     ///< index of entry + 1, 0 marks an empty slot
+   uint32_t m_mask;
+   uint32_t m_count;
+};
+
+/**
+ * \brief Index of items by a pair of pointers (user and client of a communication).
+ */
+class PairIndex {
+public:
+   bool init(uint32_t size);
+   void destroy();
+   void clear();
+   void *find(const void *first, const void *second) const;
+   bool insert(const void *first, const void *second, void *item);
+   void remove(const void *first, const void *second);
+private:
+   struct slot_t {
+      const void *first;
+      const void *second;
+      void *item;                         ///< NULL marks an empty slot
+   };
+
+   static uint32_t hash(const void *first, const void *second);
+   bool resize(uint32_t size);
+
+   slot_t *m_slots;
+   uint32_t m_mask;
+   uint32_t m_count;
+};
+
+#endif /* SIP_BF_DETECTOR_HASH_INDEX_H */
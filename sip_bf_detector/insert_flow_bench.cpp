@@ -0,0 +1,126 @@
+/**
+ * \file insert_flow_bench.cpp
+ * \brief Micro-benchmark of Detector::insertFlow() of sip_bf_detector (make bench).
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+/*
+ * The detector uses the globals of the module, so its translation unit is
+ * included with main() renamed.
+ */
+#define main sip_bf_detector_main
+#include "sip_bf_detector.cpp"
+#undef main
+
+#include "bench.h"
+
+#define FLOW_CNT (1 << 19)
+#define SERVER_CNT 256
+#define CLIENT_CNT 16384
+#define ATTACKER_CNT 64
+#define USER_CNT 4096
+#define FROM_MAX_LENGTH 48
+
+/*
+ * Messages of one window shorter than g_free_mem_interval, so no timer
+ * expires and no alert is sent (the output interface is not initialized).
+ * Half of the messages come from a few attackers guessing passwords of
+ * many users, most of the messages are 401 Unauthorized.
+ */
+static char froms[FLOW_CNT][FROM_MAX_LENGTH];
+static ip_addr_t servers[FLOW_CNT];
+static ip_addr_t clients[FLOW_CNT];
+static data_t flows[FLOW_CNT];
+
+static bool fill_flows()
+{
+   for (uint32_t i = 0; i < FLOW_CNT; i++) {
+      uint64_t r = bench_rand();
+      bool attacker = (r >> 63) != 0;
+      uint32_t server = (r >> 32) % SERVER_CNT;
+      uint32_t client = attacker ? (r >> 16) % ATTACKER_CNT : ATTACKER_CNT + (r >> 16) % CLIENT_CNT;
+      uint32_t user = bench_rand() % USER_CNT;
+      data_t &flow = flows[i];
+
+      servers[i] = ip_from_int(0x0a000000 | server);
+      clients[i] = ip_from_int(0xc0000000 | client);
+      int length = snprintf(froms[i], FROM_MAX_LENGTH, "sip:%u@pbx%u.example.com", user, server);
+      if (parse_sip_from(froms[i], length, &flow) != 0) {
+         return false;
+      }
+      flow.ipv4 = true;
+      flow.ip_src = &servers[i];
+      flow.ip_dst = &clients[i];
+      flow.status_code = (bench_rand() % 10) ? SIP_STATUS_UNAUTHORIZED : SIP_STATUS_OK;
+      flow.link_bit_field = 1;
+      flow.protocol = PROTOCOL_UDP;
+      flow.server_port = 5060;
+      flow.client_port = 5060;
+      flow.time_stamp = 1000000000 + i / (FLOW_CNT / 600);
+   }
+   return true;
+}
+
+int main()
+{
+   Detector det;
+   uint32_t i;
+
+   if (!fill_flows()) {
+      fprintf(stderr, "ERROR: could not parse SIP_FROM.\n");
+      return 1;
+   }
+   if (!det.init()) {
+      return 1;
+   }
+
+   double start = bench_now_ns();
+   unsigned long start_allocations = bench_allocations();
+   for (i = 0; i < FLOW_CNT; i++) {
+      if (!det.insertFlow(&flows[i])) {
+         fprintf(stderr, "ERROR: Detector::insertFlow failed.\n");
+         break;
+      }
+   }
+   bench_report("Detector::insertFlow", i, start, start_allocations);
+
+   // Detector::destroy() would report the attacks in progress, the memory is
+   // released at exit instead
+   return 0;
+}
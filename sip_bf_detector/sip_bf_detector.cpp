@@ -42,6 +42,7 @@
  */
 
 #include "sip_bf_detector.h"
+#include "worker.h"
 #include "fields.h"
 
 #include <getopt.h>
@@ -49,6 +50,8 @@
 #include <sstream>
 #include <cmath>
 #include <ctime>
+#include <new>
+#include <pthread.h>
 
 UR_FIELDS (
    ipaddr DST_IP,                // IP address of attack source
@@ -87,7 +90,8 @@ trap_module_info_t *module_info = NULL;
    PARAM('d', "dist_threshold", "Number of clients attempting to connect to a specific user (on one particular server) which is considered a distributed brute-force attack. (25 by default)", required_argument, "uint32") \
    PARAM('f', "free_mem_delay", "Number of seconds after the last action to consider attack as ceased. (1800 by default)", required_argument, "uint64") \
    PARAM('o', "ok_count", "Number of observed OK responses after crossing alert threshold to consider the alert false and drop the communication. (5 by default)", required_argument, "uint32") \
-   PARAM('s', "scan_threshold", "Number of extensions a specific client attempted to register as (on one particular server) which is considered a scan. (5 by default)", required_argument, "uint32")
+   PARAM('s', "scan_threshold", "Number of extensions a specific client attempted to register as (on one particular server) which is considered a scan. (5 by default)", required_argument, "uint32") \
+   PARAM('t', "threads", "Number of worker threads, SIP servers are distributed among them by their IP address. (0 by default, messages are processed by the receiving thread)", required_argument, "uint32")
 
 #define ASSIGN_MIN(A, B) (A) = ((A) <= (B)) ? (A) : (B)
 #define ASSIGN_MAX(A, B) (A) = ((A) >= (B)) ? (A) : (B)
@@ -100,11 +104,13 @@ uint64_t g_free_mem_interval = FREE_MEMORY_INTERVAL;
 uint32_t g_scan_limit = DEFAULT_SCAN_LIMIT;
 uint32_t g_dbf_limit = DEFAULT_DBF_LIMIT;
 uint32_t g_ok_limit = DEFAULT_OK_COUNT_LIMIT;
+uint32_t g_worker_count = 0;
 uint16_t g_min_sec = 0;
 uint16_t g_event_row = 0;
 ur_template_t *alert_tmplt = NULL;
 //ur_template_t *tm_tmplt = NULL;
 void *alert_rec = NULL;
+pthread_mutex_t g_alert_lock = PTHREAD_MUTEX_INITIALIZER;   // guards alert_rec, event IDs and the output interface
 //void *tm_rec = NULL;
 int sig_counter = 0;
 
@@ -120,63 +126,6 @@ void signal_handler(int signal)
    
 }
 
-/**
- * Comparing function used in b+ tree of users. 
- * Compares two strings representing keys in b+ tree.
- *
- * \param[in] a pointer to the first key
- * \param[in] b pointer to the second key
- * \return <0 (a < b), 0 (a == b), >0 (a > b)
- */
-int compare_user_name(void *a, void *b)
-{
-   return strncmp((const char *) a, (const char *) b, MAX_LENGTH_USER_NAME);
-}
-
-/**
- * Comparing function used in b+ tree of servers and attackers. 
- * Compares two integer representations of IPv4 keys.
- *
- * \param[in] a pointer to the first key
- * \param[in] b pointer to the second key
- * \return <0 (a < b), 0 (a == b), >0 (a > b)
- */
-int compare_ipv4(void *a, void *b)
-{
-   uint32_t *h1, *h2;
-   h1 = (uint32_t *) a;
-   h2 = (uint32_t *) b;
-   if (*h1 == *h2) {
-      return EQUAL;
-   }
-   else if (*h1 < *h2) {
-      return LESS;
-   }
-
-   return MORE;
-}
-
-/**
- * Comparing function used in b+ tree of servers and attackers. 
- * Compares two IPv6 keys.
- *
- * \param[in] a pointer to the first key
- * \param[in] b pointer to the second key
- * \return <0 (a < b), 0 (a == b), >0 (a > b)
- */
-int compare_ipv6(void *a, void *b)
-{
-   int ret;
-   ret = memcmp(a, b, IP_VERSION_6_BYTES);
-   if (ret == 0) {
-      return EQUAL;
-   } else if (ret < 0) {
-      return LESS;
-   }
-
-   return MORE;
-}
-
 dbf_t::dbf_t(const data_t *flow)
 {
    m_breacher = NULL;
@@ -234,35 +183,23 @@ scan_t::scan_t(const data_t *flow)
    m_ok_count = 0;
 }
 
-bool User::init(char *name) 
+bool User::init(char *name, uint64_t hash)
 {
-   size_t length = strlen(name);
-   m_name = NULL;
+   m_name = name;
+   m_hash = hash;
    m_dbf = NULL;
    m_index = 0;
    m_size = DEFAULT_DBF_START_SIZE;
-   m_name = (char *) malloc((length + 1) * sizeof(char));
    m_com = (bf_t **) malloc(m_size * sizeof(bf_t *));
-   if (!m_name || !m_com) {
+   if (!m_com) {
       fprintf(stderr, "ERROR: User::init - malloc failed.\n");
-      if (m_name) {
-         free(m_name);
-      }
-
-      if (m_com) {
-         free(m_com);
-      }
-
       return false;
    }
 
-   strncpy(m_name, name, length);
-   m_name[length] = '\0';   
-
    return true;
 }
 
-int User::addCom(const data_t *flow, Client *clt, bf_t *bf)
+int User::addCom(const data_t *flow, Client *clt, bf_t *bf, Server *srv)
 {
    if (bf) {
       ASSIGN_MAX(bf->m_time_last, flow->time_stamp);
@@ -274,14 +211,16 @@ int User::addCom(const data_t *flow, Client *clt, bf_t *bf)
       return 0;
    }
 
-   m_com[m_index] = new bf_t(flow, clt, this);
-   if (!m_com[m_index]) {
-      fprintf(stderr, "ERROR: User::addCom - new failed when creating BF structure.\n");
+   bf = srv->createCom(flow, clt, this);
+   if (!bf) {
       return -1;
    }
 
-   clt->addCom(flow, m_com[m_index]);
+   bf->m_usr_index = m_index;
+   m_com[m_index] = bf;
+   clt->addCom(flow, bf);
    m_index++;
+   srv->schedule(&m_timer, bf->m_time_last + g_free_mem_interval + 1);
 
    if (m_index == g_dbf_limit) {
       m_dbf = new dbf_t(flow);
@@ -302,17 +241,6 @@ int User::addCom(const data_t *flow, Client *clt, bf_t *bf)
    return 0;
 }
 
-bf_t* User::findCom(const Client* clt) const
-{
-   for (uint32_t i = 0; i < m_index; i++) {
-      if (clt == m_com[i]->m_source) {
-         return m_com[i];
-      }
-   }
-
-   return NULL;
-}
-
 dbf_t* User::getDBF() const
 {
    return m_dbf;
@@ -332,9 +260,7 @@ int User::evaluateFlows(uint32_t current_time, Server *srv)
          scan_t *scan = bf->m_source->getScan();
 
          if (!(scan && !scan->m_destroy)) {
-            bf->m_source->removeCom(bf);
-            removeCom(bf);
-            delete bf;
+            srv->removeCom(bf);
             j++;
             i--;
          }
@@ -347,7 +273,6 @@ int User::evaluateFlows(uint32_t current_time, Server *srv)
       
       if (m_index == 0) {
          free(m_com);
-         free(m_name);
          return 1;      
       }
 
@@ -360,24 +285,18 @@ int User::evaluateFlows(uint32_t current_time, Server *srv)
          scan_t *scan = bf->m_source->getScan();
          if (scan) {
             if (scan->m_destroy) {
-               bf->m_source->removeCom(bf);
-               removeCom(bf);
-               delete bf;
+               srv->removeCom(bf);
                i--;
             }
          } else if (bf->m_ok_count > g_ok_limit) {
-            bf->m_source->removeCom(bf);
-            removeCom(bf);
-            delete bf;
+            srv->removeCom(bf);
             i--;
          } else if ((current_time > bf->m_time_last) && ((current_time - bf->m_time_last) > g_free_mem_interval)) {
             if (bf->m_attempts >= g_alert_threshold) {
                srv->reportAlert(bf, NULL, NULL, BF);   
             }
 
-            bf->m_source->removeCom(bf);
-            removeCom(bf);
-            delete bf;
+            srv->removeCom(bf);
             i--;  
          }
       }
@@ -386,13 +305,42 @@ int User::evaluateFlows(uint32_t current_time, Server *srv)
    if (m_index == 0) {
       delete m_dbf;
       free(m_com);
-      free(m_name);
       return 1;      
    }
 
    return 0;
 }
 
+bool User::nextCheck(uint32_t *expires) const
+{
+   if (m_dbf) {
+      if (m_dbf->m_destroy) {
+         // remaining communications are released when scans of their clients end
+         return false;
+      }
+
+      *expires = m_dbf->m_time_last + g_free_mem_interval + 1;
+      return true;
+   }
+
+   bool found = false;
+   for (uint32_t i = 0; i < m_index; i++) {
+      const bf_t *bf = m_com[i];
+      const scan_t *scan = bf->m_source->getScan();
+      if (scan && !scan->m_destroy) {
+         continue;
+      }
+
+      uint32_t bf_expires = bf->m_time_last + g_free_mem_interval + 1;
+      if (!found || bf_expires < *expires) {
+         *expires = bf_expires;
+         found = true;
+      }
+   }
+
+   return found;
+}
+
 bool User::extendCom()
 {
    bf_t **tmp = NULL;
@@ -418,42 +366,34 @@ void User::destroy(Server *srv)
          srv->reportAlert(NULL, this, NULL, DBF);   
       }
       
-      for (uint32_t i = 0; i < m_index; i++) {
-         m_com[i]->m_source->removeCom(m_com[i]);
-         delete m_com[i];
+      while (m_index > 0) {
+         srv->removeCom(m_com[m_index - 1]);
       }
 
    } else {
-      for (uint32_t i = 0; i < m_index; i++) {
-         bf_t *bf = m_com[i];
+      while (m_index > 0) {
+         bf_t *bf = m_com[m_index - 1];
          if (bf->isReportable()) {
             srv->reportAlert(bf, NULL, NULL, BF);
          }
 
-         bf->m_source->removeCom(bf);
-         delete bf;
+         srv->removeCom(bf);
       }
    }
 
    delete m_dbf;
    free(m_com);
-   free(m_name);
 }
 
 void User::removeCom(bf_t *bf) {
-   for (uint32_t i = 0; i < m_index; i++) {
-      if (m_com[i] == bf) {
-         if (i + 1 == m_index) {
-            m_com[i] = NULL;
-         } else {
-            m_com[i] = m_com[m_index - 1];
-            m_com[m_index - 1] = NULL;
-         }
-
-         m_index--;
-         return;
-      }
+   uint32_t i = bf->m_usr_index;
+   m_index--;
+   if (i != m_index) {
+      m_com[i] = m_com[m_index];
+      m_com[i]->m_usr_index = i;
    }
+
+   m_com[m_index] = NULL;
 }
 
 void User::getDBFStats(stats_t *stats) const
@@ -476,29 +416,19 @@ void User::getDBFStats(stats_t *stats) const
    stats->m_total_count += m_dbf->m_other_attempts;   
 }
 
-bool Client::init(ip_addr_t *ip, uint16_t port)
+bool Client::init(const ip_addr_t *ip, uint16_t port)
 {
-   m_ip = NULL;
+   m_ip = *ip;
    m_scan = NULL;
    m_index = 0;
    m_port = port;
    m_size = DEFAULT_SCAN_START_SIZE;
    m_com = (bf_t **) malloc(m_size * sizeof(bf_t *));
-   m_ip = (ip_addr_t *) malloc(sizeof(ip_addr_t));
-   if (!m_com || !m_ip) {
+   if (!m_com) {
       fprintf(stderr, "ERROR: Client::init - malloc failed.\n");
-      if (m_com) {
-         free(m_com);
-      }
-
-      if (m_ip) {
-         free(m_ip);
-      }
-
       return false;
    }
-   
-   memcpy(m_ip, ip, sizeof(ip_addr_t));
+
    return true;
 }
 
@@ -509,6 +439,7 @@ scan_t* Client::getScan() const
 
 bool Client::addCom(const data_t *flow, bf_t *bf)
 {
+   bf->m_clt_index = m_index;
    m_com[m_index] = bf;
    m_index++;
 
@@ -519,6 +450,7 @@ bool Client::addCom(const data_t *flow, bf_t *bf)
          return false;
       }
 
+      m_server->schedule(&m_timer, m_scan->m_time_last + g_free_mem_interval + 1);
       return true;
    } 
 
@@ -536,21 +468,21 @@ int Client::getSize() const
    return m_index;
 }
 
-void Client::removeCom(bf_t *bf)
+bf_t* Client::getCom(uint32_t index) const
 {
-   for (uint32_t i = 0; i < m_index; i++) {
-      if (m_com[i] == bf) {
-         if (i + 1 == m_index) {
-            m_com[i] = NULL;
-         } else {
-            m_com[i] = m_com[m_index - 1];
-            m_com[m_index - 1] = NULL;
-         }
+   return m_com[index];
+}
 
-         m_index--;
-         return;
-      }
+void Client::removeCom(bf_t *bf)
+{
+   uint32_t i = bf->m_clt_index;
+   m_index--;
+   if (i != m_index) {
+      m_com[i] = m_com[m_index];
+      m_com[i]->m_clt_index = i;
    }
+
+   m_com[m_index] = NULL;
 }
 
 bool Client::extendCom()
@@ -573,7 +505,6 @@ bool Client::extendCom()
 
 void Client::destroy()
 {
-   free(m_ip);
    delete m_scan;
    free(m_com);
 }
@@ -597,16 +528,16 @@ void Client::getScanStats(stats_t *stats) const
    stats->m_total_count += m_scan->m_other_attempts;
 }
 
-bool Server::init(const data_t *flow)
+bool Server::init(const data_t *flow, TimerWheel *timers)
 {
-   int (*comp_func)(void *, void *);
    uint8_t ip_bytes;
    size_t length;
-   m_users = m_clients = NULL;
+   m_clients = NULL;
+   m_timers = timers;
    m_name_suffix = NULL;
    m_ip = NULL;
    m_port = flow->server_port;
-   length = strlen(flow->name_suffix);
+   length = flow->name_suffix_len;
    m_ipv4 = flow->ipv4;
    m_name_suffix = (char *) malloc(length + 1);
    m_ip = (ip_addr_t *) malloc(sizeof(ip_addr_t));
@@ -615,22 +546,35 @@ bool Server::init(const data_t *flow)
       goto cleanup;
    }
 
-   strncpy(m_name_suffix, flow->name_suffix, length);
+   memcpy(m_name_suffix, flow->name_suffix, length);
    m_name_suffix[length] = '\0';
    memcpy(m_ip, flow->ip_src, sizeof(ip_addr_t));
 
    if (m_ipv4) {
-      comp_func = &compare_ipv4;
       ip_bytes = IP_VERSION_4_BYTES;
    } else {
-      comp_func = &compare_ipv6;
       ip_bytes = IP_VERSION_6_BYTES;
    }
 
-   m_users = bpt_init(5, &compare_user_name, sizeof(User), MAX_LENGTH_USER_NAME);
-   m_clients = bpt_init(5, comp_func, sizeof(Client), ip_bytes);
-   if (!m_users || !m_clients) {
-      fprintf(stderr, "ERROR: Server::init - bpt_init returned NULL.\n");
+   m_user_pool.init(sizeof(User));
+   m_client_pool.init(sizeof(Client));
+   m_com_pool.init(sizeof(bf_t));
+   m_names.init();
+
+   if (!m_users.init(DEFAULT_NAME_TABLE_SIZE)) {
+      goto cleanup;
+   }
+
+   if (!m_coms.init(DEFAULT_PAIR_INDEX_SIZE)) {
+      m_users.destroy();
+      goto cleanup;
+   }
+
+   m_clients = ip_table_init(DEFAULT_CLIENT_TABLE_SIZE, ip_bytes, sizeof(Client *));
+   if (!m_clients) {
+      fprintf(stderr, "ERROR: Server::init - ip_table_init returned NULL.\n");
+      m_users.destroy();
+      m_coms.destroy();
       goto cleanup;
    }
 
@@ -647,16 +591,6 @@ cleanup:
       m_ip = NULL;
    }
 
-   if (m_users) {
-      bpt_clean(m_users);
-      m_users = NULL;
-   }
-
-   if (m_clients) {
-      bpt_clean(m_clients);
-      m_clients = NULL;
-   }
-
    return false;
 }
 
@@ -705,6 +639,14 @@ uint64_t Server::createId(uint32_t time_first)
 }*/
 
 void Server::reportAlert(bf_t *bf, User *usr, Client *clt, event_type_t event)
+{
+   // servers of different workers report concurrently
+   pthread_mutex_lock(&g_alert_lock);
+   sendAlert(bf, usr, clt, event);
+   pthread_mutex_unlock(&g_alert_lock);
+}
+
+void Server::sendAlert(bf_t *bf, User *usr, Client *clt, event_type_t event)
 {
    ostringstream ss;
    ur_set(alert_tmplt, alert_rec, F_SBFD_EVENT_TYPE, event);
@@ -727,7 +669,7 @@ void Server::reportAlert(bf_t *bf, User *usr, Client *clt, event_type_t event)
       ur_set(alert_tmplt, alert_rec, F_SBFD_CEASE_TIME, ur_time_from_sec_msec(bf->m_time_last, 0));
       ur_set(alert_tmplt, alert_rec, F_SBFD_ATTEMPTS, bf->m_attempts);
       ur_set(alert_tmplt, alert_rec, F_SBFD_AVG_ATTEMPTS, bf->m_attempts);
-      ur_set(alert_tmplt, alert_rec, F_SBFD_SOURCE, *(bf->m_source->m_ip));
+      ur_set(alert_tmplt, alert_rec, F_SBFD_SOURCE, bf->m_source->m_ip);
       ur_set(alert_tmplt, alert_rec, F_SBFD_PROTOCOL, bf->m_protocol);
       ur_set(alert_tmplt, alert_rec, F_SBFD_LINK_BIT_FIELD, bf->m_link_bit_field);
       ur_set(alert_tmplt, alert_rec, F_SRC_PORT, bf->m_source->m_port);
@@ -749,7 +691,7 @@ void Server::reportAlert(bf_t *bf, User *usr, Client *clt, event_type_t event)
       dbf_t *dbf = usr->getDBF();
 
       if (!dbf->m_breacher) {
-         ur_set(alert_tmplt, alert_rec, F_SBFD_SOURCE, *(stats->m_clt->m_ip));
+         ur_set(alert_tmplt, alert_rec, F_SBFD_SOURCE, stats->m_clt->m_ip);
          ur_set(alert_tmplt, alert_rec, F_SBFD_BREACH_TIME, 0);
       } else {
          ur_set(alert_tmplt, alert_rec, F_SBFD_SOURCE, *(dbf->m_breacher));
@@ -798,7 +740,7 @@ void Server::reportAlert(bf_t *bf, User *usr, Client *clt, event_type_t event)
       ur_set(alert_tmplt, alert_rec, F_SBFD_CEASE_TIME, ur_time_from_sec_msec(scan->m_time_last, 0));
       ur_set(alert_tmplt, alert_rec, F_SBFD_ATTEMPTS, stats->m_total_count);
       ur_set(alert_tmplt, alert_rec, F_SBFD_AVG_ATTEMPTS, stats->m_avg_count);
-      ur_set(alert_tmplt, alert_rec, F_SBFD_SOURCE, *(clt->m_ip));
+      ur_set(alert_tmplt, alert_rec, F_SBFD_SOURCE, clt->m_ip);
       ur_set(alert_tmplt, alert_rec, F_SRC_PORT, clt->m_port);
       ur_set(alert_tmplt, alert_rec, F_SBFD_PROTOCOL, stats->m_protocol);
       ur_set(alert_tmplt, alert_rec, F_SBFD_LINK_BIT_FIELD, stats->m_link_bit_field);      
@@ -818,7 +760,7 @@ void Server::reportAlert(bf_t *bf, User *usr, Client *clt, event_type_t event)
 
 bool Server::insertSourceAndTarget(const data_t *flow, User *usr, Client *clt)
 {
-   bf_t *bf = usr->findCom(clt);
+   bf_t *bf = findCom(usr, clt);
    if (flow->status_code == SIP_STATUS_OK) {
       if (!bf) {
          return true;
@@ -828,9 +770,7 @@ bool Server::insertSourceAndTarget(const data_t *flow, User *usr, Client *clt)
          bf->m_ok_count++;
          ASSIGN_MAX(bf->m_time_last, flow->time_stamp);
          if (bf->m_ok_count > g_ok_limit) {
-            usr->removeCom(bf);
-            clt->removeCom(bf);
-            delete bf;
+            removeCom(bf);
          }
       } else if (bf->m_attempts >= g_alert_threshold) {
          bf->m_attempts++;
@@ -839,15 +779,13 @@ bool Server::insertSourceAndTarget(const data_t *flow, User *usr, Client *clt)
          bf->m_ok_count++;
          /*	alertTimeMachine(flow->ip_dst);	*/
       } else {
-         usr->removeCom(bf);
-         clt->removeCom(bf);
-         delete bf;
+         removeCom(bf);
       }
 
       return true;
    }
    
-   int ret = usr->addCom(flow, clt, bf);
+   int ret = usr->addCom(flow, clt, bf, this);
    switch (ret) {
       case 1:
       case 0:
@@ -863,8 +801,9 @@ bool Server::insertFlow(const data_t *flow)
 {
    int dst_ip = ip_get_v4_as_int(flow->ip_dst);
    void *tree_key = flow->ipv4 ? (void *) (&dst_ip) : (void *) flow->ip_dst;
-   User *usr = (User *) bpt_search(m_users, flow->user);
-   Client *clt = (Client *) bpt_search(m_clients, tree_key);
+   User *usr = (User *) m_users.find(flow->user_hash, flow->user, flow->user_len);
+   Client **node = (Client **) ip_table_search(m_clients, tree_key);
+   Client *clt = node ? *node : NULL;
 
    if (usr && clt) {
       if (clt->getScan()) {
@@ -882,7 +821,7 @@ bool Server::insertFlow(const data_t *flow)
       if (clt->getScan()) {
          updateScan(flow, clt, usr);
       } else {
-         usr = createUserNode(flow->user);
+         usr = createUserNode(flow);
          if (!usr) {
             return false;
          }
@@ -906,10 +845,9 @@ bool Server::insertFlow(const data_t *flow)
          return false;
       }
 
-      usr = createUserNode(flow->user);
+      usr = createUserNode(flow);
       if (!usr) {
-         clt->destroy();
-         bpt_item_del(m_clients, tree_key);
+         removeClientNode(clt);
          return false;
       }
 
@@ -934,13 +872,14 @@ void Server::updateDBF(const data_t *flow, Client *clt, User *usr)
          /*	alertTimeMachine(flow->ip_dst); */
       } else if(dbf->m_ok_count > g_ok_limit) {
          dbf->m_destroy = true;
+         scheduleNow(&usr->m_timer);
       }
    }
 
    if (!clt) {
       dbf->m_other_attempts++;
    } else {
-      bf_t *bf = usr->findCom(clt);
+      bf_t *bf = findCom(usr, clt);
       if (bf) {
          ASSIGN_MAX(bf->m_time_last, flow->time_stamp);
          bf->m_attempts++;            
@@ -963,13 +902,14 @@ void Server::updateScan(const data_t *flow, Client *clt, User *usr)
       scan->m_ok_count++;
       if (scan->m_ok_count > g_ok_limit) {
          scan->m_destroy = true;
+         scheduleNow(&clt->m_timer);
       }
    }
 
    if (!usr) {
       scan->m_other_attempts++;
    } else {
-      bf_t *bf = usr->findCom(clt);
+      bf_t *bf = findCom(usr, clt);
       if (bf) {
          if (flow->status_code == SIP_STATUS_OK && bf->m_time_breach == 0) {
             bf->m_time_breach = flow->time_stamp;
@@ -987,190 +927,226 @@ void Server::updateScan(const data_t *flow, Client *clt, User *usr)
 
 Client* Server::createClientNode(void *tree_key, ip_addr_t *ip, uint16_t port)
 {
-   Client *clt = (Client *) bpt_insert(m_clients, tree_key);
-   if (clt) {
-      if (!clt->init(ip, port)) {
-         bpt_item_del(m_clients, tree_key);
-         clt = NULL;
-      }
-   } else {
-      fprintf(stderr, "ERROR: Server::createClientNode - bpt_insert returned NULL.\n");
+   Client *clt = (Client *) m_client_pool.alloc();
+   if (!clt) {
+      return NULL;
+   }
+
+   if (!clt->init(ip, port)) {
+      m_client_pool.release(clt);
+      return NULL;
    }
 
+   Client **node = (Client **) ip_table_search_or_insert(m_clients, tree_key);
+   if (!node) {
+      fprintf(stderr, "ERROR: Server::createClientNode - ip_table_search_or_insert returned NULL.\n");
+      clt->destroy();
+      m_client_pool.release(clt);
+      return NULL;
+   }
+
+   // checked with the next advance of time, client without any communication is released
+   *node = clt;
+   clt->m_server = this;
+   m_timers->initNode(&clt->m_timer, TIMER_CLIENT, clt);
+   scheduleNow(&clt->m_timer);
+
    return clt;
 }
 
-User* Server::createUserNode(char *name)
+User* Server::createUserNode(const data_t *flow)
 {
-   User *usr = (User *) bpt_insert(m_users, name);
-   if (usr) {
-      if (!usr->init(name)) {
-         bpt_item_del(m_users, name);
-         usr = NULL;
-      }
-   } else {
-      fprintf(stderr, "ERROR: Server::createUserNode - bpt_insert returned NULL.\n");
-   }      
+   User *usr = (User *) m_user_pool.alloc();
+   if (!usr) {
+      return NULL;
+   }
+
+   // the only place where the user name is copied out of the received record
+   char *name = m_names.copy(flow->user, flow->user_len);
+   if (!name) {
+      m_user_pool.release(usr);
+      return NULL;
+   }
+
+   if (!usr->init(name, flow->user_hash)) {
+      m_names.release(name);
+      m_user_pool.release(usr);
+      return NULL;
+   }
 
+   usr->m_server = this;
+   m_timers->initNode(&usr->m_timer, TIMER_USER, usr);
+
+   if (!m_users.insert(usr->m_hash, usr->m_name, usr)) {
+      usr->destroy(this);
+      m_names.release(name);
+      m_user_pool.release(usr);
+      return NULL;
+   }
+
+   scheduleNow(&usr->m_timer);
    return usr;
 }
 
-bool Server::isEmpty() const
+void Server::removeUserNode(User *usr)
 {
-   if (bpt_item_cnt(m_users) == 0 && bpt_item_cnt(m_clients) == 0) {
-      return true;
-   }
+   // the user has already released its communications
+   m_timers->remove(&usr->m_timer);
+   m_users.remove(usr->m_hash, usr);
+   m_names.release(usr->m_name);
+   m_user_pool.release(usr);
+}
 
-   return false;
+void Server::removeClientNode(Client *clt)
+{
+   ip_addr_t ip = clt->m_ip;
+   int dst_ip = ip_get_v4_as_int(&ip);
+   void *tree_key = m_ipv4 ? (void *) (&dst_ip) : (void *) &ip;
+
+   m_timers->remove(&clt->m_timer);
+   clt->destroy();
+   ip_table_remove(m_clients, tree_key);
+   m_client_pool.release(clt);
 }
 
-bool Server::evaluateFlows(const uint32_t current_time)
+bf_t* Server::findCom(const User *usr, const Client *clt) const
 {
-   int is_there_next;
-   bpt_list_item_t *b_item;
+   return (bf_t *) m_coms.find(usr, clt);
+}
 
-   b_item = bpt_list_init(m_clients);
-   if (!b_item) {
-      fprintf(stderr, "ERROR: Server::evaluateFlows - bpt_list_init returned NULL.\n");
-      return false;
+bf_t* Server::createCom(const data_t *flow, Client *clt, User *usr)
+{
+   void *mem = m_com_pool.alloc();
+   if (!mem) {
+      return NULL;
    }
 
-   is_there_next = bpt_list_start(m_clients, b_item);
-   while (is_there_next == 1) {
-      Client *clt = (Client *) (b_item->value);
-      scan_t *scan = (scan_t *) clt->getScan();
+   bf_t *bf = new (mem) bf_t(flow, clt, usr);
+   if (!m_coms.insert(usr, clt, bf)) {
+      m_com_pool.release(bf);
+      return NULL;
+   }
 
-      if (scan && !scan->m_destroy && (current_time > scan->m_time_last) && ((current_time - scan->m_time_last) > g_free_mem_interval)) {
-         reportAlert(NULL, NULL, clt, SCAN);
-         scan->m_destroy = true;
-      }
+   return bf;
+}
 
-      is_there_next = bpt_list_item_next(m_clients, b_item);
-   }
+void Server::removeCom(bf_t *bf)
+{
+   Client *clt = bf->m_source;
 
-   bpt_list_clean(b_item);
+   m_coms.remove(bf->m_target, bf->m_source);
+   clt->removeCom(bf);
+   bf->m_target->removeCom(bf);
+   m_com_pool.release(bf);
 
-   // create a list of items in the tree and iterate through it
-   b_item = bpt_list_init(m_users);
-   if (!b_item) {
-      fprintf(stderr, "ERROR: Server::evaluateFlows - bpt_list_init returned NULL.\n");
-      return false;
+   if (clt->getSize() == 0) {
+      scheduleNow(&clt->m_timer);
    }
+}
 
-   is_there_next = bpt_list_start(m_users, b_item);
-   while (is_there_next == 1) {
-      User *usr = (User *) (b_item->value);
-      int ret = usr->evaluateFlows(current_time, this);
-      if (ret == 1) {
-         is_there_next = bpt_list_item_del(m_users, b_item);   
-      } else {
-         is_there_next = bpt_list_item_next(m_users, b_item);
-      }
-      
+void Server::schedule(timer_node_t *node, uint32_t expires)
+{
+   // timers are only moved earlier, a check which comes too early just schedules the next one
+   if (!m_timers->pending(node) || expires < node->expires) {
+      m_timers->add(node, expires);
    }
+}
 
-   bpt_list_clean(b_item);
+void Server::scheduleNow(timer_node_t *node)
+{
+   schedule(node, m_timers->now());
+}
 
-   b_item = bpt_list_init(m_clients);
-   if (!b_item) {
-      fprintf(stderr, "ERROR: Server::evaluateFlows - bpt_list_init returned NULL.\n");
-      return false;
+bool Server::isEmpty() const
+{
+   if (m_users.count() == 0 && m_clients->count == 0) {
+      return true;
    }
 
-   is_there_next = bpt_list_start(m_clients, b_item);
-   while (is_there_next == 1) {
-      Client *clt = (Client *) (b_item->value);
-
-      if (clt->getSize() == 0) {
-         clt->destroy();
-         is_there_next = bpt_list_item_del(m_clients, b_item);
-      } else {
-         is_there_next = bpt_list_item_next(m_clients, b_item);
-      }
-   }
+   return false;
+}
 
-   bpt_list_clean(b_item);
+void Server::checkUser(User *usr, uint32_t current_time)
+{
+   uint32_t expires;
 
-   return true;
+   if (usr->evaluateFlows(current_time, this) == 1) {
+      removeUserNode(usr);
+   } else if (usr->nextCheck(&expires)) {
+      m_timers->add(&usr->m_timer, expires);
+   }
 }
 
-void Server::cleanStructures()
+void Server::checkClient(Client *clt, uint32_t current_time)
 {
-   int is_there_next;
-   bpt_list_item_t *b_item;
+   scan_t *scan = clt->getScan();
 
-   b_item = bpt_list_init(m_clients);
-   if (!b_item) {
-      fprintf(stderr, "ERROR: Server::cleanStructures - bpt_list_init returned NULL.\n");
-      return;
+   if (scan && !scan->m_destroy && (current_time > scan->m_time_last) && ((current_time - scan->m_time_last) > g_free_mem_interval)) {
+      reportAlert(NULL, NULL, clt, SCAN);
+      scan->m_destroy = true;
    }
 
-   is_there_next = bpt_list_start(m_clients, b_item);
-   while (is_there_next == 1) {
-      Client *clt = (Client *) (b_item->value);
-      if (clt->getScan() && !clt->getScan()->m_destroy) {
-         reportAlert(NULL, NULL, clt, SCAN);
+   if (clt->getSize() == 0) {
+      removeClientNode(clt);
+   } else if (scan && scan->m_destroy) {
+      // users drop their communications with the client once the scan is over
+      for (int i = 0; i < clt->getSize(); i++) {
+         scheduleNow(&clt->getCom(i)->m_target->m_timer);
       }
-
-      is_there_next = bpt_list_item_next(m_clients, b_item);
+   } else if (scan) {
+      m_timers->add(&clt->m_timer, scan->m_time_last + g_free_mem_interval + 1);
    }
+}
 
-   bpt_list_clean(b_item);
+void Server::cleanStructures()
+{
+   uint32_t index;
 
-   // create a list of items in the tree and iterate through it
-   b_item = bpt_list_init(m_users);
-   if (!b_item) {
-      fprintf(stderr, "ERROR: Server::cleanStructures - bpt_list_init returned NULL.\n");
-      return;
+   for (index = ip_table_first(m_clients); index < m_clients->size; index = ip_table_next(m_clients, index)) {
+      Client *clt = *(Client **) ip_table_value(m_clients, index);
+      if (clt->getScan() && !clt->getScan()->m_destroy) {
+         reportAlert(NULL, NULL, clt, SCAN);
+      }
    }
 
-   is_there_next = bpt_list_start(m_users, b_item);
-   while (is_there_next == 1) {
-      User *usr = (User *) (b_item->value);
+   while (m_users.count() > 0) {
+      User *usr = (User *) m_users.get(m_users.count() - 1);
       usr->destroy(this);
-      is_there_next = bpt_list_item_del(m_users, b_item);
+      removeUserNode(usr);
    }
 
-   bpt_list_clean(b_item);
-
-   b_item = bpt_list_init(m_clients);
-   if (!b_item) {
-      fprintf(stderr, "ERROR: Server::cleanStructures - bpt_list_init returned NULL.\n");
-      return;
-   }
-
-   is_there_next = bpt_list_start(m_clients, b_item);
-   while (is_there_next == 1) {
-      Client *clt = (Client *) (b_item->value);
+   for (index = ip_table_first(m_clients); index < m_clients->size; index = ip_table_next(m_clients, index)) {
+      Client *clt = *(Client **) ip_table_value(m_clients, index);
+      m_timers->remove(&clt->m_timer);
       clt->destroy();
-      is_there_next = bpt_list_item_del(m_clients, b_item);
+      m_client_pool.release(clt);
+      ip_table_delete(m_clients, index);
    }
-
-   bpt_list_clean(b_item);
 }
 
 void Server::destroy()
 {
-   bpt_clean(m_users);
-   bpt_clean(m_clients);
+   m_users.destroy();
+   m_coms.destroy();
+   ip_table_destroy(m_clients);
+   m_user_pool.destroy();
+   m_client_pool.destroy();
+   m_com_pool.destroy();
+   m_names.destroy();
    free(m_ip);
    free(m_name_suffix);
 }
 
 bool Detector::init()
 {
-   m_ipv4tree = bpt_init(5, &compare_ipv4, sizeof(Server), IP_VERSION_4_BYTES);
-   m_ipv6tree = bpt_init(5, &compare_ipv6, sizeof(Server), IP_VERSION_6_BYTES);
-   if (!m_ipv4tree || !m_ipv6tree) {
-      fprintf(stderr, "ERROR: Detector::init - bpt_init returned NULL.\n");
-      if (m_ipv4tree) {
-         bpt_clean(m_ipv4tree);
-      }
-
-      if (m_ipv6tree) {
-         bpt_clean(m_ipv6tree);
-      }
-
+   m_timers.init();
+   m_time_last_check = 0;
+   m_ipv4servers = ip_table_init(DEFAULT_SERVER_TABLE_SIZE, IP_VERSION_4_BYTES, sizeof(Server *));
+   m_ipv6servers = ip_table_init(DEFAULT_SERVER_TABLE_SIZE, IP_VERSION_6_BYTES, sizeof(Server *));
+   if (!m_ipv4servers || !m_ipv6servers) {
+      fprintf(stderr, "ERROR: Detector::init - ip_table_init returned NULL.\n");
+      ip_table_destroy(m_ipv4servers);
+      ip_table_destroy(m_ipv6servers);
       return false;
    }
 
@@ -1184,217 +1160,239 @@ bool Detector::insertFlow(const data_t *flow)
       return false;
    }
 
-   bpt_t *server_tree;
+   ip_table_t *servers;
    void *tree_key;
    int src_ip;
 
+   // start the clock of the timers at the time of the first message
+   if (m_timers.now() == 0) {
+      m_timers.advance(flow->time_stamp, &Detector::timerExpired, this);
+   }
+
    if (flow->ipv4) {
       src_ip = ip_get_v4_as_int(flow->ip_src);
       tree_key = &src_ip;
-      server_tree = m_ipv4tree;
+      servers = m_ipv4servers;
    } else {
       tree_key = flow->ip_src;
-      server_tree = m_ipv6tree;
+      servers = m_ipv6servers;
    }
 
-   Server *srv = (Server *) bpt_search(server_tree, tree_key);
+   Server **node = (Server **) ip_table_search(servers, tree_key);
+   Server *srv = node ? *node : NULL;
    if (!srv) {
       if (flow->status_code == SIP_STATUS_OK) {
          return true;
       }
 
-      srv = (Server *) bpt_insert(server_tree, tree_key);
-      if (srv) {
-         if (!srv->init(flow)) {
-            bpt_item_del(server_tree, tree_key);
-            return false;
-         }
-      } else {
-         fprintf(stderr, "ERROR: Detector::insertFlow - bpt_insert returned NULL.\n");
+      // servers are referenced by their clients and users, so they are
+      // allocated separately and the table keeps only pointers to them
+      srv = (Server *) calloc(1, sizeof(Server));
+      if (!srv) {
+         fprintf(stderr, "ERROR: Detector::insertFlow - calloc failed.\n");
          return false;
       }
-   }
-
-   return srv->insertFlow(flow);
-}
-
-bool Detector::evaluateFlows(const uint32_t current_time)
-{
-   static uint32_t time_last_check = 0;
-
-   // Check whether it is time for another memory sweep
-   if (current_time >= time_last_check && ((current_time - time_last_check) > g_check_mem_interval)) {
-      int is_there_next;
-      bpt_list_item_t *b_item;
-
-      // create a list of items in the tree and iterate through it
-      b_item = bpt_list_init(m_ipv4tree);
-      if (!b_item) {
-         fprintf(stderr, "ERROR: Detector::evaluateFlows - bpt_list_init returned NULL.\n");
+      if (!srv->init(flow, &m_timers)) {
+         free(srv);
          return false;
       }
 
-      is_there_next = bpt_list_start(m_ipv4tree, b_item);
-      while (is_there_next == 1) {
-         Server *srv = (Server *) (b_item->value);
-         if (!srv->evaluateFlows(current_time)) {
-            bpt_list_clean(b_item);
-            return false;
-         }
-
-         if (srv->isEmpty()) {
-            srv->destroy();
-            is_there_next = bpt_list_item_del(m_ipv4tree, b_item);
-         } else {
-            is_there_next = bpt_list_item_next(m_ipv4tree, b_item);
-         }
-      }
-
-      bpt_list_clean(b_item);
-
-      b_item = bpt_list_init(m_ipv6tree);
-      if (!b_item) {
-         fprintf(stderr, "ERROR: Detector::evaluateFlows - bpt_list_init returned NULL.\n");
+      node = (Server **) ip_table_search_or_insert(servers, tree_key);
+      if (!node) {
+         fprintf(stderr, "ERROR: Detector::insertFlow - ip_table_search_or_insert returned NULL.\n");
+         srv->destroy();
+         free(srv);
          return false;
       }
+      *node = srv;
+   }
 
-      is_there_next = bpt_list_start(m_ipv6tree, b_item);
-      while (is_there_next == 1) {
-         Server *srv = (Server *) (b_item->value);
-         if (!srv->evaluateFlows(current_time)) {
-            bpt_list_clean(b_item);
-            return false;
-         }
-
-         if (srv->isEmpty()) {
-            srv->destroy();
-            is_there_next = bpt_list_item_del(m_ipv6tree, b_item);
-         } else {
-            is_there_next = bpt_list_item_next(m_ipv6tree, b_item);
-         }
-      }
+   return srv->insertFlow(flow);
+}
 
-      bpt_list_clean(b_item);
-      time_last_check = current_time;
+bool Detector::evaluateFlows(const uint32_t current_time)
+{
+   // Check whether it is time for another check of ceased attacks, only users and clients with expired timers are evaluated
+   if (current_time >= m_time_last_check && ((current_time - m_time_last_check) > g_check_mem_interval)) {
+      m_timers.advance(current_time, &Detector::timerExpired, this);
+      m_time_last_check = current_time;
    }
 
    return true;
 }
 
-void Detector::destroy()
+void Detector::timerExpired(timer_node_t *node, uint32_t current_time, void *arg)
 {
-   int is_there_next;
-   bpt_list_item_t *b_item;
+   Detector *det = (Detector *) arg;
+   Server *srv;
 
-   // create a list of items in the tree and iterate through it
-   b_item = bpt_list_init(m_ipv4tree);
-   if (!b_item) {
-      fprintf(stderr, "ERROR: Detector::destroy - bpt_list_init returned NULL.\n");
-      return;
+   if (node->type == TIMER_USER) {
+      User *usr = (User *) node->data;
+      srv = usr->m_server;
+      srv->checkUser(usr, current_time);
+   } else {
+      Client *clt = (Client *) node->data;
+      srv = clt->m_server;
+      srv->checkClient(clt, current_time);
    }
 
-   is_there_next = bpt_list_start(m_ipv4tree, b_item);
-   while (is_there_next == 1) {
-      Server *srv = (Server *) (b_item->value);
-      srv->cleanStructures();
-      srv->destroy();
-      is_there_next = bpt_list_item_del(m_ipv4tree, b_item);
+   if (srv->isEmpty()) {
+      det->removeServer(srv);
    }
+}
 
-   bpt_list_clean(b_item);
-
-   b_item = bpt_list_init(m_ipv6tree);
-   if (!b_item) {
-      fprintf(stderr, "ERROR: Detector::destroy - bpt_list_init returned NULL.\n");
-      return;
+void Detector::removeServer(Server *srv)
+{
+   ip_addr_t ip = *srv->m_ip;
+   bool ipv4 = ip_is4(&ip);
+   int src_ip = ip_get_v4_as_int(&ip);
+
+   srv->destroy();
+   free(srv);
+   if (ipv4) {
+      ip_table_remove(m_ipv4servers, &src_ip);
+   } else {
+      ip_table_remove(m_ipv6servers, &ip);
    }
+}
 
-   is_there_next = bpt_list_start(m_ipv6tree, b_item);
-   while (is_there_next == 1) {
-      Server *srv = (Server *) (b_item->value);
-      srv->cleanStructures();
-      srv->destroy();
-      is_there_next = bpt_list_item_del(m_ipv6tree, b_item);
-   }
+void Detector::destroy()
+{
+   ip_table_t *tables[2] = { m_ipv4servers, m_ipv6servers };
+   uint32_t index;
 
-   bpt_list_clean(b_item);
-   bpt_clean(m_ipv4tree);
-   bpt_clean(m_ipv6tree);
+   for (int i = 0; i < 2; i++) {
+      for (index = ip_table_first(tables[i]); index < tables[i]->size; index = ip_table_next(tables[i], index)) {
+         Server *srv = *(Server **) ip_table_value(tables[i], index);
+         srv->cleanStructures();
+         srv->destroy();
+         free(srv);
+         ip_table_delete(tables[i], index);
+      }
+      ip_table_destroy(tables[i]);
+   }
 }
 
 /**
  * \brief Cut first 4 characters ("sip:") or 5 characters ("sips:") from an input string and ignore ';' or '?' + string after it.
  *
- * \param[in] input_str pointer to the input string
- * \param[in,out] str_len length of the string
- * \param[out] output_str pointer to the stripped string
- * \return 0 if the input string was stripped, -1 otherwise
+ * The input string is not modified, user name and suffix point into it. The user name
+ * is truncated to MAX_LENGTH_USER_NAME characters and its hash is stored to the flow.
+ *
+ * \param[in] input_str pointer to the input string (not null terminated)
+ * \param[in] str_len length of the string
+ * \param[out] flow user name and suffix of the message are stored here
+ * \return 0 if the input string was parsed, -1 otherwise
  */
-int parse_sip_from(char *input_str, int str_len, char **user, char **suffix)
+int parse_sip_from(const char *input_str, int str_len, data_t *flow)
 {
+   const char *user;
+
    if (str_len >= 4 && (strncmp(input_str, "sip:", 4) == 0)) {
 
       // input string beginning with "sip:"
-      *user = input_str + 4 * sizeof (char);
+      user = input_str + 4;
       str_len -= 4;
    } else {
       if (str_len >= 5 && (strncmp(input_str, "sips:", 5) == 0)) {
 
          // input string beginning with "sips:"
-         *user = input_str + 5 * sizeof (char);
+         user = input_str + 5;
          str_len -= 5;
       } else {
          return -1;
       }
    }
 
-   *suffix = strchr(*user, '@');
-   if ((*suffix) == NULL || &((*user)[str_len]) == (*suffix)) {
+   const char *at = (const char *) memchr(user, '@', str_len);
+   if (at == NULL || memchr(user, '\0', at - user) != NULL) {
       return -1;
    }
 
-   (*suffix)[0] = '\0';
-   (*suffix) = (*suffix) + 1;
-   str_len -= (*suffix) - (*user);
+   size_t user_len = at - user;
+   const char *suffix = at + 1;
+   str_len -= suffix - user;
 
    int i = 0;
    while (i < str_len) {
-      if (((*suffix)[i] == ';') || ((*suffix)[i] == '?')) {
-         (*suffix)[i] = '\0';
+      if (suffix[i] == ';' || suffix[i] == '?' || suffix[i] == '\0') {
          break;
       }
 
       i++;
    }
 
-   if(strlen(*user) >= MAX_LENGTH_USER_NAME) {
-      (*user)[MAX_LENGTH_USER_NAME] = '\0';
+   if (user_len > MAX_LENGTH_USER_NAME) {
+      user_len = MAX_LENGTH_USER_NAME;
    }
 
+   flow->user = user;
+   flow->user_len = user_len;
+   flow->name_suffix = suffix;
+   flow->name_suffix_len = i;
+   flow->user_hash = hash_user_name(user, user_len);
+
    return 0;
 }
 
+/** \brief Offsets of the fields of UNIREC_INPUT_TEMPLATE in input_record_t. */
+static const ur_fixed_field_t INPUT_RECORD_FIELDS[] = {
+   UR_FIXED_FIELD(input_record_t, dst_ip, F_DST_IP),
+   UR_FIXED_FIELD(input_record_t, src_ip, F_SRC_IP),
+   UR_FIXED_FIELD(input_record_t, link_bit_field, F_LINK_BIT_FIELD),
+   UR_FIXED_FIELD(input_record_t, time_first, F_TIME_FIRST),
+   UR_FIXED_FIELD(input_record_t, dst_port, F_DST_PORT),
+   UR_FIXED_FIELD(input_record_t, sip_msg_type, F_SIP_MSG_TYPE),
+   UR_FIXED_FIELD(input_record_t, sip_status_code, F_SIP_STATUS_CODE),
+   UR_FIXED_FIELD(input_record_t, src_port, F_SRC_PORT),
+   UR_FIXED_FIELD(input_record_t, protocol, F_PROTOCOL),
+   UR_FIXED_FIELD(input_record_t, sip_calling_party, F_SIP_CALLING_PARTY),
+   UR_FIXED_FIELD(input_record_t, sip_cseq, F_SIP_CSEQ),
+};
+
 /**
- * \brief Recover string from Unirec field with variable length.
+ * \brief Check whether records of the negotiated template can be read as input_record_t.
  *
- * \param[in] unirec_field_id id of the Unirec field
- * \param[in] max_length maximum possible length of the recovered string
  * \param[in] in_tmplt Unirec input template
- * \param[out] string_output pointer to the recovered string
- * \param[out] string_len length of the recovered string
+ * \return true when the template has exactly the fields of UNIREC_INPUT_TEMPLATE
  */
-void get_string_from_unirec(int unirec_field_id, int max_length, const void *in_rec,
-                            const ur_template_t *in_tmplt, char *string_output, int *string_len)
+static bool is_input_record(const ur_template_t *in_tmplt)
 {
-   // determine length of the string
-   *string_len = ur_get_var_len(in_tmplt, in_rec, unirec_field_id);
-   if (*string_len > max_length) {
-      *string_len = max_length;
+   return ur_fixed_match(in_tmplt, INPUT_RECORD_FIELDS, UR_FIXED_FIELD_COUNT(INPUT_RECORD_FIELDS), sizeof(input_record_t));
+}
+
+/** \brief Value of a field of the received record, see ur_fixed_get(). */
+#define IN_GET(member, field_id) ur_fixed_get(in_fixed, input_record_t, member, in_tmplt, in_rec, field_id)
+
+/**
+ * \brief Get string view of Unirec field with variable length (not null terminated),
+ * its length is limited to max_length.
+ */
+#define IN_GET_STRING(member, field_id, max_length, string_len) \
+   (*(string_len) = ur_fixed_var_len(in_fixed, input_record_t, member, in_tmplt, in_rec, field_id), \
+    *(string_len) = (*(string_len) > (max_length) ? (max_length) : *(string_len)), \
+    ur_fixed_var_ptr(in_fixed, input_record_t, member, in_tmplt, in_rec, field_id))
+
+/**
+ * \brief Check whether CSEQ of the message is in format "<number> REGISTER".
+ *
+ * \param[in] cseq pointer to the CSEQ string (not null terminated)
+ * \param[in] cseq_len length of the string
+ * \return true if "REG" is found in the string, false otherwise
+ */
+bool is_register_cseq(const char *cseq, int cseq_len)
+{
+   for (int i = 0; i + 3 <= cseq_len; i++) {
+      if (cseq[i] == '\0') {
+         break;
+      }
+
+      if (cseq[i] == 'R' && cseq[i + 1] == 'E' && cseq[i + 2] == 'G') {
+         return true;
+      }
    }
 
-   // copy string and set terminating null character
-   memcpy(string_output, ur_get_ptr_by_id(in_tmplt, in_rec, unirec_field_id), *string_len);
-   string_output[*string_len] = '\0';
+   return false;
 }
 
 int main(int argc, char **argv)
@@ -1404,7 +1402,9 @@ int main(int argc, char **argv)
    int exit_value = 0;
    signed char opt;
    uint16_t msg_type;
-   char sip_from_orig[MAX_LENGTH_SIP_FROM + 1], sip_cseq[MAX_LENGTH_CSEQ + 1];
+   const char *sip_cseq;
+   data_t sip_data;                       // reused for every received message
+   bool in_fixed = false;                 // records are read as input_record_t
  
    struct sigaction sig_action;
    sig_action.sa_handler = signal_handler;
@@ -1415,6 +1415,9 @@ int main(int argc, char **argv)
    sigaction(SIGTERM,&sig_action,NULL);
 
    Detector *det = NULL;
+   Worker *workers = NULL;
+   uint32_t started = 0;                  // number of running workers
+   uint32_t time_last_tick = 0;
 
    // initialize libtrap
    INIT_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS)
@@ -1428,6 +1431,7 @@ int main(int argc, char **argv)
       exit_value = -1;
       goto cleanup;
    }
+   in_fixed = is_input_record(in_tmplt);
 
    alert_tmplt = ur_create_output_template(0, UNIREC_ALERT_TEMPLATE, NULL);
    if (alert_tmplt == NULL){
@@ -1503,33 +1507,68 @@ int main(int argc, char **argv)
          }
          break;
 
+      case 't':
+         if (sscanf(optarg, "%" SCNu32 "", &g_worker_count) != 1) {
+            fprintf(stderr, "Error: irrational value of worker threads count.\n");
+            goto cleanup;
+         }
+         break;
+
       default:
          fprintf(stderr, "Error: unsupported parameter.\n");
          goto cleanup;
       }
    }
 
-   // initialize IPv4 and IPv6 b+ trees
-   det = new Detector();
-   if (!det) {
-      fprintf(stderr, "ERROR: main - new failed when creating Detector object.\n");
-      exit_value = -1;
-      goto cleanup;
-   }
-   
-   if (!det->init()) {
-      exit_value = -1;
-      goto cleanup;
+   if (g_worker_count > 0) {
+      // every worker owns its own Detector with IPv4 and IPv6 tables of servers
+      workers = new Worker[g_worker_count];
+      for (started = 0; started < g_worker_count; started++) {
+         if (!workers[started].start()) {
+            exit_value = -1;
+            goto cleanup;
+         }
+      }
+   } else {
+      // initialize IPv4 and IPv6 tables of servers
+      det = new Detector();
+      if (!det) {
+         fprintf(stderr, "ERROR: main - new failed when creating Detector object.\n");
+         exit_value = -1;
+         goto cleanup;
+      }
+
+      if (!det->init()) {
+         exit_value = -1;
+         goto cleanup;
+      }
    }
 
    // receive and process data until SIGINT is received or error occurs
    while (!stop) {
       const void *in_rec;
       uint16_t in_rec_size;
-      data_t *sip_data;
 
       // receive data
-      ret = TRAP_RECEIVE(0, in_rec, in_rec_size, in_tmplt);
+      ret = trap_recv(0, &in_rec, &in_rec_size);
+      if (ret == TRAP_E_FORMAT_CHANGED) {
+         // the record is already in the new format
+         const char *spec = NULL;
+         uint8_t data_fmt;
+         if (trap_get_data_fmt(TRAPIFC_INPUT, 0, &data_fmt, &spec) != TRAP_E_OK) {
+            fprintf(stderr, "Error: data format was not loaded.\n");
+            exit_value = -1;
+            break;
+         }
+         in_tmplt = ur_define_fields_and_update_template(spec, in_tmplt);
+         if (in_tmplt == NULL) {
+            fprintf(stderr, "Error: template could not be edited.\n");
+            exit_value = -1;
+            break;
+         }
+         in_fixed = is_input_record(in_tmplt);
+         ret = TRAP_E_OK;
+      }
       TRAP_DEFAULT_RECV_ERROR_HANDLING(ret, continue, break);
       if (in_rec_size < ur_rec_fixlen_size(in_tmplt)) {
          if (in_rec_size <= 1) {
@@ -1541,69 +1580,87 @@ int main(int argc, char **argv)
       }
 
       // determine whether this is status message with 401 Unauthorized 403 Forbidden or 200 OK code and CSEQ in format "<number> REGISTER"
-      get_string_from_unirec(F_SIP_CSEQ, MAX_LENGTH_CSEQ, in_rec, in_tmplt, sip_cseq, &sip_cseq_len);
-      if (!(sip_cseq_len > 2 && strstr(sip_cseq, "REG"))) {
+      sip_cseq = IN_GET_STRING(sip_cseq, F_SIP_CSEQ, MAX_LENGTH_CSEQ, &sip_cseq_len);
+      if (!(sip_cseq_len > 2 && is_register_cseq(sip_cseq, sip_cseq_len))) {
          continue;
       }
 
-      sip_data = (data_t *) malloc(sizeof(data_t));
-      if (!sip_data) {
-         fprintf(stderr, "Error: malloc failed.\n");
-         exit_value = -1;
-         break;
-      }
-
-      msg_type = ur_get(in_tmplt, in_rec, F_SIP_MSG_TYPE);
-      sip_data->status_code = ur_get(in_tmplt, in_rec, F_SIP_STATUS_CODE);
-      if (!(msg_type == SIP_MSG_TYPE_STATUS && (sip_data->status_code == SIP_STATUS_OK || sip_data->status_code == SIP_STATUS_UNAUTHORIZED))) {
-         free(sip_data);
+      msg_type = IN_GET(sip_msg_type, F_SIP_MSG_TYPE);
+      sip_data.status_code = IN_GET(sip_status_code, F_SIP_STATUS_CODE);
+      if (!(msg_type == SIP_MSG_TYPE_STATUS && (sip_data.status_code == SIP_STATUS_OK || sip_data.status_code == SIP_STATUS_UNAUTHORIZED))) {
          continue;
       }
 
       int sip_from_len;
       // receive and store all vital information about this message to SipDataholder structure
-      get_string_from_unirec(F_SIP_CALLING_PARTY, MAX_LENGTH_SIP_FROM, in_rec, in_tmplt, sip_from_orig, &sip_from_len);
-      int invalid_sipfrom = parse_sip_from(sip_from_orig, sip_from_len, &(sip_data->user), &(sip_data->name_suffix));
+      const char *sip_from = IN_GET_STRING(sip_calling_party, F_SIP_CALLING_PARTY, MAX_LENGTH_SIP_FROM, &sip_from_len);
+      int invalid_sipfrom = parse_sip_from(sip_from, sip_from_len, &sip_data);
       if (invalid_sipfrom) {
-         free(sip_data);
          VERBOSE("Warning: invalid value of sip_from field.\n")
          continue;
       }
 
-      sip_data->ip_src = &ur_get(in_tmplt, in_rec, F_SRC_IP);
-      sip_data->ip_dst = &ur_get(in_tmplt, in_rec, F_DST_IP);
-      if (ip_is_null(sip_data->ip_src) || ip_is_null(sip_data->ip_dst)) {
-         free(sip_data);
+      sip_data.ip_src = (ip_addr_t *) ur_fixed_get_ptr(in_fixed, input_record_t, src_ip, in_tmplt, in_rec, F_SRC_IP);
+      sip_data.ip_dst = (ip_addr_t *) ur_fixed_get_ptr(in_fixed, input_record_t, dst_ip, in_tmplt, in_rec, F_DST_IP);
+      if (ip_is_null(sip_data.ip_src) || ip_is_null(sip_data.ip_dst)) {
          VERBOSE("Warning: null value of IP.\n")
          continue;
       }
-      sip_data->link_bit_field = ur_get(in_tmplt, in_rec, F_LINK_BIT_FIELD);
-      sip_data->server_port = ur_get(in_tmplt, in_rec, F_SRC_PORT);
-      sip_data->client_port = ur_get(in_tmplt, in_rec, F_DST_PORT);
-      sip_data->protocol = ur_get(in_tmplt, in_rec, F_PROTOCOL);
-      sip_data->time_stamp = ur_time_get_sec((ur_time_t *) ur_get(in_tmplt, in_rec, F_TIME_FIRST));
-      sip_data->ipv4 = ip_is4(sip_data->ip_src);
-
-      // insert potential attack attempt to the tree, generate alerts of type #1 and #2 (view README.md) if conditions are matched
-      bool retval = det->insertFlow(sip_data);
+      sip_data.link_bit_field = IN_GET(link_bit_field, F_LINK_BIT_FIELD);
+      sip_data.server_port = IN_GET(src_port, F_SRC_PORT);
+      sip_data.client_port = IN_GET(dst_port, F_DST_PORT);
+      sip_data.protocol = IN_GET(protocol, F_PROTOCOL);
+      sip_data.time_stamp = ur_time_get_sec(IN_GET(time_first, F_TIME_FIRST));
+      sip_data.ipv4 = ip_is4(sip_data.ip_src);
+
+      if (workers) {
+         Worker *worker = &workers[server_shard(&sip_data, g_worker_count)];
+         if (worker->failed()) {
+            VERBOSE("Error: unable to insert possible attack attempt.\n")
+            exit_value = -1;
+            break;
+         }
+
+         worker->pushFlow(&sip_data);
+
+         // all workers check ceased attacks at the same moments as a single Detector would
+         if (sip_data.time_stamp >= time_last_tick && sip_data.time_stamp - time_last_tick > g_check_mem_interval) {
+            for (uint32_t i = 0; i < g_worker_count; i++) {
+               workers[i].pushTick(sip_data.time_stamp);
+            }
+            time_last_tick = sip_data.time_stamp;
+         }
+         continue;
+      }
+
+      // insert potential attack attempt to the tables, generate alerts of type #1 and #2 (view README.md) if conditions are matched
+      bool retval = det->insertFlow(&sip_data);
       if (!retval) {
-         free(sip_data);
          VERBOSE("Error: unable to insert possible attack attempt.\n")
          exit_value = -1;
          break;
       }
 
-      if (!det->evaluateFlows((time_t) sip_data->time_stamp)) {
-         free(sip_data);
+      if (!det->evaluateFlows((time_t) sip_data.time_stamp)) {
          exit_value = -1;
-         break;      
+         break;
       }
-
-      free(sip_data);
    }
 
 cleanup:
-   // free all used memory
+   // let the workers process the queued messages, then free all used memory
+   for (uint32_t i = 0; i < started; i++) {
+      workers[i].stop();
+   }
+
+   for (uint32_t i = 0; i < started; i++) {
+      if (workers[i].failed()) {
+         exit_value = -1;
+      }
+      workers[i].destroy();
+   }
+
+   delete [] workers;
    if (det) {
       det->destroy();
    }
@@ -41,6 +41,9 @@
  *
  */
 
+#ifndef SIP_BF_DETECTOR_H
+#define SIP_BF_DETECTOR_H
+
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
@@ -50,9 +53,12 @@
 
 #include <libtrap/trap.h>
 #include <unirec/unirec.h>
-extern "C" {
-#include <b_plus_tree.h>
-}
+#include "ip_table.h"
+#include "ur_fixed.h"
+
+#include "hash_index.h"
+#include "timer_wheel.h"
+#include "slab.h"
 
 using namespace std;
 
@@ -63,12 +69,17 @@ using namespace std;
 #define MAX_LENGTH_USER_NAME     50
 #define MAX_LENGTH_CSEQ          50
 #define IP_VERSION_4_BYTES       4
-#define IP_VERSION_6_BYTES       32
+#define IP_VERSION_6_BYTES       16
 #define DEFAULT_SCAN_LIMIT       25
 #define DEFAULT_DBF_LIMIT        5
 #define DEFAULT_SCAN_START_SIZE  5
 #define DEFAULT_DBF_START_SIZE   1
 #define DEFAULT_OK_COUNT_LIMIT   5
+#define DEFAULT_SERVER_TABLE_SIZE 256
+#define DEFAULT_CLIENT_TABLE_SIZE 16
+
+#define TIMER_USER     0
+#define TIMER_CLIENT   1
 
 #define PROTOCOL_TCP   0x6
 #define PROTOCOL_UDP   0x11
@@ -76,7 +87,7 @@ using namespace std;
 /** \brief Default value of unsuccessful authentication attempts to consider this behaviour as an attack. */
 #define DEFAULT_ALERT_THRESHOLD  50
 
-/** \brief Default time in seconds between checks for ceased attacks. */
+/** \brief Default time in seconds between checks for ceased attacks (advances of the timer wheel). */
 #define CHECK_MEMORY_INTERVAL    300
 
 /** \brief Default number of seconds since last action to consider an attack as ceased. */
@@ -85,6 +96,24 @@ using namespace std;
 /** \brief UniRec input template definition. */
 #define UNIREC_INPUT_TEMPLATE "DST_IP,SRC_IP,SRC_PORT,DST_PORT,LINK_BIT_FIELD,PROTOCOL,TIME_FIRST,SIP_MSG_TYPE,SIP_STATUS_CODE,SIP_CSEQ,SIP_CALLING_PARTY"
 
+/**
+ * \brief Record of UNIREC_INPUT_TEMPLATE as UniRec lays it out, the fields are read
+ * directly while the negotiated input template matches it (see ur_fixed.h).
+ */
+typedef struct __attribute__ ((__packed__)) {
+   ip_addr_t dst_ip;
+   ip_addr_t src_ip;
+   uint64_t link_bit_field;
+   ur_time_t time_first;
+   uint16_t dst_port;
+   uint16_t sip_msg_type;
+   uint16_t sip_status_code;
+   uint16_t src_port;
+   uint8_t protocol;
+   ur_fixed_var_t sip_calling_party;
+   ur_fixed_var_t sip_cseq;
+} input_record_t;
+
 /** \brief UniRec alert template definition. */
 #define UNIREC_ALERT_TEMPLATE "SBFD_TARGET,SBFD_SOURCE,SRC_PORT,DST_PORT,SBFD_LINK_BIT_FIELD,SBFD_PROTOCOL,SBFD_EVENT_TIME,SBFD_CEASE_TIME,SBFD_BREACH_TIME,SBFD_EVENT_TYPE,SBFD_EVENT_ID,SBFD_ATTEMPTS,SBFD_AVG_ATTEMPTS,SBFD_USER"
 
@@ -117,8 +146,11 @@ struct stats_t {
 
 struct data_t {
    bool ipv4;                             ///< flag signalizing whether used protocol is IPv4 or IPv6
-   char *user;                            ///< pointer to user name
-   char *name_suffix;
+   const char *user;                      ///< user name, points into the received UniRec record
+   uint16_t user_len;                     ///< length of the user name (at most MAX_LENGTH_USER_NAME)
+   uint64_t user_hash;                    ///< hash of the user name, key of the users table
+   const char *name_suffix;               ///< part of SIP_FROM after '@', points into the received UniRec record
+   uint16_t name_suffix_len;              ///< length of the name suffix
    uint16_t status_code;                  ///< sip status code
    uint8_t link_bit_field;                ///< indicator of particular monitoring probe
    uint8_t protocol;					  ///< sip protocol used for data transfer
@@ -161,20 +193,25 @@ struct bf_t {
    uint8_t m_protocol;
    uint8_t m_link_bit_field;
    uint8_t m_ok_count;
+   uint32_t m_usr_index;                  ///< position in communications of the target
+   uint32_t m_clt_index;                  ///< position in communications of the source
 };
 
 class User {
 public:
    void destroy(Server *srv);
-   bool init(char *name);
-   int addCom(const data_t *flow, Client *clt, bf_t *bf);
+   bool init(char *name, uint64_t hash);
+   int addCom(const data_t *flow, Client *clt, bf_t *bf, Server *srv);
    void removeCom(bf_t *bf);
    dbf_t* getDBF() const;
-   bf_t* findCom(const Client *clt) const;
    void getDBFStats(stats_t *stats) const;
    int evaluateFlows(uint32_t current_time, Server *srv);
+   bool nextCheck(uint32_t *expires) const;
 
    char *m_name;
+   uint64_t m_hash;
+   Server *m_server;
+   timer_node_t m_timer;
 private:
    bool extendCom();
    dbf_t *m_dbf;
@@ -186,15 +223,18 @@ private:
 class Client {
 public:
    void destroy();
-   bool init(ip_addr_t *ip, uint16_t port);
+   bool init(const ip_addr_t *ip, uint16_t port);
    bool addCom(const data_t *flow, bf_t *bf);
    void removeCom(bf_t *bf);
    scan_t* getScan() const;
    void getScanStats(stats_t *stats) const;
    int getSize() const;
+   bf_t* getCom(uint32_t index) const;
 
    uint16_t m_port;
-   ip_addr_t *m_ip;
+   ip_addr_t m_ip;
+   Server *m_server;
+   timer_node_t m_timer;
 private:
    bool extendCom();
    uint32_t m_index;
@@ -207,26 +247,41 @@ class Server {
 public:
    void destroy();
    void cleanStructures();
-   bool init(const data_t *flow);
+   bool init(const data_t *flow, TimerWheel *timers);
    bool insertFlow(const data_t *flow);
    bool isEmpty() const;
-   bool evaluateFlows(const uint32_t current_time);
+   void checkUser(User *usr, uint32_t current_time);
+   void checkClient(Client *clt, uint32_t current_time);
+   void schedule(timer_node_t *node, uint32_t expires);
+   void scheduleNow(timer_node_t *node);
    void reportAlert(bf_t *bf, User *usr, Client *clt, event_type_t event);
    void alertTimeMachine(const ip_addr_t *source);
+   bf_t* findCom(const User *usr, const Client *clt) const;
+   bf_t* createCom(const data_t *flow, Client *clt, User *usr);
+   void removeCom(bf_t *bf);
 
    uint16_t m_port;
    ip_addr_t *m_ip;
 private:
    Client* createClientNode(void *tree_key, ip_addr_t *ip, uint16_t port);
-   User* createUserNode(char *name);
+   User* createUserNode(const data_t *flow);
+   void removeUserNode(User *usr);
+   void removeClientNode(Client *clt);
    bool insertSourceAndTarget(const data_t *flow, User *user, Client *clt);
    void updateScan(const data_t *flow, Client *clt, User *usr);
    void updateDBF(const data_t *flow, Client *clt, User *usr);
    uint64_t createId(uint32_t time_first);
+   void sendAlert(bf_t *bf, User *usr, Client *clt, event_type_t event);
    bool m_ipv4;
    char *m_name_suffix;
-   bpt_t *m_users;
-   bpt_t *m_clients;
+   NameTable m_users;                     ///< users interned by hash of their name
+   PairIndex m_coms;                      ///< communications indexed by (user, client)
+   ip_table_t *m_clients;                 ///< pointers to clients indexed by their IP address
+   SlabPool m_user_pool;
+   SlabPool m_client_pool;
+   SlabPool m_com_pool;
+   NameArena m_names;                     ///< names of users
+   TimerWheel *m_timers;                  ///< timers of users and clients, shared by all servers
 };
 
 class Detector {
@@ -236,6 +291,12 @@ public:
    bool insertFlow(const data_t *flow);
    bool evaluateFlows(const uint32_t current_time);
 private:
-   bpt_t *m_ipv4tree;
-   bpt_t *m_ipv6tree;
+   static void timerExpired(timer_node_t *node, uint32_t current_time, void *arg);
+   void removeServer(Server *srv);
+   ip_table_t *m_ipv4servers;             ///< pointers to servers indexed by their IP address
+   ip_table_t *m_ipv6servers;
+   TimerWheel m_timers;
+   uint32_t m_time_last_check;
 };
+
+#endif /* SIP_BF_DETECTOR_H */
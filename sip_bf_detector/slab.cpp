@@ -0,0 +1,173 @@
+/**
+ * \file slab.cpp
+ * \brief Pools of fixed-size objects and arena of names used by the servers of sip_bf_detector.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include "slab.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* objects and strings keep the alignment of malloc */
+#define SLAB_ALIGN               16
+#define ALIGN_UP(X, A)           (((X) + (A) - 1) & ~((size_t) (A) - 1))
+
+void SlabPool::init(size_t obj_size)
+{
+   m_obj_size = ALIGN_UP(obj_size < sizeof(void *) ? sizeof(void *) : obj_size, sizeof(void *));
+   m_slabs = NULL;
+   m_free = NULL;
+}
+
+void SlabPool::destroy()
+{
+   while (m_slabs) {
+      slab_t *next = m_slabs->next;
+      free(m_slabs);
+      m_slabs = next;
+   }
+
+   m_free = NULL;
+}
+
+void* SlabPool::alloc()
+{
+   if (!m_free) {
+      const size_t header = ALIGN_UP(sizeof(slab_t), SLAB_ALIGN);
+      slab_t *slab = (slab_t *) malloc(header + SLAB_OBJECTS * m_obj_size);
+      if (!slab) {
+         fprintf(stderr, "ERROR: SlabPool::alloc - malloc failed.\n");
+         return NULL;
+      }
+
+      slab->next = m_slabs;
+      m_slabs = slab;
+
+      // link the new objects in the order of their addresses
+      char *obj = (char *) slab + header;
+      for (int i = SLAB_OBJECTS - 1; i >= 0; i--) {
+         release(obj + i * m_obj_size);
+      }
+   }
+
+   void *obj = m_free;
+   m_free = *(void **) obj;
+   return obj;
+}
+
+void SlabPool::release(void *obj)
+{
+   *(void **) obj = m_free;
+   m_free = obj;
+}
+
+void NameArena::init()
+{
+   m_chunks = NULL;
+}
+
+void NameArena::destroy()
+{
+   while (m_chunks) {
+      chunk_t *next = m_chunks->next;
+      free(m_chunks);
+      m_chunks = next;
+   }
+}
+
+char* NameArena::copy(const char *str, uint16_t length)
+{
+   const uint32_t header = ALIGN_UP(sizeof(chunk_t), SLAB_ALIGN);
+   chunk_t *chunk = m_chunks;
+
+   if (header + length + 1 > ARENA_CHUNK_SIZE) {
+      fprintf(stderr, "ERROR: NameArena::copy - string of length %u does not fit into a chunk.\n", length);
+      return NULL;
+   }
+
+   if (!chunk || chunk->used + length + 1 > ARENA_CHUNK_SIZE) {
+      void *mem;
+      if (posix_memalign(&mem, ARENA_CHUNK_SIZE, ARENA_CHUNK_SIZE) != 0) {
+         fprintf(stderr, "ERROR: NameArena::copy - posix_memalign failed.\n");
+         return NULL;
+      }
+
+      chunk = (chunk_t *) mem;
+      chunk->prev = NULL;
+      chunk->next = m_chunks;
+      chunk->used = header;
+      chunk->live = 0;
+      if (m_chunks) {
+         m_chunks->prev = chunk;
+      }
+      m_chunks = chunk;
+   }
+
+   char *dst = (char *) chunk + chunk->used;
+   memcpy(dst, str, length);
+   dst[length] = '\0';
+   chunk->used += length + 1;
+   chunk->live++;
+
+   return dst;
+}
+
+void NameArena::release(const char *str)
+{
+   chunk_t *chunk = (chunk_t *) ((uintptr_t) str & ~((uintptr_t) ARENA_CHUNK_SIZE - 1));
+
+   chunk->live--;
+   if (chunk->live > 0) {
+      return;
+   }
+
+   if (chunk == m_chunks) {
+      // the chunk being filled is only rewound
+      chunk->used = ALIGN_UP(sizeof(chunk_t), SLAB_ALIGN);
+      return;
+   }
+
+   chunk->prev->next = chunk->next;
+   if (chunk->next) {
+      chunk->next->prev = chunk->prev;
+   }
+   free(chunk);
+}
@@ -0,0 +1,101 @@
+/**
+ * \file slab.h
+ * \brief Pools of fixed-size objects and arena of names used by the servers of sip_bf_detector.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef SIP_BF_DETECTOR_SLAB_H
+#define SIP_BF_DETECTOR_SLAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** \brief Number of objects allocated at once by a pool. */
+#define SLAB_OBJECTS             64
+
+/** \brief Size of one chunk of a name arena, chunks are aligned to their size. */
+#define ARENA_CHUNK_SIZE         4096
+
+/**
+ * \brief Pool of objects of one size.
+ *
+ * Objects are carved from slabs of SLAB_OBJECTS objects, released objects are reused
+ * by the next allocations and the slabs are freed at once by destroy().
+ * Constructors and destructors are not called.
+ */
+class SlabPool {
+public:
+   void init(size_t obj_size);
+   void destroy();
+   void* alloc();
+   void release(void *obj);
+private:
+   struct slab_t {
+      slab_t *next;
+   };
+
+   size_t m_obj_size;
+   slab_t *m_slabs;
+   void *m_free;                          ///< list of released objects linked through their first bytes
+};
+
+/**
+ * \brief Bump allocator of null terminated strings.
+ *
+ * Strings are appended to the current chunk, a chunk is freed once all its strings are released,
+ * all remaining chunks are freed by destroy().
+ */
+class NameArena {
+public:
+   void init();
+   void destroy();
+   char* copy(const char *str, uint16_t length);
+   void release(const char *str);
+private:
+   struct chunk_t {
+      chunk_t *prev;
+      chunk_t *next;
+      uint32_t used;                      ///< bytes used including the header
+      uint32_t live;                      ///< number of strings which are not released
+   };
+
+   chunk_t *m_chunks;                     ///< the first chunk is the one being filled
+};
+
+#endif /* SIP_BF_DETECTOR_SLAB_H */
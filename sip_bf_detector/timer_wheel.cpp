@@ -0,0 +1,187 @@
+/**
+ * \file timer_wheel.cpp
+ * \brief Hierarchical timer wheel used by sip_bf_detector to expire users and clients incrementally.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include "timer_wheel.h"
+
+#include <string.h>
+
+void TimerWheel::init()
+{
+   memset(m_slots, 0, sizeof(m_slots));
+   memset(m_level_count, 0, sizeof(m_level_count));
+   m_now = 0;
+   m_count = 0;
+}
+
+void TimerWheel::initNode(timer_node_t *node, uint8_t type, void *data)
+{
+   node->next = NULL;
+   node->pprev = NULL;
+   node->expires = 0;
+   node->level = 0;
+   node->type = type;
+   node->data = data;
+}
+
+void TimerWheel::add(timer_node_t *node, uint32_t expires)
+{
+   if (node->pprev) {
+      unlink(node);
+   }
+
+   // timers which should have already fired are fired with the next second
+   if (expires <= m_now) {
+      expires = m_now + 1;
+   }
+
+   node->expires = expires;
+   link(node);
+}
+
+void TimerWheel::remove(timer_node_t *node)
+{
+   if (node->pprev) {
+      unlink(node);
+   }
+}
+
+bool TimerWheel::pending(const timer_node_t *node) const
+{
+   return node->pprev != NULL;
+}
+
+uint32_t TimerWheel::now() const
+{
+   return m_now;
+}
+
+void TimerWheel::advance(uint32_t time, timer_callback_t callback, void *arg)
+{
+   while (time > m_now) {
+      if (m_count == 0) {
+         // nothing to fire, jump over the idle period
+         m_now = time;
+         return;
+      }
+
+      // while the lowest levels are empty, nothing fires before the next cascade of the level above them
+      int empty = 0;
+      while (empty < TIMER_WHEEL_LEVELS - 1 && m_level_count[empty] == 0) {
+         empty++;
+      }
+
+      if (empty > 0) {
+         uint32_t block = 1U << (empty * TIMER_WHEEL_SLOT_BITS);
+         uint32_t skip = block - 1 - (m_now & (block - 1));
+         if (skip >= time - m_now) {
+            m_now = time;
+            return;
+         }
+
+         m_now += skip;
+      }
+
+      m_now++;
+      uint32_t slot = m_now & TIMER_WHEEL_SLOT_MASK;
+      for (int level = 1; slot == 0 && level < TIMER_WHEEL_LEVELS; level++) {
+         slot = (m_now >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_SLOT_MASK;
+         cascade(level, slot);
+      }
+
+      // timers added by the callback always go to a later slot
+      timer_node_t **head = &m_slots[0][m_now & TIMER_WHEEL_SLOT_MASK];
+      while (*head) {
+         timer_node_t *node = *head;
+         unlink(node);
+         callback(node, m_now, arg);
+      }
+   }
+}
+
+void TimerWheel::link(timer_node_t *node)
+{
+   uint32_t delta = node->expires - m_now;
+   int level = 0;
+
+   while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1U << ((level + 1) * TIMER_WHEEL_SLOT_BITS))) {
+      level++;
+   }
+
+   timer_node_t **head = &m_slots[level][(node->expires >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_SLOT_MASK];
+   node->next = *head;
+   if (*head) {
+      (*head)->pprev = &node->next;
+   }
+
+   node->pprev = head;
+   node->level = level;
+   *head = node;
+   m_level_count[level]++;
+   m_count++;
+}
+
+void TimerWheel::unlink(timer_node_t *node)
+{
+   *node->pprev = node->next;
+   if (node->next) {
+      node->next->pprev = node->pprev;
+   }
+
+   node->next = NULL;
+   node->pprev = NULL;
+   m_level_count[node->level]--;
+   m_count--;
+}
+
+void TimerWheel::cascade(int level, uint32_t slot)
+{
+   timer_node_t *node = m_slots[level][slot];
+
+   m_slots[level][slot] = NULL;
+   while (node) {
+      timer_node_t *next = node->next;
+      m_level_count[level]--;
+      m_count--;
+      link(node);
+      node = next;
+   }
+}
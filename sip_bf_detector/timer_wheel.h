@@ -0,0 +1,99 @@
+/**
+ * \file timer_wheel.h
+ * \brief Hierarchical timer wheel used by sip_bf_detector to expire users and clients incrementally.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef SIP_BF_DETECTOR_TIMER_WHEEL_H
+#define SIP_BF_DETECTOR_TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TIMER_WHEEL_LEVELS      4
+#define TIMER_WHEEL_SLOT_BITS   8
+#define TIMER_WHEEL_SLOTS       (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_SLOT_MASK   (TIMER_WHEEL_SLOTS - 1)
+
+/**
+ * \brief Timer embedded in the object which is going to be checked.
+ */
+struct timer_node_t {
+   timer_node_t *next;
+   timer_node_t **pprev;                  ///< NULL when the timer is not scheduled
+   uint32_t expires;                      ///< time in seconds when the timer fires
+   uint8_t level;                         ///< level of the wheel the timer is linked to
+   uint8_t type;                          ///< type of the object the timer belongs to
+   void *data;                            ///< object the timer belongs to
+};
+
+/**
+ * \brief Called for every fired timer, the timer is already unscheduled and can be added again.
+ */
+typedef void (*timer_callback_t)(timer_node_t *node, uint32_t current_time, void *arg);
+
+/**
+ * \brief Hierarchical timer wheel with one second resolution.
+ *
+ * Level 0 has one slot per second, every higher level has slots 256 times longer.
+ * Timers of higher levels are cascaded to lower levels as the time advances,
+ * so adding, removing and firing a timer is O(1). Periods without any timer due
+ * are skipped block by block, so long gaps in time are cheap.
+ */
+class TimerWheel {
+public:
+   void init();
+   void initNode(timer_node_t *node, uint8_t type, void *data);
+   void add(timer_node_t *node, uint32_t expires);
+   void remove(timer_node_t *node);
+   bool pending(const timer_node_t *node) const;
+   uint32_t now() const;
+   void advance(uint32_t time, timer_callback_t callback, void *arg);
+private:
+   void link(timer_node_t *node);
+   void unlink(timer_node_t *node);
+   void cascade(int level, uint32_t slot);
+
+   timer_node_t *m_slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+   uint32_t m_level_count[TIMER_WHEEL_LEVELS];
+   uint32_t m_now;
+   uint32_t m_count;
+};
+
+#endif /* SIP_BF_DETECTOR_TIMER_WHEEL_H */
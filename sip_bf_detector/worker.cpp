@@ -0,0 +1,273 @@
+/**
+ * \file worker.cpp
+ * \brief Worker threads of sip_bf_detector, each of them owns a subset of SIP servers.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include "worker.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+
+bool MessageQueue::init()
+{
+   m_head = m_tail = 0;
+   m_sleeping = 0;
+   m_msgs = (queue_msg_t *) malloc(WORKER_QUEUE_SIZE * sizeof(queue_msg_t));
+   if (!m_msgs) {
+      fprintf(stderr, "ERROR: MessageQueue::init - malloc failed.\n");
+      return false;
+   }
+   pthread_mutex_init(&m_lock, NULL);
+   pthread_cond_init(&m_wake, NULL);
+
+   return true;
+}
+
+void MessageQueue::destroy()
+{
+   pthread_cond_destroy(&m_wake);
+   pthread_mutex_destroy(&m_lock);
+   free(m_msgs);
+   m_msgs = NULL;
+}
+
+queue_msg_t* MessageQueue::reserve()
+{
+   uint32_t tail = __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE);
+   if (m_head - tail == WORKER_QUEUE_SIZE) {
+      return NULL;
+   }
+
+   return &m_msgs[m_head & (WORKER_QUEUE_SIZE - 1)];
+}
+
+void MessageQueue::push()
+{
+   __atomic_store_n(&m_head, m_head + 1, __ATOMIC_RELEASE);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   if (__atomic_load_n(&m_sleeping, __ATOMIC_RELAXED)) {
+      pthread_mutex_lock(&m_lock);
+      pthread_cond_signal(&m_wake);
+      pthread_mutex_unlock(&m_lock);
+   }
+}
+
+queue_msg_t* MessageQueue::front()
+{
+   uint32_t head = __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+   if (head == m_tail) {
+      return NULL;
+   }
+
+   return &m_msgs[m_tail & (WORKER_QUEUE_SIZE - 1)];
+}
+
+queue_msg_t* MessageQueue::wait()
+{
+   queue_msg_t *msg;
+
+   for (int i = 0; i < WORKER_SPIN; i++) {
+      if ((msg = front()) != NULL) {
+         return msg;
+      }
+      sched_yield();
+   }
+
+   pthread_mutex_lock(&m_lock);
+   __atomic_store_n(&m_sleeping, 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   while ((msg = front()) == NULL) {
+      pthread_cond_wait(&m_wake, &m_lock);
+   }
+   __atomic_store_n(&m_sleeping, 0, __ATOMIC_RELAXED);
+   pthread_mutex_unlock(&m_lock);
+
+   return msg;
+}
+
+void MessageQueue::pop()
+{
+   __atomic_store_n(&m_tail, m_tail + 1, __ATOMIC_RELEASE);
+}
+
+bool Worker::start()
+{
+   m_running = false;
+   m_failed = 0;
+   if (!m_queue.init()) {
+      return false;
+   }
+
+   if (!m_det.init()) {
+      m_queue.destroy();
+      return false;
+   }
+
+   if (pthread_create(&m_thread, NULL, &Worker::run, this) != 0) {
+      fprintf(stderr, "ERROR: Worker::start - pthread_create failed.\n");
+      m_det.destroy();
+      m_queue.destroy();
+      return false;
+   }
+
+   m_running = true;
+   return true;
+}
+
+void Worker::stop()
+{
+   if (!m_running) {
+      return;
+   }
+
+   queue_msg_t *msg = reserveWait();
+   msg->type = QUEUE_MSG_STOP;
+   m_queue.push();
+   pthread_join(m_thread, NULL);
+   m_running = false;
+}
+
+void Worker::destroy()
+{
+   m_det.destroy();
+   m_queue.destroy();
+}
+
+void Worker::pushFlow(const data_t *flow)
+{
+   queue_msg_t *msg = reserveWait();
+   uint16_t suffix_len = flow->name_suffix_len;
+
+   // the received record is reused by libtrap, copy everything the pointers refer to
+   if (suffix_len > MAX_LENGTH_SIP_FROM) {
+      suffix_len = MAX_LENGTH_SIP_FROM;
+   }
+
+   msg->type = QUEUE_MSG_FLOW;
+   msg->data = *flow;
+   msg->ip_src = *flow->ip_src;
+   msg->ip_dst = *flow->ip_dst;
+   memcpy(msg->user, flow->user, flow->user_len);
+   memcpy(msg->name_suffix, flow->name_suffix, suffix_len);
+   msg->data.name_suffix_len = suffix_len;
+   m_queue.push();
+}
+
+void Worker::pushTick(uint32_t time)
+{
+   queue_msg_t *msg = reserveWait();
+   msg->type = QUEUE_MSG_TICK;
+   msg->data.time_stamp = time;
+   m_queue.push();
+}
+
+bool Worker::failed() const
+{
+   return __atomic_load_n(&m_failed, __ATOMIC_ACQUIRE) != 0;
+}
+
+queue_msg_t* Worker::reserveWait()
+{
+   queue_msg_t *msg;
+   while ((msg = m_queue.reserve()) == NULL) {
+      usleep(WORKER_IDLE_SLEEP);
+   }
+
+   return msg;
+}
+
+void *Worker::run(void *arg)
+{
+   Worker *w = (Worker *) arg;
+
+   while (true) {
+      queue_msg_t *msg = w->m_queue.wait();
+
+      if (msg->type == QUEUE_MSG_STOP) {
+         w->m_queue.pop();
+         break;
+      }
+
+      // after an error the messages are only drained until the receiving thread stops
+      if (!w->failed()) {
+         bool ok;
+         if (msg->type == QUEUE_MSG_FLOW) {
+            msg->data.user = msg->user;
+            msg->data.name_suffix = msg->name_suffix;
+            msg->data.ip_src = &msg->ip_src;
+            msg->data.ip_dst = &msg->ip_dst;
+            ok = w->m_det.insertFlow(&msg->data);
+         } else {
+            ok = w->m_det.evaluateFlows(msg->data.time_stamp);
+         }
+
+         if (!ok) {
+            __atomic_store_n(&w->m_failed, 1, __ATOMIC_RELEASE);
+         }
+      }
+
+      w->m_queue.pop();
+   }
+
+   return NULL;
+}
+
+uint32_t server_shard(const data_t *flow, uint32_t count)
+{
+   const ip_addr_t *ip = flow->ip_src;
+   uint32_t hash;
+
+   if (flow->ipv4) {
+      hash = ip_get_v4_as_int(ip);
+   } else {
+      hash = ip->ui32[0] ^ ip->ui32[1] ^ ip->ui32[2] ^ ip->ui32[3];
+   }
+
+   hash ^= hash >> 16;
+   hash *= 0x85ebca6b;
+   hash ^= hash >> 13;
+   hash *= 0xc2b2ae35;
+   hash ^= hash >> 16;
+
+   return hash % count;
+}
@@ -0,0 +1,135 @@
+/**
+ * \file worker.h
+ * \brief Worker threads of sip_bf_detector, each of them owns a subset of SIP servers.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef SIP_BF_DETECTOR_WORKER_H
+#define SIP_BF_DETECTOR_WORKER_H
+
+#include "sip_bf_detector.h"
+
+#include <pthread.h>
+
+/** \brief Number of messages in the queue of one worker, must be a power of 2. */
+#define WORKER_QUEUE_SIZE        4096
+
+/** \brief Microseconds to sleep when the queue of a worker is full. */
+#define WORKER_IDLE_SLEEP        50
+
+/** \brief Polls of an empty queue before the worker waits for a message. */
+#define WORKER_SPIN              64
+
+enum queue_msg_type_t {
+   QUEUE_MSG_FLOW,                        ///< message carrying a SIP status message
+   QUEUE_MSG_TICK,                        ///< time to check ceased attacks
+   QUEUE_MSG_STOP                         ///< no more messages
+};
+
+/**
+ * \brief Message passed to a worker, strings and addresses are copied out of the received record.
+ */
+struct queue_msg_t {
+   uint8_t type;
+   data_t data;
+   ip_addr_t ip_src;
+   ip_addr_t ip_dst;
+   char user[MAX_LENGTH_USER_NAME];
+   char name_suffix[MAX_LENGTH_SIP_FROM];
+};
+
+/**
+ * \brief Single producer single consumer ring of messages.
+ *
+ * The producer fills the slot returned by reserve() and publishes it with push(),
+ * the consumer processes the slot returned by front() in place and releases it with pop().
+ * An idle consumer waits in wait() on a condition variable. It sets m_sleeping before
+ * checking the queue again and push() checks it after the publication, both with a full
+ * fence in between, so either the consumer sees the message or the producer wakes it up.
+ */
+class MessageQueue {
+public:
+   bool init();
+   void destroy();
+   queue_msg_t* reserve();
+   void push();
+   queue_msg_t* front();
+   queue_msg_t* wait();
+   void pop();
+private:
+   queue_msg_t *m_msgs;
+   uint32_t m_head;                       ///< written by the producer only
+   char m_pad[64];                        ///< keeps head and tail in different cache lines
+   uint32_t m_tail;                       ///< written by the consumer only
+   int m_sleeping;                        ///< consumer waits on m_wake
+   pthread_mutex_t m_lock;
+   pthread_cond_t m_wake;
+};
+
+/**
+ * \brief Thread with its own Detector processing the messages of the servers assigned to it.
+ */
+class Worker {
+public:
+   bool start();
+   void stop();
+   void destroy();
+   void pushFlow(const data_t *flow);
+   void pushTick(uint32_t time);
+   bool failed() const;
+private:
+   static void *run(void *arg);
+   queue_msg_t* reserveWait();
+   pthread_t m_thread;
+   bool m_running;
+   int m_failed;
+   MessageQueue m_queue;
+   Detector m_det;
+};
+
+/**
+ * \brief Select a worker for the server of the message.
+ *
+ * \param[in] flow received message
+ * \param[in] count number of workers
+ * \return index of the worker
+ */
+uint32_t server_shard(const data_t *flow, uint32_t count);
+
+#endif /* SIP_BF_DETECTOR_WORKER_H */
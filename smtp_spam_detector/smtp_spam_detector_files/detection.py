@@ -42,6 +42,7 @@ Authors:
 #from cluster import Cluster
 from .flow import Flow, SMTP_Flow
 from .smtp_entity import SMTP_ENTITY
+from .features import FeatureTable
 from pytrap import TrapCtx
 from threading import Thread, RLock
 
@@ -52,6 +53,7 @@ import time
 import datetime
 import logging
 import json
+import numpy as np
 # In case we are in nemea/modules/report2idea/ and we want to import from repo:
 sys.path.insert(0, os.path.join(os.path.dirname(__file__), "..", "..", "nemea-framework", "pycommon"))
 import report2idea
@@ -68,6 +70,8 @@ class SpamDetection(Thread):
         # Storage for both flow types
         self.data = dict()
         self.data_lock = RLock()
+        # Features of the entities, updated with every flow
+        self.features = FeatureTable()
         # Blacklisted entities that are probably spammers
         self.potentialspammers = list()
 
@@ -113,11 +117,13 @@ class SpamDetection(Thread):
                     if flow.DST_IP in self.data:
                         self.data[flow.DST_IP].incoming += 1
                     else:
-                        self.data[flow.DST_IP] = SMTP_ENTITY(flow.DST_IP, flow.TIME_LAST)
+                        self.data[flow.DST_IP] = self.new_entity(flow.DST_IP, flow.TIME_LAST)
+                    self.features.update(self.data[flow.DST_IP])
                     self.data[key].add_new_flow(flow)
                     self.data[key].update_time(flow)
                 else:
-                    self.data[key] = SMTP_ENTITY(flow)
+                    self.data[key] = self.new_entity(flow)
+                self.features.update(self.data[key])
             except Exception as e:
                 detection_log.error("An error has occurred during entity insertion to database. ({0})".format(e))
         # Move timeframe according to received time from flows
@@ -125,6 +131,14 @@ class SpamDetection(Thread):
                 self.t_cflow = flow.TIME_LAST.getTimeAsFloat()
         return True
 
+    def new_entity(self, *args):
+        """
+        Creates an entity (see SMTP_ENTITY) with its row in the feature table
+        """
+        entity = SMTP_ENTITY(*args)
+        entity.slot = self.features.slot(entity)
+        return entity
+
     def create_report(self, entity):
         """
         Creates report for given entity
@@ -200,23 +214,32 @@ class SpamDetection(Thread):
         Do frequency analysis here
         """
         self.t_detect  = self.t_cflow
-        potentialspammers = set()
+        potentialspammers = []
         detection_log.info("Started probing entity database")
         with self.data_lock:
-            for entity in self.data:
-                score = self.data[entity].is_spam()
-                detection_log.debug("Evaluated entity:{!r}".format(self.data[entity]))
+            # Only the entities touched since the last analysis may change
+            slots, features = self.features.take_touched()
+            entities = self.features.entities
+            dl = len(entities)
 
-                if (score > 0.9):
-                    potentialspammers.add(self.data[entity])
+        # Features are copied, flows are added to the database meanwhile
+        score, conf, conn_tag, ratio_tag = self.features.evaluate(features)
+
+        with self.data_lock:
+            for i in np.flatnonzero(conf > 0.9):
+                entity = entities[slots[i]]
+                entity.set_evaluation(float(score[i]), conn_tag[i], ratio_tag[i])
+                potentialspammers.append(entity)
+            if detection_log.isEnabledFor(logging.DEBUG):
+                for slot in slots:
+                    detection_log.debug("Evaluated entity:{!r}".format(entities[slot]))
 
         ps = len(potentialspammers)
-        dl = len(self.data)
         try:
             part = float(ps)/float(dl)
         except ZeroDivisionError:
             part = 0
-        detection_log.info("Found {0} potential spammers in {1} [{2:.5%}]".format(ps, dl, float(part)))
+        detection_log.info("Found {0} potential spammers in {1} [{2:.5%}], evaluated {3}".format(ps, dl, float(part), len(slots)))
         self.send_reports([ self.create_report(entity) for entity in potentialspammers ])
         detection_log.info("Analysis run done!")
 
@@ -232,9 +255,10 @@ class SpamDetection(Thread):
         if self.t_clean + g.CLEAN_INTERVAL >= self.t_cflow:
             return None
 
-        data_len  = len(self.data)
-        records_len = 0
-        self.data.clear()
+        with self.data_lock:
+            data_len  = len(self.data)
+            self.data.clear()
+            self.features.clear()
 
         self.t_clean = time.time()
         detection_log.info("Database dropped. Cleared {0} records of entities.".format(data_len))
@@ -268,6 +292,7 @@ class SpamDetection(Thread):
 
             time.sleep(10)
 
+        self.features.shutdown()
         detection_log.info("***** Finished detection thread, exiting. *****")
         return None
 
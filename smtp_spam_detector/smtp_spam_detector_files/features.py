@@ -0,0 +1,180 @@
+"""
+Copyright (C) 2026 CESNET
+
+LICENSE TERMS
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. Neither the name of the Company nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+ALTERNATIVELY, provided that this notice is retained in full, this
+product may be distributed under the terms of the GNU General Public
+License (GPL) version 2 or later, in which case the provisions
+of the GPL apply INSTEAD OF those given above.
+
+This software is provided ``as is'', and any express or implied
+warranties, including, but not limited to, the implied warranties of
+merchantability and fitness for a particular purpose are disclaimed.
+In no event shall the company or contributors be liable for any
+direct, indirect, incidental, special, exemplary, or consequential
+damages (including, but not limited to, procurement of substitute
+goods or services; loss of use, data, or profits; or business
+interruption) however caused and on any theory of liability, whether
+in contract, strict liability, or tort (including negligence or
+otherwise) arising in any way out of the use of this software, even
+if advised of the possibility of such damage.
+"""
+
+#!/usr/bin/env python3
+import numpy as np
+from concurrent.futures import ThreadPoolExecutor
+
+from . import g
+
+# Order of the columns of the feature table
+INCOMING, OUTGOING, SENT, BYTES, PACKETS, AVG_SCORE, CONN_CNT = range(7)
+COLUMNS = 7
+
+class FeatureTable(object):
+    """
+    Features of all entities stored by columns in one NumPy array, every
+    entity has its own row (slot). The rows are updated by the detection with
+    every flow of the entity and the entity is marked as touched, so the
+    analysis evaluates only the entities touched since the last cycle.
+    The table is not locked, the caller holds the lock of the database.
+    """
+    def __init__(self, capacity=4096):
+        self.values = np.zeros((capacity, COLUMNS))
+        self.touched = np.zeros(capacity, dtype=bool)
+        self.entities = []          # entity of each slot
+        self.pool = None
+
+    def __len__(self):
+        return len(self.entities)
+
+    def slot(self, entity):
+        """
+        Add a row for the new entity
+
+        Returns:
+            Slot of the entity
+        """
+        slot = len(self.entities)
+        if slot == len(self.values):
+            # double the capacity
+            self.values = np.concatenate((self.values, np.zeros_like(self.values)))
+            self.touched = np.concatenate((self.touched, np.zeros_like(self.touched)))
+        self.entities.append(entity)
+        return slot
+
+    def update(self, entity):
+        """
+        Copy the counters of the entity to its row and mark it as touched
+        """
+        row = self.values[entity.slot]
+        row[INCOMING] = entity.incoming
+        row[OUTGOING] = entity.outgoing
+        row[SENT] = len(entity.sent_history)
+        row[BYTES] = entity.bytes
+        row[PACKETS] = entity.packets
+        row[AVG_SCORE] = entity.avg_score
+        row[CONN_CNT] = len(entity.dst_ips)
+        self.touched[entity.slot] = True
+
+    def take_touched(self):
+        """
+        Get the rows of the entities touched since the last call
+
+        Returns:
+            A tuple of an array with slots and an array with their features
+            (a copy, so the rows can be updated during the evaluation).
+        """
+        slots = np.flatnonzero(self.touched[:len(self.entities)])
+        self.touched[slots] = False
+        return slots, self.values[slots]
+
+    def clear(self):
+        """
+        Remove all entities
+        """
+        self.values[:len(self.entities)] = 0
+        self.touched[:] = False
+        self.entities = []
+
+    def evaluate(self, features):
+        """
+        Evaluate the entities in batches by the worker pool
+
+        Arguments:
+            features - array of features of the evaluated entities
+
+        Returns:
+            A tuple of arrays with scores, confidence levels and both tags
+            (CONN_CNT, TR_RAT) of the entities.
+        """
+        if self.pool is None:
+            self.pool = ThreadPoolExecutor(max_workers=g.EVAL_WORKERS,
+                                           thread_name_prefix="evaluation")
+        batches = [features[i:i + g.EVAL_BATCH]
+                   for i in range(0, len(features), g.EVAL_BATCH)]
+        if len(batches) <= 1:
+            results = [evaluate_batch(features)]
+        else:
+            results = list(self.pool.map(evaluate_batch, batches))
+        return tuple(np.concatenate(column) for column in zip(*results))
+
+    def shutdown(self):
+        if self.pool is not None:
+            self.pool.shutdown()
+            self.pool = None
+
+
+def evaluate_batch(features):
+    """
+    Goes through various features of the entities and determines whether
+    they are spammers or not. The score starts with an average score of the
+    entity flows, the score is based on Best Current Practices (BCP) and RFC
+    filter that evaluate whether the communication is legit or not. Entities
+    without incoming messages add the logarithm of the outgoing ones.
+    Then it looks at the communication ratio which is then compared with
+    constant that is computed with the Cumulative Distribution Function
+    (CDF) function (TODO dynamically adjust the ratio threshold) and at the
+    number of unique servers the entity sent messages to.
+
+    The score is adjusted with non-linear function (see SMTP_ENTITY.set_conf)
+    so it responds with the percentage value.
+
+    Arguments:
+        features - array with rows of the feature table
+
+    Returns:
+        A tuple of arrays with scores, confidence levels and both tags
+        (CONN_CNT, TR_RAT) of the entities.
+    """
+    incoming = features[:, INCOMING]
+    outgoing = features[:, OUTGOING]
+    sent = features[:, SENT]
+
+    score = features[:, AVG_SCORE].copy()
+    silent = (incoming == 0) & (outgoing > 0)
+    score[silent] += np.log(outgoing[silent])
+
+    traffic_ratio = np.zeros(len(features))
+    np.divide(incoming, sent, out=traffic_ratio, where=(sent != 0))
+
+    conn_tag = features[:, CONN_CNT] > g.MAX_ALLOWED_SERVERS
+    ratio_tag = traffic_ratio > 1.2
+    score += np.where(conn_tag, 1, -1) + np.where(ratio_tag, 1, -1)
+
+    with np.errstate(over='ignore'):
+        conf = 1 / (np.exp(-1 * score / 2) + 1)
+    return score, conf, conn_tag, ratio_tag
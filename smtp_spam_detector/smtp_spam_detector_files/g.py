@@ -64,6 +64,8 @@ MAX_ALLOWED_SERVERS = 10       # Number of maximum allowed server that mail
                                # server is able to communicate
 PROBE_INTERVAL = 5*60
 MAX_WORKERS = 2                # Maximum of allowed threads for workers
+EVAL_WORKERS = 4               # Threads evaluating batches of entities
+EVAL_BATCH = 65536             # Number of entities evaluated in one batch
 PATH_DEBUG_LOG = "/var/log/smtp_spam_detector.log"
 # ******************************************************************************
 # Detector signal handler
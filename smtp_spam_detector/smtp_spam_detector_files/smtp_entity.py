@@ -71,6 +71,8 @@ class SMTP_ENTITY:
         self.traffic_ratio = 0.0    # ratio of incoming/outgoing traffic
         self.packets = 0            # counter for volume of sent packets
         self.conn_cnt = 0           # unique entity connection counter
+        self.dst_ips = set()        # unique servers the entity sent messages to
+        self.slot = None            # row of the entity in the feature table
         self.conf_lvl = 0           # level of confidence
         self.fv = []                # feature vector
         self.tags = set()           # triggered rules by detector
@@ -88,6 +90,7 @@ class SMTP_ENTITY:
 
             self.id = args[0].SRC_IP
             self.sent_history.append(args[0])
+            self.dst_ips.add(args[0].DST_IP)
             self.bytes = args[0].BYTES
             self.packes = args[0].PACKETS
             self.time_start = args[0].TIME_FIRST
@@ -157,6 +160,7 @@ class SMTP_ENTITY:
             self.packets += flow.PACKETS
             self.bytes += flow.BYTES
             self.sent_history.append(flow)
+            self.dst_ips.add(flow.DST_IP)
 
             if type(flow) is Flow:
                 self.basic_pool.append(flow)
@@ -208,67 +212,30 @@ class SMTP_ENTITY:
         return [self.incoming, self.outgoing, self.bytes, self.avg_score,
                 self.traffic_ratio, self.packets, self.conn_cnt, self.conf_lvl]
 
-    def is_spam(self):
+    def set_evaluation(self, score, conn_tag, ratio_tag):
         """
-        Goes through various features of the entity and determines whether
-        the entity is a spammer or not. First it computes the ratio of sent
-        and received messages. Firstly it gets an average score of the entity
-        flows, the score is based on Best Current Practices (BCP) and RFC
-        filter that evaluate whether the communication is legit or not, also
-        the communication protocol is used to distinguish a legit server from
-        a spam machine.
-        Then it looks at the communication ratio which is then compared with
-        constant that is computed with the Cumulative Distribution Function
-        (CDF) function (TODO dynamically adjust the ratio threshold). Then it
-        creates an unique list which is basically a connection count value.
-
-        The evaluation happens in set_conf() function where the score is
-        adjusted with non-linear function so the score responds with the
-        percentage value.
+        Store the result of the evaluation of the entity (see
+        features.evaluate_batch) for its report.
 
         Arguments:
-            self - self.tags
-                 - self.fv
+            score - score of the entity
+            conn_tag - the entity sent messages to too many servers
+            ratio_tag - the entity received more messages than it sent
 
         Returns:
             Returns a (double) confidence level of this entity being a spammer or not in percentage.
-
         """
         tags = set()
-        score = self.avg_score
-
-        if (self.incoming == 0):
-            try:
-                score += math.log(self.outgoing)
-            except ValueError:
-                sys.stderr.write("smtp_entity: Math error")
-        sent = len(self.sent_history)
-
-        if (sent != 0):
-            traffic_ratio = self.incoming / sent
-        else:
-            traffic_ratio = 0
-        # Check for unique DST_IPs
-        unique_ips = set()
-        with self.__lock:
-            for flow in self.sent_history:
-                unique_ips.add(flow.DST_IP)
-        self.conn_cnt = len(unique_ips)
-
-        if (self.conn_cnt > MAX_ALLOWED_SERVERS):
+        if conn_tag:
             tags.add("CONN_CNT")
-            score += 1
-        else:
-            score -= 1
-        if (traffic_ratio > 1.2):
+        if ratio_tag:
             tags.add("TR_RAT")
-            score += 1
-        else:
-            score -= 1
 
-        self.fv = self.get_features()
-        self.fv.append(score)
-        self.tags = tags
+        with self.__lock:
+            self.conn_cnt = len(self.dst_ips)
+            self.fv = self.get_features()
+            self.fv.append(score)
+            self.tags = tags
         return self.set_conf(score)
 
 
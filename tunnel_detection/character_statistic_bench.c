@@ -0,0 +1,108 @@
+/**
+ * \file character_statistic_bench.c
+ * \brief Micro-benchmark of calculate_character_statistic_conv_to_lowercase() of dnstunnel_detection (make bench).
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+/*
+ * The statistic is computed in the translation unit of the module, so it is
+ * included with main() renamed.
+ */
+#define main dnstunnel_detection_main
+#include "tunnel_detection_dns.c"
+#undef main
+
+#include "bench.h"
+
+#define STRING_CNT 65536
+#define STRING_MAX_LENGTH 253
+#define STAT_ROUNDS 16
+
+/**
+ * DNS name, mostly short names of usual domains, every fourth one has long
+ * base32 labels as names of tunnels. Letters are of mixed case.
+ */
+static void random_name(char *name)
+{
+   static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+   static const char *suffix = ".Example.com";
+   size_t length = (bench_rand() % 4) ? 4 + bench_rand() % 20 : 60 + bench_rand() % 180;
+   size_t i;
+
+   for (i = 0; i < length; i++) {
+      name[i] = (i % 63 == 62) ? '.' : alphabet[bench_rand() % (sizeof(alphabet) - 1)];
+   }
+   strcpy(name + length, suffix);
+}
+
+int main(void)
+{
+   char (*names)[STRING_MAX_LENGTH + 1] = malloc(STRING_CNT * sizeof(*names));
+   character_statistic_t char_stat;
+   volatile unsigned int sink = 0;
+   unsigned long start_allocations;
+   unsigned long bytes = 0;
+   double start;
+   int r, i;
+
+   if (names == NULL) {
+      fprintf(stderr, "ERROR: could not allocate names.\n");
+      return 1;
+   }
+   for (i = 0; i < STRING_CNT; i++) {
+      random_name(names[i]);
+      bytes += strlen(names[i]);
+   }
+
+   // Names are converted in place, later rounds see lower case names only
+   start = bench_now_ns();
+   start_allocations = bench_allocations();
+   for (r = 0; r < STAT_ROUNDS; r++) {
+      for (i = 0; i < STRING_CNT; i++) {
+         calculate_character_statistic_conv_to_lowercase(names[i], &char_stat);
+         sink += char_stat.count_of_different_letters;
+      }
+   }
+   bench_report("character_statistic", (uint64_t) STAT_ROUNDS * STRING_CNT, start, start_allocations);
+   printf("%-32s %10.1f bytes\n", "mean name length", (double) bytes / STRING_CNT);
+
+   free(names);
+   (void) sink;
+   return 0;
+}
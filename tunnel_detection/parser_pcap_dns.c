@@ -41,6 +41,9 @@
  *
  */
 #include "parser_pcap_dns.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 uint32_t read_ip_address_v4(FILE * file){
 	int ip=0;
@@ -141,7 +144,7 @@ void read_item(FILE * file){
 	}
 }
 
-int read_packet(FILE *file, packet_t * create){
+int read_packet_from_file(FILE *file, packet_t * create){
 	int sign;
 	create->request_length=0;
 	create->request_string[0] = 0;
@@ -247,12 +250,270 @@ int read_packet(FILE *file, packet_t * create){
 	return 0;
 }
 
-FILE * parser_initialize(char *name){
-   	FILE *file = fopen ( name, "r" );
-   	return file;
+//functions with the same meaning as above, they move in the mapped file instead of calling fgetc/ungetc
+static inline int map_getc(packet_reader_t *reader){
+	if(reader->position >= reader->size)
+		return -1;
+	return (unsigned char)reader->data[reader->position++];
+}
+
+static inline void map_ungetc(packet_reader_t *reader, int sign){
+	if(sign != -1)
+		reader->position--;
+}
+
+static uint32_t map_read_ip_address_v4(packet_reader_t *reader){
+	uint32_t ip=0;
+	int sign;
+	int octet;
+	for (int i = 0; i < 4; i++){
+		ip <<= 8;
+		sign = map_getc(reader);
+		octet=0;
+		while(sign >= '0' && sign <= '9'){
+			octet = octet * 10 + (sign - '0');
+			sign = map_getc(reader);
+		}
+		ip |= octet;
+	}
+	map_ungetc(reader, sign);
+	return ip;
+}
+
+static int map_read_int(packet_reader_t *reader){
+	int number=0;
+	int sign;
+	sign = map_getc(reader);
+	while(sign >= '0' && sign <= '9'){
+		number = number * 10 + (sign - '0');
+		sign = map_getc(reader);
+	}
+	map_ungetc(reader, sign);
+	return number;
+}
+
+static double map_read_double(packet_reader_t *reader){
+	char number[20];
+	unsigned char size=0;
+	int sign;
+	sign = map_getc(reader);
+	while((sign >= '0' && sign <= '9') || sign == '.'){
+		if(size < sizeof(number) - 1)
+			number[size++]=sign;
+		sign = map_getc(reader);
+	}
+	number[size]=0;
+	map_ungetc(reader, sign);
+	return atof(number);
+}
+
+static int map_read_string(packet_reader_t *reader, char * string, int maxsize){
+	const char *start = reader->data + reader->position;
+	size_t left = reader->size - reader->position;
+	size_t size = 0;
+	//find end of the item and copy it at once
+	if(left > (size_t)maxsize - 1)
+		left = maxsize - 1;
+	while(size < left && start[size] != ';' && start[size] != '\n'){
+		size++;
+	}
+	memcpy(string, start, size);
+	string[size]=0;
+	reader->position += size;
+	return size;
+}
+
+static void map_read_ip_address_v6(packet_reader_t *reader, uint64_t * ip){
+	int sign;
+	unsigned char size = 0;
+	char str[40];
+	sign = map_getc(reader);
+	if(sign != ';' && sign != ',' && sign != '\n' && sign != -1 ){
+		ip_addr_t addr;
+		while(sign != ';' && sign != ',' && sign != '\n' && sign != -1 && size < 39){
+			str[size++] = sign;
+			sign = map_getc(reader);
+		}
+		str[size]=0;
+		if(ip_from_str(str, &addr) == 1){
+			memcpy(&ip[0], &addr, 16);
+		}
+		map_ungetc(reader, sign);
+	}
+}
+
+static void map_read_rest_of_line(packet_reader_t *reader){
+	const char *end = memchr(reader->data + reader->position, '\n', reader->size - reader->position);
+	reader->position = end == NULL ? reader->size : (size_t)(end - reader->data) + 1;
+}
+
+static void map_read_item(packet_reader_t *reader){
+	int sign;
+	sign = map_getc(reader);
+	while(sign != ';' && sign != '\n' && sign != -1){
+		sign = map_getc(reader);
+	}
+}
+
+//asks kernel to read next part of the file and to release the part which was already parsed
+static void map_read_ahead(packet_reader_t *reader){
+	size_t end;
+	if(reader->position + PARSER_READ_AHEAD / 2 < reader->advised)
+		return;
+	if(reader->advised < reader->size){
+		end = reader->advised + PARSER_READ_AHEAD;
+		if(end > reader->size)
+			end = reader->size;
+		madvise((void *)(reader->data + reader->advised), end - reader->advised, MADV_WILLNEED);
+		reader->advised = end;
+	}
+	//keep one part behind the parser, it can step back by one sign
+	if(reader->position >= reader->released + 2 * PARSER_READ_AHEAD){
+		madvise((void *)(reader->data + reader->released), PARSER_READ_AHEAD, MADV_DONTNEED);
+		reader->released += PARSER_READ_AHEAD;
+	}
+}
+
+int read_packet(packet_reader_t *reader, packet_t * create){
+	int sign;
+	if(reader == NULL)
+		return -1;
+	if(reader->data == NULL)
+		return read_packet_from_file(reader->file, create);
+	create->request_length=0;
+	create->request_string[0] = 0;
+	create->txt_response[0] = 0;
+	create->cname_response[0] = 0;
+	create->mx_response[0] = 0;
+	create->ns_response[0] = 0;
+
+	//test if it is not on the end of file
+	if(reader->position >= reader->size)
+		return -1;
+	map_read_ahead(reader);
+
+	//read time
+	create->time = map_read_double(reader);
+	map_getc(reader);
+
+	//read ip address v4
+	sign = map_getc(reader);
+	if(sign != ';'){
+		map_ungetc(reader, sign);
+		create->src_ip_v4 = map_read_ip_address_v4(reader);
+		map_getc(reader);
+		create->dst_ip_v4 = map_read_ip_address_v4(reader);
+		map_getc(reader);
+		create->ip_version = IP_VERSION_4;
+	}
+	//read ip address v6
+	sign = map_getc(reader);
+	if(sign != ';'){
+		map_ungetc(reader, sign);
+		map_read_ip_address_v6(reader, create->src_ip_v6);
+		map_getc(reader);
+		map_read_ip_address_v6(reader, create->dst_ip_v6);
+		map_getc(reader);
+		create->ip_version = IP_VERSION_6;
+	}
+	//read type (response/request)
+	sign = map_getc(reader);
+	if(sign != ';'){
+		map_ungetc(reader, sign);
+		create->is_response = map_read_int(reader);
+		map_getc(reader);
+	}
+	//read size
+	sign = map_getc(reader);
+	if(sign != ';'){
+		map_ungetc(reader, sign);
+		create->size = map_read_int(reader);
+		map_getc(reader);
+	}
+	//read request string
+	sign = map_getc(reader);
+	if(sign != ';'){
+		map_ungetc(reader, sign);
+		create->request_length = map_read_string(reader, create->request_string, MAX_LENGTH_OF_REQUEST_DOMAIN);
+		map_getc(reader);
+	}
+
+	if(create->is_response){
+		//read response ip
+		map_getc(reader);
+		map_read_item(reader);
+
+		//read txt string
+		sign = map_getc(reader);
+		if(sign != ';'){
+			map_ungetc(reader, sign);
+			map_read_string(reader, create->txt_response, MAX_LENGTH_OF_RESPONSE_STRING);
+			map_getc(reader);
+		}
+		//read cname string
+		sign = map_getc(reader);
+		if(sign != ';'){
+			map_ungetc(reader, sign);
+			map_read_string(reader, create->cname_response, MAX_LENGTH_OF_RESPONSE_STRING);
+			map_getc(reader);
+		}
+		//read mx string
+		sign = map_getc(reader);
+		if(sign != ';'){
+			map_ungetc(reader, sign);
+			map_read_string(reader, create->mx_response, MAX_LENGTH_OF_RESPONSE_STRING);
+			map_getc(reader);
+		}
+		//read ns string
+		sign = map_getc(reader);
+		if(sign != ';' && sign != '\n' && sign != -1){
+			map_ungetc(reader, sign);
+			map_read_string(reader, create->ns_response, MAX_LENGTH_OF_RESPONSE_STRING);
+			map_getc(reader);
+		}
+		map_read_rest_of_line(reader);
+	}
+	else{
+		//read rest of line
+		map_read_rest_of_line(reader);
+	}
+	return 0;
+}
+
+packet_reader_t * parser_initialize(char *name){
+	struct stat st;
+	void *data;
+	int fd;
+	packet_reader_t *reader = (packet_reader_t *) calloc(1, sizeof(packet_reader_t));
+	if(reader == NULL)
+		return NULL;
+	fd = open(name, O_RDONLY);
+	if(fd != -1 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0){
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(data != MAP_FAILED){
+			madvise(data, st.st_size, MADV_SEQUENTIAL);
+			reader->data = (const char *) data;
+			reader->size = st.st_size;
+		}
+	}
+	if(fd != -1)
+		close(fd);
+	if(reader->data == NULL){
+		//pipes and empty files are read by stdio
+		reader->file = fopen(name, "r");
+		if(reader->file == NULL){
+			free(reader);
+			return NULL;
+		}
+	}
+	return reader;
 }
 
 
-void parser_end(FILE *file){
-	fclose(file);
+void parser_end(packet_reader_t *reader){
+	if(reader->data != NULL)
+		munmap((void *) reader->data, reader->size);
+	if(reader->file != NULL)
+		fclose(reader->file);
+	free(reader);
 }
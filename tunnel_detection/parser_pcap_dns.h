@@ -60,6 +60,25 @@
 #include <unirec/unirec.h>
 #include "tunnel_detection_dns_structs.h"
 
+/*!
+ * \name Reading of mapped file
+ * \{ */
+#define PARSER_READ_AHEAD (16 * 1024 * 1024) /*< Size of the part of mapped file read ahead (and released behind) */
+/* /} */
+
+/*!
+ * \brief Structure - reader of packets
+ * Structure used to read packets from the file. Regular files are mapped to memory and parsed
+ * in place, other files (pipes) are read by stdio.
+ */
+typedef struct packet_reader_t {
+	FILE * file;            /*< file read by stdio, NULL when the file is mapped */
+	const char * data;      /*< mapped file */
+	size_t size;            /*< size of mapped file */
+	size_t position;        /*< position of parser in mapped file */
+	size_t advised;         /*< end of the part of mapped file requested to be read */
+	size_t released;        /*< end of the part of mapped file released from memory */
+} packet_reader_t;
 
 
 
@@ -113,27 +132,36 @@ void read_ip_address_v6(FILE * file, uint64_t * ip);
 void read_rest_of_line(FILE * file);
 
 /*!
- * \brief Read packet from file
+ * \brief Read packet from file by stdio
  * Function reads packet from file
  * \param[in] file pointer to file.
  * \param[in] create pointer to structure with results.
  * \return 0 on SUCCESS, -1 on end of the file
  */
-int read_packet(FILE *file, packet_t * create);
+int read_packet_from_file(FILE *file, packet_t * create);
+
+/*!
+ * \brief Read packet
+ * Function reads packet from mapped file (or from file by stdio, when it is not mapped)
+ * \param[in] reader pointer to reader.
+ * \param[in] create pointer to structure with results.
+ * \return 0 on SUCCESS, -1 on end of the file
+ */
+int read_packet(packet_reader_t *reader, packet_t * create);
 
 /*!
  * \brief Init function of parser
- * Function inicialize parser (open file for reading)
+ * Function inicialize parser (open file for reading and map it to memory, if it is regular file)
  * \param[in] name name of file
- * \return pointer on file on SUCCESS, NULL on ERROR
+ * \return pointer on reader on SUCCESS, NULL on ERROR
  */
-FILE * parser_initialize(char *name);
+packet_reader_t * parser_initialize(char *name);
 
 /*!
  * \brief Parser end
  * Function close file for reading packets
- * \param[in] file pointer to file.
+ * \param[in] reader pointer to reader.
  */
-void parser_end(FILE *file);
+void parser_end(packet_reader_t *reader);
 
  #endif /* _PARSER_PCAP_DNS_ */
\ No newline at end of file
@@ -0,0 +1,313 @@
+/*!
+ * \file suspicion_store.c
+ * \brief Storage of strings of suspicious IP addresses - prefix tree or bounded sketch.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "suspicion_store.h"
+
+//hash of string (FNV-1a with final mixing, all bits are used by sketch)
+static uint64_t sketch_hash(const char * string, int length)
+{
+   uint64_t hash = 14695981039346656037ULL;
+   int i;
+   for (i = 0; i < length; i++) {
+      hash ^= (unsigned char)string[i];
+      hash *= 1099511628211ULL;
+   }
+   hash ^= hash >> 33;
+   hash *= 0xff51afd7ed558ccdULL;
+   hash ^= hash >> 33;
+   hash *= 0xc4ceb9fe1a85ec53ULL;
+   hash ^= hash >> 33;
+   return hash;
+}
+
+//finds start of the domain of given depth (from the end of string)
+static int sketch_domain_start(const char * string, int length, int depth)
+{
+   int i = length;
+   //skip dot on the end
+   if (i > 0 && string[i - 1] == '.') {
+      i--;
+   }
+   while (i > 0) {
+      if (string[i - 1] == '.' && --depth == 0) {
+         return i;
+      }
+      i--;
+   }
+   return 0;
+}
+
+//counts domain of string in most used domains (Space-Saving)
+static uint32_t sketch_insert_domain(suspicion_sketch_t * sketch, const char * string, int length)
+{
+   suspicion_sketch_domain_t * dom;
+   unsigned int i, min;
+   int start = sketch_domain_start(string, length, SKETCH_DOMAIN_DEPTH);
+   uint32_t hash = (uint32_t)sketch_hash(string + start, length - start);
+   for (i = 0; i < sketch->count_of_domains; i++) {
+      if (sketch->domains[i].hash == hash) {
+         sketch->domains[i].count_of_insert++;
+         return hash;
+      }
+   }
+   if (sketch->count_of_domains < SKETCH_TOP_DOMAINS) {
+      dom = &sketch->domains[sketch->count_of_domains++];
+      dom->count_of_insert = 1;
+   }
+   else {
+      //replace the least used domain, it inherits its count
+      min = 0;
+      for (i = 1; i < SKETCH_TOP_DOMAINS; i++) {
+         if (sketch->domains[i].count_of_insert < sketch->domains[min].count_of_insert) {
+            min = i;
+         }
+      }
+      dom = &sketch->domains[min];
+      dom->count_of_insert++;
+   }
+   dom->hash = hash;
+   length -= start;
+   if (length >= SKETCH_MAX_LENGTH_OF_STRING) {
+      length = SKETCH_MAX_LENGTH_OF_STRING - 1;
+   }
+   memcpy(dom->domain, string + start, length);
+   dom->domain[length] = 0;
+   return hash;
+}
+
+//adds string to sampled strings, if its hash is small enough
+static void sketch_insert_item(suspicion_sketch_t * sketch, const char * string, int length, uint32_t domain_hash)
+{
+   uint64_t hash = sketch_hash(string, length);
+   unsigned int low = 0, high = sketch->count_of_items, middle;
+   //find position of hash
+   while (low < high) {
+      middle = (low + high) / 2;
+      if (sketch->items[middle].hash < hash) {
+         low = middle + 1;
+      }
+      else {
+         high = middle;
+      }
+   }
+   if (low < sketch->count_of_items && sketch->items[low].hash == hash) {
+      //sampled string
+      if (sketch->items[low].count_of_insert++ == 1) {
+         sketch->count_of_items_once--;
+      }
+      return;
+   }
+   if (low == SKETCH_SIZE) {
+      //hash is bigger than all sampled
+      return;
+   }
+   if (sketch->count_of_items == SKETCH_SIZE) {
+      //drop the string with the biggest hash
+      if (sketch->items[SKETCH_SIZE - 1].count_of_insert == 1) {
+         sketch->count_of_items_once--;
+      }
+      sketch->count_of_items--;
+   }
+   memmove(&sketch->items[low + 1], &sketch->items[low], (sketch->count_of_items - low) * sizeof(suspicion_sketch_item_t));
+   sketch->items[low].hash = hash;
+   sketch->items[low].domain_hash = domain_hash;
+   sketch->items[low].count_of_insert = 1;
+   sketch->count_of_items++;
+   sketch->count_of_items_once++;
+   //text is kept just for the first strings
+   if (low < SKETCH_SAMPLES) {
+      memmove(sketch->samples[low + 1], sketch->samples[low], (SKETCH_SAMPLES - low - 1) * SKETCH_MAX_LENGTH_OF_STRING);
+      if (length >= SKETCH_MAX_LENGTH_OF_STRING) {
+         length = SKETCH_MAX_LENGTH_OF_STRING - 1;
+      }
+      memcpy(sketch->samples[low], string, length);
+      sketch->samples[low][length] = 0;
+   }
+}
+
+//estimated count of different strings
+static double sketch_count_of_different(suspicion_sketch_t * sketch)
+{
+   if (sketch->count_of_items < SKETCH_SIZE) {
+      return sketch->count_of_items;
+   }
+   //K-th smallest hash of uniformly distributed hashes
+   return (double)(SKETCH_SIZE - 1) / ((double)sketch->items[SKETCH_SIZE - 1].hash / 18446744073709551616.0);
+}
+
+suspicion_store_t * suspicion_store_initialize(unsigned char sketch)
+{
+   suspicion_store_t * store = (suspicion_store_t*)calloc(sizeof(suspicion_store_t), 1);
+   if (store == NULL) {
+      return NULL;
+   }
+   if (sketch) {
+      store->sketch = (suspicion_sketch_t*)calloc(sizeof(suspicion_sketch_t), 1);
+   }
+   else {
+      store->tree = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+   }
+   if (store->sketch == NULL && store->tree == NULL) {
+      free(store);
+      return NULL;
+   }
+   return store;
+}
+
+void suspicion_store_destroy(suspicion_store_t * store)
+{
+   if (store == NULL) {
+      return;
+   }
+   if (store->tree != NULL) {
+      prefix_tree_destroy(store->tree);
+   }
+   free(store->sketch);
+   free(store);
+}
+
+void suspicion_store_insert(suspicion_store_t * store, const char * string, int length)
+{
+   suspicion_sketch_t * sketch;
+   double different;
+   if (store == NULL) {
+      return;
+   }
+   if (store->tree != NULL) {
+      prefix_tree_insert(store->tree, string, length);
+      store->count_of_inserting = store->tree->count_of_inserting;
+      store->count_of_inserting_for_just_ones = store->tree->count_of_inserting_for_just_ones;
+      store->count_of_domain_searched_just_ones = store->tree->count_of_domain_searched_just_ones;
+      store->count_of_different_domains = store->tree->count_of_different_domains;
+      return;
+   }
+   sketch = store->sketch;
+   sketch_insert_item(sketch, string, length, sketch_insert_domain(sketch, string, length));
+   store->count_of_inserting++;
+   store->count_of_inserting_for_just_ones = store->count_of_inserting;
+   different = sketch_count_of_different(sketch);
+   store->count_of_different_domains = (int)(different + 0.5);
+   store->count_of_domain_searched_just_ones = (int)(different * sketch->count_of_items_once / sketch->count_of_items + 0.5);
+}
+
+double suspicion_store_most_used_domain_percent_of_subdomains(suspicion_store_t * store, int depth)
+{
+   suspicion_sketch_t * sketch;
+   unsigned int i, max, count_of_subdomains;
+   if (store->tree != NULL) {
+      return prefix_tree_most_used_domain_percent_of_subdomains(store->tree, depth);
+   }
+   sketch = store->sketch;
+   if (sketch->count_of_domains == 0) {
+      return 0;
+   }
+   max = 0;
+   for (i = 1; i < sketch->count_of_domains; i++) {
+      if (sketch->domains[i].count_of_insert > sketch->domains[max].count_of_insert) {
+         max = i;
+      }
+   }
+   //part of sampled strings with the domain
+   count_of_subdomains = 0;
+   for (i = 0; i < sketch->count_of_items; i++) {
+      if (sketch->items[i].domain_hash == sketch->domains[max].hash) {
+         count_of_subdomains++;
+      }
+   }
+   return sketch_count_of_different(sketch) * count_of_subdomains / sketch->count_of_items / sketch->domains[max].count_of_insert;
+}
+
+int suspicion_store_read_domain(suspicion_store_t * store, int list, int index, char * string, int * count)
+{
+   suspicion_sketch_t * sketch;
+   unsigned int i, j, order[SKETCH_TOP_DOMAINS > SKETCH_SAMPLES ? SKETCH_TOP_DOMAINS : SKETCH_SAMPLES], size;
+   string[0] = 0;
+   if (store->tree != NULL) {
+      prefix_tree_domain_t * dom = list == SUSPICION_MOST_USED ? store->tree->domain_extension->list_of_most_used_domains :
+                                                                 store->tree->domain_extension->list_of_most_unused_domains;
+      while (dom != NULL && index-- > 0) {
+         dom = dom->domain_extension->most_used_domain_less;
+      }
+      if (dom == NULL) {
+         return 0;
+      }
+      prefix_tree_read_string(store->tree, dom, string);
+      if (count != NULL) {
+         *count = dom->count_of_insert;
+      }
+      return 1;
+   }
+   sketch = store->sketch;
+   size = list == SUSPICION_MOST_USED ? sketch->count_of_domains :
+          (sketch->count_of_items < SKETCH_SAMPLES ? sketch->count_of_items : SKETCH_SAMPLES);
+   if (index < 0 || (unsigned int)index >= size) {
+      return 0;
+   }
+   //sort indexes by count, descending for most used, ascending for most unused
+   for (i = 0; i < size; i++) {
+      unsigned int value = list == SUSPICION_MOST_USED ? sketch->domains[i].count_of_insert : sketch->items[i].count_of_insert;
+      for (j = i; j > 0; j--) {
+         unsigned int prev = list == SUSPICION_MOST_USED ? sketch->domains[order[j - 1]].count_of_insert : sketch->items[order[j - 1]].count_of_insert;
+         if (list == SUSPICION_MOST_USED ? prev >= value : prev <= value) {
+            break;
+         }
+         order[j] = order[j - 1];
+      }
+      order[j] = i;
+   }
+   i = order[index];
+   if (list == SUSPICION_MOST_USED) {
+      strcpy(string, sketch->domains[i].domain);
+      if (count != NULL) {
+         *count = sketch->domains[i].count_of_insert;
+      }
+   }
+   else {
+      strcpy(string, sketch->samples[i]);
+      if (count != NULL) {
+         *count = sketch->items[i].count_of_insert;
+      }
+   }
+   return 1;
+}
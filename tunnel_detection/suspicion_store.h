@@ -0,0 +1,162 @@
+/*!
+ * \file suspicion_store.h
+ * \brief Storage of strings of suspicious IP addresses - prefix tree or bounded sketch.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef _SUSPICION_STORE_
+#define _SUSPICION_STORE_
+
+#include <stdint.h>
+#include <prefix_tree.h>
+
+/*!
+ * \name Sketch setting
+ *  Defines size of the sketch, which limits memory used by one suspicion.
+ * \{ */
+#define SKETCH_SIZE 128               /*< Count of sampled different strings (with the smallest hashes) */
+#define SKETCH_TOP_DOMAINS 8          /*< Count of most used domains kept in sketch */
+#define SKETCH_SAMPLES 5              /*< Count of sampled strings kept with their text */
+#define SKETCH_DOMAIN_DEPTH 2         /*< Depth of domains counted in sketch (same as DEPTH_TUNNEL_SUSPICTION) */
+#define SKETCH_MAX_LENGTH_OF_STRING 255 /*< Maximal length of stored domain or sample string (with terminating zero) */
+/* /} */
+
+/*!
+ * \name Lists of domains
+ *  Specify list of domains to read from the storage.
+ * \{ */
+#define SUSPICION_MOST_USED 0   /*< Most used domains */
+#define SUSPICION_MOST_UNUSED 1 /*< Least used domains, least used sampled strings in sketch */
+/* /} */
+
+/*!
+ * \brief Structure - sampled string in sketch
+ * Structure used to keep information about one sampled string.
+ */
+typedef struct suspicion_sketch_item_t {
+   uint64_t hash;             /*< hash of string */
+   uint32_t domain_hash;      /*< hash of domain of string */
+   uint32_t count_of_insert;  /*< count of inserting of string */
+} suspicion_sketch_item_t;
+
+/*!
+ * \brief Structure - domain in sketch
+ * Structure used to keep information about one of most used domains in sketch.
+ */
+typedef struct suspicion_sketch_domain_t {
+   char domain[SKETCH_MAX_LENGTH_OF_STRING]; /*< domain string */
+   uint32_t hash;                            /*< hash of domain */
+   unsigned int count_of_insert;             /*< count of inserting, overestimated by replaced domains */
+} suspicion_sketch_domain_t;
+
+/*!
+ * \brief Structure - sketch of strings
+ * Structure used instead of prefix tree, it has fixed size. It samples different strings
+ * with the smallest hashes (with their exact counts), which is used to estimate count of different
+ * strings and strings searched just once. Most used domains are counted by Space-Saving algorithm.
+ */
+typedef struct suspicion_sketch_t {
+   suspicion_sketch_item_t items[SKETCH_SIZE];              /*< sampled strings sorted by hash */
+   suspicion_sketch_domain_t domains[SKETCH_TOP_DOMAINS];   /*< most used domains */
+   char samples[SKETCH_SAMPLES][SKETCH_MAX_LENGTH_OF_STRING]; /*< text of the first sampled strings */
+   unsigned int count_of_items;                             /*< count of sampled strings */
+   unsigned int count_of_items_once;                        /*< count of sampled strings inserted just once */
+   unsigned int count_of_domains;                           /*< count of used domains */
+} suspicion_sketch_t;
+
+/*!
+ * \brief Structure - storage of suspicious strings
+ * Structure used to keep strings of suspicion. The counters have the same meaning as in prefix tree,
+ * in sketch mode they are estimated.
+ */
+typedef struct suspicion_store_t {
+   prefix_tree_t * tree;        /*< prefix tree, NULL in sketch mode */
+   suspicion_sketch_t * sketch; /*< sketch, NULL in prefix tree mode */
+   int count_of_inserting;      /*< count of inserted strings */
+   int count_of_inserting_for_just_ones; /*< count of inserted strings, for calculating strings searched just once */
+   int count_of_domain_searched_just_ones; /*< count of strings inserted just once */
+   int count_of_different_domains; /*< count of different domains (different strings in sketch) */
+} suspicion_store_t;
+
+/*!
+ * \brief Initialize storage
+ * Function creates storage of suspicious strings.
+ * \param[in] sketch 1 to use bounded sketch, 0 to use prefix tree.
+ * \return pointer to storage, NULL on error.
+ */
+suspicion_store_t * suspicion_store_initialize(unsigned char sketch);
+
+/*!
+ * \brief Destroy storage
+ * Function frees all memory of storage.
+ * \param[in] store pointer to storage.
+ */
+void suspicion_store_destroy(suspicion_store_t * store);
+
+/*!
+ * \brief Insert string to storage
+ * Function inserts string and updates counters of storage.
+ * \param[in] store pointer to storage.
+ * \param[in] string inserted string.
+ * \param[in] length length of string.
+ */
+void suspicion_store_insert(suspicion_store_t * store, const char * string, int length);
+
+/*!
+ * \brief Percent of subdomains in most used domain
+ * Function calculates count of different subdomains of most used domain divided by count of its inserting.
+ * \param[in] store pointer to storage.
+ * \param[in] depth depth of domain (sketch uses SKETCH_DOMAIN_DEPTH).
+ * \return percent of subdomains.
+ */
+double suspicion_store_most_used_domain_percent_of_subdomains(suspicion_store_t * store, int depth);
+
+/*!
+ * \brief Read domain from list
+ * Function reads index-th domain of the list of most used or most unused domains.
+ * \param[in] store pointer to storage.
+ * \param[in] list SUSPICION_MOST_USED or SUSPICION_MOST_UNUSED.
+ * \param[in] index index of domain in the list.
+ * \param[out] string buffer for domain, at least MAX_LENGTH_OF_REQUEST_DOMAIN long.
+ * \param[out] count count of inserting of the domain, can be NULL.
+ * \return 1 if the domain exists, 0 otherwise.
+ */
+int suspicion_store_read_domain(suspicion_store_t * store, int list, int index, char * string, int * count);
+
+#endif /* _SUSPICION_STORE_ */
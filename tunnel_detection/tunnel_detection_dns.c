@@ -52,8 +52,19 @@
 #include <ctype.h>
 #include <time.h>
 #include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "tunnel_detection_dns.h"
 #include "parser_pcap_dns.h"
+#include "worker.h"
+#include "metrics.h"
+#include "overload.h"
+#include "affinity.h"
 #include "fields.h"
 
 UR_FIELDS (
@@ -106,12 +117,26 @@ trap_module_info_t *module_info = NULL;
   PARAM('t', "max_round", "MAX round in SUSPICION MODE and ATTACK MODE [SUSPICION, ATTACK]", required_argument, "string") \
   PARAM('w', "tunnel_length", "MIN length of string to be tunnel [MIN].", required_argument, "int32") \
   PARAM('z', "collect_length", "Length of collecting packets before analysis in sec [time in sec]", required_argument, "int32") \
-  PARAM('E', "file_event_id", "Path to file with last used event id (Id of an alert). Default path is /data/dnstunnel_tunnel/event_id.txt", required_argument, "string")
+  PARAM('E', "file_event_id", "Path to file with last used event id (Id of an alert). Default path is /data/dnstunnel_tunnel/event_id.txt", required_argument, "string") \
+  PARAM('x', "sketch", "Keep strings of suspicious IPs in a bounded sketch instead of a prefix tree (limits memory used by one IP).", no_argument, "none") \
+  PARAM('W', "workers", "Number of worker threads, IP addresses are distributed among them by hash (0 by default, packets are processed by the receiving thread).", required_argument, "uint32") \
+  PARAM('M', "metrics", "UNIX socket serving runtime metrics in Prometheus text format.", required_argument, "string") \
+  PARAM('L', "overload", "Load (0-1] of the receiving thread above which only IPs sampled by hash are analyzed (disabled by default).", required_argument, "float") \
+  PARAM('A', "affinity", "List of CPUs the receiving thread and the workers are pinned to in turns, e.g. 0-3 (not pinned by default).", required_argument, "string")
 
 static int stop = 0;
 static int stats = 0;
 static int progress = 0;
 static values_t values;
+static __thread time_t current_time = 0; /*< Module clock driven by the timestamps of received records, every worker has its own */
+static pthread_mutex_t alert_lock = PTHREAD_MUTEX_INITIALIZER; /*< Guards output interfaces shared by workers */
+
+// Runtime metrics, registered in main and shared by the workers
+static metrics_counter_t *records_metric = NULL;
+static metrics_histogram_t *packet_metric = NULL;
+static metrics_histogram_t *evaluation_metric = NULL;
+static metrics_gauge_t *tracked_ipv4_metric = NULL;
+static metrics_gauge_t *tracked_ipv6_metric = NULL;
 
 #ifdef TIME
    static int add_to_bplus = 0;
@@ -133,6 +158,13 @@ void signal_handler(int signal)
    }
 }
 
+void update_current_time(time_t t)
+{
+   if (t > current_time) {
+      current_time = t;
+   }
+}
+
 void calculate_limits_by_confidential_interval( double sum, double sum_2, int count, double * min, double * max) {
    double ex, var, std;
    ex = sum / (double)count;
@@ -182,7 +214,7 @@ void get_ip_str_from_ip_struct(ip_address_t * item, void * key,  char * ip_buff)
 
 static inline unsigned int get_event_id()
 {
-   return values.event_id_counter++;
+   return __sync_fetch_and_add(&values.event_id_counter, 1);
 }
 
 int filter_trafic_to_save_in_prefix_tree_tunnel_suspicion(character_statistic_t * char_stat)
@@ -197,20 +229,32 @@ int filter_trafic_to_save_in_prefix_tree_tunnel_suspicion(character_statistic_t
    return 0;
 }
 
-void collection_of_information_and_basic_payload_detection(bpt_t * tree, void * ip_in_packet, packet_t * packet)
+static uint64_t packet_host(packet_t * packet)
+{
+   uint64_t * ip;
+   if (packet->ip_version == IP_VERSION_4) {
+      return (uint64_t)(packet->is_response ? packet->dst_ip_v4 : packet->src_ip_v4);
+   }
+   ip = packet->is_response ? packet->dst_ip_v6 : packet->src_ip_v6;
+   return ip[0] ^ ip[1];
+}
+
+void collection_of_information_and_basic_payload_detection(ip_table_t * table, evaluation_list_t * list, void * ip_in_packet, packet_t * packet)
 {
    ip_address_t * found;
    float size2;
    int index_to_histogram;
    character_statistic_t char_stat;
+   uint64_t start = metrics_start();
    size2=packet->size*packet->size;
-   //found or create in b plus tree
-   found = (ip_address_t*)bpt_search_or_insert(tree,ip_in_packet);
+   //found or create in the table
+   found = (ip_address_t*)ip_table_search_or_insert(table, ip_in_packet);
    if (found == NULL) {
+      metrics_stop(packet_metric, start);
       return;
    }
    found->ip_version = packet->ip_version;
-   found->time_last = time(NULL);
+   found->time_last = current_time;
 
    #ifdef TIME
       if (found->counter_request.dns_request_count == 0 && found->counter_response.dns_response_count ==0) {
@@ -244,12 +288,12 @@ void collection_of_information_and_basic_payload_detection(bpt_t * tree, void *
                   found->suspision_request_tunnel = (ip_address_suspision_request_tunnel_t*)calloc(sizeof(ip_address_suspision_request_tunnel_t),1);
                }
                if (found->suspision_request_tunnel != NULL && found->suspision_request_tunnel->tunnel_suspision == NULL) {
-                  found->suspision_request_tunnel->tunnel_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
-                  time(&(found->suspision_request_tunnel->time_first));
+                  found->suspision_request_tunnel->tunnel_suspision = suspicion_store_initialize(values.suspicion_sketch);
+                  found->suspision_request_tunnel->time_first = current_time;
                }
                if (found->suspision_request_tunnel != NULL && found->suspision_request_tunnel->tunnel_suspision != NULL) {
                   found->suspision_request_tunnel->sum_of_inserting++;
-                  prefix_tree_insert(found->suspision_request_tunnel->tunnel_suspision, packet->request_string, char_stat.length);
+                  suspicion_store_insert(found->suspision_request_tunnel->tunnel_suspision, packet->request_string, char_stat.length);
                }
                #ifdef TIME
                   add_to_prefix++;
@@ -260,7 +304,7 @@ void collection_of_information_and_basic_payload_detection(bpt_t * tree, void *
             }
             else if (found->state_request_tunnel != STATE_NEW && found->suspision_request_tunnel && found->suspision_request_tunnel->state_request_size[index_to_histogram] == STATE_ATTACK) {
                found->suspision_request_tunnel->sum_of_inserting++;
-               prefix_tree_insert(found->suspision_request_tunnel->tunnel_suspision, packet->request_string, char_stat.length);
+               suspicion_store_insert(found->suspision_request_tunnel->tunnel_suspision, packet->request_string, char_stat.length);
                #ifdef TIME
                   add_to_prefix++;
                #endif /*TIME*/
@@ -268,7 +312,7 @@ void collection_of_information_and_basic_payload_detection(bpt_t * tree, void *
             //add to prefix tree, if ip is in suspision state, other anomaly
             if (found->state_request_other != STATE_NEW && found->suspision_request_other && found->suspision_request_other->state_request_size[index_to_histogram] == STATE_ATTACK) {
                found->suspision_request_other->sum_of_inserting++;
-               prefix_tree_insert(found->suspision_request_other->other_suspision, packet->request_string, char_stat.length);
+               suspicion_store_insert(found->suspision_request_other->other_suspision, packet->request_string, char_stat.length);
                #ifdef TIME
                   add_to_prefix++;
                #endif /*TIME*/
@@ -293,7 +337,7 @@ void collection_of_information_and_basic_payload_detection(bpt_t * tree, void *
          if (packet->request_length > 0) {
             calculate_character_statistic_conv_to_lowercase(packet->request_string, &char_stat);
             found->suspision_response_other->sum_of_inserting++;
-            prefix_tree_insert(found->suspision_response_other->other_suspision, packet->request_string, char_stat.length);
+            suspicion_store_insert(found->suspision_response_other->other_suspision, packet->request_string, char_stat.length);
             #ifdef TIME
                add_to_prefix++;
             #endif /*TIME*/
@@ -311,14 +355,14 @@ void collection_of_information_and_basic_payload_detection(bpt_t * tree, void *
                found->suspision_response_tunnel = (ip_address_suspision_response_tunnel_t*)calloc(sizeof(ip_address_suspision_response_tunnel_t),1);
             }
             if (found->suspision_response_tunnel != NULL && found->suspision_response_tunnel->request_suspision == NULL) {
-               found->suspision_response_tunnel->request_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+               found->suspision_response_tunnel->request_suspision = suspicion_store_initialize(values.suspicion_sketch);
                if (found->suspision_response_tunnel->request_suspision) {
-                  time(&(found->suspision_response_tunnel->request_suspision_time_first));
+                  found->suspision_response_tunnel->request_suspision_time_first = current_time;
                }
             }
             if (found->suspision_response_tunnel != NULL && found->suspision_response_tunnel->request_suspision != NULL) {
                found->suspision_response_tunnel->sum_of_inserting_request++;
-               prefix_tree_insert(found->suspision_response_tunnel->request_suspision, packet->request_string, char_stat.length);
+               suspicion_store_insert(found->suspision_response_tunnel->request_suspision, packet->request_string, char_stat.length);
             }
             #ifdef TIME
                add_to_prefix++;
@@ -336,14 +380,14 @@ void collection_of_information_and_basic_payload_detection(bpt_t * tree, void *
                found->suspision_response_tunnel = (ip_address_suspision_response_tunnel_t*)calloc(sizeof(ip_address_suspision_response_tunnel_t),1);
             }
             if (found->suspision_response_tunnel != NULL && found->suspision_response_tunnel->txt_suspision == NULL) {
-               found->suspision_response_tunnel->txt_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+               found->suspision_response_tunnel->txt_suspision = suspicion_store_initialize(values.suspicion_sketch);
                if (found->suspision_response_tunnel->txt_suspision) {
-                  time(&(found->suspision_response_tunnel->txt_suspision_time_first));
+                  found->suspision_response_tunnel->txt_suspision_time_first = current_time;
                }
             }
             if (found->suspision_response_tunnel != NULL && found->suspision_response_tunnel->txt_suspision != NULL) {
                found->suspision_response_tunnel->sum_of_inserting_txt++;
-               prefix_tree_insert(found->suspision_response_tunnel->txt_suspision, packet->txt_response, char_stat.length);
+               suspicion_store_insert(found->suspision_response_tunnel->txt_suspision, packet->txt_response, char_stat.length);
             }
             #ifdef TIME
                add_to_prefix++;
@@ -360,14 +404,14 @@ void collection_of_information_and_basic_payload_detection(bpt_t * tree, void *
                found->suspision_response_tunnel = (ip_address_suspision_response_tunnel_t*)calloc(sizeof(ip_address_suspision_response_tunnel_t),1);
             }
             if (found->suspision_response_tunnel != NULL && found->suspision_response_tunnel->cname_suspision == NULL) {
-               found->suspision_response_tunnel->cname_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+               found->suspision_response_tunnel->cname_suspision = suspicion_store_initialize(values.suspicion_sketch);
                if (found->suspision_response_tunnel->cname_suspision) {
-                  time(&(found->suspision_response_tunnel->cname_suspision_time_first));
+                  found->suspision_response_tunnel->cname_suspision_time_first = current_time;
                }
             }
             if (found->suspision_response_tunnel != NULL && found->suspision_response_tunnel->cname_suspision != NULL) {
                found->suspision_response_tunnel->sum_of_inserting_cname++;
-               prefix_tree_insert(found->suspision_response_tunnel->cname_suspision, packet->cname_response, char_stat.length);
+               suspicion_store_insert(found->suspision_response_tunnel->cname_suspision, packet->cname_response, char_stat.length);
             }
             #ifdef TIME
                add_to_prefix++;
@@ -384,14 +428,14 @@ void collection_of_information_and_basic_payload_detection(bpt_t * tree, void *
                found->suspision_response_tunnel = (ip_address_suspision_response_tunnel_t*)calloc(sizeof(ip_address_suspision_response_tunnel_t),1);
             }
             if (found->suspision_response_tunnel !=NULL && found->suspision_response_tunnel->mx_suspision == NULL) {
-               found->suspision_response_tunnel->mx_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+               found->suspision_response_tunnel->mx_suspision = suspicion_store_initialize(values.suspicion_sketch);
                if (found->suspision_response_tunnel->mx_suspision) {
-                  time(&(found->suspision_response_tunnel->mx_suspision_time_first));
+                  found->suspision_response_tunnel->mx_suspision_time_first = current_time;
                }
             }
             if (found->suspision_response_tunnel !=NULL && found->suspision_response_tunnel->mx_suspision != NULL) {
                found->suspision_response_tunnel->sum_of_inserting_mx++;
-               prefix_tree_insert(found->suspision_response_tunnel->mx_suspision, packet->mx_response, char_stat.length);
+               suspicion_store_insert(found->suspision_response_tunnel->mx_suspision, packet->mx_response, char_stat.length);
             }
             #ifdef TIME
                add_to_prefix++;
@@ -408,14 +452,14 @@ void collection_of_information_and_basic_payload_detection(bpt_t * tree, void *
                found->suspision_response_tunnel = (ip_address_suspision_response_tunnel_t*)calloc(sizeof(ip_address_suspision_response_tunnel_t),1);
             }
             if (found->suspision_response_tunnel != NULL && found->suspision_response_tunnel->ns_suspision == NULL) {
-               found->suspision_response_tunnel->ns_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+               found->suspision_response_tunnel->ns_suspision = suspicion_store_initialize(values.suspicion_sketch);
                if (found->suspision_response_tunnel->ns_suspision) {
-                  time(&(found->suspision_response_tunnel->ns_suspision_time_first));
+                  found->suspision_response_tunnel->ns_suspision_time_first = current_time;
                }
             }
             if (found->suspision_response_tunnel != NULL && found->suspision_response_tunnel->ns_suspision != NULL) {
                found->suspision_response_tunnel->sum_of_inserting_ns++;
-               prefix_tree_insert(found->suspision_response_tunnel->ns_suspision, packet->ns_response, char_stat.length);
+               suspicion_store_insert(found->suspision_response_tunnel->ns_suspision, packet->ns_response, char_stat.length);
             }
             #ifdef TIME
                add_to_prefix++;
@@ -426,32 +470,103 @@ void collection_of_information_and_basic_payload_detection(bpt_t * tree, void *
          }
       }
    }
+   //IP will be evaluated, when the traffic anomaly could be found or it is in suspicion
+   if (!found->in_evaluation &&
+       (found->counter_request.dns_request_count > values.min_dns_request_count_other_anomaly ||
+        found->counter_response.dns_response_count > values.min_dns_response_count_other_anomaly ||
+        found->state_request_tunnel != STATE_NEW || found->state_response_tunnel != STATE_NEW ||
+        found->state_request_other != STATE_NEW || found->state_response_other != STATE_NEW)) {
+      evaluation_list_add(list, ip_in_packet, found);
+   }
+   metrics_stop(packet_metric, start);
 }
 
-void calculate_character_statistic_conv_to_lowercase(char * string, character_statistic_t * stat)
+void evaluation_list_init(evaluation_list_t * list, unsigned int key_size)
 {
-   char used[255];
-   int i;
-   memset(used, 0, 255);
-   stat->count_of_different_letters = 0;
-   stat->count_of_numbers_in_string = 0;
-   stat->length = 0;
-   while (*string != 0) {
-      used[(unsigned char)(*string)]++;
-      if (*string>='0' && *string<='9') {
-         stat->count_of_numbers_in_string++;
-      }
-      //convert to lover case
-      *string = tolower(*string);
-      string++;
-      stat->length++;
+   list->keys = NULL;
+   list->count = 0;
+   list->size = 0;
+   list->key_size = key_size;
+}
+
+void evaluation_list_add(evaluation_list_t * list, void * key, ip_address_t * item)
+{
+   if (list->count == list->size) {
+      unsigned int size = list->size == 0 ? 1024 : list->size * 2;
+      unsigned char * keys = (unsigned char*)realloc(list->keys, (size_t)size * list->key_size);
+      if (keys == NULL) {
+         fprintf(stderr, "Error: realloc failed.\n");
+         return;
+      }
+      list->keys = keys;
+      list->size = size;
+   }
+   memcpy(list->keys + (size_t)list->count * list->key_size, key, list->key_size);
+   list->count++;
+   item->in_evaluation = 1;
+}
+
+//marks characters of the string in the bitmask of used characters
+static inline void mark_used_characters(uint64_t * used, const unsigned char * str, size_t from, size_t to)
+{
+   for (; from < to; from++) {
+      used[str[from] >> 6] |= (uint64_t)1 << (str[from] & 63);
    }
+}
+
+void calculate_character_statistic_conv_to_lowercase(char * string, character_statistic_t * stat)
+{
+   unsigned char * str = (unsigned char *)string;
+   uint64_t used[4] = {0, 0, 0, 0};
+   size_t length = strlen(string);
+   size_t i = 0;
+   unsigned int numbers = 0;
+   //characters are marked as used before the conversion, so the upper case letters are different from the lower case ones
+#ifdef __AVX2__
+   {
+      const __m256i before_a = _mm256_set1_epi8('A' - 1), after_z = _mm256_set1_epi8('Z' + 1);
+      const __m256i before_0 = _mm256_set1_epi8('0' - 1), after_9 = _mm256_set1_epi8('9' + 1);
+      const __m256i to_lower = _mm256_set1_epi8('a' - 'A');
+      for (; i + 32 <= length; i += 32) {
+         __m256i x = _mm256_loadu_si256((const __m256i *)(str + i));
+         __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(x, before_a), _mm256_cmpgt_epi8(after_z, x));
+         __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(x, before_0), _mm256_cmpgt_epi8(after_9, x));
+         mark_used_characters(used, str, i, i + 32);
+         numbers += __builtin_popcount((unsigned int)_mm256_movemask_epi8(digit));
+         _mm256_storeu_si256((__m256i *)(str + i), _mm256_add_epi8(x, _mm256_and_si256(upper, to_lower)));
+      }
+   }
+#endif /*__AVX2__*/
+#ifdef __SSE2__
+   {
+      const __m128i before_a = _mm_set1_epi8('A' - 1), after_z = _mm_set1_epi8('Z' + 1);
+      const __m128i before_0 = _mm_set1_epi8('0' - 1), after_9 = _mm_set1_epi8('9' + 1);
+      const __m128i to_lower = _mm_set1_epi8('a' - 'A');
+      for (; i + 16 <= length; i += 16) {
+         __m128i x = _mm_loadu_si128((const __m128i *)(str + i));
+         __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(x, before_a), _mm_cmplt_epi8(x, after_z));
+         __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(x, before_0), _mm_cmplt_epi8(x, after_9));
+         mark_used_characters(used, str, i, i + 16);
+         numbers += __builtin_popcount((unsigned int)_mm_movemask_epi8(digit));
+         _mm_storeu_si128((__m128i *)(str + i), _mm_add_epi8(x, _mm_and_si128(upper, to_lower)));
+      }
+   }
+#endif /*__SSE2__*/
+   //rest of the string (or whole string without SIMD)
+   mark_used_characters(used, str, i, length);
+   for (; i < length; i++) {
+      if (str[i] >= '0' && str[i] <= '9') {
+         numbers++;
+      }
+      else if (str[i] >= 'A' && str[i] <= 'Z') {
+         str[i] += 'a' - 'A';
+      }
+   }
+   stat->length = length;
+   stat->count_of_numbers_in_string = numbers;
    //count used letters
-   for (i=0; i<255; i++) {
-      if (used[i]!=0) {
-         stat->count_of_different_letters++;
-      }
-   }
+   stat->count_of_different_letters = __builtin_popcountll(used[0]) + __builtin_popcountll(used[1]) +
+                                      __builtin_popcountll(used[2]) + __builtin_popcountll(used[3]);
 }
 
 void calculate_statistic(ip_address_t * ip_rec, calulated_result_t * result)
@@ -528,7 +643,7 @@ void check_and_delete_suspision(ip_address_t * item_to_delete, unsigned char par
    if (part & REQUEST_PART_TUNNEL) {
       if (item_to_delete->suspision_request_tunnel != NULL) {
          if (item_to_delete->suspision_request_tunnel->tunnel_suspision != NULL) {
-            prefix_tree_destroy(item_to_delete->suspision_request_tunnel->tunnel_suspision);
+            suspicion_store_destroy(item_to_delete->suspision_request_tunnel->tunnel_suspision);
          }
          free(item_to_delete->suspision_request_tunnel);
          item_to_delete->suspision_request_tunnel = NULL;
@@ -537,7 +652,7 @@ void check_and_delete_suspision(ip_address_t * item_to_delete, unsigned char par
    if (part & REQUEST_PART_OTHER) {
       if (item_to_delete->suspision_request_other != NULL) {
          if (item_to_delete->suspision_request_other->other_suspision != NULL) {
-            prefix_tree_destroy(item_to_delete->suspision_request_other->other_suspision);
+            suspicion_store_destroy(item_to_delete->suspision_request_other->other_suspision);
          }
          free(item_to_delete->suspision_request_other);
          item_to_delete->suspision_request_other = NULL;
@@ -547,7 +662,7 @@ void check_and_delete_suspision(ip_address_t * item_to_delete, unsigned char par
    if (part & RESPONSE_PART_OTHER) {
       if (item_to_delete->suspision_response_other != NULL) {
          if (item_to_delete->suspision_response_other->other_suspision != NULL) {
-            prefix_tree_destroy(item_to_delete->suspision_response_other->other_suspision);
+            suspicion_store_destroy(item_to_delete->suspision_response_other->other_suspision);
          }
          free(item_to_delete->suspision_response_other);
          item_to_delete->suspision_response_other = NULL;
@@ -557,19 +672,19 @@ void check_and_delete_suspision(ip_address_t * item_to_delete, unsigned char par
    if (part & RESPONSE_PART_TUNNEL) {
       if (item_to_delete->suspision_response_tunnel != NULL) {
          if (item_to_delete->suspision_response_tunnel->request_suspision != NULL) {
-            prefix_tree_destroy(item_to_delete->suspision_response_tunnel->request_suspision);
+            suspicion_store_destroy(item_to_delete->suspision_response_tunnel->request_suspision);
          }
          if (item_to_delete->suspision_response_tunnel->cname_suspision != NULL) {
-            prefix_tree_destroy(item_to_delete->suspision_response_tunnel->cname_suspision);
+            suspicion_store_destroy(item_to_delete->suspision_response_tunnel->cname_suspision);
          }
          if (item_to_delete->suspision_response_tunnel->txt_suspision != NULL) {
-            prefix_tree_destroy(item_to_delete->suspision_response_tunnel->txt_suspision);
+            suspicion_store_destroy(item_to_delete->suspision_response_tunnel->txt_suspision);
          }
          if (item_to_delete->suspision_response_tunnel->ns_suspision != NULL) {
-            prefix_tree_destroy(item_to_delete->suspision_response_tunnel->ns_suspision);
+            suspicion_store_destroy(item_to_delete->suspision_response_tunnel->ns_suspision);
          }
          if (item_to_delete->suspision_response_tunnel->mx_suspision != NULL) {
-            prefix_tree_destroy(item_to_delete->suspision_response_tunnel->mx_suspision);
+            suspicion_store_destroy(item_to_delete->suspision_response_tunnel->mx_suspision);
          }
          free(item_to_delete->suspision_response_tunnel);
          item_to_delete->suspision_response_tunnel = NULL;
@@ -599,8 +714,8 @@ int is_traffic_on_ip_ok_request_other(ip_address_t * item, calulated_result_t *
          }
          //if it is first other suspision
          if (item->suspision_request_other->other_suspision == NULL) {
-            time(&(item->suspision_request_other->time_first));
-            item->suspision_request_other->other_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+            item->suspision_request_other->time_first = current_time;
+            item->suspision_request_other->other_suspision = suspicion_store_initialize(values.suspicion_sketch);
          }
          max = 0;
          for (i = max; i < HISTOGRAM_SIZE_REQUESTS ; i++) {
@@ -643,8 +758,8 @@ int is_traffic_on_ip_ok_request_tunnel(ip_address_t * item, calulated_result_t *
          }
          //if it is first other suspision
          if (item->suspision_request_tunnel->tunnel_suspision == NULL) {
-            time(&(item->suspision_request_tunnel->time_first));
-            item->suspision_request_tunnel->tunnel_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+            item->suspision_request_tunnel->time_first = current_time;
+            item->suspision_request_tunnel->tunnel_suspision = suspicion_store_initialize(values.suspicion_sketch);
          }
          max = 0;
          for (i = max; i < HISTOGRAM_SIZE_REQUESTS ; i++) {
@@ -680,8 +795,8 @@ int is_traffic_on_ip_ok_response_other(ip_address_t * item, calulated_result_t *
          }
          //if it is first other suspision
          if (item->suspision_response_other->other_suspision == NULL) {
-            time(&(item->suspision_response_other->time_first));
-            item->suspision_response_other->other_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+            item->suspision_response_other->time_first = current_time;
+            item->suspision_response_other->other_suspision = suspicion_store_initialize(values.suspicion_sketch);
          }
          max = 0;
          for (i = max; i < HISTOGRAM_SIZE_RESPONSE ; i++) {
@@ -707,7 +822,7 @@ int is_traffic_on_ip_ok_response_other(ip_address_t * item, calulated_result_t *
 
 int is_payload_on_ip_ok_request_other(ip_address_t * item)
 {
-   prefix_tree_t *tree;
+   suspicion_store_t *tree;
       //other anomaly detection request
       if (item->suspision_request_other != NULL && item->suspision_request_other->other_suspision != NULL) {
         if (item->state_request_other == STATE_ATTACK) {
@@ -773,7 +888,7 @@ int is_payload_on_ip_ok_request_other(ip_address_t * item)
 
 int is_payload_on_ip_ok_response_other(ip_address_t * item)
 {
-   prefix_tree_t *tree;
+   suspicion_store_t *tree;
    //other anomaly detection response
    if (item->suspision_response_other != NULL && item->suspision_response_other->other_suspision != NULL ) {
       if (item->state_response_other == STATE_ATTACK) {
@@ -849,7 +964,7 @@ int is_payload_on_ip_ok_response_other(ip_address_t * item)
 
 int is_payload_on_ip_ok_request_tunnel(ip_address_t * item)
 {
-   prefix_tree_t *tree;
+   suspicion_store_t *tree;
    //tunnel detection request
    if (item->suspision_request_tunnel != NULL && item->suspision_request_tunnel->tunnel_suspision != NULL) {
        if ((item->state_request_tunnel == STATE_ATTACK) ) {
@@ -874,7 +989,7 @@ int is_payload_on_ip_ok_request_tunnel(ip_address_t * item)
                   printf("NOT PROVED REQUEST TUNNEL\n");
                   printf("Count of inserting: %d\n", tree->count_of_inserting);
                   printf("Percent of domain searched just once: %f\n", (double)(tree->count_of_domain_searched_just_ones) / (double)(tree->count_of_inserting_for_just_ones));
-                  printf("Max percent of subdomains: %f\n", prefix_tree_most_used_domain_percent_of_subdomains(tree, DEPTH_TUNNEL_SUSPICTION));
+                  printf("Max percent of subdomains: %f\n", suspicion_store_most_used_domain_percent_of_subdomains(tree, DEPTH_TUNNEL_SUSPICTION));
                #endif /*DEBUG*/
                if (item->suspision_request_tunnel->round_in_suspicion > values.max_count_of_round_in_suspiction) {
                  check_and_delete_suspision(item, REQUEST_PART_TUNNEL);
@@ -894,7 +1009,7 @@ int is_payload_on_ip_ok_request_tunnel(ip_address_t * item)
              (double)(tree->count_of_domain_searched_just_ones) / (double)(tree->count_of_inserting_for_just_ones) > values.max_percent_of_domain_searching_just_once &&      //percent of searching unique domains
              (double)(tree->count_of_different_domains) / (double)(tree->count_of_inserting_for_just_ones) > values.max_percent_of_unique_domains   //percent of unique domains
              )&&
-             (prefix_tree_most_used_domain_percent_of_subdomains(tree, DEPTH_TUNNEL_SUSPICTION) > values.max_percent_of_subdomains_in_main_domain)
+             (suspicion_store_most_used_domain_percent_of_subdomains(tree, DEPTH_TUNNEL_SUSPICTION) > values.max_percent_of_subdomains_in_main_domain)
              )) {  //percent of unique search
              item->state_request_tunnel = STATE_ATTACK;
              item->suspision_request_tunnel->event_id = get_event_id();
@@ -912,10 +1027,7 @@ int is_payload_on_ip_ok_request_tunnel(ip_address_t * item)
               )) {
             char buff[1000];
             buff[999] = '\0';
-            prefix_tree_domain_t *dom = item->suspision_request_tunnel->tunnel_suspision->domain_extension->list_of_most_unused_domains;
-            if (dom != NULL) {
-               prefix_tree_read_string(item->suspision_request_tunnel->tunnel_suspision, dom, buff);
-            }
+            suspicion_store_read_domain(tree, SUSPICION_MOST_UNUSED, 0, buff, NULL);
             if (strlen(buff) > values.request_max_count_of_used_letters_closer) {
                item->state_request_tunnel = STATE_ATTACK;
                item->suspision_request_tunnel->event_id = get_event_id();
@@ -931,11 +1043,8 @@ int is_payload_on_ip_ok_request_tunnel(ip_address_t * item)
               #ifdef DEBUG
                  printf("NOT PRUVED ANOMALY\n");
                  char buff[1000];
-              prefix_tree_domain_t *dom = item->suspision_request_tunnel->tunnel_suspision->domain_extension->list_of_most_unused_domains;
-               if (dom != NULL) {
-                  prefix_tree_read_string(item->suspision_request_tunnel->tunnel_suspision, dom, buff);
-               }
-                 printf("domain %s\tcount %d,  \t max_percent_of_domain_searching_just_once: %f, \t max_percent_of_unique_domains: %f, \t max_percent_of_subdomains_in_main_domain: %f\n", buff,tree->count_of_inserting, (double)(tree->count_of_domain_searched_just_ones) / (double)(tree->count_of_inserting_for_just_ones), (double)(tree->count_of_different_domains) / (double)(tree->count_of_inserting_for_just_ones), (prefix_tree_most_used_domain_percent_of_subdomains(tree, DEPTH_TUNNEL_SUSPICTION)));
+                 suspicion_store_read_domain(tree, SUSPICION_MOST_UNUSED, 0, buff, NULL);
+                 printf("domain %s\tcount %d,  \t max_percent_of_domain_searching_just_once: %f, \t max_percent_of_unique_domains: %f, \t max_percent_of_subdomains_in_main_domain: %f\n", buff,tree->count_of_inserting, (double)(tree->count_of_domain_searched_just_ones) / (double)(tree->count_of_inserting_for_just_ones), (double)(tree->count_of_different_domains) / (double)(tree->count_of_inserting_for_just_ones), (suspicion_store_most_used_domain_percent_of_subdomains(tree, DEPTH_TUNNEL_SUSPICTION)));
              #endif /*DEBUG*/
               item->suspision_request_tunnel->round_in_suspicion++;
               //maximum round in suspicion
@@ -954,7 +1063,7 @@ int is_payload_on_ip_ok_request_tunnel(ip_address_t * item)
 
 int is_payload_on_ip_ok_response_tunnel(ip_address_t * item)
 {
-   prefix_tree_t *tree;
+   suspicion_store_t *tree;
    //tunnel detection response
    if (item->state_response_tunnel != STATE_NEW) {
       tree = item->suspision_response_tunnel->request_suspision;
@@ -973,7 +1082,7 @@ int is_payload_on_ip_ok_response_tunnel(ip_address_t * item)
       }
       else if (item->suspision_response_tunnel->state_type & REQUEST_STRING_TUNNEL) {
          item->suspision_response_tunnel->state_type &= ~REQUEST_STRING_TUNNEL;
-         prefix_tree_destroy(tree);
+         suspicion_store_destroy(tree);
          item->suspision_response_tunnel->request_suspision = NULL;
       }
       tree = item->suspision_response_tunnel->txt_suspision;
@@ -993,7 +1102,7 @@ int is_payload_on_ip_ok_response_tunnel(ip_address_t * item)
       }
       else if (tree != NULL && item->suspision_response_tunnel->state_type & TXT_TUNNEL) {
          item->suspision_response_tunnel->state_type &= ~TXT_TUNNEL;
-         prefix_tree_destroy(tree);
+         suspicion_store_destroy(tree);
          item->suspision_response_tunnel->txt_suspision = NULL;
       }
       tree = item->suspision_response_tunnel->mx_suspision;
@@ -1013,7 +1122,7 @@ int is_payload_on_ip_ok_response_tunnel(ip_address_t * item)
       }
       else if (tree != NULL && item->suspision_response_tunnel->state_type & MX_TUNNEL) {
          item->suspision_response_tunnel->state_type &= ~MX_TUNNEL;
-         prefix_tree_destroy(tree);
+         suspicion_store_destroy(tree);
          item->suspision_response_tunnel->mx_suspision = NULL;
 
       }
@@ -1034,7 +1143,7 @@ int is_payload_on_ip_ok_response_tunnel(ip_address_t * item)
       }
       else if (tree != NULL && item->suspision_response_tunnel->state_type & CNAME_TUNNEL) {
          item->suspision_response_tunnel->state_type &= ~CNAME_TUNNEL;
-         prefix_tree_destroy(tree);
+         suspicion_store_destroy(tree);
          item->suspision_response_tunnel->cname_suspision = NULL;
       }
       tree = item->suspision_response_tunnel->ns_suspision;
@@ -1054,7 +1163,7 @@ int is_payload_on_ip_ok_response_tunnel(ip_address_t * item)
       }
       else if (tree != NULL && item->suspision_response_tunnel->state_type & NS_TUNNEL) {
          item->suspision_response_tunnel->state_type &= ~NS_TUNNEL;
-         prefix_tree_destroy(tree);
+         suspicion_store_destroy(tree);
          item->suspision_response_tunnel->ns_suspision = NULL;
       }
       //if there wasnt any payload problem
@@ -1120,23 +1229,35 @@ void send_unirec_out_sdm(unirec_tunnel_notification_t * notification)
    }
 }
 
-void calculate_statistic_and_choose_anomaly(bpt_t * b_plus_tree, FILE *file, unirec_tunnel_notification_t * ur_notification)
+void calculate_statistic_and_choose_anomaly(ip_table_t * table, evaluation_list_t * list, async_log_t *log, unirec_tunnel_notification_t * ur_notification)
 {
    ip_address_t * item;
+   char report[ANOMALY_REPORT_MAX_SIZE];
+   size_t report_size;
    ip_addr_t ip_address;
-   char ip_address_str [100];
-   bpt_list_item_t * b_item;
-   int is_there_next = 0, print_time = 1;
+   #ifdef DEBUG
+      char ip_address_str [100];
+   #endif /*DEBUG*/
+   unsigned char * key;
+   unsigned int i, index, count_of_kept = 0;
+   int print_time = 1;
    calulated_result_t result;
-   b_item = bpt_list_init(b_plus_tree);
-   is_there_next = bpt_list_start(b_plus_tree, b_item);
-
-   while (is_there_next == 1) {
-      item = (ip_address_t*)b_item->value;
+   uint64_t start = metrics_start();
+   //IPs tracked by this thread, the gauges are summed over the workers
+   metrics_gauge_set(list->key_size == sizeof(uint32_t) ? tracked_ipv4_metric : tracked_ipv6_metric,
+                     table->count);
+   //IPs with anomaly stay in the evaluation, all the others are deleted after it
+   for (i = 0; i < list->count; i++) {
+      key = list->keys + (size_t)i * list->key_size;
+      item = (ip_address_t*)ip_table_search(table, key);
+      if (item == NULL) {
+         continue;
+      }
+      item->in_evaluation = 0;
       calculate_statistic(item, &result);
       #ifdef DEBUG
          if (item->state_request_other == STATE_ATTACK || item->state_request_tunnel == STATE_ATTACK || item->state_response_tunnel == STATE_ATTACK || item->state_response_other == STATE_ATTACK) {
-            get_ip_str_from_ip_struct(item, b_item->key, ip_address_str);
+            get_ip_str_from_ip_struct(item, key, ip_address_str);
             printf("IP: %s\n", ip_address_str);
          }
       #endif /*DEBUG*/
@@ -1166,34 +1287,52 @@ void calculate_statistic_and_choose_anomaly(bpt_t * b_plus_tree, FILE *file, uni
       }
       //send alerts of anomalies in ATTACK STATE
       if (item->state_request_other == STATE_ATTACK || item->state_request_tunnel == STATE_ATTACK || item->state_response_tunnel == STATE_ATTACK || item->state_response_other == STATE_ATTACK) {
-         ip_address = get_ip_addr_t_from_ip_struct(item, b_item->key);
-         //print new anomaly
-         if (item->print & 0b11111111 && file != NULL) {
-            //translate ip int to str
-            ip_to_str(&(ip_address) ,ip_address_str);
-            print_founded_anomaly_immediately(ip_address_str, item, file, print_time);
+         ip_address = get_ip_addr_t_from_ip_struct(item, key);
+         //new anomaly is copied to a binary report, the log writer thread formats it to the file
+         if (item->print & 0b11111111 && log != NULL) {
+            report_size = build_anomaly_report(&ip_address, item, print_time, report, sizeof(report));
+            if (report_size > 0) {
+               async_log_write(log, ANOMALY_REPORT_RECORD, report, report_size);
+            }
             print_time = 0;
             item->print=0;
-            fflush(file);
          }
+         //workers share the output interfaces
+         pthread_mutex_lock(&alert_lock);
          send_unirec_alert_and_reset_records(&ip_address, item, ur_notification);
-      }
-      if (item->sdm_exported == SDM_EXPORTED_FALSE) {
+         if (item->sdm_exported == SDM_EXPORTED_FALSE) {
             send_unirec_alert_to_sdm(&ip_address, item, ur_notification);
+         }
+         pthread_mutex_unlock(&alert_lock);
       }
-      //check if it can be deleted
-      if (item->state_request_other == STATE_NEW && item->state_request_tunnel == STATE_NEW && item->state_response_other == STATE_NEW && item->state_response_tunnel == STATE_NEW) {
-         is_there_next = bpt_list_item_del(b_plus_tree, b_item);
-      #ifdef TIME
-         delete_from_blus++;
-      #endif /*TIME*/
+      //with anomaly, in can not be deleted
+      if (item->state_request_other != STATE_NEW || item->state_request_tunnel != STATE_NEW || item->state_response_other != STATE_NEW || item->state_response_tunnel != STATE_NEW) {
+         //it will be evaluated in next round too
+         item->in_evaluation = 1;
+         memmove(list->keys + (size_t)count_of_kept * list->key_size, key, list->key_size);
+         count_of_kept++;
       }
-      else {
-         //with anomaly, in can not be deleted
-         is_there_next = bpt_list_item_next(b_plus_tree, b_item);
+   }
+   #ifdef TIME
+      delete_from_blus += table->count - count_of_kept;
+   #endif /*TIME*/
+   list->count = count_of_kept;
+   //the table is not modified during the evaluation, so the items are deleted only now
+   for (index = ip_table_first(table); index < table->size; index = ip_table_next(table, index)) {
+      if (!((ip_address_t*)ip_table_value(table, index))->in_evaluation) {
+         ip_table_delete(table, index);
       }
    }
-   bpt_list_clean(b_item);
+   metrics_stop(evaluation_metric, start);
+}
+
+void clean_ip_table(ip_table_t * table)
+{
+   uint32_t index;
+   for (index = ip_table_first(table); index < table->size; index = ip_table_next(table, index)) {
+      check_and_delete_suspision((ip_address_t*)ip_table_value(table, index), REQUEST_AND_RESPONSE_PART);
+   }
+   ip_table_destroy(table);
 }
 
 void send_unirec_alert_to_sdm(ip_addr_t * ip_address, ip_address_t *item, unirec_tunnel_notification_t * unirec_out)
@@ -1212,7 +1351,6 @@ void send_unirec_alert_to_sdm(ip_addr_t * ip_address, ip_address_t *item, unirec
 
 
 void send_unirec_alert_and_reset_records(ip_addr_t * ip_address, ip_address_t *item, unirec_tunnel_notification_t * unirec_out) {
-   prefix_tree_domain_t * dom;
    if (unirec_out == NULL) {
       return;
    }
@@ -1222,21 +1360,15 @@ void send_unirec_alert_and_reset_records(ip_addr_t * ip_address, ip_address_t *i
    if (item->suspision_request_tunnel && item->state_request_tunnel == STATE_ATTACK && item->suspision_request_tunnel->round_in_suspicion == 0) {
       unirec_out->event_id = item->suspision_request_tunnel->event_id;
       unirec_out->tunnel_per_new_domain = (double)(item->suspision_request_tunnel->tunnel_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_request_tunnel->tunnel_suspision->count_of_inserting_for_just_ones);
-      unirec_out->tunnel_per_subdomain =  prefix_tree_most_used_domain_percent_of_subdomains(item->suspision_request_tunnel->tunnel_suspision, DEPTH_TUNNEL_SUSPICTION);
+      unirec_out->tunnel_per_subdomain =  suspicion_store_most_used_domain_percent_of_subdomains(item->suspision_request_tunnel->tunnel_suspision, DEPTH_TUNNEL_SUSPICTION);
       unirec_out->tunnel_cnt_packet = item->suspision_request_tunnel->sum_of_inserting;
-      dom = item->suspision_request_tunnel->tunnel_suspision->domain_extension->list_of_most_unused_domains;
-      if (dom != NULL) {
-         prefix_tree_read_string(item->suspision_request_tunnel->tunnel_suspision, dom, unirec_out->tunnel_domain);
-      }
-      else {
-         unirec_out->tunnel_domain[0] = 0;
-      }
+      suspicion_store_read_domain(item->suspision_request_tunnel->tunnel_suspision, SUSPICION_MOST_UNUSED, 0, unirec_out->tunnel_domain, NULL);
       unirec_out->tunnel_type = TUN_T_REQUEST_TUNNEL;
       unirec_out->time_first = item->suspision_request_tunnel->time_first;
       unirec_out->time_last = item->time_last;
       send_unirec_out(unirec_out);
-      prefix_tree_destroy(item->suspision_request_tunnel->tunnel_suspision);
-      item->suspision_request_tunnel->tunnel_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+      suspicion_store_destroy(item->suspision_request_tunnel->tunnel_suspision);
+      item->suspision_request_tunnel->tunnel_suspision = suspicion_store_initialize(values.suspicion_sketch);
    }
    //Request other anomaly
    if (item->suspision_request_other && item->state_request_other == STATE_ATTACK && item->suspision_request_other->round_in_suspicion == 0) {
@@ -1244,21 +1376,15 @@ void send_unirec_alert_and_reset_records(ip_addr_t * ip_address, ip_address_t *i
       unirec_out->tunnel_per_new_domain = (double)(item->suspision_request_other->other_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_request_other->other_suspision->count_of_inserting_for_just_ones);
       unirec_out->tunnel_per_subdomain =  (double)item->suspision_request_other->other_suspision->count_of_different_domains/(double)(item->suspision_request_other->other_suspision->count_of_inserting_for_just_ones);
       unirec_out->tunnel_cnt_packet = item->suspision_request_other->sum_of_inserting;
-      dom = item->suspision_request_other->other_suspision->domain_extension->list_of_most_used_domains;
-      if (dom != NULL) {
-         prefix_tree_read_string(item->suspision_request_other->other_suspision, dom, unirec_out->tunnel_domain);
-      }
-      else {
-         unirec_out->tunnel_domain[0] = 0;
-      }
+      suspicion_store_read_domain(item->suspision_request_other->other_suspision, SUSPICION_MOST_USED, 0, unirec_out->tunnel_domain, NULL);
       unirec_out->tunnel_type = TUN_T_REQUEST_OTHER;
       unirec_out->time_first = item->suspision_request_other->time_first;
       unirec_out->time_last = item->time_last;
       send_unirec_out(unirec_out);
       //reset
       item->counter_request.request_without_string = 0;
-      prefix_tree_destroy(item->suspision_request_other->other_suspision);
-      item->suspision_request_other->other_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+      suspicion_store_destroy(item->suspision_request_other->other_suspision);
+      item->suspision_request_other->other_suspision = suspicion_store_initialize(values.suspicion_sketch);
    }
    //response tunnel
    if (item->suspision_response_tunnel && item->state_response_tunnel == STATE_ATTACK && item->suspision_response_tunnel->round_in_suspicion == 0) {
@@ -1268,19 +1394,13 @@ void send_unirec_alert_and_reset_records(ip_addr_t * ip_address, ip_address_t *i
          unirec_out->tunnel_per_new_domain = (double)(item->suspision_response_tunnel->request_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_response_tunnel->request_suspision->count_of_inserting_for_just_ones);
          unirec_out->tunnel_per_subdomain =  (double)item->suspision_response_tunnel->request_suspision->count_of_different_domains/(double)(item->suspision_response_tunnel->request_suspision->count_of_inserting_for_just_ones);
          unirec_out->tunnel_cnt_packet = item->suspision_response_tunnel->sum_of_inserting_request;
-         dom = item->suspision_response_tunnel->request_suspision->domain_extension->list_of_most_unused_domains;
-         if (dom != NULL) {
-            prefix_tree_read_string(item->suspision_response_tunnel->request_suspision, dom, unirec_out->tunnel_domain);
-         }
-         else {
-            unirec_out->tunnel_domain[0] = 0;
-         }
+         suspicion_store_read_domain(item->suspision_response_tunnel->request_suspision, SUSPICION_MOST_UNUSED, 0, unirec_out->tunnel_domain, NULL);
          unirec_out->tunnel_type = TUN_T_RESPONSE_TUNNEL_REQ;
          unirec_out->time_first = item->suspision_response_tunnel->request_suspision_time_first;
          unirec_out->time_last = item->time_last;
          send_unirec_out(unirec_out);
-         prefix_tree_destroy(item->suspision_response_tunnel->request_suspision);
-         item->suspision_response_tunnel->request_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+         suspicion_store_destroy(item->suspision_response_tunnel->request_suspision);
+         item->suspision_response_tunnel->request_suspision = suspicion_store_initialize(values.suspicion_sketch);
       }
       //txt
       if (item->suspision_response_tunnel->state_type & TXT_TUNNEL) {
@@ -1288,76 +1408,52 @@ void send_unirec_alert_and_reset_records(ip_addr_t * ip_address, ip_address_t *i
          unirec_out->tunnel_per_new_domain = (double)(item->suspision_response_tunnel->txt_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_response_tunnel->txt_suspision->count_of_inserting_for_just_ones);
          unirec_out->tunnel_per_subdomain =  (double)item->suspision_response_tunnel->txt_suspision->count_of_different_domains/(double)(item->suspision_response_tunnel->txt_suspision->count_of_inserting_for_just_ones);
          unirec_out->tunnel_cnt_packet = item->suspision_response_tunnel->sum_of_inserting_txt;
-         dom =item->suspision_response_tunnel->txt_suspision->domain_extension->list_of_most_unused_domains;
-         if (dom != NULL) {
-            prefix_tree_read_string(item->suspision_response_tunnel->txt_suspision, dom, unirec_out->tunnel_domain);
-         }
-         else {
-            unirec_out->tunnel_domain[0] = 0;
-         }
+         suspicion_store_read_domain(item->suspision_response_tunnel->txt_suspision, SUSPICION_MOST_UNUSED, 0, unirec_out->tunnel_domain, NULL);
          unirec_out->tunnel_type = TUN_T_RESPONSE_TUNNEL_TXT;
          unirec_out->time_first = item->suspision_response_tunnel->txt_suspision_time_first;
          unirec_out->time_last = item->time_last;
          send_unirec_out(unirec_out);
-         prefix_tree_destroy(item->suspision_response_tunnel->txt_suspision);
-         item->suspision_response_tunnel->txt_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+         suspicion_store_destroy(item->suspision_response_tunnel->txt_suspision);
+         item->suspision_response_tunnel->txt_suspision = suspicion_store_initialize(values.suspicion_sketch);
       }
       if (item->suspision_response_tunnel->state_type & CNAME_TUNNEL) {
          unirec_out->event_id = item->suspision_response_tunnel->event_id_cname;
          unirec_out->tunnel_per_new_domain = (double)(item->suspision_response_tunnel->cname_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_response_tunnel->cname_suspision->count_of_inserting_for_just_ones);
          unirec_out->tunnel_per_subdomain =  (double)item->suspision_response_tunnel->cname_suspision->count_of_different_domains/(double)(item->suspision_response_tunnel->cname_suspision->count_of_inserting_for_just_ones);
          unirec_out->tunnel_cnt_packet = item->suspision_response_tunnel->sum_of_inserting_cname;
-         dom =item->suspision_response_tunnel->cname_suspision->domain_extension->list_of_most_unused_domains;
-         if (dom != NULL) {
-            prefix_tree_read_string(item->suspision_response_tunnel->cname_suspision, dom, unirec_out->tunnel_domain);
-         }
-         else {
-            unirec_out->tunnel_domain[0] = 0;
-         }
+         suspicion_store_read_domain(item->suspision_response_tunnel->cname_suspision, SUSPICION_MOST_UNUSED, 0, unirec_out->tunnel_domain, NULL);
          unirec_out->tunnel_type = TUN_T_RESPONSE_TUNNEL_CNAME;
          unirec_out->time_first = item->suspision_response_tunnel->cname_suspision_time_first;
          unirec_out->time_last = item->time_last;
          send_unirec_out(unirec_out);
-         prefix_tree_destroy(item->suspision_response_tunnel->cname_suspision);
-         item->suspision_response_tunnel->cname_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+         suspicion_store_destroy(item->suspision_response_tunnel->cname_suspision);
+         item->suspision_response_tunnel->cname_suspision = suspicion_store_initialize(values.suspicion_sketch);
       }
       if (item->suspision_response_tunnel->state_type & NS_TUNNEL) {
          unirec_out->event_id = item->suspision_response_tunnel->event_id_ns;
          unirec_out->tunnel_per_new_domain = (double)(item->suspision_response_tunnel->ns_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_response_tunnel->ns_suspision->count_of_inserting_for_just_ones);
          unirec_out->tunnel_per_subdomain =  (double)item->suspision_response_tunnel->ns_suspision->count_of_different_domains/(double)(item->suspision_response_tunnel->ns_suspision->count_of_inserting_for_just_ones);
          unirec_out->tunnel_cnt_packet = item->suspision_response_tunnel->sum_of_inserting_ns;
-         dom =item->suspision_response_tunnel->ns_suspision->domain_extension->list_of_most_unused_domains;
-         if (dom != NULL) {
-            prefix_tree_read_string(item->suspision_response_tunnel->ns_suspision, dom, unirec_out->tunnel_domain);
-         }
-         else {
-            unirec_out->tunnel_domain[0] = 0;
-         }
+         suspicion_store_read_domain(item->suspision_response_tunnel->ns_suspision, SUSPICION_MOST_UNUSED, 0, unirec_out->tunnel_domain, NULL);
          unirec_out->tunnel_type = TUN_T_RESPONSE_TUNNEL_NS;
          unirec_out->time_first = item->suspision_response_tunnel->ns_suspision_time_first;
          unirec_out->time_last = item->time_last;
          send_unirec_out(unirec_out);
-         prefix_tree_destroy(item->suspision_response_tunnel->ns_suspision);
-         item->suspision_response_tunnel->ns_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+         suspicion_store_destroy(item->suspision_response_tunnel->ns_suspision);
+         item->suspision_response_tunnel->ns_suspision = suspicion_store_initialize(values.suspicion_sketch);
       }
       if (item->suspision_response_tunnel->state_type & MX_TUNNEL) {
          unirec_out->event_id = item->suspision_response_tunnel->event_id_mx;
          unirec_out->tunnel_per_new_domain = (double)(item->suspision_response_tunnel->mx_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_response_tunnel->mx_suspision->count_of_inserting_for_just_ones);
          unirec_out->tunnel_per_subdomain =  (double)item->suspision_response_tunnel->mx_suspision->count_of_different_domains/(double)(item->suspision_response_tunnel->mx_suspision->count_of_inserting_for_just_ones);
          unirec_out->tunnel_cnt_packet = item->suspision_response_tunnel->sum_of_inserting_mx;
-         dom =item->suspision_response_tunnel->mx_suspision->domain_extension->list_of_most_unused_domains;
-         if (dom != NULL) {
-            prefix_tree_read_string(item->suspision_response_tunnel->mx_suspision, dom, unirec_out->tunnel_domain);
-         }
-         else {
-            unirec_out->tunnel_domain[0] = 0;
-         }
+         suspicion_store_read_domain(item->suspision_response_tunnel->mx_suspision, SUSPICION_MOST_UNUSED, 0, unirec_out->tunnel_domain, NULL);
          unirec_out->tunnel_type = TUN_T_RESPONSE_TUNNEL_MX;
          unirec_out->time_first = item->suspision_response_tunnel->mx_suspision_time_first;
          unirec_out->time_last = item->time_last;
          send_unirec_out(unirec_out);
-         prefix_tree_destroy(item->suspision_response_tunnel->mx_suspision);
-         item->suspision_response_tunnel->mx_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+         suspicion_store_destroy(item->suspision_response_tunnel->mx_suspision);
+         item->suspision_response_tunnel->mx_suspision = suspicion_store_initialize(values.suspicion_sketch);
       }
    }
    if (item->suspision_response_other && item->state_response_other == STATE_ATTACK && item->suspision_response_other->round_in_suspicion == 0) {
@@ -1365,158 +1461,229 @@ void send_unirec_alert_and_reset_records(ip_addr_t * ip_address, ip_address_t *i
       unirec_out->tunnel_per_new_domain = 0;
       unirec_out->tunnel_per_subdomain =  0;
       unirec_out->tunnel_cnt_packet = item->suspision_response_other->sum_of_inserting;
-      dom =item->suspision_response_other->other_suspision->domain_extension->list_of_most_used_domains;
-      if (dom != NULL) {
-         prefix_tree_read_string(item->suspision_response_other->other_suspision, dom, unirec_out->tunnel_domain);
-      }
-      else {
-         unirec_out->tunnel_domain[0] = 0;
-      }
+      suspicion_store_read_domain(item->suspision_response_other->other_suspision, SUSPICION_MOST_USED, 0, unirec_out->tunnel_domain, NULL);
       unirec_out->tunnel_type = TUN_T_RESPONSE_OTHER;
       unirec_out->time_first = item->suspision_response_other->time_first;
       unirec_out->time_last = item->time_last;
       send_unirec_out(unirec_out);
-      prefix_tree_destroy(item->suspision_response_other->other_suspision);
-      item->suspision_response_other->other_suspision = prefix_tree_initialize(SUFFIX ,0,'.',DOMAIN_EXTENSION_YES, RELAXATION_AFTER_DELETE_YES);
+      suspicion_store_destroy(item->suspision_response_other->other_suspision);
+      item->suspision_response_other->other_suspision = suspicion_store_initialize(values.suspicion_sketch);
    }
 }
 
-void print_founded_anomaly_immediately(char * ip_address, ip_address_t *item, FILE *file, unsigned char print_time)
+/* Append the top domains of the store to the report, returns their number. */
+static uint8_t report_add_domains(char * buffer, size_t size, size_t * len, suspicion_store_t * store, int list)
 {
-   if (print_time) {
-      time_t mytime;
-      char timebuf[26];
-      mytime = time(NULL);
-      fprintf(file, "\nTIME: %s\n", ctime_r(&mytime, timebuf));
-   }
-   prefix_tree_domain_t *dom;
+   anomaly_report_domain_t domain;
    char str[1024];
-   if (item->print & 0b11111111) {
-      //ip address contaion anomaly
-      fprintf(file, "\n%s\n", ip_address);
-      //print found anomaly tunnel
-      if (item->state_request_tunnel == STATE_ATTACK && item->print & REQUEST_PART_TUNNEL) {
-         fprintf(file, "%u\tRequest tunnel found:\tDomains searched just once: %f.\tcount of different domains: %f.\tPercent of subdomain in most used domain %f.\tAll recorded requests: %d\n", item->suspision_request_tunnel->event_id, (double)(item->suspision_request_tunnel->tunnel_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_request_tunnel->tunnel_suspision->count_of_inserting_for_just_ones), (double)item->suspision_request_tunnel->tunnel_suspision->count_of_different_domains/(double)(item->suspision_request_tunnel->tunnel_suspision->count_of_inserting_for_just_ones), prefix_tree_most_used_domain_percent_of_subdomains(item->suspision_request_tunnel->tunnel_suspision, DEPTH_TUNNEL_SUSPICTION) ,(item->suspision_request_tunnel->tunnel_suspision->count_of_inserting) );
-         dom =item->suspision_request_tunnel->tunnel_suspision->domain_extension->list_of_most_unused_domains;
-         for (int i=0; i<5;i++) {
-            str[0]=0;
-            if (dom==NULL) break;
-            fprintf(file, "\t\t%s. %d\n",  prefix_tree_read_string(item->suspision_request_tunnel->tunnel_suspision ,dom, str), dom->count_of_insert);
-            dom= dom->domain_extension->most_used_domain_less;
-         }
+   int count;
+   uint8_t added = 0;
+   for (int i = 0; i < ANOMALY_REPORT_DOMAINS; i++) {
+      if (!suspicion_store_read_domain(store, list, i, str, &count)) break;
+      domain.count = count;
+      domain.length = strnlen(str, ANOMALY_REPORT_DOMAIN);
+      if (*len + sizeof(domain) + domain.length > size) break;
+      memcpy(buffer + *len, &domain, sizeof(domain));
+      memcpy(buffer + *len + sizeof(domain), str, domain.length);
+      *len += sizeof(domain) + domain.length;
+      added++;
+   }
+   return added;
+}
+
+/* Append the section with the top domains of the store (can be NULL) to the report. */
+static void report_add_section(char * buffer, size_t size, size_t * len, anomaly_report_header_t * header,
+                               anomaly_report_section_t * section, suspicion_store_t * store, int list)
+{
+   size_t pos = *len;
+   if (pos + sizeof(*section) > size) {
+      return;
+   }
+   *len += sizeof(*section);
+   section->domains = store != NULL ? report_add_domains(buffer, size, len, store, list) : 0;
+   memcpy(buffer + pos, section, sizeof(*section));
+   header->sections++;
+}
+
+/* Section of a response tunnel of one record type. */
+static void report_add_response_tunnel(char * buffer, size_t size, size_t * len, anomaly_report_header_t * header,
+                                       uint8_t kind, unsigned int event_id, suspicion_store_t * store)
+{
+   anomaly_report_section_t section;
+   memset(&section, 0, sizeof(section));
+   section.kind = kind;
+   section.event_id = event_id;
+   section.values[0] = (double)(store->count_of_domain_searched_just_ones) / (double)(store->count_of_inserting_for_just_ones);
+   section.values[1] = (double)store->count_of_different_domains / (double)(store->count_of_inserting_for_just_ones);
+   section.count = store->count_of_inserting;
+   report_add_section(buffer, size, len, header, &section, store, SUSPICION_MOST_UNUSED);
+}
+
+size_t build_anomaly_report(ip_addr_t * ip_address, ip_address_t *item, unsigned char print_time, char * buffer, size_t size)
+{
+   anomaly_report_header_t header;
+   anomaly_report_section_t section;
+   size_t len = sizeof(header);
+   if (!(item->print & 0b11111111) || size < sizeof(header)) {
+      return 0;
+   }
+   memset(&header, 0, sizeof(header));
+   header.time = current_time;
+   header.ip = *ip_address;
+   header.print_time = print_time;
+   //request tunnel
+   if (item->state_request_tunnel == STATE_ATTACK && item->print & REQUEST_PART_TUNNEL) {
+      suspicion_store_t * store = item->suspision_request_tunnel->tunnel_suspision;
+      memset(&section, 0, sizeof(section));
+      section.kind = REPORT_REQUEST_TUNNEL;
+      section.event_id = item->suspision_request_tunnel->event_id;
+      section.values[0] = (double)(store->count_of_domain_searched_just_ones) / (double)(store->count_of_inserting_for_just_ones);
+      section.values[1] = (double)store->count_of_different_domains / (double)(store->count_of_inserting_for_just_ones);
+      section.values[2] = suspicion_store_most_used_domain_percent_of_subdomains(store, DEPTH_TUNNEL_SUSPICTION);
+      section.count = store->count_of_inserting;
+      report_add_section(buffer, size, &len, &header, &section, store, SUSPICION_MOST_UNUSED);
+   }
+   //other anomaly in request
+   if (item->state_request_other == STATE_ATTACK && item->print & REQUEST_PART_OTHER) {
+      memset(&section, 0, sizeof(section));
+      section.malformed = item->counter_request.request_without_string;
+      if (item->suspision_request_other != NULL) {
+         suspicion_store_t * store = item->suspision_request_other->other_suspision;
+         section.kind = REPORT_REQUEST_OTHER;
+         section.event_id = item->suspision_request_other->event_id;
+         section.values[0] = (double)(store->count_of_domain_searched_just_ones) / (double)(store->count_of_inserting_for_just_ones);
+         section.values[1] = (double)store->count_of_different_domains / (double)(store->count_of_inserting_for_just_ones);
+         section.count = store->count_of_inserting;
+         for (int i = 0; i < HISTOGRAM_SIZE_REQUESTS; i++) {
+            if (item->suspision_request_other->state_request_size[i] & STATE_ATTACK) {
+               section.sizes |= 1U << i;
+            }
+         }
+         report_add_section(buffer, size, &len, &header, &section, store, SUSPICION_MOST_USED);
       }
-      //print founded anomaly other in request
-      if (item->state_request_other == STATE_ATTACK && item->print & REQUEST_PART_OTHER) {
-         if (item->suspision_request_other != NULL) {
-            fprintf(file, "%u\tRequest traffic anomaly found:\tDomains searched just once: %f.\tCount of different domains: %f.\tAll recorded requests: %d.\tCount of malformed requests: %d.\n\t\tFound in sizes: ", item->suspision_request_other->event_id, (double)(item->suspision_request_other->other_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_request_other->other_suspision->count_of_inserting_for_just_ones), (double)item->suspision_request_other->other_suspision->count_of_different_domains/(double)(item->suspision_request_other->other_suspision->count_of_inserting_for_just_ones),(item->suspision_request_other->other_suspision->count_of_inserting), item->counter_request.request_without_string  );
-            for (int i=0; i<HISTOGRAM_SIZE_REQUESTS; i++) {
-               if (item->suspision_request_other->state_request_size[i] & STATE_ATTACK)
-               fprintf(file, "%d-%d\t", i*10,i*10+10);
-            }
-            fprintf(file, "\n");
-            dom =item->suspision_request_other->other_suspision->domain_extension->list_of_most_used_domains;
-            for (int i=0; i<5;i++) {
-               str[0]=0;
-               if (dom==NULL) break;
-               fprintf(file, "\t\t%s. %d\n",  prefix_tree_read_string(item->suspision_request_other->other_suspision, dom, str), dom->count_of_insert);
-               dom= dom->domain_extension->most_used_domain_less;
-            }
-         }
-         else {
-            fprintf(file, "\tMallformed packets found:\tCount of malformed responses: %u.\n", item->counter_request.request_without_string);
-         }
+      else {
+         section.kind = REPORT_REQUEST_MALFORMED;
+         report_add_section(buffer, size, &len, &header, &section, NULL, 0);
       }
-      //response tunnel
-      if (item->state_response_tunnel == STATE_ATTACK && item->print & RESPONSE_PART_TUNNEL) {
-         if (item->suspision_response_tunnel->state_type & REQUEST_STRING_TUNNEL) {
-            fprintf(file, "%u\tReponse tunnel found by request strings :\tstrings searched just once: %f.\tcount of different strings: %f.\tall requests: %d.\n", item->suspision_response_tunnel->event_id_request, (double)(item->suspision_response_tunnel->request_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_response_tunnel->request_suspision->count_of_inserting_for_just_ones), (double)item->suspision_response_tunnel->request_suspision->count_of_different_domains/(double)(item->suspision_response_tunnel->request_suspision->count_of_inserting_for_just_ones),(item->suspision_response_tunnel->request_suspision->count_of_inserting) );
-            dom =item->suspision_response_tunnel->request_suspision->domain_extension->list_of_most_unused_domains;
-            for (int i=0; i<5;i++) {
-               str[0]=0;
-               if (dom==NULL) break;
-               fprintf(file, "\t\t%s. %d\n",  prefix_tree_read_string(item->suspision_response_tunnel->request_suspision ,dom, str), dom->count_of_insert);
-               dom= dom->domain_extension->most_used_domain_less;
-            }
-         }
-         //txt
-         if (item->suspision_response_tunnel->state_type & TXT_TUNNEL) {
-            fprintf(file, "%u\tReponse TXT tunnel found:\tstrings searched just once: %f.\tcount of different strings: %f.\tall requests: %d.\n", item->suspision_response_tunnel->event_id_request, (double)(item->suspision_response_tunnel->txt_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_response_tunnel->txt_suspision->count_of_inserting_for_just_ones), (double)item->suspision_response_tunnel->txt_suspision->count_of_different_domains/(double)(item->suspision_response_tunnel->txt_suspision->count_of_inserting_for_just_ones),(item->suspision_response_tunnel->txt_suspision->count_of_inserting) );
-            dom =item->suspision_response_tunnel->txt_suspision->domain_extension->list_of_most_unused_domains;
-            for (int i=0; i<5;i++) {
-               str[0]=0;
-               if (dom==NULL) break;
-               fprintf(file, "\t\t%s. %d\n",  prefix_tree_read_string(item->suspision_response_tunnel->txt_suspision ,dom, str), dom->count_of_insert);
-               dom= dom->domain_extension->most_used_domain_less;
-            }
-         }
-         //cname
-         if (item->suspision_response_tunnel->state_type & CNAME_TUNNEL) {
-            fprintf(file, "%u\tReponse CNAME tunnel found:\tstrings searched just once: %f.\tcount of different strings: %f.\tall requests: %d.\n", item->suspision_response_tunnel->event_id_txt, (double)(item->suspision_response_tunnel->cname_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_response_tunnel->cname_suspision->count_of_inserting_for_just_ones), (double)item->suspision_response_tunnel->cname_suspision->count_of_different_domains/(double)(item->suspision_response_tunnel->cname_suspision->count_of_inserting_for_just_ones),(item->suspision_response_tunnel->cname_suspision->count_of_inserting) );
-            dom =item->suspision_response_tunnel->cname_suspision->domain_extension->list_of_most_unused_domains;
-            for (int i=0; i<5;i++) {
-               str[0]=0;
-               if (dom==NULL) break;
-               fprintf(file, "\t\t%s. %d\n",  prefix_tree_read_string(item->suspision_response_tunnel->cname_suspision, dom, str), dom->count_of_insert);
-               dom= dom->domain_extension->most_used_domain_less;
-            }
-         }
-         //ns
-         if (item->suspision_response_tunnel->state_type & NS_TUNNEL) {
-            fprintf(file, "%u\tReponse NS tunnel found:\tstrings searched just once: %f.\tcount of different strings: %f.\tall requests: %d.\n", item->suspision_response_tunnel->event_id_cname, (double)(item->suspision_response_tunnel->ns_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_response_tunnel->ns_suspision->count_of_inserting_for_just_ones), (double)item->suspision_response_tunnel->ns_suspision->count_of_different_domains/(double)(item->suspision_response_tunnel->ns_suspision->count_of_inserting_for_just_ones),(item->suspision_response_tunnel->ns_suspision->count_of_inserting) );
-            dom =item->suspision_response_tunnel->ns_suspision->domain_extension->list_of_most_unused_domains;
-            for (int i=0; i<5;i++) {
-               str[0]=0;
-               if (dom==NULL) break;
-               fprintf(file, "\t\t%s. %d\n",  prefix_tree_read_string(item->suspision_response_tunnel->ns_suspision ,dom, str), dom->count_of_insert);
-               dom= dom->domain_extension->most_used_domain_less;
+   }
+   //response tunnel
+   if (item->state_response_tunnel == STATE_ATTACK && item->print & RESPONSE_PART_TUNNEL) {
+      ip_address_suspision_response_tunnel_t * tunnel = item->suspision_response_tunnel;
+      if (tunnel->state_type & REQUEST_STRING_TUNNEL) {
+         report_add_response_tunnel(buffer, size, &len, &header, REPORT_RESPONSE_REQUEST_STRING, tunnel->event_id_request, tunnel->request_suspision);
+      }
+      if (tunnel->state_type & TXT_TUNNEL) {
+         report_add_response_tunnel(buffer, size, &len, &header, REPORT_RESPONSE_TXT, tunnel->event_id_request, tunnel->txt_suspision);
+      }
+      if (tunnel->state_type & CNAME_TUNNEL) {
+         report_add_response_tunnel(buffer, size, &len, &header, REPORT_RESPONSE_CNAME, tunnel->event_id_txt, tunnel->cname_suspision);
+      }
+      if (tunnel->state_type & NS_TUNNEL) {
+         report_add_response_tunnel(buffer, size, &len, &header, REPORT_RESPONSE_NS, tunnel->event_id_cname, tunnel->ns_suspision);
+      }
+      if (tunnel->state_type & MX_TUNNEL) {
+         report_add_response_tunnel(buffer, size, &len, &header, REPORT_RESPONSE_MX, tunnel->event_id_ns, tunnel->mx_suspision);
+      }
+   }
+   //other anomaly in responses
+   if (item->state_response_other == STATE_ATTACK && item->print & RESPONSE_PART_OTHER) {
+      calulated_result_t result;
+      calculate_statistic(item, &result);
+      memset(&section, 0, sizeof(section));
+      section.kind = REPORT_RESPONSE_OTHER;
+      section.event_id = item->suspision_response_other->event_id;
+      section.values[0] = result.ex_response;
+      section.values[1] = result.var_response;
+      section.values[2] = (double)item->suspision_response_other->without_string / (double)item->suspision_response_other->packet_in_suspicion;
+      section.count = item->counter_response.dns_response_count;
+      report_add_section(buffer, size, &len, &header, &section, item->suspision_response_other->other_suspision, SUSPICION_MOST_USED);
+   }
+   memcpy(buffer, &header, sizeof(header));
+   item->print = 0;
+   return len;
+}
+
+void format_anomaly_report(FILE * file, uint16_t type, const void * data, uint32_t size, void * arg)
+{
+   static const char * response_tunnels[] = {
+      "Reponse tunnel found by request strings :",
+      "Reponse TXT tunnel found:",
+      "Reponse CNAME tunnel found:",
+      "Reponse NS tunnel found:",
+      "Reponse MX tunnel found:"
+   };
+   const char * pos = (const char *) data, * end = pos + size;
+   anomaly_report_header_t header;
+   anomaly_report_section_t section;
+   anomaly_report_domain_t domain;
+   char ip_address_str[INET6_ADDRSTRLEN];
+   char timebuf[26];
+   unsigned int i, j;
+   (void) arg;
+   if (file == NULL || type != ANOMALY_REPORT_RECORD || size < sizeof(header)) {
+      return;
+   }
+   memcpy(&header, pos, sizeof(header));
+   pos += sizeof(header);
+   if (header.print_time) {
+      time_t time = (time_t) header.time;
+      fprintf(file, "\nTIME: %s\n", ctime_r(&time, timebuf));
+   }
+   ip_to_str(&header.ip, ip_address_str);
+   fprintf(file, "\n%s\n", ip_address_str);
+   for (i = 0; i < header.sections && pos + sizeof(section) <= end; i++) {
+      memcpy(&section, pos, sizeof(section));
+      pos += sizeof(section);
+      switch (section.kind) {
+         case REPORT_REQUEST_TUNNEL:
+            fprintf(file, "%u\tRequest tunnel found:\tDomains searched just once: %f.\tcount of different domains: %f.\tPercent of subdomain in most used domain %f.\tAll recorded requests: %d\n", section.event_id, section.values[0], section.values[1], section.values[2], (int) section.count);
+            break;
+         case REPORT_REQUEST_OTHER:
+            fprintf(file, "%u\tRequest traffic anomaly found:\tDomains searched just once: %f.\tCount of different domains: %f.\tAll recorded requests: %d.\tCount of malformed requests: %d.\n\t\tFound in sizes: ", section.event_id, section.values[0], section.values[1], (int) section.count, (int) section.malformed);
+            for (j = 0; j < HISTOGRAM_SIZE_REQUESTS; j++) {
+               if (section.sizes & (1U << j))
+               fprintf(file, "%d-%d\t", j*10, j*10+10);
             }
-         }
-         //mx
-         if (item->suspision_response_tunnel->state_type & MX_TUNNEL) {
-            fprintf(file, "%u\tReponse MX tunnel found:\tstrings searched just once: %f.\tcount of different strings: %f.\tall requests: %d.\n", item->suspision_response_tunnel->event_id_ns, (double)(item->suspision_response_tunnel->mx_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_response_tunnel->mx_suspision->count_of_inserting_for_just_ones), (double)item->suspision_response_tunnel->mx_suspision->count_of_different_domains/(double)(item->suspision_response_tunnel->mx_suspision->count_of_inserting_for_just_ones),(item->suspision_response_tunnel->mx_suspision->count_of_inserting) );
-            dom =item->suspision_response_tunnel->mx_suspision->domain_extension->list_of_most_unused_domains;
-            for (int i=0; i<5;i++) {
-               str[0]=0;
-               if (dom==NULL) break;
-               fprintf(file, "\t\t%s. %d\n",  prefix_tree_read_string(item->suspision_response_tunnel->mx_suspision, dom, str), dom->count_of_insert);
-               dom= dom->domain_extension->most_used_domain_less;
+            fprintf(file, "\n");
+            break;
+         case REPORT_REQUEST_MALFORMED:
+            fprintf(file, "\tMallformed packets found:\tCount of malformed responses: %u.\n", section.malformed);
+            break;
+         case REPORT_RESPONSE_OTHER:
+            fprintf(file, "%u\tReseponse anomaly found:\tEX: %f.\tVAR: %f. \tPercent without request string %f. \tCount of responses %lu.\n", section.event_id, section.values[0], section.values[1], section.values[2], (unsigned long) section.count);
+            break;
+         default:
+            if (section.kind >= REPORT_RESPONSE_REQUEST_STRING && section.kind <= REPORT_RESPONSE_MX) {
+               fprintf(file, "%u\t%s\tstrings searched just once: %f.\tcount of different strings: %f.\tall requests: %d.\n", section.event_id, response_tunnels[section.kind - REPORT_RESPONSE_REQUEST_STRING], section.values[0], section.values[1], (int) section.count);
             }
-         }
+            break;
       }
-      //print founded anomaly other in responses
-      if (item->state_response_other == STATE_ATTACK && item->print & RESPONSE_PART_OTHER) {
-         calulated_result_t result;
-         calculate_statistic(item, &result);
-         fprintf(file, "%u\tReseponse anomaly found:\tEX: %f.\tVAR: %f. \tPercent without request string %f. \tCount of responses %lu.\n", item->suspision_response_other->event_id, result.ex_response, result.var_response, (double)item->suspision_response_other->without_string / (double)item->suspision_response_other->packet_in_suspicion ,item->counter_response.dns_response_count);
-         dom =item->suspision_response_other->other_suspision->domain_extension->list_of_most_used_domains;
-         for (int i=0; i<5;i++) {
-            str[0]=0;
-            if (dom==NULL) break;
-            fprintf(file, "\t\t%s. %d\n",  prefix_tree_read_string(item->suspision_response_other->other_suspision, dom, str), dom->count_of_insert);
-            dom= dom->domain_extension->most_used_domain_less;
+      for (j = 0; j < section.domains && pos + sizeof(domain) <= end; j++) {
+         memcpy(&domain, pos, sizeof(domain));
+         pos += sizeof(domain);
+         if (pos + domain.length > end) {
+            return;
          }
+         fprintf(file, "\t\t%.*s. %d\n", (int) domain.length, pos, domain.count);
+         pos += domain.length;
       }
-      item->print = 0;
-    }
+   }
 }
 
 void print_founded_anomaly(char * ip_address, ip_address_t *item, FILE *file)
 {
-   prefix_tree_domain_t *dom;
+   int count;
    char str[1024];
 
    if (item->state_request_other == STATE_ATTACK || item->state_request_tunnel == STATE_ATTACK || item->state_response_other == STATE_ATTACK || item->state_request_tunnel == STATE_ATTACK) {
       fprintf(file, "\n%s\n", ip_address);
       //print found anomaly tunnel
       if (item->state_request_tunnel == STATE_ATTACK) {
-         fprintf(file, "\tRequest tunnel found:\tDomains searched just once: %f.\tcount of different domains: %f.\tPercent of subdomain in most used domain %f.\tAll recorded requests: %d\n", (double)(item->suspision_request_tunnel->tunnel_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_request_tunnel->tunnel_suspision->count_of_inserting_for_just_ones), (double)item->suspision_request_tunnel->tunnel_suspision->count_of_different_domains/(double)(item->suspision_request_tunnel->tunnel_suspision->count_of_inserting_for_just_ones), prefix_tree_most_used_domain_percent_of_subdomains(item->suspision_request_tunnel->tunnel_suspision, DEPTH_TUNNEL_SUSPICTION) ,(item->suspision_request_tunnel->tunnel_suspision->count_of_inserting) );
+         fprintf(file, "\tRequest tunnel found:\tDomains searched just once: %f.\tcount of different domains: %f.\tPercent of subdomain in most used domain %f.\tAll recorded requests: %d\n", (double)(item->suspision_request_tunnel->tunnel_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_request_tunnel->tunnel_suspision->count_of_inserting_for_just_ones), (double)item->suspision_request_tunnel->tunnel_suspision->count_of_different_domains/(double)(item->suspision_request_tunnel->tunnel_suspision->count_of_inserting_for_just_ones), suspicion_store_most_used_domain_percent_of_subdomains(item->suspision_request_tunnel->tunnel_suspision, DEPTH_TUNNEL_SUSPICTION) ,(item->suspision_request_tunnel->tunnel_suspision->count_of_inserting) );
 
-         dom =item->suspision_request_tunnel->tunnel_suspision->domain_extension->list_of_most_unused_domains;
          for (int i=0; i<5;i++) {
-            str[0]=0;
-            if (dom==NULL) break;
-            fprintf(file, "\t\t%s. %d\n",  prefix_tree_read_string(item->suspision_request_tunnel->tunnel_suspision, dom, str), dom->count_of_insert);
-            dom= dom->domain_extension->most_used_domain_less;
+            if (!suspicion_store_read_domain(item->suspision_request_tunnel->tunnel_suspision, SUSPICION_MOST_UNUSED, i, str, &count)) break;
+            fprintf(file, "\t\t%s. %d\n", str, count);
          }
       }
       //print founded anomaly other in request
@@ -1529,12 +1696,9 @@ void print_founded_anomaly(char * ip_address, ip_address_t *item, FILE *file)
             }
             fprintf(file, "\n");
 
-            dom =item->suspision_request_other->other_suspision->domain_extension->list_of_most_used_domains;
             for (int i=0; i<5;i++) {
-               str[0]=0;
-               if (dom==NULL) break;
-               fprintf(file, "\t\t%s. %d\n",  prefix_tree_read_string(item->suspision_request_other->other_suspision, dom, str), dom->count_of_insert);
-               dom= dom->domain_extension->most_used_domain_less;
+               if (!suspicion_store_read_domain(item->suspision_request_other->other_suspision, SUSPICION_MOST_USED, i, str, &count)) break;
+               fprintf(file, "\t\t%s. %d\n", str, count);
             }
          }
          else {
@@ -1545,56 +1709,41 @@ void print_founded_anomaly(char * ip_address, ip_address_t *item, FILE *file)
       if (item->state_response_tunnel == STATE_ATTACK) {
          if (item->suspision_response_tunnel->state_type & REQUEST_STRING_TUNNEL) {
             fprintf(file, "\tReponse tunnel found by request strings :\tstrings searched just once: %f.\tcount of different strings: %f.\tall requests: %d.\n", (double)(item->suspision_response_tunnel->request_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_response_tunnel->request_suspision->count_of_inserting_for_just_ones), (double)item->suspision_response_tunnel->request_suspision->count_of_different_domains/(double)(item->suspision_response_tunnel->request_suspision->count_of_inserting_for_just_ones),(item->suspision_response_tunnel->request_suspision->count_of_inserting) );
-            dom =item->suspision_response_tunnel->request_suspision->domain_extension->list_of_most_unused_domains;
             for (int i=0; i<5;i++) {
-               str[0]=0;
-               if (dom==NULL) break;
-               fprintf(file, "\t\t%s. %d\n",  prefix_tree_read_string(item->suspision_response_tunnel->request_suspision, dom, str), dom->count_of_insert);
-               dom= dom->domain_extension->most_used_domain_less;
+               if (!suspicion_store_read_domain(item->suspision_response_tunnel->request_suspision, SUSPICION_MOST_UNUSED, i, str, &count)) break;
+               fprintf(file, "\t\t%s. %d\n", str, count);
             }
          }
          //txt
          if (item->suspision_response_tunnel->state_type & TXT_TUNNEL) {
             fprintf(file, "\tReponse TXT tunnel found:\tstrings searched just once: %f.\tcount of different strings: %f.\tall requests: %d.\n", (double)(item->suspision_response_tunnel->txt_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_response_tunnel->txt_suspision->count_of_inserting_for_just_ones), (double)item->suspision_response_tunnel->txt_suspision->count_of_different_domains/(double)(item->suspision_response_tunnel->txt_suspision->count_of_inserting_for_just_ones),(item->suspision_response_tunnel->txt_suspision->count_of_inserting) );
-            dom =item->suspision_response_tunnel->txt_suspision->domain_extension->list_of_most_unused_domains;
             for (int i=0; i<5;i++) {
-               str[0]=0;
-               if (dom==NULL) break;
-               fprintf(file, "\t\t%s. %d\n",  prefix_tree_read_string(item->suspision_response_tunnel->txt_suspision, dom, str), dom->count_of_insert);
-               dom= dom->domain_extension->most_used_domain_less;
+               if (!suspicion_store_read_domain(item->suspision_response_tunnel->txt_suspision, SUSPICION_MOST_UNUSED, i, str, &count)) break;
+               fprintf(file, "\t\t%s. %d\n", str, count);
             }
          }
          //cname
          if (item->suspision_response_tunnel->state_type & CNAME_TUNNEL) {
             fprintf(file, "\tReponse CNAME tunnel found:\tstrings searched just once: %f.\tcount of different strings: %f.\tall requests: %d.\n", (double)(item->suspision_response_tunnel->cname_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_response_tunnel->cname_suspision->count_of_inserting_for_just_ones), (double)item->suspision_response_tunnel->cname_suspision->count_of_different_domains/(double)(item->suspision_response_tunnel->cname_suspision->count_of_inserting_for_just_ones),(item->suspision_response_tunnel->cname_suspision->count_of_inserting) );
-            dom =item->suspision_response_tunnel->cname_suspision->domain_extension->list_of_most_unused_domains;
             for (int i=0; i<5;i++) {
-               str[0]=0;
-               if (dom==NULL) break;
-               fprintf(file, "\t\t%s. %d\n",  prefix_tree_read_string(item->suspision_response_tunnel->cname_suspision, dom, str), dom->count_of_insert);
-               dom= dom->domain_extension->most_used_domain_less;
+               if (!suspicion_store_read_domain(item->suspision_response_tunnel->cname_suspision, SUSPICION_MOST_UNUSED, i, str, &count)) break;
+               fprintf(file, "\t\t%s. %d\n", str, count);
             }
          }
          //ns
          if (item->suspision_response_tunnel->state_type & NS_TUNNEL) {
             fprintf(file, "\tReponse NS tunnel found:\tstrings searched just once: %f.\tcount of different strings: %f.\tall requests: %d.\n", (double)(item->suspision_response_tunnel->ns_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_response_tunnel->ns_suspision->count_of_inserting_for_just_ones), (double)item->suspision_response_tunnel->ns_suspision->count_of_different_domains/(double)(item->suspision_response_tunnel->ns_suspision->count_of_inserting_for_just_ones),(item->suspision_response_tunnel->ns_suspision->count_of_inserting) );
-            dom =item->suspision_response_tunnel->ns_suspision->domain_extension->list_of_most_unused_domains;
             for (int i=0; i<5;i++) {
-               str[0]=0;
-               if (dom==NULL) break;
-               fprintf(file, "\t\t%s. %d\n",  prefix_tree_read_string(item->suspision_response_tunnel->ns_suspision, dom, str), dom->count_of_insert);
-               dom= dom->domain_extension->most_used_domain_less;
+               if (!suspicion_store_read_domain(item->suspision_response_tunnel->ns_suspision, SUSPICION_MOST_UNUSED, i, str, &count)) break;
+               fprintf(file, "\t\t%s. %d\n", str, count);
             }
          }
          //mx
          if (item->suspision_response_tunnel->state_type & MX_TUNNEL) {
             fprintf(file, "\tReponse MX tunnel found:\tstrings searched just once: %f.\tcount of different strings: %f.\tall requests: %d.\n", (double)(item->suspision_response_tunnel->mx_suspision->count_of_domain_searched_just_ones) /(double)(item->suspision_response_tunnel->mx_suspision->count_of_inserting_for_just_ones), (double)item->suspision_response_tunnel->mx_suspision->count_of_different_domains/(double)(item->suspision_response_tunnel->mx_suspision->count_of_inserting_for_just_ones),(item->suspision_response_tunnel->mx_suspision->count_of_inserting) );
-            dom =item->suspision_response_tunnel->mx_suspision->domain_extension->list_of_most_unused_domains;
             for (int i=0; i<5;i++) {
-               str[0]=0;
-               if (dom==NULL) break;
-               fprintf(file, "\t\t%s. %d\n",  prefix_tree_read_string(item->suspision_response_tunnel->mx_suspision, dom, str), dom->count_of_insert);
-               dom= dom->domain_extension->most_used_domain_less;
+               if (!suspicion_store_read_domain(item->suspision_response_tunnel->mx_suspision, SUSPICION_MOST_UNUSED, i, str, &count)) break;
+               fprintf(file, "\t\t%s. %d\n", str, count);
             }
          }
       }
@@ -1604,12 +1753,9 @@ void print_founded_anomaly(char * ip_address, ip_address_t *item, FILE *file)
          calculate_statistic(item, &result);
          fprintf(file, "\tReseponse anomaly found:\tEX: %f.\tVAR: %f. \tPercent without request string %f. \tCount of responses %lu.\n", result.ex_response, result.var_response, (double)item->suspision_response_other->without_string / (double)item->suspision_response_other->packet_in_suspicion ,item->counter_response.dns_response_count);
 
-         dom =item->suspision_response_other->other_suspision->domain_extension->list_of_most_used_domains;
          for (int i=0; i<5;i++) {
-            str[0]=0;
-            if (dom==NULL) break;
-            fprintf(file, "\t\t%s. %d\n",  prefix_tree_read_string(item->suspision_response_other->other_suspision, dom, str), dom->count_of_insert);
-            dom= dom->domain_extension->most_used_domain_less;
+            if (!suspicion_store_read_domain(item->suspision_response_other->other_suspision, SUSPICION_MOST_USED, i, str, &count)) break;
+            fprintf(file, "\t\t%s. %d\n", str, count);
          }
       }
    }
@@ -1703,7 +1849,7 @@ void print_histogram_values (char *ip_address, ip_address_t *ip_item, FILE *file
    fprintf(file_responses, "%lu\n", ip_item->counter_response.histogram_dns_response[HISTOGRAM_SIZE_RESPONSE - 1]);
 }
 
-void write_detail_result(char * record_folder_name, bpt_t ** b_plus_tree, int count_of_btree)
+void write_detail_result(char * record_folder_name, ip_table_t ** tables, int count_of_tables)
 {
    FILE *file_requests = NULL,
         *file_responses = NULL,
@@ -1712,8 +1858,7 @@ void write_detail_result(char * record_folder_name, bpt_t ** b_plus_tree, int co
         *file_anomaly = NULL;
    char ip_buff[100] = {0};
    int i;
-   int is_there_next;
-   bpt_list_item_t *b_item;
+   uint32_t index;
    ip_address_t *ip_item;
    char *file_path = (char *) calloc(strlen(record_folder_name) + strlen(FILE_NAME_SUMMARY_REQUESTS) + 2, sizeof(char));
    if (!file_path) {
@@ -1794,24 +1939,19 @@ void write_detail_result(char * record_folder_name, bpt_t ** b_plus_tree, int co
 
 //print histogram of each IP
    //for each item in list
-   for (i =0; i < count_of_btree; i++) {
-      b_item = bpt_list_init(b_plus_tree[i]);
-      is_there_next = bpt_list_start(b_plus_tree[i], b_item);
-      while (is_there_next == 1) {
-         //value from bplus item structure
-         ip_item = (ip_address_t*)b_item->value;
+   for (i =0; i < count_of_tables; i++) {
+      for (index = ip_table_first(tables[i]); index < tables[i]->size; index = ip_table_next(tables[i], index)) {
+         //value from the table
+         ip_item = (ip_address_t*)ip_table_value(tables[i], index);
          //translate ip int to str
-         get_ip_str_from_ip_struct(ip_item, b_item->key, ip_buff);
+         get_ip_str_from_ip_struct(ip_item, ip_table_key(tables[i], index), ip_buff);
          //print histogram values
          print_histogram_values(ip_buff, ip_item, file_requests, file_responses, file_requests_count_letters);
          //print fouded anomaly
          print_founded_anomaly(ip_buff, ip_item, file_anomaly);
          //print suspision
          print_suspision_ip(ip_buff, ip_item, file_suspision);
-         //next item
-         is_there_next = bpt_list_item_next(b_plus_tree[i], b_item);
       }
-      bpt_list_clean(b_item);
    }
 
 cleanup:
@@ -1861,47 +2001,6 @@ static inline void cut_max_domain(packet_t *packet)
    packet->request_string[packet->request_length]=0;
 }
 
-int compare_ipv6(void * a, void * b)
-{
-   uint64_t *h1, *h2;
-   h1 = (uint64_t*)a;
-   h2 = (uint64_t*)b;
-   if (h1[0] == h2[0]) {
-      if (h1[1] == h2[1]) {
-         return EQUAL;
-      }
-      else if (h1[1] < h2[1]) {
-         return LESS;
-      }
-      else {
-         return MORE;
-      }
-   }
-   else if (h1[0] < h2[0]) {
-      return LESS;
-   }
-   else {
-      return MORE;
-   }
-
-}
-
-int compare_ipv4(void * a, void * b)
-{
-   uint32_t *h1, *h2;
-   h1 = (uint32_t*)a;
-   h2 = (uint32_t*)b;
-   if (*h1 == *h2) {
-         return EQUAL;
-   }
-   else if (*h1 < *h2) {
-      return LESS;
-   }
-   else {
-      return MORE;
-   }
-}
-
 unsigned int read_event_id_from_file(char * file_name)
 {
    FILE *fp;
@@ -1982,6 +2081,8 @@ void load_default_values()
    values.sdm_timeout = SDM_TIMEOUT;
    values.sdm_count_of_packets = SDM_COUNT_OF_PACKETS;
    values.file_name_event_id = NULL;
+   values.suspicion_sketch = 0;
+   values.count_of_workers = 0;
 }
 
 int main(int argc, char **argv)
@@ -1991,18 +2092,24 @@ int main(int argc, char **argv)
    double start_time=0, packet_time=0;
    int count_of_cycle=0;
    char file_or_port=0;
-   FILE * result_file = NULL,
-        * exception_file_domain = NULL,
+   async_log_t * result_log = NULL;
+   FILE * exception_file_domain = NULL,
         * exception_file_ip = NULL;
-   bpt_t * btree_ver4, *btree_ver6, *btree[2];
+   ip_table_t * table_ver4, *table_ver6, *table[2];
+   evaluation_list_t evaluation_ver4, evaluation_ver6;
+   worker_t * workers = NULL;
+   unsigned int count_of_started_workers = 0;
    prefix_tree_t * exception_domain_prefix_tree = NULL;
-   bpt_t * exception_ip_v4_b_plus_tree = NULL;
-   bpt_t * exception_ip_v6_b_plus_tree = NULL;
+   ip_table_t * exception_ip_v4_table = NULL;
+   ip_table_t * exception_ip_v6_table = NULL;
    unsigned long cnt_flows = 0;
    unsigned long cnt_packets = 0;
    unsigned long histogram_dns_requests [HISTOGRAM_SIZE_REQUESTS];
    unsigned long histogram_dns_response [HISTOGRAM_SIZE_RESPONSE];
    unsigned char write_summary = 0;
+   char * metrics_socket = NULL;
+   double overload_threshold = 0;
+   overload_t overload;
    memset(histogram_dns_requests, 0, HISTOGRAM_SIZE_REQUESTS * sizeof(unsigned long));
    memset(histogram_dns_response, 0, HISTOGRAM_SIZE_RESPONSE * sizeof(unsigned long));
    //load default values from defined constants
@@ -2049,8 +2156,8 @@ int main(int argc, char **argv)
             }
             break;
          case 'd':
-               result_file = fopen ( optarg, "a+" );
-               if (result_file == NULL) {
+               result_log = async_log_open(optarg, ASYNC_LOG_DEFAULT_CAPACITY, ASYNC_LOG_SYNC_NEVER, format_anomaly_report, NULL);
+               if (result_log == NULL) {
                   fprintf(stderr, "Error: Output file couldn`t be opened.\n");
                   goto failed_trap;
                }
@@ -2058,7 +2165,7 @@ int main(int argc, char **argv)
                   time_t mytime;
                   char timebuf[26];
                   mytime = time(NULL);
-                  fprintf(result_file, "\nSTART TIME: %s\n", ctime_r(&mytime, timebuf));
+                  async_log_printf(result_log, "\nSTART TIME: %s\n", ctime_r(&mytime, timebuf));
                }
             break;
          case 'a':
@@ -2155,6 +2262,32 @@ int main(int argc, char **argv)
           case 'E':
             values.file_name_event_id = optarg;
             break;
+         case 'x':
+            values.suspicion_sketch = 1;
+            break;
+         case 'W':
+            if (sscanf(optarg, "%u", &values.count_of_workers) != 1) {
+               fprintf(stderr, "Missing 'W' argument\n");
+               goto failed_trap;
+            }
+            break;
+         case 'M':
+            metrics_socket = optarg;
+            break;
+         case 'L': {
+            char *end;
+            overload_threshold = strtod(optarg, &end);
+            if (end == optarg || *end != '\0' || !(overload_threshold > 0 && overload_threshold <= 1)) {
+               fprintf(stderr, "Wrong 'L' argument, load threshold must be in (0, 1]\n");
+               goto failed_trap;
+            }
+            break;
+         }
+         case 'A':
+            if (affinity_init(optarg) != 0) {
+               goto failed_trap;
+            }
+            break;
          case 'i':
             file_or_port |= READ_FROM_UNIREC;
             break;
@@ -2316,26 +2449,26 @@ int main(int argc, char **argv)
             sign = fgetc(exception_file_ip);
          }
          ip_str[length] = 0;
-         //translate to IP unirec format and insert to b plus tree.
+         //translate to IP unirec format and insert to the table.
          if (length != 0) {
             if (ip_from_str(ip_str, &addr) == 1) {
                if (ip_is4(&addr)) {
                   //is IPv4
-                  if (exception_ip_v4_b_plus_tree == NULL) {
-                     exception_ip_v4_b_plus_tree = bpt_init(COUNT_OF_ITEM_IN_LEAF, &compare_ipv4, 0, sizeof(uint32_t));
+                  if (exception_ip_v4_table == NULL) {
+                     exception_ip_v4_table = ip_table_init(IP_TABLE_INITIAL_SIZE, sizeof(uint32_t), 0);
                   }
-                  if (exception_ip_v4_b_plus_tree != NULL) {
-                     uint32_t ip_to_tree = ip_get_v4_as_int(&addr);
-                     bpt_insert(exception_ip_v4_b_plus_tree, &ip_to_tree);
+                  if (exception_ip_v4_table != NULL) {
+                     uint32_t ip_to_table = ip_get_v4_as_int(&addr);
+                     ip_table_search_or_insert(exception_ip_v4_table, &ip_to_table);
                   }
                }
                else {
                   //is IPv6
-                  if (exception_ip_v6_b_plus_tree == NULL) {
-                     exception_ip_v6_b_plus_tree = bpt_init(COUNT_OF_ITEM_IN_LEAF, &compare_ipv6, 0, sizeof(uint64_t)*2);
+                  if (exception_ip_v6_table == NULL) {
+                     exception_ip_v6_table = ip_table_init(IP_TABLE_INITIAL_SIZE, sizeof(uint64_t)*2, 0);
                   }
-                  if (exception_ip_v6_b_plus_tree != NULL) {
-                     bpt_insert(exception_ip_v6_b_plus_tree, &addr);
+                  if (exception_ip_v6_table != NULL) {
+                     ip_table_search_or_insert(exception_ip_v6_table, &addr);
                   }
                }
             }
@@ -2348,33 +2481,70 @@ int main(int argc, char **argv)
       }
       fclose(exception_file_ip);
    }
-   //initialize b+ tree ipv4
-   btree_ver4 = bpt_init(COUNT_OF_ITEM_IN_LEAF, &compare_ipv4, sizeof(ip_address_t), sizeof(uint32_t));
-   //initialize b+ tree ipv6
-   btree_ver6 = bpt_init(COUNT_OF_ITEM_IN_LEAF, &compare_ipv6, sizeof(ip_address_t), sizeof(uint64_t)*2);
-   //add trees to array, you can work with it in cycle
-   btree[0] = btree_ver4;
-   btree[1] = btree_ver6;
+   //runtime metrics, the workers use them too
+   records_metric = metrics_counter("dnstunnel_records_total", "Records (packets) received by the module.");
+   packet_metric = metrics_histogram("dnstunnel_packet_seconds", "Time of the collection of information from one packet.");
+   evaluation_metric = metrics_histogram("dnstunnel_evaluation_seconds", "Duration of the evaluation of the collected IP addresses.");
+   tracked_ipv4_metric = metrics_gauge("dnstunnel_tracked_ips{version=\"4\"}", "IP addresses in the tables at the last evaluation.");
+   tracked_ipv6_metric = metrics_gauge("dnstunnel_tracked_ips{version=\"6\"}", "IP addresses in the tables at the last evaluation.");
+   //only records received from the interface are shed, files are read as fast as possible
+   overload_init(&overload, "dnstunnel", (file_or_port & READ_FROM_UNIREC) ? overload_threshold : 0);
+   if (metrics_socket != NULL && metrics_server_start(metrics_socket) != 0) {
+      fprintf(stderr, "Error: Metrics could not be served on socket %s.\n", metrics_socket);
+   }
+   //the receiving thread is pinned before it allocates its tables, so they are local to its CPU
+   affinity_pin_self();
+   //initialize table ipv4
+   table_ver4 = ip_table_init(IP_TABLE_INITIAL_SIZE, sizeof(uint32_t), sizeof(ip_address_t));
+   //initialize table ipv6
+   table_ver6 = ip_table_init(IP_TABLE_INITIAL_SIZE, sizeof(uint64_t)*2, sizeof(ip_address_t));
+   //add tables to array, you can work with it in cycle
+   table[0] = table_ver4;
+   table[1] = table_ver6;
+   //lists of IPs to evaluate
+   evaluation_list_init(&evaluation_ver4, sizeof(uint32_t));
+   evaluation_list_init(&evaluation_ver6, sizeof(uint64_t)*2);
+   //every worker owns its own b+ trees, the trees above stay empty
+   if (values.count_of_workers > 0 && file_or_port != MEASURE_PARAMETERS) {
+      workers = (worker_t*)calloc(values.count_of_workers, sizeof(worker_t));
+      if (workers == NULL) {
+         fprintf(stderr, "Error: calloc failed.\n");
+         stop = 1;
+      }
+      for (count_of_started_workers = 0; workers != NULL && count_of_started_workers < values.count_of_workers; count_of_started_workers++) {
+         if (worker_start(&workers[count_of_started_workers], count_of_started_workers, result_log, &ur_notification) != 0) {
+            stop = 1;
+            break;
+         }
+      }
+   }
    // ***** Main processing loop for Unirec records *****
    if (input_packet_file_name == NULL) {
       ip_addr_t * ip_in_packet;
       const void *data;
       uint16_t data_size;
       time_t start_t, end_t;
-      time(&start_t);
-      time(&end_t);
+      unsigned int records_without_time = 0;
+      update_current_time(time(NULL));
       #ifdef TEST
       char ip_buff [100];
       #endif /*TEST*/
       //read packets from interface
       while (!stop) {
          //cycle of colecting informations
-         time(&start_t);
-         time(&end_t);
+         start_t = current_time;
+         end_t = current_time;
          while (difftime(end_t, start_t) <= values.time_of_one_session && !stop) {
             // Receive data from any interface, wait until data are available
             ret = TRAP_RECEIVE(0, data, data_size, tmplt);
-            TRAP_DEFAULT_GET_DATA_ERROR_HANDLING(ret, continue, break);
+            TRAP_DEFAULT_GET_DATA_ERROR_HANDLING(ret, {
+               //no records, the clock of input without timestamps has to be moved by the system time
+               if (!ur_is_present(tmplt, F_TIME_LAST)) {
+                  update_current_time(time(NULL));
+                  end_t = current_time;
+               }
+               continue;
+            }, break);
 
             // Check size of received data
             if (data_size < ur_rec_fixlen_size(tmplt)) {
@@ -2389,8 +2559,19 @@ int main(int argc, char **argv)
                }
             }
             cnt_packets++;
+            metrics_counter_inc(records_metric);
+            overload_begin(&overload);
+            //move the clock by the record time, system time is read just once in a while
+            if (ur_is_present(tmplt, F_TIME_LAST)) {
+               update_current_time(ur_time_get_sec(ur_get(tmplt, data, F_TIME_LAST)));
+            }
+            else if (++records_without_time >= CLOCK_REFRESH_RECORDS) {
+               records_without_time = 0;
+               update_current_time(time(NULL));
+            }
             //fill the packet structure
             //size
+            packet.time = (double)current_time;
             packet.size = ur_get(tmplt, data, F_BYTES);
             //DNS NAME
             packet.request_length = copy_string(packet.request_string, ur_get_ptr(tmplt, data, F_DNS_NAME), ur_get_var_len(tmplt, data, F_DNS_NAME), MAX_LENGTH_OF_REQUEST_DOMAIN);
@@ -2464,23 +2645,24 @@ int main(int argc, char **argv)
                   printf("cname: %s\n", packet.cname_response);
                printf("\n");
             #endif /*TEST*/
-            //test if it is not in exception
-            if ( //domains
+            //test if it is not in exception, in overload only IPs sampled by hash are analyzed
+            if (overload_keep(&overload, packet_host(&packet)) &&
+                  //domains
                   (exception_domain_prefix_tree == NULL ||
                    packet.request_length == 0 ||
                    prefix_tree_is_string_in_exception(exception_domain_prefix_tree, packet.request_string, packet.request_length) == 0
                   ) &&
                   (  //ip
                      (packet.ip_version == IP_VERSION_4 &&
-                        (exception_ip_v4_b_plus_tree == NULL ||
-                         (bpt_search(exception_ip_v4_b_plus_tree, &packet.src_ip_v4) == NULL &&
-                          bpt_search(exception_ip_v4_b_plus_tree, &packet.dst_ip_v4) == NULL
+                        (exception_ip_v4_table == NULL ||
+                         (ip_table_search(exception_ip_v4_table, &packet.src_ip_v4) == NULL &&
+                          ip_table_search(exception_ip_v4_table, &packet.dst_ip_v4) == NULL
                          ))
                      )||
                      (packet.ip_version == IP_VERSION_6 &&
-                        (exception_ip_v6_b_plus_tree == NULL ||
-                        (bpt_search(exception_ip_v4_b_plus_tree, packet.src_ip_v6) == NULL &&
-                         bpt_search(exception_ip_v4_b_plus_tree, packet.dst_ip_v6) == NULL))
+                        (exception_ip_v6_table == NULL ||
+                        (ip_table_search(exception_ip_v6_table, packet.src_ip_v6) == NULL &&
+                         ip_table_search(exception_ip_v6_table, packet.dst_ip_v6) == NULL))
                      )
                   )
             ) {
@@ -2488,22 +2670,28 @@ int main(int argc, char **argv)
                   //is it destination port of DNS (Port 53) request
                   if (packet.is_response==0) {
                      // Update counters
-                     if (packet.ip_version == IP_VERSION_4) {
-                           collection_of_information_and_basic_payload_detection(btree_ver4, (&packet.src_ip_v4), &packet);
+                     if (workers != NULL) {
+                        worker_push_packet(&workers[worker_shard(&packet, values.count_of_workers)], &packet);
+                     }
+                     else if (packet.ip_version == IP_VERSION_4) {
+                           collection_of_information_and_basic_payload_detection(table_ver4, &evaluation_ver4, (&packet.src_ip_v4), &packet);
                         }
                         else {
-                           collection_of_information_and_basic_payload_detection(btree_ver6, packet.src_ip_v6,  &packet);
+                           collection_of_information_and_basic_payload_detection(table_ver6, &evaluation_ver6, packet.src_ip_v6,  &packet);
                         }
                      histogram_dns_requests[packet.size <= (HISTOGRAM_SIZE_REQUESTS - 1) * 10 ? packet.size / 10 : HISTOGRAM_SIZE_REQUESTS - 1]++;
                   }
                   //is it source port of DNS (Port 53)
                   else {
                      // Update counters
-                     if (packet.ip_version == IP_VERSION_4) {
-                        collection_of_information_and_basic_payload_detection(btree_ver4, (&packet.dst_ip_v4), &packet);
+                     if (workers != NULL) {
+                        worker_push_packet(&workers[worker_shard(&packet, values.count_of_workers)], &packet);
+                     }
+                     else if (packet.ip_version == IP_VERSION_4) {
+                        collection_of_information_and_basic_payload_detection(table_ver4, &evaluation_ver4, (&packet.dst_ip_v4), &packet);
                      }
                      else {
-                        collection_of_information_and_basic_payload_detection(btree_ver6, packet.dst_ip_v6, &packet);
+                        collection_of_information_and_basic_payload_detection(table_ver6, &evaluation_ver6, packet.dst_ip_v6, &packet);
                      }
 
                      histogram_dns_response[packet.size <= (HISTOGRAM_SIZE_RESPONSE - 1) * 10 ? packet.size / 10 : HISTOGRAM_SIZE_RESPONSE - 1]++;
@@ -2514,15 +2702,23 @@ int main(int argc, char **argv)
                signal(SIGUSR1, signal_handler);
                stats = 0;
             }
+            overload_end(&overload, 1);
             //save packet time
-            time(&end_t);
+            end_t = current_time;
          }
          //restart timer
          printf("cycle %d\n", ++count_of_cycle);
-         printf("\tcount of ip's before_erase %lu\n", bpt_item_cnt(btree_ver4) + bpt_item_cnt(btree_ver6));
-         calculate_statistic_and_choose_anomaly(btree_ver4, result_file, &ur_notification);
-         calculate_statistic_and_choose_anomaly(btree_ver6, result_file, &ur_notification);
-         printf("\tcount of ip's after_erase %lu\n\n", bpt_item_cnt(btree_ver4) + bpt_item_cnt(btree_ver6));
+         if (workers != NULL) {
+            //workers evaluate their IPs while the next session is received
+            for (i = 0; i < (int)count_of_started_workers; i++) {
+               worker_push_evaluation(&workers[i], current_time);
+            }
+            continue;
+         }
+         printf("\tcount of ip's before_erase %lu\n", (unsigned long) (table_ver4->count + table_ver6->count));
+         calculate_statistic_and_choose_anomaly(table_ver4, &evaluation_ver4, result_log, &ur_notification);
+         calculate_statistic_and_choose_anomaly(table_ver6, &evaluation_ver6, result_log, &ur_notification);
+         printf("\tcount of ip's after_erase %lu\n\n", (unsigned long) (table_ver4->count + table_ver6->count));
          //stop=1;
       }
    }
@@ -2530,7 +2726,7 @@ int main(int argc, char **argv)
    //***** Main processing loop for file *****
       //read packets from file
       //initialization of parser
-      FILE *input;
+      packet_reader_t *input;
       #ifdef TIME
             clock_t start_t, end_t;
             double delay = 0;
@@ -2557,11 +2753,13 @@ int main(int argc, char **argv)
                   start_t = clock();
             #endif /*TIME*/
             cnt_packets++;
+            metrics_counter_inc(records_metric);
             //read packet time
             if (start_time==0) {
                start_time = packet.time;
             }
             packet_time = packet.time;
+            update_current_time((time_t) packet.time);
             if (progress > 0 && cnt_flows % progress == 0) {
                printf(".");
                fflush(stdout);
@@ -2574,37 +2772,43 @@ int main(int argc, char **argv)
                   ) &&
                   (  //ip
                      (packet.ip_version == IP_VERSION_4 &&
-                        (exception_ip_v4_b_plus_tree == NULL ||
-                         (bpt_search(exception_ip_v4_b_plus_tree, &packet.src_ip_v4) == NULL &&
-                          bpt_search(exception_ip_v4_b_plus_tree, &packet.dst_ip_v4) == NULL
+                        (exception_ip_v4_table == NULL ||
+                         (ip_table_search(exception_ip_v4_table, &packet.src_ip_v4) == NULL &&
+                          ip_table_search(exception_ip_v4_table, &packet.dst_ip_v4) == NULL
                          ))
                      )||
                      (packet.ip_version == IP_VERSION_6 &&
-                        (exception_ip_v6_b_plus_tree == NULL ||
-                        (bpt_search(exception_ip_v4_b_plus_tree, packet.src_ip_v6) == NULL &&
-                         bpt_search(exception_ip_v4_b_plus_tree, packet.dst_ip_v6) == NULL))
+                        (exception_ip_v6_table == NULL ||
+                        (ip_table_search(exception_ip_v6_table, packet.src_ip_v6) == NULL &&
+                         ip_table_search(exception_ip_v6_table, packet.dst_ip_v6) == NULL))
                      )
                   )
             ) {
                //is it destination port of DNS (Port 53) request
                if (packet.is_response==0) {
                   // Update counters
-                  if (packet.ip_version == IP_VERSION_4) {
-                     collection_of_information_and_basic_payload_detection(btree_ver4, (&packet.src_ip_v4), &packet);
+                  if (workers != NULL) {
+                     worker_push_packet(&workers[worker_shard(&packet, values.count_of_workers)], &packet);
+                  }
+                  else if (packet.ip_version == IP_VERSION_4) {
+                     collection_of_information_and_basic_payload_detection(table_ver4, &evaluation_ver4, (&packet.src_ip_v4), &packet);
                   }
                   else {
-                     collection_of_information_and_basic_payload_detection(btree_ver6, packet.src_ip_v6, &packet);
+                     collection_of_information_and_basic_payload_detection(table_ver6, &evaluation_ver6, packet.src_ip_v6, &packet);
                   }
                   histogram_dns_requests[packet.size <= (HISTOGRAM_SIZE_REQUESTS - 1) * 10 ? packet.size / 10 : HISTOGRAM_SIZE_REQUESTS - 1]++;
                }
                //is it source port of DNS (Port 53)
                else {
                   // Update counters
-                  if (packet.ip_version == IP_VERSION_4) {
-                     collection_of_information_and_basic_payload_detection(btree_ver4, (&packet.dst_ip_v4), &packet);
+                  if (workers != NULL) {
+                     worker_push_packet(&workers[worker_shard(&packet, values.count_of_workers)], &packet);
+                  }
+                  else if (packet.ip_version == IP_VERSION_4) {
+                     collection_of_information_and_basic_payload_detection(table_ver4, &evaluation_ver4, (&packet.dst_ip_v4), &packet);
                   }
                   else {
-                     collection_of_information_and_basic_payload_detection(btree_ver6, packet.dst_ip_v6, &packet);
+                     collection_of_information_and_basic_payload_detection(table_ver6, &evaluation_ver6, packet.dst_ip_v6, &packet);
                   }
                   histogram_dns_response[packet.size <= (HISTOGRAM_SIZE_RESPONSE - 1) * 10 ? packet.size / 10 : HISTOGRAM_SIZE_RESPONSE - 1]++;
                }
@@ -2625,19 +2829,26 @@ int main(int argc, char **argv)
          start_time=0;
          packet_time=0;
          printf("cycle %d\n", ++count_of_cycle);
-         printf("\tcount of ip's before_erase %lu\n", bpt_item_cnt(btree_ver4) + bpt_item_cnt(btree_ver6));
+         if (workers != NULL) {
+            //workers evaluate their IPs while the next session is read
+            for (i = 0; i < (int)count_of_started_workers; i++) {
+               worker_push_evaluation(&workers[i], current_time);
+            }
+            continue;
+         }
+         printf("\tcount of ip's before_erase %lu\n", (unsigned long) (table_ver4->count + table_ver6->count));
          #ifdef TIME
-               ip_address_before_erase += bpt_item_cnt(btree_ver4) + bpt_item_cnt(btree_ver6);
+               ip_address_before_erase += table_ver4->count + table_ver6->count;
                start_t = clock();
          #endif /*TIME*/
-         calculate_statistic_and_choose_anomaly(btree_ver4, result_file, &ur_notification);
-         calculate_statistic_and_choose_anomaly(btree_ver6, result_file, &ur_notification);
+         calculate_statistic_and_choose_anomaly(table_ver4, &evaluation_ver4, result_log, &ur_notification);
+         calculate_statistic_and_choose_anomaly(table_ver6, &evaluation_ver6, result_log, &ur_notification);
           #ifdef TIME
               end_t = clock();;
           #endif /*TIME*/
-          printf("\tcount of ip's after_erase %lu\n\n", bpt_item_cnt(btree_ver4) + bpt_item_cnt(btree_ver6));
+          printf("\tcount of ip's after_erase %lu\n\n", (unsigned long) (table_ver4->count + table_ver6->count));
          #ifdef TIME
-                  ip_address_after_erase += bpt_item_cnt(btree_ver4) + bpt_item_cnt(btree_ver6);
+                  ip_address_after_erase += table_ver4->count + table_ver6->count;
                   delay += (double)(end_t - start_t) / CLOCKS_PER_SEC;
                printf("time all: %f\t delta time: %f\n", delay, delay - last_delay);
                printf("add to b plus: %d,\t search in b plus: %d,\t delete ip from blus: %d,\t add to prefix: %d \n", add_to_bplus, search_in_bplus, delete_from_blus, add_to_prefix );
@@ -2655,7 +2866,7 @@ int main(int argc, char **argv)
    //***** Main processing loop for measure parameters *****
       //read packets from file
       //inicialization of parser
-      FILE *input;
+      packet_reader_t *input;
       measure_parameters_t measure;
       character_statistic_t char_stat;
       prefix_tree_t * tree_measure;
@@ -2683,6 +2894,7 @@ int main(int argc, char **argv)
                break; // End of data (used for testing purposes)
             }
             cnt_packets++;
+            metrics_counter_inc(records_metric);
             //read packet time
             packet_time = packet.time;
             if (progress > 0 && cnt_flows % progress == 0) {
@@ -2697,15 +2909,15 @@ int main(int argc, char **argv)
                   ) &&
                   (  //ip
                      (packet.ip_version == IP_VERSION_4 &&
-                        (exception_ip_v4_b_plus_tree == NULL ||
-                         (bpt_search(exception_ip_v4_b_plus_tree, &packet.src_ip_v4) == NULL &&
-                          bpt_search(exception_ip_v4_b_plus_tree, &packet.dst_ip_v4) == NULL
+                        (exception_ip_v4_table == NULL ||
+                         (ip_table_search(exception_ip_v4_table, &packet.src_ip_v4) == NULL &&
+                          ip_table_search(exception_ip_v4_table, &packet.dst_ip_v4) == NULL
                          ))
                      )||
                      (packet.ip_version == IP_VERSION_6 &&
-                        (exception_ip_v6_b_plus_tree == NULL ||
-                        (bpt_search(exception_ip_v4_b_plus_tree, packet.src_ip_v6) == NULL &&
-                         bpt_search(exception_ip_v4_b_plus_tree, packet.dst_ip_v6) == NULL))
+                        (exception_ip_v6_table == NULL ||
+                        (ip_table_search(exception_ip_v6_table, packet.src_ip_v6) == NULL &&
+                         ip_table_search(exception_ip_v6_table, packet.dst_ip_v6) == NULL))
                      )
                   )
             ) {
@@ -2815,44 +3027,58 @@ int main(int argc, char **argv)
       printf("\n");
    }
    printf("Packets: %20lu\n", cnt_packets);
+   //let the workers process the queued packets
+   for (i = 0; i < (int)count_of_started_workers; i++) {
+      worker_stop(&workers[i]);
+   }
    // *****  Write into file ******
    if (write_summary) {
       write_summary_result(record_folder_name, histogram_dns_requests, histogram_dns_response);
-      write_detail_result(record_folder_name, btree, 2);
+      if (workers != NULL) {
+         ip_table_t ** worker_table = (ip_table_t**)malloc(2 * count_of_started_workers * sizeof(ip_table_t*));
+         if (worker_table != NULL) {
+            for (i = 0; i < (int)count_of_started_workers; i++) {
+               worker_table[2 * i] = workers[i].table[0];
+               worker_table[2 * i + 1] = workers[i].table[1];
+            }
+            write_detail_result(record_folder_name, worker_table, 2 * count_of_started_workers);
+            free(worker_table);
+         }
+      }
+      else {
+         write_detail_result(record_folder_name, table, 2);
+      }
    }
    write_event_id_to_file(values.file_name_event_id == NULL ? FILE_NAME_EVENT_ID : values.file_name_event_id, values.event_id_counter);
    // ***** Cleanup *****
-   //clean values in b plus tree
-   if (result_file != NULL) {
-      fclose(result_file);
-   }
-
-   //clean btree ver4 and ver6
-   bpt_list_item_t *b_item;
+   //clean values in the tables
+   //clean table ver4 and ver6
    for (i = 0; i<2; i++) {
-      b_item = bpt_list_init(btree[i]);
-      int is_there_next = bpt_list_start(btree[i], b_item);
-      while (is_there_next == 1) {
-         check_and_delete_suspision((ip_address_t*)b_item->value, REQUEST_AND_RESPONSE_PART);
-         is_there_next = bpt_list_item_next(btree[i], b_item);
-      }
-      bpt_list_clean(b_item);
-      bpt_clean(btree[i]);
+      clean_ip_table(table[i]);
+   }
+   free(evaluation_ver4.keys);
+   free(evaluation_ver6.keys);
+   //clean workers with their tables
+   for (i = 0; i < (int)count_of_started_workers; i++) {
+      worker_destroy(&workers[i]);
+   }
+   free(workers);
+   if (overload.shed > 0) {
+      printf("Packets shed in overload: %lu\n", (unsigned long) overload.shed);
    }
    //clean exception prefix tree
    if (exception_domain_prefix_tree != NULL) {
       prefix_tree_destroy(exception_domain_prefix_tree);
    }
-   //clean exception b plus tree for IPv4
-   if (exception_ip_v4_b_plus_tree != NULL) {
-      bpt_clean(exception_ip_v4_b_plus_tree);
-   }
-   //clean exception b plus tree for IPv6
-   if (exception_ip_v6_b_plus_tree != NULL) {
-      bpt_clean(exception_ip_v6_b_plus_tree);
-   }
+   //clean exception table for IPv4
+   ip_table_destroy(exception_ip_v4_table);
+   //clean exception table for IPv6
+   ip_table_destroy(exception_ip_v6_table);
    // Do all necessary cleanup before exiting
 failed_trap:
+   metrics_server_stop();
+   //write the rest of the anomaly file
+   async_log_close(result_log);
    if (file_or_port & READ_FROM_UNIREC) {
       // send terminate message
       char dummy[1] = {0};
@@ -57,7 +57,8 @@
 #include <libtrap/trap.h>
 #include <unirec/unirec.h>
 #include "parser_pcap_dns.h"
-#include <b_plus_tree.h>
+#include "ip_table.h"
+#include "async_log.h"
 #include "tunnel_detection_dns_structs.h"
 
 
@@ -90,11 +91,18 @@
 #define SDM_COUNT_OF_PACKETS 1000 /*< Count of packet which will be recorded by SDM */
 #define SDM_TIMEOUT 300 /*< Timeout, after that the rule will be discard from SDM */
  /* /} */
+/*!
+ * \name Module clock
+ *  The module time is given by timestamps of the received records (or packets
+ *  in a file). System time is used only for records without TIME_LAST.
+ * \{ */
+#define CLOCK_REFRESH_RECORDS 1000 /*< Count of records without timestamp after that the system time is read again */
+ /* /} */
 /*!
  * \name Default values
  *  Defines macros used by DNS tunel detection
  * \{ */
-#define COUNT_OF_ITEM_IN_LEAF 5 /*< Count of item in leaf of B+ tree. M value of B+ tree */
+#define IP_TABLE_INITIAL_SIZE 4096 /*< Initial count of slots in the tables of IP addresses */
 #define READ_FROM_FILE 1 /*< Specify module configuration. Modul will read packets from FILE */
 #define READ_FROM_UNIREC 2 /*< Specify module configuration. Modul will read packets from UNIREC */
 #define MEASURE_PARAMETERS 4 /*< Specify module configuration. Modul will measure detection parameters */
@@ -164,19 +172,17 @@
 void signal_handler(int signal);
 
 /*!
- * \brief Turns IP address from b_plus_tree to ip_addr_t
- * Turns IP address from b_plus_tree to ip_addr_t structure.
- * \param[in] item  value structure from b_plus_tree
- * \param[in] key key from b_plus_tree
- * \return ip_addr_t structure
+ * \brief Update module clock.
+ * Moves the module clock to the given time, the clock never goes back.
+ * \param[in] t Timestamp of the last received record or packet.
  */
-static inline ip_addr_t get_ip_addr_t_from_ip_struct(ip_address_t *item, void *key);
+void update_current_time(time_t t);
 
 /*!
- * \brief Turns IP address from b_plus_tree to string
- * Turns IP address from b_plus_tree to string in dot format.
- * \param[in] item  value structure from b_plus_tree
- * \param[in] key key from b_plus_tree
+ * \brief Turns IP address from table to string
+ * Turns IP address from table to string in dot format.
+ * \param[in] item  value structure from table
+ * \param[in] key key from table
  * \param[in] ip_buff space where to store the string
  */
 void get_ip_str_from_ip_struct(ip_address_t * item, void * key,  char * ip_buff);
@@ -205,16 +211,16 @@ void write_summary_result(char * record_folder, unsigned long * histogram_dns_re
  * It will write details of DNS communication to a file.
  * It is histogram of DNS requests and responses of each ip address separately.
  * \param[in] record_folder_name name of folder where to save results
- * \param[in] b_plus_tree pointer to array of b_plus_tree structures, where the IP address are stored.
- * \param[in] count_of_btree count of trees in the array.
+ * \param[in] tables pointer to array of tables, where the IP address are stored.
+ * \param[in] count_of_tables count of tables in the array.
  */
-void write_detail_result(char * record_folder_name, bpt_t ** b_plus_tree, int count_of_btree);
+void write_detail_result(char * record_folder_name, ip_table_t ** tables, int count_of_tables);
 
 /*!
  * \brief Send alerts of detected tunnel to SDM
  * It will send informations about detected tunnel to SDM.
  * \param[in] ip_address IP address with anomaly.
- * \param[in] item value from b_plus_tree.
+ * \param[in] item value from table.
  * \param[in] unirec_out structure with information about UniRec output.
  */
 void send_unirec_alert_to_sdm(ip_addr_t * ip_address, ip_address_t *item, unirec_tunnel_notification_t * unirec_out_sdm);
@@ -223,7 +229,7 @@ void send_unirec_alert_to_sdm(ip_addr_t * ip_address, ip_address_t *item, unirec
  * \brief Send alerts of detected anomalies.
  * It will send informations about detected anomalies.
  * \param[in] ip_address IP address with anomaly.
- * \param[in] item value from b_plus_tree.
+ * \param[in] item value from table.
  * \param[in] unirec_out structure with information about UniRec output.
  */
 void send_unirec_alert_and_reset_records(ip_addr_t * ip_address, ip_address_t *item, unirec_tunnel_notification_t * unirec_out);
@@ -239,11 +245,28 @@ int filter_trafic_to_save_in_prefix_tree_tunnel_suspicion(character_statistic_t
 /*!
  * \brief Save information about IP
  * Function saves new information from packets and analyzes basic payload anomaly.
- * \param[in] tree pointer to B+ tree.
+ * IP address is added to list of IPs to evaluate, when it exceeds minimal counts or gets into suspicion.
+ * \param[in] table pointer to table of IP addresses.
+ * \param[in] list list of IPs to evaluate.
  * \param[in] ip_in_packet ip address from packet.
  * \param[in] packet recieved packet.
  */
-void collection_of_information_and_basic_payload_detection(bpt_t * tree, void * ip_in_packet, packet_t * packet);
+void collection_of_information_and_basic_payload_detection(ip_table_t * table, evaluation_list_t * list, void * ip_in_packet, packet_t * packet);
+
+/*!
+ * \brief Initialize list of IPs to evaluate
+ * \param[in] list list of IPs to evaluate.
+ * \param[in] key_size size of key of table.
+ */
+void evaluation_list_init(evaluation_list_t * list, unsigned int key_size);
+
+/*!
+ * \brief Add IP to list of IPs to evaluate
+ * \param[in] list list of IPs to evaluate.
+ * \param[in] key key of IP in table.
+ * \param[in] item IP address structure.
+ */
+void evaluation_list_add(evaluation_list_t * list, void * key, ip_address_t * item);
 
 
 /*!
@@ -339,24 +362,46 @@ int is_payload_on_ip_ok_response_tunnel(ip_address_t * item);
 /*!
  * \brief Detection function
  * One of main function on module.
- * Function tests every IP address on anomaly. When anomaly is founded it is written into file.
- * If there is no anomaly, the IP address is deleted from B+ tree.
- * \param[in] b_plus_tree pointer to B+ tree structure
- * \param[in] file pointer to file with results
+ * Function tests every IP address from the list on anomaly. When anomaly is founded it is written into file.
+ * IP addresses without anomaly and IP addresses which are not in the list (they did not exceed minimal counts)
+ * are deleted from the table.
+ * \param[in,out] table pointer to table of IP addresses
+ * \param[in,out] list list of IPs to evaluate
+ * \param[in] log log of the file with results, anomalies are written to it by its own thread (can be NULL)
  * \param[in] ur_notification structure with unirec output datas
  */
-void calculate_statistic_and_choose_anomaly(bpt_t * b_plus_tree, FILE *file, unirec_tunnel_notification_t * ur_notification);
+void calculate_statistic_and_choose_anomaly(ip_table_t * table, evaluation_list_t * list, async_log_t *log, unirec_tunnel_notification_t * ur_notification);
 
 /*!
- * \brief Print annomaly during detection
- * Function write info about anomaly to file, which is given in parametter.
- * It prits info about one IP address.
- * \param[in] ip_address ip address string
+ * \brief Clean table of IP addresses
+ * Function deletes suspicions of all IP addresses in the table and frees the table.
+ * \param[in] table pointer to table of IP addresses
+ */
+void clean_ip_table(ip_table_t * table);
+
+/*!
+ * \brief Build binary report of annomaly during detection
+ * Function copies info about anomaly of one IP address to the buffer, the text
+ * of the report is written by format_anomaly_report in the log writer thread.
+ * \param[in] ip_address ip address
  * \param[in] item ip address with anomaly
- * \param[in] file pointer to file with results
  * \param[in] print_time 1 - time is printed, 0 - time is not printed
+ * \param[out] buffer buffer for the report
+ * \param[in] size size of the buffer
+ * \return size of the report, 0 if there is no anomaly to report
+ */
+size_t build_anomaly_report(ip_addr_t * ip_address, ip_address_t *item, unsigned char print_time, char * buffer, size_t size);
+
+/*!
+ * \brief Print annomaly report to file
+ * Log writer callback, it prints the binary report built by build_anomaly_report.
+ * \param[in] file pointer to file with results
+ * \param[in] type type of log record
+ * \param[in] data binary report
+ * \param[in] size size of the report
+ * \param[in] arg unused
  */
-void print_founded_anomaly_immediately(char * ip_address, ip_address_t *item, FILE *file, unsigned char print_time);
+void format_anomaly_report(FILE * file, uint16_t type, const void * data, uint32_t size, void * arg);
 
 /*!
  * \brief Print annomaly on the end of module
@@ -403,30 +448,12 @@ void print_histogram_values (char *ip_address, ip_address_t *ip_item, FILE *file
  * \brief Write result function
  * Write information about all ip addresses to given folder
  * \param[in] record_folder_name folder with results
- * \param[in] b_plus_tree pointer to B+ tree structures
- * \param[in] count_of_btree count of tree structures (for ipv4, ipv6 ...)
+ * \param[in] tables pointer to tables of IP addresses
+ * \param[in] count_of_tables count of tables (for ipv4, ipv6 ...)
  */
-void write_detail_result(char * record_folder_name, bpt_t ** b_plus_tree, int count_of_btree);
+void write_detail_result(char * record_folder_name, ip_table_t ** tables, int count_of_tables);
 
 
-/*!
- * \brief Compare function for IPv6
- * Compare which ip is <, >, ==
- * \param[in] a first IP address
- * \param[in] b seccond IP address
- * \return if a<b LESS, a>b MORE, a==b EQUAL
- */
-int compare_ipv6(void * a, void * b);
-
-/*!
- * \brief Compare function for IPv4
- * Compare which ip is <, >, ==
- * \param[in] a first IP address
- * \param[in] b seccond IP address
- * \return if a<b LESS, a>b MORE, a==b EQUAL
- */
-int compare_ipv4(void * a, void * b);
-
 
 /*!
  * \brief Load default values
@@ -46,6 +46,7 @@
 
 
 #include <prefix_tree.h>
+#include "suspicion_store.h"
 
 
 //********* ip address record *********
@@ -85,7 +86,7 @@ typedef struct character_statistic_t{
  */
  typedef struct ip_address_suspision_request_other_t{
     unsigned char  state_request_size [HISTOGRAM_SIZE_REQUESTS]; /*!< state, for every size to store in prefix tree */
-    prefix_tree_t * other_suspision;    /*!< pointer to prefix tree */
+    suspicion_store_t * other_suspision;   /*!< pointer to storage of strings */
     unsigned int round_in_suspicion;    /*!< count of round in SUSPICTION state */
     time_t time_first;                  /*!< time of first anomaly flow */
     unsigned int sum_of_inserting;      /*!< Sum of inserting */
@@ -98,7 +99,7 @@ typedef struct character_statistic_t{
  */
  typedef struct ip_address_suspision_request_tunnel_t{
     unsigned char  state_request_size [HISTOGRAM_SIZE_REQUESTS]; /*!< state, for every size to store in prefix tree */
-    prefix_tree_t * tunnel_suspision;  /*!< pointer to prefix tree */
+    suspicion_store_t * tunnel_suspision;   /*!< pointer to storage of strings */
     unsigned int round_in_suspicion;   /*!< count of round in SUSPICTION state */
     time_t time_first;                 /*!< time of first anomaly flow */
     unsigned int sum_of_inserting;     /*< Sum of inserting */
@@ -113,7 +114,7 @@ typedef struct character_statistic_t{
  */
  typedef struct ip_address_suspision_response_other_t{
     unsigned char  state_response_size [HISTOGRAM_SIZE_RESPONSE]; /*!< state, for every size to store in prefix tree */
-    prefix_tree_t * other_suspision;   /*!< pointer to prefix tree */
+    suspicion_store_t * other_suspision;   /*!< pointer to storage of strings */
     unsigned int round_in_suspicion;   /*!< count of round in SUSPICTION state */
     unsigned int without_string;       /*!< count of response without request string */
     unsigned int packet_in_suspicion;  /*!< count of responses in suspicion */
@@ -139,11 +140,11 @@ typedef struct character_statistic_t{
  * Structure used to keep information about type detection response tunnel
  */
 typedef struct ip_address_suspision_response_tunnel_t{
-    prefix_tree_t * txt_suspision;      /*!< pointer to prefix tree */
-    prefix_tree_t * cname_suspision;    /*!< pointer to prefix tree */
-    prefix_tree_t * mx_suspision;       /*!< pointer to prefix tree */
-    prefix_tree_t * ns_suspision;       /*!< pointer to prefix tree */
-    prefix_tree_t * request_suspision;  /*!< pointer to prefix tree */
+    suspicion_store_t * txt_suspision;      /*!< pointer to storage of strings */
+    suspicion_store_t * cname_suspision;    /*!< pointer to storage of strings */
+    suspicion_store_t * mx_suspision;       /*!< pointer to storage of strings */
+    suspicion_store_t * ns_suspision;       /*!< pointer to storage of strings */
+    suspicion_store_t * request_suspision;  /*!< pointer to storage of strings */
     unsigned char state_type;           /*!< records to store */
     unsigned int round_in_suspicion;    /*!< count of round in SUSPICTION state */
     unsigned int sum_of_inserting_request;/*!< Sum of inserting */
@@ -166,7 +167,7 @@ typedef struct ip_address_suspision_response_tunnel_t{
 
 /*!
  * \name Version of IP address
- *  Defines macros used in B+ tree and printing IP.
+ *  Defines macros used in tables of IP addresses and printing IP.
  * \{ */
 #define IP_VERSION_4 4
 #define IP_VERSION_6 6
@@ -231,8 +232,21 @@ typedef struct ip_address_suspision_response_tunnel_t{
     unsigned char state_request_tunnel; /*!< state of finding tunnel in requests */
     unsigned char state_response_other; /*!< state of finding other anomaly in response */
     unsigned char state_response_tunnel;/*!< state of finding tunnel in response */
+    unsigned char in_evaluation;        /*!< IP is in the list of IPs to evaluate */
 } ip_address_t;
 
+/*!
+ * \brief Structure - list of IP addresses to evaluate
+ * Structure used to keep keys of IP addresses, which exceeded minimal counts of requests or responses
+ * or which are in suspicion. Just these IP addresses are evaluated, the others are removed from the table.
+ */
+typedef struct evaluation_list_t{
+    unsigned char * keys;         /*!< keys of IP addresses in the table */
+    unsigned int count;           /*!< count of keys */
+    unsigned int size;            /*!< count of allocated keys */
+    unsigned int key_size;        /*!< size of one key */
+} evaluation_list_t;
+
 /*!
  * \brief Structure containing calculated inforamtion about IP address
  * Structure used to keep information about IP address
@@ -330,6 +344,8 @@ typedef struct values_t{
     unsigned int sdm_timeout;   /*< Timeout, after that the rule will be discard from SDM */
     unsigned int sdm_count_of_packets;  /*< Count of packet which will be recorded by SDM */
     char *file_name_event_id; /*< Path to file with event id*/
+    unsigned char suspicion_sketch; /*< Keep strings of suspicions in sketch instead of prefix tree */
+    unsigned int count_of_workers; /*< Count of worker threads, 0 to process packets by the receiving thread */
 }values_t;
 
 //********* values for measuring parameters *********
@@ -391,4 +407,60 @@ typedef struct unirec_tunnel_notification_t{
     unsigned int    event_id;  /*< Event ID */
 }unirec_tunnel_notification_t;
 
+/*!
+ * \brief Sections of a binary anomaly report
+ * Kinds of found anomalies in the order they are printed to the log.
+ */
+enum anomaly_report_kind_e {
+   REPORT_REQUEST_TUNNEL,
+   REPORT_REQUEST_OTHER,
+   REPORT_REQUEST_MALFORMED,
+   REPORT_RESPONSE_REQUEST_STRING,
+   REPORT_RESPONSE_TXT,
+   REPORT_RESPONSE_CNAME,
+   REPORT_RESPONSE_NS,
+   REPORT_RESPONSE_MX,
+   REPORT_RESPONSE_OTHER
+};
+
+#define ANOMALY_REPORT_RECORD 1 /*< Type of log record with a binary anomaly report. */
+#define ANOMALY_REPORT_MAX_SIZE 16384 /*< Maximal size of a binary anomaly report. */
+#define ANOMALY_REPORT_DOMAINS 5 /*< Count of top domains in a section of a report. */
+#define ANOMALY_REPORT_DOMAIN 255 /*< Maximal length of a domain in a report, longer are cut. */
+
+/*!
+ * \brief Structure - header of a binary anomaly report
+ * Numbers copied from the IP address by the evaluating thread, the log writer
+ * thread formats them. Sections follow the header.
+ */
+typedef struct anomaly_report_header_t{
+    int64_t     time; /*< clock of the evaluating thread */
+    ip_addr_t   ip; /*< ip address with anomaly */
+    uint32_t    sections; /*< count of sections */
+    uint8_t     print_time; /*< time is printed before the ip address */
+}anomaly_report_header_t;
+
+/*!
+ * \brief Structure - section of a binary anomaly report
+ * One found anomaly of the IP address, its top domains follow the section.
+ */
+typedef struct anomaly_report_section_t{
+    uint8_t     kind; /*< anomaly_report_kind_e */
+    uint8_t     domains; /*< count of domains following the section */
+    uint32_t    event_id; /*< Event ID */
+    uint32_t    malformed; /*< count of malformed requests */
+    uint32_t    sizes; /*< bits of request sizes (by 10 B) in attack */
+    int64_t     count; /*< count of recorded requests or responses */
+    double      values[3]; /*< ratios printed for the anomaly */
+}anomaly_report_section_t;
+
+/*!
+ * \brief Structure - domain in a binary anomaly report
+ * Characters of the domain (not terminated) follow the structure.
+ */
+typedef struct anomaly_report_domain_t{
+    int32_t     count; /*< count of inserting of the domain */
+    uint16_t    length; /*< length of the domain */
+}anomaly_report_domain_t;
+
 #endif /* _TUNNEL_DETECTION_DNS_STRUCTS_ */
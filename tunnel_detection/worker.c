@@ -0,0 +1,270 @@
+/*!
+ * \file worker.c
+ * \brief Worker threads of the DNS tunnel detection, each of them owns a subset of IP addresses.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include "tunnel_detection_dns.h"
+#include "worker.h"
+#include "affinity.h"
+
+static worker_msg_t * worker_reserve(worker_t * worker)
+{
+   uint32_t tail;
+   while (1) {
+      tail = __atomic_load_n(&worker->tail, __ATOMIC_ACQUIRE);
+      if (worker->head - tail != WORKER_QUEUE_SIZE) {
+         return &worker->queue[worker->head & (WORKER_QUEUE_SIZE - 1)];
+      }
+      usleep(WORKER_IDLE_SLEEP);
+   }
+}
+
+static void worker_push(worker_t * worker)
+{
+   __atomic_store_n(&worker->head, worker->head + 1, __ATOMIC_RELEASE);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   if (__atomic_load_n(&worker->sleeping, __ATOMIC_RELAXED)) {
+      pthread_mutex_lock(&worker->lock);
+      pthread_cond_signal(&worker->wake);
+      pthread_mutex_unlock(&worker->lock);
+   }
+}
+
+static int worker_empty(worker_t * worker)
+{
+   return __atomic_load_n(&worker->head, __ATOMIC_ACQUIRE) == worker->tail;
+}
+
+static void worker_wait(worker_t * worker)
+{
+   int i;
+   for (i = 0; i < WORKER_SPIN; i++) {
+      if (!worker_empty(worker)) {
+         return;
+      }
+      sched_yield();
+   }
+   pthread_mutex_lock(&worker->lock);
+   __atomic_store_n(&worker->sleeping, 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   while (worker_empty(worker)) {
+      pthread_cond_wait(&worker->wake, &worker->lock);
+   }
+   __atomic_store_n(&worker->sleeping, 0, __ATOMIC_RELAXED);
+   pthread_mutex_unlock(&worker->lock);
+}
+
+static void worker_evaluate(worker_t * worker)
+{
+   unsigned long before, after;
+   before = worker->table[0]->count + worker->table[1]->count;
+   calculate_statistic_and_choose_anomaly(worker->table[0], &worker->evaluation[0], worker->result_log, &worker->notification);
+   calculate_statistic_and_choose_anomaly(worker->table[1], &worker->evaluation[1], worker->result_log, &worker->notification);
+   after = worker->table[0]->count + worker->table[1]->count;
+   printf("\tworker %u: count of ip's before_erase %lu, after_erase %lu\n", worker->id, before, after);
+}
+
+static void * worker_run(void * arg)
+{
+   worker_t * worker = (worker_t*)arg;
+   worker_msg_t * msg;
+   packet_t * packet;
+   int i;
+   //tables were initialized by the receiving thread, move them to the node of the worker (grown tables are local anyway)
+   for (i = 0; i < 2; i++) {
+      affinity_bind_local(worker->table[i]->tags, worker->table[i]->size + IP_TABLE_GROUP);
+      affinity_bind_local(worker->table[i]->slots, (size_t)worker->table[i]->size * worker->table[i]->slot_size);
+   }
+   while (1) {
+      if (worker_empty(worker)) {
+         worker_wait(worker);
+      }
+      msg = &worker->queue[worker->tail & (WORKER_QUEUE_SIZE - 1)];
+      if (msg->type == WORKER_MSG_STOP) {
+         __atomic_store_n(&worker->tail, worker->tail + 1, __ATOMIC_RELEASE);
+         break;
+      }
+      packet = &msg->packet;
+      //every thread has its own clock, moved by the packets of the thread
+      update_current_time((time_t)packet->time);
+      if (msg->type == WORKER_MSG_EVALUATE) {
+         worker_evaluate(worker);
+      }
+      else if (packet->is_response == 0) {
+         if (packet->ip_version == IP_VERSION_4) {
+            collection_of_information_and_basic_payload_detection(worker->table[0], &worker->evaluation[0], &packet->src_ip_v4, packet);
+         }
+         else {
+            collection_of_information_and_basic_payload_detection(worker->table[1], &worker->evaluation[1], packet->src_ip_v6, packet);
+         }
+      }
+      else {
+         if (packet->ip_version == IP_VERSION_4) {
+            collection_of_information_and_basic_payload_detection(worker->table[0], &worker->evaluation[0], &packet->dst_ip_v4, packet);
+         }
+         else {
+            collection_of_information_and_basic_payload_detection(worker->table[1], &worker->evaluation[1], packet->dst_ip_v6, packet);
+         }
+      }
+      __atomic_store_n(&worker->tail, worker->tail + 1, __ATOMIC_RELEASE);
+   }
+   return NULL;
+}
+
+int worker_start(worker_t * worker, unsigned int id, async_log_t * result_log, unirec_tunnel_notification_t * notification)
+{
+   memset(worker, 0, sizeof(worker_t));
+   pthread_mutex_init(&worker->lock, NULL);
+   pthread_cond_init(&worker->wake, NULL);
+   worker->id = id;
+   worker->result_log = result_log;
+   worker->notification.unirec_out = notification->unirec_out;
+   worker->notification.unirec_out_sdm = notification->unirec_out_sdm;
+   worker->queue = (worker_msg_t*)malloc(WORKER_QUEUE_SIZE * sizeof(worker_msg_t));
+   worker->table[0] = ip_table_init(IP_TABLE_INITIAL_SIZE, sizeof(uint32_t), sizeof(ip_address_t));
+   worker->table[1] = ip_table_init(IP_TABLE_INITIAL_SIZE, sizeof(uint64_t)*2, sizeof(ip_address_t));
+   if (worker->queue == NULL || worker->table[0] == NULL || worker->table[1] == NULL) {
+      fprintf(stderr, "Error: Worker %u could not be allocated.\n", id);
+      worker_destroy(worker);
+      return 1;
+   }
+   evaluation_list_init(&worker->evaluation[0], sizeof(uint32_t));
+   evaluation_list_init(&worker->evaluation[1], sizeof(uint64_t)*2);
+   //workers send alerts concurrently, each of them fills its own records
+   if (worker->notification.unirec_out != NULL) {
+      worker->notification.detection = ur_create_record(worker->notification.unirec_out, MAX_LENGTH_OF_REQUEST_DOMAIN);
+      if (worker->notification.detection == NULL) {
+         fprintf(stderr, "Error: No memory available for detection record of worker %u.\n", id);
+         worker_destroy(worker);
+         return 1;
+      }
+   }
+   if (worker->notification.unirec_out_sdm != NULL) {
+      worker->notification.detection_sdm = ur_create_record(worker->notification.unirec_out_sdm, MAX_LENGTH_SDM_CAPTURE_FILE_ID);
+      if (worker->notification.detection_sdm == NULL) {
+         fprintf(stderr, "Error: No memory available for detection record of worker %u.\n", id);
+         worker_destroy(worker);
+         return 1;
+      }
+   }
+   if (affinity_thread_create(&worker->thread, &worker_run, worker) != 0) {
+      fprintf(stderr, "Error: Thread of worker %u could not be created.\n", id);
+      worker_destroy(worker);
+      return 1;
+   }
+   worker->running = 1;
+   return 0;
+}
+
+void worker_push_packet(worker_t * worker, packet_t * packet)
+{
+   worker_msg_t * msg = worker_reserve(worker);
+   msg->type = WORKER_MSG_PACKET;
+   memcpy(&msg->packet, packet, sizeof(packet_t));
+   worker_push(worker);
+}
+
+void worker_push_evaluation(worker_t * worker, time_t time)
+{
+   worker_msg_t * msg = worker_reserve(worker);
+   msg->type = WORKER_MSG_EVALUATE;
+   msg->packet.time = (double)time;
+   worker_push(worker);
+}
+
+void worker_stop(worker_t * worker)
+{
+   worker_msg_t * msg;
+   if (!worker->running) {
+      return;
+   }
+   msg = worker_reserve(worker);
+   msg->type = WORKER_MSG_STOP;
+   worker_push(worker);
+   pthread_join(worker->thread, NULL);
+   worker->running = 0;
+}
+
+void worker_destroy(worker_t * worker)
+{
+   int i;
+   for (i = 0; i < 2; i++) {
+      if (worker->table[i] != NULL) {
+         clean_ip_table(worker->table[i]);
+         worker->table[i] = NULL;
+      }
+      free(worker->evaluation[i].keys);
+      worker->evaluation[i].keys = NULL;
+   }
+   if (worker->notification.detection != NULL) {
+      ur_free_record(worker->notification.detection);
+      worker->notification.detection = NULL;
+   }
+   if (worker->notification.detection_sdm != NULL) {
+      ur_free_record(worker->notification.detection_sdm);
+      worker->notification.detection_sdm = NULL;
+   }
+   free(worker->queue);
+   worker->queue = NULL;
+   pthread_cond_destroy(&worker->wake);
+   pthread_mutex_destroy(&worker->lock);
+}
+
+unsigned int worker_shard(packet_t * packet, unsigned int count)
+{
+   uint32_t hash;
+   if (packet->ip_version == IP_VERSION_4) {
+      hash = (uint32_t)(packet->is_response ? packet->dst_ip_v4 : packet->src_ip_v4);
+   }
+   else {
+      uint64_t * ip = packet->is_response ? packet->dst_ip_v6 : packet->src_ip_v6;
+      hash = (uint32_t)(ip[0] ^ (ip[0] >> 32) ^ ip[1] ^ (ip[1] >> 32));
+   }
+   hash ^= hash >> 16;
+   hash *= 0x85ebca6b;
+   hash ^= hash >> 13;
+   hash *= 0xc2b2ae35;
+   hash ^= hash >> 16;
+   return hash % count;
+}
@@ -0,0 +1,155 @@
+/*!
+ * \file worker.h
+ * \brief Worker threads of the DNS tunnel detection, each of them owns a subset of IP addresses.
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef _TUNNEL_DETECTION_WORKER_
+#define _TUNNEL_DETECTION_WORKER_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "ip_table.h"
+#include "async_log.h"
+#include "tunnel_detection_dns_structs.h"
+
+/*!
+ * \name Worker setting
+ * \{ */
+#define WORKER_QUEUE_SIZE 1024   /*< Count of messages in the queue of one worker, must be a power of 2 */
+#define WORKER_IDLE_SLEEP 50     /*< Microseconds to sleep when the queue of a worker is full */
+#define WORKER_SPIN 64           /*< Polls of an empty queue before the worker waits for a message */
+/* /} */
+
+/*!
+ * \name Types of worker messages
+ * \{ */
+#define WORKER_MSG_PACKET 0      /*< Message carrying a packet */
+#define WORKER_MSG_EVALUATE 1    /*< End of collecting session, the IPs have to be evaluated */
+#define WORKER_MSG_STOP 2        /*< No more messages */
+/* /} */
+
+/*!
+ * \brief Structure - message for worker
+ * Structure used to pass a packet or a command from the receiving thread to a worker.
+ * Time of the evaluation is passed in packet.time.
+ */
+typedef struct worker_msg_t {
+   unsigned char type;  /*< type of message */
+   packet_t packet;     /*< copy of packet */
+} worker_msg_t;
+
+/*!
+ * \brief Structure - worker
+ * Structure used to keep information about one worker thread with its own tables
+ * of IP addresses and lists of IP addresses to evaluate. Queue of messages has
+ * a single producer (the receiving thread) and a single consumer (the worker).
+ * An idle worker waits on a condition variable. It sets sleeping before checking
+ * the queue again and the producer checks it after the publication, both with a
+ * full fence in between, so either the worker sees the message or it is woken up.
+ */
+typedef struct worker_t {
+   pthread_t thread;                      /*< thread of worker */
+   unsigned int id;                       /*< number of worker */
+   unsigned char running;                 /*< thread was started */
+   worker_msg_t * queue;                  /*< ring of messages */
+   uint32_t head;                         /*< written by the receiving thread only */
+   char pad[64];                          /*< keeps head and tail in different cache lines */
+   uint32_t tail;                         /*< written by the worker only */
+   int sleeping;                          /*< worker waits on wake */
+   pthread_mutex_t lock;                  /*< lock of wake */
+   pthread_cond_t wake;                   /*< signaled by the receiving thread */
+   ip_table_t * table[2];                 /*< tables of IPv4 and IPv6 addresses */
+   evaluation_list_t evaluation[2];       /*< lists of IPv4 and IPv6 addresses to evaluate */
+   unirec_tunnel_notification_t notification; /*< own output records, templates are shared */
+   async_log_t * result_log;              /*< shared log of the file with anomalies, can be NULL */
+} worker_t;
+
+/*!
+ * \brief Start worker
+ * Function initializes tables, queue and output records of worker and starts its thread.
+ * \param[in] worker pointer to worker.
+ * \param[in] id number of worker.
+ * \param[in] result_log log of the file with anomalies, can be NULL.
+ * \param[in] notification notification of the module, its templates are used by worker.
+ * \return 0 on success, 1 on error.
+ */
+int worker_start(worker_t * worker, unsigned int id, async_log_t * result_log, unirec_tunnel_notification_t * notification);
+
+/*!
+ * \brief Pass packet to worker
+ * Function copies packet to the queue of worker, it waits when the queue is full.
+ * \param[in] worker pointer to worker.
+ * \param[in] packet pointer to packet.
+ */
+void worker_push_packet(worker_t * worker, packet_t * packet);
+
+/*!
+ * \brief Finish collecting session of worker
+ * Function tells worker to evaluate its IP addresses.
+ * \param[in] worker pointer to worker.
+ * \param[in] time current time of the module.
+ */
+void worker_push_evaluation(worker_t * worker, time_t time);
+
+/*!
+ * \brief Stop worker
+ * Function waits till worker processes all the messages in its queue and its thread ends.
+ * \param[in] worker pointer to worker.
+ */
+void worker_stop(worker_t * worker);
+
+/*!
+ * \brief Destroy worker
+ * Function frees all memory of stopped worker including its tables.
+ * \param[in] worker pointer to worker.
+ */
+void worker_destroy(worker_t * worker);
+
+/*!
+ * \brief Select worker for packet
+ * Function hashes IP address of the client (source of request, destination of response).
+ * \param[in] packet pointer to packet.
+ * \param[in] count count of workers.
+ * \return index of worker.
+ */
+unsigned int worker_shard(packet_t * packet, unsigned int count);
+
+#endif /* _TUNNEL_DETECTION_WORKER_ */
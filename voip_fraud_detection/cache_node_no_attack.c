@@ -41,28 +41,53 @@
  *
  */
 
+#include <stdint.h>
+#include <string.h>
 #include "cache_node_no_attack.h"
 
 
 // initialize size of cache_node_no_attack
 int cache_node_no_attack_size = 0;
 
-prefix_tree_inner_node_t * cache_node_no_attack_data[MAX_CACHE_NO_ATTACK_SIZE];
+// slots with other generation than actual one are empty
+unsigned int cache_node_no_attack_generation = 1;
+
+cache_node_no_attack_item_t cache_node_no_attack_data[CACHE_NO_ATTACK_TABLE_SIZE];
+
+// Index of the first slot for node in hash set
+
+static inline unsigned int cache_node_no_attack_index(prefix_tree_inner_node_t * node)
+{
+   uint64_t hash = (uint64_t) (uintptr_t) node;
+   hash ^= hash >> 33;
+   hash *= 0xff51afd7ed558ccdULL;
+   hash ^= hash >> 33;
+   return (unsigned int) hash & (CACHE_NO_ATTACK_TABLE_SIZE - 1);
+}
+
+// Find if the node itself is in cache
+
+static inline int cache_node_no_attack_contains(prefix_tree_inner_node_t * node)
+{
+   unsigned int i = cache_node_no_attack_index(node);
+
+   while (cache_node_no_attack_data[i].generation == cache_node_no_attack_generation) {
+      if (cache_node_no_attack_data[i].node == node) return 1;
+      i = (i + 1) & (CACHE_NO_ATTACK_TABLE_SIZE - 1);
+   }
+
+   return 0;
+}
 
 // Find if node is verified for no attack by cache
 // Return 1 if node exists in cache, 0 otherwise
 
 int cache_node_no_attack_exists(prefix_tree_inner_node_t * node)
 {
-   if (node != NULL) {
-      // try to find node in cache
-      int i;
-      for (i = 0; i < cache_node_no_attack_size; i++) {
-         if (cache_node_no_attack_data[i] == node) return 1;
-      }
-
-      // try to find predecessor of node in cache
-      return cache_node_no_attack_exists(node->parent);
+   // try to find node or predecessor of node in cache
+   while (node != NULL) {
+      if (cache_node_no_attack_contains(node)) return 1;
+      node = node->parent;
    }
 
    // node not found => return 0
@@ -73,39 +98,23 @@ int cache_node_no_attack_exists(prefix_tree_inner_node_t * node)
 
 void cache_node_no_attack_save(prefix_tree_inner_node_t * node)
 {
-   static int full_index = 0;
-
-   // clear successors of the node in cache
-   int i;
-   prefix_tree_inner_node_t * predecessor_node;
-
-   for (i = 0; i < cache_node_no_attack_size; i++) {
-      predecessor_node = cache_node_no_attack_data[i]->parent;
-
-      while (predecessor_node != NULL) {
-         if (predecessor_node == node) {
+   // successors of the node stay in cache, they are covered by the node anyway
+   if (cache_node_no_attack_size >= MAX_CACHE_NO_ATTACK_SIZE) {
+      // cache is full, node will be examined again
+      return;
+   }
 
-            // delete cache_no_attack_data[i] from cache
-            cache_node_no_attack_size--;
-            if (cache_node_no_attack_size > 0) {
-               cache_node_no_attack_data[i] = cache_node_no_attack_data[cache_node_no_attack_size];
-            }
-         }
-         predecessor_node = predecessor_node->parent;
-      }
+   unsigned int i = cache_node_no_attack_index(node);
 
+   while (cache_node_no_attack_data[i].generation == cache_node_no_attack_generation) {
+      if (cache_node_no_attack_data[i].node == node) return;
+      i = (i + 1) & (CACHE_NO_ATTACK_TABLE_SIZE - 1);
    }
 
    // save the node to cache
-   if (cache_node_no_attack_size >= MAX_CACHE_NO_ATTACK_SIZE) {
-      cache_node_no_attack_data[full_index] = node;
-      full_index++;
-      if (full_index >= MAX_CACHE_NO_ATTACK_SIZE) full_index = 0;
-   } else {
-      cache_node_no_attack_data[cache_node_no_attack_size] = node;
-      cache_node_no_attack_size++;
-   }
-
+   cache_node_no_attack_data[i].node = node;
+   cache_node_no_attack_data[i].generation = cache_node_no_attack_generation;
+   cache_node_no_attack_size++;
 }
 
 // Clear cache
@@ -113,4 +122,11 @@ void cache_node_no_attack_save(prefix_tree_inner_node_t * node)
 void cache_node_no_attack_clear()
 {
    cache_node_no_attack_size = 0;
+   cache_node_no_attack_generation++;
+
+   // generation overflowed, slots of old generations have to be really cleared
+   if (cache_node_no_attack_generation == 0) {
+      memset(cache_node_no_attack_data, 0, sizeof (cache_node_no_attack_data));
+      cache_node_no_attack_generation = 1;
+   }
 }
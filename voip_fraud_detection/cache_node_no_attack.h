@@ -48,13 +48,22 @@
 #include "configuration.h"
 
 
+/** \brief Slot of cache_node_no_attack hash set. */
+typedef struct cache_node_no_attack_item {
+   prefix_tree_inner_node_t * node; ///< cached node
+   unsigned int generation; ///< generation of cache, in which the node was saved (slot is empty in other generations)
+} cache_node_no_attack_item_t;
+
 /** \brief Storage of cache_node_no_attack (extern). */
-extern prefix_tree_inner_node_t * cache_node_no_attack_data[MAX_CACHE_NO_ATTACK_SIZE];
+extern cache_node_no_attack_item_t cache_node_no_attack_data[CACHE_NO_ATTACK_TABLE_SIZE];
 
 /** \brief Size of cache_node_no_attack (extern). */
 extern int cache_node_no_attack_size;
 
-/** \brief Find if node is verified for no attack by cache.
+/** \brief Actual generation of cache_node_no_attack (extern). */
+extern unsigned int cache_node_no_attack_generation;
+
+/** \brief Find if node or some of its predecessors is verified for no attack by cache.
  * \param[in] node prefix_tree_inner_node_t* for finding in cache.
  * \return Return 1 if node exists in cache, 0 otherwise.
  */
@@ -65,7 +74,7 @@ int cache_node_no_attack_exists(prefix_tree_inner_node_t * node);
  */
 void cache_node_no_attack_save(prefix_tree_inner_node_t * node);
 
-/** \brief Clear cache_node_no_attack. */
+/** \brief Clear cache_node_no_attack, only the generation of cache is incremented. */
 void cache_node_no_attack_clear();
 
 #endif	/* VOIP_FRAUD_DETECTION_CACHE_NODE_NO_ATTACK_H */
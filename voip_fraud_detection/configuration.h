@@ -80,9 +80,30 @@
 /** \brief Interval defined in seconds for running check_and_clear_module_memory() function. */
 #define CHECK_MEMORY_INTERVAL 60
 
+/** \brief Number of hash table slots checked by check_and_free_module_memory() per received record. */
+#define CHECK_MEMORY_SLOTS_PER_RECORD 64
+
 /** \brief Interval defined in seconds for saving countries to defined countries file (0 = disable autosaving = save only when module exits). */
 #define COUNTRIES_FILE_SAVING_INTERVAL 3600
 
+/** \brief Number of items of GeoIP lookup cache (power of 2). */
+#define GEOIP_CACHE_SIZE 8192
+
+/** \brief Maximum length of domain part of called party saved in GeoIP lookup cache (longer ones are not cached). */
+#define GEOIP_CACHE_MAX_DOMAIN_LENGTH 47
+
+/** \brief Time in seconds for which GeoIP lookup is cached. */
+#define GEOIP_CACHE_TTL 3600
+
+/** \brief Magic at the beginning of countries file in binary format. */
+#define COUNTRIES_BINARY_FILE_MAGIC "VFDCNTRY"
+
+/** \brief Length of COUNTRIES_BINARY_FILE_MAGIC. */
+#define COUNTRIES_BINARY_FILE_MAGIC_LENGTH 8
+
+/** \brief Version of countries file in binary format. */
+#define COUNTRIES_BINARY_FILE_VERSION 1
+
 /** \brief Default value of max_prefix_length.
  * If parameter max_prefix_length is not set at startup of module then this default value is used. */
 #define DEFAULT_MAX_PREFIX_LENGTH 10
@@ -139,11 +160,20 @@
 /** \brief Maximum number of Call-ID item in storage. */
 #define MAX_CALL_ID_STORAGE_SIZE 100
 
+/** \brief Number of slots of Call-ID hash set in node data (power of 2, at least twice MAX_CALL_ID_STORAGE_SIZE, at most 256). */
+#define CALL_ID_SET_SIZE 256
+
 /** \brief Maximum string length of node in prefix tree. */
 #define MAX_STRING_PREFIX_TREE_NODE 100
 
 /** \brief Maximum size of cache_no_attack. */
-#define MAX_CACHE_NO_ATTACK_SIZE 100
+#define MAX_CACHE_NO_ATTACK_SIZE 4096
+
+/** \brief Number of slots of cache_no_attack hash set (power of 2, at least twice MAX_CACHE_NO_ATTACK_SIZE). */
+#define CACHE_NO_ATTACK_TABLE_SIZE 8192
+
+/** \brief Maximum number of SIP_TO saved between two checks of prefix examination, whole suffix tree is examined after more inserts. */
+#define MAX_INSERTED_SIP_TO 65536
 
 /** \brief Maximum length of line ALLOWED_COUNTRIES in countries file. */
 #define MAX_LENGTH_ALLOWED_COUNTRIES_LINE 300
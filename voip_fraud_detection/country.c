@@ -42,6 +42,8 @@
  */
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
 
 #include "country.h"
 #include "voip_fraud_detection.h"
@@ -49,6 +51,14 @@
 
 #ifdef ENABLE_GEOIP
 
+/** \brief Thread saving countries file in background. */
+static countries_writer_t countries_writer;
+
+/** \brief Cache of GeoIP lookups (direct mapped by hash of domain part). */
+static geoip_cache_item_t geoip_cache[GEOIP_CACHE_SIZE];
+
+static void countries_snapshot_save(cc_hash_table_v2_t * hash_table_ip);
+
 // Load GeoIP databases to memory
 
 void geoip_databases_load()
@@ -121,8 +131,7 @@ void country_ip_save(ip_item_t * ip, const char * country, cc_hash_table_v2_t *
 
    // check if countries file saving interval was expired
    if (COUNTRIES_FILE_SAVING_INTERVAL != 0 && (current_time - time_last_countries_file_saved) >= COUNTRIES_FILE_SAVING_INTERVAL) {
-      countries_save_all_to_file(modul_configuration.countries_file, hash_table_ip);
-      time_last_countries_file_saved = current_time;
+      countries_snapshot_save(hash_table_ip);
    }
 
 }
@@ -135,6 +144,100 @@ void countries_power_off_learning_mode(int signum)
    PRINT_OUT_LOG("Info: Learning countries mode was finished, starting detection of calling to different countries ...\n");
 }
 
+// Create item of IP address loaded from countries file and insert it into hash table
+
+static ip_item_t * countries_ip_item_create(cc_hash_table_v2_t * hash_table_ip, ip_addr_t * ip_address)
+{
+   ip_item_t * hash_table_item;
+
+   // create new item for hash table
+   hash_table_item = (ip_item_t *) malloc(sizeof (ip_item_t));
+
+   // check successful allocation memory
+   if (hash_table_item == NULL) {
+      PRINT_ERR("load_all_countries_from_file: hash_table_item: Error memory allocation\n");
+      return NULL;
+   }
+
+   //  initialize hash_table_item (and check for errors)
+   if (hash_table_item_initialize(hash_table_item) == -1) {
+      free(hash_table_item);
+      return NULL;
+   }
+
+   // insert item (pointer) into hash table
+   ip_item_t * kicked_hash_table_item;
+   if ((kicked_hash_table_item = (ip_item_t *) ht_insert_v2(hash_table_ip, (char *) ip_address->bytes, (void *) &hash_table_item)) != NULL) {
+      // free memory of kicked item from hash table
+      hash_table_item_free_inner_memory(*(ip_item_t **) kicked_hash_table_item);
+      free(*(ip_item_t **) kicked_hash_table_item);
+      kicked_hash_table_item = NULL;
+#ifdef DEBUG
+      PRINT_OUT("load_all_countries_from_file: Hash table reaches size limit\n");
+#endif
+   }
+
+   return hash_table_item;
+}
+
+// Load all countries from stream in binary format (after magic) to memory
+
+static int countries_load_binary(FILE * io_countries_file, cc_hash_table_v2_t * hash_table_ip)
+{
+   uint32_t version, allowed_countries_count, count, item_id;
+   uint8_t country_count;
+   ip_addr_t ip_address;
+   ip_item_t * hash_table_item;
+
+   // check version of format
+   if (fread(&version, sizeof (uint32_t), 1, io_countries_file) != 1 || version != COUNTRIES_BINARY_FILE_VERSION) {
+      return -1;
+   }
+
+   // load allowed countries to memory
+   if (fread(&allowed_countries_count, sizeof (uint32_t), 1, io_countries_file) != 1 || modul_configuration.allowed_countries_count != 0) {
+      return -1;
+   }
+
+   if (allowed_countries_count > 0) {
+      modul_configuration.allowed_countries = (char *) calloc(allowed_countries_count + 1, sizeof (char) * 2);
+      if (modul_configuration.allowed_countries == NULL) {
+         PRINT_ERR("load_all_countries_from_file: allowed_countries: Error memory allocation\n");
+         return -1;
+      }
+
+      if (fread(modul_configuration.allowed_countries, sizeof (char) * 2, allowed_countries_count, io_countries_file) != allowed_countries_count) {
+         return -1;
+      }
+      modul_configuration.allowed_countries_count = allowed_countries_count;
+   }
+
+   // load countries of individual IP addresses
+   if (fread(&count, sizeof (uint32_t), 1, io_countries_file) != 1) {
+      return -1;
+   }
+
+   for (item_id = 0; item_id < count; item_id++) {
+      if (fread(&ip_address, sizeof (ip_addr_t), 1, io_countries_file) != 1 \
+            || fread(&country_count, sizeof (uint8_t), 1, io_countries_file) != 1 \
+            || country_count > COUNTRY_STORAGE_SIZE) {
+         return -1;
+      }
+
+      hash_table_item = countries_ip_item_create(hash_table_ip, &ip_address);
+      if (hash_table_item == NULL) {
+         return -1;
+      }
+
+      if (fread(hash_table_item->country, sizeof (char) * 2, country_count, io_countries_file) != country_count) {
+         return -1;
+      }
+      hash_table_item->country_count = country_count;
+   }
+
+   return 0;
+}
+
 // Load all countries from defined file to memory
 
 int countries_load_all_from_file(char * file, cc_hash_table_v2_t * hash_table_ip)
@@ -149,6 +252,16 @@ int countries_load_all_from_file(char * file, cc_hash_table_v2_t * hash_table_ip
          return 0;
       }
 
+      // check if countries file is in binary format (saved with countries_binary parameter)
+      char magic[COUNTRIES_BINARY_FILE_MAGIC_LENGTH];
+      if (fread(magic, 1, COUNTRIES_BINARY_FILE_MAGIC_LENGTH, io_countries_file) == COUNTRIES_BINARY_FILE_MAGIC_LENGTH \
+            && memcmp(magic, COUNTRIES_BINARY_FILE_MAGIC, COUNTRIES_BINARY_FILE_MAGIC_LENGTH) == 0) {
+         int return_code = countries_load_binary(io_countries_file, hash_table_ip);
+         fclose(io_countries_file);
+         return return_code;
+      }
+      rewind(io_countries_file);
+
       ip_item_t * hash_table_item, * last_hash_table_item;
       ip_addr_t ip_address;
       char ip_address_str [INET6_ADDRSTRLEN + 1];
@@ -290,33 +403,12 @@ int countries_load_all_from_file(char * file, cc_hash_table_v2_t * hash_table_ip
                }
 
                // create new item for hash table
-               hash_table_item = (ip_item_t *) malloc(sizeof (ip_item_t));
-
-               // check successful allocation memory
+               hash_table_item = countries_ip_item_create(hash_table_ip, &ip_address);
                if (hash_table_item == NULL) {
-                  PRINT_ERR("load_all_countries_from_file: hash_table_item: Error memory allocation\n");
-                  fclose(io_countries_file);
-                  return -1;
-               }
-
-               //  initialize hash_table_item (and check for errors)
-               if (hash_table_item_initialize(hash_table_item) == -1) {
                   fclose(io_countries_file);
                   return -1;
                }
 
-               // insert item (pointer) into hash table
-               ip_item_t * kicked_hash_table_item;
-               if ((kicked_hash_table_item = (ip_item_t *) ht_insert_v2(hash_table_ip, (char *) ip_address.bytes, (void *) &hash_table_item)) != NULL) {
-                  // free memory of kicked item from hash table
-                  hash_table_item_free_inner_memory(*(ip_item_t **) kicked_hash_table_item);
-                  free(*(ip_item_t **) kicked_hash_table_item);
-                  kicked_hash_table_item = NULL;
-#ifdef DEBUG
-                  PRINT_OUT("load_all_countries_from_file: Hash table reaches size limit\n");
-#endif
-               }
-
                // save indication of IP address settings
                last_hash_table_item = hash_table_item;
 
@@ -344,70 +436,281 @@ int countries_load_all_from_file(char * file, cc_hash_table_v2_t * hash_table_ip
    return 0;
 }
 
-// Save all countries from memory to defined file
+// Copy countries of all IP addresses from hash table to snapshot
 
-void countries_save_all_to_file(char * file, cc_hash_table_v2_t * hash_table_ip)
+static int countries_snapshot_fill(countries_snapshot_t * snapshot, cc_hash_table_v2_t * hash_table_ip)
 {
-   if (file != NULL) {
-      FILE * io_countries_file;
+   ip_item_t * hash_table_item;
+   int table_id;
 
-      // open file (write, text mode)
-      io_countries_file = fopen(file, "wt");
-      if (io_countries_file == NULL) {
-         PRINT_ERR("Error open country file for writing: \"", file, "\"\n");
-         return;
+   snapshot->count = 0;
+   snapshot->save_time = current_time;
+
+   // allowed countries are loaded only at startup of module and don't change
+   snapshot->allowed_countries = modul_configuration.allowed_countries;
+   snapshot->allowed_countries_count = modul_configuration.allowed_countries_count;
+
+   for (table_id = 0; table_id < hash_table_ip->table_size; table_id++) {
+
+      if (hash_table_ip->ind[table_id].valid) {
+
+         hash_table_item = *(ip_item_t **) hash_table_ip->data[hash_table_ip->ind[table_id].index];
+         if (hash_table_item->country_count > 0) {
+
+            // check if snapshot is full
+            if (snapshot->count >= snapshot->size) {
+               uint32_t size = snapshot->size == 0 ? 1024 : snapshot->size * 2;
+               countries_snapshot_item_t * item = (countries_snapshot_item_t *) realloc(snapshot->item, sizeof (countries_snapshot_item_t) * size);
+
+               // check successful allocation memory
+               if (item == NULL) {
+                  PRINT_ERR("countries_snapshot_fill: Error memory allocation\n");
+                  return -1;
+               }
+
+               snapshot->item = item;
+               snapshot->size = size;
+            }
+
+            memcpy(&(snapshot->item[snapshot->count].ip), hash_table_ip->keys[hash_table_ip->ind[table_id].index], sizeof (ip_addr_t));
+            snapshot->item[snapshot->count].country_count = hash_table_item->country_count;
+            memcpy(snapshot->item[snapshot->count].country, hash_table_item->country, sizeof (char) * 2 * hash_table_item->country_count);
+            snapshot->count++;
+         }
       }
+   }
+
+   return 0;
+}
+
+// Write countries from snapshot to stream in text format
+
+static void countries_snapshot_write_text(FILE * io_countries_file, countries_snapshot_t * snapshot)
+{
+   char time_str[FORMAT_DATETIME_LENGTH];
+   const time_t save_time = snapshot->save_time;
+   struct tm tmp_tm;
+
+   // time_t_to_str() can't be used (static buffer shared with packet processing)
+   if (strftime(time_str, FORMAT_DATETIME_LENGTH, FORMAT_DATETIME, gmtime_r(&save_time, &tmp_tm)) == 0) {
+      time_str[0] = '\0';
+   }
+
+   // write countries to file
+   fprintf(io_countries_file, "# VOIP_FRAUD_DETECTION - COUNTRIES FILE\n#\n");
+   fprintf(io_countries_file, "# =========================================================\n");
+   fprintf(io_countries_file, "# WARNING: !!! Backup this file before manually editing !!!\n");
+   fprintf(io_countries_file, "# =========================================================\n#\n");
+   fprintf(io_countries_file, "# Save time: %s (module version: "MODULE_VERSION")\n", time_str);
+   fprintf(io_countries_file, "# For description of countries shortcut visit: http://dev.maxmind.com/geoip/legacy/codes/iso3166/\n");
+   fprintf(io_countries_file, "# After every country must be placed delimiter \":\"!\n");
+   fprintf(io_countries_file, "#\n# Allowed countries for all IP addresses can be defined on the next line. (example: \"ALLOWED_COUNTRIES=CZ:SK:\")\n");
+   fprintf(io_countries_file, "ALLOWED_COUNTRIES=");
+
+   unsigned int allowed_countries_id;
+   for (allowed_countries_id = 0; allowed_countries_id < snapshot->allowed_countries_count; allowed_countries_id++) {
+      fprintf(io_countries_file, "%.*s:", 2, &(snapshot->allowed_countries[allowed_countries_id * 2]));
+   }
+   fprintf(io_countries_file, "\n#\n# Next lines contain countries for individual IP addresses ...\n");
+
+   char ip_address_str [INET6_ADDRSTRLEN];
 
-      // write countries to file
-      fprintf(io_countries_file, "# VOIP_FRAUD_DETECTION - COUNTRIES FILE\n#\n");
-      fprintf(io_countries_file, "# =========================================================\n");
-      fprintf(io_countries_file, "# WARNING: !!! Backup this file before manually editing !!!\n");
-      fprintf(io_countries_file, "# =========================================================\n#\n");
-      fprintf(io_countries_file, "# Save time: %s (module version: "MODULE_VERSION")\n", get_actual_time_string());
-      fprintf(io_countries_file, "# For description of countries shortcut visit: http://dev.maxmind.com/geoip/legacy/codes/iso3166/\n");
-      fprintf(io_countries_file, "# After every country must be placed delimiter \":\"!\n");
-      fprintf(io_countries_file, "#\n# Allowed countries for all IP addresses can be defined on the next line. (example: \"ALLOWED_COUNTRIES=CZ:SK:\")\n");
-      fprintf(io_countries_file, "ALLOWED_COUNTRIES=");
-
-      unsigned int allowed_countries_id;
-      for (allowed_countries_id = 0; allowed_countries_id < modul_configuration.allowed_countries_count; allowed_countries_id++) {
-         fprintf(io_countries_file, "%.*s:", 2, &(modul_configuration.allowed_countries[allowed_countries_id * 2]));
+   uint32_t item_id, country_id;
+   for (item_id = 0; item_id < snapshot->count; item_id++) {
+      ip_to_str(&(snapshot->item[item_id].ip), (char *) &ip_address_str);
+      fprintf(io_countries_file, "-%s\n=", ip_address_str);
+
+      for (country_id = 0; country_id < snapshot->item[item_id].country_count; country_id++) {
+         fprintf(io_countries_file, "%.*s:", 2, snapshot->item[item_id].country[country_id]);
       }
-      fprintf(io_countries_file, "\n#\n# Next lines contain countries for individual IP addresses ...\n");
 
-      ip_item_t * hash_table_item;
-      ip_addr_t ip_address;
-      char ip_address_str [INET6_ADDRSTRLEN];
+      fprintf(io_countries_file, "\n");
+   }
+
+   // write countries to file
+   fprintf(io_countries_file, "# END OF FILE - VOIP_FRAUD_DETECTION - COUNTRIES (%u)\n", snapshot->count);
+}
 
-      unsigned int countries_count = 0;
+// Write countries from snapshot to stream in binary format
 
-      int table_id, country_id;
-      for (table_id = 0; table_id < hash_table_ip->table_size; table_id++) {
+static void countries_snapshot_write_binary(FILE * io_countries_file, countries_snapshot_t * snapshot)
+{
+   uint32_t version = COUNTRIES_BINARY_FILE_VERSION;
+   uint32_t item_id;
+   uint8_t country_count;
+
+   // header: magic, version, allowed countries and number of IP addresses
+   fwrite(COUNTRIES_BINARY_FILE_MAGIC, 1, COUNTRIES_BINARY_FILE_MAGIC_LENGTH, io_countries_file);
+   fwrite(&version, sizeof (uint32_t), 1, io_countries_file);
+   fwrite(&(snapshot->allowed_countries_count), sizeof (uint32_t), 1, io_countries_file);
+   fwrite(snapshot->allowed_countries, sizeof (char) * 2, snapshot->allowed_countries_count, io_countries_file);
+   fwrite(&(snapshot->count), sizeof (uint32_t), 1, io_countries_file);
+
+   // records: IP address, number of countries and countries
+   for (item_id = 0; item_id < snapshot->count; item_id++) {
+      country_count = snapshot->item[item_id].country_count;
+      fwrite(&(snapshot->item[item_id].ip), sizeof (ip_addr_t), 1, io_countries_file);
+      fwrite(&country_count, sizeof (uint8_t), 1, io_countries_file);
+      fwrite(snapshot->item[item_id].country, sizeof (char) * 2, country_count, io_countries_file);
+   }
+}
 
-         if (hash_table_ip->ind[table_id].valid) {
+// Write countries from snapshot to defined file (atomically by renaming temporary file)
 
-            memcpy(&ip_address, hash_table_ip->keys[hash_table_ip->ind[table_id].index], sizeof (ip_addr_t));
-            ip_to_str(&ip_address, (char *) &ip_address_str);
+static void countries_snapshot_write(char * file, countries_snapshot_t * snapshot, char binary)
+{
+   char tmp_file[strlen(file) + 5];
+   FILE * io_countries_file;
 
-            hash_table_item = *(ip_item_t **) hash_table_ip->data[hash_table_ip->ind[table_id].index];
-            if (hash_table_item->country_count > 0) {
-               fprintf(io_countries_file, "-%s\n=", ip_address_str);
+   sprintf(tmp_file, "%s.tmp", file);
 
-               for (country_id = 0; country_id < hash_table_item->country_count; country_id++) {
-                  fprintf(io_countries_file, "%.*s:", 2, hash_table_item->country[country_id]);
-               }
+   // open temporary file (write, text or binary mode)
+   io_countries_file = fopen(tmp_file, binary ? "wb" : "wt");
+   if (io_countries_file == NULL) {
+      PRINT_ERR("Error open country file for writing: \"", tmp_file, "\"\n");
+      return;
+   }
 
-               fprintf(io_countries_file, "\n");
-               countries_count++;
-            }
-         }
+   if (binary) {
+      countries_snapshot_write_binary(io_countries_file, snapshot);
+   } else {
+      countries_snapshot_write_text(io_countries_file, snapshot);
+   }
+
+   // close file and replace the old one, readers never see partially written file
+   int write_error = ferror(io_countries_file);
+   if (fclose(io_countries_file) != 0) write_error = 1;
+
+   if (write_error) {
+      PRINT_ERR("Error writing country file: \"", tmp_file, "\"\n");
+      remove(tmp_file);
+      return;
+   }
+
+   if (rename(tmp_file, file) != 0) {
+      PRINT_ERR("Error renaming country file: \"", tmp_file, "\"\n");
+      remove(tmp_file);
+   }
+}
+
+// Thread writing snapshots of countries handed over by countries_snapshot_save()
+
+static void * countries_writer_thread(void * arg)
+{
+   pthread_mutex_lock(&countries_writer.lock);
+
+   while (1) {
+      // wait for snapshot or stop of writer
+      while (!countries_writer.pending && !countries_writer.stop) {
+         pthread_cond_wait(&countries_writer.cond, &countries_writer.lock);
       }
 
-      // write countries to file
-      fprintf(io_countries_file, "# END OF FILE - VOIP_FRAUD_DETECTION - COUNTRIES (%u)\n", countries_count);
+      if (!countries_writer.pending) break;
 
-      // close file
-      fclose(io_countries_file);
+      // snapshot is owned by writer until pending is reset
+      pthread_mutex_unlock(&countries_writer.lock);
+      countries_snapshot_write(modul_configuration.countries_file, &countries_writer.snapshot, modul_configuration.countries_file_binary);
+      pthread_mutex_lock(&countries_writer.lock);
+
+      countries_writer.pending = 0;
+   }
+
+   pthread_mutex_unlock(&countries_writer.lock);
+
+   return NULL;
+}
+
+// Start thread for saving countries file in background
+
+int countries_writer_start()
+{
+   countries_writer.pending = 0;
+   countries_writer.stop = 0;
+   countries_writer.running = 0;
+   memset(&countries_writer.snapshot, 0, sizeof (countries_snapshot_t));
+
+   if (modul_configuration.countries_file == NULL || COUNTRIES_FILE_SAVING_INTERVAL == 0) return 0;
+
+   pthread_mutex_init(&countries_writer.lock, NULL);
+   pthread_cond_init(&countries_writer.cond, NULL);
+
+   if (pthread_create(&countries_writer.thread, NULL, countries_writer_thread, NULL) != 0) {
+      PRINT_ERR("countries_writer_start: Error creating thread\n");
+      pthread_mutex_destroy(&countries_writer.lock);
+      pthread_cond_destroy(&countries_writer.cond);
+      return -1;
+   }
+
+   countries_writer.running = 1;
+
+   return 0;
+}
+
+// Wait for the last snapshot and stop thread for saving countries file
+
+void countries_writer_stop()
+{
+   if (countries_writer.running) {
+      pthread_mutex_lock(&countries_writer.lock);
+      countries_writer.stop = 1;
+      pthread_cond_signal(&countries_writer.cond);
+      pthread_mutex_unlock(&countries_writer.lock);
+
+      pthread_join(countries_writer.thread, NULL);
+      pthread_mutex_destroy(&countries_writer.lock);
+      pthread_cond_destroy(&countries_writer.cond);
+      countries_writer.running = 0;
+   }
+
+   if (countries_writer.snapshot.item != NULL) {
+      free(countries_writer.snapshot.item);
+      countries_writer.snapshot.item = NULL;
+   }
+   countries_writer.snapshot.size = 0;
+}
+
+// Hand over snapshot of all countries to thread saving countries file
+
+static void countries_snapshot_save(cc_hash_table_v2_t * hash_table_ip)
+{
+   // without writer thread save countries synchronously
+   if (!countries_writer.running) {
+      countries_save_all_to_file(modul_configuration.countries_file, hash_table_ip);
+      return;
+   }
+
+   pthread_mutex_lock(&countries_writer.lock);
+
+   // writer is still busy with the last snapshot, try it again later
+   if (countries_writer.pending) {
+      pthread_mutex_unlock(&countries_writer.lock);
+      return;
+   }
+
+   // only copy of countries is made here, formatting and I/O run in writer thread
+   if (countries_snapshot_fill(&countries_writer.snapshot, hash_table_ip) == 0) {
+      countries_writer.pending = 1;
+      pthread_cond_signal(&countries_writer.cond);
+   }
+
+   pthread_mutex_unlock(&countries_writer.lock);
+
+   time_last_countries_file_saved = current_time;
+}
+
+// Save all countries from memory to defined file
+
+void countries_save_all_to_file(char * file, cc_hash_table_v2_t * hash_table_ip)
+{
+   if (file != NULL) {
+      countries_snapshot_t snapshot;
+      memset(&snapshot, 0, sizeof (countries_snapshot_t));
+
+      if (countries_snapshot_fill(&snapshot, hash_table_ip) == 0) {
+         countries_snapshot_write(file, &snapshot, modul_configuration.countries_file_binary);
+      }
+
+      free(snapshot.item);
    }
 
    // prevention of immediately auto-saving countries file
@@ -458,6 +761,60 @@ char * get_domain(char * str, int str_len)
    }
 }
 
+// Find country of domain part (IP address or FQDN) in GeoIP databases
+
+static int geoip_id_lookup_databases(char * text_domain_part)
+{
+   int geoip_id;
+   ip_addr_t ip;
+
+   // check if domain text is IP address
+   if (ip_from_str(text_domain_part, &ip) != 0) {
+      if (ip_is4(&ip)) {
+         // IP address is version 4
+         geoip_id = GeoIP_id_by_addr_gl(geo_ipv4, text_domain_part, &geoip_lookup);
+      } else {
+         // IP address is version 6
+         geoip_id = GeoIP_id_by_addr_v6_gl(geo_ipv6, text_domain_part, &geoip_lookup);
+      }
+   } else {
+      // try if domain part is FQDN for IP address version 4 (Fully Qualified Domain Name)
+      geoip_id = GeoIP_id_by_name_gl(geo_ipv4, text_domain_part, &geoip_lookup);
+
+      // try if domain part is FQDN for IP address version 6 (Fully Qualified Domain Name)
+      if (geoip_id <= 0) geoip_id = GeoIP_id_by_name_v6_gl(geo_ipv6, text_domain_part, &geoip_lookup);
+   }
+
+   return geoip_id;
+}
+
+// Find country of domain part in GeoIP cache, GeoIP databases are used on miss or expired item
+
+static int geoip_id_lookup(char * text_domain_part)
+{
+   size_t length = strlen(text_domain_part);
+
+   // long domain parts are not cached
+   if (length > GEOIP_CACHE_MAX_DOMAIN_LENGTH) {
+      return geoip_id_lookup_databases(text_domain_part);
+   }
+
+   geoip_cache_item_t * item = &geoip_cache[SuperFastHash(text_domain_part, length) & (GEOIP_CACHE_SIZE - 1)];
+
+   // check if valid item of the same domain part is cached (unresolved domain parts are cached too)
+   if (item->domain[0] != '\0' && current_time >= item->time_inserted && current_time - item->time_inserted < GEOIP_CACHE_TTL \
+         && strcmp(item->domain, text_domain_part) == 0) {
+      return item->geoip_id;
+   }
+
+   // replace item by actual domain part
+   item->geoip_id = geoip_id_lookup_databases(text_domain_part);
+   item->time_inserted = current_time;
+   memcpy(item->domain, text_domain_part, length + 1);
+
+   return item->geoip_id;
+}
+
 // Detection of calling to different countries and write/send information about it
 
 int country_different_call_detection(cc_hash_table_v2_t * hash_table, ip_item_t * hash_table_item, char *sip_to, int sip_to_len, char *sip_from, char *user_agent, ip_addr_t * ip_src, ip_addr_t * ip_dst)
@@ -468,24 +825,9 @@ int country_different_call_detection(cc_hash_table_v2_t * hash_table, ip_item_t
    if ((text_domain_part = get_domain(sip_to, sip_to_len)) != NULL) {
 
       int geoip_id;
-      ip_addr_t ip;
-
-      // check if domain text is IP address
-      if (ip_from_str(text_domain_part, &ip) != 0) {
-         if (ip_is4(&ip)) {
-            // IP address is version 4
-            geoip_id = GeoIP_id_by_addr_gl(geo_ipv4, text_domain_part, &geoip_lookup);
-         } else {
-            // IP address is version 6
-            geoip_id = GeoIP_id_by_addr_v6_gl(geo_ipv6, text_domain_part, &geoip_lookup);
-         }
-      } else {
-         // try if domain part is FQDN for IP address version 4 (Fully Qualified Domain Name)
-         geoip_id = GeoIP_id_by_name_gl(geo_ipv4, text_domain_part, &geoip_lookup);
 
-         // try if domain part is FQDN for IP address version 6 (Fully Qualified Domain Name)
-         if (geoip_id <= 0) geoip_id = GeoIP_id_by_name_v6_gl(geo_ipv6, text_domain_part, &geoip_lookup);
-      }
+      // get country of domain part (from cache or GeoIP databases)
+      geoip_id = geoip_id_lookup(text_domain_part);
 
       // geoip if country is located
       if (geoip_id > 0) {
@@ -44,6 +44,7 @@
 #ifndef VOIP_FRAUD_DETECTION_COUNTRY_H
 #define VOIP_FRAUD_DETECTION_COUNTRY_H
 
+#include <pthread.h>
 #include <cuckoo_hash_v2.h>
 #include <libtrap/trap.h>
 #include <unirec/unirec.h>
@@ -60,6 +61,41 @@ GeoIP *geo_ipv4, *geo_ipv6;
 /** \brief GeoIP temp variable (for finding in GeoIP database). */
 GeoIPLookup geoip_lookup;
 
+/** \brief Item of GeoIP lookup cache. */
+typedef struct geoip_cache_item_struct {
+   char domain[GEOIP_CACHE_MAX_DOMAIN_LENGTH + 1]; /**< Domain part (IP address or FQDN) of called party, empty for free item. */
+   int geoip_id; /**< GeoIP ID of country (0 if country isn't located). */
+   ur_time_t time_inserted; /**< Time of GeoIP lookup. */
+} geoip_cache_item_t;
+
+/** \brief Countries of one IP address in snapshot. */
+typedef struct countries_snapshot_item_struct {
+   ip_addr_t ip; /**< IP address. */
+   uint32_t country_count; /**< Number of saved countries for the IP address. */
+   char country[COUNTRY_STORAGE_SIZE][2]; /**< Storage of countries for IP address. */
+} countries_snapshot_item_t;
+
+/** \brief Copy of countries of all IP addresses, which is saved to countries file. */
+typedef struct countries_snapshot_struct {
+   countries_snapshot_item_t * item; /**< Array of IP addresses with countries. */
+   uint32_t count; /**< Number of items in array. */
+   uint32_t size; /**< Allocated size of array. */
+   char * allowed_countries; /**< List of allowed countries for all IP addresses. */
+   uint32_t allowed_countries_count; /**< Number of allowed countries for all IP addresses. */
+   ur_time_t save_time; /**< Time of creating snapshot. */
+} countries_snapshot_t;
+
+/** \brief Thread saving snapshots of countries to countries file in background. */
+typedef struct countries_writer_struct {
+   pthread_t thread; /**< Writer thread. */
+   pthread_mutex_t lock; /**< Lock of pending and stop. */
+   pthread_cond_t cond; /**< Signal of new snapshot or stop. */
+   countries_snapshot_t snapshot; /**< Snapshot owned by writer when pending is set. */
+   char pending; /**< Indication of snapshot waiting for writing. */
+   char stop; /**< Indication of stopping writer. */
+   char running; /**< Indication if writer thread is running. */
+} countries_writer_t;
+
 /** \brief Time of the last saving countries from memory to the defined countries file. */
 ur_time_t time_last_countries_file_saved;
 
@@ -99,11 +135,20 @@ void countries_power_off_learning_mode(int signum);
 int countries_load_all_from_file(char * file, cc_hash_table_v2_t * hash_table_ip);
 
 /** \brief Save all countries from memory to defined file.
+ * File is written to temporary file and renamed, in binary format if countries_file_binary is set.
  * \param[in] file Definition of file path.
  * \param[in] hash_table_ip Pointer to hash table of IP addresses.
  */
 void countries_save_all_to_file(char * file, cc_hash_table_v2_t * hash_table_ip);
 
+/** \brief Start thread saving countries file in background (every COUNTRIES_FILE_SAVING_INTERVAL).
+ * \return Return 0 if thread is started (or not needed), -1 if error occurs (countries are saved synchronously).
+ */
+int countries_writer_start();
+
+/** \brief Wait for writing of the last snapshot and stop thread saving countries file. */
+void countries_writer_stop();
+
 /** \brief Get domain name or IP adrress from input URI.
  * \param[in] str Input string (URI).
  * \param[in] str_len Integer - length of input string.
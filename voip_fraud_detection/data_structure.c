@@ -67,6 +67,10 @@ int hash_table_item_initialize(ip_item_t * hash_table_item)
    hash_table_item->prefix_examination_attack_event_id = 0;
    hash_table_item->prefix_examination_attack_prefix_length = 0;
    hash_table_item->prefix_examination_attack_sip_to = NULL;
+   hash_table_item->inserted_sip_to = NULL;
+   hash_table_item->inserted_sip_to_count = 0;
+   hash_table_item->inserted_sip_to_size = 0;
+   hash_table_item->examine_whole_tree = 1;
 
    // calling to different country
    hash_table_item->time_attack_detected_call_different_country = 0;
@@ -93,6 +97,54 @@ void hash_table_item_free_inner_memory(ip_item_t * hash_table_item)
       free(hash_table_item->prefix_examination_attack_sip_to);
       hash_table_item->prefix_examination_attack_sip_to = NULL;
    }
+
+   if (hash_table_item->inserted_sip_to != NULL) {
+      free(hash_table_item->inserted_sip_to);
+      hash_table_item->inserted_sip_to = NULL;
+   }
+   hash_table_item->inserted_sip_to_count = 0;
+   hash_table_item->inserted_sip_to_size = 0;
+}
+
+// Save node of SIP_TO inserted to suffix tree
+
+void inserted_sip_to_save(ip_item_t * hash_table_item, prefix_tree_domain_t * prefix_tree_node)
+{
+   // whole tree will be examined, inserted nodes are not needed
+   if (hash_table_item->examine_whole_tree) return;
+
+   // repeated insert of the same SIP_TO is saved once
+   if (hash_table_item->inserted_sip_to_count > 0 && hash_table_item->inserted_sip_to[hash_table_item->inserted_sip_to_count - 1] == prefix_tree_node) return;
+
+   // check if storage is full
+   if (hash_table_item->inserted_sip_to_count >= hash_table_item->inserted_sip_to_size) {
+      uint32_t size = hash_table_item->inserted_sip_to_size == 0 ? 64 : hash_table_item->inserted_sip_to_size * 2;
+      prefix_tree_domain_t ** inserted_sip_to = NULL;
+
+      if (size <= MAX_INSERTED_SIP_TO) {
+         inserted_sip_to = (prefix_tree_domain_t **) realloc(hash_table_item->inserted_sip_to, sizeof (prefix_tree_domain_t *) * size);
+      }
+
+      // too many inserts or memory error => examine whole tree
+      if (inserted_sip_to == NULL) {
+         inserted_sip_to_reset(hash_table_item, 1);
+         return;
+      }
+
+      hash_table_item->inserted_sip_to = inserted_sip_to;
+      hash_table_item->inserted_sip_to_size = size;
+   }
+
+   hash_table_item->inserted_sip_to[hash_table_item->inserted_sip_to_count] = prefix_tree_node;
+   hash_table_item->inserted_sip_to_count++;
+}
+
+// Forget saved nodes of inserted SIP_TO
+
+void inserted_sip_to_reset(ip_item_t * hash_table_item, char examine_whole_tree)
+{
+   hash_table_item->inserted_sip_to_count = 0;
+   hash_table_item->examine_whole_tree = examine_whole_tree;
 }
 
 
@@ -121,6 +173,7 @@ int node_data_check_initialize(prefix_tree_domain_t * prefix_tree_node)
       ((node_data_t *) (prefix_tree_node->parent->value))->user_agent_hash = 0;
       ((node_data_t *) (prefix_tree_node->parent->value))->call_id_full = 0;
       ((node_data_t *) (prefix_tree_node->parent->value))->call_id_insert_position = 0;
+      memset(((node_data_t *) (prefix_tree_node->parent->value))->call_id_set, 0, sizeof (uint8_t) * CALL_ID_SET_SIZE);
    }
 
    return 0;
@@ -86,6 +86,7 @@ typedef struct modul_configuration_struct {
    unsigned int learning_countries_period; /**< Time in seconds for learning mode of calling to different countries. */
    unsigned char countries_detection_mode; /**< Indication of actual detection mode of calling to different country. */
    char * countries_file; /**< Setting of countries file. */
+   char countries_file_binary; /**< Indication if countries file is saved in binary format. */
    char * allowed_countries; /**< List of allowed countries for all IP addresses. */
    unsigned int allowed_countries_count; /**< Number of allowed countries for all IP addresses. */
    short int disable_saving_new_country; /**< Indication if new country is saved to list of allowed countries for defined IP address. */
@@ -110,6 +111,10 @@ typedef struct ip_item_struct {
    uint16_t prefix_examination_attack_prefix_length; /**< Prefix length of attack_sip_to (in the last prefix examination attack). */
    uint32_t prefix_examination_detection_event_count; /**< Number of detected prefix examination attack events for the IP. */
    uint32_t prefix_examination_attack_detected_count; /**< Number of detected prefix examination attacks for the IP. */
+   prefix_tree_domain_t ** inserted_sip_to; /**< Nodes of SIP_TO inserted to suffix tree since last check of prefix examination. */
+   uint32_t inserted_sip_to_count; /**< Number of nodes in inserted_sip_to. */
+   uint32_t inserted_sip_to_size; /**< Allocated size of inserted_sip_to. */
+   char examine_whole_tree; /**< Indication if whole suffix tree has to be examined (new tree, deleted nodes or too many inserts). */
 
    ur_time_t time_attack_detected_call_different_country; /**< Time last detection of calling to different country. */
    uint32_t call_different_country_attack_event_id; /**< Event ID of the last calling to different country attack. */
@@ -130,6 +135,7 @@ typedef struct node_data_struct {
    uint32_t call_id_hash[MAX_CALL_ID_STORAGE_SIZE]; /**< Storage for Call-ID hashes of INVITE request (call_id_hash storage). */
    uint32_t call_id_insert_position; /**< Position of insert for call_id storage. */
    char call_id_full; /**< Indication if call_id storage is full (0=not full; 1=full). */
+   uint8_t call_id_set[CALL_ID_SET_SIZE]; /**< Hash set of positions in call_id_hash storage + 1 (0=empty slot). */
 } node_data_t;
 
 /** \brief Global module statistic structure.
@@ -184,6 +190,18 @@ int hash_table_item_initialize(ip_item_t * hash_table_item);
  */
 void hash_table_item_free_inner_memory(ip_item_t * hash_table_item);
 
+/** \brief Save node of SIP_TO inserted to suffix tree, only subtrees with inserted nodes are examined by next check of prefix examination.
+ * \param[in] hash_table_item Determine item of hash table.
+ * \param[in] prefix_tree_node Node returned by prefix_tree_insert().
+ */
+void inserted_sip_to_save(ip_item_t * hash_table_item, prefix_tree_domain_t * prefix_tree_node);
+
+/** \brief Forget saved nodes of inserted SIP_TO (after check of prefix examination or renew of suffix tree).
+ * \param[in] hash_table_item Determine item of hash table.
+ * \param[in] examine_whole_tree Indication if whole suffix tree has to be examined by next check.
+ */
+void inserted_sip_to_reset(ip_item_t * hash_table_item, char examine_whole_tree);
+
 /** \brief Initialize data of suffix tree node defined by input parameter.
  * \param[in] prefix_tree_node Determine node to initialization its data.
  * \return Return 0 if data are successfully initialized, -1 if memory error occurs.
@@ -109,42 +109,134 @@ void write_to_stream(FILE * stream, char * str, ...)
    va_end(parameters);
 }
 
-// Write input strings to log file (variadic funtion)
+// Writer of the log file, lines are written by its own thread so that detection is not slowed by the file
 
-void write_to_log(char * str, ...)
+static async_log_t *log_writer = NULL;
+
+// Type of log records with datetime formatted by the writer thread (log_datetime_header_t, prefix and strings)
+
+#define LOG_RECORD_DATETIME 1
+
+typedef struct log_datetime_header_s {
+   ur_time_t time;
+   uint32_t prefix_length;
+} log_datetime_header_t;
+
+// Format record with datetime in the writer thread
+
+static void format_log_record(FILE * file, uint16_t type, const void * data, uint32_t size, void * arg)
 {
+   log_datetime_header_t header;
+   char time_str[FORMAT_DATETIME_LENGTH];
+   const char * text = (const char *) data + sizeof(header);
+   struct tm tmp_tm;
+   time_t time;
 
-   // check if log_file is set (configuration of module)
-   if (modul_configuration.log_file != NULL) {
+   (void) arg;
+   if (file == NULL || type != LOG_RECORD_DATETIME || size < sizeof(header)) {
+      return;
+   }
+   memcpy(&header, data, sizeof(header));
+   if (header.prefix_length > size - sizeof(header)) {
+      return;
+   }
 
-      va_list parameters;
-      char * parameter;
+   time = header.time;
+   if (strftime(time_str, FORMAT_DATETIME_LENGTH, FORMAT_DATETIME, gmtime_r(&time, &tmp_tm)) == 0) {
+      time_str[0] = '\0';
+   }
+   fwrite(text, 1, header.prefix_length, file);
+   fprintf(file, "%s;", time_str);
+   fwrite(text + header.prefix_length, 1, size - sizeof(header) - header.prefix_length, file);
+}
 
-      static FILE * io_log_file;
+// Open log file (if is set)
 
-      // open log file (append, text mode)
-      io_log_file = fopen(modul_configuration.log_file, "at");
-      if (io_log_file == NULL) {
+void open_log()
+{
+   if (modul_configuration.log_file != NULL && log_writer == NULL) {
+      log_writer = async_log_open(modul_configuration.log_file, ASYNC_LOG_DEFAULT_CAPACITY, ASYNC_LOG_SYNC_NEVER, format_log_record, NULL);
+      if (log_writer == NULL) {
          fprintf(stderr, "Error open log file: %s!\n", modul_configuration.log_file);
-         return;
       }
+   }
+}
+
+// Write the rest of the log and close log file
 
-      // set first parameter
-      parameter = str;
+void close_log()
+{
+   async_log_close(log_writer);
+   log_writer = NULL;
+}
 
-      // initialization of parameters list
-      va_start(parameters, str);
+// Copy strings to one record of the log after the header
 
-      // write parameters to log file
-      while (parameter != NULL) {
-         fprintf(io_log_file, "%s", parameter);
-         parameter = va_arg(parameters, char*);
-      }
+static void write_strings_to_log(uint16_t type, const void * header, size_t header_size, char * str, va_list parameters)
+{
+   va_list copy;
+   char * parameter;
+   char * record, * position;
+   size_t length = header_size;
 
-      // close log file
-      fclose(io_log_file);
+   // count length of all parameters
+   va_copy(copy, parameters);
+   for (parameter = str; parameter != NULL; parameter = va_arg(copy, char*)) {
+      length += strlen(parameter);
+   }
+   va_end(copy);
 
-      // end using variable parameters list
-      va_end(parameters);
+   // reserve one record for all parameters (it is dropped when the writer can't keep up)
+   record = async_log_reserve(log_writer, type, length);
+   if (record == NULL) {
+      return;
    }
+
+   // copy header and parameters to the record
+   memcpy(record, header, header_size);
+   position = record + header_size;
+   for (parameter = str; parameter != NULL; parameter = va_arg(parameters, char*)) {
+      length = strlen(parameter);
+      memcpy(position, parameter, length);
+      position += length;
+   }
+
+   async_log_commit(log_writer, record);
+}
+
+// Write input strings to log file (variadic funtion)
+
+void write_to_log(char * str, ...)
+{
+   va_list parameters;
+
+   // check if log file is opened
+   if (log_writer == NULL) {
+      return;
+   }
+
+   va_start(parameters, str);
+   write_strings_to_log(ASYNC_LOG_TEXT, NULL, 0, str, parameters);
+   va_end(parameters);
+}
+
+// Write prefix, actual datetime and input strings to log file (variadic funtion)
+
+void write_to_log_datetime(char * prefix, ...)
+{
+   va_list parameters;
+   log_datetime_header_t header;
+
+   // check if log file is opened
+   if (log_writer == NULL) {
+      return;
+   }
+
+   // the prefix is the first string of the record
+   header.time = current_time;
+   header.prefix_length = strlen(prefix);
+
+   va_start(parameters, prefix);
+   write_strings_to_log(LOG_RECORD_DATETIME, &header, sizeof(header), prefix, parameters);
+   va_end(parameters);
 }
@@ -50,6 +50,7 @@
 #include <string.h>
 #include <stdarg.h>
 #include <unirec/unirec.h>
+#include "async_log.h"
 #include "configuration.h"
 #include "data_structure.h"
 
@@ -74,21 +75,21 @@ extern ur_time_t current_time;
 /** \brief Function macro for printing to log file with actual datetime.
  * Unlimited input parameters are printed to log files with actual datetime at the beginning of text.
  */
-#define PRINT_LOG(...) write_to_log(get_actual_time_string(), ";", __VA_ARGS__, NULL)
+#define PRINT_LOG(...) write_to_log_datetime("", __VA_ARGS__, NULL)
 
 /** \brief Function macro for printing to standard output and log file at the same time with actual datetime.
  * Unlimited input parameters are printed to standard output and log file at the same time with actual
  * datetime at the beginning of text.
  */
 #define PRINT_OUT_LOG(...) write_to_stream(stdout, get_actual_time_string(), ";", __VA_ARGS__, NULL);\
-write_to_log(get_actual_time_string(),";", __VA_ARGS__, NULL)
+write_to_log_datetime("", __VA_ARGS__, NULL)
 
 /** \brief Function macro for printing to standard error output and log file at the same time with actual datetime.
  * Unlimited input parameters are printed to standard error output and log file at the same time with actual
  * datetime at the beginning of text.
  */
 #define PRINT_ERR_LOG(...) write_to_stream(stderr, ERROR_MESSAGE_PREFIX, get_actual_time_string(), ";", __VA_ARGS__, NULL);\
-write_to_log(ERROR_MESSAGE_PREFIX, get_actual_time_string(),";", __VA_ARGS__, NULL)
+write_to_log_datetime(ERROR_MESSAGE_PREFIX, __VA_ARGS__, NULL)
 
 /** \brief Function macro for printing to standard output.
  * Unlimited input parameters are printed to standard output.
@@ -133,8 +134,22 @@ char * ushortint_to_str(unsigned short int integer);
  */
 void write_to_stream(FILE * stream, char * str, ...);
 
+/** \brief Open log file (if is set), strings are then written to it by a separate thread.
+ */
+void open_log();
+
+/** \brief Write the rest of strings and close log file.
+ */
+void close_log();
+
 /** \brief Write input strings to log file (variadic funtion).
+ * All strings of one call form one record of the log, it is dropped when the log writer can't keep up.
  */
 void write_to_log(char * str, ...);
 
+/** \brief Write prefix, actual datetime and input strings to log file (variadic funtion).
+ * The datetime is formatted by the log writer thread, it is written after the prefix.
+ */
+void write_to_log_datetime(char * prefix, ...);
+
 #endif	/* VOIP_FRAUD_DETECTION_OUTPUT_H */
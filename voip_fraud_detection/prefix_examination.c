@@ -41,13 +41,138 @@
  *
  */
 
+#include <stdint.h>
 #include "prefix_examination.h"
 #include "fields.h"
 
+
+// hash set of dirty nodes (on the path of SIP_TO inserted since last check),
+// slots with other generation than actual one are empty
+static cache_node_no_attack_item_t * dirty_node_data = NULL;
+static unsigned int dirty_node_data_size = 0;
+static unsigned int dirty_node_count = 0;
+static unsigned int dirty_node_generation = 1;
+
+// indication if all nodes are dirty (whole suffix tree is examined)
+static char dirty_node_all = 1;
+
+// Index of the first slot for node in hash set of dirty nodes
+
+static inline unsigned int dirty_node_index(prefix_tree_inner_node_t * node, unsigned int size)
+{
+   uint64_t hash = (uint64_t) (uintptr_t) node;
+   hash ^= hash >> 33;
+   hash *= 0xff51afd7ed558ccdULL;
+   hash ^= hash >> 33;
+   return (unsigned int) hash & (size - 1);
+}
+
+// Find if the node is dirty
+
+static int dirty_node_exists(prefix_tree_inner_node_t * node)
+{
+   if (dirty_node_all) return 1;
+
+   unsigned int i = dirty_node_index(node, dirty_node_data_size);
+
+   while (dirty_node_data[i].generation == dirty_node_generation) {
+      if (dirty_node_data[i].node == node) return 1;
+      i = (i + 1) & (dirty_node_data_size - 1);
+   }
+
+   return 0;
+}
+
+// Double size of hash set of dirty nodes, return -1 if memory error occurs
+
+static int dirty_node_grow()
+{
+   unsigned int size = dirty_node_data_size == 0 ? 1024 : dirty_node_data_size * 2;
+   unsigned int i, j;
+
+   cache_node_no_attack_item_t * data = (cache_node_no_attack_item_t *) calloc(size, sizeof (cache_node_no_attack_item_t));
+   if (data == NULL) return -1;
+
+   // move nodes of actual generation (generation 1 in new table)
+   for (i = 0; i < dirty_node_data_size; i++) {
+      if (dirty_node_data[i].generation == dirty_node_generation) {
+         j = dirty_node_index(dirty_node_data[i].node, size);
+         while (data[j].generation == 1) j = (j + 1) & (size - 1);
+         data[j].node = dirty_node_data[i].node;
+         data[j].generation = 1;
+      }
+   }
+
+   free(dirty_node_data);
+   dirty_node_data = data;
+   dirty_node_data_size = size;
+   dirty_node_generation = 1;
+
+   return 0;
+}
+
+// Mark node as dirty, return 1 if node was already dirty, -1 if memory error occurs
+
+static int dirty_node_save(prefix_tree_inner_node_t * node)
+{
+   // keep load factor of hash set under 1/2
+   if ((dirty_node_count + 1) * 2 > dirty_node_data_size && dirty_node_grow() == -1) return -1;
+
+   unsigned int i = dirty_node_index(node, dirty_node_data_size);
+
+   while (dirty_node_data[i].generation == dirty_node_generation) {
+      if (dirty_node_data[i].node == node) return 1;
+      i = (i + 1) & (dirty_node_data_size - 1);
+   }
+
+   dirty_node_data[i].node = node;
+   dirty_node_data[i].generation = dirty_node_generation;
+   dirty_node_count++;
+
+   return 0;
+}
+
+// Mark nodes on paths of SIP_TO inserted since last check as dirty
+
+static void dirty_node_mark(ip_item_t * hash_table_item)
+{
+   unsigned int i;
+   prefix_tree_inner_node_t * node;
+
+   dirty_node_all = hash_table_item->examine_whole_tree;
+   if (dirty_node_all) return;
+
+   // forget dirty nodes of last check
+   dirty_node_count = 0;
+   dirty_node_generation++;
+   if (dirty_node_generation == 0) {
+      // generation counter overflowed, all slots have to be emptied
+      if (dirty_node_data != NULL) memset(dirty_node_data, 0, sizeof (cache_node_no_attack_item_t) * dirty_node_data_size);
+      dirty_node_generation = 1;
+   }
+
+   for (i = 0; i < hash_table_item->inserted_sip_to_count; i++) {
+      node = hash_table_item->inserted_sip_to[i]->parent;
+
+      // predecessors of dirty node are dirty too
+      while (node != NULL) {
+         int ret = dirty_node_save(node);
+         if (ret == 1) break;
+         if (ret == -1) {
+            // memory error => examine whole tree
+            PRINT_ERR("dirty_node_save: Error memory allocation\n");
+            dirty_node_all = 1;
+            return;
+         }
+         node = node->parent;
+      }
+   }
+}
+
 // Detection prefix examination in input suffix tree,
 // if attack is detected delete node and his descendants
 
-int prefix_examination_tree_detection(prefix_tree_t * tree, prefix_tree_inner_node_t * node)
+int prefix_examination_tree_detection(prefix_tree_t * tree, prefix_tree_inner_node_t * node, int clean_length)
 {
    // check if node is in cache_no_attack
    if (cache_node_no_attack_exists(node)) {
@@ -56,6 +181,24 @@ int prefix_examination_tree_detection(prefix_tree_t * tree, prefix_tree_inner_no
 
    int i;
 
+   // nothing was inserted below clean node, so only leaves whose prefix reaches
+   // a dirty predecessor (through at most max_prefix_length chars without '@') can change
+   if (clean_length < 0 && !dirty_node_exists(node)) {
+      if (node->parent == NULL) return STATE_NO_ATTACK;
+      clean_length = 0;
+   }
+
+   if (clean_length >= 0) {
+      char str [MAX_STRING_PREFIX_TREE_NODE + 1];
+
+      prefix_tree_read_inner_node(tree, node, str);
+      clean_length += strlen(str);
+
+      if (clean_length > modul_configuration.max_prefix_length || strstr(str, "@") != NULL) {
+         return STATE_NO_ATTACK;
+      }
+   }
+
    if (node->child == NULL) {
       // node is a leaf
 
@@ -164,7 +307,7 @@ int prefix_examination_tree_detection(prefix_tree_t * tree, prefix_tree_inner_no
          if (node->child[i] != NULL) {
 
             // recursive call
-            state_detection = prefix_examination_tree_detection(tree, node->child[i]);
+            state_detection = prefix_examination_tree_detection(tree, node->child[i], clean_length);
             if (state_detection == STATE_ATTACK_DETECTED) return STATE_ATTACK_DETECTED;
          }
       }
@@ -275,8 +418,18 @@ int prefix_examination_detection(cc_hash_table_v2_t * hash_table_user_agent, ip_
 
          int status_detection;
 
-         // call detection of prefix examination attack in suffix tree
-         status_detection = prefix_examination_tree_detection(hash_table_item->tree, hash_table_item->tree->root);
+         // mark nodes on paths of SIP_TO inserted since last check
+         dirty_node_mark(hash_table_item);
+
+         // call detection of prefix examination attack in suffix tree (skipped if nothing was inserted)
+         if (hash_table_item->examine_whole_tree || hash_table_item->inserted_sip_to_count > 0) {
+            status_detection = prefix_examination_tree_detection(hash_table_item->tree, hash_table_item->tree->root, -1);
+         } else {
+            status_detection = STATE_NO_ATTACK;
+         }
+
+         // tree is examined, after deleting of attack nodes the whole tree is examined again
+         inserted_sip_to_reset(hash_table_item, status_detection == STATE_ATTACK_DETECTED);
 
          if (status_detection == STATE_ATTACK_DETECTED) {
 
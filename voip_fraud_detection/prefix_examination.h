@@ -58,11 +58,15 @@
 extern uint32_t last_event_id;
 
 /** \brief Detection prefix examination in input suffix tree. If attack is detected delete node and his descendants.
+ * \param[in] tree Pointer to suffix tree (data structure named prefix_tree).
+ * Only subtrees containing SIP_TO inserted since last check (dirty nodes) and leaves
+ * whose prefix reaches a dirty predecessor are examined, other results can not change.
  * \param[in] tree Pointer to suffix tree (data structure named prefix_tree).
  * \param[in] node Pointer to start node of detection.
+ * \param[in] clean_length Length of prefix from the first clean node to the node, -1 for dirty node (used in recursive calling).
  * \return ID that indicates results of testing (STATE_NO_ATTACK or STATE_ATTACK_DETECTED).
  */
-int prefix_examination_tree_detection(prefix_tree_t * tree, prefix_tree_inner_node_t * node);
+int prefix_examination_tree_detection(prefix_tree_t * tree, prefix_tree_inner_node_t * node, int clean_length);
 
 /** \brief Function to thorough count of prefix detection minus value and save information about attack to detection_struct.
  * This function is used by prefix_examination_tree_detection().
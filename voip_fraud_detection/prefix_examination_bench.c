@@ -0,0 +1,126 @@
+/**
+ * \file prefix_examination_bench.c
+ * \brief Micro-benchmark of prefix_examination_tree_detection() of voip_fraud_detection (make bench).
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+/*
+ * The configuration and the trees are set up by the translation unit of the
+ * module, so it is included with main() renamed.
+ */
+#define main voip_fraud_detection_main
+#include "voip_fraud_detection.c"
+#undef main
+
+#include "bench.h"
+
+#define ITEM_CNT 1024
+#define CALLEE_CNT 32
+#define DOMAIN_CNT 4
+#define DETECTION_ROUNDS 16
+
+static ip_item_t items[ITEM_CNT];
+
+/**
+ * Insert SIP_TO of a random callee into the tree of the caller as done by
+ * the module (called numbers to a few domains).
+ */
+static int insert_callee(ip_item_t *item)
+{
+   char sip_to[64];
+   prefix_tree_domain_t *node;
+   int length;
+
+   length = snprintf(sip_to, sizeof(sip_to), "%010llu@pbx%u.example.com",
+                     (unsigned long long) (bench_rand() % 10000000000ULL),
+                     (unsigned int) (bench_rand() % DOMAIN_CNT));
+   node = prefix_tree_insert(item->tree, sip_to, length);
+   if (node == NULL) {
+      return -1;
+   }
+   inserted_sip_to_save(item, node);
+   if (node_data_check_initialize(node) == -1) {
+      return -1;
+   }
+   ((node_data_t *) (node->parent->value))->invite_count++;
+   return 0;
+}
+
+int main(void)
+{
+   unsigned long start_allocations;
+   unsigned long detected = 0;
+   double start;
+   int r, i, j;
+
+   modul_configuration.max_prefix_length = DEFAULT_MAX_PREFIX_LENGTH;
+   modul_configuration.prefix_examination_detection_threshold = DEFAULT_PREFIX_EXAMINATION_DETECTION_THRESHOLD;
+   modul_configuration.prefix_statistic_file = NULL;
+
+   for (i = 0; i < ITEM_CNT; i++) {
+      if (hash_table_item_initialize(&items[i]) == -1) {
+         return 1;
+      }
+      for (j = 0; j < CALLEE_CNT; j++) {
+         if (insert_callee(&items[i]) == -1) {
+            fprintf(stderr, "ERROR: could not insert SIP_TO.\n");
+            return 1;
+         }
+      }
+   }
+
+   // Examination of whole trees, as after start or after a detected attack
+   start = bench_now_ns();
+   start_allocations = bench_allocations();
+   for (r = 0; r < DETECTION_ROUNDS; r++) {
+      for (i = 0; i < ITEM_CNT; i++) {
+         cache_node_no_attack_clear();
+         if (prefix_examination_tree_detection(items[i].tree, items[i].tree->root, -1) == STATE_ATTACK_DETECTED) {
+            detected++;
+         }
+      }
+   }
+   bench_report("prefix_examination (tree)", (uint64_t) DETECTION_ROUNDS * ITEM_CNT, start, start_allocations);
+   printf("%-32s %10lu\n", "attacks detected", detected);
+
+   for (i = 0; i < ITEM_CNT; i++) {
+      hash_table_item_free_inner_memory(&items[i]);
+   }
+   return 0;
+}
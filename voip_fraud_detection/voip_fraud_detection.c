@@ -89,6 +89,7 @@ trap_module_info_t *module_info = NULL;
   PARAM('t', "prefix_exam_limit", "Prefix examination detection threshold.", required_argument, "uint32") \
   PARAM('o', "countries_detection_mode", "Disable detection of calling to different country.", no_argument, "none") \
   PARAM('a', "learn_countries_period", "Set learning mode for detection of calling to different country for defined period in seconds.", required_argument, "uint32") \
+  PARAM('b', "countries_binary", "Save countries file in binary format (faster loading, it's recognized automatically).", no_argument, "none") \
   PARAM('w', "disable_country_save", "Disable saving new country after calling to different country (every new calling will be reported repeatedly).", no_argument, "none") \
   PARAM('p', "pause", "Detection pause after attack in seconds.", required_argument, "uint32") \
   PARAM('q', "max_item_prefix_tree", "Limit of maximum item in prefix tree for one IP address.", required_argument, "uint32") \
@@ -135,53 +136,74 @@ void check_and_free_module_memory(cc_hash_table_v2_t * hash_table)
 {
    static ur_time_t time_last_check = 0;
 
-   int i;
+   // position of the next checked slot of hash table (-1 = no check in progress)
+   static int check_position = -1;
+
+   int i, end_position;
    ip_item_t * hash_table_item;
 
-   // check if check memory interval was expired
-   if (current_time > time_last_check && (current_time - time_last_check > CHECK_MEMORY_INTERVAL)) {
-      // printf("Checking memory: %"PRIu64", %"PRIu64", %"PRIu64"\n", current_time, time_last_check, current_time - time_last_check);
-      // iterate over items in hash table
-      for (i = 0; i < hash_table->table_size; i++) {
+   if (check_position < 0) {
+      // check if check memory interval was expired
+      if (!(current_time > time_last_check && (current_time - time_last_check > CHECK_MEMORY_INTERVAL))) return;
 
-         // check if item in hash table is valid
-         if (hash_table->ind[i].valid) {
+      // start new check from the first slot
+      check_position = 0;
+   }
 
-            // get item from hash_table
-            hash_table_item = *(ip_item_t **) hash_table->data[hash_table->ind[i].index];
+   // check is spread over received records, only CHECK_MEMORY_SLOTS_PER_RECORD slots are checked at once
+   end_position = check_position + CHECK_MEMORY_SLOTS_PER_RECORD;
+   if (end_position > hash_table->table_size) end_position = hash_table->table_size;
 
-            // check for no SIP communication for defined time
-            if ((current_time - hash_table_item->time_last_communication) > modul_configuration.clear_data_no_communication_after) {
-               // free additional memory
-               hash_table_item_free_inner_memory(hash_table_item);
+   // iterate over items in hash table
+   for (i = check_position; i < end_position; i++) {
 
-               // remove item from hash table
-               ht_remove_by_key_v2(hash_table, (char *) hash_table->keys[hash_table->ind[i].index]);
+      // check if item in hash table is valid
+      if (hash_table->ind[i].valid) {
 
-               // actual hash table item was removed, continue with next item
-               continue;
-            }
+         // get item from hash_table
+         hash_table_item = *(ip_item_t **) hash_table->data[hash_table->ind[i].index];
 
-            // check if prefix_tree has more than max_item_prefix_tree items
-            if ((hash_table_item->tree->root->count_of_string > modul_configuration.max_item_prefix_tree)) {
-               // destroy prefix_tree
-               prefix_tree_destroy(hash_table_item->tree);
+         // check for no SIP communication for defined time
+         if ((current_time - hash_table_item->time_last_communication) > modul_configuration.clear_data_no_communication_after) {
+            // free additional memory
+            hash_table_item_free_inner_memory(hash_table_item);
 
-               // initialize new prefix_tree
-               hash_table_item->tree = prefix_tree_initialize(SUFFIX, 0, -1, DOMAIN_EXTENSION_NO, RELAXATION_AFTER_DELETE_YES);
+            // remove item from hash table
+            ht_remove_by_key_v2(hash_table, (char *) hash_table->keys[hash_table->ind[i].index]);
 
-               // check successful allocation memory
-               if (hash_table_item->tree == NULL) {
-                  PRINT_ERR("hash_table_item->renew_tree, prefix_tree_initialize: Error memory allocation\n");
-               }
+            // actual hash table item was removed, continue with next item
+            continue;
+         }
 
-               // reset first_invite_request
-               hash_table_item->first_invite_request = (ur_time_t) 0;
+         // check if prefix_tree has more than max_item_prefix_tree items
+         if ((hash_table_item->tree->root->count_of_string > modul_configuration.max_item_prefix_tree)) {
+            // destroy prefix_tree
+            prefix_tree_destroy(hash_table_item->tree);
 
+            // initialize new prefix_tree
+            hash_table_item->tree = prefix_tree_initialize(SUFFIX, 0, -1, DOMAIN_EXTENSION_NO, RELAXATION_AFTER_DELETE_YES);
+
+            // check successful allocation memory
+            if (hash_table_item->tree == NULL) {
+               PRINT_ERR("hash_table_item->renew_tree, prefix_tree_initialize: Error memory allocation\n");
             }
 
+            // reset first_invite_request
+            hash_table_item->first_invite_request = (ur_time_t) 0;
+
+            // saved nodes of inserted SIP_TO belong to the old tree
+            inserted_sip_to_reset(hash_table_item, 1);
+
          }
+
       }
+   }
+
+   check_position = end_position;
+
+   // check if all slots were checked
+   if (check_position >= hash_table->table_size) {
+      check_position = -1;
 
       // save time of last check of module memory
       time_last_check = current_time;
@@ -236,54 +258,86 @@ void event_id_save(char * file)
    }
 }
 
-// Find if Call-ID exists in node_data
-// Return 1 if Call-ID exists, 0 otherwise
+// Index of the first slot for Call-ID hash in hash set of node_data
 
-int call_id_node_data_exists(prefix_tree_domain_t * prefix_tree_node, char * call_id, int call_id_len)
+static inline unsigned int call_id_set_index(uint32_t call_id_hash)
 {
-   int i;
-   int end_index = MAX_CALL_ID_STORAGE_SIZE;
+   return call_id_hash & (CALL_ID_SET_SIZE - 1);
+}
+
+// Find slot of Call-ID hash in hash set of node_data
+// Return index of slot if Call-ID hash exists, -1 otherwise
 
-   // if storage of Call-ID isn't full, set correct end index
-   if (((node_data_t *) (prefix_tree_node->parent->value))->call_id_full == 0) {
-      end_index = ((node_data_t *) (prefix_tree_node->parent->value))->call_id_insert_position;
+static int call_id_set_find(node_data_t * node_data, uint32_t call_id_hash)
+{
+   unsigned int i = call_id_set_index(call_id_hash);
+
+   // slots contain position in call_id_hash storage + 1 (0 = empty slot)
+   while (node_data->call_id_set[i] != 0) {
+      if (node_data->call_id_hash[node_data->call_id_set[i] - 1] == call_id_hash) return i;
+      i = (i + 1) & (CALL_ID_SET_SIZE - 1);
    }
 
-   uint32_t call_id_hash;
+   return -1;
+}
+
+// Remove slot from hash set of node_data (shift following slots back instead of tombstones)
 
-   for (i = 0; i < end_index; i++) {
+static void call_id_set_remove(node_data_t * node_data, unsigned int i)
+{
+   unsigned int j = i, k;
 
-      // calculation hash of call_id
-      call_id_hash = SuperFastHash(call_id, sizeof (char) * call_id_len);
+   while (1) {
+      j = (j + 1) & (CALL_ID_SET_SIZE - 1);
+      if (node_data->call_id_set[j] == 0) break;
 
-      // check if input call_id_hash is the same as node_data->call_id_hash[i]
-      if (((node_data_t *) (prefix_tree_node->parent->value))->call_id_hash[i] == call_id_hash) {
-         // Call-ID found
-         return 1;
+      // move slot j to the empty position i, if i lies between its first slot k and j
+      k = call_id_set_index(node_data->call_id_hash[node_data->call_id_set[j] - 1]);
+      if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+         node_data->call_id_set[i] = node_data->call_id_set[j];
+         i = j;
       }
    }
-   return 0;
+
+   node_data->call_id_set[i] = 0;
+}
+
+// Find if Call-ID exists in node_data
+// Return 1 if Call-ID exists, 0 otherwise
+
+int call_id_node_data_exists(prefix_tree_domain_t * prefix_tree_node, uint32_t call_id_hash)
+{
+   return call_id_set_find((node_data_t *) (prefix_tree_node->parent->value), call_id_hash) >= 0;
 }
 
 // Save Call-ID to node_data
 
-void call_id_node_data_save(prefix_tree_domain_t * prefix_tree_node, char * call_id, int call_id_len)
+void call_id_node_data_save(prefix_tree_domain_t * prefix_tree_node, uint32_t call_id_hash)
 {
+   node_data_t * node_data = (node_data_t *) (prefix_tree_node->parent->value);
+
    // check if Call-ID doesn't exist in node data
-   if (call_id_node_data_exists(prefix_tree_node, call_id, call_id_len) == 0) {
-      unsigned int call_id_insert_position = ((node_data_t *) (prefix_tree_node->parent->value))->call_id_insert_position;
+   if (call_id_set_find(node_data, call_id_hash) == -1) {
+      unsigned int call_id_insert_position = node_data->call_id_insert_position;
 
-      // calculation hash of call_id
-      uint32_t call_id_hash = SuperFastHash(call_id, sizeof (char) * call_id_len);
+      // storage is full, the oldest Call-ID on insert position is replaced
+      if (node_data->call_id_full == 1) {
+         call_id_set_remove(node_data, call_id_set_find(node_data, node_data->call_id_hash[call_id_insert_position]));
+      }
 
       // save hash to Call-ID storage
-      ((node_data_t *) (prefix_tree_node->parent->value))->call_id_hash[call_id_insert_position] = call_id_hash;
+      node_data->call_id_hash[call_id_insert_position] = call_id_hash;
+
+      // save position of hash to hash set
+      unsigned int i = call_id_set_index(call_id_hash);
+      while (node_data->call_id_set[i] != 0) i = (i + 1) & (CALL_ID_SET_SIZE - 1);
+      node_data->call_id_set[i] = call_id_insert_position + 1;
 
       // increment insert position of Call-ID storage
-      ((node_data_t *) (prefix_tree_node->parent->value))->call_id_insert_position += 1;
-      if (((node_data_t *) (prefix_tree_node->parent->value))->call_id_insert_position >= MAX_CALL_ID_STORAGE_SIZE) {
-         ((node_data_t *) (prefix_tree_node->parent->value))->call_id_insert_position = 0;
-         ((node_data_t *) (prefix_tree_node->parent->value))->call_id_full = 1;
+      node_data->call_id_insert_position += 1;
+      if (node_data->call_id_insert_position >= MAX_CALL_ID_STORAGE_SIZE) {
+         node_data->call_id_insert_position = 0;
+         node_data->call_id_full = 1;
       }
 
    }
@@ -397,6 +451,7 @@ int main(int argc, char **argv)
    modul_configuration.countries_detection_mode = COUNTRIES_LEARNING_MODE;
    modul_configuration.learning_countries_period = DEFAULT_LEARNING_COUNTRIES_PERIOD;
    modul_configuration.countries_file = DEFAULT_COUNTRIES_FILE;
+   modul_configuration.countries_file_binary = 0;
    modul_configuration.allowed_countries = NULL;
    modul_configuration.allowed_countries_count = 0;
    modul_configuration.disable_saving_new_country = 0;
@@ -443,6 +498,9 @@ int main(int argc, char **argv)
          case 'a':
             modul_configuration.learning_countries_period = atoi(optarg);
             break;
+         case 'b':
+            modul_configuration.countries_file_binary = 1;
+            break;
          case 'w':
             modul_configuration.disable_saving_new_country = 1;
             break;
@@ -452,6 +510,7 @@ int main(int argc, char **argv)
 #else
          case 'c':
          case 'a':
+         case 'b':
          case 'w':
          case 'o':
             PRINT_ERR("You must install GeoIP before you can use detection of calling to different countries!\n");
@@ -485,6 +544,10 @@ int main(int argc, char **argv)
       }
    }
 
+   // open log file, the rest of the log is written at exit
+   open_log();
+   atexit(close_log);
+
 
    // ***** Set correct mode of countries detection and set alarm *****
 
@@ -634,6 +697,9 @@ int main(int argc, char **argv)
    if (countries_load_all_from_file(modul_configuration.countries_file, &hash_table_ip) == -1) {
       PRINT_ERR_LOG("Error loading countries file!\n");
    }
+
+   // countries file is saved in background during processing
+   countries_writer_start();
 #endif
 
    // definition of required variables
@@ -645,6 +711,7 @@ int main(int argc, char **argv)
    char user_agent[MAX_LENGTH_USER_AGENT + 1];
    char sip_cseq[MAX_LENGTH_SIP_CSEQ + 1];
    int call_id_len, user_agent_len;
+   uint32_t call_id_hash;
    char *sip_target, *sip_from;
    int sip_from_len, sip_target_len, sip_cseq_len;
 
@@ -709,6 +776,7 @@ int main(int argc, char **argv)
 
          global_module_statistic.received_invite_flow_count++;
          get_string_from_unirec(call_id, &call_id_len, F_SIP_CALL_ID, MAX_LENGTH_CALL_ID);
+         call_id_hash = SuperFastHash(call_id, sizeof (char) * call_id_len);
          get_string_from_unirec(user_agent, &user_agent_len, F_SIP_USER_AGENT, MAX_LENGTH_USER_AGENT);
          ip_src = &ur_get(ur_template_in, in_rec, F_SRC_IP);
          ip_to_str(ip_src, ip_src_str);
@@ -772,10 +840,13 @@ int main(int argc, char **argv)
             callee_count++;
          }
 
+         // subtree of inserted node will be examined by next check of prefix examination
+         inserted_sip_to_save(hash_table_item, prefix_tree_node);
+
          // check of successful initialization of node data
          if (node_data_check_initialize(prefix_tree_node) == -1) continue;
          // save Call-ID to node_data
-         call_id_node_data_save(prefix_tree_node, call_id, call_id_len);
+         call_id_node_data_save(prefix_tree_node, call_id_hash);
 
          // compute hash of User-Agent
          ((node_data_t *) (prefix_tree_node->parent->value))->user_agent_hash = SuperFastHash(user_agent, sizeof (char) * user_agent_len);
@@ -815,7 +886,7 @@ int main(int argc, char **argv)
 
          cut_sip_identifier(&sip_from, sip_from_orig, &sip_from_len);
          get_string_from_unirec(call_id, &call_id_len, F_SIP_CALL_ID, MAX_LENGTH_CALL_ID);
-         get_string_from_unirec(call_id, &call_id_len, F_SIP_CALL_ID, MAX_LENGTH_CALL_ID);
+         call_id_hash = SuperFastHash(call_id, sizeof (char) * call_id_len);
          ip_src = &ur_get(ur_template_in, in_rec, F_SRC_IP);
          ip_to_str(ip_src, ip_src_str);
          ip_dst = &ur_get(ur_template_in, in_rec, F_DST_IP);
@@ -835,7 +906,7 @@ int main(int argc, char **argv)
             if (node_data_check_initialize(prefix_tree_node) == -1) continue;
 
             // check if Call-ID is saved in node_data
-            if (call_id_node_data_exists(prefix_tree_node, call_id, call_id_len) == 1) {
+            if (call_id_node_data_exists(prefix_tree_node, call_id_hash) == 1) {
                ((node_data_t *) (prefix_tree_node->parent->value))->ok_count++;
 #ifdef ENABLE_GEOIP
                if (modul_configuration.countries_detection_mode != COUNTRIES_DETECTION_MODE_OFF) {
@@ -897,6 +968,7 @@ int main(int argc, char **argv)
    PRINT_OUT_LOG("   - invalid_sip_identifier=", uint_to_str(global_module_statistic.invalid_sip_identifier_count), "\n");
 
 #ifdef ENABLE_GEOIP
+   countries_writer_stop();
    countries_save_all_to_file(modul_configuration.countries_file, &hash_table_ip);
 #endif
 
@@ -98,18 +98,17 @@ void event_id_save(char * file);
 
 /** \brief Find if Call-ID exists in node_data (data of node in suffix tree).
  * \param[in] prefix_tree_node Pointer to node, in which is done searching.
- * \param[in] call_id Call-ID to search in node_data.
- * \param[in] call_id_len Length of call_id string to search.
+ * \param[in] call_id_hash SuperFastHash of Call-ID to search in node_data.
  * \return Return 1 if Call-ID exists in node_data, 0 otherwise.
  */
-int call_id_node_data_exists(prefix_tree_domain_t * prefix_tree_node, char * call_id, int call_id_len);
+int call_id_node_data_exists(prefix_tree_domain_t * prefix_tree_node, uint32_t call_id_hash);
 
 /** \brief Save Call-ID to node_data (data of node in suffix tree).
+ * The oldest Call-ID is replaced when storage is full.
  * \param[in] prefix_tree_node Pointer to node to save node_data.
- * \param[in] call_id Call-ID to save in node_data.
- * \param[in] call_id_len Length of Call-ID string to save.
+ * \param[in] call_id_hash SuperFastHash of Call-ID to save in node_data.
  */
-void call_id_node_data_save(prefix_tree_domain_t * prefix_tree_node, char * call_id, int call_id_len);
+void call_id_node_data_save(prefix_tree_domain_t * prefix_tree_node, uint32_t call_id_hash);
 
 /** \brief Cut SIP identifier from input string.
  * Cut first 4 chars ("sip:") or 5 chars ("sips:") from input string and ignore ';' or '?' + string after it.
@@ -0,0 +1,104 @@
+/**
+ * \file insert_port_bench.c
+ * \brief Micro-benchmark of insert_port() of vportscan_detector (make bench).
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+/*
+ * The set of ports is internal to the module, so its translation unit is
+ * included with main() renamed.
+ */
+#define main vportscan_detector_main
+#include "vportscan_detector.c"
+#undef main
+
+#include "bench.h"
+
+#define ITEM_CNT 4096
+#define FLOW_CNT (1 << 22)
+
+// Flows of scanners, a quarter of them hit a few common ports (seen twice
+// they are removed from the set)
+typedef struct bench_flow_s {
+   uint32_t item;
+   uint16_t dst_port;
+} bench_flow_t;
+
+static item_t items[ITEM_CNT];
+
+int main(void)
+{
+   bench_flow_t *flows = (bench_flow_t *) malloc(FLOW_CNT * sizeof(bench_flow_t));
+   unsigned long alerts = 0;
+   unsigned long start_allocations;
+   double start;
+   uint32_t i;
+
+   if (flows == NULL) {
+      fprintf(stderr, "ERROR: could not allocate flows.\n");
+      return 1;
+   }
+
+   for (i = 0; i < FLOW_CNT; i++) {
+      uint64_t r = bench_rand();
+      flows[i].item = (r >> 32) % ITEM_CNT;
+      flows[i].dst_port = ((r >> 48) & 3) ? r % 65536 : r % 64;
+   }
+
+   start = bench_now_ns();
+   start_allocations = bench_allocations();
+   for (i = 0; i < FLOW_CNT; i++) {
+      item_t *np = &items[flows[i].item];
+
+      if (insert_port(np, flows[i].dst_port, i) == 1) {
+         // The reported item is deleted by the module
+         alerts++;
+         free(np->dynamic_ports);
+         memset(np, 0, sizeof(item_t));
+      }
+   }
+   bench_report("insert_port", FLOW_CNT, start, start_allocations);
+   printf("%-32s %10lu\n", "alerts", alerts);
+
+   for (i = 0; i < ITEM_CNT; i++) {
+      free(items[i].dynamic_ports);
+   }
+   free(flows);
+   return 0;
+}
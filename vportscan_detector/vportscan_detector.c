@@ -54,21 +54,23 @@
 #include <libtrap/trap.h>
 #include <unirec/unirec.h>
 #include "fields.h"
-#include <b_plus_tree.h>
 #include <time.h>
+#include "ip_table.h"
+#include "ip_wheel.h"
 
 #define MAX_PACKETS 4 // Maximum number of packets in suspicious flow
 #define MAX_PORTS 50 // After reaching this maximum of scanned ports for one IP address, alert is sent
 #define MAX_AGE_OF_UNMODIFIED_PORTS_TABLE 5*60 // This determines maximum age of the unchanged ports table for one IP address
 
-#define TIME_BEFORE_PRUNING 1*60
+#define TABLE_INITIAL_SIZE 4096
+#define EXPIRED_ITEMS_PER_FLOW 16 // Maximum number of expired timers checked per flow
 
 #define TCP_PROTOCOL 0x6
 #define TCP_FLAGS_SYN 0x2
 
-#define NUM_OF_ITEMS_IN_TREE_LEAF 5
 #define STATIC_PORT_ARR_SIZE  10
-#define DYNAMIC_PORT_ARR_SIZE  (MAX_PORTS - STATIC_PORT_ARR_SIZE)
+#define PORT_SET_BITS 7 // Set of ports has 2^PORT_SET_BITS slots (more than twice MAX_PORTS)
+#define PORT_SET_SIZE (1 << PORT_SET_BITS)
 
 UR_FIELDS (
    ipaddr DST_IP,
@@ -102,9 +104,11 @@ TRAP_DEFAULT_SIGNAL_HANDLER(stop = 1)
 typedef struct item_s item_t;
 
 struct item_s {
-   time_t ts_modified;
+   time_t ts_modified; // TIME_LAST of the last modifying flow (in seconds)
+   time_t ts_queued; // Time of modification when the timer of the key was added
    uint16_t static_ports[STATIC_PORT_ARR_SIZE];
-   uint16_t *dynamic_ports;
+   uint16_t *dynamic_ports; // Open addressing set of all ports (0 is empty slot), allocated after STATIC_PORT_ARR_SIZE ports
+   uint8_t zero_port; // Port 0 is in the set of dynamic_ports
    uint8_t ports_cnts;
    ur_time_t ts_first;
    ur_time_t ts_last;
@@ -112,26 +116,72 @@ struct item_s {
 
 /***********************************************/
 
-int compare_64b(void *a, void *b)
+/**
+ * Function returns home slot of the port in the set of dynamic_ports.
+ */
+static inline uint32_t port_set_home(uint16_t port)
+{
+   return (uint32_t) (port * 2654435761U) >> (32 - PORT_SET_BITS);
+}
+
+/**
+ * Function removes the port from the set of dynamic_ports if it is
+ * present (following ports of the cluster are shifted back). Returns 1
+ * if the port was removed, 0 if it is not present.
+ */
+int port_set_remove(item_t *info, uint16_t port)
 {
-   uint64_t *h1, *h2;
-   h1 = (uint64_t*)a;
-   h2 = (uint64_t*)b;
-   if (*h1 == *h2) {
-      return EQUAL;
+   uint32_t x, y, home;
+
+   if (port == 0) {
+      if (info->zero_port == 0) {
+         return 0;
+      }
+      info->zero_port = 0;
+      return 1;
+   }
+
+   for (x = port_set_home(port); info->dynamic_ports[x] != port; x = (x + 1) & (PORT_SET_SIZE - 1)) {
+      if (info->dynamic_ports[x] == 0) {
+         return 0;
+      }
    }
-   else if (*h1 < *h2) {
-      return LESS;
+
+   for (y = (x + 1) & (PORT_SET_SIZE - 1); info->dynamic_ports[y] != 0; y = (y + 1) & (PORT_SET_SIZE - 1)) {
+      home = port_set_home(info->dynamic_ports[y]);
+      // Move the port to the free slot if it's not between the slot and
+      // its home slot
+      if (((y - home) & (PORT_SET_SIZE - 1)) >= ((y - x) & (PORT_SET_SIZE - 1))) {
+         info->dynamic_ports[x] = info->dynamic_ports[y];
+         x = y;
+      }
    }
-   else {
-      return MORE;
+   info->dynamic_ports[x] = 0;
+   return 1;
+}
+
+/**
+ * Function inserts port (not present) into the set of dynamic_ports.
+ */
+void port_set_insert(item_t *info, uint16_t port)
+{
+   uint32_t x;
+
+   if (port == 0) {
+      info->zero_port = 1;
+      return;
    }
+
+   // The set is never more than half full so there is always an empty slot
+   for (x = port_set_home(port); info->dynamic_ports[x] != 0; x = (x + 1) & (PORT_SET_SIZE - 1));
+   info->dynamic_ports[x] = port;
 }
 
 /**
  * Function returns 1 in case of alert, 0 after successful added port and -1 in case of error.
+ * The ts_flow is the time of the flow used as the time of modification.
  */
-int insert_port(void *p, int port)
+int insert_port(void *p, uint16_t port, time_t ts_flow)
 {
    int x = 0;
    item_t *info = NULL;
@@ -142,49 +192,45 @@ int insert_port(void *p, int port)
 
    info = (item_t *) p;
 
-   for (x = 0; x < info->ports_cnts; x++) {
-      if (x < STATIC_PORT_ARR_SIZE) {
+   if (info->dynamic_ports == NULL) {
+      for (x = 0; x < info->ports_cnts; x++) {
          if (info->static_ports[x] == port) {
-            if (info->ports_cnts > STATIC_PORT_ARR_SIZE) {
-               info->static_ports[x] = info->dynamic_ports[info->ports_cnts - STATIC_PORT_ARR_SIZE - 1];
-               info->dynamic_ports[info->ports_cnts - STATIC_PORT_ARR_SIZE - 1] = 0;
-            } else if (info->ports_cnts > 1) {
+            if (info->ports_cnts > 1) {
                info->static_ports[x] = info->static_ports[info->ports_cnts - 1];
                info->static_ports[info->ports_cnts - 1] = 0;
             } else {
                info->static_ports[x] = 0;
             }
             info->ports_cnts--;
-            time(&info->ts_modified); // Update the time of table modification
+            info->ts_modified = ts_flow; // Update the time of table modification
             return 0;
          }
+      }
+
+      if (info->ports_cnts < STATIC_PORT_ARR_SIZE) {
+         info->static_ports[info->ports_cnts] = port; // Insert the new port into first free index
       } else {
-         if (info->dynamic_ports[x - STATIC_PORT_ARR_SIZE] == port) {
-            if (x < (info->ports_cnts - 1)) {
-               info->dynamic_ports[x - STATIC_PORT_ARR_SIZE] = info->dynamic_ports[info->ports_cnts - 1 - STATIC_PORT_ARR_SIZE];
-               info->dynamic_ports[info->ports_cnts - 1 - STATIC_PORT_ARR_SIZE] = 0;
-            } else {
-               info->dynamic_ports[x - STATIC_PORT_ARR_SIZE] = 0;
-            }
-            info->ports_cnts--;
-            time(&info->ts_modified); // Update the time of table modification
-            return 0;
+         // Inserting first port to dynamic set - allocate the set and move all static ports to it
+         info->dynamic_ports = (uint16_t *) calloc(PORT_SET_SIZE, sizeof(uint16_t));
+         if (info->dynamic_ports == NULL) {
+            return -1;
+         }
+         for (x = 0; x < STATIC_PORT_ARR_SIZE; x++) {
+            port_set_insert(info, info->static_ports[x]);
          }
+         port_set_insert(info, port);
       }
-   }
-
-   if (info->ports_cnts < STATIC_PORT_ARR_SIZE) {
-      info->static_ports[info->ports_cnts] = port; // Insert the new port into first free index
    } else {
-      if (info->dynamic_ports == NULL) {
-         // Inserting first port to dynamic array - allocate the array
-         info->dynamic_ports = (uint16_t *) calloc(DYNAMIC_PORT_ARR_SIZE, sizeof(uint16_t));
+      if (port_set_remove(info, port)) {
+         info->ports_cnts--;
+         info->ts_modified = ts_flow; // Update the time of table modification
+         return 0;
       }
-      info->dynamic_ports[info->ports_cnts - STATIC_PORT_ARR_SIZE] = port;
+      port_set_insert(info, port);
    }
 
    info->ports_cnts++;
-   time(&info->ts_modified); // Update the time of table modification
+   info->ts_modified = ts_flow; // Update the time of table modification
 
    if (info->ports_cnts >= MAX_PORTS) {
       return 1; // Signalize alert after reaching MAX_PORTS scanned ports
@@ -193,10 +239,54 @@ int insert_port(void *p, int port)
    return 0;
 }
 
+/**
+ * Function adds timer of the key, the item expires when it's not modified
+ * longer than MAX_AGE_OF_UNMODIFIED_PORTS_TABLE after ts_queued. Returns 0 on
+ * success and -1 in case of error.
+ */
+static inline int schedule_item(ip_wheel_t *wheel, uint64_t key, item_t *item, time_t ts)
+{
+   item->ts_queued = ts;
+   return ip_wheel_add(wheel, &key, ts + MAX_AGE_OF_UNMODIFIED_PORTS_TABLE + 1);
+}
+
+/**
+ * Function deletes a few items of the table which weren't modified longer than
+ * MAX_AGE_OF_UNMODIFIED_PORTS_TABLE, the keys are taken from the expired timers.
+ * Items modified in the meantime are scheduled again. Returns 0 on success and
+ * -1 in case of error.
+ */
+int expire_items(ip_table_t *table, ip_wheel_t *wheel, time_t ts_cur_time)
+{
+   uint64_t key;
+   uint64_t expires;
+   item_t *value_pt = NULL;
+   int x;
+
+   for (x = 0; x < EXPIRED_ITEMS_PER_FLOW && ip_wheel_pop(wheel, ts_cur_time, &key, &expires); x++) {
+      value_pt = ip_table_search(table, &key);
+      if (value_pt == NULL || (uint64_t) (value_pt->ts_queued + MAX_AGE_OF_UNMODIFIED_PORTS_TABLE + 1) != expires) {
+         continue; // Item was deleted or the key was scheduled again
+      }
+
+      if ((ts_cur_time - value_pt->ts_modified) > MAX_AGE_OF_UNMODIFIED_PORTS_TABLE) {
+         // free dynamic array of ports
+         if (value_pt->dynamic_ports != NULL) {
+            free(value_pt->dynamic_ports);
+         }
+         ip_table_delete(table, ip_table_index(table, value_pt));
+      } else if (schedule_item(wheel, key, value_pt, value_pt->ts_modified) != 0) {
+         fprintf(stderr, "ERROR: could not allocate timer wheel.\n");
+         return -1;
+      }
+   }
+   return 0;
+}
+
 int main(int argc, char **argv)
 {
-   time_t ts_last_pruning;
-   time_t ts_cur_time;
+   time_t ts_cur_time = 0;
+   time_t ts_flow;
    int ret_val = 0;
    const void *recv_data;
    uint16_t recv_data_size = 0;
@@ -211,17 +301,19 @@ int main(int argc, char **argv)
 
    uint32_t int_src_ip = 0;
    uint32_t int_dst_ip = 0;
-   uint64_t ip_to_tree = 0;
+   uint64_t ip_key = 0;
    ur_time_t ts_first, ts_last;
 
-   bpt_t *b_plus_tree = bpt_init(NUM_OF_ITEMS_IN_TREE_LEAF, &compare_64b, sizeof(item_t), sizeof(uint64_t));
-   if (b_plus_tree == NULL) {
-      fprintf(stderr, "ERROR: Could not initialize B_PLUS_TREE\n");
+   ip_table_t *table = ip_table_init(TABLE_INITIAL_SIZE, sizeof(uint64_t), sizeof(item_t));
+   if (table == NULL) {
+      fprintf(stderr, "ERROR: Could not initialize table of address pairs\n");
       fflush(stderr);
       return 0;
    }
    void *new_item = NULL;
    item_t *np = NULL;
+   ip_wheel_t wheel;
+   ip_wheel_init(&wheel, sizeof(uint64_t));
 
    ur_template_t *out_tmplt = NULL, *in_tmplt = NULL;
    void *out_rec = NULL;
@@ -258,9 +350,6 @@ int main(int argc, char **argv)
 
    trap_ifcctl(TRAPIFC_OUTPUT, 0, TRAPCTL_SETTIMEOUT, TRAP_NO_WAIT);
 
-   // Initialize time of last pruning of the B+ tree
-   time(&ts_last_pruning);
-
    while (!stop) {
       ret_val = TRAP_RECEIVE(0, recv_data, recv_data_size, in_tmplt);
       TRAP_DEFAULT_RECV_ERROR_HANDLING(ret_val, continue, break);
@@ -275,6 +364,12 @@ int main(int argc, char **argv)
          }
       }
 
+      // Current time is the latest TIME_LAST of flows, so that the timeouts work the same for data read from files
+      ts_flow = ur_time_get_sec(ur_get(in_tmplt, recv_data, F_TIME_LAST));
+      if (ts_flow > ts_cur_time) {
+         ts_cur_time = ts_flow;
+      }
+
       src_ip = &ur_get(in_tmplt, recv_data, F_SRC_IP);
       dst_ip = &ur_get(in_tmplt, recv_data, F_DST_IP);
 
@@ -291,21 +386,29 @@ int main(int argc, char **argv)
       int_src_ip = ip_get_v4_as_int(src_ip);
       int_dst_ip = ip_get_v4_as_int(dst_ip);
 
-      // Concatenate ip_v4 DST_IP and ip_v4 SRC_IP to uint64 (used as a key value in B+ tree)
-      ip_to_tree = int_dst_ip;
-      ip_to_tree = ip_to_tree << 32;
-      ip_to_tree |= int_src_ip;
+      // Concatenate ip_v4 DST_IP and ip_v4 SRC_IP to uint64 (used as a key in the table)
+      ip_key = int_dst_ip;
+      ip_key = ip_key << 32;
+      ip_key |= int_src_ip;
 
       if (packets <= MAX_PACKETS && (protocol == TCP_PROTOCOL && (tcp_flags == TCP_FLAGS_SYN))) {
-         new_item = bpt_search_or_insert(b_plus_tree, &ip_to_tree);
+         new_item = ip_table_search_or_insert(table, &ip_key);
          if (new_item == NULL) {
-            fprintf(stderr, "ERROR: could not allocate port-scan info structure in leaf node of the B+ tree.\n");
+            fprintf(stderr, "ERROR: could not allocate port-scan info structure in the table.\n");
             fflush(stderr);
             goto cleanup;
          }
          ts_first = ur_get(in_tmplt, recv_data, F_TIME_FIRST);
          ts_last = ur_get(in_tmplt, recv_data, F_TIME_LAST);
          np = (item_t *) new_item;
+         if (np->ts_modified == 0) {
+            // New item - schedule its expiration
+            if (schedule_item(&wheel, ip_key, np, ur_time_get_sec(ts_last)) != 0) {
+               fprintf(stderr, "ERROR: could not allocate timer wheel.\n");
+               fflush(stderr);
+               goto cleanup;
+            }
+         }
          if (np->ports_cnts == 0) {
             np->ts_first = ts_first;
             np->ts_last = ts_last;
@@ -318,7 +421,12 @@ int main(int argc, char **argv)
             }
          }
 
-         if (insert_port(new_item, dst_port) == 1) {
+         ret_val = insert_port(new_item, dst_port, ur_time_get_sec(ts_last));
+         if (ret_val == -1) {
+            fprintf(stderr, "ERROR: could not allocate set of ports.\n");
+            fflush(stderr);
+            goto cleanup;
+         } else if (ret_val == 1) {
             // Scan detected
             ur_copy_fields(out_tmplt, out_rec, in_tmplt, recv_data);
 
@@ -334,10 +442,10 @@ int main(int argc, char **argv)
                free(np->dynamic_ports);
             }
 
-            // delete item from tree no matter how successful was trap_send()
-            bpt_item_del(b_plus_tree, &ip_to_tree);
+            // delete item from the table no matter how successful was trap_send()
+            ip_table_delete(table, ip_table_index(table, np));
 
-            // break on error, do nothing on timeout in order to perform tree pruning
+            // break on error, do nothing on timeout in order to perform table pruning
             TRAP_DEFAULT_SEND_ERROR_HANDLING(ret_val, (void) 0, break);
          }
 
@@ -345,50 +453,16 @@ int main(int argc, char **argv)
          // flow of unsatisfied condition (TCP, packet number)
       }
 
-      // B+ tree pruning
-      time(&ts_cur_time);
-      if ((ts_cur_time - ts_last_pruning) > TIME_BEFORE_PRUNING) {
-         item_t *value_pt = NULL;
-         bpt_list_item_t *b_item = NULL;
-         int has_next = 0;
-
-         // Create a structure for iterating throw the leaves
-         b_item = bpt_list_init(b_plus_tree);
-         if (b_item == NULL) {
-            fprintf(stderr, "ERROR: could not initialize a list iterator structure\n");
-            goto cleanup;
-         }
-
-         // Get first value from the list. Function returns 1 if there are more values, 0 if there is no value
-         has_next = bpt_list_start(b_plus_tree, b_item);
-         while (has_next == 1) {
-            // Get the value from B+ item structure
-            value_pt = b_item->value;
-            if (value_pt == NULL) {
-               //there is problem in the tree. This case should be unreachable
-               fprintf(stderr, "ERROR during iteration through the tree. Value is NULL\n");
-               goto cleanup;
-            }
-
-            // Delete the item if it wasn't modified longer than MAX_AGE_OF_IP_IN_SEC(1)
-            if ((ts_cur_time - value_pt->ts_modified) > MAX_AGE_OF_UNMODIFIED_PORTS_TABLE) {
-               // free dynamic array of ports
-               if (value_pt->dynamic_ports != NULL) {
-                  free(value_pt->dynamic_ports);
-               }
-               has_next = bpt_list_item_del(b_plus_tree, b_item);
-            } else { // Get next item from the list
-               has_next = bpt_list_item_next(b_plus_tree, b_item);
-            }
-         }
-
-         time(&ts_last_pruning);
+      // Table pruning - a few items with expired timers
+      if (expire_items(table, &wheel, ts_cur_time) != 0) {
+         goto cleanup;
       }
    }
 
    // ***** Cleanup *****
 cleanup:
-   bpt_clean(b_plus_tree);
+   ip_table_destroy(table);
+   ip_wheel_destroy(&wheel);
    ur_free_template(in_tmplt);
    ur_free_template(out_tmplt);
    ur_free_record(out_rec);